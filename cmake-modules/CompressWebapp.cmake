@@ -0,0 +1,37 @@
+#
+# Glewlwyd
+#
+# CMake install script that creates the precompressed siblings <file>.gz and <file>.br
+# of the webapp text and font files in WEBAPP_DIR, at the maximum compression level.
+# The static files server sends these siblings instead of compressing the files.
+#
+#   WEBAPP_DIR         - Path of the installed webapp
+#   GZIP_EXECUTABLE    - Path to gzip, the .gz files aren't created if empty
+#   BROTLI_EXECUTABLE  - Path to brotli, the .br files aren't created if empty
+#
+# Copyright 2016-2022 Nicolas Mora <mail@babelouest.org>
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the MIT License
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+#
+
+file(GLOB_RECURSE WEBAPP_COMPRESS_FILES
+     "${WEBAPP_DIR}/*.js" "${WEBAPP_DIR}/*.css" "${WEBAPP_DIR}/*.html" "${WEBAPP_DIR}/*.json"
+     "${WEBAPP_DIR}/*.svg" "${WEBAPP_DIR}/*.ttf" "${WEBAPP_DIR}/*.eot" "${WEBAPP_DIR}/*.otf")
+
+foreach (WEBAPP_FILE ${WEBAPP_COMPRESS_FILES})
+  get_filename_component(WEBAPP_FILE_NAME ${WEBAPP_FILE} NAME)
+  # config.json is edited after install, a precompressed copy would be outdated
+  if (NOT WEBAPP_FILE_NAME STREQUAL "config.json")
+    if (GZIP_EXECUTABLE)
+      execute_process(COMMAND ${GZIP_EXECUTABLE} -9 -k -f -n ${WEBAPP_FILE})
+    endif ()
+    if (BROTLI_EXECUTABLE)
+      execute_process(COMMAND ${BROTLI_EXECUTABLE} -q 11 -k -f ${WEBAPP_FILE})
+    endif ()
+  endif ()
+endforeach ()
@@ -0,0 +1,52 @@
+#.rst:
+# FindBrotli
+# ----------
+#
+# Find Brotli
+#
+# Find Brotli headers and libraries.
+#
+# ::
+#
+#   BROTLI_FOUND          - True if Brotli found.
+#   BROTLI_INCLUDE_DIRS   - Where to find brotli/encode.h.
+#   BROTLI_LIBRARIES      - List of libraries when using Brotli.
+
+#=============================================================================
+# Copyright 2022 Nicolas Mora <mail@babelouest.org>
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public License
+# as published by the Free Software Foundation;
+# version 2.1 of the License.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	See the
+# GNU GENERAL PUBLIC LICENSE for more details.
+#
+# You should have received a copy of the GNU General Public
+# License along with this library.	If not, see <http://www.gnu.org/licenses/>.
+#=============================================================================
+
+find_package(PkgConfig QUIET)
+pkg_check_modules(PC_BROTLI QUIET libbrotlienc)
+
+find_path(BROTLI_INCLUDE_DIR
+        NAMES brotli/encode.h
+        HINTS ${PC_BROTLI_INCLUDEDIR} ${PC_BROTLI_INCLUDE_DIRS})
+
+find_library(BROTLI_LIBRARY
+        NAMES brotlienc libbrotlienc
+        HINTS ${PC_BROTLI_LIBDIR} ${PC_BROTLI_LIBRARY_DIRS})
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(Brotli
+        REQUIRED_VARS BROTLI_LIBRARY BROTLI_INCLUDE_DIR)
+
+if (BROTLI_FOUND)
+    set(BROTLI_LIBRARIES ${BROTLI_LIBRARY})
+    set(BROTLI_INCLUDE_DIRS ${BROTLI_INCLUDE_DIR})
+endif ()
+
+mark_as_advanced(BROTLI_INCLUDE_DIR BROTLI_LIBRARY)
@@ -27,16 +27,13 @@
 #include "glewlwyd.h"
 
 int verify_api_key(struct config_elements * config, const char * token) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query, * j_result = NULL;
   int res, ret;
-  char * token_hash = NULL, * tmp;
+  char token_hash[GLEWLWYD_HASH_BUFFER_SIZE];
   
   if (o_strlen(token) == GLEWLWYD_API_KEY_LENGTH) {
-    if ((token_hash = generate_hash(config->hash_algorithm, token)) != NULL) {
-      tmp = str_replace(token_hash, "/", "_");
-      o_free(token_hash);
-      token_hash = str_replace(tmp, "+", "-");
-      o_free(tmp);
+    if (generate_hash_buffer(config->hash_algorithm, token, 1, token_hash, sizeof(token_hash)) == G_OK) {
       j_query = json_pack("{sss[ss]s{ss?si}}",
                           "table",
                           GLEWLWYD_TABLE_API_KEY,
@@ -48,8 +45,7 @@ int verify_api_key(struct config_elements * config, const char * token) {
                             token_hash,
                             "gak_enabled",
                             1);
-      o_free(token_hash);
-      res = h_select(config->conn, j_query, &j_result, NULL);
+      res = h_select(conn, j_query, &j_result, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         if (json_array_size(j_result)) {
@@ -62,7 +58,7 @@ int verify_api_key(struct config_elements * config, const char * token) {
                               "where",
                                 "gak_id",
                                 json_object_get(json_array_get(j_result, 0), "gak_id"));
-          res = h_update(config->conn, j_query, NULL);
+          res = h_update(conn, j_query, NULL);
           json_decref(j_query);
           if (res == H_OK) {
             ret = G_OK;
@@ -81,16 +77,18 @@ int verify_api_key(struct config_elements * config, const char * token) {
         ret = G_ERROR_DB;
       }
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "verify_api_key - Error generate_hash");
+      y_log_message(Y_LOG_LEVEL_ERROR, "verify_api_key - Error generate_hash_buffer");
       ret = G_ERROR;
     }
   } else {
     ret = G_ERROR_UNAUTHORIZED;
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return ret;
 }
 
 json_t * get_api_key_list(struct config_elements * config, const char * pattern, size_t offset, size_t limit) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query, * j_result, * j_return, * j_element;
   int res;
   size_t index;
@@ -103,7 +101,7 @@ json_t * get_api_key_list(struct config_elements * config, const char * pattern,
                         "gak_token_hash AS token_hash",
                         "gak_counter AS counter",
                         "gak_username AS username",
-                        SWITCH_DB_TYPE(config->conn->type, "UNIX_TIMESTAMP(gak_issued_at) AS issued_at", "strftime('%s', gak_issued_at) AS issued_at", "EXTRACT(EPOCH FROM gak_issued_at)::integer AS issued_at"),
+                        SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gak_issued_at) AS issued_at", "strftime('%s', gak_issued_at) AS issued_at", "EXTRACT(EPOCH FROM gak_issued_at)::integer AS issued_at"),
                         "gak_issued_for AS issued_for",
                         "gak_user_agent AS user_agent",
                         "gak_enabled",
@@ -115,13 +113,13 @@ json_t * get_api_key_list(struct config_elements * config, const char * pattern,
     json_object_set_new(j_query, "limit", json_integer((json_int_t)limit));
   }
   if (!o_strnullempty(pattern)) {
-    pattern_escaped = h_escape_string_with_quotes(config->conn, pattern);
+    pattern_escaped = h_escape_string_with_quotes(conn, pattern);
     pattern_clause = msprintf("IN (SELECT gak_id FROM " GLEWLWYD_TABLE_API_KEY " WHERE gak_username LIKE '%%'||%s||'%%' OR gak_issued_for LIKE '%%'||%s||'%%' OR gak_user_agent LIKE '%%'||%s||'%%')", pattern_escaped, pattern_escaped, pattern_escaped);
     json_object_set_new(j_query, "where", json_pack("{s{ssss}}", "gak_id", "operator", "raw", "value", pattern_clause));
     o_free(pattern_escaped);
     o_free(pattern_clause);
   }
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     json_array_foreach(j_result, index, j_element) {
@@ -134,64 +132,56 @@ json_t * get_api_key_list(struct config_elements * config, const char * pattern,
     glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
 json_t * generate_api_key(struct config_elements * config, const char * username, const char * issued_for, const char * user_agent) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query, * j_return, * j_last_index;
   int res;
-  char token[GLEWLWYD_API_KEY_LENGTH+1] = {0}, * token_hash, * tmp;
+  char token[GLEWLWYD_API_KEY_LENGTH+1] = {0}, token_hash[GLEWLWYD_HASH_BUFFER_SIZE];
   
   if (rand_string(token, GLEWLWYD_API_KEY_LENGTH) != NULL) {
-    token_hash = generate_hash(config->hash_algorithm, token);
-    if (token_hash != NULL) {
-      tmp = str_replace(token_hash, "/", "_");
-      o_free(token_hash);
-      token_hash = str_replace(tmp, "+", "-");
-      o_free(tmp);
-      if (pthread_mutex_lock(&config->insert_lock)) {
-        y_log_message(Y_LOG_LEVEL_ERROR, "generate_api_key - Error pthread_mutex_lock");
-        j_return = json_pack("{si}", "result", G_ERROR);
-      } else {
-        j_query = json_pack("{sss{ssssssss?}}",
-                            "table", GLEWLWYD_TABLE_API_KEY,
-                            "values",
-                              "gak_token_hash", token_hash,
-                              "gak_username", username,
-                              "gak_issued_for", issued_for,
-                              "gak_user_agent", user_agent);
-        res = h_insert(config->conn, j_query, NULL);
-        json_decref(j_query);
-        if (res == H_OK) {
-          if ((j_last_index = h_last_insert_id(config->conn)) != NULL) {
-            update_issued_for(config, NULL, GLEWLWYD_TABLE_API_KEY, "gak_issued_for", issued_for, "gak_id", json_integer_value(j_last_index));
-            j_return = json_pack("{sis{ss}}", "result", G_OK, "api_key", "key", token);
-          } else {
-            y_log_message(Y_LOG_LEVEL_ERROR, "generate_api_key - Error j_last_index");
-            glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
-            j_return = json_pack("{si}", "result", G_ERROR_DB);
-          }
-          json_decref(j_last_index);
+    if (generate_hash_buffer(config->hash_algorithm, token, 1, token_hash, sizeof(token_hash)) == G_OK) {
+      j_query = json_pack("{sss{ssssssss?}}",
+                          "table", GLEWLWYD_TABLE_API_KEY,
+                          "values",
+                            "gak_token_hash", token_hash,
+                            "gak_username", username,
+                            "gak_issued_for", issued_for,
+                            "gak_user_agent", user_agent);
+      res = glewlwyd_db_insert(config, conn, j_query, "gak_id", &j_last_index);
+      json_decref(j_query);
+      if (res == H_OK) {
+        if (j_last_index != NULL) {
+          update_issued_for(config, NULL, GLEWLWYD_TABLE_API_KEY, "gak_issued_for", issued_for, "gak_id", json_integer_value(j_last_index));
+          j_return = json_pack("{sis{ss}}", "result", G_OK, "api_key", "key", token);
         } else {
-          y_log_message(Y_LOG_LEVEL_ERROR, "generate_api_key - Error executing j_query");
+          y_log_message(Y_LOG_LEVEL_ERROR, "generate_api_key - Error j_last_index");
           glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
           j_return = json_pack("{si}", "result", G_ERROR_DB);
         }
-        pthread_mutex_unlock(&config->insert_lock);
+        json_decref(j_last_index);
+      } else {
+        y_log_message(Y_LOG_LEVEL_ERROR, "generate_api_key - Error executing j_query");
+        glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+        j_return = json_pack("{si}", "result", G_ERROR_DB);
       }
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "generate_api_key - Error generate_hash");
+      y_log_message(Y_LOG_LEVEL_ERROR, "generate_api_key - Error generate_hash_buffer");
       j_return = json_pack("{si}", "result", G_ERROR);
     }
-    o_free(token_hash);
   } else {
     y_log_message(Y_LOG_LEVEL_ERROR, "generate_api_key - Error rand_string");
     j_return = json_pack("{si}", "result", G_ERROR);
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
 int disable_api_key(struct config_elements * config, const char * token_hash) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query;
   int res, ret;
   
@@ -207,7 +197,7 @@ int disable_api_key(struct config_elements * config, const char * token_hash) {
                           token_hash,
                           "gak_enabled",
                           1);
-    res = h_update(config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       ret = G_OK;
@@ -219,5 +209,6 @@ int disable_api_key(struct config_elements * config, const char * token_hash) {
   } else {
     ret = G_ERROR_PARAM;
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return ret;
 }
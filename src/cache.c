@@ -0,0 +1,419 @@
+/**
+ *
+ * Glewlwyd SSO Server
+ *
+ * Authentiation server
+ * Users are authenticated via various backend available: database, ldap
+ * Using various authentication methods available: password, OTP, send code, etc.
+ *
+ * In-memory object cache functions definitions
+ *
+ * Copyright 2016-2021 Nicolas Mora <mail@babelouest.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU GENERAL PUBLIC LICENSE
+ * License as published by the Free Software Foundation;
+ * version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU GENERAL PUBLIC LICENSE for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <ctype.h>
+#include <string.h>
+#include <time.h>
+#include "glewlwyd.h"
+
+/**
+ * Cache entry, chained in its hash bucket and in the LRU list of its shard
+ */
+struct _glwd_cache_entry {
+  char                     * key;
+  uint64_t                   hash;
+  json_t                   * j_value;
+  time_t                     expires_at;
+  struct _glwd_cache_entry * bucket_next;
+  struct _glwd_cache_entry * lru_prev;
+  struct _glwd_cache_entry * lru_next;
+};
+
+/**
+ * FNV-1a hash of the key, case insensitive
+ */
+static uint64_t glewlwyd_cache_hash(const char * key) {
+  uint64_t hash = 14695981039346656037ULL;
+
+  for (; *key; key++) {
+    hash ^= (uint64_t)tolower((unsigned char)*key);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static struct _glwd_cache_shard * glewlwyd_cache_get_shard(struct _glwd_cache * cache, uint64_t hash) {
+  return &cache->shard_list[hash % GLEWLWYD_CACHE_NB_SHARD];
+}
+
+/**
+ * The low bits of the hash select the shard, the next ones the bucket
+ */
+static size_t glewlwyd_cache_bucket_index(struct _glwd_cache_shard * shard, uint64_t hash) {
+  return (size_t)((hash / GLEWLWYD_CACHE_NB_SHARD) % shard->nb_bucket);
+}
+
+static void glewlwyd_cache_lru_unlink(struct _glwd_cache_shard * shard, struct _glwd_cache_entry * entry) {
+  if (entry->lru_prev != NULL) {
+    entry->lru_prev->lru_next = entry->lru_next;
+  } else {
+    shard->lru_head = entry->lru_next;
+  }
+  if (entry->lru_next != NULL) {
+    entry->lru_next->lru_prev = entry->lru_prev;
+  } else {
+    shard->lru_tail = entry->lru_prev;
+  }
+  entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void glewlwyd_cache_lru_push_head(struct _glwd_cache_shard * shard, struct _glwd_cache_entry * entry) {
+  entry->lru_prev = NULL;
+  entry->lru_next = shard->lru_head;
+  if (shard->lru_head != NULL) {
+    shard->lru_head->lru_prev = entry;
+  }
+  shard->lru_head = entry;
+  if (shard->lru_tail == NULL) {
+    shard->lru_tail = entry;
+  }
+}
+
+/**
+ * Removes the entry from its bucket and the LRU list, then frees it
+ * The shard lock must be held by the caller
+ */
+static void glewlwyd_cache_remove_entry(struct _glwd_cache_shard * shard, struct _glwd_cache_entry * entry) {
+  struct _glwd_cache_entry ** cur = &shard->bucket_list[glewlwyd_cache_bucket_index(shard, entry->hash)];
+
+  while (*cur != NULL && *cur != entry) {
+    cur = &(*cur)->bucket_next;
+  }
+  if (*cur != NULL) {
+    *cur = entry->bucket_next;
+  }
+  glewlwyd_cache_lru_unlink(shard, entry);
+  shard->nb_entry--;
+  o_free(entry->key);
+  json_decref(entry->j_value);
+  o_free(entry);
+}
+
+static struct _glwd_cache_entry * glewlwyd_cache_find_entry(struct _glwd_cache_shard * shard, const char * key, uint64_t hash) {
+  struct _glwd_cache_entry * entry;
+
+  for (entry = shard->bucket_list[glewlwyd_cache_bucket_index(shard, hash)]; entry != NULL; entry = entry->bucket_next) {
+    if (entry->hash == hash && 0 == o_strcasecmp(entry->key, key)) {
+      break;
+    }
+  }
+  return entry;
+}
+
+/**
+ * Initialize a cache of max_entries objects, spread among GLEWLWYD_CACHE_NB_SHARD shards
+ * If max_entries or ttl is 0, the cache is disabled
+ */
+int glewlwyd_cache_init(struct _glwd_cache * cache, const char * name, size_t max_entries, unsigned int ttl) {
+  size_t i;
+  int ret = G_OK;
+
+  cache->initialized = 0;
+  cache->shard_list = NULL;
+  if (max_entries && ttl) {
+    cache->name = o_strdup(name);
+    cache->ttl = ttl;
+    cache->max_shard_entries = (max_entries+GLEWLWYD_CACHE_NB_SHARD-1)/GLEWLWYD_CACHE_NB_SHARD;
+    if ((cache->shard_list = o_malloc(GLEWLWYD_CACHE_NB_SHARD*sizeof(struct _glwd_cache_shard))) != NULL) {
+      for (i=0; i<GLEWLWYD_CACHE_NB_SHARD; i++) {
+        memset(&cache->shard_list[i], 0, sizeof(struct _glwd_cache_shard));
+        cache->shard_list[i].nb_bucket = cache->max_shard_entries;
+        if ((cache->shard_list[i].bucket_list = o_malloc(cache->shard_list[i].nb_bucket*sizeof(struct _glwd_cache_entry *))) != NULL) {
+          memset(cache->shard_list[i].bucket_list, 0, cache->shard_list[i].nb_bucket*sizeof(struct _glwd_cache_entry *));
+          if (pthread_mutex_init(&cache->shard_list[i].lock, NULL)) {
+            y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_cache_init - Error pthread_mutex_init for cache %s", name);
+            o_free(cache->shard_list[i].bucket_list);
+            ret = G_ERROR;
+          }
+        } else {
+          y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_cache_init - Error allocating resources for bucket_list in cache %s", name);
+          ret = G_ERROR_MEMORY;
+        }
+        if (ret != G_OK) {
+          while (i--) {
+            pthread_mutex_destroy(&cache->shard_list[i].lock);
+            o_free(cache->shard_list[i].bucket_list);
+          }
+          o_free(cache->shard_list);
+          cache->shard_list = NULL;
+          break;
+        }
+      }
+      if (ret == G_OK) {
+        cache->initialized = 1;
+        y_log_message(Y_LOG_LEVEL_INFO, "Cache %s initialized with %zu entries and ttl %u seconds", name, max_entries, ttl);
+      }
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_cache_init - Error allocating resources for shard_list in cache %s", name);
+      ret = G_ERROR_MEMORY;
+    }
+    if (ret != G_OK) {
+      o_free(cache->name);
+      cache->name = NULL;
+    }
+  }
+  return ret;
+}
+
+void glewlwyd_cache_close(struct _glwd_cache * cache) {
+  size_t i;
+
+  if (cache->initialized) {
+    glewlwyd_cache_clear(cache);
+    for (i=0; i<GLEWLWYD_CACHE_NB_SHARD; i++) {
+      pthread_mutex_destroy(&cache->shard_list[i].lock);
+      o_free(cache->shard_list[i].bucket_list);
+    }
+    o_free(cache->shard_list);
+    o_free(cache->name);
+    cache->shard_list = NULL;
+    cache->name = NULL;
+    cache->initialized = 0;
+  }
+}
+
+/**
+ * Returns a copy of the cached value for the key, or NULL if the key
+ * isn't in the cache or is expired
+ */
+json_t * glewlwyd_cache_get(struct _glwd_cache * cache, const char * key) {
+  struct _glwd_cache_shard * shard;
+  struct _glwd_cache_entry * entry;
+  uint64_t hash;
+  json_t * j_return = NULL;
+
+  if (cache->initialized && !o_strnullempty(key)) {
+    hash = glewlwyd_cache_hash(key);
+    shard = glewlwyd_cache_get_shard(cache, hash);
+    if (!pthread_mutex_lock(&shard->lock)) {
+      if ((entry = glewlwyd_cache_find_entry(shard, key, hash)) != NULL) {
+        if (entry->expires_at > time(NULL)) {
+          glewlwyd_cache_lru_unlink(shard, entry);
+          glewlwyd_cache_lru_push_head(shard, entry);
+          j_return = json_deep_copy(entry->j_value);
+          shard->nb_hit++;
+        } else {
+          glewlwyd_cache_remove_entry(shard, entry);
+          shard->nb_miss++;
+        }
+      } else {
+        shard->nb_miss++;
+      }
+      pthread_mutex_unlock(&shard->lock);
+    }
+  }
+  return j_return;
+}
+
+/**
+ * Returns the generation of the shard of the key, it changes every time an entry of the shard is invalidated
+ * A value read from the backend after this call can be stored with glewlwyd_cache_set_if_generation,
+ * so a value read before a concurrent update isn't stored after its invalidation
+ */
+size_t glewlwyd_cache_get_generation(struct _glwd_cache * cache, const char * key) {
+  struct _glwd_cache_shard * shard;
+  size_t generation = 0;
+
+  if (cache->initialized && !o_strnullempty(key)) {
+    shard = glewlwyd_cache_get_shard(cache, glewlwyd_cache_hash(key));
+    if (!pthread_mutex_lock(&shard->lock)) {
+      generation = shard->generation;
+      pthread_mutex_unlock(&shard->lock);
+    }
+  }
+  return generation;
+}
+
+/**
+ * Stores a copy of j_value for the key, evicting the least recently used
+ * entry of the shard if it is full
+ * If check_generation is set and an entry of the shard was invalidated since generation was read,
+ * the value may be outdated and isn't stored
+ * If ttl is 0, the cache ttl is used
+ */
+static int glewlwyd_cache_set_entry(struct _glwd_cache * cache, const char * key, json_t * j_value, unsigned int ttl, int check_generation, size_t generation) {
+  struct _glwd_cache_shard * shard;
+  struct _glwd_cache_entry * entry;
+  uint64_t hash;
+  int ret;
+
+  if (cache->initialized && !o_strnullempty(key) && j_value != NULL) {
+    hash = glewlwyd_cache_hash(key);
+    shard = glewlwyd_cache_get_shard(cache, hash);
+    if (!pthread_mutex_lock(&shard->lock)) {
+      if (check_generation && shard->generation != generation) {
+        ret = G_ERROR_PARAM;
+      } else {
+        if ((entry = glewlwyd_cache_find_entry(shard, key, hash)) != NULL) {
+          glewlwyd_cache_remove_entry(shard, entry);
+        }
+        while (shard->nb_entry >= cache->max_shard_entries && shard->lru_tail != NULL) {
+          glewlwyd_cache_remove_entry(shard, shard->lru_tail);
+          shard->nb_eviction++;
+        }
+        if ((entry = o_malloc(sizeof(struct _glwd_cache_entry))) != NULL) {
+          entry->key = o_strdup(key);
+          entry->hash = hash;
+          entry->j_value = json_deep_copy(j_value);
+          entry->expires_at = time(NULL) + (time_t)(ttl?ttl:cache->ttl);
+          entry->bucket_next = shard->bucket_list[glewlwyd_cache_bucket_index(shard, hash)];
+          shard->bucket_list[glewlwyd_cache_bucket_index(shard, hash)] = entry;
+          glewlwyd_cache_lru_push_head(shard, entry);
+          shard->nb_entry++;
+          ret = G_OK;
+        } else {
+          y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_cache_set - Error allocating resources for entry in cache %s", cache->name);
+          ret = G_ERROR_MEMORY;
+        }
+      }
+      pthread_mutex_unlock(&shard->lock);
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_cache_set - Error pthread_mutex_lock in cache %s", cache->name);
+      ret = G_ERROR;
+    }
+  } else {
+    ret = G_ERROR_PARAM;
+  }
+  return ret;
+}
+
+/**
+ * Stores a copy of j_value for the key
+ * If ttl is 0, the cache ttl is used
+ */
+int glewlwyd_cache_set(struct _glwd_cache * cache, const char * key, json_t * j_value, unsigned int ttl) {
+  return glewlwyd_cache_set_entry(cache, key, j_value, ttl, 0, 0);
+}
+
+/**
+ * Stores a copy of j_value for the key, unless an entry of the shard was invalidated
+ * since generation was returned by glewlwyd_cache_get_generation
+ * If ttl is 0, the cache ttl is used
+ */
+int glewlwyd_cache_set_if_generation(struct _glwd_cache * cache, const char * key, json_t * j_value, unsigned int ttl, size_t generation) {
+  return glewlwyd_cache_set_entry(cache, key, j_value, ttl, 1, generation);
+}
+
+/**
+ * Removes the key from the cache
+ * The generation of the shard is incremented even if the key isn't in the cache,
+ * so a value read before the removal can't be stored afterwards
+ */
+void glewlwyd_cache_remove(struct _glwd_cache * cache, const char * key) {
+  struct _glwd_cache_shard * shard;
+  struct _glwd_cache_entry * entry;
+  uint64_t hash;
+
+  if (cache->initialized && !o_strnullempty(key)) {
+    hash = glewlwyd_cache_hash(key);
+    shard = glewlwyd_cache_get_shard(cache, hash);
+    if (!pthread_mutex_lock(&shard->lock)) {
+      if ((entry = glewlwyd_cache_find_entry(shard, key, hash)) != NULL) {
+        glewlwyd_cache_remove_entry(shard, entry);
+      }
+      shard->generation++;
+      pthread_mutex_unlock(&shard->lock);
+    }
+  }
+}
+
+/**
+ * Removes all the entries of the cache
+ */
+void glewlwyd_cache_clear(struct _glwd_cache * cache) {
+  size_t i;
+
+  if (cache->initialized) {
+    for (i=0; i<GLEWLWYD_CACHE_NB_SHARD; i++) {
+      if (!pthread_mutex_lock(&cache->shard_list[i].lock)) {
+        while (cache->shard_list[i].lru_head != NULL) {
+          glewlwyd_cache_remove_entry(&cache->shard_list[i], cache->shard_list[i].lru_head);
+        }
+        cache->shard_list[i].generation++;
+        pthread_mutex_unlock(&cache->shard_list[i].lock);
+      }
+    }
+  }
+}
+
+static void glewlwyd_cache_get_stats(struct _glwd_cache * cache, size_t * stats) {
+  size_t i;
+
+  memset(stats, 0, 4*sizeof(size_t));
+  for (i=0; i<GLEWLWYD_CACHE_NB_SHARD; i++) {
+    if (!pthread_mutex_lock(&cache->shard_list[i].lock)) {
+      stats[0] += cache->shard_list[i].nb_entry;
+      stats[1] += cache->shard_list[i].nb_hit;
+      stats[2] += cache->shard_list[i].nb_miss;
+      stats[3] += cache->shard_list[i].nb_eviction;
+      pthread_mutex_unlock(&cache->shard_list[i].lock);
+    }
+  }
+}
+
+/**
+ * Returns the metrics of the enabled caches in prometheus text format
+ */
+char * glewlwyd_cache_metrics(struct config_elements * config) {
+  struct _glwd_cache * cache_list[] = {&config->user_cache, &config->client_cache, &config->geolocation_cache, NULL};
+  const char * metric_list[][3] = {
+    {"glewlwyd_cache_entries", "Number of entries in the cache", "gauge"},
+    {"glewlwyd_cache_hit_total", "Total number of cache hits", "counter"},
+    {"glewlwyd_cache_miss_total", "Total number of cache misses", "counter"},
+    {"glewlwyd_cache_eviction_total", "Total number of entries evicted from the cache", "counter"},
+    {"glewlwyd_cache_hit_ratio", "Ratio of cache hits among the cache lookups", "gauge"}
+  };
+  size_t stats[4], i, j;
+  char * content = NULL, * metric_content[5] = {NULL, NULL, NULL, NULL, NULL};
+
+  for (i=0; cache_list[i] != NULL; i++) {
+    if (cache_list[i]->initialized) {
+      glewlwyd_cache_get_stats(cache_list[i], stats);
+      for (j=0; j<5; j++) {
+        if (metric_content[j] == NULL) {
+          metric_content[j] = msprintf("# HELP %s %s\n# TYPE %s %s\n", metric_list[j][0], metric_list[j][1], metric_list[j][0], metric_list[j][2]);
+        }
+        if (j<4) {
+          metric_content[j] = mstrcatf(metric_content[j], "%s{cache=\"%s\"} %zu\n", metric_list[j][0], cache_list[i]->name, stats[j]);
+        } else {
+          metric_content[j] = mstrcatf(metric_content[j], "%s{cache=\"%s\"} %.4f\n", metric_list[j][0], cache_list[i]->name, (stats[1]+stats[2])?(double)stats[1]/(double)(stats[1]+stats[2]):0.0);
+        }
+      }
+    }
+  }
+  for (j=0; j<5; j++) {
+    if (metric_content[j] != NULL) {
+      if (content == NULL) {
+        content = metric_content[j];
+      } else {
+        content = mstrcatf(content, "%s", metric_content[j]);
+        o_free(metric_content[j]);
+      }
+    }
+  }
+  return content;
+}
@@ -26,10 +26,24 @@
  */
 #include "glewlwyd.h"
 
+struct _client_password_check {
+  struct config_elements        * config;
+  struct _client_module_instance * client_module;
+  const char                    * client_id;
+  const char                    * password;
+};
+
+static int client_module_check_password_task(void * data) {
+  struct _client_password_check * check = (struct _client_password_check *)data;
+
+  return check->client_module->module->client_module_check_password(check->config->config_m, check->client_id, check->password, check->client_module->cls);
+}
+
 json_t * auth_check_client_credentials(struct config_elements * config, const char * client_id, const char * password) {
   int res;
   json_t * j_return = NULL, * j_module_list = get_client_module_list(config), * j_module, * j_client;
   struct _client_module_instance * client_module;
+  struct _client_password_check check = {config, NULL, client_id, password};
   size_t index;
   
   if (check_result_value(j_module_list, G_OK)) {
@@ -40,11 +54,14 @@ json_t * auth_check_client_credentials(struct config_elements * config, const ch
           if (client_module->enabled) {
             j_client = client_module->module->client_module_get(config->config_m, client_id, client_module->cls);
             if (check_result_value(j_client, G_OK)) {
-              res = client_module->module->client_module_check_password(config->config_m, client_id, password, client_module->cls);
+              check.client_module = client_module;
+              res = glewlwyd_password_pool_check(config, &client_module_check_password_task, &check);
               if (res == G_OK) {
                 j_return = json_pack("{si}", "result", G_OK);
               } else if (res == G_ERROR_UNAUTHORIZED) {
                 j_return = json_pack("{si}", "result", G_ERROR_UNAUTHORIZED);
+              } else if (res == G_ERROR_UNAVAILABLE) {
+                j_return = json_pack("{si}", "result", G_ERROR_UNAVAILABLE);
               } else if (res != G_ERROR_NOT_FOUND) {
                 y_log_message(Y_LOG_LEVEL_ERROR, "auth_check_client_credentials - Error, client_module_check_password for module '%s', skip", client_module->name);
 	      }
@@ -69,11 +86,25 @@ json_t * auth_check_client_credentials(struct config_elements * config, const ch
   return j_return;
 }
 
+/**
+ * The client cache stores the result of get_client when the client
+ * is looked up among all the client backends, including not found clients
+ * A client is stored as not found only if all the backends answered not found,
+ * and nothing is stored if the client was invalidated since generation was read
+ */
+static void set_client_cache(struct config_elements * config, const char * client_id, json_t * j_client, int has_error, size_t generation) {
+  if (check_result_value(j_client, G_OK)) {
+    glewlwyd_cache_set_if_generation(&config->client_cache, client_id, j_client, 0, generation);
+  } else if (check_result_value(j_client, G_ERROR_NOT_FOUND) && !has_error && config->client_cache_negative_ttl) {
+    glewlwyd_cache_set_if_generation(&config->client_cache, client_id, j_client, config->client_cache_negative_ttl, generation);
+  }
+}
+
 json_t * get_client(struct config_elements * config, const char * client_id, const char * source) {
-  int found = 0;
+  int found = 0, has_error = 0;
   json_t * j_return = NULL, * j_client, * j_module_list, * j_module;
   struct _client_module_instance * client_module;
-  size_t index;
+  size_t index, generation = glewlwyd_cache_get_generation(&config->client_cache, client_id);
   
   if (o_strnullempty(client_id)) {
     j_return = json_pack("{si}", "result", G_ERROR_PARAM);
@@ -94,7 +125,7 @@ json_t * get_client(struct config_elements * config, const char * client_id, con
     } else {
       j_return = json_pack("{si}", "result", G_ERROR_NOT_FOUND);
     }
-  } else {
+  } else if ((j_return = glewlwyd_cache_get(&config->client_cache, client_id)) == NULL) {
     j_module_list = get_client_module_list(config);
     if (check_result_value(j_module_list, G_OK)) {
       json_array_foreach(json_object_get(j_module_list, "module"), index, j_module) {
@@ -110,11 +141,13 @@ json_t * get_client(struct config_elements * config, const char * client_id, con
               } else if (!check_result_value(j_client, G_ERROR_NOT_FOUND)) {
                 y_log_message(Y_LOG_LEVEL_ERROR, "get_client - Error, client_module_get for module %s", client_module->name);
                 j_return = json_pack("{si}", "result", G_ERROR);
+                has_error = 1;
               }
               json_decref(j_client);
             }
           } else {
             y_log_message(Y_LOG_LEVEL_ERROR, "get_client - Error, client_module_instance %s is NULL", json_string_value(json_object_get(j_module, "name")));
+            has_error = 1;
           }
         }
       }
@@ -123,6 +156,10 @@ json_t * get_client(struct config_elements * config, const char * client_id, con
       j_return = json_pack("{si}", "result", G_ERROR);
     }
     json_decref(j_module_list);
+    if (j_return == NULL) {
+      j_return = json_pack("{si}", "result", G_ERROR_NOT_FOUND);
+    }
+    set_client_cache(config, client_id, j_return, has_error, generation);
   }
   if (j_return == NULL) {
     j_return = json_pack("{si}", "result", G_ERROR_NOT_FOUND);
@@ -318,6 +355,7 @@ int add_client(struct config_elements * config, json_t * j_client, const char *
       ret = G_ERROR;
     }
   }
+  glewlwyd_cache_remove(&config->client_cache, json_string_value(json_object_get(j_client, "client_id")));
   return ret;
 }
 
@@ -379,6 +417,7 @@ int set_client(struct config_elements * config, const char * client_id, json_t *
       ret = G_ERROR;
     }
   }
+  glewlwyd_cache_remove(&config->client_cache, client_id);
   return ret;
 }
 
@@ -443,5 +482,6 @@ int delete_client(struct config_elements * config, const char * client_id, const
       ret = G_ERROR;
     }
   }
+  glewlwyd_cache_remove(&config->client_cache, client_id);
   return ret;
 }
@@ -47,6 +47,24 @@ struct mod_parameters {
   struct config_module * config_glewlwyd;
 };
 
+/**
+ * Checkout a connection from the glewlwyd database pool,
+ * or return the module connection if the module uses its own database
+ */
+static struct _h_connection * database_conn_checkout(struct mod_parameters * param) {
+  if (!param->use_glewlwyd_connection) {
+    return param->config_glewlwyd->glewlwyd_module_callback_db_checkout(param->config_glewlwyd);
+  } else {
+    return param->conn;
+  }
+}
+
+static void database_conn_checkin(struct mod_parameters * param, struct _h_connection * conn) {
+  if (!param->use_glewlwyd_connection) {
+    param->config_glewlwyd->glewlwyd_module_callback_db_checkin(param->config_glewlwyd, conn);
+  }
+}
+
 static json_t * is_client_database_parameters_valid(json_t * j_params) {
   json_t * j_return, * j_error = json_array(), * j_element = NULL;
   const char * field = NULL;
@@ -129,21 +147,24 @@ static json_t * is_client_database_parameters_valid(json_t * j_params) {
 }
 
 static char * get_pattern_clause(struct mod_parameters * param, const char * pattern) {
-  char * escape_pattern = h_escape_string_with_quotes(param->conn, pattern), * clause = NULL;
+  struct _h_connection * conn = database_conn_checkout(param);
+  char * escape_pattern = h_escape_string_with_quotes(conn, pattern), * clause = NULL;
   
   if (escape_pattern != NULL) {
     clause = msprintf("IN (SELECT gc_id from " G_TABLE_CLIENT " WHERE gc_client_id LIKE '%%'||%s||'%%' OR gc_name LIKE '%%'||%s||'%%' OR gc_description LIKE '%%'||%s||'%%')", escape_pattern, escape_pattern, escape_pattern);
   }
   o_free(escape_pattern);
+  database_conn_checkin(param, conn);
   return clause;
 }
 
 static int append_client_properties(struct mod_parameters * param, json_t * j_client, int profile) {
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query, * j_result, * j_element = NULL, * j_param_config, * j_value;
   int res, ret;
   size_t index = 0;
   
-  if (param->conn->type == HOEL_DB_TYPE_MARIADB) {
+  if (conn->type == HOEL_DB_TYPE_MARIADB) {
     j_query = json_pack("{sss[ssss]s{sO}}",
                         "table",
                         G_TABLE_CLIENT_PROPERTY,
@@ -155,7 +176,7 @@ static int append_client_properties(struct mod_parameters * param, json_t * j_cl
                         "where",
                           "gc_id",
                           json_object_get(j_client, "gc_id"));
-    res = h_select(param->conn, j_query, &j_result, NULL);
+    res = h_select(conn, j_query, &j_result, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       json_array_foreach(j_result, index, j_element) {
@@ -247,7 +268,7 @@ static int append_client_properties(struct mod_parameters * param, json_t * j_cl
                         "where",
                           "gc_id",
                           json_object_get(j_client, "gc_id"));
-    res = h_select(param->conn, j_query, &j_result, NULL);
+    res = h_select(conn, j_query, &j_result, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       json_array_foreach(j_result, index, j_element) {
@@ -292,10 +313,12 @@ static int append_client_properties(struct mod_parameters * param, json_t * j_cl
       ret = G_ERROR_DB;
     }
   }
+  database_conn_checkin(param, conn);
   return ret;
 }
 
 static json_t * database_client_scope_get(struct mod_parameters * param, json_int_t gc_id) {
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query, * j_result, * j_return, * j_array, * j_scope = NULL;
   int res;
   size_t index = 0;
@@ -315,7 +338,7 @@ static json_t * database_client_scope_get(struct mod_parameters * param, json_in
                       "order_by",
                       "gcs_id");
   o_free(scope_clause);
-  res = h_select(param->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     j_array = json_array();
@@ -335,16 +358,18 @@ static json_t * database_client_scope_get(struct mod_parameters * param, json_in
     param->config_glewlwyd->glewlwyd_module_callback_metrics_increment_counter(param->config_glewlwyd, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  database_conn_checkin(param, conn);
   return j_return;
 }
 
 static json_t * database_client_get(const char * client_id, void * cls, int profile) {
   struct mod_parameters * param = (struct mod_parameters *)cls;
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query, * j_result, * j_scope, * j_return;
   int res;
   char * client_id_escaped, * client_id_clause;
   
-  client_id_escaped = h_escape_string_with_quotes(param->conn, client_id);
+  client_id_escaped = h_escape_string_with_quotes(conn, client_id);
   client_id_clause = msprintf(" = UPPER(%s)", client_id_escaped);  
   j_query = json_pack("{sss[ssssss]s{s{ssss}}}",
                       "table",
@@ -364,7 +389,7 @@ static json_t * database_client_get(const char * client_id, void * cls, int prof
                           client_id_clause);
   o_free(client_id_escaped);
   o_free(client_id_clause);
-  res = h_select(param->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result) == 1) {
@@ -394,30 +419,32 @@ static json_t * database_client_get(const char * client_id, void * cls, int prof
     param->config_glewlwyd->glewlwyd_module_callback_metrics_increment_counter(param->config_glewlwyd, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     y_log_message(Y_LOG_LEVEL_ERROR, "database_client_get database - Error executing j_query");
   }
+  database_conn_checkin(param, conn);
   return j_return;
 }
 
 static char * get_password_clause_write(struct mod_parameters * param, const char * password) {
+  struct _h_connection * conn = database_conn_checkout(param);
   char * clause = NULL, * password_encoded, digest[1024] = {0};
   
   if (o_strnullempty(password)) {
     clause = o_strdup("''");
-  } else if (param->conn->type == HOEL_DB_TYPE_SQLITE) {
+  } else if (conn->type == HOEL_DB_TYPE_SQLITE) {
     if (generate_digest_pbkdf2(password, param->PBKDF2_iterations, NULL, digest)) {
       clause = msprintf("'%s%c%u'", digest, G_PBKDF2_ITERATOR_SEP, param->PBKDF2_iterations);
     } else {
       y_log_message(Y_LOG_LEVEL_ERROR, "get_password_clause_write database - Error generate_digest_pbkdf2");
     }
-  } else if (param->conn->type == HOEL_DB_TYPE_MARIADB) {
-    password_encoded = h_escape_string_with_quotes(param->conn, password);
+  } else if (conn->type == HOEL_DB_TYPE_MARIADB) {
+    password_encoded = h_escape_string_with_quotes(conn, password);
     if (password_encoded != NULL) {
       clause = msprintf("PASSWORD(%s)", password_encoded);
       o_free(password_encoded);
     } else {
       y_log_message(Y_LOG_LEVEL_ERROR, "get_password_clause_write database - Error h_escape_string_with_quotes (mariadb)");
     }
-  } else if (param->conn->type == HOEL_DB_TYPE_PGSQL) {
-    password_encoded = h_escape_string_with_quotes(param->conn, password);
+  } else if (conn->type == HOEL_DB_TYPE_PGSQL) {
+    password_encoded = h_escape_string_with_quotes(conn, password);
     if (password_encoded != NULL) {
       clause = msprintf("crypt(%s, gen_salt('bf'))", password_encoded);
       o_free(password_encoded);
@@ -425,17 +452,19 @@ static char * get_password_clause_write(struct mod_parameters * param, const cha
       y_log_message(Y_LOG_LEVEL_ERROR, "get_password_clause_write database - Error h_escape_string_with_quotes (postgre)");
     }
   }
+  database_conn_checkin(param, conn);
   return clause;
 }
 
 static char * get_salt_from_password_hash(struct mod_parameters * param, const char * client_id, unsigned int * iterations) {
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query, * j_result;
   int res;
   unsigned char password_b64_decoded[1024] = {0};
   char * salt = NULL, * client_id_escaped, * client_id_clause, * str_iterator;
   size_t password_b64_decoded_len = 0, gc_password_len;
   
-  client_id_escaped = h_escape_string_with_quotes(param->conn, client_id);
+  client_id_escaped = h_escape_string_with_quotes(conn, client_id);
   client_id_clause = msprintf(" = UPPER(%s)", client_id_escaped);
   j_query = json_pack("{sss[s]s{s{ssss}}}",
                       "table",
@@ -450,7 +479,7 @@ static char * get_salt_from_password_hash(struct mod_parameters * param, const c
                           client_id_clause);
   o_free(client_id_clause);
   o_free(client_id_escaped);
-  res = h_select(param->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result) && !json_string_null_or_empty(json_object_get(json_array_get(j_result, 0), "gc_password"))) {
@@ -474,14 +503,16 @@ static char * get_salt_from_password_hash(struct mod_parameters * param, const c
   } else {
     y_log_message(Y_LOG_LEVEL_ERROR, "get_salt_from_password_hash - Error executing j_query");
   }
+  database_conn_checkin(param, conn);
   return salt;
 }
 
 static char * get_password_clause_check(struct mod_parameters * param, const char * client_id, const char * password) {
+  struct _h_connection * conn = database_conn_checkout(param);
   char * clause = NULL, * password_encoded, digest[1024] = {0}, * salt;
   unsigned int iterations = 0;
   
-  if (param->conn->type == HOEL_DB_TYPE_SQLITE) {
+  if (conn->type == HOEL_DB_TYPE_SQLITE) {
     if ((salt = get_salt_from_password_hash(param, client_id, &iterations)) != NULL) {
       if (generate_digest_pbkdf2(password, iterations?iterations:1000, salt, digest)) {
         if (iterations) {
@@ -496,16 +527,16 @@ static char * get_password_clause_check(struct mod_parameters * param, const cha
       y_log_message(Y_LOG_LEVEL_ERROR, "get_password_clause_check database - Error get_salt_from_password_hash");
     }
     o_free(salt);
-  } else if (param->conn->type == HOEL_DB_TYPE_MARIADB) {
-    password_encoded = h_escape_string_with_quotes(param->conn, password);
+  } else if (conn->type == HOEL_DB_TYPE_MARIADB) {
+    password_encoded = h_escape_string_with_quotes(conn, password);
     if (password_encoded != NULL) {
       clause = msprintf(" = PASSWORD(%s)", password_encoded);
       o_free(password_encoded);
     } else {
       y_log_message(Y_LOG_LEVEL_ERROR, "get_password_clause_write database - Error h_escape_string_with_quotes (mariadb)");
     }
-  } else if (param->conn->type == HOEL_DB_TYPE_PGSQL) {
-    password_encoded = h_escape_string_with_quotes(param->conn, password);
+  } else if (conn->type == HOEL_DB_TYPE_PGSQL) {
+    password_encoded = h_escape_string_with_quotes(conn, password);
     if (password_encoded != NULL) {
       clause = msprintf(" = crypt(%s, gc_password)", password_encoded);
       o_free(password_encoded);
@@ -513,10 +544,12 @@ static char * get_password_clause_check(struct mod_parameters * param, const cha
       y_log_message(Y_LOG_LEVEL_ERROR, "get_password_clause_write database - Error h_escape_string_with_quotes (postgre)");
     }
   }
+  database_conn_checkin(param, conn);
   return clause;
 }
 
 static json_t * get_property_value_db(struct mod_parameters * param, const char * name, json_t * j_property, json_int_t gc_id) {
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_value, * j_return;
   char * tmp;
   
@@ -527,7 +560,7 @@ static json_t * get_property_value_db(struct mod_parameters * param, const char
   } else {
     j_value = json_incref(j_property);
   }
-  if (param->conn->type == HOEL_DB_TYPE_MARIADB) {
+  if (conn->type == HOEL_DB_TYPE_MARIADB) {
     if (json_string_length(j_value) < 512) {
       j_return = json_pack("{sIsssOsOsO}", "gc_id", gc_id, "gcp_name", name, "gcp_value_tiny", j_value, "gcp_value_small", json_null(), "gcp_value_medium", json_null());
     } else if (json_string_length(j_value) < 16*1024) {
@@ -542,10 +575,12 @@ static json_t * get_property_value_db(struct mod_parameters * param, const char
     j_return = json_pack("{sIsssO}", "gc_id", gc_id, "gcp_name", name, "gcp_value", j_value);
   }
   json_decref(j_value);
+  database_conn_checkin(param, conn);
   return j_return;
 }
 
 static int save_client_properties(struct mod_parameters * param, json_t * j_client, json_int_t gc_id) {
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_property = NULL, * j_query, * j_array = json_array(), * j_format, * j_property_value = NULL;
   const char * name = NULL;
   int ret, res;
@@ -576,13 +611,13 @@ static int save_client_properties(struct mod_parameters * param, json_t * j_clie
     }
     // Delete old values
     j_query = json_pack("{sss{sI}}", "table", G_TABLE_CLIENT_PROPERTY, "where", "gc_id", gc_id);
-    res = h_delete(param->conn, j_query, NULL);
+    res = h_delete(conn, j_query, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       // Add new values
       if (json_array_size(j_array)) {
         j_query = json_pack("{sssO}", "table", G_TABLE_CLIENT_PROPERTY, "values", j_array);
-        res = h_insert(param->conn, j_query, NULL);
+        res = h_insert(conn, j_query, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           ret = G_OK;
@@ -604,17 +639,19 @@ static int save_client_properties(struct mod_parameters * param, json_t * j_clie
     y_log_message(Y_LOG_LEVEL_ERROR, "insert_client_properties database - Error allocating resources for j_array");
     ret = G_ERROR_MEMORY;
   }
+  database_conn_checkin(param, conn);
   return ret;
 }
 
 static int save_client_scope(struct mod_parameters * param, json_t * j_scope, json_int_t gc_id) {
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query, * j_result, * j_element = NULL, * j_new_scope_id;
   int res, ret;
   char * scope_clause;
   size_t index = 0;
   
   j_query = json_pack("{sss{sI}}", "table", G_TABLE_CLIENT_SCOPE_CLIENT, "where", "gc_id", gc_id);
-  res = h_delete(param->conn, j_query, NULL);
+  res = h_delete(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = G_OK;
@@ -628,7 +665,7 @@ static int save_client_scope(struct mod_parameters * param, json_t * j_scope, js
                             "where",
                               "gcs_name",
                               j_element);
-        res = h_select(param->conn, j_query, &j_result, NULL);
+        res = h_select(conn, j_query, &j_result, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           if (json_array_size(j_result)) {
@@ -640,7 +677,7 @@ static int save_client_scope(struct mod_parameters * param, json_t * j_scope, js
                                   gc_id,
                                   "gcs_id",
                                   json_object_get(json_array_get(j_result, 0), "gcs_id"));
-            res = h_insert(param->conn, j_query, NULL);
+            res = h_insert(conn, j_query, NULL);
             json_decref(j_query);
             if (res != H_OK) {
               y_log_message(Y_LOG_LEVEL_ERROR, "save_client_scope database - Error executing j_query insert scope_client (1)");
@@ -652,10 +689,10 @@ static int save_client_scope(struct mod_parameters * param, json_t * j_scope, js
                                 "values",
                                   "gcs_name",
                                   j_element);
-            res = h_insert(param->conn, j_query, NULL);
+            res = h_insert(conn, j_query, NULL);
             json_decref(j_query);
             if (res == H_OK) {
-              j_new_scope_id = h_last_insert_id(param->conn);
+              j_new_scope_id = h_last_insert_id(conn);
               if (j_new_scope_id != NULL) {
                 j_query = json_pack("{sss{sIsO}}",
                                     "table",
@@ -665,7 +702,7 @@ static int save_client_scope(struct mod_parameters * param, json_t * j_scope, js
                                       gc_id,
                                       "gcs_id",
                                       j_new_scope_id);
-                res = h_insert(param->conn, j_query, NULL);
+                res = h_insert(conn, j_query, NULL);
                 json_decref(j_query);
                 if (res != H_OK) {
                   y_log_message(Y_LOG_LEVEL_ERROR, "save_client_scope database - Error executing j_query insert scope_client (2)");
@@ -696,7 +733,7 @@ static int save_client_scope(struct mod_parameters * param, json_t * j_scope, js
                             "value",
                             scope_clause);
     o_free(scope_clause);
-    res = h_delete(param->conn, j_query, NULL);
+    res = h_delete(conn, j_query, NULL);
     json_decref(j_query);
     if (res != H_OK) {
       y_log_message(Y_LOG_LEVEL_ERROR, "save_client_scope database - Error executing j_query delete empty scopes");
@@ -707,6 +744,7 @@ static int save_client_scope(struct mod_parameters * param, json_t * j_scope, js
     ret = G_ERROR_DB;
   }
   
+  database_conn_checkin(param, conn);
   return ret;
 }
 
@@ -805,6 +843,7 @@ int client_module_close(struct config_module * config, void * cls) {
 size_t client_module_count_total(struct config_module * config, const char * pattern, void * cls) {
   UNUSED(config);
   struct mod_parameters * param = (struct mod_parameters *)cls;
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query, * j_result = NULL;
   int res;
   size_t ret = 0;
@@ -820,7 +859,7 @@ size_t client_module_count_total(struct config_module * config, const char * pat
     json_object_set_new(j_query, "where", json_pack("{s{ssss}}", "gc_id", "operator", "raw", "value", pattern_clause));
     o_free(pattern_clause);
   }
-  res = h_select(param->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = (size_t)json_integer_value(json_object_get(json_array_get(j_result, 0), "total"));
@@ -828,12 +867,14 @@ size_t client_module_count_total(struct config_module * config, const char * pat
   } else {
     y_log_message(Y_LOG_LEVEL_ERROR, "client_module_count_total database - Error executing j_query");
   }
+  database_conn_checkin(param, conn);
   return ret;
 }
 
 json_t * client_module_get_list(struct config_module * config, const char * pattern, size_t offset, size_t limit, void * cls) {
   UNUSED(config);
   struct mod_parameters * param = (struct mod_parameters *)cls;
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query, * j_result, * j_element = NULL, * j_scope, * j_return;
   int res;
   char * pattern_clause;
@@ -860,7 +901,7 @@ json_t * client_module_get_list(struct config_module * config, const char * patt
     json_object_set_new(j_query, "where", json_pack("{s{ssss}}", "gc_id", "operator", "raw", "value", pattern_clause));
     o_free(pattern_clause);
   }
-  res = h_select(param->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     json_array_foreach(j_result, index, j_element) {
@@ -888,6 +929,7 @@ json_t * client_module_get_list(struct config_module * config, const char * patt
     param->config_glewlwyd->glewlwyd_module_callback_metrics_increment_counter(param->config_glewlwyd, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     y_log_message(Y_LOG_LEVEL_ERROR, "client_module_get_list database - Error executing j_query");
   }
+  database_conn_checkin(param, conn);
   return j_return;
 }
 
@@ -899,6 +941,7 @@ json_t * client_module_get(struct config_module * config, const char * client_id
 json_t * client_module_is_valid(struct config_module * config, const char * client_id, json_t * j_client, int mode, void * cls) {
   UNUSED(config);
   struct mod_parameters * param = (struct mod_parameters *)cls;
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_result = json_array(), * j_element, * j_format, * j_value, * j_return = NULL, * j_cur_client;
   char * message, * escaped;
   size_t index = 0;
@@ -906,7 +949,7 @@ json_t * client_module_is_valid(struct config_module * config, const char * clie
   
   if (j_result != NULL) {
     if (mode == GLEWLWYD_IS_VALID_MODE_ADD) {
-      escaped = h_escape_string(param->conn, json_string_value(json_object_get(j_client, "client_id")));
+      escaped = h_escape_string(conn, json_string_value(json_object_get(j_client, "client_id")));
       if (!json_is_string(json_object_get(j_client, "client_id")) || o_strlen(escaped) > 128) {
         json_array_append_new(j_result, json_string("client_id is mandatory and must be a string (maximum 128 characters)"));
       } else {
@@ -938,12 +981,12 @@ json_t * client_module_is_valid(struct config_module * config, const char * clie
     if (mode != GLEWLWYD_IS_VALID_MODE_UPDATE_PROFILE && json_object_get(j_client, "password") != NULL && !json_is_string(json_object_get(j_client, "password"))) {
       json_array_append_new(j_result, json_string("password must be a string"));
     }
-    escaped = h_escape_string(param->conn, json_string_value(json_object_get(j_client, "name")));
+    escaped = h_escape_string(conn, json_string_value(json_object_get(j_client, "name")));
     if (json_object_get(j_client, "name") != NULL && json_object_get(j_client, "name") != json_null() && (!json_is_string(json_object_get(j_client, "name")) || o_strlen(escaped) > 256)) {
       json_array_append_new(j_result, json_string("name must be a string (maximum 256 characters)"));
     }
     o_free(escaped);
-    escaped = h_escape_string(param->conn, json_string_value(json_object_get(j_client, "description")));
+    escaped = h_escape_string(conn, json_string_value(json_object_get(j_client, "description")));
     if (json_object_get(j_client, "description") != NULL && json_object_get(j_client, "description") != json_null() && (!json_is_string(json_object_get(j_client, "description")) || o_strlen(escaped) > 512)) {
       json_array_append_new(j_result, json_string("description must be a string (maximum 512 characters)"));
     }
@@ -964,7 +1007,7 @@ json_t * client_module_is_valid(struct config_module * config, const char * clie
             o_free(message);
           } else {
             json_array_foreach(j_element, index, j_value) {
-              escaped = h_escape_string(param->conn, json_string_value(j_value));
+              escaped = h_escape_string(conn, json_string_value(j_value));
               if ((!json_is_string(j_value) || o_strlen(escaped) > 16*1024*1024) && 0 != o_strcmp("jwks", json_string_value(json_object_get(j_format, "convert")))) {
                 message = msprintf("property '%s' must contain a string value (maximum 16M characters)", property);
                 json_array_append_new(j_result, json_string(message));
@@ -974,7 +1017,7 @@ json_t * client_module_is_valid(struct config_module * config, const char * clie
             }
           }
         } else {
-          escaped = h_escape_string(param->conn, json_string_value(j_element));
+          escaped = h_escape_string(conn, json_string_value(j_element));
           if ((((!json_is_string(j_element) && json_object_get(j_client, "description") != json_null()) || o_strlen(escaped) > 16*1024*1024)) && 0 != o_strcmp("jwks", json_string_value(json_object_get(j_format, "convert")))) {
             message = msprintf("property '%s' must be a string value (maximum 16M characters)", property);
             json_array_append_new(j_result, json_string(message));
@@ -994,12 +1037,14 @@ json_t * client_module_is_valid(struct config_module * config, const char * clie
     y_log_message(Y_LOG_LEVEL_ERROR, "client_module_is_valid database - Error allocating resources for j_result");
     j_return = json_pack("{si}", "result", G_ERROR_MEMORY);
   }
+  database_conn_checkin(param, conn);
   return j_return;
 }
 
 int client_module_add(struct config_module * config, json_t * j_client, void * cls) {
   UNUSED(config);
   struct mod_parameters * param = (struct mod_parameters *)cls;
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query, * j_gc_id;
   int res, ret;
   char * password_clause;
@@ -1028,10 +1073,10 @@ int client_module_add(struct config_module * config, json_t * j_client, void * c
   if (json_object_get(j_client, "confidential") != NULL) {
     json_object_set_new(json_object_get(j_query, "values"), "gc_confidential", json_object_get(j_client, "confidential")==json_false()?json_integer(0):json_integer(1));
   }
-  res = h_insert(param->conn, j_query, NULL);
+  res = h_insert(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
-    j_gc_id = h_last_insert_id(param->conn);
+    j_gc_id = h_last_insert_id(conn);
     if (save_client_properties(param, j_client, json_integer_value(j_gc_id)) != G_OK) {
       y_log_message(Y_LOG_LEVEL_ERROR, "client_module_add database - Error save_client_properties");
       param->config_glewlwyd->glewlwyd_module_callback_metrics_increment_counter(param->config_glewlwyd, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
@@ -1049,23 +1094,25 @@ int client_module_add(struct config_module * config, json_t * j_client, void * c
     param->config_glewlwyd->glewlwyd_module_callback_metrics_increment_counter(param->config_glewlwyd, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  database_conn_checkin(param, conn);
   return ret;
 }
 
 int client_module_update(struct config_module * config, const char * client_id, json_t * j_client, void * cls) {
   UNUSED(config);
   struct mod_parameters * param = (struct mod_parameters *)cls;
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query, * j_result = NULL;
   int res, ret;
   char * password_clause;
   char * client_id_escaped, * client_id_clause;
   
-  client_id_escaped = h_escape_string_with_quotes(param->conn, client_id);
+  client_id_escaped = h_escape_string_with_quotes(conn, client_id);
   client_id_clause = msprintf(" = UPPER(%s)", client_id_escaped);  
   j_query = json_pack("{sss[s]s{s{ssss}}}", "table", G_TABLE_CLIENT, "columns", "gc_id", "where", "UPPER(gc_client_id)", "operator", "raw", "value", client_id_clause);
   o_free(client_id_escaped);
   o_free(client_id_clause);
-  res = h_select(param->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK && json_array_size(j_result)) {
     j_query = json_pack("{sss{}s{sO}}",
@@ -1094,7 +1141,7 @@ int client_module_update(struct config_module * config, const char * client_id,
       json_object_set_new(json_object_get(j_query, "set"), "gc_confidential", json_object_get(j_client, "confidential")==json_false()?json_integer(0):json_integer(1));
     }
     if (json_object_size(json_object_get(j_query, "set"))) {
-      res = h_update(param->conn, j_query, NULL);
+      res = h_update(conn, j_query, NULL);
     } else {
       res = H_OK;
     }
@@ -1120,17 +1167,19 @@ int client_module_update(struct config_module * config, const char * client_id,
     ret = G_ERROR_NOT_FOUND;
   }
   json_decref(j_result);
+  database_conn_checkin(param, conn);
   return ret;
 }
 
 int client_module_delete(struct config_module * config, const char * client_id, void * cls) {
   UNUSED(config);
   struct mod_parameters * param = (struct mod_parameters *)cls;
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query;
   int res, ret;
   char * client_id_escaped, * client_id_clause;
   
-  client_id_escaped = h_escape_string_with_quotes(param->conn, client_id);
+  client_id_escaped = h_escape_string_with_quotes(conn, client_id);
   client_id_clause = msprintf(" = UPPER(%s)", client_id_escaped);  
   j_query = json_pack("{sss{s{ssss}}}",
                       "table",
@@ -1143,7 +1192,7 @@ int client_module_delete(struct config_module * config, const char * client_id,
                           client_id_clause);
   o_free(client_id_escaped);
   o_free(client_id_clause);
-  res = h_delete(param->conn, j_query, NULL);
+  res = h_delete(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = G_OK;
@@ -1152,18 +1201,20 @@ int client_module_delete(struct config_module * config, const char * client_id,
     param->config_glewlwyd->glewlwyd_module_callback_metrics_increment_counter(param->config_glewlwyd, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  database_conn_checkin(param, conn);
   return ret;
 }
 
 int client_module_check_password(struct config_module * config, const char * client_id, const char * password, void * cls) {
   UNUSED(config);
   struct mod_parameters * param = (struct mod_parameters *)cls;
+  struct _h_connection * conn = database_conn_checkout(param);
   int ret, res;
   json_t * j_query, * j_result;
   char * clause = get_password_clause_check(param, client_id, password);
   char * client_id_escaped, * client_id_clause;
   
-  client_id_escaped = h_escape_string_with_quotes(param->conn, client_id);
+  client_id_escaped = h_escape_string_with_quotes(conn, client_id);
   client_id_clause = msprintf(" = UPPER(%s)", client_id_escaped);  
   j_query = json_pack("{sss[s]s{s{ssss}s{ssss}}}",
                       "table",
@@ -1184,7 +1235,7 @@ int client_module_check_password(struct config_module * config, const char * cli
   o_free(client_id_escaped);
   o_free(client_id_clause);
   o_free(clause);
-  res = h_select(param->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result) == 1) {
@@ -1198,5 +1249,6 @@ int client_module_check_password(struct config_module * config, const char * cli
     param->config_glewlwyd->glewlwyd_module_callback_metrics_increment_counter(param->config_glewlwyd, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  database_conn_checkin(param, conn);
   return ret;
 }
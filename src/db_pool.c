@@ -0,0 +1,555 @@
+/**
+ *
+ * Glewlwyd SSO Server
+ *
+ * Authentiation server
+ * Users are authenticated via various backend available: database, ldap
+ * Using various authentication methods available: password, OTP, send code, etc.
+ *
+ * Database connection pool functions definitions
+ *
+ * Copyright 2016-2021 Nicolas Mora <mail@babelouest.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU GENERAL PUBLIC LICENSE
+ * License as published by the Free Software Foundation;
+ * version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU GENERAL PUBLIC LICENSE for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <time.h>
+
+#include "glewlwyd.h"
+
+/**
+ * Connection held by the current thread
+ * depth is the number of nested checkouts not checked in yet
+ */
+struct _glwd_db_pool_thread {
+  size_t index;
+  size_t depth;
+};
+
+static void free_glwd_db_pool_thread(void * data) {
+  o_free(data);
+}
+
+static struct _h_connection * glewlwyd_db_pool_connect(struct _glwd_db_pool * pool) {
+  struct _h_connection * conn = NULL;
+
+  if (pool->type == HOEL_DB_TYPE_SQLITE) {
+    if ((conn = h_connect_sqlite(pool->path)) != NULL) {
+      if (h_execute_query_sqlite(conn, "PRAGMA foreign_keys = ON;") != H_OK) {
+        y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_db_pool_connect - Error executing sqlite3 query 'PRAGMA foreign_keys = ON;'");
+        h_close_db(conn);
+        h_clean_connection(conn);
+        conn = NULL;
+      }
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_db_pool_connect - Error opening sqlite database %s", pool->path);
+    }
+  } else if (pool->type == HOEL_DB_TYPE_MARIADB) {
+    if ((conn = h_connect_mariadb(pool->host, pool->user, pool->password, pool->dbname, pool->port, NULL)) != NULL) {
+      if (h_execute_query_mariadb(conn, "SET sql_mode='PIPES_AS_CONCAT';", NULL) != H_OK) {
+        y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_db_pool_connect - Error executing mariadb query 'SET sql_mode='PIPES_AS_CONCAT';'");
+        h_close_db(conn);
+        h_clean_connection(conn);
+        conn = NULL;
+      }
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_db_pool_connect - Error opening mariadb database %s", pool->dbname);
+    }
+  } else if (pool->type == HOEL_DB_TYPE_PGSQL) {
+    if ((conn = h_connect_pgsql(pool->path)) == NULL) {
+      y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_db_pool_connect - Error opening postgre database");
+    }
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_db_pool_connect - Error database type unknown");
+  }
+  return conn;
+}
+
+/**
+ * Returns the index of the connection with the least logical operations running
+ * pool->lock must be locked
+ */
+static size_t glewlwyd_db_pool_get_least_used(struct _glwd_db_pool * pool) {
+  size_t i, index = 0;
+
+  for (i=1; i<pool->nb_conn && pool->conn_usage[index]; i++) {
+    if (pool->conn_usage[i] < pool->conn_usage[index]) {
+      index = i;
+    }
+  }
+  return index;
+}
+
+/**
+ * Stores the parameters used to open the pool connections
+ */
+int glewlwyd_db_pool_set_parameters(struct _glwd_db_pool * pool, int type, const char * path, const char * host, const char * user, const char * password, const char * dbname, unsigned int port) {
+  int ret;
+
+  if (pool != NULL) {
+    o_free(pool->path);
+    o_free(pool->host);
+    o_free(pool->user);
+    o_free(pool->password);
+    o_free(pool->dbname);
+    pool->type = type;
+    pool->path = o_strdup(path);
+    pool->host = o_strdup(host);
+    pool->user = o_strdup(user);
+    pool->password = o_strdup(password);
+    pool->dbname = o_strdup(dbname);
+    pool->port = port;
+    ret = G_OK;
+  } else {
+    ret = G_ERROR_PARAM;
+  }
+  return ret;
+}
+
+/**
+ * Initialize the database connection pool
+ * config->conn is the first connection of the pool,
+ * the other ones are opened with the parameters stored in config->db_pool
+ */
+int glewlwyd_db_pool_init(struct config_elements * config) {
+  struct _glwd_db_pool * pool = &config->db_pool;
+  pthread_mutexattr_t mutexattr;
+  int ret = G_OK;
+  size_t i;
+
+  if (config->conn != NULL) {
+    if (!pool->size) {
+      pool->size = (pool->type == HOEL_DB_TYPE_SQLITE)?1:GLEWLWYD_DEFAULT_DATABASE_POOL_SIZE;
+    }
+    if (pool->type == HOEL_DB_TYPE_SQLITE && pool->size > 1) {
+      y_log_message(Y_LOG_LEVEL_WARNING, "Database pool size is set to 1 with sqlite3 databases");
+      pool->size = 1;
+    }
+    if ((pool->conn_list = o_malloc(pool->size*sizeof(struct _h_connection *))) != NULL &&
+        (pool->conn_usage = o_malloc(pool->size*sizeof(size_t))) != NULL &&
+        (pool->insert_lock_list = o_malloc(pool->size*sizeof(pthread_mutex_t))) != NULL) {
+      pool->conn_list[0] = config->conn;
+      pool->conn_usage[0] = 0;
+      pool->nb_conn = 1;
+      for (i=1; i<pool->size; i++) {
+        if ((pool->conn_list[i] = glewlwyd_db_pool_connect(pool)) != NULL) {
+          pool->conn_usage[i] = 0;
+          pool->nb_conn++;
+        } else {
+          y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_db_pool_init - Error opening connection %zu", i);
+          ret = G_ERROR_DB;
+          break;
+        }
+      }
+      if (ret == G_OK) {
+        pool->nb_in_use = 0;
+        pool->nb_checkout = 0;
+        pool->nb_wait = 0;
+        pool->nb_shared = 0;
+        pool->wait_usec = 0;
+        // The insert locks are recursive so glewlwyd_db_insert can be called between glewlwyd_db_insert_begin and glewlwyd_db_insert_end
+        pthread_mutexattr_init(&mutexattr);
+        pthread_mutexattr_settype(&mutexattr, PTHREAD_MUTEX_RECURSIVE);
+        for (i=0; ret == G_OK && i<pool->nb_conn; i++) {
+          if (pthread_mutex_init(&pool->insert_lock_list[i], &mutexattr)) {
+            y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_db_pool_init - Error initializing insert lock %zu", i);
+            ret = G_ERROR;
+          }
+        }
+        pthread_mutexattr_destroy(&mutexattr);
+        if (ret == G_OK && !pthread_mutex_init(&pool->lock, NULL) && !pthread_cond_init(&pool->cond, NULL) && !pthread_key_create(&pool->thread_key, free_glwd_db_pool_thread)) {
+          pool->initialized = 1;
+          y_log_message(Y_LOG_LEVEL_INFO, "Database pool initialized with %zu connections", pool->nb_conn);
+        } else {
+          y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_db_pool_init - Error initializing lock, cond or thread key");
+          ret = G_ERROR;
+        }
+      }
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_db_pool_init - Error allocating resources for conn_list, conn_usage or insert_lock_list");
+      ret = G_ERROR_MEMORY;
+    }
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_db_pool_init - Error no database connection");
+    ret = G_ERROR_PARAM;
+  }
+  return ret;
+}
+
+/**
+ * Close the pool connections except config->conn which is closed by the caller
+ */
+void glewlwyd_db_pool_close(struct config_elements * config) {
+  struct _glwd_db_pool * pool = &config->db_pool;
+  size_t i;
+
+  if (pool->initialized) {
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->cond);
+    pthread_key_delete(pool->thread_key);
+    for (i=0; i<pool->nb_conn; i++) {
+      pthread_mutex_destroy(&pool->insert_lock_list[i]);
+    }
+    pool->initialized = 0;
+  }
+  for (i=1; i<pool->nb_conn; i++) {
+    h_close_db(pool->conn_list[i]);
+    h_clean_connection(pool->conn_list[i]);
+  }
+  o_free(pool->conn_list);
+  o_free(pool->conn_usage);
+  o_free(pool->insert_lock_list);
+  pool->conn_list = NULL;
+  pool->conn_usage = NULL;
+  pool->insert_lock_list = NULL;
+  pool->nb_conn = 0;
+  o_free(pool->path);
+  o_free(pool->host);
+  o_free(pool->user);
+  o_free(pool->password);
+  o_free(pool->dbname);
+  pool->path = pool->host = pool->user = pool->password = pool->dbname = NULL;
+}
+
+/**
+ * Checkout a connection from the pool for a logical operation
+ * If the current thread already holds a connection, the same one is returned
+ * If all the connections are busy, waits up to pool->max_wait milliseconds
+ * for a free one, then shares the least used connection and logs a warning
+ * Every checkout must be followed by a glewlwyd_db_pool_checkin
+ */
+struct _h_connection * glewlwyd_db_pool_checkout(struct config_elements * config) {
+  struct _glwd_db_pool * pool = &config->db_pool;
+  struct _glwd_db_pool_thread * thread_data;
+  struct _h_connection * conn = config->conn;
+  struct timespec start, end, deadline;
+  size_t index;
+  int has_waited = 0, is_shared = 0;
+
+  if (pool->initialized) {
+    if ((thread_data = (struct _glwd_db_pool_thread *)pthread_getspecific(pool->thread_key)) == NULL) {
+      if ((thread_data = o_malloc(sizeof(struct _glwd_db_pool_thread))) != NULL) {
+        thread_data->index = 0;
+        thread_data->depth = 0;
+        if (pthread_setspecific(pool->thread_key, thread_data)) {
+          y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_db_pool_checkout - Error pthread_setspecific");
+          o_free(thread_data);
+          thread_data = NULL;
+        }
+      } else {
+        y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_db_pool_checkout - Error allocating resources for thread_data");
+      }
+    }
+    if (thread_data != NULL) {
+      if (thread_data->depth) {
+        thread_data->depth++;
+        conn = pool->conn_list[thread_data->index];
+      } else if (!pthread_mutex_lock(&pool->lock)) {
+        index = glewlwyd_db_pool_get_least_used(pool);
+        if (pool->conn_usage[index] && pool->max_wait) {
+          has_waited = 1;
+          clock_gettime(CLOCK_MONOTONIC, &start);
+          clock_gettime(CLOCK_REALTIME, &deadline);
+          deadline.tv_sec += (time_t)(pool->max_wait/1000);
+          deadline.tv_nsec += (long)(pool->max_wait%1000)*1000000L;
+          if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+          }
+          while (pool->conn_usage[index]) {
+            if (pthread_cond_timedwait(&pool->cond, &pool->lock, &deadline) == ETIMEDOUT) {
+              index = glewlwyd_db_pool_get_least_used(pool);
+              break;
+            }
+            index = glewlwyd_db_pool_get_least_used(pool);
+          }
+          clock_gettime(CLOCK_MONOTONIC, &end);
+          pool->nb_wait++;
+          pool->wait_usec += (unsigned long long)((end.tv_sec-start.tv_sec)*1000000L + (end.tv_nsec-start.tv_nsec)/1000L);
+        }
+        if (pool->conn_usage[index]) {
+          pool->nb_shared++;
+          is_shared = (pool->nb_conn > 1);
+        } else {
+          pool->nb_in_use++;
+        }
+        pool->conn_usage[index]++;
+        pool->nb_checkout++;
+        pthread_mutex_unlock(&pool->lock);
+        thread_data->index = index;
+        thread_data->depth = 1;
+        conn = pool->conn_list[index];
+        if (is_shared) {
+          y_log_message(Y_LOG_LEVEL_WARNING, "Database pool - All %zu connections are busy, sharing connection %zu, consider increasing pool_size or pool_max_wait", pool->nb_conn, index);
+        } else if (has_waited) {
+          y_log_message(Y_LOG_LEVEL_DEBUG, "glewlwyd_db_pool_checkout - Waited for connection %zu", index);
+        }
+      } else {
+        y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_db_pool_checkout - Error lock");
+      }
+    }
+  }
+  return conn;
+}
+
+/**
+ * Checkin a connection previously checked out
+ */
+void glewlwyd_db_pool_checkin(struct config_elements * config, struct _h_connection * conn) {
+  struct _glwd_db_pool * pool = &config->db_pool;
+  struct _glwd_db_pool_thread * thread_data;
+
+  if (pool->initialized && (thread_data = (struct _glwd_db_pool_thread *)pthread_getspecific(pool->thread_key)) != NULL && thread_data->depth) {
+    if (pool->conn_list[thread_data->index] == conn) {
+      thread_data->depth--;
+      if (!thread_data->depth) {
+        if (!pthread_mutex_lock(&pool->lock)) {
+          pool->conn_usage[thread_data->index]--;
+          if (!pool->conn_usage[thread_data->index]) {
+            pool->nb_in_use--;
+            pthread_cond_signal(&pool->cond);
+          }
+          pthread_mutex_unlock(&pool->lock);
+        } else {
+          y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_db_pool_checkin - Error lock");
+        }
+      }
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_db_pool_checkin - Error connection is not the one checked out by this thread");
+    }
+  }
+}
+
+/**
+ * Returns true if conn is one of the pool connections
+ */
+int glewlwyd_db_pool_is_pool_connection(struct config_elements * config, const struct _h_connection * conn) {
+  size_t i;
+  int ret = (conn == config->conn);
+
+  for (i=0; !ret && i<config->db_pool.nb_conn; i++) {
+    ret = (conn == config->db_pool.conn_list[i]);
+  }
+  return ret;
+}
+
+/**
+ * Builds an insert query for a single row with a RETURNING clause,
+ * used with PostgreSQL databases
+ */
+static char * glewlwyd_db_build_insert_returning(const struct _h_connection * conn, const json_t * j_query, const char * id_column) {
+  json_t * j_value = NULL;
+  const char * key = NULL;
+  char * columns = NULL, * values = NULL, * value, * query = NULL;
+  int error = 0;
+
+  json_object_foreach(json_object_get(j_query, "values"), key, j_value) {
+    if (json_is_string(j_value)) {
+      value = h_escape_string_with_quotes(conn, json_string_value(j_value));
+    } else if (json_is_integer(j_value)) {
+      value = msprintf("%" JSON_INTEGER_FORMAT, json_integer_value(j_value));
+    } else if (json_is_real(j_value)) {
+      value = msprintf("%f", json_real_value(j_value));
+    } else if (json_is_true(j_value)) {
+      value = o_strdup("1");
+    } else if (json_is_false(j_value)) {
+      value = o_strdup("0");
+    } else if (json_is_null(j_value)) {
+      value = o_strdup("NULL");
+    } else if (json_is_string(json_object_get(j_value, "raw"))) {
+      value = o_strdup(json_string_value(json_object_get(j_value, "raw")));
+    } else {
+      value = NULL;
+    }
+    if (value == NULL) {
+      y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_db_build_insert_returning - Error value for column %s", key);
+      error = 1;
+      break;
+    }
+    if (columns == NULL) {
+      columns = o_strdup(key);
+      values = value;
+    } else {
+      columns = mstrcatf(columns, ",%s", key);
+      values = mstrcatf(values, ",%s", value);
+      o_free(value);
+    }
+  }
+  if (!error && columns != NULL) {
+    query = msprintf("INSERT INTO %s (%s) VALUES (%s) RETURNING %s", json_string_value(json_object_get(j_query, "table")), columns, values, id_column);
+  }
+  o_free(columns);
+  o_free(values);
+  return query;
+}
+
+/**
+ * Returns the insert lock of the connection, config->insert_lock if conn isn't a pool connection
+ */
+static pthread_mutex_t * glewlwyd_db_get_insert_lock(struct config_elements * config, const struct _h_connection * conn) {
+  pthread_mutex_t * lock = &config->insert_lock;
+  size_t i;
+
+  for (i=0; config->db_pool.initialized && i<config->db_pool.nb_conn; i++) {
+    if (config->db_pool.conn_list[i] == conn) {
+      lock = &config->db_pool.insert_lock_list[i];
+      break;
+    }
+  }
+  return lock;
+}
+
+/**
+ * Inserts a single row and sets the new row id in j_last_id
+ * With PostgreSQL, the id is returned by the insert statement itself,
+ * otherwise the insert and the last insert id are executed under the lock
+ * of the connection, so inserts on other connections aren't serialized
+ */
+int glewlwyd_db_insert(struct config_elements * config, const struct _h_connection * conn, const json_t * j_query, const char * id_column, json_t ** j_last_id) {
+  pthread_mutex_t * lock;
+  json_t * j_result = NULL, * j_id;
+  char * query;
+  int ret;
+
+  *j_last_id = NULL;
+  if (conn->type == HOEL_DB_TYPE_PGSQL && !o_strnullempty(id_column) && json_is_object(json_object_get(j_query, "values"))) {
+    if ((query = glewlwyd_db_build_insert_returning(conn, j_query, id_column)) != NULL) {
+      if ((ret = h_execute_query_json(conn, query, &j_result)) == H_OK) {
+        j_id = json_object_get(json_array_get(j_result, 0), id_column);
+        if (json_is_integer(j_id)) {
+          *j_last_id = json_incref(j_id);
+        } else if (json_is_string(j_id)) {
+          *j_last_id = json_integer(strtoll(json_string_value(j_id), NULL, 10));
+        }
+        json_decref(j_result);
+      }
+      o_free(query);
+    } else {
+      ret = H_ERROR_PARAMS;
+    }
+  } else {
+    lock = glewlwyd_db_get_insert_lock(config, conn);
+    if (!pthread_mutex_lock(lock)) {
+      if ((ret = h_insert(conn, j_query, NULL)) == H_OK) {
+        *j_last_id = h_last_insert_id(conn);
+      }
+      pthread_mutex_unlock(lock);
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_db_insert - Error lock");
+      ret = H_ERROR;
+    }
+  }
+  return ret;
+}
+
+/**
+ * Locks the insert lock of the connection until glewlwyd_db_insert_end
+ * Used around a glewlwyd_db_insert followed by the inserts of its child rows,
+ * so no insert of another thread sharing the connection can run in between
+ * and change the last insert id
+ * With PostgreSQL, the id is returned by the insert statement, nothing is locked
+ */
+void glewlwyd_db_insert_begin(struct config_elements * config, const struct _h_connection * conn) {
+  if (conn->type != HOEL_DB_TYPE_PGSQL && pthread_mutex_lock(glewlwyd_db_get_insert_lock(config, conn))) {
+    y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_db_insert_begin - Error lock");
+  }
+}
+
+/**
+ * Unlocks the insert lock of the connection locked by glewlwyd_db_insert_begin
+ */
+void glewlwyd_db_insert_end(struct config_elements * config, const struct _h_connection * conn) {
+  if (conn->type != HOEL_DB_TYPE_PGSQL) {
+    pthread_mutex_unlock(glewlwyd_db_get_insert_lock(config, conn));
+  }
+}
+
+/**
+ * Returns the pool metrics in prometheus text format
+ */
+char * glewlwyd_db_pool_metrics(struct config_elements * config) {
+  struct _glwd_db_pool * pool = &config->db_pool;
+  char * content = NULL;
+
+  if (pool->initialized && !pthread_mutex_lock(&pool->lock)) {
+    content = msprintf("# HELP glewlwyd_database_pool_size Number of connections in the database pool\n"
+                       "# TYPE glewlwyd_database_pool_size gauge\n"
+                       "glewlwyd_database_pool_size %zu\n"
+                       "# HELP glewlwyd_database_pool_in_use Number of database connections currently checked out\n"
+                       "# TYPE glewlwyd_database_pool_in_use gauge\n"
+                       "glewlwyd_database_pool_in_use %zu\n"
+                       "# HELP glewlwyd_database_pool_checkout_total Total number of database connection checkouts\n"
+                       "# TYPE glewlwyd_database_pool_checkout_total counter\n"
+                       "glewlwyd_database_pool_checkout_total %zu\n"
+                       "# HELP glewlwyd_database_pool_wait_total Total number of checkouts that waited for a free connection\n"
+                       "# TYPE glewlwyd_database_pool_wait_total counter\n"
+                       "glewlwyd_database_pool_wait_total %zu\n"
+                       "# HELP glewlwyd_database_pool_wait_seconds_total Total time spent waiting for a free connection\n"
+                       "# TYPE glewlwyd_database_pool_wait_seconds_total counter\n"
+                       "glewlwyd_database_pool_wait_seconds_total %.6f\n"
+                       "# HELP glewlwyd_database_pool_shared_total Total number of checkouts sharing a busy connection\n"
+                       "# TYPE glewlwyd_database_pool_shared_total counter\n"
+                       "glewlwyd_database_pool_shared_total %zu\n",
+                       pool->nb_conn,
+                       pool->nb_in_use,
+                       pool->nb_checkout,
+                       pool->nb_wait,
+                       (double)pool->wait_usec/1000000.0,
+                       pool->nb_shared);
+    pthread_mutex_unlock(&pool->lock);
+  }
+  return content;
+}
+
+struct _h_connection * glewlwyd_callback_db_checkout(struct config_plugin * config) {
+  return glewlwyd_db_pool_checkout(config->glewlwyd_config);
+}
+
+void glewlwyd_callback_db_checkin(struct config_plugin * config, struct _h_connection * conn) {
+  glewlwyd_db_pool_checkin(config->glewlwyd_config, conn);
+}
+
+struct _h_connection * glewlwyd_module_callback_db_checkout(struct config_module * config) {
+  return glewlwyd_db_pool_checkout(config->glewlwyd_config);
+}
+
+void glewlwyd_module_callback_db_checkin(struct config_module * config, struct _h_connection * conn) {
+  glewlwyd_db_pool_checkin(config->glewlwyd_config, conn);
+}
+
+int glewlwyd_callback_db_insert(struct config_plugin * config, const struct _h_connection * conn, const json_t * j_query, const char * id_column, json_t ** j_last_id) {
+  return glewlwyd_db_insert(config->glewlwyd_config, conn, j_query, id_column, j_last_id);
+}
+
+int glewlwyd_module_callback_db_insert(struct config_module * config, const struct _h_connection * conn, const json_t * j_query, const char * id_column, json_t ** j_last_id) {
+  return glewlwyd_db_insert(config->glewlwyd_config, conn, j_query, id_column, j_last_id);
+}
+
+void glewlwyd_callback_db_insert_begin(struct config_plugin * config, const struct _h_connection * conn) {
+  glewlwyd_db_insert_begin(config->glewlwyd_config, conn);
+}
+
+void glewlwyd_callback_db_insert_end(struct config_plugin * config, const struct _h_connection * conn) {
+  glewlwyd_db_insert_end(config->glewlwyd_config, conn);
+}
+
+void glewlwyd_module_callback_db_insert_begin(struct config_module * config, const struct _h_connection * conn) {
+  glewlwyd_db_insert_begin(config->glewlwyd_config, conn);
+}
+
+void glewlwyd_module_callback_db_insert_end(struct config_module * config, const struct _h_connection * conn) {
+  glewlwyd_db_insert_end(config->glewlwyd_config, conn);
+}
@@ -0,0 +1,467 @@
+/**
+ *
+ * Glewlwyd SSO Server
+ *
+ * Authentiation server
+ * Users are authenticated via various backend available: database, ldap
+ * Using various authentication methods available: password, OTP, send code, etc.
+ *
+ * Offline geolocation database functions definitions
+ *
+ * Copyright 2016-2021 Nicolas Mora <mail@babelouest.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU GENERAL PUBLIC LICENSE
+ * License as published by the Free Software Foundation;
+ * version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU GENERAL PUBLIC LICENSE for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+#include "glewlwyd.h"
+
+#define GEOLOCATION_ADDR_LEN 16
+#define GEOLOCATION_NETWORK_COLUMN "network"
+#define GEOLOCATION_DB_MAX_RETRY_DELAY 300
+
+/**
+ * IP range, addresses are stored as 16 bytes big-endian, IPv4 as IPv4-mapped IPv6
+ * offset and length point to the csv line in the file content
+ */
+struct _glwd_geolocation_range {
+  unsigned char start[GEOLOCATION_ADDR_LEN];
+  unsigned char end[GEOLOCATION_ADDR_LEN];
+  size_t        offset;
+  size_t        length;
+};
+
+/**
+ * Range database loaded from a csv file
+ * The header line contains the column names
+ * The first column is either a network in CIDR notation if its name is 'network'
+ * or the first 2 columns are the start and end addresses of the range
+ */
+struct _glwd_geolocation_db {
+  char                           * path;
+  dev_t                            dev;
+  ino_t                            ino;
+  time_t                           mtime;
+  off_t                            size;
+  time_t                           checked_at;
+  char                           * data;
+  size_t                           data_size;
+  char                          ** column_list;
+  size_t                           nb_column;
+  size_t                           nb_address_column;
+  struct _glwd_geolocation_range * range_list;
+  size_t                           nb_range;
+  unsigned int                     ref;
+};
+
+/**
+ * Returns the csv field at index in the line, unquoted, or NULL if the line has less fields
+ */
+static char * get_csv_field(const char * line, size_t length, size_t index) {
+  size_t i = 0, cur_index = 0, start;
+  int quoted;
+  char * field = NULL, * raw;
+
+  while (i <= length && field == NULL) {
+    quoted = (i < length && line[i] == '"');
+    if (quoted) {
+      i++;
+    }
+    start = i;
+    if (quoted) {
+      while (i < length && (line[i] != '"' || (i+1 < length && line[i+1] == '"'))) {
+        i += (line[i] == '"')?2:1;
+      }
+    } else {
+      while (i < length && line[i] != ',') {
+        i++;
+      }
+    }
+    if (cur_index == index) {
+      if (quoted) {
+        raw = o_strndup(line+start, i-start);
+        field = str_replace(raw, "\"\"", "\"");
+        o_free(raw);
+      } else {
+        field = o_strndup(line+start, i-start);
+      }
+    } else {
+      if (quoted) {
+        while (i < length && line[i] != ',') {
+          i++;
+        }
+      }
+      i++;
+      cur_index++;
+    }
+  }
+  return field;
+}
+
+/**
+ * Parses an IPv4 or IPv6 address, or an IPv4 address in integer form, into a 16 bytes address
+ */
+static int parse_address(const char * str_address, unsigned char * address) {
+  unsigned char addr_v4[sizeof(struct in_addr)];
+  unsigned long int_address;
+  char * endptr = NULL;
+  int ret = G_OK;
+
+  memset(address, 0, GEOLOCATION_ADDR_LEN);
+  if (inet_pton(AF_INET, str_address, addr_v4) == 1) {
+    address[10] = 0xff;
+    address[11] = 0xff;
+    memcpy(address+12, addr_v4, sizeof(struct in_addr));
+  } else if (inet_pton(AF_INET6, str_address, address) == 1) {
+    ret = G_OK;
+  } else if (!o_strnullempty(str_address) && isdigit((unsigned char)str_address[0])) {
+    int_address = strtoul(str_address, &endptr, 10);
+    if (*endptr == '\0' && int_address <= 0xffffffffUL) {
+      address[10] = 0xff;
+      address[11] = 0xff;
+      address[12] = (unsigned char)(int_address >> 24);
+      address[13] = (unsigned char)(int_address >> 16);
+      address[14] = (unsigned char)(int_address >> 8);
+      address[15] = (unsigned char)int_address;
+    } else {
+      ret = G_ERROR_PARAM;
+    }
+  } else {
+    ret = G_ERROR_PARAM;
+  }
+  return ret;
+}
+
+/**
+ * Parses a network in CIDR notation into its first and last addresses
+ */
+static int parse_network(const char * network, unsigned char * start, unsigned char * end) {
+  char * address = NULL, * endptr = NULL;
+  const char * slash = o_strchr(network, '/');
+  long prefix = -1;
+  unsigned int i;
+  int ret = G_OK;
+
+  if (slash != NULL && (address = o_strndup(network, (size_t)(slash-network))) != NULL) {
+    prefix = strtol(slash+1, &endptr, 10);
+    if (*endptr == '\0' && prefix >= 0 && parse_address(address, start) == G_OK) {
+      if (o_strchr(address, ':') == NULL) {
+        prefix += 96;
+      }
+      if (prefix <= 8*GEOLOCATION_ADDR_LEN) {
+        for (i=0; i<GEOLOCATION_ADDR_LEN; i++) {
+          if ((unsigned int)prefix < 8*(i+1)) {
+            start[i] &= (unsigned char)((unsigned int)prefix > 8*i ? 0xff << (8*(i+1)-(unsigned int)prefix) : 0);
+            end[i] = (unsigned char)(start[i] | (unsigned char)~((unsigned int)prefix > 8*i ? 0xff << (8*(i+1)-(unsigned int)prefix) : 0));
+          } else {
+            end[i] = start[i];
+          }
+        }
+      } else {
+        ret = G_ERROR_PARAM;
+      }
+    } else {
+      ret = G_ERROR_PARAM;
+    }
+    o_free(address);
+  } else {
+    ret = G_ERROR_PARAM;
+  }
+  return ret;
+}
+
+static int geolocation_range_compare(const void * a, const void * b) {
+  return memcmp(((const struct _glwd_geolocation_range *)a)->start, ((const struct _glwd_geolocation_range *)b)->start, GEOLOCATION_ADDR_LEN);
+}
+
+static void geolocation_db_free(struct _glwd_geolocation_db * db) {
+  size_t i;
+
+  if (db != NULL) {
+    o_free(db->data);
+    for (i=0; i<db->nb_column; i++) {
+      o_free(db->column_list[i]);
+    }
+    o_free(db->column_list);
+    o_free(db->range_list);
+    o_free(db->path);
+    o_free(db);
+  }
+}
+
+/**
+ * Reads the csv file in memory and builds the range index sorted by start address
+ * The file content is copied, so a file truncated or rewritten after the load can't crash the server,
+ * it's reloaded on the next check
+ */
+static struct _glwd_geolocation_db * geolocation_db_load(const char * path) {
+  struct _glwd_geolocation_db * db = NULL;
+  struct _glwd_geolocation_range * range_list;
+  struct stat st;
+  size_t offset, length, line_length, nb_range_alloc = 0;
+  ssize_t read_length = 0;
+  char * field_start, * field_end, * eol;
+  int fd, ret = G_OK;
+
+  if ((fd = open(path, O_RDONLY)) >= 0) {
+    if (!fstat(fd, &st) && st.st_size > 0) {
+      if ((db = o_malloc(sizeof(struct _glwd_geolocation_db))) != NULL) {
+        memset(db, 0, sizeof(struct _glwd_geolocation_db));
+        db->path = o_strdup(path);
+        db->dev = st.st_dev;
+        db->ino = st.st_ino;
+        db->mtime = st.st_mtime;
+        db->size = st.st_size;
+        db->checked_at = time(NULL);
+        db->data_size = (size_t)st.st_size;
+        db->ref = 1;
+        if ((db->data = o_malloc(db->data_size)) != NULL) {
+          offset = 0;
+          while (offset < db->data_size && (read_length = read(fd, db->data+offset, db->data_size-offset)) > 0) {
+            offset += (size_t)read_length;
+          }
+          if (offset != db->data_size) {
+            y_log_message(Y_LOG_LEVEL_ERROR, "geolocation_db_load - Error read %s, file truncated while loading", path);
+            ret = G_ERROR;
+          }
+        } else {
+          y_log_message(Y_LOG_LEVEL_ERROR, "geolocation_db_load - Error allocating resources for data");
+          ret = G_ERROR_MEMORY;
+        }
+        if (ret == G_OK) {
+          // Header line
+          eol = memchr(db->data, '\n', db->data_size);
+          length = (eol!=NULL?(size_t)(eol-db->data):db->data_size);
+          while ((field_start = get_csv_field(db->data, length, db->nb_column)) != NULL) {
+            db->column_list = o_realloc(db->column_list, (db->nb_column+1)*sizeof(char *));
+            db->column_list[db->nb_column] = o_strdup(trimwhitespace(field_start));
+            o_free(field_start);
+            db->nb_column++;
+          }
+          db->nb_address_column = (db->nb_column && 0 == o_strcmp(GEOLOCATION_NETWORK_COLUMN, db->column_list[0]))?1:2;
+          if (db->nb_column > db->nb_address_column) {
+            // Range lines
+            for (offset = length+1; offset < db->data_size; offset += length+1) {
+              eol = memchr(db->data+offset, '\n', db->data_size-offset);
+              length = (eol!=NULL?(size_t)(eol-(db->data+offset)):db->data_size-offset);
+              line_length = length;
+              if (line_length && db->data[offset+line_length-1] == '\r') {
+                line_length--;
+              }
+              if (!line_length || db->data[offset] == '#') {
+                continue;
+              }
+              if (db->nb_range == nb_range_alloc) {
+                nb_range_alloc = nb_range_alloc?2*nb_range_alloc:1024;
+                if ((range_list = o_realloc(db->range_list, nb_range_alloc*sizeof(struct _glwd_geolocation_range))) != NULL) {
+                  db->range_list = range_list;
+                } else {
+                  y_log_message(Y_LOG_LEVEL_ERROR, "geolocation_db_load - Error allocating resources for range_list");
+                  ret = G_ERROR_MEMORY;
+                  break;
+                }
+              }
+              field_start = get_csv_field(db->data+offset, line_length, 0);
+              field_end = db->nb_address_column==2?get_csv_field(db->data+offset, line_length, 1):NULL;
+              if ((db->nb_address_column == 1 && parse_network(field_start, db->range_list[db->nb_range].start, db->range_list[db->nb_range].end) == G_OK) ||
+                  (db->nb_address_column == 2 && parse_address(field_start, db->range_list[db->nb_range].start) == G_OK && parse_address(field_end, db->range_list[db->nb_range].end) == G_OK)) {
+                db->range_list[db->nb_range].offset = offset;
+                db->range_list[db->nb_range].length = line_length;
+                db->nb_range++;
+              } else {
+                y_log_message(Y_LOG_LEVEL_DEBUG, "geolocation_db_load - Invalid range at offset %zu in %s", offset, path);
+              }
+              o_free(field_start);
+              o_free(field_end);
+            }
+            if (ret == G_OK) {
+              qsort(db->range_list, db->nb_range, sizeof(struct _glwd_geolocation_range), &geolocation_range_compare);
+              y_log_message(Y_LOG_LEVEL_INFO, "Geolocation database %s loaded, %zu ranges", path, db->nb_range);
+            }
+          } else {
+            y_log_message(Y_LOG_LEVEL_ERROR, "geolocation_db_load - Invalid header in %s", path);
+            ret = G_ERROR_PARAM;
+          }
+        }
+        if (ret != G_OK) {
+          geolocation_db_free(db);
+          db = NULL;
+        }
+      } else {
+        y_log_message(Y_LOG_LEVEL_ERROR, "geolocation_db_load - Error allocating resources for db");
+      }
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "geolocation_db_load - Error fstat or empty file %s", path);
+    }
+    close(fd);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "geolocation_db_load - Error opening %s", path);
+  }
+  return db;
+}
+
+static void geolocation_db_release(struct config_elements * config, struct _glwd_geolocation_db * db) {
+  int to_free = 0;
+
+  if (db != NULL && !pthread_mutex_lock(&config->geolocation_config_lock)) {
+    to_free = !(--db->ref);
+    pthread_mutex_unlock(&config->geolocation_config_lock);
+  }
+  if (to_free) {
+    geolocation_db_free(db);
+  }
+}
+
+/**
+ * Returns the database for the file path, a reference is taken on it
+ * The file is checked at most once per second and reloaded if it has changed
+ * Only one thread loads the file at a time, the other ones use the current database,
+ * or none if no database is loaded, until the load is complete
+ * After a failed load, the next one is delayed, up to GEOLOCATION_DB_MAX_RETRY_DELAY seconds
+ */
+static struct _glwd_geolocation_db * geolocation_db_get(struct config_elements * config, const char * path) {
+  struct _glwd_geolocation_db * db = NULL, * new_db = NULL, * old_db = NULL;
+  struct stat st;
+  time_t now = time(NULL), delay;
+  int check = 0, loaded = 0;
+
+  if (!pthread_mutex_lock(&config->geolocation_config_lock)) {
+    if (config->geolocation_db != NULL && 0 == o_strcmp(config->geolocation_db->path, path)) {
+      db = config->geolocation_db;
+      db->ref++;
+      if (db->checked_at != now && !config->geolocation_db_loading && now >= config->geolocation_db_retry_at) {
+        db->checked_at = now;
+        check = 1;
+      }
+    } else if (!config->geolocation_db_loading && now >= config->geolocation_db_retry_at) {
+      check = 1;
+    }
+    config->geolocation_db_loading |= check;
+    pthread_mutex_unlock(&config->geolocation_config_lock);
+  }
+  if (check) {
+    if (!stat(path, &st)) {
+      if (db == NULL || db->dev != st.st_dev || db->ino != st.st_ino || db->mtime != st.st_mtime || db->size != st.st_size) {
+        new_db = geolocation_db_load(path);
+      } else {
+        loaded = 1;
+      }
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "geolocation_db_get - Error stat %s", path);
+    }
+    if (!pthread_mutex_lock(&config->geolocation_config_lock)) {
+      if (new_db != NULL) {
+        old_db = config->geolocation_db;
+        config->geolocation_db = new_db;
+        new_db->ref++;
+        loaded = 1;
+      }
+      if (loaded) {
+        config->geolocation_db_nb_failure = 0;
+        config->geolocation_db_retry_at = 0;
+      } else {
+        if (config->geolocation_db_nb_failure < 16) {
+          config->geolocation_db_nb_failure++;
+        }
+        delay = (time_t)1<<config->geolocation_db_nb_failure;
+        config->geolocation_db_retry_at = now + (delay<GEOLOCATION_DB_MAX_RETRY_DELAY?delay:GEOLOCATION_DB_MAX_RETRY_DELAY);
+      }
+      config->geolocation_db_loading = 0;
+      pthread_mutex_unlock(&config->geolocation_config_lock);
+      if (new_db != NULL) {
+        geolocation_db_release(config, old_db);
+        geolocation_db_release(config, db);
+        db = new_db;
+      }
+    } else {
+      geolocation_db_free(new_db);
+    }
+  }
+  return db;
+}
+
+/**
+ * Returns the output properties of the range containing ip_address, separated by ' - '
+ */
+char * glewlwyd_geolocation_db_lookup(struct config_elements * config, const char * path, const char * ip_address, const char * output_properties) {
+  struct _glwd_geolocation_db * db;
+  struct _glwd_geolocation_range * range = NULL;
+  unsigned char address[GEOLOCATION_ADDR_LEN];
+  char ** properties = NULL, * data = NULL, * value;
+  size_t low, high, mid, i, j;
+
+  if (parse_address(ip_address, address) == G_OK) {
+    if ((db = geolocation_db_get(config, path)) != NULL) {
+      // Find the last range whose start is lower or equal than address
+      low = 0;
+      high = db->nb_range;
+      while (low < high) {
+        mid = low + (high-low)/2;
+        if (memcmp(db->range_list[mid].start, address, GEOLOCATION_ADDR_LEN) <= 0) {
+          low = mid+1;
+        } else {
+          high = mid;
+        }
+      }
+      if (low && memcmp(address, db->range_list[low-1].end, GEOLOCATION_ADDR_LEN) <= 0) {
+        range = &db->range_list[low-1];
+      }
+      if (range != NULL && split_string(output_properties, ",", &properties)) {
+        for (i=0; properties[i]!=NULL; i++) {
+          for (j=db->nb_address_column; j<db->nb_column; j++) {
+            if (0 == o_strcmp(db->column_list[j], trimwhitespace(properties[i]))) {
+              value = get_csv_field(db->data+range->offset, range->length, j);
+              if (data == NULL) {
+                data = o_strdup(value);
+              } else {
+                data = mstrcatf(data, " - %s", value);
+              }
+              o_free(value);
+              break;
+            }
+          }
+        }
+      }
+      free_string_array(properties);
+      geolocation_db_release(config, db);
+    }
+  } else {
+    y_log_message(Y_LOG_LEVEL_DEBUG, "glewlwyd_geolocation_db_lookup - Invalid address %s", ip_address);
+  }
+  return data;
+}
+
+/**
+ * Releases the loaded database, it will be freed when the last lookup using it is complete
+ */
+void glewlwyd_geolocation_db_close(struct config_elements * config) {
+  struct _glwd_geolocation_db * db = NULL;
+
+  if (!pthread_mutex_lock(&config->geolocation_config_lock)) {
+    db = config->geolocation_db;
+    config->geolocation_db = NULL;
+    config->geolocation_db_nb_failure = 0;
+    config->geolocation_db_retry_at = 0;
+    pthread_mutex_unlock(&config->geolocation_config_lock);
+  }
+  geolocation_db_release(config, db);
+}
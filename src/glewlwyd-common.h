@@ -57,6 +57,9 @@
 #define G_ERROR_DB           4
 #define G_ERROR_MEMORY       5
 #define G_ERROR_NOT_FOUND    6
+#define G_ERROR_UNAVAILABLE  7
+
+#define GLEWLWYD_PASSWORD_POOL_RETRY_AFTER "1"
 
 /**
  * Callback priority
@@ -102,7 +105,13 @@
 
 #define GLEWLWYD_DEFAULT_SALT_LENGTH 16
 
+#define GLEWLWYD_HASH_BUFFER_SIZE 128
+#define GLEWLWYD_HASH_NB_ALG      6
+
 #define G_PBKDF2_ITERATOR_DEFAULT 150000
+#define GLEWLWYD_PBKDF2_MAX_LANES 16
+// A multi-buffer batch costs as much as a full batch, below lanes/GLEWLWYD_PBKDF2_MULTI_MIN_RATIO digests one at a time are faster
+#define GLEWLWYD_PBKDF2_MULTI_MIN_RATIO 2
 
 #define SWITCH_DB_TYPE(T, M, S, P) \
         ((T)==HOEL_DB_TYPE_MARIADB?\
@@ -317,22 +326,225 @@ struct _plugin_module_instance {
 #define GLWD_METRICS_AUTH_USER_INVALID        "glewlwyd_auth_user_invalid"
 #define GLWD_METRICS_AUTH_USER_INVALID_SCHEME "glewlwyd_auth_user_invalid_scheme"
 #define GLWD_METRICS_DATABSE_ERROR            "glewlwyd_database_error"
+#define GLWD_METRICS_HTTP_REQUEST_DURATION    "glewlwyd_http_request_duration_seconds"
+#define GLWD_METRICS_HTTP_REQUEST_IN_FLIGHT   "glewlwyd_http_requests_in_flight"
+
+#define GLWD_METRICS_TYPE_COUNTER   0
+#define GLWD_METRICS_TYPE_GAUGE     1
+#define GLWD_METRICS_TYPE_HISTOGRAM 2
+
+#define GLEWLWYD_METRICS_NB_SHARD  16
+#define GLEWLWYD_METRICS_NB_BUCKET 256
+#define GLEWLWYD_METRICS_CACHE_LINE 64
+
+/**
+ * Counter shard, padded to its own cache line
+ */
+struct _glwd_metrics_shard {
+  size_t counter;
+  char   padding[GLEWLWYD_METRICS_CACHE_LINE - sizeof(size_t)];
+};
 
 /**
  * Structure used to store a prometheus metrics
+ * A metrics data is a counter for a metric name and a label value,
+ * it's never freed before glewlwyd_metrics_close
+ * A gauge uses the counter shards with a wrapping arithmetic,
+ * a histogram uses them for the number of observations
  */
 struct _glwd_metrics_data {
-  char * label;
-  size_t counter;
+  struct _glwd_metrics_shard  shard_list[GLEWLWYD_METRICS_NB_SHARD];
+  size_t                    * bucket_counter_list;
+  size_t                      sum;
+  struct _glwd_metric       * metric;
+  char                      * label;
+  unsigned long               hash;
+  struct _glwd_metrics_data * bucket_next;
+  struct _glwd_metrics_data * metric_next;
 };
 
 struct _glwd_metric {
   char                      * name;
   char                      * help;
+  unsigned short              type;
+  double                    * bucket_list;
+  size_t                      bucket_size;
   struct _glwd_metrics_data * data;
+  struct _glwd_metrics_data * data_last;
   size_t                      data_size;
 };
 
+/**
+ * Structure used to store the database connection pool
+ * A connection is checked out for a logical operation (a set of queries
+ * that must run on the same connection, e.g. insert then last insert id)
+ * and checked in afterwards. Nested checkouts in the same thread
+ * return the connection already held by the thread
+ */
+struct _glwd_db_pool {
+  unsigned int             size;
+  unsigned int             max_wait;
+  int                      type;
+  char                   * path;
+  char                   * host;
+  char                   * user;
+  char                   * password;
+  char                   * dbname;
+  unsigned int             port;
+  struct _h_connection  ** conn_list;
+  size_t                 * conn_usage;
+  pthread_mutex_t        * insert_lock_list;
+  size_t                   nb_conn;
+  size_t                   nb_in_use;
+  size_t                   nb_checkout;
+  size_t                   nb_wait;
+  size_t                   nb_shared;
+  unsigned long long       wait_usec;
+  pthread_mutex_t          lock;
+  pthread_cond_t           cond;
+  pthread_key_t            thread_key;
+  unsigned short           initialized;
+};
+
+#define GLEWLWYD_CACHE_NB_SHARD 16
+
+/**
+ * Shard of an in-memory cache, with its own lock, hash buckets and LRU list
+ */
+struct _glwd_cache_shard {
+  pthread_mutex_t            lock;
+  struct _glwd_cache_entry ** bucket_list;
+  size_t                     nb_bucket;
+  struct _glwd_cache_entry * lru_head;
+  struct _glwd_cache_entry * lru_tail;
+  size_t                     nb_entry;
+  size_t                     nb_hit;
+  size_t                     nb_miss;
+  size_t                     nb_eviction;
+  size_t                     generation;
+};
+
+/**
+ * Bounded in-memory cache of json objects with a TTL,
+ * the keys are case insensitive
+ */
+struct _glwd_cache {
+  char                     * name;
+  unsigned int               ttl;
+  size_t                     max_shard_entries;
+  struct _glwd_cache_shard * shard_list;
+  unsigned short             initialized;
+};
+
+#define GLEWLWYD_REPLAY_CACHE_NB_SHARD  16
+#define GLEWLWYD_REPLAY_CACHE_NB_BUCKET 1024
+#define GLEWLWYD_REPLAY_CACHE_NB_SLOT   64
+#define GLEWLWYD_REPLAY_CACHE_KEY_SIZE  32
+
+/**
+ * Shard of a replay cache, with its own lock, hash buckets and expiration slots
+ */
+struct _glwd_replay_cache_shard {
+  pthread_mutex_t                    lock;
+  struct _glwd_replay_cache_entry ** bucket_list;
+  size_t                             nb_bucket;
+  struct _glwd_replay_cache_entry ** slot_list;
+  size_t                             nb_entry;
+  time_t                             swept_slot;
+};
+
+/**
+ * In-memory set of identifiers already used, i.e. jti claims,
+ * each identifier is kept until its expiration, at most max_lifetime seconds
+ * The entries are grouped by expiration time in slots of slot_duration seconds,
+ * so the expired entries are removed a slot at a time
+ */
+struct _glwd_replay_cache {
+  struct _glwd_replay_cache_shard * shard_list;
+  time_t                            max_lifetime;
+  time_t                            slot_duration;
+  size_t                            nb_slot;
+  unsigned short                    initialized;
+};
+
+#define GLEWLWYD_JOB_TYPE_MAIL         0
+#define GLEWLWYD_JOB_TYPE_GEOLOCATION  1
+#define GLEWLWYD_JOB_TYPE_NOTIFICATION 2
+#define GLEWLWYD_JOB_TYPE_DATABASE     3
+#define GLEWLWYD_JOB_NB_TYPE           4
+
+#define GLEWLWYD_JOB_OVERFLOW_DROP     0
+#define GLEWLWYD_JOB_OVERFLOW_COALESCE 1
+
+/**
+ * Deletes the expired rows of the tables registered by the core and the plugins,
+ * by batches of batch_size rows every interval seconds
+ */
+struct _glwd_purge {
+  unsigned int               interval;
+  unsigned int               retention;
+  size_t                     batch_size;
+  unsigned int               batch_delay;
+  struct _glwd_purge_task ** task_list;
+  size_t                     nb_task;
+  pthread_t                  thread;
+  pthread_mutex_t            lock;
+  pthread_cond_t             cond;
+  unsigned short             stop;
+  unsigned short             initialized;
+};
+
+/**
+ * Bounded queue of background jobs run by a fixed number of worker threads,
+ * max_running limits the number of jobs of each type running at the same time
+ */
+struct _glwd_job_queue {
+  unsigned int               nb_worker;
+  size_t                     max_size;
+  unsigned short             overflow;
+  unsigned int               max_running[GLEWLWYD_JOB_NB_TYPE];
+  unsigned int               nb_running[GLEWLWYD_JOB_NB_TYPE];
+  size_t                     nb_queued[GLEWLWYD_JOB_NB_TYPE];
+  size_t                     nb_done[GLEWLWYD_JOB_NB_TYPE];
+  size_t                     nb_dropped[GLEWLWYD_JOB_NB_TYPE];
+  size_t                     nb_coalesced[GLEWLWYD_JOB_NB_TYPE];
+  unsigned long long         wait_usec[GLEWLWYD_JOB_NB_TYPE];
+  struct _glwd_job         * head;
+  struct _glwd_job         * tail;
+  struct _glwd_job         * running_head;
+  size_t                     size;
+  pthread_t                * worker_list;
+  unsigned int               nb_started;
+  pthread_mutex_t            lock;
+  pthread_cond_t             cond;
+  unsigned short             stop;
+  unsigned short             initialized;
+};
+
+/**
+ * Queue of password checks run by a fixed number of worker threads,
+ * at most max_size checks can wait in the queue
+ */
+struct _glwd_password_pool {
+  unsigned int                 nb_worker;
+  size_t                       max_size;
+  struct _glwd_password_task * head;
+  struct _glwd_password_task * tail;
+  size_t                       size;
+  unsigned int                 nb_running;
+  unsigned int                 nb_helper;
+  unsigned int                 nb_waiting;
+  size_t                       nb_done;
+  size_t                       nb_rejected;
+  unsigned long long           wait_usec;
+  pthread_t                  * worker_list;
+  unsigned int                 nb_started;
+  pthread_mutex_t              lock;
+  pthread_cond_t               cond;
+  unsigned short               stop;
+  unsigned short               initialized;
+};
+
 /**
  * Structure used to store the global application config
  */
@@ -342,6 +554,10 @@ struct config_elements {
   size_t                                         max_post_size;
   int                                            allow_gzip;
   int                                            allow_deflate;
+  int                                            allow_zstd;
+  int                                            allow_brotli;
+  int                                            compression_level;
+  size_t                                         compression_min_size;
   char *                                         bind_address;
   char *                                         bind_address_metrics;
   char *                                         external_url;
@@ -372,6 +588,30 @@ struct config_elements {
   char *                                         secure_connection_pem_file;
   char *                                         secure_connection_ca_file;
   struct _h_connection *                         conn;
+  struct _glwd_db_pool                           db_pool;
+  size_t                                         user_cache_size;
+  unsigned int                                   user_cache_ttl;
+  struct _glwd_cache                             user_cache;
+  size_t                                         client_cache_size;
+  unsigned int                                   client_cache_ttl;
+  unsigned int                                   client_cache_negative_ttl;
+  struct _glwd_cache                             client_cache;
+  size_t                                         geolocation_cache_size;
+  unsigned int                                   geolocation_cache_ttl;
+  unsigned int                                   geolocation_cache_negative_ttl;
+  unsigned int                                   geolocation_cache_prefix_ipv4;
+  unsigned int                                   geolocation_cache_prefix_ipv6;
+  struct _glwd_cache                             geolocation_cache;
+  pthread_mutex_t                                geolocation_config_lock;
+  json_t *                                       j_geolocation_config;
+  size_t                                         geolocation_config_generation;
+  struct _glwd_geolocation_db *                  geolocation_db;
+  int                                            geolocation_db_loading;
+  time_t                                         geolocation_db_retry_at;
+  unsigned int                                   geolocation_db_nb_failure;
+  struct _glwd_job_queue                         job_queue;
+  struct _glwd_password_pool                     password_pool;
+  struct _glwd_purge                             purge;
   struct _u_instance *                           instance;
   unsigned int                                   instance_initialized;
   struct _u_instance *                           instance_metrics;
@@ -383,15 +623,21 @@ struct config_elements {
   char *                                         login_url;
   unsigned int                                   delete_profile;
   pthread_mutex_t                                module_lock;
+  pthread_mutex_t                                module_snapshot_lock;
   char *                                         user_module_path;
   struct _pointer_list *                         user_module_list;
   struct _pointer_list *                         user_module_instance_list;
+  json_t *                                       j_user_module_snapshot;
   char *                                         user_middleware_module_path;
   struct _pointer_list *                         user_middleware_module_list;
   struct _pointer_list *                         user_middleware_module_instance_list;
   char *                                         client_module_path;
   struct _pointer_list *                         client_module_list;
   struct _pointer_list *                         client_module_instance_list;
+  json_t *                                       j_client_module_snapshot;
+  pthread_mutex_t                                scope_graph_lock;
+  pthread_mutex_t                                scope_graph_update_lock;
+  json_t *                                       j_scope_graph;
   char *                                         user_auth_scheme_module_path;
   struct _pointer_list *                         user_auth_scheme_module_list;
   struct _pointer_list *                         user_auth_scheme_module_instance_list;
@@ -405,6 +651,10 @@ struct config_elements {
   unsigned short                                 metrics_endpoint_admin_session;
   pthread_mutex_t                                metrics_lock;
   struct _pointer_list                           metrics_list;
+  struct _glwd_metrics_data *                    metrics_bucket_list[GLEWLWYD_METRICS_NB_BUCKET];
+  struct _pointer_list                           metrics_timed_endpoint_list;
+  double *                                       metrics_latency_bucket_list;
+  size_t                                         metrics_latency_bucket_size;
   pthread_mutex_t                                insert_lock;
 };
 
@@ -461,7 +711,23 @@ struct config_plugin {
   char   * (* glewlwyd_callback_get_plugin_external_url)(struct config_plugin * config, const char * name);
   char   * (* glewlwyd_callback_get_login_url)(struct config_plugin * config, const char * client_id, const char * scope_list, const char * callback_url, struct _u_map * additional_parameters);
   char   * (* glewlwyd_callback_generate_hash)(struct config_plugin * config, const char * data);
+  int      (* glewlwyd_callback_generate_hash_buffer)(struct config_plugin * config, const char * data, char * out_hash, size_t out_hash_size);
   void     (* glewlwyd_callback_update_issued_for)(struct config_plugin * config, const struct _h_connection * conn, const char * sql_table, const char * issued_for_column, const char * issued_for_value, const char * id_column, json_int_t id_value);
+
+  // Database connection pool functions
+  struct _h_connection * (* glewlwyd_callback_db_checkout)(struct config_plugin * config);
+  void                   (* glewlwyd_callback_db_checkin)(struct config_plugin * config, struct _h_connection * conn);
+  int                    (* glewlwyd_callback_db_insert)(struct config_plugin * config, const struct _h_connection * conn, const json_t * j_query, const char * id_column, json_t ** j_last_id);
+  void                   (* glewlwyd_callback_db_insert_begin)(struct config_plugin * config, const struct _h_connection * conn);
+  void                   (* glewlwyd_callback_db_insert_end)(struct config_plugin * config, const struct _h_connection * conn);
+
+  // Background jobs functions
+  int      (* glewlwyd_callback_job_submit)(struct config_plugin * config, unsigned int type, const char * key, void * owner, void (* run)(void * data), void (* cancel)(void * data), void * data);
+  void     (* glewlwyd_callback_job_cancel)(struct config_plugin * config, void * owner);
+
+  // Expired rows purge functions
+  int      (* glewlwyd_callback_purge_add_task)(struct config_plugin * config, const char * name, const char * table, const char * id_column, const char * plugin_column, const char * date_column, unsigned int extra_retention, const char * condition);
+  void     (* glewlwyd_callback_purge_remove_task)(struct config_plugin * config, const char * name);
 };
 
 /**
@@ -483,6 +749,15 @@ struct config_module {
   int                    (* glewlwyd_module_callback_metrics_add_metric)(struct config_module * config, const char * name, const char * help);
   int                    (* glewlwyd_module_callback_metrics_increment_counter)(struct config_module * config, const char * name, size_t inc, ...);
   void                   (* glewlwyd_module_callback_update_issued_for)(struct config_module * config, const struct _h_connection * conn, const char * sql_table, const char * issued_for_column, const char * issued_for_value, const char * id_column, json_int_t id_value);
+  struct _h_connection * (* glewlwyd_module_callback_db_checkout)(struct config_module * config);
+  void                   (* glewlwyd_module_callback_db_checkin)(struct config_module * config, struct _h_connection * conn);
+  int                    (* glewlwyd_module_callback_db_insert)(struct config_module * config, const struct _h_connection * conn, const json_t * j_query, const char * id_column, json_t ** j_last_id);
+  void                   (* glewlwyd_module_callback_db_insert_begin)(struct config_module * config, const struct _h_connection * conn);
+  void                   (* glewlwyd_module_callback_db_insert_end)(struct config_module * config, const struct _h_connection * conn);
+  int                    (* glewlwyd_module_callback_job_submit)(struct config_module * config, unsigned int type, const char * key, void * owner, void (* run)(void * data), void (* cancel)(void * data), void * data);
+  void                   (* glewlwyd_module_callback_job_cancel)(struct config_module * config, void * owner);
+  size_t                 (* glewlwyd_module_callback_password_pool_reserve_helper)(struct config_module * config, size_t nb);
+  void                   (* glewlwyd_module_callback_password_pool_release_helper)(struct config_module * config, size_t nb);
 };
 
 /**
@@ -499,8 +774,14 @@ char * join_json_string_array(json_t * j_array, const char * separator);
 int generate_digest(digest_algorithm digest, const char * data, int use_salt, char * out_digest);
 int generate_digest_raw(digest_algorithm digest, const unsigned char * data, size_t data_len, unsigned char * out_digest, size_t * out_digest_len);
 char * generate_hash(digest_algorithm digest, const char * data);
+int generate_hash_buffer(digest_algorithm digest, const char * data, int url_safe, char * out_hash, size_t out_hash_size);
 int generate_digest_pbkdf2(const char * data, unsigned int iterations, const char * salt, char * out_digest);
 
+// Multi-buffer PBKDF2 functions
+size_t generate_digest_pbkdf2_lanes(void);
+size_t generate_digest_pbkdf2_multi_min(void);
+int generate_digest_pbkdf2_multi(size_t nb, const char ** data_list, const unsigned int * iterations_list, const char ** salt_list, char ** out_digest_list);
+
 /**
  * Check if the result json object has a "result" element that is equal to value
  */
@@ -508,6 +789,19 @@ int check_result_value(json_t * result, const int value);
 
 int json_string_null_or_empty(json_t * j_str);
 
+/**
+ * Returns true if the coding is in the Accept-Encoding list with a non-zero q-value
+ */
+int accept_list_has_coding(char ** accept_list, const char * coding);
+
+/**
+ * Replay cache functions
+ */
+int glewlwyd_replay_cache_init(struct _glwd_replay_cache * cache, size_t nb_bucket, time_t max_lifetime);
+void glewlwyd_replay_cache_close(struct _glwd_replay_cache * cache);
+int glewlwyd_replay_cache_check_and_set(struct _glwd_replay_cache * cache, const char * scope, const char * identifier, time_t expires_at);
+void glewlwyd_replay_cache_remove(struct _glwd_replay_cache * cache, const char * scope, const char * identifier);
+
 /**
  * Modules functions prototypes
  */
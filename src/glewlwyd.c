@@ -91,6 +91,7 @@ int main (int argc, char ** argv) {
   config->config_p->glewlwyd_callback_get_plugin_external_url = &glewlwyd_callback_get_plugin_external_url;
   config->config_p->glewlwyd_callback_get_login_url = &glewlwyd_callback_get_login_url;
   config->config_p->glewlwyd_callback_generate_hash = &glewlwyd_callback_generate_hash;
+  config->config_p->glewlwyd_callback_generate_hash_buffer = &glewlwyd_callback_generate_hash_buffer;
   config->config_p->glewlwyd_callback_update_issued_for = &glewlwyd_callback_update_issued_for;
   config->config_p->glewlwyd_plugin_callback_get_user_list = &glewlwyd_plugin_callback_get_user_list;
   config->config_p->glewlwyd_plugin_callback_get_user = &glewlwyd_plugin_callback_get_user;
@@ -114,6 +115,15 @@ int main (int argc, char ** argv) {
   config->config_p->glewlwyd_plugin_callback_get_scheme_module = &glewlwyd_plugin_callback_get_scheme_module;
   config->config_p->glewlwyd_plugin_callback_metrics_add_metric = &glewlwyd_plugin_callback_metrics_add_metric;
   config->config_p->glewlwyd_plugin_callback_metrics_increment_counter = &glewlwyd_plugin_callback_metrics_increment_counter;
+  config->config_p->glewlwyd_callback_db_checkout = &glewlwyd_callback_db_checkout;
+  config->config_p->glewlwyd_callback_db_checkin = &glewlwyd_callback_db_checkin;
+  config->config_p->glewlwyd_callback_db_insert = &glewlwyd_callback_db_insert;
+  config->config_p->glewlwyd_callback_db_insert_begin = &glewlwyd_callback_db_insert_begin;
+  config->config_p->glewlwyd_callback_db_insert_end = &glewlwyd_callback_db_insert_end;
+  config->config_p->glewlwyd_callback_job_submit = &glewlwyd_callback_job_submit;
+  config->config_p->glewlwyd_callback_job_cancel = &glewlwyd_callback_job_cancel;
+  config->config_p->glewlwyd_callback_purge_add_task = &glewlwyd_callback_purge_add_task;
+  config->config_p->glewlwyd_callback_purge_remove_task = &glewlwyd_callback_purge_remove_task;
 
   // Init config structure with default values
   config->config_m->external_url = NULL;
@@ -129,11 +139,22 @@ int main (int argc, char ** argv) {
   config->config_m->glewlwyd_module_callback_metrics_add_metric = &glewlwyd_module_callback_metrics_add_metric;
   config->config_m->glewlwyd_module_callback_metrics_increment_counter = &glewlwyd_module_callback_metrics_increment_counter;
   config->config_m->glewlwyd_module_callback_update_issued_for = &glewlwyd_module_callback_update_issued_for;
+  config->config_m->glewlwyd_module_callback_db_checkout = &glewlwyd_module_callback_db_checkout;
+  config->config_m->glewlwyd_module_callback_db_checkin = &glewlwyd_module_callback_db_checkin;
+  config->config_m->glewlwyd_module_callback_db_insert = &glewlwyd_module_callback_db_insert;
+  config->config_m->glewlwyd_module_callback_db_insert_begin = &glewlwyd_module_callback_db_insert_begin;
+  config->config_m->glewlwyd_module_callback_db_insert_end = &glewlwyd_module_callback_db_insert_end;
+  config->config_m->glewlwyd_module_callback_job_submit = &glewlwyd_module_callback_job_submit;
+  config->config_m->glewlwyd_module_callback_job_cancel = &glewlwyd_module_callback_job_cancel;
+  config->config_m->glewlwyd_module_callback_password_pool_reserve_helper = &glewlwyd_module_callback_password_pool_reserve_helper;
+  config->config_m->glewlwyd_module_callback_password_pool_release_helper = &glewlwyd_module_callback_password_pool_release_helper;
   config->config_file = NULL;
   config->port = 0;
   config->max_post_size = GLEWLWYD_DEFAULT_MAX_POST_SIZE;
   config->bind_address = NULL;
   config->bind_address_metrics = NULL;
+  config->metrics_latency_bucket_list = NULL;
+  config->metrics_latency_bucket_size = 0;
   config->instance = NULL;
   config->instance_metrics = NULL;
   config->instance_initialized = 0;
@@ -158,6 +179,43 @@ int main (int argc, char ** argv) {
   config->secure_connection_pem_file = NULL;
   config->secure_connection_ca_file = NULL;
   config->conn = NULL;
+  memset(&config->db_pool, 0, sizeof(struct _glwd_db_pool)); // size 0 is the default size for the database type
+  config->db_pool.max_wait = GLEWLWYD_DEFAULT_DATABASE_POOL_MAX_WAIT;
+  config->user_cache_size = GLEWLWYD_DEFAULT_USER_CACHE_SIZE;
+  config->user_cache_ttl = GLEWLWYD_DEFAULT_USER_CACHE_TTL;
+  memset(&config->user_cache, 0, sizeof(struct _glwd_cache));
+  config->client_cache_size = GLEWLWYD_DEFAULT_CLIENT_CACHE_SIZE;
+  config->client_cache_ttl = GLEWLWYD_DEFAULT_CLIENT_CACHE_TTL;
+  config->client_cache_negative_ttl = GLEWLWYD_DEFAULT_CLIENT_CACHE_NEGATIVE_TTL;
+  memset(&config->client_cache, 0, sizeof(struct _glwd_cache));
+  config->geolocation_cache_size = GLEWLWYD_DEFAULT_GEOLOCATION_CACHE_SIZE;
+  config->geolocation_cache_ttl = GLEWLWYD_DEFAULT_GEOLOCATION_CACHE_TTL;
+  config->geolocation_cache_negative_ttl = GLEWLWYD_DEFAULT_GEOLOCATION_CACHE_NEGATIVE_TTL;
+  config->geolocation_cache_prefix_ipv4 = 32;
+  config->geolocation_cache_prefix_ipv6 = 128;
+  memset(&config->geolocation_cache, 0, sizeof(struct _glwd_cache));
+  config->j_geolocation_config = NULL;
+  config->geolocation_config_generation = 0;
+  config->geolocation_db = NULL;
+  config->geolocation_db_loading = 0;
+  config->geolocation_db_retry_at = 0;
+  config->geolocation_db_nb_failure = 0;
+  memset(&config->job_queue, 0, sizeof(struct _glwd_job_queue));
+  config->job_queue.nb_worker = GLEWLWYD_DEFAULT_JOB_QUEUE_WORKERS;
+  config->job_queue.max_size = GLEWLWYD_DEFAULT_JOB_QUEUE_SIZE;
+  config->job_queue.overflow = GLEWLWYD_JOB_OVERFLOW_DROP;
+  config->job_queue.max_running[GLEWLWYD_JOB_TYPE_MAIL] = GLEWLWYD_DEFAULT_JOB_QUEUE_MAX_RUNNING;
+  config->job_queue.max_running[GLEWLWYD_JOB_TYPE_GEOLOCATION] = GLEWLWYD_DEFAULT_JOB_QUEUE_MAX_RUNNING;
+  config->job_queue.max_running[GLEWLWYD_JOB_TYPE_NOTIFICATION] = GLEWLWYD_DEFAULT_JOB_QUEUE_MAX_RUNNING;
+  config->job_queue.max_running[GLEWLWYD_JOB_TYPE_DATABASE] = GLEWLWYD_DEFAULT_JOB_QUEUE_MAX_RUNNING;
+  memset(&config->password_pool, 0, sizeof(struct _glwd_password_pool));
+  config->password_pool.nb_worker = GLEWLWYD_DEFAULT_PASSWORD_POOL_WORKERS;
+  config->password_pool.max_size = GLEWLWYD_DEFAULT_PASSWORD_POOL_SIZE;
+  memset(&config->purge, 0, sizeof(struct _glwd_purge));
+  config->purge.interval = GLEWLWYD_DEFAULT_PURGE_INTERVAL;
+  config->purge.retention = GLEWLWYD_DEFAULT_PURGE_RETENTION;
+  config->purge.batch_size = GLEWLWYD_DEFAULT_PURGE_BATCH_SIZE;
+  config->purge.batch_delay = GLEWLWYD_DEFAULT_PURGE_BATCH_DELAY;
   config->session_key = o_strdup(GLEWLWYD_DEFAULT_SESSION_KEY);
   config->session_expiration = GLEWLWYD_DEFAULT_SESSION_EXPIRATION_PASSWORD;
   config->salt_length = GLEWLWYD_DEFAULT_SALT_LENGTH;
@@ -167,12 +225,15 @@ int main (int argc, char ** argv) {
   config->user_module_path = NULL;
   config->user_module_list = NULL;
   config->user_module_instance_list = NULL;
+  config->j_user_module_snapshot = NULL;
   config->user_middleware_module_path = NULL;
   config->user_middleware_module_list = NULL;
   config->user_middleware_module_instance_list = NULL;
   config->client_module_path = NULL;
   config->client_module_list = NULL;
   config->client_module_instance_list = NULL;
+  config->j_client_module_snapshot = NULL;
+  config->j_scope_graph = NULL;
   config->user_auth_scheme_module_path = NULL;
   config->user_auth_scheme_module_list = NULL;
   config->user_auth_scheme_module_instance_list = NULL;
@@ -191,6 +252,10 @@ int main (int argc, char ** argv) {
   config->metrics_endpoint_admin_session = 0;
   config->allow_gzip = 1;
   config->allow_deflate = 1;
+  config->allow_zstd = 1;
+  config->allow_brotli = 1;
+  config->compression_level = GLEWLWYD_DEFAULT_COMPRESSION_LEVEL;
+  config->compression_min_size = GLEWLWYD_DEFAULT_COMPRESSION_MIN_SIZE;
 
   // Initialize module lock
   pthread_mutexattr_init ( &mutexattr );
@@ -203,6 +268,18 @@ int main (int argc, char ** argv) {
     fprintf(stderr, "Error initializing insert mutex\n");
     exit_server(&config, GLEWLWYD_ERROR);
   }
+  if (pthread_mutex_init(&config->module_snapshot_lock, NULL) != 0) {
+    fprintf(stderr, "Error initializing module snapshot mutex\n");
+    exit_server(&config, GLEWLWYD_ERROR);
+  }
+  if (pthread_mutex_init(&config->scope_graph_lock, NULL) != 0 || pthread_mutex_init(&config->scope_graph_update_lock, NULL) != 0) {
+    fprintf(stderr, "Error initializing scope graph mutex\n");
+    exit_server(&config, GLEWLWYD_ERROR);
+  }
+  if (pthread_mutex_init(&config->geolocation_config_lock, NULL) != 0) {
+    fprintf(stderr, "Error initializing geolocation config mutex\n");
+    exit_server(&config, GLEWLWYD_ERROR);
+  }
   pthread_mutexattr_destroy(&mutexattr);
 
   config->static_file_config = o_malloc(sizeof(struct _u_compressed_inmemory_website_config));
@@ -312,8 +389,13 @@ int main (int argc, char ** argv) {
 
   http_comression_config.allow_gzip = config->allow_gzip;
   http_comression_config.allow_deflate = config->allow_deflate;
+  http_comression_config.allow_zstd = config->allow_zstd;
+  http_comression_config.allow_brotli = config->allow_brotli;
+  http_comression_config.level = config->compression_level;
+  http_comression_config.min_size = config->compression_min_size;
   config->static_file_config->allow_gzip = config->allow_gzip;
   config->static_file_config->allow_deflate = config->allow_deflate;
+  config->static_file_config->allow_brotli = config->allow_brotli;
 
   if (config->metrics_endpoint) {
     config->instance_metrics = o_malloc(sizeof(struct _u_instance));
@@ -347,6 +429,12 @@ int main (int argc, char ** argv) {
   glewlwyd_metrics_add_metric(config, GLWD_METRICS_AUTH_USER_INVALID, "Total number of invalid authentication");
   glewlwyd_metrics_add_metric(config, GLWD_METRICS_AUTH_USER_INVALID_SCHEME, "Total number of invalid authentication by scheme");
   glewlwyd_metrics_add_metric(config, GLWD_METRICS_DATABSE_ERROR, "Total number of database errors");
+  if (config->metrics_endpoint && config->metrics_latency_bucket_list == NULL && glewlwyd_metrics_parse_buckets(GLEWLWYD_DEFAULT_METRICS_LATENCY_BUCKETS, &config->metrics_latency_bucket_list, &config->metrics_latency_bucket_size) != G_OK) {
+    fprintf(stderr, "Error initializing metrics latency buckets\n");
+    exit_server(&config, GLEWLWYD_ERROR);
+  }
+  glewlwyd_metrics_add_metric_type(config, GLWD_METRICS_HTTP_REQUEST_DURATION, "Duration of the requests in seconds", GLWD_METRICS_TYPE_HISTOGRAM, config->metrics_latency_bucket_list, config->metrics_latency_bucket_size);
+  glewlwyd_metrics_add_metric_type(config, GLWD_METRICS_HTTP_REQUEST_IN_FLIGHT, "Number of requests in progress", GLWD_METRICS_TYPE_GAUGE, NULL, 0);
   glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_AUTH_USER_VALID, 0, NULL);
   glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_AUTH_USER_INVALID, 0, NULL);
   glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_AUTH_USER_VALID_SCHEME, 0, "scheme_type", "password", NULL);
@@ -357,6 +445,36 @@ int main (int argc, char ** argv) {
   config->config_m->login_url = config->login_url;
   config->config_m->admin_scope = config->admin_scope;
   config->config_m->profile_scope = config->profile_scope;
+  if (glewlwyd_db_pool_init(config) != G_OK) {
+    fprintf(stderr, "Error initializing database pool\n");
+    exit_server(&config, GLEWLWYD_ERROR);
+  }
+  if (glewlwyd_cache_init(&config->user_cache, "user", config->user_cache_size, config->user_cache_ttl) != G_OK) {
+    fprintf(stderr, "Error initializing user cache\n");
+    exit_server(&config, GLEWLWYD_ERROR);
+  }
+  if (glewlwyd_cache_init(&config->client_cache, "client", config->client_cache_size, config->client_cache_ttl) != G_OK) {
+    fprintf(stderr, "Error initializing client cache\n");
+    exit_server(&config, GLEWLWYD_ERROR);
+  }
+  if (glewlwyd_cache_init(&config->geolocation_cache, "geolocation", config->geolocation_cache_size, config->geolocation_cache_ttl) != G_OK) {
+    fprintf(stderr, "Error initializing geolocation cache\n");
+    exit_server(&config, GLEWLWYD_ERROR);
+  }
+  if (glewlwyd_job_queue_init(config) != G_OK) {
+    fprintf(stderr, "Error initializing background job queue\n");
+    exit_server(&config, GLEWLWYD_ERROR);
+  }
+  if (glewlwyd_password_pool_init(config) != G_OK) {
+    fprintf(stderr, "Error initializing password verification pool\n");
+    exit_server(&config, GLEWLWYD_ERROR);
+  }
+  if (glewlwyd_purge_init(config) != G_OK ||
+      glewlwyd_purge_add_task(config, GLEWLWYD_PURGE_CORE_NAME, GLEWLWYD_TABLE_USER_SESSION, "gus_id", NULL, "gus_expiration", 0, NULL) != G_OK) {
+    fprintf(stderr, "Error initializing purge\n");
+    exit_server(&config, GLEWLWYD_ERROR);
+  }
+
   config->config_m->conn = config->conn;
   config->config_m->hash_algorithm = config->hash_algorithm;
 
@@ -399,6 +517,10 @@ int main (int argc, char ** argv) {
     fprintf(stderr, "Error loading user auth scheme modules instances\n");
     exit_server(&config, GLEWLWYD_ERROR);
   }
+  if (update_scope_graph(config) != G_OK) {
+    fprintf(stderr, "Error loading scope graph\n");
+    exit_server(&config, GLEWLWYD_ERROR);
+  }
 
   // Initialize plugins
   if (init_plugin_module_list(config) != G_OK) {
@@ -414,19 +536,19 @@ int main (int argc, char ** argv) {
 
   // Authentication
   if (config->login_api_enabled) {
-    ulfius_add_endpoint_by_val(config->instance, "POST", config->api_prefix, "/auth/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_auth, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "POST", config->api_prefix, "/auth/scheme/trigger/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_auth_trigger, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/auth/scheme/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_get_schemes_from_scopes, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "DELETE", config->api_prefix, "/auth/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_delete_session, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "POST", config->api_prefix, "/auth/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_auth, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "POST", config->api_prefix, "/auth/scheme/trigger/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_auth_trigger, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/auth/scheme/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_get_schemes_from_scopes, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "DELETE", config->api_prefix, "/auth/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_delete_session, (void*)config);
     // User profile
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/profile_list/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_get_profile, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/profile_list/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_get_profile, (void*)config);
     ulfius_add_endpoint_by_val(config->instance, "*", config->api_prefix, "/profile/plugin", GLEWLWYD_CALLBACK_PRIORITY_AUTHENTICATION, &callback_glewlwyd_check_user_session, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/profile/plugin", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_get_plugin_list, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/profile/plugin", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_get_plugin_list, (void*)config);
   } else {
     ulfius_add_endpoint_by_val(config->instance, "*", config->api_prefix, "/auth/*", GLEWLWYD_CALLBACK_PRIORITY_AUTHENTICATION, &callback_403_whatever_the_means, NULL);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/profile_list/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_403_whatever_the_means, NULL);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/profile_list/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_403_whatever_the_means, NULL);
     ulfius_add_endpoint_by_val(config->instance, "*", config->api_prefix, "/profile/plugin", GLEWLWYD_CALLBACK_PRIORITY_AUTHENTICATION, &callback_403_whatever_the_means, NULL);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/profile/plugin", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_403_whatever_the_means, NULL);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/profile/plugin", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_403_whatever_the_means, NULL);
   }
 
   if (config->profile_session_authentication & GLEWLWYD_SESSION_AUTH_COOKIE) {
@@ -435,17 +557,17 @@ int main (int argc, char ** argv) {
     ulfius_add_endpoint_by_val(config->instance, "*", config->api_prefix, "/profile/grant", GLEWLWYD_CALLBACK_PRIORITY_AUTHENTICATION, &callback_glewlwyd_check_user_profile_valid, (void*)config);
     ulfius_add_endpoint_by_val(config->instance, "*", config->api_prefix, "/profile/session/*", GLEWLWYD_CALLBACK_PRIORITY_AUTHENTICATION, &callback_glewlwyd_check_user_profile_valid, (void*)config);
     ulfius_add_endpoint_by_val(config->instance, "*", config->api_prefix, "/profile/scheme/*", GLEWLWYD_CALLBACK_PRIORITY_AUTHENTICATION, &callback_glewlwyd_check_user_profile_valid, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "PUT", config->api_prefix, "/profile/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_update_profile, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "DELETE", config->api_prefix, "/profile/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_delete_profile, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "PUT", config->api_prefix, "/profile/password", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_update_password, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/profile/grant", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_get_client_grant_list, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/profile/session", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_get_session_list, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "DELETE", config->api_prefix, "/profile/session/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_session, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "DELETE", config->api_prefix, "/profile/session/:session_hash", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_session, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/profile/scheme", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_get_scheme_list, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "PUT", config->api_prefix, "/profile/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_update_profile, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "DELETE", config->api_prefix, "/profile/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_delete_profile, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "PUT", config->api_prefix, "/profile/password", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_update_password, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/profile/grant", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_get_client_grant_list, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/profile/session", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_get_session_list, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "DELETE", config->api_prefix, "/profile/session/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_session, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "DELETE", config->api_prefix, "/profile/session/:session_hash", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_session, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/profile/scheme", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_get_scheme_list, (void*)config);
     ulfius_add_endpoint_by_val(config->instance, "*", config->api_prefix, "/profile/scheme/register/*", GLEWLWYD_CALLBACK_PRIORITY_PRE_APPLICATION, &callback_glewlwyd_scheme_check_forbid_profile, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "POST", config->api_prefix, "/profile/scheme/register/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_auth_register, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "PUT", config->api_prefix, "/profile/scheme/register/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_auth_register_get, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "POST", config->api_prefix, "/profile/scheme/register/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_auth_register, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "PUT", config->api_prefix, "/profile/scheme/register/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_auth_register_get, (void*)config);
   } else {
     ulfius_add_endpoint_by_val(config->instance, "*", config->api_prefix, "/profile/", GLEWLWYD_CALLBACK_PRIORITY_AUTHENTICATION, &callback_403_whatever_the_means, NULL);
     ulfius_add_endpoint_by_val(config->instance, "*", config->api_prefix, "/profile/password", GLEWLWYD_CALLBACK_PRIORITY_AUTHENTICATION, &callback_403_whatever_the_means, NULL);
@@ -456,21 +578,21 @@ int main (int argc, char ** argv) {
 
   // Grant scopes endpoints
   ulfius_add_endpoint_by_val(config->instance, "*", config->api_prefix, "/auth/grant/*", GLEWLWYD_CALLBACK_PRIORITY_AUTHENTICATION, &callback_glewlwyd_check_user_session, (void*)config);
-  ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/auth/grant/:client_id/:scope_list", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_user_session_scope_grant, (void*)config);
-  ulfius_add_endpoint_by_val(config->instance, "PUT", config->api_prefix, "/auth/grant/:client_id/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_set_user_session_scope_grant, (void*)config);
+  glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/auth/grant/:client_id/:scope_list", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_user_session_scope_grant, (void*)config);
+  glewlwyd_add_timed_endpoint(config, NULL, "PUT", config->api_prefix, "/auth/grant/:client_id/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_set_user_session_scope_grant, (void*)config);
 
   if (config->admin_session_authentication & GLEWLWYD_SESSION_AUTH_COOKIE) {
     // User profile by delegation
     ulfius_add_endpoint_by_val(config->instance, "*", config->api_prefix, "/delegate/:username/*", GLEWLWYD_CALLBACK_PRIORITY_AUTHENTICATION, &callback_glewlwyd_check_admin_session_delegate, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "PUT", config->api_prefix, "/delegate/:username/profile/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_update_profile, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/delegate/:username/profile/session", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_get_session_list, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/delegate/:username/profile/plugin", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_get_plugin_list, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/delegate/:username/profile/grant", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_get_client_grant_list, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "PUT", config->api_prefix, "/delegate/:username/auth/grant/:client_id", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_set_user_session_scope_grant, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "DELETE", config->api_prefix, "/delegate/:username/profile/session/:session_hash", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_session, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/delegate/:username/profile/scheme", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_get_scheme_list, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "POST", config->api_prefix, "/delegate/:username/profile/scheme/register/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_auth_register_delegate, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "PUT", config->api_prefix, "/delegate/:username/profile/scheme/register/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_auth_register_get_delegate, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "PUT", config->api_prefix, "/delegate/:username/profile/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_update_profile, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/delegate/:username/profile/session", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_get_session_list, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/delegate/:username/profile/plugin", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_get_plugin_list, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/delegate/:username/profile/grant", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_get_client_grant_list, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "PUT", config->api_prefix, "/delegate/:username/auth/grant/:client_id", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_set_user_session_scope_grant, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "DELETE", config->api_prefix, "/delegate/:username/profile/session/:session_hash", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_session, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/delegate/:username/profile/scheme", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_get_scheme_list, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "POST", config->api_prefix, "/delegate/:username/profile/scheme/register/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_auth_register_delegate, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "PUT", config->api_prefix, "/delegate/:username/profile/scheme/register/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_user_auth_register_get_delegate, (void*)config);
   } else {
     ulfius_add_endpoint_by_val(config->instance, "*", config->api_prefix, "/delegate/*", GLEWLWYD_CALLBACK_PRIORITY_AUTHENTICATION, &callback_403_whatever_the_means, NULL);
   }
@@ -480,85 +602,85 @@ int main (int argc, char ** argv) {
     ulfius_add_endpoint_by_val(config->instance, "*", config->api_prefix, "/mod/*", GLEWLWYD_CALLBACK_PRIORITY_AUTHENTICATION, &callback_glewlwyd_check_admin_session_or_api_key, (void*)config);
 
     // Get all module types available
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/mod/type/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_module_type_list, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "PUT", config->api_prefix, "/mod/reload/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_reload_modules, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/mod/type/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_module_type_list, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "PUT", config->api_prefix, "/mod/reload/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_reload_modules, (void*)config);
 
     // User modules management
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/mod/user/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_user_module_list, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/mod/user/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_user_module, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "POST", config->api_prefix, "/mod/user/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_add_user_module, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "PUT", config->api_prefix, "/mod/user/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_set_user_module, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "DELETE", config->api_prefix, "/mod/user/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_user_module, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "PUT", config->api_prefix, "/mod/user/:name/:action", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_manage_user_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/mod/user/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_user_module_list, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/mod/user/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_user_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "POST", config->api_prefix, "/mod/user/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_add_user_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "PUT", config->api_prefix, "/mod/user/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_set_user_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "DELETE", config->api_prefix, "/mod/user/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_user_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "PUT", config->api_prefix, "/mod/user/:name/:action", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_manage_user_module, (void*)config);
 
     // User middleware modules management
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/mod/user_middleware/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_user_middleware_module_list, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/mod/user_middleware/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_user_middleware_module, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "POST", config->api_prefix, "/mod/user_middleware/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_add_user_middleware_module, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "PUT", config->api_prefix, "/mod/user_middleware/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_set_user_middleware_module, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "DELETE", config->api_prefix, "/mod/user_middleware/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_user_middleware_module, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "PUT", config->api_prefix, "/mod/user_middleware/:name/:action", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_manage_user_middleware_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/mod/user_middleware/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_user_middleware_module_list, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/mod/user_middleware/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_user_middleware_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "POST", config->api_prefix, "/mod/user_middleware/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_add_user_middleware_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "PUT", config->api_prefix, "/mod/user_middleware/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_set_user_middleware_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "DELETE", config->api_prefix, "/mod/user_middleware/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_user_middleware_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "PUT", config->api_prefix, "/mod/user_middleware/:name/:action", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_manage_user_middleware_module, (void*)config);
 
     // User auth scheme modules management
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/mod/scheme/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_user_auth_scheme_module_list, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/mod/scheme/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_user_auth_scheme_module, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "POST", config->api_prefix, "/mod/scheme/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_add_user_auth_scheme_module, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "PUT", config->api_prefix, "/mod/scheme/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_set_user_auth_scheme_module, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "DELETE", config->api_prefix, "/mod/scheme/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_user_auth_scheme_module, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "PUT", config->api_prefix, "/mod/scheme/:name/:action", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_manage_user_auth_scheme_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/mod/scheme/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_user_auth_scheme_module_list, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/mod/scheme/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_user_auth_scheme_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "POST", config->api_prefix, "/mod/scheme/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_add_user_auth_scheme_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "PUT", config->api_prefix, "/mod/scheme/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_set_user_auth_scheme_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "DELETE", config->api_prefix, "/mod/scheme/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_user_auth_scheme_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "PUT", config->api_prefix, "/mod/scheme/:name/:action", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_manage_user_auth_scheme_module, (void*)config);
 
     // Client modules management
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/mod/client/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_client_module_list, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/mod/client/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_client_module, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "POST", config->api_prefix, "/mod/client/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_add_client_module, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "PUT", config->api_prefix, "/mod/client/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_set_client_module, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "DELETE", config->api_prefix, "/mod/client/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_client_module, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "PUT", config->api_prefix, "/mod/client/:name/:action", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_manage_client_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/mod/client/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_client_module_list, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/mod/client/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_client_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "POST", config->api_prefix, "/mod/client/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_add_client_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "PUT", config->api_prefix, "/mod/client/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_set_client_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "DELETE", config->api_prefix, "/mod/client/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_client_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "PUT", config->api_prefix, "/mod/client/:name/:action", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_manage_client_module, (void*)config);
 
     // Plugin modules management
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/mod/plugin/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_plugin_module_list, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/mod/plugin/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_plugin_module, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "POST", config->api_prefix, "/mod/plugin/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_add_plugin_module, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "PUT", config->api_prefix, "/mod/plugin/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_set_plugin_module, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "DELETE", config->api_prefix, "/mod/plugin/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_plugin_module, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "PUT", config->api_prefix, "/mod/plugin/:name/:action", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_manage_plugin_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/mod/plugin/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_plugin_module_list, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/mod/plugin/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_plugin_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "POST", config->api_prefix, "/mod/plugin/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_add_plugin_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "PUT", config->api_prefix, "/mod/plugin/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_set_plugin_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "DELETE", config->api_prefix, "/mod/plugin/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_plugin_module, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "PUT", config->api_prefix, "/mod/plugin/:name/:action", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_manage_plugin_module, (void*)config);
 
     // Users CRUD
     ulfius_add_endpoint_by_val(config->instance, "*", config->api_prefix, "/user/*", GLEWLWYD_CALLBACK_PRIORITY_AUTHENTICATION, &callback_glewlwyd_check_admin_session_or_api_key, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/user/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_user_list, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/user/:username", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_user, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "POST", config->api_prefix, "/user/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_add_user, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "PUT", config->api_prefix, "/user/:username", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_set_user, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "DELETE", config->api_prefix, "/user/:username", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_user, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/user/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_user_list, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/user/:username", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_user, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "POST", config->api_prefix, "/user/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_add_user, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "PUT", config->api_prefix, "/user/:username", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_set_user, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "DELETE", config->api_prefix, "/user/:username", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_user, (void*)config);
 
     // Clients CRUD
     ulfius_add_endpoint_by_val(config->instance, "*", config->api_prefix, "/client/*", GLEWLWYD_CALLBACK_PRIORITY_AUTHENTICATION, &callback_glewlwyd_check_admin_session_or_api_key, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/client/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_client_list, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/client/:client_id", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_client, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "POST", config->api_prefix, "/client/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_add_client, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "PUT", config->api_prefix, "/client/:client_id", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_set_client, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "DELETE", config->api_prefix, "/client/:client_id", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_client, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/client/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_client_list, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/client/:client_id", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_client, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "POST", config->api_prefix, "/client/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_add_client, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "PUT", config->api_prefix, "/client/:client_id", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_set_client, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "DELETE", config->api_prefix, "/client/:client_id", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_client, (void*)config);
 
     // Scopes CRUD
     ulfius_add_endpoint_by_val(config->instance, "*", config->api_prefix, "/scope/*", GLEWLWYD_CALLBACK_PRIORITY_AUTHENTICATION, &callback_glewlwyd_check_admin_session_or_api_key, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/scope/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_scope_list, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/scope/:scope", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_scope, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "POST", config->api_prefix, "/scope/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_add_scope, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "PUT", config->api_prefix, "/scope/:scope", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_set_scope, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "DELETE", config->api_prefix, "/scope/:scope", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_scope, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/scope/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_scope_list, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/scope/:scope", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_scope, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "POST", config->api_prefix, "/scope/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_add_scope, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "PUT", config->api_prefix, "/scope/:scope", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_set_scope, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "DELETE", config->api_prefix, "/scope/:scope", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_scope, (void*)config);
 
     // API key CRD
     ulfius_add_endpoint_by_val(config->instance, "*", config->api_prefix, "/key/*", GLEWLWYD_CALLBACK_PRIORITY_AUTHENTICATION, &callback_glewlwyd_check_admin_session, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/key/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_api_key_list, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "DELETE", config->api_prefix, "/key/:key_hash", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_api_key, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "POST", config->api_prefix, "/key/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_add_api_key, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/key/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_api_key_list, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "DELETE", config->api_prefix, "/key/:key_hash", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_api_key, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "POST", config->api_prefix, "/key/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_add_api_key, (void*)config);
 
     // Misc configuration CRUD
     ulfius_add_endpoint_by_val(config->instance, "*", config->api_prefix, "/misc/*", GLEWLWYD_CALLBACK_PRIORITY_AUTHENTICATION, &callback_glewlwyd_check_admin_session_or_api_key, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/misc/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_misc_config_list, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/misc/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_misc_config, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "PUT", config->api_prefix, "/misc/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_set_misc_config, (void*)config);
-    ulfius_add_endpoint_by_val(config->instance, "DELETE", config->api_prefix, "/misc/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_misc_config, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/misc/", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_misc_config_list, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "GET", config->api_prefix, "/misc/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_get_misc_config, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "PUT", config->api_prefix, "/misc/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_set_misc_config, (void*)config);
+    glewlwyd_add_timed_endpoint(config, NULL, "DELETE", config->api_prefix, "/misc/:name", GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_delete_misc_config, (void*)config);
   } else {
     ulfius_add_endpoint_by_val(config->instance, "*", config->api_prefix, "/mod/*", GLEWLWYD_CALLBACK_PRIORITY_AUTHENTICATION, &callback_403_whatever_the_means, NULL);
     ulfius_add_endpoint_by_val(config->instance, "*", config->api_prefix, "/user/*", GLEWLWYD_CALLBACK_PRIORITY_AUTHENTICATION, &callback_403_whatever_the_means, NULL);
@@ -569,7 +691,7 @@ int main (int argc, char ** argv) {
   }
 
   // Other configuration
-  ulfius_add_endpoint_by_val(config->instance, "GET", "/config", NULL, GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_server_configuration, (void*)config);
+  glewlwyd_add_timed_endpoint(config, NULL, "GET", "/config", NULL, GLEWLWYD_CALLBACK_PRIORITY_APPLICATION, &callback_glewlwyd_server_configuration, (void*)config);
 
   if (http_comression_config.allow_deflate || http_comression_config.allow_gzip) {
     ulfius_add_endpoint_by_val(config->instance, "GET", config->api_prefix, "/profile_list/", GLEWLWYD_CALLBACK_PRIORITY_COMPRESSION, &callback_http_compression, &http_comression_config);
@@ -589,6 +711,9 @@ int main (int argc, char ** argv) {
 
   // Static files server
   if (config->static_file_config->files_path != NULL) {
+    if (u_load_compressed_inmemory_website_files(config->static_file_config) != U_OK) {
+      y_log_message(Y_LOG_LEVEL_WARNING, "Error loading static files in memory, the files will be served from the disk");
+    }
     ulfius_add_endpoint_by_val(config->instance, "GET", NULL, "*", GLEWLWYD_CALLBACK_PRIORITY_FILE, &callback_static_compressed_inmemory_website, (void*)config->static_file_config);
   }
   // Set default headers
@@ -703,6 +828,11 @@ void exit_server(struct config_elements ** config, int exit_value) {
   if (config != NULL && *config != NULL) {
     close_logs = ((*config)->log_mode != Y_LOG_MODE_NONE && (*config)->log_level != Y_LOG_LEVEL_NONE);
 
+    // Background jobs may use modules and plugins, the workers are stopped first
+    glewlwyd_job_queue_close(*config);
+    glewlwyd_password_pool_close(*config);
+    glewlwyd_purge_close(*config);
+
     close_user_module_instance_list(*config);
     close_user_module_list(*config);
 
@@ -720,6 +850,15 @@ void exit_server(struct config_elements ** config, int exit_value) {
 
     pthread_mutex_destroy(&(*config)->module_lock);
     pthread_mutex_destroy(&(*config)->insert_lock);
+    pthread_mutex_destroy(&(*config)->module_snapshot_lock);
+    json_decref((*config)->j_user_module_snapshot);
+    json_decref((*config)->j_client_module_snapshot);
+    pthread_mutex_destroy(&(*config)->scope_graph_lock);
+    pthread_mutex_destroy(&(*config)->scope_graph_update_lock);
+    json_decref((*config)->j_scope_graph);
+    glewlwyd_geolocation_db_close(*config);
+    pthread_mutex_destroy(&(*config)->geolocation_config_lock);
+    json_decref((*config)->j_geolocation_config);
 
     /* stop framework */
     if ((*config)->instance_initialized) {
@@ -732,6 +871,10 @@ void exit_server(struct config_elements ** config, int exit_value) {
       ulfius_clean_instance((*config)->instance_metrics);
     }
 
+    glewlwyd_cache_close(&(*config)->user_cache);
+    glewlwyd_cache_close(&(*config)->client_cache);
+    glewlwyd_cache_close(&(*config)->geolocation_cache);
+    glewlwyd_db_pool_close(*config);
     h_close_db((*config)->conn);
     h_clean_connection((*config)->conn);
     ulfius_global_close();
@@ -772,6 +915,7 @@ void exit_server(struct config_elements ** config, int exit_value) {
       o_free((*config)->static_file_config);
     }
     glewlwyd_metrics_close((*config));
+    o_free((*config)->metrics_latency_bucket_list);
 
     o_free((*config)->config_p);
     o_free((*config)->config_m);
@@ -1113,6 +1257,238 @@ int build_config_from_file(struct config_elements * config) {
       config->session_expiration = (uint)int_value;
     }
 
+    if (config_lookup_int(&cfg, "user_cache_size", &int_value) == CONFIG_TRUE) {
+      if (int_value >= 0) {
+        config->user_cache_size = (size_t)int_value;
+      } else {
+        fprintf(stderr, "Error - user_cache_size invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_int(&cfg, "user_cache_ttl", &int_value) == CONFIG_TRUE) {
+      if (int_value >= 0) {
+        config->user_cache_ttl = (unsigned int)int_value;
+      } else {
+        fprintf(stderr, "Error - user_cache_ttl invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_int(&cfg, "client_cache_size", &int_value) == CONFIG_TRUE) {
+      if (int_value >= 0) {
+        config->client_cache_size = (size_t)int_value;
+      } else {
+        fprintf(stderr, "Error - client_cache_size invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_int(&cfg, "client_cache_ttl", &int_value) == CONFIG_TRUE) {
+      if (int_value >= 0) {
+        config->client_cache_ttl = (unsigned int)int_value;
+      } else {
+        fprintf(stderr, "Error - client_cache_ttl invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_int(&cfg, "client_cache_negative_ttl", &int_value) == CONFIG_TRUE) {
+      if (int_value >= 0) {
+        config->client_cache_negative_ttl = (unsigned int)int_value;
+      } else {
+        fprintf(stderr, "Error - client_cache_negative_ttl invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_int(&cfg, "geolocation_cache_size", &int_value) == CONFIG_TRUE) {
+      if (int_value >= 0) {
+        config->geolocation_cache_size = (size_t)int_value;
+      } else {
+        fprintf(stderr, "Error - geolocation_cache_size invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_int(&cfg, "geolocation_cache_ttl", &int_value) == CONFIG_TRUE) {
+      if (int_value >= 0) {
+        config->geolocation_cache_ttl = (unsigned int)int_value;
+      } else {
+        fprintf(stderr, "Error - geolocation_cache_ttl invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_int(&cfg, "geolocation_cache_negative_ttl", &int_value) == CONFIG_TRUE) {
+      if (int_value >= 0) {
+        config->geolocation_cache_negative_ttl = (unsigned int)int_value;
+      } else {
+        fprintf(stderr, "Error - geolocation_cache_negative_ttl invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_int(&cfg, "geolocation_cache_prefix_ipv4", &int_value) == CONFIG_TRUE) {
+      if (int_value > 0 && int_value <= 32) {
+        config->geolocation_cache_prefix_ipv4 = (unsigned int)int_value;
+      } else {
+        fprintf(stderr, "Error - geolocation_cache_prefix_ipv4 invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_int(&cfg, "geolocation_cache_prefix_ipv6", &int_value) == CONFIG_TRUE) {
+      if (int_value > 0 && int_value <= 128) {
+        config->geolocation_cache_prefix_ipv6 = (unsigned int)int_value;
+      } else {
+        fprintf(stderr, "Error - geolocation_cache_prefix_ipv6 invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_int(&cfg, "job_queue_workers", &int_value) == CONFIG_TRUE) {
+      if (int_value > 0) {
+        config->job_queue.nb_worker = (unsigned int)int_value;
+      } else {
+        fprintf(stderr, "Error - job_queue_workers invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_int(&cfg, "job_queue_size", &int_value) == CONFIG_TRUE) {
+      if (int_value > 0) {
+        config->job_queue.max_size = (size_t)int_value;
+      } else {
+        fprintf(stderr, "Error - job_queue_size invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_string(&cfg, "job_queue_overflow", &str_value) == CONFIG_TRUE) {
+      if (0 == o_strcmp(str_value, "drop")) {
+        config->job_queue.overflow = GLEWLWYD_JOB_OVERFLOW_DROP;
+      } else if (0 == o_strcmp(str_value, "coalesce")) {
+        config->job_queue.overflow = GLEWLWYD_JOB_OVERFLOW_COALESCE;
+      } else {
+        fprintf(stderr, "Error - job_queue_overflow invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_int(&cfg, "job_queue_mail_max_running", &int_value) == CONFIG_TRUE) {
+      if (int_value >= 0) {
+        config->job_queue.max_running[GLEWLWYD_JOB_TYPE_MAIL] = (unsigned int)int_value;
+      } else {
+        fprintf(stderr, "Error - job_queue_mail_max_running invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_int(&cfg, "job_queue_geolocation_max_running", &int_value) == CONFIG_TRUE) {
+      if (int_value >= 0) {
+        config->job_queue.max_running[GLEWLWYD_JOB_TYPE_GEOLOCATION] = (unsigned int)int_value;
+      } else {
+        fprintf(stderr, "Error - job_queue_geolocation_max_running invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_int(&cfg, "job_queue_notification_max_running", &int_value) == CONFIG_TRUE) {
+      if (int_value >= 0) {
+        config->job_queue.max_running[GLEWLWYD_JOB_TYPE_NOTIFICATION] = (unsigned int)int_value;
+      } else {
+        fprintf(stderr, "Error - job_queue_notification_max_running invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_int(&cfg, "job_queue_database_max_running", &int_value) == CONFIG_TRUE) {
+      if (int_value >= 0) {
+        config->job_queue.max_running[GLEWLWYD_JOB_TYPE_DATABASE] = (unsigned int)int_value;
+      } else {
+        fprintf(stderr, "Error - job_queue_database_max_running invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_int(&cfg, "password_pool_workers", &int_value) == CONFIG_TRUE) {
+      if (int_value >= 0) {
+        config->password_pool.nb_worker = (unsigned int)int_value;
+      } else {
+        fprintf(stderr, "Error - password_pool_workers invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_int(&cfg, "password_pool_size", &int_value) == CONFIG_TRUE) {
+      if (int_value > 0) {
+        config->password_pool.max_size = (size_t)int_value;
+      } else {
+        fprintf(stderr, "Error - password_pool_size invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_int(&cfg, "purge_interval", &int_value) == CONFIG_TRUE) {
+      if (int_value >= 0) {
+        config->purge.interval = (unsigned int)int_value;
+      } else {
+        fprintf(stderr, "Error - purge_interval invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_int(&cfg, "purge_retention", &int_value) == CONFIG_TRUE) {
+      if (int_value >= 0) {
+        config->purge.retention = (unsigned int)int_value;
+      } else {
+        fprintf(stderr, "Error - purge_retention invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_int(&cfg, "purge_batch_size", &int_value) == CONFIG_TRUE) {
+      if (int_value > 0) {
+        config->purge.batch_size = (size_t)int_value;
+      } else {
+        fprintf(stderr, "Error - purge_batch_size invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_int(&cfg, "purge_batch_delay", &int_value) == CONFIG_TRUE) {
+      if (int_value >= 0) {
+        config->purge.batch_delay = (unsigned int)int_value;
+      } else {
+        fprintf(stderr, "Error - purge_batch_delay invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
     if (config_lookup_string(&cfg, "external_url", &str_value) == CONFIG_TRUE) {
       o_free(config->external_url);
       config->external_url = o_strdup(str_value);
@@ -1241,6 +1617,7 @@ int build_config_from_file(struct config_elements * config) {
                 ret = G_ERROR_PARAM;
                 break;
               }
+              glewlwyd_db_pool_set_parameters(&config->db_pool, HOEL_DB_TYPE_SQLITE, str_value_2, NULL, NULL, NULL, NULL, 0);
             }
           } else {
             fprintf(stderr, "Error - no sqlite database specified\n");
@@ -1264,6 +1641,7 @@ int build_config_from_file(struct config_elements * config) {
               ret = G_ERROR_PARAM;
               break;
             }
+            glewlwyd_db_pool_set_parameters(&config->db_pool, HOEL_DB_TYPE_MARIADB, NULL, str_value_2, str_value_3, str_value_4, str_value_5, (unsigned int)int_value);
           }
         } else if (0 == o_strcmp(str_value, "postgre")) {
           config_setting_lookup_string(database, "conninfo", &str_value_2);
@@ -1273,6 +1651,7 @@ int build_config_from_file(struct config_elements * config) {
             ret = G_ERROR_PARAM;
             break;
           }
+          glewlwyd_db_pool_set_parameters(&config->db_pool, HOEL_DB_TYPE_PGSQL, str_value_2, NULL, NULL, NULL, NULL, 0);
         } else {
           fprintf(stderr, "Error - database type unknown\n");
           ret = G_ERROR_PARAM;
@@ -1283,6 +1662,24 @@ int build_config_from_file(struct config_elements * config) {
         ret = G_ERROR_PARAM;
         break;
       }
+      if (config_setting_lookup_int(database, "pool_size", &int_value) == CONFIG_TRUE) {
+        if (int_value > 0) {
+          config->db_pool.size = (unsigned int)int_value;
+        } else {
+          fprintf(stderr, "Error - database pool_size invalid, exiting\n");
+          ret = G_ERROR_PARAM;
+          break;
+        }
+      }
+      if (config_setting_lookup_int(database, "pool_max_wait", &int_value) == CONFIG_TRUE) {
+        if (int_value >= 0) {
+          config->db_pool.max_wait = (unsigned int)int_value;
+        } else {
+          fprintf(stderr, "Error - database pool_max_wait invalid, exiting\n");
+          ret = G_ERROR_PARAM;
+          break;
+        }
+      }
     } else {
       fprintf(stderr, "Error - no database setting found\n");
       ret = G_ERROR_PARAM;
@@ -1343,6 +1740,15 @@ int build_config_from_file(struct config_elements * config) {
       if (config_lookup_bool(&cfg, "metrics_endpoint_admin_session", &int_value_3) == CONFIG_TRUE) {
         config->metrics_endpoint_admin_session = (ushort)int_value_3;
       }
+
+      if (config_lookup_string(&cfg, "metrics_latency_buckets", &str_value) == CONFIG_TRUE) {
+        o_free(config->metrics_latency_bucket_list);
+        if (glewlwyd_metrics_parse_buckets(str_value, &config->metrics_latency_bucket_list, &config->metrics_latency_bucket_size) != G_OK) {
+          fprintf(stderr, "Error - metrics_latency_buckets invalid, exiting\n");
+          ret = G_ERROR_PARAM;
+          break;
+        }
+      }
     }
 
     if (config_lookup_string(&cfg, "response_allowed_compression", &str_value) == CONFIG_TRUE && !o_strnullempty(str_value)) {
@@ -1353,6 +1759,12 @@ int build_config_from_file(struct config_elements * config) {
         if (!string_array_has_value((const char **)splitted, "gzip")) {
           config->allow_gzip = 0;
         }
+        if (!string_array_has_value((const char **)splitted, "zstd")) {
+          config->allow_zstd = 0;
+        }
+        if (!string_array_has_value((const char **)splitted, "br")) {
+          config->allow_brotli = 0;
+        }
         free_string_array(splitted);
       } else {
         fprintf(stderr, "Error split_string, exiting\n");
@@ -1361,6 +1773,26 @@ int build_config_from_file(struct config_elements * config) {
       }
     }
 
+    if (config_lookup_int(&cfg, "response_compression_level", &int_value) == CONFIG_TRUE) {
+      if (int_value >= 1 && int_value <= 9) {
+        config->compression_level = int_value;
+      } else {
+        fprintf(stderr, "Error - response_compression_level invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
+    if (config_lookup_int(&cfg, "response_compression_min_size", &int_value) == CONFIG_TRUE) {
+      if (int_value >= 0) {
+        config->compression_min_size = (size_t)int_value;
+      } else {
+        fprintf(stderr, "Error - response_compression_min_size invalid, exiting\n");
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+
     if (config_lookup_string(&cfg, "admin_session_authentication", &str_value) == CONFIG_TRUE && !o_strnullempty(str_value)) {
       config->admin_session_authentication = GLEWLWYD_SESSION_AUTH_NONE;
       if (split_string(str_value, ",", &splitted)) {
@@ -1651,6 +2083,259 @@ int build_config_from_env(struct config_elements * config) {
     }
   }
 
+  if ((value = getenv(GLEWLWYD_ENV_USER_CACHE_SIZE)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue >= 0) {
+      config->user_cache_size = (size_t)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid user_cache_size number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_USER_CACHE_TTL)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue >= 0) {
+      config->user_cache_ttl = (unsigned int)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid user_cache_ttl number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_CLIENT_CACHE_SIZE)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue >= 0) {
+      config->client_cache_size = (size_t)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid client_cache_size number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_CLIENT_CACHE_TTL)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue >= 0) {
+      config->client_cache_ttl = (unsigned int)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid client_cache_ttl number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_CLIENT_CACHE_NEGATIVE_TTL)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue >= 0) {
+      config->client_cache_negative_ttl = (unsigned int)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid client_cache_negative_ttl number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_GEOLOCATION_CACHE_SIZE)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue >= 0) {
+      config->geolocation_cache_size = (size_t)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid geolocation_cache_size number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_GEOLOCATION_CACHE_TTL)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue >= 0) {
+      config->geolocation_cache_ttl = (unsigned int)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid geolocation_cache_ttl number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_GEOLOCATION_CACHE_NEGATIVE_TTL)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue >= 0) {
+      config->geolocation_cache_negative_ttl = (unsigned int)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid geolocation_cache_negative_ttl number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_GEOLOCATION_CACHE_PREFIX_IPV4)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue > 0 && lvalue <= 32) {
+      config->geolocation_cache_prefix_ipv4 = (unsigned int)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid geolocation_cache_prefix_ipv4 number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_GEOLOCATION_CACHE_PREFIX_IPV6)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue > 0 && lvalue <= 128) {
+      config->geolocation_cache_prefix_ipv6 = (unsigned int)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid geolocation_cache_prefix_ipv6 number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_JOB_QUEUE_WORKERS)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue > 0) {
+      config->job_queue.nb_worker = (unsigned int)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid job_queue_workers number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_JOB_QUEUE_SIZE)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue > 0) {
+      config->job_queue.max_size = (size_t)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid job_queue_size number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_JOB_QUEUE_OVERFLOW)) != NULL && !o_strnullempty(value)) {
+    if (0 == o_strcmp(value, "drop")) {
+      config->job_queue.overflow = GLEWLWYD_JOB_OVERFLOW_DROP;
+    } else if (0 == o_strcmp(value, "coalesce")) {
+      config->job_queue.overflow = GLEWLWYD_JOB_OVERFLOW_COALESCE;
+    } else {
+      fprintf(stderr, "Error invalid job_queue_overflow value (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_JOB_QUEUE_MAIL_MAX_RUNNING)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue >= 0) {
+      config->job_queue.max_running[GLEWLWYD_JOB_TYPE_MAIL] = (unsigned int)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid job_queue_mail_max_running number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_JOB_QUEUE_GEOLOCATION_MAX_RUNNING)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue >= 0) {
+      config->job_queue.max_running[GLEWLWYD_JOB_TYPE_GEOLOCATION] = (unsigned int)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid job_queue_geolocation_max_running number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_JOB_QUEUE_NOTIFICATION_MAX_RUNNING)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue >= 0) {
+      config->job_queue.max_running[GLEWLWYD_JOB_TYPE_NOTIFICATION] = (unsigned int)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid job_queue_notification_max_running number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_JOB_QUEUE_DATABASE_MAX_RUNNING)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue >= 0) {
+      config->job_queue.max_running[GLEWLWYD_JOB_TYPE_DATABASE] = (unsigned int)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid job_queue_database_max_running number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_PASSWORD_POOL_WORKERS)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue >= 0) {
+      config->password_pool.nb_worker = (unsigned int)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid password_pool_workers number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_PASSWORD_POOL_SIZE)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue > 0) {
+      config->password_pool.max_size = (size_t)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid password_pool_size number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_PURGE_INTERVAL)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue >= 0) {
+      config->purge.interval = (unsigned int)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid purge_interval number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_PURGE_RETENTION)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue >= 0) {
+      config->purge.retention = (unsigned int)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid purge_retention number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_PURGE_BATCH_SIZE)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue > 0) {
+      config->purge.batch_size = (size_t)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid purge_batch_size number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_PURGE_BATCH_DELAY)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue >= 0) {
+      config->purge.batch_delay = (unsigned int)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid purge_batch_delay number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
   if ((value = getenv(GLEWLWYD_ENV_SESSION_KEY)) != NULL && !o_strnullempty(value)) {
     o_free(config->session_key);
     config->session_key = o_strdup(value);
@@ -1786,6 +2471,8 @@ int build_config_from_env(struct config_elements * config) {
         if (h_execute_query_sqlite(config->conn, "PRAGMA foreign_keys = ON;") != H_OK) {
           y_log_message(Y_LOG_LEVEL_ERROR, "Error executing sqlite3 query 'PRAGMA foreign_keys = ON; (env), exiting'");
           ret = G_ERROR_PARAM;
+        } else {
+          glewlwyd_db_pool_set_parameters(&config->db_pool, HOEL_DB_TYPE_SQLITE, getenv(GLEWLWYD_ENV_DATABASE_SQLITE3_PATH), NULL, NULL, NULL, NULL, 0);
         }
       }
     } else if (0 == o_strcmp(value, "mariadb")) {
@@ -1798,6 +2485,8 @@ int build_config_from_env(struct config_elements * config) {
           if (h_execute_query_mariadb(config->conn, "SET sql_mode='PIPES_AS_CONCAT';", NULL) != H_OK) {
             y_log_message(Y_LOG_LEVEL_ERROR, "Error executing mariadb query 'SET sql_mode='PIPES_AS_CONCAT'; (env), exiting'");
             ret = G_ERROR_PARAM;
+          } else {
+            glewlwyd_db_pool_set_parameters(&config->db_pool, HOEL_DB_TYPE_MARIADB, NULL, getenv(GLEWLWYD_ENV_DATABASE_MARIADB_HOST), getenv(GLEWLWYD_ENV_DATABASE_MARIADB_USER), getenv(GLEWLWYD_ENV_DATABASE_MARIADB_PASSWORD), getenv(GLEWLWYD_ENV_DATABASE_MARIADB_DBNAME), (unsigned int)lvalue);
           }
         }
       }
@@ -1805,6 +2494,8 @@ int build_config_from_env(struct config_elements * config) {
       if ((config->conn = h_connect_pgsql(getenv(GLEWLWYD_ENV_DATABASE_POSTGRE_CONNINFO))) == NULL) {
         fprintf(stderr, "Error opening postgre database %s (env), exiting\n", getenv(GLEWLWYD_ENV_DATABASE_POSTGRE_CONNINFO));
         ret = G_ERROR_PARAM;
+      } else {
+        glewlwyd_db_pool_set_parameters(&config->db_pool, HOEL_DB_TYPE_PGSQL, getenv(GLEWLWYD_ENV_DATABASE_POSTGRE_CONNINFO), NULL, NULL, NULL, NULL, 0);
       }
     } else {
       fprintf(stderr, "Error - database type unknown (env), exiting\n");
@@ -1812,6 +2503,26 @@ int build_config_from_env(struct config_elements * config) {
     }
   }
 
+  if ((value = getenv(GLEWLWYD_ENV_DATABASE_POOL_SIZE)) != NULL && !o_strnullempty(value)) {
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue > 0 && lvalue < 65535) {
+      config->db_pool.size = (unsigned int)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid database pool size (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_DATABASE_POOL_MAX_WAIT)) != NULL && !o_strnullempty(value)) {
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue >= 0) {
+      config->db_pool.max_wait = (unsigned int)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid database pool max wait (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
   if ((value = getenv(GLEWLWYD_ENV_METRICS)) != NULL) {
     config->metrics_endpoint = (ushort)(o_strcmp(value, "1")==0);
   }
@@ -1833,6 +2544,14 @@ int build_config_from_env(struct config_elements * config) {
     }
   }
 
+  if ((value = getenv(GLEWLWYD_ENV_METRICS_LATENCY_BUCKETS)) != NULL && !o_strnullempty(value)) {
+    o_free(config->metrics_latency_bucket_list);
+    if (glewlwyd_metrics_parse_buckets(value, &config->metrics_latency_bucket_list, &config->metrics_latency_bucket_size) != G_OK) {
+      fprintf(stderr, "Error invalid metrics latency buckets (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
   if ((value = getenv(GLEWLWYD_ENV_RESPONSE_ALLOWED_COMPRESSION)) != NULL && !o_strnullempty(value)) {
     if (split_string(value, ",", &splitted)) {
       if (!string_array_has_value((const char **)splitted, "deflate")) {
@@ -1841,6 +2560,12 @@ int build_config_from_env(struct config_elements * config) {
       if (!string_array_has_value((const char **)splitted, "gzip")) {
         config->allow_gzip = 0;
       }
+      if (!string_array_has_value((const char **)splitted, "zstd")) {
+        config->allow_zstd = 0;
+      }
+      if (!string_array_has_value((const char **)splitted, "br")) {
+        config->allow_brotli = 0;
+      }
       free_string_array(splitted);
     } else {
       fprintf(stderr, "Error split_string, exiting\n");
@@ -1848,6 +2573,28 @@ int build_config_from_env(struct config_elements * config) {
     }
   }
 
+  if ((value = getenv(GLEWLWYD_ENV_RESPONSE_COMPRESSION_LEVEL)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue >= 1 && lvalue <= 9) {
+      config->compression_level = (int)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid response_compression_level number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
+  if ((value = getenv(GLEWLWYD_ENV_RESPONSE_COMPRESSION_MIN_SIZE)) != NULL && !o_strnullempty(value)) {
+    endptr = NULL;
+    lvalue = strtol(value, &endptr, 10);
+    if (!(*endptr) && lvalue >= 0) {
+      config->compression_min_size = (size_t)lvalue;
+    } else {
+      fprintf(stderr, "Error invalid response_compression_min_size number (env), exiting\n");
+      ret = G_ERROR_PARAM;
+    }
+  }
+
   if ((value = getenv(GLEWLWYD_ENV_ADMIN_SESSION_AUTH)) != NULL && !o_strnullempty(value)) {
     config->admin_session_authentication = GLEWLWYD_SESSION_AUTH_NONE;
     if (split_string(value, ",", &splitted)) {
@@ -2319,6 +3066,9 @@ int load_user_module_instance_list(struct config_elements * config) {
     y_log_message(Y_LOG_LEVEL_ERROR, "load_user_module_instance_list - Error allocating resource for config->user_module_instance_list");
     ret = G_ERROR_MEMORY;
   }
+  if (ret == G_OK) {
+    update_user_module_snapshot(config);
+  }
   return ret;
 }
 
@@ -2581,6 +3331,7 @@ int load_user_middleware_module_instance_list(struct config_elements * config) {
   struct _user_middleware_module * module = NULL;
   char * message;
 
+  glewlwyd_cache_clear(&config->user_cache);
   config->user_middleware_module_instance_list = o_malloc(sizeof(struct _pointer_list));
   if (config->user_middleware_module_instance_list != NULL) {
     pointer_list_init(config->user_middleware_module_instance_list);
@@ -3353,6 +4104,9 @@ int load_client_module_instance_list(struct config_elements * config) {
     y_log_message(Y_LOG_LEVEL_ERROR, "load_client_module_instance_list - Error allocating resources for config->client_module_instance_list");
     ret = G_ERROR;
   }
+  if (ret == G_OK) {
+    update_client_module_snapshot(config);
+  }
   return ret;
 }
 
@@ -3761,16 +4515,102 @@ void close_plugin_module_list(struct config_elements * config) {
   }
 }
 
+/**
+ * Returns the ip-geolocation-api misc config, kept in memory until the misc config is updated
+ * The config read from the database is kept only if it wasn't reset during the read
+ */
+static json_t * get_ip_geolocation_config(struct config_elements * config) {
+  json_t * j_misc_config = NULL, * j_return = NULL;
+  size_t generation = 0;
+
+  if (!pthread_mutex_lock(&config->geolocation_config_lock)) {
+    j_return = json_incref(config->j_geolocation_config);
+    generation = config->geolocation_config_generation;
+    pthread_mutex_unlock(&config->geolocation_config_lock);
+  }
+  if (j_return == NULL) {
+    j_misc_config = get_misc_config(config, GLEWLWYD_IP_GEOLOCATION_API_TYPE, NULL);
+    if (check_result_value(j_misc_config, G_OK)) {
+      j_return = json_incref(json_object_get(json_object_get(j_misc_config, "misc_config"), "value"));
+    } else if (check_result_value(j_misc_config, G_ERROR_NOT_FOUND)) {
+      j_return = json_object();
+    }
+    if (j_return != NULL && !pthread_mutex_lock(&config->geolocation_config_lock)) {
+      if (config->j_geolocation_config == NULL && config->geolocation_config_generation == generation) {
+        config->j_geolocation_config = json_incref(j_return);
+      }
+      pthread_mutex_unlock(&config->geolocation_config_lock);
+    }
+    json_decref(j_misc_config);
+  }
+  return j_return;
+}
+
+void reset_ip_geolocation_config(struct config_elements * config) {
+  if (!pthread_mutex_lock(&config->geolocation_config_lock)) {
+    json_decref(config->j_geolocation_config);
+    config->j_geolocation_config = NULL;
+    config->geolocation_config_generation++;
+    pthread_mutex_unlock(&config->geolocation_config_lock);
+  }
+  glewlwyd_geolocation_db_close(config);
+  glewlwyd_cache_clear(&config->geolocation_cache);
+}
+
+/**
+ * Returns the geolocation cache key of the ip address: the network address
+ * of its /geolocation_cache_prefix_ipv4 or /geolocation_cache_prefix_ipv6 prefix
+ */
+static char * get_ip_geolocation_cache_key(struct config_elements * config, const char * ip_address) {
+  unsigned char addr[sizeof(struct in6_addr)];
+  char str_addr[INET6_ADDRSTRLEN] = {0}, * key = NULL;
+  unsigned int prefix, i;
+  int family;
+
+  if (inet_pton(AF_INET, ip_address, addr) == 1) {
+    family = AF_INET;
+    prefix = config->geolocation_cache_prefix_ipv4;
+  } else if (inet_pton(AF_INET6, ip_address, addr) == 1) {
+    family = AF_INET6;
+    prefix = config->geolocation_cache_prefix_ipv6;
+  } else {
+    family = 0;
+    prefix = 0;
+  }
+  if (family) {
+    for (i=0; i<(family==AF_INET?sizeof(struct in_addr):sizeof(struct in6_addr)); i++) {
+      if (prefix < 8*(i+1)) {
+        addr[i] &= (unsigned char)(prefix > 8*i ? 0xff << (8*(i+1)-prefix) : 0);
+      }
+    }
+    if (inet_ntop(family, addr, str_addr, INET6_ADDRSTRLEN) != NULL) {
+      key = msprintf("%s/%u", str_addr, prefix);
+    }
+  }
+  return key;
+}
+
+/**
+ * Returns the location of the ip address
+ * The cache generation is read before the config, so a location fetched with a config
+ * reset during the fetch isn't stored in the cache
+ */
 char * get_ip_data(struct config_elements * config, const char * ip_address) {
-  char * data = NULL, * url, ** properties = NULL;
-  json_t * j_misc_config = get_misc_config(config, GLEWLWYD_IP_GEOLOCATION_API_TYPE, NULL), * j_response;
+  char * data = NULL, * url, ** properties = NULL, * cache_key = get_ip_geolocation_cache_key(config, ip_address);
+  size_t generation = glewlwyd_cache_get_generation(&config->geolocation_cache, cache_key), i;
+  json_t * j_geolocation_config = get_ip_geolocation_config(config), * j_response, * j_cached;
   struct _u_request req;
   struct _u_response resp;
-  size_t i;
 
-  if (check_result_value(j_misc_config, G_OK) && json_object_get(json_object_get(json_object_get(j_misc_config, "misc_config"), "value"), "enabled") == json_true()) {
-    if (split_string(json_string_value(json_object_get(json_object_get(json_object_get(j_misc_config, "misc_config"), "value"), "output-properties")), ",", &properties)) {
-      url = str_replace(json_string_value(json_object_get(json_object_get(json_object_get(j_misc_config, "misc_config"), "value"), "url")), "{IP}", ip_address);
+  if (json_object_get(j_geolocation_config, "enabled") == json_true() && !o_strnullempty(json_string_value(json_object_get(j_geolocation_config, "file")))) {
+    // The local database lookup is cheaper than the cache, no need to use it
+    data = glewlwyd_geolocation_db_lookup(config, json_string_value(json_object_get(j_geolocation_config, "file")), ip_address, json_string_value(json_object_get(j_geolocation_config, "output-properties")));
+  } else if (json_object_get(j_geolocation_config, "enabled") == json_true()) {
+    if ((j_cached = glewlwyd_cache_get(&config->geolocation_cache, cache_key)) != NULL) {
+      data = o_strdup(json_string_value(json_object_get(j_cached, "data")));
+      json_decref(j_cached);
+    } else if (split_string(json_string_value(json_object_get(j_geolocation_config, "output-properties")), ",", &properties)) {
+      url = str_replace(json_string_value(json_object_get(j_geolocation_config, "url")), "{IP}", ip_address);
       ulfius_init_request(&req);
       ulfius_init_response(&resp);
       ulfius_set_request_properties(&req, U_OPT_HTTP_URL, url, U_OPT_NONE);
@@ -3793,12 +4633,19 @@ char * get_ip_data(struct config_elements * config, const char * ip_address) {
       ulfius_clean_request(&req);
       ulfius_clean_response(&resp);
       o_free(url);
+      // Failed lookups are cached too, so an unavailable API isn't called for every request
+      if (data != NULL || config->geolocation_cache_negative_ttl) {
+        j_cached = json_pack("{ss?}", "data", data);
+        glewlwyd_cache_set_if_generation(&config->geolocation_cache, cache_key, j_cached, data!=NULL?0:config->geolocation_cache_negative_ttl, generation);
+        json_decref(j_cached);
+      }
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "get_ip_data - Error split_string for %s", json_string_value(json_object_get(json_object_get(json_object_get(j_misc_config, "misc_config"), "value"), "output-properties")));
+      y_log_message(Y_LOG_LEVEL_ERROR, "get_ip_data - Error split_string for %s", json_string_value(json_object_get(j_geolocation_config, "output-properties")));
     }
     free_string_array(properties);
   }
-  json_decref(j_misc_config);
+  o_free(cache_key);
+  json_decref(j_geolocation_config);
   return data;
 }
 
@@ -3842,7 +4689,10 @@ char * complete_template(const char * template, ...) {
   return to_return;
 }
 
-void * thread_send_mail(void * args) {
+/**
+ * Background job sending an e-mail, send_mail is freed afterwards
+ */
+void run_send_mail(void * args) {
   struct send_mail_content_struct * send_mail = (struct send_mail_content_struct *)args;
   if (send_mail != NULL) {
     if (ulfius_send_smtp_rich_email(send_mail->host,
@@ -3858,8 +4708,17 @@ void * thread_send_mail(void * args) {
                                    send_mail->content_type,
                                    send_mail->subject,
                                    send_mail->body) != U_OK) {
-      y_log_message(Y_LOG_LEVEL_ERROR, "thread_send_mail - Error ulfius_send_smtp_rich_email");
+      y_log_message(Y_LOG_LEVEL_ERROR, "run_send_mail - Error ulfius_send_smtp_rich_email");
     }
+    free_send_mail(send_mail);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "run_send_mail - Error send_mail ivalid");
+  }
+}
+
+void free_send_mail(void * args) {
+  struct send_mail_content_struct * send_mail = (struct send_mail_content_struct *)args;
+  if (send_mail != NULL) {
     o_free(send_mail->host);
     o_free(send_mail->user);
     o_free(send_mail->password);
@@ -3869,11 +4728,7 @@ void * thread_send_mail(void * args) {
     o_free(send_mail->subject);
     o_free(send_mail->body);
     o_free(send_mail);
-  } else {
-    y_log_message(Y_LOG_LEVEL_ERROR, "thread_send_mail - Error send_mail ivalid");
   }
-  
-  return NULL;
 }
 
 int is_plugin_api_run_enabled (struct config_elements * config, const char * name) {
@@ -60,6 +60,7 @@
 // Configuration default values
 #define GLEWLWYD_DEFAULT_PORT                              4593
 #define GLEWLWYD_DEFAULT_METRICS_PORT                      4594
+#define GLEWLWYD_DEFAULT_METRICS_LATENCY_BUCKETS           "0.005,0.01,0.025,0.05,0.1,0.25,0.5,1,2.5,5,10"
 #define GLEWLWYD_DEFAULT_API_PREFIX                        "api"
 #define GLEWLWYD_DEFAULT_ALLOW_ORIGIN                      "*"
 #define GLEWLWYD_DEFAULT_ALLOW_METHODS                     "GET, POST, PUT, DELETE, OPTIONS"
@@ -72,6 +73,28 @@
 #define GLEWLWYD_DEFAULT_SESSION_KEY                       "GLEWLWYD2_SESSION_ID"
 #define GLEWLWYD_DEFAULT_SESSION_EXPIRATION_COOKIE         5256000 // 10 years
 #define GLEWLWYD_DEFAULT_MAX_POST_SIZE                     (16*1024*1024)+1024
+#define GLEWLWYD_DEFAULT_DATABASE_POOL_SIZE                4 // MariaDB/Mysql and PostgreSQL, SQLite3 always uses 1 connection
+#define GLEWLWYD_DEFAULT_DATABASE_POOL_MAX_WAIT            0 // milliseconds
+#define GLEWLWYD_DEFAULT_USER_CACHE_SIZE                   0 // disabled
+#define GLEWLWYD_DEFAULT_USER_CACHE_TTL                    60 // seconds
+#define GLEWLWYD_DEFAULT_CLIENT_CACHE_SIZE                 0 // disabled
+#define GLEWLWYD_DEFAULT_CLIENT_CACHE_TTL                  60 // seconds
+#define GLEWLWYD_DEFAULT_CLIENT_CACHE_NEGATIVE_TTL         10 // seconds
+#define GLEWLWYD_DEFAULT_GEOLOCATION_CACHE_SIZE            1024
+#define GLEWLWYD_DEFAULT_GEOLOCATION_CACHE_TTL             3600 // seconds
+#define GLEWLWYD_DEFAULT_GEOLOCATION_CACHE_NEGATIVE_TTL    300 // seconds
+#define GLEWLWYD_DEFAULT_JOB_QUEUE_WORKERS                 4
+#define GLEWLWYD_DEFAULT_JOB_QUEUE_SIZE                    1024
+#define GLEWLWYD_DEFAULT_JOB_QUEUE_MAX_RUNNING             2
+#define GLEWLWYD_DEFAULT_PASSWORD_POOL_WORKERS             4
+#define GLEWLWYD_DEFAULT_PASSWORD_POOL_SIZE                64
+#define GLEWLWYD_DEFAULT_PURGE_INTERVAL                    3600
+#define GLEWLWYD_DEFAULT_PURGE_RETENTION                   86400
+#define GLEWLWYD_DEFAULT_PURGE_BATCH_SIZE                  500
+#define GLEWLWYD_DEFAULT_PURGE_BATCH_DELAY                 100
+#define GLEWLWYD_DEFAULT_COMPRESSION_LEVEL                1
+#define GLEWLWYD_DEFAULT_COMPRESSION_MIN_SIZE             1024 // bytes
+#define GLEWLWYD_PURGE_CORE_NAME                           "glewlwyd"
 
 #define GLEWLWYD_DEFAULT_SESSION_EXPIRATION_PASSWORD       40320   // 4 weeks
 #define GLEWLWYD_RESET_PASSWORD_DEFAULT_SESSION_EXPIRATION 2592000 // 30 days
@@ -148,11 +171,39 @@
 #define GLEWLWYD_ENV_DATABASE_MARIADB_PORT        "GLWD_DATABASE_MARIADB_PORT"
 #define GLEWLWYD_ENV_DATABASE_SQLITE3_PATH        "GLWD_DATABASE_SQLITE3_PATH"
 #define GLEWLWYD_ENV_DATABASE_POSTGRE_CONNINFO    "GLWD_DATABASE_POSTGRE_CONNINFO"
+#define GLEWLWYD_ENV_DATABASE_POOL_SIZE           "GLWD_DATABASE_POOL_SIZE"
+#define GLEWLWYD_ENV_DATABASE_POOL_MAX_WAIT       "GLWD_DATABASE_POOL_MAX_WAIT"
+#define GLEWLWYD_ENV_USER_CACHE_SIZE              "GLWD_USER_CACHE_SIZE"
+#define GLEWLWYD_ENV_USER_CACHE_TTL               "GLWD_USER_CACHE_TTL"
+#define GLEWLWYD_ENV_CLIENT_CACHE_SIZE            "GLWD_CLIENT_CACHE_SIZE"
+#define GLEWLWYD_ENV_CLIENT_CACHE_TTL             "GLWD_CLIENT_CACHE_TTL"
+#define GLEWLWYD_ENV_CLIENT_CACHE_NEGATIVE_TTL    "GLWD_CLIENT_CACHE_NEGATIVE_TTL"
+#define GLEWLWYD_ENV_GEOLOCATION_CACHE_SIZE       "GLWD_GEOLOCATION_CACHE_SIZE"
+#define GLEWLWYD_ENV_GEOLOCATION_CACHE_TTL        "GLWD_GEOLOCATION_CACHE_TTL"
+#define GLEWLWYD_ENV_GEOLOCATION_CACHE_NEGATIVE_TTL "GLWD_GEOLOCATION_CACHE_NEGATIVE_TTL"
+#define GLEWLWYD_ENV_GEOLOCATION_CACHE_PREFIX_IPV4  "GLWD_GEOLOCATION_CACHE_PREFIX_IPV4"
+#define GLEWLWYD_ENV_GEOLOCATION_CACHE_PREFIX_IPV6  "GLWD_GEOLOCATION_CACHE_PREFIX_IPV6"
+#define GLEWLWYD_ENV_JOB_QUEUE_WORKERS            "GLWD_JOB_QUEUE_WORKERS"
+#define GLEWLWYD_ENV_JOB_QUEUE_SIZE               "GLWD_JOB_QUEUE_SIZE"
+#define GLEWLWYD_ENV_JOB_QUEUE_OVERFLOW           "GLWD_JOB_QUEUE_OVERFLOW"
+#define GLEWLWYD_ENV_JOB_QUEUE_MAIL_MAX_RUNNING   "GLWD_JOB_QUEUE_MAIL_MAX_RUNNING"
+#define GLEWLWYD_ENV_JOB_QUEUE_GEOLOCATION_MAX_RUNNING  "GLWD_JOB_QUEUE_GEOLOCATION_MAX_RUNNING"
+#define GLEWLWYD_ENV_JOB_QUEUE_NOTIFICATION_MAX_RUNNING "GLWD_JOB_QUEUE_NOTIFICATION_MAX_RUNNING"
+#define GLEWLWYD_ENV_JOB_QUEUE_DATABASE_MAX_RUNNING     "GLWD_JOB_QUEUE_DATABASE_MAX_RUNNING"
+#define GLEWLWYD_ENV_PASSWORD_POOL_WORKERS        "GLWD_PASSWORD_POOL_WORKERS"
+#define GLEWLWYD_ENV_PASSWORD_POOL_SIZE           "GLWD_PASSWORD_POOL_SIZE"
+#define GLEWLWYD_ENV_PURGE_INTERVAL               "GLWD_PURGE_INTERVAL"
+#define GLEWLWYD_ENV_PURGE_RETENTION              "GLWD_PURGE_RETENTION"
+#define GLEWLWYD_ENV_PURGE_BATCH_SIZE             "GLWD_PURGE_BATCH_SIZE"
+#define GLEWLWYD_ENV_PURGE_BATCH_DELAY            "GLWD_PURGE_BATCH_DELAY"
 #define GLEWLWYD_ENV_METRICS                      "GLWD_METRICS"
 #define GLEWLWYD_ENV_METRICS_PORT                 "GLWD_METRICS_PORT"
 #define GLEWLWYD_ENV_METRICS_ADMIN                "GLWD_METRICS_ADMIN"
 #define GLEWLWYD_ENV_METRICS_BIND_ADDRESS         "GLWD_METRICS_BIND_ADDRESS"
+#define GLEWLWYD_ENV_METRICS_LATENCY_BUCKETS      "GLWD_METRICS_LATENCY_BUCKETS"
 #define GLEWLWYD_ENV_RESPONSE_ALLOWED_COMPRESSION "GLWD_RESPONSE_ALLOWED_COMPRESSION"
+#define GLEWLWYD_ENV_RESPONSE_COMPRESSION_LEVEL   "GLWD_RESPONSE_COMPRESSION_LEVEL"
+#define GLEWLWYD_ENV_RESPONSE_COMPRESSION_MIN_SIZE "GLWD_RESPONSE_COMPRESSION_MIN_SIZE"
 #define GLEWLWYD_ENV_ADMIN_SESSION_AUTH           "GLWD_ADMIN_SESSION_AUTH"
 #define GLEWLWYD_ENV_PROFILE_SESSION_AUTH         "GLWD_PROFILE_SESSION_AUTH"
 #define GLEWLWYD_ENV_MULTIPLE_USER_SESSION        "GLWD_MULTIPLE_USER_SESSION"
@@ -203,9 +254,11 @@ struct _user_auth_scheme_module * get_user_auth_scheme_module_lib(struct config_
 struct _plugin_module_instance * get_plugin_module_instance(struct config_elements * config, const char * name);
 struct _plugin_module * get_plugin_module_lib(struct config_elements * config, const char * name);
 char * get_ip_data(struct config_elements * config, const char * ip_address);
+void reset_ip_geolocation_config(struct config_elements * config);
 const char * get_template_property(json_t * j_params, const char * template_property, const char * user_lang, const char * property_field);
 char * complete_template(const char * template, ...);
-void * thread_send_mail(void * args);
+void run_send_mail(void * args);
+void free_send_mail(void * args);
 int is_plugin_api_run_enabled (struct config_elements * config, const char * name);
 
 // Modules generic functions
@@ -249,6 +302,7 @@ int user_has_scheme(struct config_elements * config, const char * username, cons
 json_t * auth_check_client_credentials(struct config_elements * config, const char * client_id, const char * password);
 
 // Scope
+int update_scope_graph(struct config_elements * config);
 json_t * get_auth_scheme_list_from_scope(struct config_elements * config, const char * scope);
 json_t * get_auth_scheme_list_from_scope_list(struct config_elements * config, const char * scope_list);
 json_t * get_validated_auth_scheme_list_from_scope_list(struct config_elements * config, const char * scope_list, const char * session_uid);
@@ -264,6 +318,7 @@ json_t * get_module_type_list(struct config_elements * config);
 
 // User module functions
 json_t * get_user_module_list(struct config_elements * config);
+int update_user_module_snapshot(struct config_elements * config);
 json_t * get_user_module(struct config_elements * config, const char * name);
 json_t * is_user_module_valid(struct config_elements * config, json_t * j_module, int add);
 json_t * add_user_module(struct config_elements * config, json_t * j_module);
@@ -297,6 +352,7 @@ void close_user_auth_scheme_module_list(struct config_elements * config);
 
 // Client module functions
 json_t * get_client_module_list(struct config_elements * config);
+int update_client_module_snapshot(struct config_elements * config);
 json_t * get_client_module(struct config_elements * config, const char * name);
 json_t * is_client_module_valid(struct config_elements * config, json_t * j_module, int add);
 json_t * add_client_module(struct config_elements * config, json_t * j_module);
@@ -330,6 +386,7 @@ time_t glewlwyd_callback_get_session_age(struct config_plugin * config, const st
 char * glewlwyd_callback_get_login_url(struct config_plugin * config, const char * client_id, const char * scope_list, const char * callback_url, struct _u_map * additional_parameters);
 char * glewlwyd_callback_get_plugin_external_url(struct config_plugin * config, const char * name);
 char * glewlwyd_callback_generate_hash(struct config_plugin * config, const char * data);
+int glewlwyd_callback_generate_hash_buffer(struct config_plugin * config, const char * data, char * out_hash, size_t out_hash_size);
 void glewlwyd_callback_update_issued_for(struct config_plugin * config, const struct _h_connection * conn, const char * sql_table, const char * issued_for_column, const char * issued_for_value, const char * id_column, json_int_t id_value);
 json_t * glewlwyd_plugin_callback_get_user_list(struct config_plugin * config, const char * pattern, size_t offset, size_t limit);
 json_t * glewlwyd_plugin_callback_get_user(struct config_plugin * config, const char * username);
@@ -409,8 +466,84 @@ void free_glwd_metrics(void * data);
 int glewlwyd_metrics_add_metric(struct config_elements * config, const char * name, const char * help);
 int glewlwyd_metrics_increment_counter_va(struct config_elements * config, const char * name, size_t inc, ...);
 int glewlwyd_metrics_increment_counter(struct config_elements * config, const char * name, const char * label, size_t inc);
+struct _glwd_metrics_data * glewlwyd_metrics_get_counter(struct config_elements * config, const char * name, const char * label);
+void glewlwyd_metrics_counter_add(struct _glwd_metrics_data * data, size_t inc);
+size_t glewlwyd_metrics_counter_value(struct _glwd_metrics_data * data);
+int glewlwyd_metrics_add_metric_type(struct config_elements * config, const char * name, const char * help, unsigned short type, const double * bucket_list, size_t bucket_size);
+void glewlwyd_metrics_gauge_add(struct _glwd_metrics_data * data, long inc);
+void glewlwyd_metrics_histogram_observe(struct _glwd_metrics_data * data, double value);
+int glewlwyd_metrics_parse_buckets(const char * str_buckets, double ** bucket_list, size_t * bucket_size);
+char * glewlwyd_metrics_get_content(struct config_elements * config);
+int glewlwyd_add_timed_endpoint(struct config_elements * config, const char * plugin_name, const char * http_method, const char * url_prefix, const char * url_format, unsigned int priority, int (* callback_function)(const struct _u_request * request, struct _u_response * response, void * user_data), void * user_data);
 char * glewlwyd_metrics_build_label(va_list vl_label);
 
+// In-memory cache functions
+int glewlwyd_cache_init(struct _glwd_cache * cache, const char * name, size_t max_entries, unsigned int ttl);
+void glewlwyd_cache_close(struct _glwd_cache * cache);
+json_t * glewlwyd_cache_get(struct _glwd_cache * cache, const char * key);
+int glewlwyd_cache_set(struct _glwd_cache * cache, const char * key, json_t * j_value, unsigned int ttl);
+size_t glewlwyd_cache_get_generation(struct _glwd_cache * cache, const char * key);
+int glewlwyd_cache_set_if_generation(struct _glwd_cache * cache, const char * key, json_t * j_value, unsigned int ttl, size_t generation);
+void glewlwyd_cache_remove(struct _glwd_cache * cache, const char * key);
+void glewlwyd_cache_clear(struct _glwd_cache * cache);
+char * glewlwyd_cache_metrics(struct config_elements * config);
+
+// Background job queue functions
+int glewlwyd_job_queue_init(struct config_elements * config);
+void glewlwyd_job_queue_close(struct config_elements * config);
+int glewlwyd_job_queue_submit(struct config_elements * config, unsigned int type, const char * key, void * owner, void (* run)(void * data), void (* cancel)(void * data), void * data);
+void glewlwyd_job_queue_cancel_owner(struct config_elements * config, void * owner);
+char * glewlwyd_job_queue_metrics(struct config_elements * config);
+int glewlwyd_callback_job_submit(struct config_plugin * config, unsigned int type, const char * key, void * owner, void (* run)(void * data), void (* cancel)(void * data), void * data);
+void glewlwyd_callback_job_cancel(struct config_plugin * config, void * owner);
+int glewlwyd_module_callback_job_submit(struct config_module * config, unsigned int type, const char * key, void * owner, void (* run)(void * data), void (* cancel)(void * data), void * data);
+void glewlwyd_module_callback_job_cancel(struct config_module * config, void * owner);
+
+// Password verification pool functions
+int glewlwyd_password_pool_init(struct config_elements * config);
+void glewlwyd_password_pool_close(struct config_elements * config);
+int glewlwyd_password_pool_check(struct config_elements * config, int (* check)(void * data), void * data);
+size_t glewlwyd_password_pool_reserve_helper(struct config_elements * config, size_t nb);
+void glewlwyd_password_pool_release_helper(struct config_elements * config, size_t nb);
+size_t glewlwyd_module_callback_password_pool_reserve_helper(struct config_module * config, size_t nb);
+void glewlwyd_module_callback_password_pool_release_helper(struct config_module * config, size_t nb);
+char * glewlwyd_password_pool_metrics(struct config_elements * config);
+
+// Expired rows purge functions
+int glewlwyd_purge_init(struct config_elements * config);
+void glewlwyd_purge_close(struct config_elements * config);
+int glewlwyd_purge_add_task(struct config_elements * config, const char * name, const char * table, const char * id_column, const char * plugin_column, const char * date_column, unsigned int extra_retention, const char * condition);
+void glewlwyd_purge_remove_task(struct config_elements * config, const char * name);
+char * glewlwyd_purge_metrics(struct config_elements * config);
+int glewlwyd_callback_purge_add_task(struct config_plugin * config, const char * name, const char * table, const char * id_column, const char * plugin_column, const char * date_column, unsigned int extra_retention, const char * condition);
+void glewlwyd_callback_purge_remove_task(struct config_plugin * config, const char * name);
+
+// Offline geolocation database functions
+char * glewlwyd_geolocation_db_lookup(struct config_elements * config, const char * path, const char * ip_address, const char * output_properties);
+void glewlwyd_geolocation_db_close(struct config_elements * config);
+
+// Database connection pool functions
+int glewlwyd_db_pool_set_parameters(struct _glwd_db_pool * pool, int type, const char * path, const char * host, const char * user, const char * password, const char * dbname, unsigned int port);
+int glewlwyd_db_pool_init(struct config_elements * config);
+void glewlwyd_db_pool_close(struct config_elements * config);
+struct _h_connection * glewlwyd_db_pool_checkout(struct config_elements * config);
+void glewlwyd_db_pool_checkin(struct config_elements * config, struct _h_connection * conn);
+int glewlwyd_db_pool_is_pool_connection(struct config_elements * config, const struct _h_connection * conn);
+char * glewlwyd_db_pool_metrics(struct config_elements * config);
+int glewlwyd_db_insert(struct config_elements * config, const struct _h_connection * conn, const json_t * j_query, const char * id_column, json_t ** j_last_id);
+void glewlwyd_db_insert_begin(struct config_elements * config, const struct _h_connection * conn);
+void glewlwyd_db_insert_end(struct config_elements * config, const struct _h_connection * conn);
+struct _h_connection * glewlwyd_callback_db_checkout(struct config_plugin * config);
+void glewlwyd_callback_db_checkin(struct config_plugin * config, struct _h_connection * conn);
+int glewlwyd_callback_db_insert(struct config_plugin * config, const struct _h_connection * conn, const json_t * j_query, const char * id_column, json_t ** j_last_id);
+void glewlwyd_callback_db_insert_begin(struct config_plugin * config, const struct _h_connection * conn);
+void glewlwyd_callback_db_insert_end(struct config_plugin * config, const struct _h_connection * conn);
+struct _h_connection * glewlwyd_module_callback_db_checkout(struct config_module * config);
+void glewlwyd_module_callback_db_checkin(struct config_module * config, struct _h_connection * conn);
+int glewlwyd_module_callback_db_insert(struct config_module * config, const struct _h_connection * conn, const json_t * j_query, const char * id_column, json_t ** j_last_id);
+void glewlwyd_module_callback_db_insert_begin(struct config_module * config, const struct _h_connection * conn);
+void glewlwyd_module_callback_db_insert_end(struct config_module * config, const struct _h_connection * conn);
+
 // Callback functions
 int callback_glewlwyd_check_user_session (const struct _u_request * request, struct _u_response * response, void * user_data);
 int callback_glewlwyd_check_admin_session (const struct _u_request * request, struct _u_response * response, void * user_data);
@@ -4,9 +4,9 @@
  *
  * Copyright 2020-2022 Nicolas Mora <mail@babelouest.org>
  *
- * Version 20221024
+ * Version 20261018
  *
- * Compress the response body using `deflate` or `gzip` depending on the request header `Accept-Encoding` and the callback configuration.
+ * Compress the response body using `zstd`, `br`, `gzip` or `deflate` depending on the request header `Accept-Encoding` and the callback configuration.
  * The rest of the response, status, headers, cookies won't change.
  * After compressing response body, the response header Content-Encoding will be set accordingly.
  *
@@ -35,23 +35,35 @@
 #include <string.h>
 #include <ulfius.h>
 #include <zlib.h>
+#ifdef U_WITH_ZSTD
+#include <zstd.h>
+#endif
+#ifdef U_WITH_BROTLI
+#include <brotli/encode.h>
+#endif
 
-#include "http_compression_callback.h"
+#include "glewlwyd-common.h"
 
-#define U_COMPRESS_NONE 0
-#define U_COMPRESS_GZIP 1
-#define U_COMPRESS_DEFL 2
+#define U_COMPRESS_NONE   0
+#define U_COMPRESS_GZIP   1
+#define U_COMPRESS_DEFL   2
+#define U_COMPRESS_ZSTD   3
+#define U_COMPRESS_BROTLI 4
 
 #define U_ACCEPT_HEADER  "Accept-Encoding"
 #define U_CONTENT_HEADER "Content-Encoding"
+#define U_VARY_HEADER    "Vary"
 
 #define U_ACCEPT_GZIP    "gzip"
 #define U_ACCEPT_DEFLATE "deflate"
+#define U_ACCEPT_ZSTD    "zstd"
+#define U_ACCEPT_BROTLI  "br"
 
 #define U_GZIP_WINDOW_BITS 15
 #define U_GZIP_ENCODING    16
 
-#define CHUNK 0x4000
+#define U_ZSTD_MAX_LEVEL   19
+#define U_BROTLI_MAX_LEVEL 11
 
 static void * u_zalloc(void * q, unsigned n, unsigned m) {
   (void)q;
@@ -63,74 +75,205 @@ static void u_zfree(void *q, void *p) {
   o_free(p);
 }
 
+static int compress_zlib(const char * data, size_t data_len, int gzip, int level, char ** data_zip, size_t * data_zip_len) {
+  z_stream defstream;
+  int ret = U_OK, res;
+  uLong bound;
+
+  memset(&defstream, 0, sizeof(z_stream));
+  defstream.zalloc = u_zalloc;
+  defstream.zfree = u_zfree;
+  defstream.opaque = Z_NULL;
+  if (gzip) {
+    res = deflateInit2(&defstream, level, Z_DEFLATED, U_GZIP_WINDOW_BITS | U_GZIP_ENCODING, 8, Z_DEFAULT_STRATEGY);
+  } else {
+    res = deflateInit(&defstream, level);
+  }
+  if (res == Z_OK) {
+    bound = deflateBound(&defstream, (uLong)data_len);
+    if ((*data_zip = o_malloc((size_t)bound)) != NULL) {
+      defstream.avail_in = (uInt)data_len;
+      defstream.next_in = (Bytef *)data;
+      defstream.avail_out = (uInt)bound;
+      defstream.next_out = (Bytef *)*data_zip;
+      if ((res = deflate(&defstream, Z_FINISH)) == Z_STREAM_END) {
+        *data_zip_len = (size_t)defstream.total_out;
+      } else {
+        y_log_message(Y_LOG_LEVEL_ERROR, "callback_http_compression - Error deflate %d", res);
+        ret = U_ERROR;
+      }
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "callback_http_compression - Error allocating resources for data_zip");
+      ret = U_ERROR_MEMORY;
+    }
+    deflateEnd(&defstream);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "callback_http_compression - Error deflateInit (%s)", gzip?"gzip":"deflate");
+    ret = U_ERROR;
+  }
+  return ret;
+}
+
+#ifdef U_WITH_ZSTD
+static int compress_zstd(const char * data, size_t data_len, int level, char ** data_zip, size_t * data_zip_len) {
+  size_t bound = ZSTD_compressBound(data_len), res;
+  int ret = U_OK;
+
+  if ((*data_zip = o_malloc(bound)) != NULL) {
+    res = ZSTD_compress(*data_zip, bound, data, data_len, level);
+    if (!ZSTD_isError(res)) {
+      *data_zip_len = res;
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "callback_http_compression - Error ZSTD_compress: %s", ZSTD_getErrorName(res));
+      ret = U_ERROR;
+    }
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "callback_http_compression - Error allocating resources for data_zip");
+    ret = U_ERROR_MEMORY;
+  }
+  return ret;
+}
+#endif
+
+#ifdef U_WITH_BROTLI
+static int compress_brotli(const char * data, size_t data_len, int level, char ** data_zip, size_t * data_zip_len) {
+  size_t bound = BrotliEncoderMaxCompressedSize(data_len);
+  int ret = U_OK;
+
+  if (bound && (*data_zip = o_malloc(bound)) != NULL) {
+    *data_zip_len = bound;
+    if (!BrotliEncoderCompress(level, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, data_len, (const uint8_t *)data, data_zip_len, (uint8_t *)*data_zip)) {
+      y_log_message(Y_LOG_LEVEL_ERROR, "callback_http_compression - Error BrotliEncoderCompress");
+      ret = U_ERROR;
+    }
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "callback_http_compression - Error allocating resources for data_zip");
+    ret = U_ERROR_MEMORY;
+  }
+  return ret;
+}
+#endif
+
+/**
+ * Maps the level from 1 (fastest) to 9 (best compression) to the range of the algorithm
+ * zstd levels above U_ZSTD_MAX_LEVEL are too slow to compress responses
+ */
+static int get_codec_level(int compress_mode, int level) {
+  int codec_level;
+
+  switch (compress_mode) {
+    case U_COMPRESS_ZSTD:
+      codec_level = 1 + ((level-1)*(U_ZSTD_MAX_LEVEL-1))/8;
+      break;
+    case U_COMPRESS_BROTLI:
+      codec_level = 1 + ((level-1)*(U_BROTLI_MAX_LEVEL-1))/8;
+      break;
+    default:
+      codec_level = level;
+      break;
+  }
+  return codec_level;
+}
+
+/**
+ * Adds Accept-Encoding to the Vary header of the response, the values already set are kept
+ */
+static void add_vary_accept_encoding(struct _u_response * response) {
+  const char * vary = u_map_get_case(response->map_header, U_VARY_HEADER);
+  char ** vary_list = NULL, * new_vary;
+  size_t i;
+  int has_value = 0;
+
+  if (o_strnullempty(vary)) {
+    u_map_put(response->map_header, U_VARY_HEADER, U_ACCEPT_HEADER);
+  } else {
+    if (split_string(vary, ",", &vary_list)) {
+      for (i=0; vary_list[i]!=NULL && !has_value; i++) {
+        has_value = (0 == o_strcasecmp(trimwhitespace(vary_list[i]), U_ACCEPT_HEADER) || 0 == o_strcmp(trimwhitespace(vary_list[i]), "*"));
+      }
+    }
+    free_string_array(vary_list);
+    if (!has_value) {
+      new_vary = msprintf("%s, %s", vary, U_ACCEPT_HEADER);
+      u_map_put(response->map_header, U_VARY_HEADER, new_vary);
+      o_free(new_vary);
+    }
+  }
+}
+
 int callback_http_compression (const struct _u_request * request, struct _u_response * response, void * user_data) {
   struct _http_compression_config * config = (struct _http_compression_config *)user_data;
   char ** accept_list = NULL;
-  int ret = U_CALLBACK_IGNORE, compress_mode = U_COMPRESS_NONE, res;
-  z_stream defstream;
+  int ret = U_CALLBACK_IGNORE, compress_mode = U_COMPRESS_NONE, res = U_ERROR, level = config!=NULL?config->level:U_COMPRESSION_DEFAULT_LEVEL;
+  size_t min_size = config!=NULL?config->min_size:U_COMPRESSION_DEFAULT_MIN_SIZE;
   char * data_zip = NULL;
   size_t data_zip_len = 0;
 
-  if (response->binary_body_length && u_map_has_key_case(request->map_header, U_ACCEPT_HEADER)) {
+  if (level < 1 || level > 9) {
+    level = U_COMPRESSION_DEFAULT_LEVEL;
+  }
+  if (response->binary_body_length && response->binary_body_length >= min_size && !u_map_has_key_case(response->map_header, U_CONTENT_HEADER) && u_map_has_key_case(request->map_header, U_ACCEPT_HEADER)) {
     if (split_string(u_map_get_case(request->map_header, U_ACCEPT_HEADER), ",", &accept_list)) {
-      if ((config == NULL || config->allow_gzip) && string_array_has_trimmed_value((const char **)accept_list, U_ACCEPT_GZIP)) {
-        compress_mode = U_COMPRESS_GZIP;
-      } else if ((config == NULL || config->allow_deflate) && string_array_has_trimmed_value((const char **)accept_list, U_ACCEPT_DEFLATE)) {
-        compress_mode = U_COMPRESS_DEFL;
+#ifdef U_WITH_ZSTD
+      if ((config == NULL || config->allow_zstd) && accept_list_has_coding(accept_list, U_ACCEPT_ZSTD)) {
+        compress_mode = U_COMPRESS_ZSTD;
+      }
+#endif
+#ifdef U_WITH_BROTLI
+      if (compress_mode == U_COMPRESS_NONE && (config == NULL || config->allow_brotli) && accept_list_has_coding(accept_list, U_ACCEPT_BROTLI)) {
+        compress_mode = U_COMPRESS_BROTLI;
+      }
+#endif
+      if (compress_mode == U_COMPRESS_NONE) {
+        if ((config == NULL || config->allow_gzip) && accept_list_has_coding(accept_list, U_ACCEPT_GZIP)) {
+          compress_mode = U_COMPRESS_GZIP;
+        } else if ((config == NULL || config->allow_deflate) && accept_list_has_coding(accept_list, U_ACCEPT_DEFLATE)) {
+          compress_mode = U_COMPRESS_DEFL;
+        }
+      }
+
+      switch (compress_mode) {
+        case U_COMPRESS_GZIP:
+        case U_COMPRESS_DEFL:
+          res = compress_zlib((const char *)response->binary_body, response->binary_body_length, compress_mode==U_COMPRESS_GZIP, get_codec_level(compress_mode, level), &data_zip, &data_zip_len);
+          break;
+#ifdef U_WITH_ZSTD
+        case U_COMPRESS_ZSTD:
+          res = compress_zstd((const char *)response->binary_body, response->binary_body_length, get_codec_level(compress_mode, level), &data_zip, &data_zip_len);
+          break;
+#endif
+#ifdef U_WITH_BROTLI
+        case U_COMPRESS_BROTLI:
+          res = compress_brotli((const char *)response->binary_body, response->binary_body_length, get_codec_level(compress_mode, level), &data_zip, &data_zip_len);
+          break;
+#endif
+        default:
+          break;
       }
 
       if (compress_mode != U_COMPRESS_NONE) {
-        defstream.zalloc = u_zalloc;
-        defstream.zfree = u_zfree;
-        defstream.opaque = Z_NULL;
-        defstream.avail_in = (uInt)response->binary_body_length;
-        defstream.next_in = (Bytef *)response->binary_body;
-
-        if (compress_mode == U_COMPRESS_GZIP) {
-          if (deflateInit2(&defstream, 
-                           Z_BEST_COMPRESSION, 
-                           Z_DEFLATED,
-                           U_GZIP_WINDOW_BITS | U_GZIP_ENCODING,
-                           8,
-                           Z_DEFAULT_STRATEGY) != Z_OK) {
-            y_log_message(Y_LOG_LEVEL_ERROR, "callback_http_compression - Error deflateInit (gzip)");
-            ret = U_CALLBACK_ERROR;
-          }
-        } else {
-          if (deflateInit(&defstream, Z_BEST_COMPRESSION) != Z_OK) {
-            y_log_message(Y_LOG_LEVEL_ERROR, "callback_http_compression - Error deflateInit (deflate)");
-            ret = U_CALLBACK_ERROR;
-          }
-        }
-        if (ret == U_CALLBACK_IGNORE) {
-          do {
-            if ((data_zip = o_realloc(data_zip, data_zip_len+_U_C_BLOCK_SIZE)) != NULL) {
-              defstream.avail_out = _U_C_BLOCK_SIZE;
-              defstream.next_out = ((Bytef *)data_zip)+data_zip_len;
-              switch ((res = deflate(&defstream, Z_FINISH))) {
-                case Z_OK:
-                case Z_STREAM_END:
-                case Z_BUF_ERROR:
-                  break;
-                default:
-                  y_log_message(Y_LOG_LEVEL_ERROR, "callback_http_compression - Error deflate %d", res);
-                  ret = U_CALLBACK_ERROR;
-                  break;
-              }
-              data_zip_len += _U_C_BLOCK_SIZE - defstream.avail_out;
-            } else {
-              y_log_message(Y_LOG_LEVEL_ERROR, "callback_http_compression - Error allocating resources for data_zip");
-              ret = U_CALLBACK_ERROR;
-            }
-          } while (U_CALLBACK_IGNORE == ret && defstream.avail_out == 0);
-
-          if (ret == U_CALLBACK_IGNORE) {
-            ulfius_set_binary_body_response(response, (unsigned int)response->status, (const char *)data_zip, defstream.total_out);
-            u_map_put(response->map_header, U_CONTENT_HEADER, compress_mode==U_COMPRESS_GZIP?U_ACCEPT_GZIP:U_ACCEPT_DEFLATE);
+        add_vary_accept_encoding(response);
+        if (res != U_OK) {
+          ret = U_CALLBACK_ERROR;
+        } else if (data_zip_len < response->binary_body_length) {
+          // The compressed body is sent only if it's smaller than the original one
+          ulfius_set_binary_body_response(response, (unsigned int)response->status, (const char *)data_zip, data_zip_len);
+          switch (compress_mode) {
+            case U_COMPRESS_GZIP:
+              u_map_put(response->map_header, U_CONTENT_HEADER, U_ACCEPT_GZIP);
+              break;
+            case U_COMPRESS_DEFL:
+              u_map_put(response->map_header, U_CONTENT_HEADER, U_ACCEPT_DEFLATE);
+              break;
+            case U_COMPRESS_ZSTD:
+              u_map_put(response->map_header, U_CONTENT_HEADER, U_ACCEPT_ZSTD);
+              break;
+            case U_COMPRESS_BROTLI:
+              u_map_put(response->map_header, U_CONTENT_HEADER, U_ACCEPT_BROTLI);
+              break;
           }
-          deflateEnd(&defstream);
-          o_free(data_zip);
         }
+        o_free(data_zip);
       }
     }
     free_string_array(accept_list);
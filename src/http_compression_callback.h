@@ -35,21 +35,33 @@
 #ifndef _U_HTTP_COMPRESSION
 #define _U_HTTP_COMPRESSION
 
-#define _U_C_BLOCK_SIZE 256
+#define U_COMPRESSION_DEFAULT_LEVEL    1
+#define U_COMPRESSION_DEFAULT_MIN_SIZE 1024
 
 /**
- * If both values are set to true, the first compression algorithm used will be gzip
+ * If several values are set to true, the compression algorithm used will be
+ * the first one accepted by the client in the order zstd, br, gzip, deflate
+ * allow_zstd and allow_brotli are used only if the file is built with
+ * U_WITH_ZSTD or U_WITH_BROTLI
+ * level is the compression level, from 1 (fastest) to 9 (best compression),
+ * it's mapped to the range of each algorithm: 1 to 9 for gzip and deflate,
+ * 1 to 19 for zstd and 1 to 11 for brotli
+ * Responses smaller than min_size bytes aren't compressed
  */
 struct _http_compression_config {
-  int allow_gzip;
-  int allow_deflate;
+  int    allow_gzip;
+  int    allow_deflate;
+  int    allow_zstd;
+  int    allow_brotli;
+  int    level;
+  size_t min_size;
 };
 
 /**
- * Compress response->binary_body using gzip or deflate algorithm
+ * Compress response->binary_body using zstd, brotli, gzip or deflate algorithm
  * depending on the request header Accept-Encoding and the
  * struct _http_compression_config configuration value
- * If user_data is NULL, it will considered as allow_gzip and allow_deflate to true
+ * If user_data is NULL, all algorithms are allowed with the default level and minimum size
  * After compressing response body, will set response header Content-Encoding accordingly
  */
 int callback_http_compression (const struct _u_request * request, struct _u_response * response, void * user_data);
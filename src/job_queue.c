@@ -0,0 +1,409 @@
+/**
+ *
+ * Glewlwyd SSO Server
+ *
+ * Authentiation server
+ * Users are authenticated via various backend available: database, ldap
+ * Using various authentication methods available: password, OTP, send code, etc.
+ *
+ * Background job queue functions definitions
+ *
+ * Copyright 2016-2021 Nicolas Mora <mail@babelouest.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU GENERAL PUBLIC LICENSE
+ * License as published by the Free Software Foundation;
+ * version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU GENERAL PUBLIC LICENSE for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "glewlwyd.h"
+
+static const char * job_type_name[GLEWLWYD_JOB_NB_TYPE] = {"mail", "geolocation", "notification", "database"};
+
+/**
+ * Job waiting in the queue, data is owned by the job until run or cancel is called
+ * owner identifies the plugin or module instance whose jobs must be cancelled when it's closed
+ */
+struct _glwd_job {
+  unsigned int       type;
+  char             * key;
+  void             * owner;
+  void            (* run)(void * data);
+  void            (* cancel)(void * data);
+  void             * data;
+  struct timespec    queued_at;
+  struct _glwd_job * next;
+};
+
+static void glewlwyd_job_free(struct _glwd_job * job, int cancel) {
+  if (cancel && job->cancel != NULL) {
+    job->cancel(job->data);
+  }
+  o_free(job->key);
+  o_free(job);
+}
+
+/**
+ * Removes from the queue the first job whose type has not reached its maximum number of running jobs
+ * The queue lock must be held
+ */
+static struct _glwd_job * glewlwyd_job_queue_pop(struct _glwd_job_queue * queue) {
+  struct _glwd_job * job, * prev = NULL;
+
+  for (job = queue->head; job != NULL; prev = job, job = job->next) {
+    if (!queue->max_running[job->type] || queue->nb_running[job->type] < queue->max_running[job->type]) {
+      if (prev != NULL) {
+        prev->next = job->next;
+      } else {
+        queue->head = job->next;
+      }
+      if (queue->tail == job) {
+        queue->tail = prev;
+      }
+      job->next = NULL;
+      queue->nb_queued[job->type]--;
+      queue->size--;
+      break;
+    }
+  }
+  return job;
+}
+
+static void * glewlwyd_job_queue_worker(void * args) {
+  struct _glwd_job_queue * queue = (struct _glwd_job_queue *)args;
+  struct _glwd_job * job, ** cur_job;
+  struct timespec now;
+  unsigned int type;
+
+  pthread_mutex_lock(&queue->lock);
+  while (!queue->stop) {
+    if ((job = glewlwyd_job_queue_pop(queue)) != NULL) {
+      type = job->type;
+      queue->nb_running[type]++;
+      job->next = queue->running_head;
+      queue->running_head = job;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      queue->wait_usec[type] += (unsigned long long)((now.tv_sec - job->queued_at.tv_sec)*1000000 + (now.tv_nsec - job->queued_at.tv_nsec)/1000);
+      pthread_mutex_unlock(&queue->lock);
+      job->run(job->data);
+      pthread_mutex_lock(&queue->lock);
+      for (cur_job = &queue->running_head; *cur_job != NULL; cur_job = &(*cur_job)->next) {
+        if (*cur_job == job) {
+          *cur_job = job->next;
+          break;
+        }
+      }
+      glewlwyd_job_free(job, 0);
+      queue->nb_running[type]--;
+      queue->nb_done[type]++;
+      // A job of this type may have been waiting for a free slot, or an owner waiting for its jobs to end
+      pthread_cond_broadcast(&queue->cond);
+    } else {
+      pthread_cond_wait(&queue->cond, &queue->lock);
+    }
+  }
+  pthread_mutex_unlock(&queue->lock);
+  return NULL;
+}
+
+int glewlwyd_job_queue_init(struct config_elements * config) {
+  struct _glwd_job_queue * queue = &config->job_queue;
+  int ret = G_OK;
+  unsigned int i;
+
+  queue->head = NULL;
+  queue->tail = NULL;
+  queue->running_head = NULL;
+  queue->size = 0;
+  queue->stop = 0;
+  queue->nb_started = 0;
+  memset(queue->nb_running, 0, sizeof(queue->nb_running));
+  memset(queue->nb_queued, 0, sizeof(queue->nb_queued));
+  memset(queue->nb_done, 0, sizeof(queue->nb_done));
+  memset(queue->nb_dropped, 0, sizeof(queue->nb_dropped));
+  memset(queue->nb_coalesced, 0, sizeof(queue->nb_coalesced));
+  memset(queue->wait_usec, 0, sizeof(queue->wait_usec));
+  if (!queue->nb_worker || !queue->max_size) {
+    y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_job_queue_init - Error invalid parameters");
+    ret = G_ERROR_PARAM;
+  } else if (pthread_mutex_init(&queue->lock, NULL) || pthread_cond_init(&queue->cond, NULL)) {
+    y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_job_queue_init - Error initializing lock or cond");
+    ret = G_ERROR;
+  } else if ((queue->worker_list = o_malloc(queue->nb_worker*sizeof(pthread_t))) == NULL) {
+    y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_job_queue_init - Error allocating resources for worker_list");
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->cond);
+    ret = G_ERROR_MEMORY;
+  } else {
+    queue->initialized = 1;
+    for (i=0; i<queue->nb_worker; i++) {
+      if (pthread_create(&queue->worker_list[i], NULL, glewlwyd_job_queue_worker, queue)) {
+        y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_job_queue_init - Error pthread_create");
+        ret = G_ERROR;
+        break;
+      }
+      queue->nb_started++;
+    }
+    if (ret != G_OK) {
+      glewlwyd_job_queue_close(config);
+    }
+  }
+  return ret;
+}
+
+/**
+ * Stops the workers after their current job, the jobs still in the queue are cancelled
+ */
+void glewlwyd_job_queue_close(struct config_elements * config) {
+  struct _glwd_job_queue * queue = &config->job_queue;
+  struct _glwd_job * job;
+  unsigned int i;
+  size_t nb_cancelled = 0;
+
+  if (queue->initialized) {
+    pthread_mutex_lock(&queue->lock);
+    queue->stop = 1;
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->lock);
+    for (i=0; i<queue->nb_started; i++) {
+      pthread_join(queue->worker_list[i], NULL);
+    }
+    while ((job = queue->head) != NULL) {
+      queue->head = job->next;
+      glewlwyd_job_free(job, 1);
+      nb_cancelled++;
+    }
+    if (nb_cancelled) {
+      y_log_message(Y_LOG_LEVEL_WARNING, "glewlwyd_job_queue_close - %zu background jobs cancelled", nb_cancelled);
+    }
+    queue->tail = NULL;
+    queue->size = 0;
+    o_free(queue->worker_list);
+    queue->worker_list = NULL;
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->cond);
+    queue->initialized = 0;
+  }
+}
+
+/**
+ * Adds a job to the queue, run is called by a worker thread with data
+ * The queue takes ownership of data: if the job isn't run, because the queue
+ * is full, the job is coalesced, its owner is closed or the server stops, cancel is called with data
+ * In coalesce mode, when the queue is full, a job replaces the queued job of the same type and key,
+ * mail jobs are never coalesced because each one is a distinct notification
+ * Returns G_OK if the job is queued or coalesced, G_ERROR if it is dropped
+ */
+int glewlwyd_job_queue_submit(struct config_elements * config, unsigned int type, const char * key, void * owner, void (* run)(void * data), void (* cancel)(void * data), void * data) {
+  struct _glwd_job_queue * queue = &config->job_queue;
+  struct _glwd_job * job = NULL, * cur_job;
+  void (* old_cancel)(void * data) = NULL;
+  void * old_data = NULL;
+  int ret;
+
+  if (type < GLEWLWYD_JOB_NB_TYPE && run != NULL) {
+    if (queue->initialized && !pthread_mutex_lock(&queue->lock)) {
+      if (!queue->stop) {
+        if (queue->size >= queue->max_size && queue->overflow == GLEWLWYD_JOB_OVERFLOW_COALESCE && type != GLEWLWYD_JOB_TYPE_MAIL && key != NULL) {
+          for (cur_job = queue->head; cur_job != NULL; cur_job = cur_job->next) {
+            if (cur_job->type == type && cur_job->owner == owner && 0 == o_strcmp(cur_job->key, key)) {
+              break;
+            }
+          }
+        } else {
+          cur_job = NULL;
+        }
+        if (cur_job != NULL) {
+          // The queued job keeps its place and its queued time, its data is replaced by the latest
+          old_cancel = cur_job->cancel;
+          old_data = cur_job->data;
+          cur_job->run = run;
+          cur_job->cancel = cancel;
+          cur_job->data = data;
+          queue->nb_coalesced[type]++;
+          ret = G_OK;
+        } else if (queue->size >= queue->max_size) {
+          queue->nb_dropped[type]++;
+          ret = G_ERROR;
+        } else if ((job = o_malloc(sizeof(struct _glwd_job))) != NULL) {
+          job->type = type;
+          job->key = o_strdup(key);
+          job->owner = owner;
+          job->run = run;
+          job->cancel = cancel;
+          job->data = data;
+          job->next = NULL;
+          clock_gettime(CLOCK_MONOTONIC, &job->queued_at);
+          if (queue->tail != NULL) {
+            queue->tail->next = job;
+          } else {
+            queue->head = job;
+          }
+          queue->tail = job;
+          queue->size++;
+          queue->nb_queued[type]++;
+          // The cond is shared with the owners waiting for their jobs to end, so every waiting thread is woken up
+          pthread_cond_broadcast(&queue->cond);
+          ret = G_OK;
+        } else {
+          y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_job_queue_submit - Error allocating resources for job");
+          ret = G_ERROR_MEMORY;
+        }
+      } else {
+        ret = G_ERROR;
+      }
+      pthread_mutex_unlock(&queue->lock);
+    } else {
+      ret = G_ERROR;
+    }
+    if (old_cancel != NULL) {
+      old_cancel(old_data);
+    }
+    if (ret != G_OK) {
+      if (ret == G_ERROR) {
+        y_log_message(Y_LOG_LEVEL_WARNING, "glewlwyd_job_queue_submit - Background job queue full or stopped, %s job dropped", job_type_name[type]);
+      }
+      if (cancel != NULL) {
+        cancel(data);
+      }
+    }
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_job_queue_submit - Error input parameters");
+    if (cancel != NULL) {
+      cancel(data);
+    }
+    ret = G_ERROR_PARAM;
+  }
+  return ret;
+}
+
+/**
+ * Cancels the queued jobs of owner and waits for the end of its running jobs,
+ * called when a plugin or module instance is closed, so no job uses its data afterwards
+ * Must not be called by a job of owner
+ */
+void glewlwyd_job_queue_cancel_owner(struct config_elements * config, void * owner) {
+  struct _glwd_job_queue * queue = &config->job_queue;
+  struct _glwd_job * job, * prev = NULL, * next, * cancel_list = NULL;
+  size_t nb_cancelled = 0;
+  int is_running;
+
+  if (owner != NULL && queue->initialized && !pthread_mutex_lock(&queue->lock)) {
+    for (job = queue->head; job != NULL; job = next) {
+      next = job->next;
+      if (job->owner == owner) {
+        if (prev != NULL) {
+          prev->next = next;
+        } else {
+          queue->head = next;
+        }
+        if (queue->tail == job) {
+          queue->tail = prev;
+        }
+        queue->nb_queued[job->type]--;
+        queue->size--;
+        job->next = cancel_list;
+        cancel_list = job;
+        nb_cancelled++;
+      } else {
+        prev = job;
+      }
+    }
+    do {
+      is_running = 0;
+      for (job = queue->running_head; job != NULL; job = job->next) {
+        if (job->owner == owner) {
+          is_running = 1;
+          break;
+        }
+      }
+      if (is_running) {
+        pthread_cond_wait(&queue->cond, &queue->lock);
+      }
+    } while (is_running);
+    pthread_mutex_unlock(&queue->lock);
+    while ((job = cancel_list) != NULL) {
+      cancel_list = job->next;
+      glewlwyd_job_free(job, 1);
+    }
+    if (nb_cancelled) {
+      y_log_message(Y_LOG_LEVEL_WARNING, "glewlwyd_job_queue_cancel_owner - %zu background jobs cancelled", nb_cancelled);
+    }
+  }
+}
+
+char * glewlwyd_job_queue_metrics(struct config_elements * config) {
+  struct _glwd_job_queue * queue = &config->job_queue;
+  const char * metric_list[][3] = {
+    {"glewlwyd_job_queue_depth", "Number of background jobs waiting in the queue", "gauge"},
+    {"glewlwyd_job_queue_running", "Number of background jobs running", "gauge"},
+    {"glewlwyd_job_queue_completed_total", "Total number of background jobs completed", "counter"},
+    {"glewlwyd_job_queue_dropped_total", "Total number of background jobs dropped because the queue was full", "counter"},
+    {"glewlwyd_job_queue_coalesced_total", "Total number of background jobs coalesced with a queued job", "counter"},
+    {"glewlwyd_job_queue_wait_seconds_total", "Total time spent by the background jobs waiting in the queue", "counter"}
+  };
+  char * content = NULL;
+  size_t i, j;
+
+  if (queue->initialized && !pthread_mutex_lock(&queue->lock)) {
+    for (j=0; j<6; j++) {
+      if (content == NULL) {
+        content = msprintf("# HELP %s %s\n# TYPE %s %s\n", metric_list[j][0], metric_list[j][1], metric_list[j][0], metric_list[j][2]);
+      } else {
+        content = mstrcatf(content, "# HELP %s %s\n# TYPE %s %s\n", metric_list[j][0], metric_list[j][1], metric_list[j][0], metric_list[j][2]);
+      }
+      for (i=0; i<GLEWLWYD_JOB_NB_TYPE; i++) {
+        switch (j) {
+          case 0:
+            content = mstrcatf(content, "%s{type=\"%s\"} %zu\n", metric_list[j][0], job_type_name[i], queue->nb_queued[i]);
+            break;
+          case 1:
+            content = mstrcatf(content, "%s{type=\"%s\"} %u\n", metric_list[j][0], job_type_name[i], queue->nb_running[i]);
+            break;
+          case 2:
+            content = mstrcatf(content, "%s{type=\"%s\"} %zu\n", metric_list[j][0], job_type_name[i], queue->nb_done[i]);
+            break;
+          case 3:
+            content = mstrcatf(content, "%s{type=\"%s\"} %zu\n", metric_list[j][0], job_type_name[i], queue->nb_dropped[i]);
+            break;
+          case 4:
+            content = mstrcatf(content, "%s{type=\"%s\"} %zu\n", metric_list[j][0], job_type_name[i], queue->nb_coalesced[i]);
+            break;
+          default:
+            content = mstrcatf(content, "%s{type=\"%s\"} %.6f\n", metric_list[j][0], job_type_name[i], (double)queue->wait_usec[i]/1000000.0);
+            break;
+        }
+      }
+    }
+    pthread_mutex_unlock(&queue->lock);
+  }
+  return content;
+}
+
+int glewlwyd_callback_job_submit(struct config_plugin * config, unsigned int type, const char * key, void * owner, void (* run)(void * data), void (* cancel)(void * data), void * data) {
+  return glewlwyd_job_queue_submit(config->glewlwyd_config, type, key, owner, run, cancel, data);
+}
+
+void glewlwyd_callback_job_cancel(struct config_plugin * config, void * owner) {
+  glewlwyd_job_queue_cancel_owner(config->glewlwyd_config, owner);
+}
+
+int glewlwyd_module_callback_job_submit(struct config_module * config, unsigned int type, const char * key, void * owner, void (* run)(void * data), void (* cancel)(void * data), void * data) {
+  return glewlwyd_job_queue_submit(config->glewlwyd_config, type, key, owner, run, cancel, data);
+}
+
+void glewlwyd_module_callback_job_cancel(struct config_module * config, void * owner) {
+  glewlwyd_job_queue_cancel_owner(config->glewlwyd_config, owner);
+}
@@ -25,92 +25,336 @@
  *
  */
 
-#include <sched.h>
+#include <ctype.h>
+#include <string.h>
+#include <time.h>
 
 #include "glewlwyd.h"
 
-struct _glwd_increment_counter_data {
-  struct config_elements * config;
-  char                   * name;
-  char                   * label;
-  size_t                   inc;
+/**
+ * Application callback wrapped to measure its duration
+ */
+struct _glwd_timed_endpoint {
+  int                      (* callback_function)(const struct _u_request * request, struct _u_response * response, void * user_data);
+  void                      * user_data;
+  struct _glwd_metrics_data * duration;
+  struct _glwd_metrics_data * in_flight;
 };
 
-void * glewlwyd_metrics_increment_counter_thread(void * args) {
-  struct _glwd_increment_counter_data * data = (struct _glwd_increment_counter_data *)args;
+/**
+ * Each thread increments its own counter shard, the shard index is
+ * given once per thread in a round-robin order
+ */
+static unsigned int glewlwyd_metrics_next_shard = 0;
+static __thread unsigned int glewlwyd_metrics_thread_shard = 0;
+
+static unsigned int glewlwyd_metrics_get_shard_index(void) {
+  if (!glewlwyd_metrics_thread_shard) {
+    glewlwyd_metrics_thread_shard = (__atomic_fetch_add(&glewlwyd_metrics_next_shard, 1, __ATOMIC_RELAXED)%GLEWLWYD_METRICS_NB_SHARD)+1;
+  }
+  return glewlwyd_metrics_thread_shard-1;
+}
+
+/**
+ * FNV-1a hash of the metric name and the lowercase label
+ */
+static unsigned long glewlwyd_metrics_hash(const char * name, const char * label) {
+  unsigned long hash = 2166136261UL;
+  const char * c;
+
+  for (c = name; *c; c++) {
+    hash = (hash ^ (unsigned char)*c) * 16777619UL;
+  }
+  hash = (hash ^ 0xff) * 16777619UL;
+  if (label != NULL) {
+    for (c = label; *c; c++) {
+      hash = (hash ^ (unsigned char)tolower((unsigned char)*c)) * 16777619UL;
+    }
+  }
+  return hash;
+}
+
+static struct _glwd_metrics_data * glewlwyd_metrics_find_data(struct config_elements * config, const char * name, const char * label, unsigned long hash) {
+  struct _glwd_metrics_data * data;
+
+  for (data = __atomic_load_n(&config->metrics_bucket_list[hash%GLEWLWYD_METRICS_NB_BUCKET], __ATOMIC_ACQUIRE); data != NULL; data = data->bucket_next) {
+    if (data->hash == hash && 0 == o_strcmp(name, data->metric->name) && ((label == NULL && data->label == NULL) || 0 == o_strcasecmp(label, data->label))) {
+      break;
+    }
+  }
+  return data;
+}
+
+static struct _glwd_metric * glewlwyd_metrics_find_metric(struct config_elements * config, const char * name) {
+  struct _glwd_metric * metric = NULL;
+  size_t i;
+
+  for (i=0; i<pointer_list_size(&config->metrics_list); i++) {
+    metric = (struct _glwd_metric *)pointer_list_get_at(&config->metrics_list, i);
+    if (0 == o_strcmp(name, metric->name)) {
+      break;
+    } else {
+      metric = NULL;
+    }
+  }
+  return metric;
+}
+
+/**
+ * Returns the counter for the metric name and label, creates it if it doesn't exist yet
+ * Returns NULL if the metric name isn't registered
+ * The lookup is lock-free, the lock is only used to create a new counter
+ */
+struct _glwd_metrics_data * glewlwyd_metrics_get_counter(struct config_elements * config, const char * name, const char * label) {
+  struct _glwd_metrics_data * data = NULL;
   struct _glwd_metric * metric;
-  size_t i, j;
-  int found;
-  
-  if (!pthread_mutex_lock(&data->config->metrics_lock)) {
-    for (i=0; i<pointer_list_size(&data->config->metrics_list); i++) {
-      metric = (struct _glwd_metric *)pointer_list_get_at(&data->config->metrics_list, i);
-      if (0 == o_strcmp(data->name, metric->name)) {
-        found = 0;
-        for (j=0; j<metric->data_size; j++) {
-          if ((data->label == NULL && metric->data[j].label == NULL) || 0 == o_strcasecmp(data->label, metric->data[j].label)) {
-            metric->data[j].counter += data->inc;
-            found = 1;
+  unsigned long hash;
+
+  if (config != NULL && config->metrics_endpoint && !o_strnullempty(name)) {
+    hash = glewlwyd_metrics_hash(name, label);
+    if ((data = glewlwyd_metrics_find_data(config, name, label, hash)) == NULL) {
+      if (!pthread_mutex_lock(&config->metrics_lock)) {
+        if ((data = glewlwyd_metrics_find_data(config, name, label, hash)) == NULL && (metric = glewlwyd_metrics_find_metric(config, name)) != NULL) {
+          if ((data = o_malloc(sizeof(struct _glwd_metrics_data))) != NULL) {
+            memset(data, 0, sizeof(struct _glwd_metrics_data));
+            if (metric->type == GLWD_METRICS_TYPE_HISTOGRAM) {
+              if ((data->bucket_counter_list = o_malloc((metric->bucket_size+1)*sizeof(size_t))) != NULL) {
+                memset(data->bucket_counter_list, 0, (metric->bucket_size+1)*sizeof(size_t));
+              } else {
+                y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_metrics_get_counter - Error allocating resources for bucket_counter_list");
+                o_free(data);
+                data = NULL;
+              }
+            }
+          } else {
+            y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_metrics_get_counter - Error allocating resources for data");
           }
-        }
-        if (!found) {
-          if ((metric->data = o_realloc(metric->data, (metric->data_size+1)*sizeof(struct _glwd_metrics_data))) != NULL) {
-            metric->data[metric->data_size].label = o_strdup(data->label);
-            metric->data[metric->data_size].counter = data->inc;
+          if (data != NULL) {
+            data->metric = metric;
+            data->label = o_strdup(label);
+            data->hash = hash;
+            if (metric->data_last != NULL) {
+              metric->data_last->metric_next = data;
+            } else {
+              metric->data = data;
+            }
+            metric->data_last = data;
             metric->data_size++;
-          } else {
-            y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_metrics_increment_counter_thread - Error realloc metric->data");
+            data->bucket_next = config->metrics_bucket_list[hash%GLEWLWYD_METRICS_NB_BUCKET];
+            __atomic_store_n(&config->metrics_bucket_list[hash%GLEWLWYD_METRICS_NB_BUCKET], data, __ATOMIC_RELEASE);
           }
         }
+        pthread_mutex_unlock(&config->metrics_lock);
+      } else {
+        y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_metrics_get_counter - Error lock");
       }
     }
-    pthread_mutex_unlock(&data->config->metrics_lock);
+  }
+  return data;
+}
+
+/**
+ * Increments the current thread's shard of the counter
+ */
+void glewlwyd_metrics_counter_add(struct _glwd_metrics_data * data, size_t inc) {
+  if (data != NULL) {
+    __atomic_fetch_add(&data->shard_list[glewlwyd_metrics_get_shard_index()].counter, inc, __ATOMIC_RELAXED);
+  }
+}
+
+/**
+ * Returns the sum of all the shards of the counter
+ */
+size_t glewlwyd_metrics_counter_value(struct _glwd_metrics_data * data) {
+  size_t i, value = 0;
+
+  for (i=0; i<GLEWLWYD_METRICS_NB_SHARD; i++) {
+    value += __atomic_load_n(&data->shard_list[i].counter, __ATOMIC_RELAXED);
+  }
+  return value;
+}
+
+/**
+ * Adds inc to the gauge, inc may be negative
+ */
+void glewlwyd_metrics_gauge_add(struct _glwd_metrics_data * data, long inc) {
+  glewlwyd_metrics_counter_add(data, (size_t)inc);
+}
+
+/**
+ * Adds the value to the histogram
+ * The sum of the values is stored with a precision of 1e-6
+ */
+void glewlwyd_metrics_histogram_observe(struct _glwd_metrics_data * data, double value) {
+  size_t i;
+
+  if (data != NULL && data->bucket_counter_list != NULL) {
+    for (i=0; i<data->metric->bucket_size && value > data->metric->bucket_list[i]; i++);
+    __atomic_fetch_add(&data->bucket_counter_list[i], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&data->sum, (size_t)(value*1000000), __ATOMIC_RELAXED);
+    glewlwyd_metrics_counter_add(data, 1);
+  }
+}
+
+/**
+ * Parses a comma separated list of increasing bucket upper bounds
+ */
+int glewlwyd_metrics_parse_buckets(const char * str_buckets, double ** bucket_list, size_t * bucket_size) {
+  char ** splitted = NULL, * endptr;
+  size_t nb_bucket, i;
+  int ret = G_OK;
+
+  *bucket_list = NULL;
+  *bucket_size = 0;
+  if ((nb_bucket = split_string(str_buckets, ",", &splitted)) && (*bucket_list = o_malloc(nb_bucket*sizeof(double))) != NULL) {
+    for (i=0; i<nb_bucket; i++) {
+      (*bucket_list)[i] = strtod(trimwhitespace(splitted[i]), &endptr);
+      if (*endptr || (*bucket_list)[i] <= 0 || (i && (*bucket_list)[i] <= (*bucket_list)[i-1])) {
+        ret = G_ERROR_PARAM;
+        break;
+      }
+    }
+    if (ret == G_OK) {
+      *bucket_size = nb_bucket;
+    } else {
+      o_free(*bucket_list);
+      *bucket_list = NULL;
+    }
   } else {
-    y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_metrics_increment_counter_thread - Error lock");
+    ret = G_ERROR_PARAM;
   }
-  o_free(data->name);
-  o_free(data->label);
-  o_free(data);
-  pthread_exit(NULL);
+  free_string_array(splitted);
+  return ret;
+}
+
+static char * glewlwyd_metrics_append_data(char * content, struct _glwd_metric * metric, struct _glwd_metrics_data * data) {
+  size_t i, cumulative = 0;
+
+  if (metric->type == GLWD_METRICS_TYPE_HISTOGRAM) {
+    for (i=0; i<=metric->bucket_size; i++) {
+      cumulative += __atomic_load_n(&data->bucket_counter_list[i], __ATOMIC_RELAXED);
+      if (i<metric->bucket_size) {
+        content = mstrcatf(content, "%s_bucket{%s%sle=\"%g\"} %zu\n", metric->name, data->label!=NULL?data->label:"", data->label!=NULL?", ":"", metric->bucket_list[i], cumulative);
+      } else {
+        content = mstrcatf(content, "%s_bucket{%s%sle=\"+Inf\"} %zu\n", metric->name, data->label!=NULL?data->label:"", data->label!=NULL?", ":"", cumulative);
+      }
+    }
+    if (data->label != NULL) {
+      content = mstrcatf(content, "%s_sum{%s} %.6f\n", metric->name, data->label, (double)__atomic_load_n(&data->sum, __ATOMIC_RELAXED)/1000000);
+      content = mstrcatf(content, "%s_count{%s} %zu\n", metric->name, data->label, glewlwyd_metrics_counter_value(data));
+    } else {
+      content = mstrcatf(content, "%s_sum %.6f\n", metric->name, (double)__atomic_load_n(&data->sum, __ATOMIC_RELAXED)/1000000);
+      content = mstrcatf(content, "%s_count %zu\n", metric->name, glewlwyd_metrics_counter_value(data));
+    }
+  } else if (metric->type == GLWD_METRICS_TYPE_GAUGE) {
+    if (data->label != NULL) {
+      content = mstrcatf(content, "%s{%s} %ld\n", metric->name, data->label, (long)glewlwyd_metrics_counter_value(data));
+    } else {
+      content = mstrcatf(content, "%s %ld\n", metric->name, (long)glewlwyd_metrics_counter_value(data));
+    }
+  } else {
+    if (data->label != NULL) {
+      content = mstrcatf(content, "%s_total{%s} %zu\n", metric->name, data->label, glewlwyd_metrics_counter_value(data));
+    } else {
+      content = mstrcatf(content, "%s_total %zu\n", metric->name, glewlwyd_metrics_counter_value(data));
+    }
+  }
+  return content;
 }
 
 /**
- * Runs a single thread with a low priority to increment a metrics value
+ * Returns the registered metrics in prometheus text format
  */
-int glewlwyd_metrics_increment_counter(struct config_elements * config, const char * name, const char * label, size_t inc) {
-  struct _glwd_increment_counter_data * data;
-  pthread_t thread_metrics;
-  int thread_ret, thread_detach;
-  pthread_attr_t attr;
-  struct sched_param param;
+char * glewlwyd_metrics_get_content(struct config_elements * config) {
+  struct _glwd_metric * metric;
+  struct _glwd_metrics_data * data;
+  char * content = o_strdup("");
+  size_t i;
+
+  if (!pthread_mutex_lock(&config->metrics_lock)) {
+    for (i=0; i<pointer_list_size(&config->metrics_list); i++) {
+      metric = (struct _glwd_metric *)pointer_list_get_at(&config->metrics_list, i);
+      if (metric->type == GLWD_METRICS_TYPE_HISTOGRAM) {
+        content = mstrcatf(content, "# HELP %s %s\n# TYPE %s histogram\n", metric->name, metric->help, metric->name);
+      } else if (metric->type == GLWD_METRICS_TYPE_GAUGE) {
+        content = mstrcatf(content, "# HELP %s %s\n# TYPE %s gauge\n", metric->name, metric->help, metric->name);
+      } else {
+        content = mstrcatf(content, "# HELP %s_total %s\n# TYPE %s_total counter\n", metric->name, metric->help, metric->name);
+      }
+      for (data = metric->data; data != NULL; data = data->metric_next) {
+        content = glewlwyd_metrics_append_data(content, metric, data);
+      }
+    }
+    pthread_mutex_unlock(&config->metrics_lock);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_metrics_get_content - Error lock");
+  }
+  return content;
+}
+
+static int callback_glewlwyd_timed_endpoint(const struct _u_request * request, struct _u_response * response, void * user_data) {
+  struct _glwd_timed_endpoint * timed_endpoint = (struct _glwd_timed_endpoint *)user_data;
+  struct timespec start, end;
+  int ret;
+
+  glewlwyd_metrics_gauge_add(timed_endpoint->in_flight, 1);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  ret = timed_endpoint->callback_function(request, response, timed_endpoint->user_data);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  glewlwyd_metrics_histogram_observe(timed_endpoint->duration, (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec)/1000000000);
+  glewlwyd_metrics_gauge_add(timed_endpoint->in_flight, -1);
+  return ret;
+}
+
+/**
+ * Adds an endpoint to the main instance, the callback duration and the
+ * number of requests in flight are measured if the metrics are enabled
+ * The wrappers are kept until glewlwyd_metrics_close, because a request
+ * may still be running when its endpoint is removed
+ */
+int glewlwyd_add_timed_endpoint(struct config_elements * config, const char * plugin_name, const char * http_method, const char * url_prefix, const char * url_format, unsigned int priority, int (* callback_function)(const struct _u_request * request, struct _u_response * response, void * user_data), void * user_data) {
+  struct _glwd_timed_endpoint * timed_endpoint;
+  char * label;
   int ret;
 
   if (config->metrics_endpoint) {
-    if (config != NULL && !o_strnullempty(name)) {
-      if ((data = o_malloc(sizeof(struct _glwd_increment_counter_data))) != NULL) {
-        data->config = config;
-        data->name = o_strdup(name);
-        data->label = o_strdup(label);
-        data->inc = inc;
-        pthread_attr_init (&attr);
-        pthread_attr_getschedparam (&attr, &param);
-        param.sched_priority = 0;
-        pthread_attr_setschedparam (&attr, &param);
-        thread_ret = pthread_create(&thread_metrics, &attr, glewlwyd_metrics_increment_counter_thread, (void *)data);
-        thread_detach = pthread_detach(thread_metrics);
-        if (thread_ret || thread_detach) {
-          y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_metrics_increment_counter - Error thread");
-          o_free(data->name);
-          o_free(data->label);
-          o_free(data);
-          ret = G_ERROR;
-        } else {
-          ret = G_OK;
-        }
+    if (plugin_name != NULL) {
+      label = msprintf("plugin=\"%s\", endpoint=\"%s %s\"", plugin_name, http_method, url_format);
+    } else {
+      label = msprintf("endpoint=\"%s %s\"", http_method, url_format);
+    }
+    if ((timed_endpoint = o_malloc(sizeof(struct _glwd_timed_endpoint))) != NULL) {
+      timed_endpoint->callback_function = callback_function;
+      timed_endpoint->user_data = user_data;
+      timed_endpoint->duration = glewlwyd_metrics_get_counter(config, GLWD_METRICS_HTTP_REQUEST_DURATION, label);
+      timed_endpoint->in_flight = glewlwyd_metrics_get_counter(config, GLWD_METRICS_HTTP_REQUEST_IN_FLIGHT, label);
+      if (!pthread_mutex_lock(&config->metrics_lock)) {
+        pointer_list_append(&config->metrics_timed_endpoint_list, timed_endpoint);
+        pthread_mutex_unlock(&config->metrics_lock);
+        ret = ulfius_add_endpoint_by_val(config->instance, http_method, url_prefix, url_format, priority, &callback_glewlwyd_timed_endpoint, timed_endpoint);
       } else {
-        y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_metrics_increment_counter - Error allocating resources for struct _glwd_increment_counter_data");
-        ret = G_ERROR_MEMORY;
+        y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_add_timed_endpoint - Error lock");
+        o_free(timed_endpoint);
+        ret = U_ERROR;
       }
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_add_timed_endpoint - Error allocating resources for timed_endpoint");
+      ret = U_ERROR_MEMORY;
+    }
+    o_free(label);
+  } else {
+    ret = ulfius_add_endpoint_by_val(config->instance, http_method, url_prefix, url_format, priority, callback_function, user_data);
+  }
+  return ret;
+}
+
+int glewlwyd_metrics_increment_counter(struct config_elements * config, const char * name, const char * label, size_t inc) {
+  int ret;
+
+  if (config->metrics_endpoint) {
+    if (config != NULL && !o_strnullempty(name)) {
+      glewlwyd_metrics_counter_add(glewlwyd_metrics_get_counter(config, name, label), inc);
+      ret = G_OK;
     } else {
       y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_metrics_increment_counter - Error input values");
       ret = G_ERROR_PARAM;
@@ -144,34 +388,63 @@ int glewlwyd_metrics_increment_counter_va(struct config_elements * config, const
 
 void free_glwd_metrics(void * data) {
   struct _glwd_metric * glwd_metrics = (struct _glwd_metric *)data;
-  size_t i;
+  struct _glwd_metrics_data * metrics_data, * next;
   
   if (glwd_metrics != NULL) {
     o_free(glwd_metrics->name);
     o_free(glwd_metrics->help);
-    for (i=0; i<glwd_metrics->data_size; i++) {
-      o_free(glwd_metrics->data[i].label);
+    for (metrics_data = glwd_metrics->data; metrics_data != NULL; metrics_data = next) {
+      next = metrics_data->metric_next;
+      o_free(metrics_data->label);
+      o_free(metrics_data->bucket_counter_list);
+      o_free(metrics_data);
     }
-    o_free(glwd_metrics->data);
+    o_free(glwd_metrics->bucket_list);
     o_free(glwd_metrics);
   }
 }
 
 int glewlwyd_metrics_add_metric(struct config_elements * config, const char * name, const char * help) {
+  return glewlwyd_metrics_add_metric_type(config, name, help, GLWD_METRICS_TYPE_COUNTER, NULL, 0);
+}
+
+/**
+ * Registers a metric of the given type
+ * bucket_list contains the increasing upper bounds of a histogram,
+ * the +Inf bucket is implicit
+ */
+int glewlwyd_metrics_add_metric_type(struct config_elements * config, const char * name, const char * help, unsigned short type, const double * bucket_list, size_t bucket_size) {
   struct _glwd_metric * glwd_metrics;
   int ret;
   
   if (config->metrics_endpoint) {
-    if (!o_strnullempty(name)) {
-      if ((glwd_metrics = o_malloc(sizeof(struct _glwd_metric))) != NULL) {
-        glwd_metrics->name = o_strdup(name);
-        glwd_metrics->help = o_strdup(help);
-        glwd_metrics->data_size = 0;
-        glwd_metrics->data = NULL;
-        pointer_list_append(&config->metrics_list, glwd_metrics);
-        ret = G_OK;
+    if (!o_strnullempty(name) && (type != GLWD_METRICS_TYPE_HISTOGRAM || (bucket_list != NULL && bucket_size))) {
+      if (!pthread_mutex_lock(&config->metrics_lock)) {
+        if (glewlwyd_metrics_find_metric(config, name) != NULL) {
+          // Metric already registered, e.g. by another instance of the same plugin
+          ret = G_OK;
+        } else if ((glwd_metrics = o_malloc(sizeof(struct _glwd_metric))) != NULL) {
+          glwd_metrics->name = o_strdup(name);
+          glwd_metrics->help = o_strdup(help);
+          glwd_metrics->type = type;
+          glwd_metrics->bucket_list = NULL;
+          glwd_metrics->bucket_size = 0;
+          glwd_metrics->data_size = 0;
+          glwd_metrics->data = NULL;
+          glwd_metrics->data_last = NULL;
+          if (type == GLWD_METRICS_TYPE_HISTOGRAM && (glwd_metrics->bucket_list = o_malloc(bucket_size*sizeof(double))) != NULL) {
+            memcpy(glwd_metrics->bucket_list, bucket_list, bucket_size*sizeof(double));
+            glwd_metrics->bucket_size = bucket_size;
+          }
+          pointer_list_append(&config->metrics_list, glwd_metrics);
+          ret = G_OK;
+        } else {
+          ret = G_ERROR_MEMORY;
+        }
+        pthread_mutex_unlock(&config->metrics_lock);
       } else {
-        ret = G_ERROR_MEMORY;
+        y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_metrics_add_metric - Error lock");
+        ret = G_ERROR;
       }
     } else {
       ret = G_ERROR_PARAM;
@@ -187,6 +460,8 @@ int glewlwyd_metrics_init(struct config_elements * config) {
   int ret = G_OK;
   
   pointer_list_init(&config->metrics_list);
+  pointer_list_init(&config->metrics_timed_endpoint_list);
+  memset(config->metrics_bucket_list, 0, GLEWLWYD_METRICS_NB_BUCKET*sizeof(struct _glwd_metrics_data *));
   pthread_mutexattr_init ( &mutexattr );
   pthread_mutexattr_settype( &mutexattr, PTHREAD_MUTEX_RECURSIVE );
   if (pthread_mutex_init(&config->metrics_lock, &mutexattr) != 0) {
@@ -198,7 +473,9 @@ int glewlwyd_metrics_init(struct config_elements * config) {
 
 void glewlwyd_metrics_close(struct config_elements * config) {
   if (config->metrics_endpoint) {
+    memset(config->metrics_bucket_list, 0, GLEWLWYD_METRICS_NB_BUCKET*sizeof(struct _glwd_metrics_data *));
     pointer_list_clean_free(&config->metrics_list, &free_glwd_metrics);
+    pointer_list_clean_free(&config->metrics_timed_endpoint_list, &o_free);
     pthread_mutex_destroy(&config->metrics_lock);
   }
 }
@@ -37,12 +37,15 @@
 #include <arpa/inet.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
 #include <gnutls/gnutls.h>
 #include <gnutls/crypto.h>
 #include <nettle/pbkdf2.h>
 
 #include "glewlwyd-common.h"
 
+#define GLEWLWYD_RAND_BUFFER_SIZE 256
+
 /**
  *
  * Read the content of a file and return it as a char *
@@ -150,6 +153,46 @@ unsigned char random_at_most(unsigned char max, int nonce, int * is_error) {
   }
 }
 
+/**
+ * Fills str with str_size characters picked uniformly in charset
+ * The random bytes are read from gnutls_rnd in blocks instead of one call per character
+ * A byte is accepted if it's lower than the largest multiple of charset_len below 256,
+ * then mapped with a modulo, so every character has the same probability
+ */
+static int rand_fill_from_charset(char * str, size_t str_size, const char * charset, size_t charset_len, gnutls_rnd_level_t level) {
+  unsigned char buffer[GLEWLWYD_RAND_BUFFER_SIZE];
+  size_t n = 0, i, remaining, buffer_len;
+  unsigned int limit;
+  int ret = G_OK;
+
+  if (str != NULL && str_size && charset_len && charset_len <= 256) {
+    limit = 256 - (256 % (unsigned int)charset_len);
+    while (n < str_size && ret == G_OK) {
+      // Read a few more bytes than required to cover the rejected ones
+      remaining = str_size - n;
+      buffer_len = remaining + (remaining>>3) + 4;
+      if (buffer_len > sizeof(buffer)) {
+        buffer_len = sizeof(buffer);
+      }
+      if (gnutls_rnd(level, buffer, buffer_len) >= 0) {
+        for (i=0; i<buffer_len && n<str_size; i++) {
+          if (buffer[i] < limit) {
+            str[n++] = charset[buffer[i] % charset_len];
+          }
+        }
+      } else {
+        y_log_message(Y_LOG_LEVEL_ERROR, "rand_fill_from_charset - Error gnutls_rnd");
+        ret = G_ERROR;
+      }
+    }
+    gnutls_memset(buffer, 0, sizeof(buffer));
+    str[str_size] = '\0';
+  } else {
+    ret = G_ERROR_PARAM;
+  }
+  return ret;
+}
+
 /**
  * Generates a random string and store it in str
  */
@@ -161,19 +204,7 @@ char * rand_string(char * str, size_t str_size) {
  * Generates a random string and store it in str
  */
 char * rand_string_from_charset(char * str, size_t str_size, const char * charset) {
-  size_t n;
-  unsigned char rnd = 0;
-  int is_error = 0;
-  
-  if (str_size && str != NULL) {
-    for (n = 0; n < str_size; n++) {
-      rnd = random_at_most((unsigned char)(o_strlen(charset) - 2), 0, &is_error);
-      if (is_error) {
-        return NULL;
-      }
-      str[n] = charset[rnd];
-    }
-    str[str_size] = '\0';
+  if (rand_fill_from_charset(str, str_size, charset, o_strlen(charset), GNUTLS_RND_KEY) == G_OK) {
     return str;
   } else {
     return NULL;
@@ -185,19 +216,8 @@ char * rand_string_from_charset(char * str, size_t str_size, const char * charse
  */
 char * rand_string_nonce(char * str, size_t str_size) {
   const char charset[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
-  size_t n;
-  unsigned char rnd = 0;
-  int is_error = 0;
-  
-  if (str_size && str != NULL) {
-    for (n = 0; n < str_size; n++) {
-      rnd = random_at_most((unsigned char)(o_strlen(charset) - 2), 1, &is_error);
-      if (is_error) {
-        return NULL;
-      }
-      str[n] = charset[rnd];
-    }
-    str[str_size] = '\0';
+
+  if (rand_fill_from_charset(str, str_size, charset, sizeof(charset) - 1, GNUTLS_RND_NONCE) == G_OK) {
     return str;
   } else {
     return NULL;
@@ -206,22 +226,8 @@ char * rand_string_nonce(char * str, size_t str_size) {
 
 int rand_code(char * str, size_t str_size) {
   const char charset[] = "0123456789";
-  size_t n;
-  int is_error = 0;
-  
-  if (str_size && str != NULL) {
-    for (n = 0; n < str_size; n++) {
-      unsigned char key = random_at_most((sizeof(charset)) - 2, 0, &is_error);
-      if (is_error) {
-        return 0;
-      }
-      str[n] = charset[key];
-    }
-    str[str_size] = '\0';
-    return 1;
-  } else {
-    return 0;
-  }
+
+  return rand_fill_from_charset(str, str_size, charset, sizeof(charset) - 1, GNUTLS_RND_KEY) == G_OK;
 }
 
 char * join_json_string_array(json_t * j_array, const char * separator) {
@@ -297,12 +303,11 @@ int generate_digest(digest_algorithm digest, const char * data, int use_salt, ch
           } else {
             res = 0;
           }
-        } else {
-          intermediate = o_strdup(data);
         }
         if (res) {
-          key_data.data = (unsigned char*)intermediate;
-          key_data.size = (unsigned int)o_strlen(intermediate);
+          // Without salt, data is hashed as is, no copy needed
+          key_data.data = (unsigned char*)(use_salt?intermediate:data);
+          key_data.size = (unsigned int)o_strlen((const char *)key_data.data);
           if (key_data.data != NULL && (dig_res = gnutls_fingerprint(alg, &key_data, encoded_key, &encoded_key_size)) == GNUTLS_E_SUCCESS) {
             if (use_salt) {
               memcpy(encoded_key+encoded_key_size, salt, GLEWLWYD_DEFAULT_SALT_LENGTH);
@@ -583,6 +588,204 @@ char * generate_hash(digest_algorithm digest, const char * data) {
   return to_return;
 }
 
+/**
+ * Per-thread hash contexts used by generate_hash_buffer, one per unsalted digest algorithm
+ * gnutls_hash_output resets the context, so it's reused for the next hash
+ */
+struct _glwd_hash_thread {
+  gnutls_hash_hd_t hd[GLEWLWYD_HASH_NB_ALG];
+};
+
+static pthread_key_t glwd_hash_thread_key;
+static pthread_once_t glwd_hash_thread_once = PTHREAD_ONCE_INIT;
+static int glwd_hash_thread_key_res = 0;
+
+static void free_glwd_hash_thread(void * data) {
+  struct _glwd_hash_thread * thread_data = (struct _glwd_hash_thread *)data;
+  size_t i;
+
+  for (i=0; i<GLEWLWYD_HASH_NB_ALG; i++) {
+    if (thread_data->hd[i] != NULL) {
+      gnutls_hash_deinit(thread_data->hd[i], NULL);
+    }
+  }
+  o_free(thread_data);
+}
+
+static void init_glwd_hash_thread_key(void) {
+  glwd_hash_thread_key_res = pthread_key_create(&glwd_hash_thread_key, free_glwd_hash_thread);
+}
+
+/**
+ * Returns the context of the current thread for the algorithm at index, creates it if needed
+ */
+static gnutls_hash_hd_t get_glwd_hash_thread_context(size_t index, gnutls_digest_algorithm_t alg) {
+  struct _glwd_hash_thread * thread_data = NULL;
+
+  if (!pthread_once(&glwd_hash_thread_once, init_glwd_hash_thread_key) && !glwd_hash_thread_key_res) {
+    if ((thread_data = (struct _glwd_hash_thread *)pthread_getspecific(glwd_hash_thread_key)) == NULL) {
+      if ((thread_data = o_malloc(sizeof(struct _glwd_hash_thread))) != NULL) {
+        memset(thread_data, 0, sizeof(struct _glwd_hash_thread));
+        if (pthread_setspecific(glwd_hash_thread_key, thread_data)) {
+          y_log_message(Y_LOG_LEVEL_ERROR, "get_glwd_hash_thread_context - Error pthread_setspecific");
+          o_free(thread_data);
+          thread_data = NULL;
+        }
+      } else {
+        y_log_message(Y_LOG_LEVEL_ERROR, "get_glwd_hash_thread_context - Error allocating resources for thread_data");
+      }
+    }
+    if (thread_data != NULL && thread_data->hd[index] == NULL && gnutls_hash_init(&thread_data->hd[index], alg) < 0) {
+      y_log_message(Y_LOG_LEVEL_ERROR, "get_glwd_hash_thread_context - Error gnutls_hash_init");
+      thread_data->hd[index] = NULL;
+    }
+  }
+  return thread_data!=NULL?thread_data->hd[index]:NULL;
+}
+
+/**
+ * Encodes data in base64 with padding in out in a single pass, out must be at least ((data_len+2)/3)*4+1 bytes
+ * If url_safe is set, '+' and '/' are replaced with '-' and '_'
+ * returns the length of the encoded string
+ */
+static size_t base64_encode_buffer(const unsigned char * data, size_t data_len, int url_safe, char * out) {
+  static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/",
+                    b64url[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+  const char * table = url_safe?b64url:b64;
+  size_t i, len = 0;
+  unsigned int block;
+
+  for (i=0; i+2<data_len; i+=3) {
+    block = ((unsigned int)data[i]<<16) | ((unsigned int)data[i+1]<<8) | data[i+2];
+    out[len++] = table[(block>>18)&0x3f];
+    out[len++] = table[(block>>12)&0x3f];
+    out[len++] = table[(block>>6)&0x3f];
+    out[len++] = table[block&0x3f];
+  }
+  if (i < data_len) {
+    block = (unsigned int)data[i]<<16;
+    if (i+1 < data_len) {
+      block |= (unsigned int)data[i+1]<<8;
+    }
+    out[len++] = table[(block>>18)&0x3f];
+    out[len++] = table[(block>>12)&0x3f];
+    out[len++] = (i+1 < data_len)?table[(block>>6)&0x3f]:'=';
+    out[len++] = '=';
+  }
+  out[len] = '\0';
+  return len;
+}
+
+/**
+ * Generates a hash from the specified string data, using the digest method specified, like generate_hash
+ * The hash is written in out_hash, of size out_hash_size, GLEWLWYD_HASH_BUFFER_SIZE is enough for all unsalted digests
+ * If url_safe is set, the base64 characters '+' and '/' are replaced with '-' and '_'
+ * The unsalted digests are computed without allocation with a context kept per thread,
+ * the other algorithms use generate_hash
+ */
+int generate_hash_buffer(digest_algorithm digest, const char * data, int url_safe, char * out_hash, size_t out_hash_size) {
+  unsigned char raw[64];
+  const char * prefix;
+  gnutls_digest_algorithm_t alg;
+  gnutls_hash_hd_t hd;
+  size_t index, prefix_len, data_len, raw_len, i;
+  char * hash;
+  int ret;
+
+  switch (digest) {
+    case digest_SHA1:
+      index = 0;
+      alg = GNUTLS_DIG_SHA1;
+      prefix = "{SHA}";
+      break;
+    case digest_SHA224:
+      index = 1;
+      alg = GNUTLS_DIG_SHA224;
+      prefix = "{SHA224}";
+      break;
+    case digest_SHA256:
+      index = 2;
+      alg = GNUTLS_DIG_SHA256;
+      prefix = "{SHA256}";
+      break;
+    case digest_SHA384:
+      index = 3;
+      alg = GNUTLS_DIG_SHA384;
+      prefix = "{SHA384}";
+      break;
+    case digest_SHA512:
+      index = 4;
+      alg = GNUTLS_DIG_SHA512;
+      prefix = "{SHA512}";
+      break;
+    case digest_MD5:
+      index = 5;
+      alg = GNUTLS_DIG_MD5;
+      prefix = "{MD5}";
+      break;
+    default:
+      index = GLEWLWYD_HASH_NB_ALG;
+      alg = GNUTLS_DIG_UNKNOWN;
+      prefix = NULL;
+      break;
+  }
+
+  if (data == NULL || out_hash == NULL || !out_hash_size) {
+    ret = G_ERROR_PARAM;
+  } else if (index < GLEWLWYD_HASH_NB_ALG) {
+    prefix_len = o_strlen(prefix);
+    data_len = o_strlen(data);
+    raw_len = gnutls_hash_get_len(alg);
+    if (out_hash_size > prefix_len + ((raw_len+2)/3)*4) {
+      memcpy(out_hash, prefix, prefix_len);
+      if (!data_len) {
+        // No data, then the hash is the prefix only, like generate_hash
+        out_hash[prefix_len] = '\0';
+        ret = G_OK;
+      } else if ((hd = get_glwd_hash_thread_context(index, alg)) != NULL) {
+        if (gnutls_hash(hd, data, data_len) >= 0) {
+          gnutls_hash_output(hd, raw);
+          base64_encode_buffer(raw, raw_len, url_safe, out_hash+prefix_len);
+          ret = G_OK;
+        } else {
+          y_log_message(Y_LOG_LEVEL_ERROR, "generate_hash_buffer - Error gnutls_hash");
+          // Reset the context state
+          gnutls_hash_output(hd, raw);
+          ret = G_ERROR;
+        }
+      } else {
+        y_log_message(Y_LOG_LEVEL_ERROR, "generate_hash_buffer - Error get_glwd_hash_thread_context");
+        ret = G_ERROR;
+      }
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "generate_hash_buffer - Error out_hash_size too small");
+      ret = G_ERROR_PARAM;
+    }
+  } else if ((hash = generate_hash(digest, data)) != NULL) {
+    if (o_strlen(hash) < out_hash_size) {
+      for (i=0; hash[i]; i++) {
+        if (url_safe && hash[i] == '+') {
+          out_hash[i] = '-';
+        } else if (url_safe && hash[i] == '/') {
+          out_hash[i] = '_';
+        } else {
+          out_hash[i] = hash[i];
+        }
+      }
+      out_hash[i] = '\0';
+      ret = G_OK;
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "generate_hash_buffer - Error out_hash_size too small");
+      ret = G_ERROR_PARAM;
+    }
+    o_free(hash);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "generate_hash_buffer - Error generate_hash");
+    ret = G_ERROR;
+  }
+  return ret;
+}
+
 /**
  * Check if the result json object has a "result" element that is equal to value
  */
@@ -594,3 +797,287 @@ int check_result_value(json_t * result, const int value) {
 int json_string_null_or_empty(json_t * j_str) {
   return o_strnullempty(json_string_value(j_str));
 }
+
+/**
+ * Returns true if the coding is in the Accept-Encoding list with a non-zero q-value
+ */
+int accept_list_has_coding(char ** accept_list, const char * coding) {
+  size_t i, coding_len = o_strlen(coding);
+  const char * value;
+  int ret = 0;
+
+  for (i=0; accept_list[i]!=NULL && !ret; i++) {
+    value = accept_list[i];
+    while (*value == ' ' || *value == '\t') {
+      value++;
+    }
+    if (0 == o_strncasecmp(value, coding, coding_len)) {
+      value += coding_len;
+      while (*value == ' ' || *value == '\t') {
+        value++;
+      }
+      if (*value == '\0') {
+        ret = 1;
+      } else if (*value == ';') {
+        value++;
+        while (*value == ' ' || *value == '\t') {
+          value++;
+        }
+        ret = !((value[0] == 'q' || value[0] == 'Q') && value[1] == '=' && strtod(value+2, NULL) <= 0.0);
+      }
+    }
+  }
+  return ret;
+}
+
+/**
+ * Replay cache entry, chained in its hash bucket and in its expiration slot
+ */
+struct _glwd_replay_cache_entry {
+  unsigned char                     key[GLEWLWYD_REPLAY_CACHE_KEY_SIZE];
+  time_t                            expires_at;
+  struct _glwd_replay_cache_entry * bucket_next;
+  struct _glwd_replay_cache_entry * slot_prev;
+  struct _glwd_replay_cache_entry * slot_next;
+};
+
+/**
+ * The key of an entry is the SHA256 digest of the scope and the identifier,
+ * so an entry has a fixed size whatever the length of the identifier
+ */
+static int glewlwyd_replay_cache_key(const char * scope, const char * identifier, unsigned char * key) {
+  gnutls_hash_hd_t dig;
+  uint64_t scope_len = (uint64_t)o_strlen(scope);
+  int ret = 0;
+
+  if (!gnutls_hash_init(&dig, GNUTLS_DIG_SHA256)) {
+    if (!gnutls_hash(dig, &scope_len, sizeof(scope_len)) &&
+        (!scope_len || !gnutls_hash(dig, scope, (size_t)scope_len)) &&
+        !gnutls_hash(dig, identifier, o_strlen(identifier))) {
+      ret = 1;
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_replay_cache_key - Error gnutls_hash");
+    }
+    gnutls_hash_deinit(dig, key);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_replay_cache_key - Error gnutls_hash_init");
+  }
+  return ret;
+}
+
+/**
+ * The low bits of the key select the shard, the next ones the bucket
+ */
+static struct _glwd_replay_cache_entry ** glewlwyd_replay_cache_get_bucket(struct _glwd_replay_cache * cache, const unsigned char * key, struct _glwd_replay_cache_shard ** shard) {
+  uint64_t hash;
+
+  memcpy(&hash, key, sizeof(hash));
+  *shard = &cache->shard_list[hash % GLEWLWYD_REPLAY_CACHE_NB_SHARD];
+  return &(*shard)->bucket_list[(hash / GLEWLWYD_REPLAY_CACHE_NB_SHARD) % (*shard)->nb_bucket];
+}
+
+static struct _glwd_replay_cache_entry ** glewlwyd_replay_cache_get_slot(struct _glwd_replay_cache * cache, struct _glwd_replay_cache_shard * shard, time_t expires_at) {
+  return &shard->slot_list[(size_t)(expires_at / cache->slot_duration) % cache->nb_slot];
+}
+
+/**
+ * Removes the entry from its bucket and its slot, then frees it
+ * The shard lock must be held by the caller
+ */
+static void glewlwyd_replay_cache_remove_entry(struct _glwd_replay_cache * cache, struct _glwd_replay_cache_shard * shard, struct _glwd_replay_cache_entry * entry) {
+  struct _glwd_replay_cache_shard * entry_shard;
+  struct _glwd_replay_cache_entry ** cur = glewlwyd_replay_cache_get_bucket(cache, entry->key, &entry_shard);
+
+  while (*cur != NULL && *cur != entry) {
+    cur = &(*cur)->bucket_next;
+  }
+  if (*cur != NULL) {
+    *cur = entry->bucket_next;
+  }
+  if (entry->slot_prev != NULL) {
+    entry->slot_prev->slot_next = entry->slot_next;
+  } else {
+    *glewlwyd_replay_cache_get_slot(cache, shard, entry->expires_at) = entry->slot_next;
+  }
+  if (entry->slot_next != NULL) {
+    entry->slot_next->slot_prev = entry->slot_prev;
+  }
+  shard->nb_entry--;
+  o_free(entry);
+}
+
+/**
+ * Removes the entries of the slots elapsed since the last sweep
+ * The shard lock must be held by the caller
+ */
+static void glewlwyd_replay_cache_sweep(struct _glwd_replay_cache * cache, struct _glwd_replay_cache_shard * shard, time_t now) {
+  struct _glwd_replay_cache_entry * entry, * next;
+  time_t cur_slot = now / cache->slot_duration, slot;
+  size_t nb_swept = 0;
+
+  for (slot = shard->swept_slot+1; slot < cur_slot && nb_swept < cache->nb_slot; slot++, nb_swept++) {
+    for (entry = shard->slot_list[(size_t)slot % cache->nb_slot]; entry != NULL; entry = next) {
+      next = entry->slot_next;
+      // After a long pause, the slot may contain entries of a later time period
+      if (entry->expires_at <= now) {
+        glewlwyd_replay_cache_remove_entry(cache, shard, entry);
+      }
+    }
+  }
+  shard->swept_slot = cur_slot-1;
+}
+
+/**
+ * Initialize a replay cache of nb_bucket hash buckets per shard,
+ * whose entries are kept at most max_lifetime seconds
+ */
+int glewlwyd_replay_cache_init(struct _glwd_replay_cache * cache, size_t nb_bucket, time_t max_lifetime) {
+  size_t i;
+  int ret = G_OK;
+
+  cache->initialized = 0;
+  cache->max_lifetime = max_lifetime>0?max_lifetime:1;
+  cache->slot_duration = (cache->max_lifetime+GLEWLWYD_REPLAY_CACHE_NB_SLOT-1)/GLEWLWYD_REPLAY_CACHE_NB_SLOT;
+  // One slot for the current period, one for the rounding of expires_at, one to avoid overlapping the oldest slot
+  cache->nb_slot = (size_t)(cache->max_lifetime/cache->slot_duration)+3;
+  if ((cache->shard_list = o_malloc(GLEWLWYD_REPLAY_CACHE_NB_SHARD*sizeof(struct _glwd_replay_cache_shard))) != NULL) {
+    for (i=0; i<GLEWLWYD_REPLAY_CACHE_NB_SHARD; i++) {
+      memset(&cache->shard_list[i], 0, sizeof(struct _glwd_replay_cache_shard));
+      cache->shard_list[i].nb_bucket = nb_bucket?nb_bucket:GLEWLWYD_REPLAY_CACHE_NB_BUCKET;
+      cache->shard_list[i].swept_slot = time(NULL)/cache->slot_duration-1;
+      cache->shard_list[i].bucket_list = o_malloc(cache->shard_list[i].nb_bucket*sizeof(struct _glwd_replay_cache_entry *));
+      cache->shard_list[i].slot_list = o_malloc(cache->nb_slot*sizeof(struct _glwd_replay_cache_entry *));
+      if (cache->shard_list[i].bucket_list != NULL && cache->shard_list[i].slot_list != NULL) {
+        memset(cache->shard_list[i].bucket_list, 0, cache->shard_list[i].nb_bucket*sizeof(struct _glwd_replay_cache_entry *));
+        memset(cache->shard_list[i].slot_list, 0, cache->nb_slot*sizeof(struct _glwd_replay_cache_entry *));
+        if (pthread_mutex_init(&cache->shard_list[i].lock, NULL)) {
+          y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_replay_cache_init - Error pthread_mutex_init");
+          ret = G_ERROR;
+        }
+      } else {
+        y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_replay_cache_init - Error allocating resources for bucket_list or slot_list");
+        ret = G_ERROR_MEMORY;
+      }
+      if (ret != G_OK) {
+        o_free(cache->shard_list[i].bucket_list);
+        o_free(cache->shard_list[i].slot_list);
+        while (i--) {
+          pthread_mutex_destroy(&cache->shard_list[i].lock);
+          o_free(cache->shard_list[i].bucket_list);
+          o_free(cache->shard_list[i].slot_list);
+        }
+        o_free(cache->shard_list);
+        cache->shard_list = NULL;
+        break;
+      }
+    }
+    if (ret == G_OK) {
+      cache->initialized = 1;
+    }
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_replay_cache_init - Error allocating resources for shard_list");
+    ret = G_ERROR_MEMORY;
+  }
+  return ret;
+}
+
+void glewlwyd_replay_cache_close(struct _glwd_replay_cache * cache) {
+  struct _glwd_replay_cache_entry * entry;
+  size_t i, j;
+
+  if (cache->initialized) {
+    for (i=0; i<GLEWLWYD_REPLAY_CACHE_NB_SHARD; i++) {
+      for (j=0; j<cache->nb_slot; j++) {
+        while ((entry = cache->shard_list[i].slot_list[j]) != NULL) {
+          cache->shard_list[i].slot_list[j] = entry->slot_next;
+          o_free(entry);
+        }
+      }
+      pthread_mutex_destroy(&cache->shard_list[i].lock);
+      o_free(cache->shard_list[i].bucket_list);
+      o_free(cache->shard_list[i].slot_list);
+    }
+    o_free(cache->shard_list);
+    cache->shard_list = NULL;
+    cache->initialized = 0;
+  }
+}
+
+/**
+ * Stores the identifier in the scope until expires_at if it isn't already present
+ * expires_at is limited to max_lifetime seconds from now
+ * Returns G_OK if the identifier wasn't present, G_ERROR_UNAUTHORIZED if it's a replay
+ */
+int glewlwyd_replay_cache_check_and_set(struct _glwd_replay_cache * cache, const char * scope, const char * identifier, time_t expires_at) {
+  struct _glwd_replay_cache_shard * shard;
+  struct _glwd_replay_cache_entry ** bucket, ** slot, * entry;
+  unsigned char key[GLEWLWYD_REPLAY_CACHE_KEY_SIZE];
+  time_t now;
+  int ret;
+
+  if (cache->initialized && !o_strnullempty(identifier)) {
+    if (glewlwyd_replay_cache_key(scope, identifier, key)) {
+      bucket = glewlwyd_replay_cache_get_bucket(cache, key, &shard);
+      if (!pthread_mutex_lock(&shard->lock)) {
+        time(&now);
+        glewlwyd_replay_cache_sweep(cache, shard, now);
+        expires_at = MAX(MIN(expires_at, now+cache->max_lifetime), now+1);
+        for (entry = *bucket; entry != NULL && 0 != memcmp(entry->key, key, GLEWLWYD_REPLAY_CACHE_KEY_SIZE); entry = entry->bucket_next);
+        if (entry != NULL && entry->expires_at > now) {
+          ret = G_ERROR_UNAUTHORIZED;
+        } else {
+          if (entry != NULL) {
+            glewlwyd_replay_cache_remove_entry(cache, shard, entry);
+          }
+          if ((entry = o_malloc(sizeof(struct _glwd_replay_cache_entry))) != NULL) {
+            memcpy(entry->key, key, GLEWLWYD_REPLAY_CACHE_KEY_SIZE);
+            entry->expires_at = expires_at;
+            entry->bucket_next = *bucket;
+            *bucket = entry;
+            slot = glewlwyd_replay_cache_get_slot(cache, shard, expires_at);
+            entry->slot_prev = NULL;
+            entry->slot_next = *slot;
+            if (*slot != NULL) {
+              (*slot)->slot_prev = entry;
+            }
+            *slot = entry;
+            shard->nb_entry++;
+            ret = G_OK;
+          } else {
+            y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_replay_cache_check_and_set - Error allocating resources for entry");
+            ret = G_ERROR_MEMORY;
+          }
+        }
+        pthread_mutex_unlock(&shard->lock);
+      } else {
+        y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_replay_cache_check_and_set - Error pthread_mutex_lock");
+        ret = G_ERROR;
+      }
+    } else {
+      ret = G_ERROR;
+    }
+  } else {
+    ret = G_ERROR_PARAM;
+  }
+  return ret;
+}
+
+/**
+ * Removes the identifier of the scope from the cache
+ */
+void glewlwyd_replay_cache_remove(struct _glwd_replay_cache * cache, const char * scope, const char * identifier) {
+  struct _glwd_replay_cache_shard * shard;
+  struct _glwd_replay_cache_entry ** bucket, * entry;
+  unsigned char key[GLEWLWYD_REPLAY_CACHE_KEY_SIZE];
+
+  if (cache->initialized && !o_strnullempty(identifier) && glewlwyd_replay_cache_key(scope, identifier, key)) {
+    bucket = glewlwyd_replay_cache_get_bucket(cache, key, &shard);
+    if (!pthread_mutex_lock(&shard->lock)) {
+      for (entry = *bucket; entry != NULL && 0 != memcmp(entry->key, key, GLEWLWYD_REPLAY_CACHE_KEY_SIZE); entry = entry->bucket_next);
+      if (entry != NULL) {
+        glewlwyd_replay_cache_remove_entry(cache, shard, entry);
+      }
+      pthread_mutex_unlock(&shard->lock);
+    }
+  }
+}
@@ -27,6 +27,7 @@
 #include "glewlwyd.h"
 
 json_t * get_misc_config_list(struct config_elements * config) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query, * j_result = NULL, * j_return, * j_element = NULL;
   int res;
   size_t index;
@@ -37,7 +38,7 @@ json_t * get_misc_config_list(struct config_elements * config) {
                         "gmc_type AS type",
                         "gmc_name AS name",
                         "gmc_value");
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     json_array_foreach(j_result, index, j_element) {
@@ -53,10 +54,12 @@ json_t * get_misc_config_list(struct config_elements * config) {
     y_log_message(Y_LOG_LEVEL_ERROR, "get_misc_config_list - Error executing j_query");
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
 json_t * get_misc_config(struct config_elements * config, const char * type, const char * name) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query, * j_result = NULL, * j_return;
   int res;
   
@@ -73,7 +76,7 @@ json_t * get_misc_config(struct config_elements * config, const char * type, con
   if (!o_strnullempty(name)) {
     json_object_set_new(json_object_get(j_query, "where"), "gmc_name", json_string(name));
   }
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result)) {
@@ -92,6 +95,7 @@ json_t * get_misc_config(struct config_elements * config, const char * type, con
     y_log_message(Y_LOG_LEVEL_ERROR, "get_misc_config - Error executing j_query");
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
@@ -127,6 +131,7 @@ json_t * is_misc_config_valid(const char * name, json_t * j_misc_config) {
 }
 
 int add_misc_config(struct config_elements * config, const char * name, json_t * j_misc_config) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query;
   int res, ret;
   char * value = NULL;
@@ -141,18 +146,21 @@ int add_misc_config(struct config_elements * config, const char * name, json_t *
                         "gmc_name", name,
                         "gmc_value", value);
   o_free(value);
-  res = h_insert(config->conn, j_query, NULL);
+  res = h_insert(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
+    reset_ip_geolocation_config(config);
     ret = G_OK;
   } else {
     y_log_message(Y_LOG_LEVEL_ERROR, "add_misc_config - Error executing j_query");
     ret = G_ERROR_DB;
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return ret;
 }
 
 int set_misc_config(struct config_elements * config, const char * name, json_t * j_misc_config) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query;
   int res, ret;
   char * value = NULL;
@@ -168,18 +176,21 @@ int set_misc_config(struct config_elements * config, const char * name, json_t *
                       "where",
                         "gmc_name", name);
   o_free(value);
-  res = h_update(config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
+    reset_ip_geolocation_config(config);
     ret = G_OK;
   } else {
     y_log_message(Y_LOG_LEVEL_ERROR, "set_misc_config - Error executing j_query");
     ret = G_ERROR_DB;
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return ret;
 }
 
 int delete_misc_config(struct config_elements * config, const char * name) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query;
   int res, ret;
   
@@ -187,14 +198,16 @@ int delete_misc_config(struct config_elements * config, const char * name) {
                       "table", GLEWLWYD_TABLE_MISC_CONFIG,
                       "where",
                         "gmc_name", name);
-  res = h_delete(config->conn, j_query, NULL);
+  res = h_delete(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
+    reset_ip_geolocation_config(config);
     ret = G_OK;
   } else {
     y_log_message(Y_LOG_LEVEL_ERROR, "set_misc_config - Error executing j_query");
     ret = G_ERROR_DB;
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return ret;
 }
 
@@ -206,9 +219,19 @@ struct _update_issued_for {
   char * issued_for_value;
 };
 
-void * run_thread_update_issued_for(void * args) {
+static void free_update_issued_for(void * args) {
+  struct _update_issued_for * thread_config = (struct _update_issued_for *)args;
+
+  o_free(thread_config->issued_for_column);
+  o_free(thread_config->issued_for_value);
+  json_decref(thread_config->j_query);
+  o_free(thread_config);
+}
+
+static void run_update_issued_for(void * args) {
   struct _update_issued_for * thread_config = (struct _update_issued_for *)args;
   char * ip_address = o_strdup(thread_config->issued_for_value), * ip_data = NULL;
+  struct _h_connection * pool_conn = NULL;
   int res;
 
   if (o_strchr(ip_address, ',') != NULL) {
@@ -223,34 +246,33 @@ void * run_thread_update_issued_for(void * args) {
   ip_data = get_ip_data(thread_config->config, ip_address);
   if (ip_data != NULL) {
     json_object_set_new(json_object_get(thread_config->j_query, "set"), thread_config->issued_for_column, json_pack("s++", thread_config->issued_for_value, " - ", ip_data));
-    res = h_update(thread_config->conn, thread_config->j_query, NULL);
+    if (thread_config->conn != NULL) {
+      res = h_update(thread_config->conn, thread_config->j_query, NULL);
+    } else {
+      pool_conn = glewlwyd_db_pool_checkout(thread_config->config);
+      res = h_update(pool_conn, thread_config->j_query, NULL);
+      glewlwyd_db_pool_checkin(thread_config->config, pool_conn);
+    }
     if (res != H_OK) {
-      y_log_message(Y_LOG_LEVEL_ERROR, "run_thread_update_issued_for - Error executing j_query");
+      y_log_message(Y_LOG_LEVEL_ERROR, "run_update_issued_for - Error executing j_query");
     }
   }
   o_free(ip_data);
   o_free(ip_address);
-  o_free(thread_config->issued_for_column);
-  o_free(thread_config->issued_for_value);
-  json_decref(thread_config->j_query);
-  o_free(thread_config);
-  
-  return NULL;
+  free_update_issued_for(thread_config);
 }
 
 void update_issued_for(struct config_elements * config, const struct _h_connection * conn, const char * sql_table, const char * issued_for_column, const char * issued_for_value, const char * id_column, json_int_t id_value) {
   struct _update_issued_for * thread_config = o_malloc(sizeof(struct _update_issued_for));
-  pthread_t thread_update_issued_for;
-  int thread_ret, thread_detach;
-  pthread_attr_t attr;
-  struct sched_param param;
+  char * job_key;
 
   if (thread_config != NULL) {
     thread_config->config = config;
-    if (conn != NULL) {
+    // A NULL or glewlwyd connection means a connection is checked out from the pool by the thread
+    if (conn != NULL && !glewlwyd_db_pool_is_pool_connection(config, conn)) {
       thread_config->conn = conn;
     } else {
-      thread_config->conn = config->conn;
+      thread_config->conn = NULL;
     }
     thread_config->j_query = json_pack("{sss{}s{sI}}",
                                 "table", sql_table,
@@ -260,19 +282,12 @@ void update_issued_for(struct config_elements * config, const struct _h_connecti
     thread_config->issued_for_column = o_strdup(issued_for_column);
     thread_config->issued_for_value = o_strdup(issued_for_value);
 
-    pthread_attr_init (&attr);
-    pthread_attr_getschedparam (&attr, &param);
-    param.sched_priority = 0;
-    pthread_attr_setschedparam (&attr, &param);
-    thread_ret = pthread_create(&thread_update_issued_for, &attr, run_thread_update_issued_for, (void *)thread_config);
-    thread_detach = pthread_detach(thread_update_issued_for);
-    if (thread_ret || thread_detach) {
-      y_log_message(Y_LOG_LEVEL_ERROR, "update_issued_for - Error thread");
-      o_free(thread_config->issued_for_column);
-      o_free(thread_config->issued_for_value);
-      json_decref(thread_config->j_query);
-      o_free(thread_config);
+    // Several updates of the same row are coalesced if the queue is full and in coalesce mode
+    job_key = msprintf("%s:%s:%" JSON_INTEGER_FORMAT, sql_table, id_column, id_value);
+    if (glewlwyd_job_queue_submit(config, GLEWLWYD_JOB_TYPE_GEOLOCATION, job_key, NULL, &run_update_issued_for, &free_update_issued_for, thread_config) != G_OK) {
+      y_log_message(Y_LOG_LEVEL_ERROR, "update_issued_for - Error glewlwyd_job_queue_submit");
     }
+    o_free(job_key);
   } else {
     y_log_message(Y_LOG_LEVEL_ERROR, "update_issued_for - Error allocating resources for thread_config");
   }
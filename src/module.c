@@ -103,7 +103,8 @@ json_t * get_module_type_list(struct config_elements * config) {
   return j_return;
 }
 
-json_t * get_user_module_list(struct config_elements * config) {
+static json_t * get_user_module_list_db(struct config_elements * config) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   int res;
   json_t * j_query, * j_result = NULL, * j_return, * j_parameters, * j_element;
   size_t index;
@@ -122,7 +123,7 @@ json_t * get_user_module_list(struct config_elements * config) {
                         "gumi_enabled",
                       "order_by",
                       "gumi_order");
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     json_array_foreach(j_result, index, j_element) {
@@ -151,10 +152,58 @@ json_t * get_user_module_list(struct config_elements * config) {
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
   json_decref(j_result);
+  glewlwyd_db_pool_checkin(config, conn);
+  return j_return;
+}
+
+/**
+ * Rebuilds the in-memory snapshot of the user module instances list
+ * The snapshot is immutable, readers get a new reference to it
+ */
+int update_user_module_snapshot(struct config_elements * config) {
+  json_t * j_module_list = get_user_module_list_db(config), * j_old;
+  int ret;
+
+  if (check_result_value(j_module_list, G_OK)) {
+    if (!pthread_mutex_lock(&config->module_snapshot_lock)) {
+      j_old = config->j_user_module_snapshot;
+      config->j_user_module_snapshot = j_module_list;
+      pthread_mutex_unlock(&config->module_snapshot_lock);
+      json_decref(j_old);
+      glewlwyd_cache_clear(&config->user_cache);
+      ret = G_OK;
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "update_user_module_snapshot - Error pthread_mutex_lock");
+      json_decref(j_module_list);
+      ret = G_ERROR;
+    }
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "update_user_module_snapshot - Error get_user_module_list_db");
+    json_decref(j_module_list);
+    ret = G_ERROR_DB;
+  }
+  return ret;
+}
+
+/**
+ * Returns the user module instances list from the in-memory snapshot,
+ * falls back to the database if no snapshot is available
+ */
+json_t * get_user_module_list(struct config_elements * config) {
+  json_t * j_return = NULL;
+
+  if (!pthread_mutex_lock(&config->module_snapshot_lock)) {
+    j_return = json_incref(config->j_user_module_snapshot);
+    pthread_mutex_unlock(&config->module_snapshot_lock);
+  }
+  if (j_return == NULL) {
+    j_return = get_user_module_list_db(config);
+  }
   return j_return;
 }
 
 json_t * get_user_module(struct config_elements * config, const char * name) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   int res;
   json_t * j_query, * j_result = NULL, * j_return, * j_parameters;
   
@@ -173,7 +222,7 @@ json_t * get_user_module(struct config_elements * config, const char * name) {
                       "where",
                         "gumi_name",
                         name);
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result) > 0) {
@@ -205,6 +254,7 @@ json_t * get_user_module(struct config_elements * config, const char * name) {
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
   json_decref(j_result);
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
@@ -289,6 +339,7 @@ json_t * is_user_module_valid(struct config_elements * config, json_t * j_module
 }
 
 json_t * add_user_module(struct config_elements * config, json_t * j_module) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   struct _user_module * module;
   struct _user_module_instance * cur_instance;
   json_t * j_query;
@@ -320,7 +371,7 @@ json_t * add_user_module(struct config_elements * config, json_t * j_module) {
   } else {
     json_object_set_new(json_object_get(j_query, "values"), "gumi_order", json_integer((json_int_t)pointer_list_size(config->user_module_list)));
   }
-  res = h_insert(config->conn, j_query, NULL);
+  res = h_insert(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     module = NULL;
@@ -372,16 +423,19 @@ json_t * add_user_module(struct config_elements * config, json_t * j_module) {
       y_log_message(Y_LOG_LEVEL_ERROR, "add_user_module - Module '%s' not found", json_string_value(json_object_get(j_module, "module")));
       j_return = json_pack("{si}", "result", G_ERROR);
     }
+    update_user_module_snapshot(config);
   } else {
     y_log_message(Y_LOG_LEVEL_ERROR, "add_user_module - Error executing j_query");
     glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
   o_free(parameters);
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
 int set_user_module(struct config_elements * config, const char * name, json_t * j_module) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query;
   int res, ret;
   char * parameters = json_dumps(json_object_get(j_module, "parameters"), JSON_COMPACT);
@@ -412,7 +466,7 @@ int set_user_module(struct config_elements * config, const char * name, json_t *
   if (json_object_get(j_module, "readonly") != NULL) {
     json_object_set_new(json_object_get(j_query, "set"), "gumi_readonly", json_object_get(j_module, "readonly")==json_true()?json_integer(1):json_integer(0));
   }
-  res = h_update(config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (!pthread_mutex_lock(&config->module_lock)) {
@@ -420,6 +474,7 @@ int set_user_module(struct config_elements * config, const char * name, json_t *
         cur_instance->readonly = json_object_get(j_module, "readonly")==json_true()?1:0;
         cur_instance->multiple_passwords = json_object_get(j_module, "multiple_passwords")==json_true()?1:0;
         ret = G_OK;
+        update_user_module_snapshot(config);
       } else {
         y_log_message(Y_LOG_LEVEL_ERROR, "set_user_module - Error get_user_module_instance");
         ret = G_ERROR;
@@ -435,10 +490,12 @@ int set_user_module(struct config_elements * config, const char * name, json_t *
     ret = G_ERROR_DB;
   }
   o_free(parameters);
+  glewlwyd_db_pool_checkin(config, conn);
   return ret;
 }
 
 int delete_user_module(struct config_elements * config, const char * name) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   int ret, res, error = 0;
   json_t * j_query, * j_result;
   struct _user_module_instance * instance;
@@ -461,10 +518,11 @@ int delete_user_module(struct config_elements * config, const char * name) {
                               "where",
                                 "gumi_name",
                                 name);
-          res = h_delete(config->conn, j_query, NULL);
+          res = h_delete(conn, j_query, NULL);
           json_decref(j_query);
           if (res == H_OK) {
             ret = G_OK;
+            update_user_module_snapshot(config);
           } else {
             y_log_message(Y_LOG_LEVEL_ERROR, "delete_user_module - Error executing j_query");
             glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
@@ -487,6 +545,7 @@ int delete_user_module(struct config_elements * config, const char * name) {
     y_log_message(Y_LOG_LEVEL_ERROR, "set_user_module - Error pthread_mutex_lock");
     ret = G_ERROR;
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return ret;
 }
 
@@ -560,6 +619,7 @@ json_t * manage_user_module(struct config_elements * config, const char * name,
 }
 
 json_t * get_user_middleware_module_list(struct config_elements * config) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   int res;
   json_t * j_query, * j_result = NULL, * j_return, * j_parameters, * j_element;
   size_t index;
@@ -576,7 +636,7 @@ json_t * get_user_middleware_module_list(struct config_elements * config) {
                         "gummi_enabled",
                       "order_by",
                       "gummi_order");
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     json_array_foreach(j_result, index, j_element) {
@@ -599,10 +659,12 @@ json_t * get_user_middleware_module_list(struct config_elements * config) {
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
   json_decref(j_result);
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
 json_t * get_user_middleware_module(struct config_elements * config, const char * name) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   int res;
   json_t * j_query, * j_result = NULL, * j_return, * j_parameters;
   
@@ -619,7 +681,7 @@ json_t * get_user_middleware_module(struct config_elements * config, const char
                       "where",
                         "gummi_name",
                         name);
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result) > 0) {
@@ -645,6 +707,7 @@ json_t * get_user_middleware_module(struct config_elements * config, const char
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
   json_decref(j_result);
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
@@ -723,6 +786,7 @@ json_t * is_user_middleware_module_valid(struct config_elements * config, json_t
 }
 
 json_t * add_user_middleware_module(struct config_elements * config, json_t * j_module) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query;
   int res;
   json_t * j_return;
@@ -747,7 +811,7 @@ json_t * add_user_middleware_module(struct config_elements * config, json_t * j_
   } else {
     json_object_set_new(json_object_get(j_query, "values"), "gummi_order", json_integer((json_int_t)pointer_list_size(config->user_middleware_module_list)));
   }
-  res = h_insert(config->conn, j_query, NULL);
+  res = h_insert(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     close_user_middleware_module_instance_list(config);
@@ -758,10 +822,12 @@ json_t * add_user_middleware_module(struct config_elements * config, json_t * j_
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
   o_free(parameters);
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
 int set_user_middleware_module(struct config_elements * config, const char * name, json_t * j_module) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query;
   int res, ret;
   char * parameters = json_dumps(json_object_get(j_module, "parameters"), JSON_COMPACT);
@@ -784,7 +850,7 @@ int set_user_middleware_module(struct config_elements * config, const char * nam
   } else {
     json_object_set_new(json_object_get(j_query, "set"), "gummi_order", json_integer((json_int_t)pointer_list_size(config->user_middleware_module_list)));
   }
-  res = h_update(config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     close_user_middleware_module_instance_list(config);
@@ -796,10 +862,12 @@ int set_user_middleware_module(struct config_elements * config, const char * nam
     ret = G_ERROR_DB;
   }
   o_free(parameters);
+  glewlwyd_db_pool_checkin(config, conn);
   return ret;
 }
 
 int delete_user_middleware_module(struct config_elements * config, const char * name) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   int ret, res;
   json_t * j_query;
   struct _user_middleware_module_instance * instance;
@@ -812,7 +880,7 @@ int delete_user_middleware_module(struct config_elements * config, const char *
                         "where",
                           "gummi_name",
                           name);
-    res = h_delete(config->conn, j_query, NULL);
+    res = h_delete(conn, j_query, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       close_user_middleware_module_instance_list(config);
@@ -827,6 +895,7 @@ int delete_user_middleware_module(struct config_elements * config, const char *
     y_log_message(Y_LOG_LEVEL_ERROR, "delete_user_middleware_module - Error module not found");
     ret = G_ERROR;
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return ret;
 }
 
@@ -900,6 +969,7 @@ json_t * manage_user_middleware_module(struct config_elements * config, const ch
 }
 
 json_t * get_user_auth_scheme_module_list(struct config_elements * config) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   int res;
   json_t * j_query, * j_result = NULL, * j_return, * j_parameters, * j_element;
   size_t index;
@@ -920,7 +990,7 @@ json_t * get_user_auth_scheme_module_list(struct config_elements * config) {
                         "guasmi_enabled",
                       "order_by",
                       "guasmi_module");
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     json_array_foreach(j_result, index, j_element) {
@@ -949,10 +1019,12 @@ json_t * get_user_auth_scheme_module_list(struct config_elements * config) {
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
   json_decref(j_result);
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
 json_t * get_user_auth_scheme_module(struct config_elements * config, const char * name) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   int res;
   json_t * j_query, * j_result = NULL, * j_return, * j_parameters;
   
@@ -974,7 +1046,7 @@ json_t * get_user_auth_scheme_module(struct config_elements * config, const char
                         "where",
                           "guasmi_name",
                           name);
-    res = h_select(config->conn, j_query, &j_result, NULL);
+    res = h_select(conn, j_query, &j_result, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       if (json_array_size(j_result) > 0) {
@@ -1009,6 +1081,7 @@ json_t * get_user_auth_scheme_module(struct config_elements * config, const char
   } else {
     j_return = json_pack("{si}", "result", G_ERROR_PARAM);
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
@@ -1093,6 +1166,7 @@ json_t * is_user_auth_scheme_module_valid(struct config_elements * config, json_
 }
 
 json_t * add_user_auth_scheme_module(struct config_elements * config, json_t * j_module) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   struct _user_auth_scheme_module * module;
   struct _user_auth_scheme_module_instance * cur_instance;
   json_t * j_query, * j_last_id, * j_result, * j_return;
@@ -1124,10 +1198,9 @@ json_t * add_user_auth_scheme_module(struct config_elements * config, json_t * j
                         json_object_get(j_module, "forbid_user_reset_credential")==json_true()?1:0,
                         "guasmi_enabled",
                         1);
-  res = h_insert(config->conn, j_query, NULL);
+  res = glewlwyd_db_insert(config, conn, j_query, "guasmi_id", &j_last_id);
   json_decref(j_query);
   if (res == H_OK) {
-    j_last_id = h_last_insert_id(config->conn);
     if (j_last_id != NULL) {
       module = NULL;
       for (i=0; i<pointer_list_size(config->user_auth_scheme_module_list); i++) {
@@ -1196,10 +1269,12 @@ json_t * add_user_auth_scheme_module(struct config_elements * config, json_t * j
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
   o_free(parameters);
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
 int set_user_auth_scheme_module(struct config_elements * config, const char * name, json_t * j_module) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query;
   int res, ret;
   char * parameters = json_dumps(json_object_get(j_module, "parameters"), JSON_COMPACT);
@@ -1229,7 +1304,7 @@ int set_user_auth_scheme_module(struct config_elements * config, const char * na
                         "guasmi_name",
                         name);
   o_free(parameters);
-  res = h_update(config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (!pthread_mutex_lock(&config->module_lock)) {
@@ -1255,10 +1330,15 @@ int set_user_auth_scheme_module(struct config_elements * config, const char * na
     glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  if (ret == G_OK) {
+    update_scope_graph(config);
+  }
+  glewlwyd_db_pool_checkin(config, conn);
   return ret;
 }
 
 int delete_user_auth_scheme_module(struct config_elements * config, const char * name) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   int ret, res;
   json_t * j_query, * j_result = manage_user_auth_scheme_module(config, name, GLEWLWYD_MODULE_ACTION_STOP);
   struct _user_auth_scheme_module_instance * instance;
@@ -1275,7 +1355,7 @@ int delete_user_auth_scheme_module(struct config_elements * config, const char *
                             "where",
                               "guasmi_name",
                               name);
-        res = h_delete(config->conn, j_query, NULL);
+        res = h_delete(conn, j_query, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           ret = G_OK;
@@ -1298,6 +1378,10 @@ int delete_user_auth_scheme_module(struct config_elements * config, const char *
     ret = G_ERROR;
   }
   json_decref(j_result);
+  if (ret == G_OK) {
+    update_scope_graph(config);
+  }
+  glewlwyd_db_pool_checkin(config, conn);
   return ret;
 }
 
@@ -1372,7 +1456,8 @@ json_t * manage_user_auth_scheme_module(struct config_elements * config, const c
   return j_return;
 }
 
-json_t * get_client_module_list(struct config_elements * config) {
+static json_t * get_client_module_list_db(struct config_elements * config) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   int res;
   json_t * j_query, * j_result = NULL, * j_return, * j_parameters, * j_element;
   size_t index;
@@ -1390,7 +1475,7 @@ json_t * get_client_module_list(struct config_elements * config) {
                         "gcmi_enabled",
                       "order_by",
                       "gcmi_order");
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     json_array_foreach(j_result, index, j_element) {
@@ -1416,10 +1501,58 @@ json_t * get_client_module_list(struct config_elements * config) {
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
   json_decref(j_result);
+  glewlwyd_db_pool_checkin(config, conn);
+  return j_return;
+}
+
+/**
+ * Rebuilds the in-memory snapshot of the client module instances list
+ * The snapshot is immutable, readers get a new reference to it
+ */
+int update_client_module_snapshot(struct config_elements * config) {
+  json_t * j_module_list = get_client_module_list_db(config), * j_old;
+  int ret;
+
+  if (check_result_value(j_module_list, G_OK)) {
+    if (!pthread_mutex_lock(&config->module_snapshot_lock)) {
+      j_old = config->j_client_module_snapshot;
+      config->j_client_module_snapshot = j_module_list;
+      pthread_mutex_unlock(&config->module_snapshot_lock);
+      json_decref(j_old);
+      glewlwyd_cache_clear(&config->client_cache);
+      ret = G_OK;
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "update_client_module_snapshot - Error pthread_mutex_lock");
+      json_decref(j_module_list);
+      ret = G_ERROR;
+    }
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "update_client_module_snapshot - Error get_client_module_list_db");
+    json_decref(j_module_list);
+    ret = G_ERROR_DB;
+  }
+  return ret;
+}
+
+/**
+ * Returns the client module instances list from the in-memory snapshot,
+ * falls back to the database if no snapshot is available
+ */
+json_t * get_client_module_list(struct config_elements * config) {
+  json_t * j_return = NULL;
+
+  if (!pthread_mutex_lock(&config->module_snapshot_lock)) {
+    j_return = json_incref(config->j_client_module_snapshot);
+    pthread_mutex_unlock(&config->module_snapshot_lock);
+  }
+  if (j_return == NULL) {
+    j_return = get_client_module_list_db(config);
+  }
   return j_return;
 }
 
 json_t * get_client_module(struct config_elements * config, const char * name) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   int res;
   json_t * j_query, * j_result = NULL, * j_return, * j_parameters;
   
@@ -1437,7 +1570,7 @@ json_t * get_client_module(struct config_elements * config, const char * name) {
                       "where",
                         "gcmi_name",
                         name);
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result) > 0) {
@@ -1466,6 +1599,7 @@ json_t * get_client_module(struct config_elements * config, const char * name) {
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
   json_decref(j_result);
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
@@ -1547,6 +1681,7 @@ json_t * is_client_module_valid(struct config_elements * config, json_t * j_modu
 }
 
 json_t * add_client_module(struct config_elements * config, json_t * j_module) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   struct _client_module * module;
   struct _client_module_instance * cur_instance;
   json_t * j_query, * j_result, * j_return;
@@ -1575,7 +1710,7 @@ json_t * add_client_module(struct config_elements * config, json_t * j_module) {
   } else {
     json_object_set_new(json_object_get(j_query, "values"), "gcmi_order", json_integer((json_int_t)pointer_list_size(config->client_module_list)));
   }
-  res = h_insert(config->conn, j_query, NULL);
+  res = h_insert(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     module = NULL;
@@ -1626,16 +1761,19 @@ json_t * add_client_module(struct config_elements * config, json_t * j_module) {
       y_log_message(Y_LOG_LEVEL_ERROR, "add_client_module - Module '%s' not found", json_string_value(json_object_get(j_module, "module")));
       j_return = json_pack("{si}", "result", G_ERROR);
     }
+    update_client_module_snapshot(config);
   } else {
     y_log_message(Y_LOG_LEVEL_ERROR, "add_client_module - Error executing j_query");
     glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
   o_free(parameters);
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
 int set_client_module(struct config_elements * config, const char * name, json_t * j_module) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query;
   int res;
   int ret;
@@ -1666,13 +1804,14 @@ int set_client_module(struct config_elements * config, const char * name, json_t
     json_object_set_new(json_object_get(j_query, "set"), "gcmi_readonly", json_object_get(j_module, "readonly")==json_true()?json_integer(1):json_integer(0));
   }
   o_free(parameters);
-  res = h_update(config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (!pthread_mutex_lock(&config->module_lock)) {
       if ((cur_instance = get_client_module_instance(config, name)) != NULL) {
         cur_instance->readonly = json_object_get(j_module, "readonly")==json_true()?1:0;
         ret = G_OK;
+        update_client_module_snapshot(config);
       } else {
         y_log_message(Y_LOG_LEVEL_ERROR, "set_client_module - Error get_user_module_instance");
         ret = G_ERROR;
@@ -1687,10 +1826,12 @@ int set_client_module(struct config_elements * config, const char * name, json_t
     glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return ret;
 }
 
 int delete_client_module(struct config_elements * config, const char * name) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   int ret, res, error = 0;
   json_t * j_query, * j_result;
   struct _client_module_instance * instance;
@@ -1713,10 +1854,11 @@ int delete_client_module(struct config_elements * config, const char * name) {
                               "where",
                                 "gcmi_name",
                                 name);
-          res = h_delete(config->conn, j_query, NULL);
+          res = h_delete(conn, j_query, NULL);
           json_decref(j_query);
           if (res == H_OK) {
             ret = G_OK;
+            update_client_module_snapshot(config);
           } else {
             y_log_message(Y_LOG_LEVEL_ERROR, "delete_client_module - Error executing j_query");
             glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
@@ -1739,6 +1881,7 @@ int delete_client_module(struct config_elements * config, const char * name) {
     y_log_message(Y_LOG_LEVEL_ERROR, "delete_client_module - Error instance not found");
     ret = G_ERROR;
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return ret;
 }
 
@@ -1812,6 +1955,7 @@ json_t * manage_client_module(struct config_elements * config, const char * name
 }
 
 json_t * get_plugin_module_list(struct config_elements * config) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   int res;
   json_t * j_query, * j_result = NULL, * j_return, * j_parameters, * j_element;
   size_t index;
@@ -1827,7 +1971,7 @@ json_t * get_plugin_module_list(struct config_elements * config) {
                         "gpmi_enabled",
                       "order_by",
                       "gpmi_module,gpmi_name");
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     json_array_foreach(j_result, index, j_element) {
@@ -1850,6 +1994,7 @@ json_t * get_plugin_module_list(struct config_elements * config) {
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
   json_decref(j_result);
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
@@ -1880,6 +2025,7 @@ json_t * get_plugin_module_list_for_user(struct config_elements * config) {
 }
 
 json_t * get_plugin_module(struct config_elements * config, const char * name) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   int res;
   json_t * j_query, * j_result = NULL, * j_return, * j_parameters;
   
@@ -1895,7 +2041,7 @@ json_t * get_plugin_module(struct config_elements * config, const char * name) {
                       "where",
                         "gpmi_name",
                         name);
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result) > 0) {
@@ -1921,6 +2067,7 @@ json_t * get_plugin_module(struct config_elements * config, const char * name) {
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
   json_decref(j_result);
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
@@ -1996,6 +2143,7 @@ json_t * is_plugin_module_valid(struct config_elements * config, json_t * j_modu
 }
 
 json_t * add_plugin_module(struct config_elements * config, json_t * j_module) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   struct _plugin_module * module;
   struct _plugin_module_instance * cur_instance;
   json_t * j_query, * j_return, * j_result;
@@ -2017,7 +2165,7 @@ json_t * add_plugin_module(struct config_elements * config, json_t * j_module) {
                         1,
                         "gpmi_parameters",
                         parameters);
-  res = h_insert(config->conn, j_query, NULL);
+  res = h_insert(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     module = NULL;
@@ -2080,10 +2228,12 @@ json_t * add_plugin_module(struct config_elements * config, json_t * j_module) {
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
   o_free(parameters);
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
 int set_plugin_module(struct config_elements * config, const char * name, json_t * j_module) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query;
   int res, ret;
   char * parameters = json_dumps(json_object_get(j_module, "parameters"), JSON_COMPACT);
@@ -2102,7 +2252,7 @@ int set_plugin_module(struct config_elements * config, const char * name, json_t
                         "gpmi_name",
                         name);
   o_free(parameters);
-  res = h_update(config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = G_OK;
@@ -2111,10 +2261,12 @@ int set_plugin_module(struct config_elements * config, const char * name, json_t
     glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return ret;
 }
 
 int delete_plugin_module(struct config_elements * config, const char * name) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   int ret, res;
   json_t * j_query, * j_result = manage_plugin_module(config, name, GLEWLWYD_MODULE_ACTION_STOP);
   struct _plugin_module_instance * instance;
@@ -2131,7 +2283,7 @@ int delete_plugin_module(struct config_elements * config, const char * name) {
                             "where",
                               "gpmi_name",
                               name);
-        res = h_delete(config->conn, j_query, NULL);
+        res = h_delete(conn, j_query, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           ret = G_OK;
@@ -2154,6 +2306,7 @@ int delete_plugin_module(struct config_elements * config, const char * name) {
     ret = G_ERROR;
   }
   json_decref(j_result);
+  glewlwyd_db_pool_checkin(config, conn);
   return ret;
 }
 
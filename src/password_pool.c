@@ -0,0 +1,285 @@
+/**
+ *
+ * Glewlwyd SSO Server
+ *
+ * Authentiation server
+ * Users are authenticated via various backend available: database, ldap
+ * Using various authentication methods available: password, OTP, send code, etc.
+ *
+ * Password verification pool functions definitions
+ *
+ * Copyright 2016-2021 Nicolas Mora <mail@babelouest.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU GENERAL PUBLIC LICENSE
+ * License as published by the Free Software Foundation;
+ * version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU GENERAL PUBLIC LICENSE for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "glewlwyd.h"
+
+/**
+ * Password check waiting in the pool queue
+ * The task lives on the stack of the HTTP thread waiting for its result
+ */
+struct _glwd_password_task {
+  int                          (* check)(void * data);
+  void                         * data;
+  int                            result;
+  unsigned short                 done;
+  pthread_cond_t                 cond;
+  struct timespec                queued_at;
+  struct _glwd_password_task   * next;
+};
+
+static void * glewlwyd_password_pool_worker(void * args) {
+  struct _glwd_password_pool * pool = (struct _glwd_password_pool *)args;
+  struct _glwd_password_task * task;
+  struct timespec now;
+  int result;
+
+  pthread_mutex_lock(&pool->lock);
+  while (!pool->stop) {
+    // The workers lent as helper threads to a running check don't take a new check
+    if ((task = pool->head) != NULL && pool->nb_running + pool->nb_helper < pool->nb_worker) {
+      pool->head = task->next;
+      if (pool->head == NULL) {
+        pool->tail = NULL;
+      }
+      pool->size--;
+      pool->nb_running++;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      pool->wait_usec += (unsigned long long)((now.tv_sec - task->queued_at.tv_sec)*1000000 + (now.tv_nsec - task->queued_at.tv_nsec)/1000);
+      pthread_mutex_unlock(&pool->lock);
+      result = task->check(task->data);
+      pthread_mutex_lock(&pool->lock);
+      pool->nb_running--;
+      pool->nb_done++;
+      task->result = result;
+      task->done = 1;
+      pthread_cond_signal(&task->cond);
+    } else {
+      pthread_cond_wait(&pool->cond, &pool->lock);
+    }
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+/**
+ * Starts the password verification workers, if nb_worker is 0 the passwords are checked by the HTTP threads
+ */
+int glewlwyd_password_pool_init(struct config_elements * config) {
+  struct _glwd_password_pool * pool = &config->password_pool;
+  int ret = G_OK;
+  unsigned int i;
+
+  pool->head = NULL;
+  pool->tail = NULL;
+  pool->size = 0;
+  pool->stop = 0;
+  pool->nb_started = 0;
+  pool->nb_running = 0;
+  pool->nb_helper = 0;
+  pool->nb_waiting = 0;
+  pool->nb_done = 0;
+  pool->nb_rejected = 0;
+  pool->wait_usec = 0;
+  if (!pool->nb_worker) {
+    y_log_message(Y_LOG_LEVEL_INFO, "Password verification pool disabled");
+  } else if (!pool->max_size) {
+    y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_password_pool_init - Error invalid parameters");
+    ret = G_ERROR_PARAM;
+  } else if (pthread_mutex_init(&pool->lock, NULL) || pthread_cond_init(&pool->cond, NULL)) {
+    y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_password_pool_init - Error initializing lock or cond");
+    ret = G_ERROR;
+  } else if ((pool->worker_list = o_malloc(pool->nb_worker*sizeof(pthread_t))) == NULL) {
+    y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_password_pool_init - Error allocating resources for worker_list");
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->cond);
+    ret = G_ERROR_MEMORY;
+  } else {
+    pool->initialized = 1;
+    for (i=0; i<pool->nb_worker; i++) {
+      if (pthread_create(&pool->worker_list[i], NULL, glewlwyd_password_pool_worker, pool)) {
+        y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_password_pool_init - Error pthread_create");
+        ret = G_ERROR;
+        break;
+      }
+      pool->nb_started++;
+    }
+    if (ret != G_OK) {
+      glewlwyd_password_pool_close(config);
+    }
+  }
+  return ret;
+}
+
+/**
+ * Stops the workers after their current check, the checks still in the queue return G_ERROR_UNAVAILABLE
+ */
+void glewlwyd_password_pool_close(struct config_elements * config) {
+  struct _glwd_password_pool * pool = &config->password_pool;
+  struct _glwd_password_task * task;
+  unsigned int i;
+
+  if (pool->initialized) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+    for (i=0; i<pool->nb_started; i++) {
+      pthread_join(pool->worker_list[i], NULL);
+    }
+    pthread_mutex_lock(&pool->lock);
+    while ((task = pool->head) != NULL) {
+      pool->head = task->next;
+      task->result = G_ERROR_UNAVAILABLE;
+      task->done = 1;
+      pthread_cond_signal(&task->cond);
+    }
+    pool->tail = NULL;
+    pool->size = 0;
+    // The lock can't be destroyed until the HTTP threads waiting for a result have left
+    while (pool->nb_waiting) {
+      pthread_cond_wait(&pool->cond, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    o_free(pool->worker_list);
+    pool->worker_list = NULL;
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->cond);
+    pool->initialized = 0;
+  }
+}
+
+/**
+ * Runs check(data) on a password verification worker and waits for its result
+ * If the pool is disabled, check is run by the current thread
+ * If max_size checks are already waiting, the check isn't run and G_ERROR_UNAVAILABLE is returned,
+ * so the HTTP threads aren't all busy hashing passwords during a burst of logins
+ */
+int glewlwyd_password_pool_check(struct config_elements * config, int (* check)(void * data), void * data) {
+  struct _glwd_password_pool * pool = &config->password_pool;
+  struct _glwd_password_task task;
+  int ret;
+
+  if (check == NULL) {
+    ret = G_ERROR_PARAM;
+  } else if (!pool->initialized) {
+    ret = check(data);
+  } else if (pthread_cond_init(&task.cond, NULL)) {
+    y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_password_pool_check - Error pthread_cond_init");
+    ret = G_ERROR;
+  } else {
+    task.check = check;
+    task.data = data;
+    task.result = G_ERROR;
+    task.done = 0;
+    task.next = NULL;
+    pthread_mutex_lock(&pool->lock);
+    if (pool->stop) {
+      ret = G_ERROR_UNAVAILABLE;
+    } else if (pool->size >= pool->max_size) {
+      pool->nb_rejected++;
+      y_log_message(Y_LOG_LEVEL_WARNING, "glewlwyd_password_pool_check - Password verification queue full, check rejected");
+      ret = G_ERROR_UNAVAILABLE;
+    } else {
+      clock_gettime(CLOCK_MONOTONIC, &task.queued_at);
+      if (pool->tail != NULL) {
+        pool->tail->next = &task;
+      } else {
+        pool->head = &task;
+      }
+      pool->tail = &task;
+      pool->size++;
+      pool->nb_waiting++;
+      pthread_cond_signal(&pool->cond);
+      while (!task.done) {
+        pthread_cond_wait(&task.cond, &pool->lock);
+      }
+      pool->nb_waiting--;
+      if (pool->stop) {
+        pthread_cond_broadcast(&pool->cond);
+      }
+      ret = task.result;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    pthread_cond_destroy(&task.cond);
+  }
+  return ret;
+}
+
+/**
+ * Reserves at most nb helper threads for the check running on the current thread,
+ * the helpers use the workers idle, so the number of threads hashing passwords stays under nb_worker
+ * If the pool is disabled, the helpers aren't bounded by the pool
+ * Returns the number of helpers reserved, they must be released with glewlwyd_password_pool_release_helper
+ */
+size_t glewlwyd_password_pool_reserve_helper(struct config_elements * config, size_t nb) {
+  struct _glwd_password_pool * pool = &config->password_pool;
+  size_t ret = nb;
+
+  if (pool->initialized) {
+    pthread_mutex_lock(&pool->lock);
+    if (pool->nb_running + pool->nb_helper >= pool->nb_worker) {
+      ret = 0;
+    } else if (ret > pool->nb_worker - pool->nb_running - pool->nb_helper) {
+      ret = pool->nb_worker - pool->nb_running - pool->nb_helper;
+    }
+    pool->nb_helper += (unsigned int)ret;
+    pthread_mutex_unlock(&pool->lock);
+  }
+  return ret;
+}
+
+/**
+ * Gives back nb helper threads to the pool, the idle workers can take the next checks
+ */
+void glewlwyd_password_pool_release_helper(struct config_elements * config, size_t nb) {
+  struct _glwd_password_pool * pool = &config->password_pool;
+
+  if (pool->initialized && nb) {
+    pthread_mutex_lock(&pool->lock);
+    pool->nb_helper -= (unsigned int)nb;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
+
+size_t glewlwyd_module_callback_password_pool_reserve_helper(struct config_module * config, size_t nb) {
+  return glewlwyd_password_pool_reserve_helper(config->glewlwyd_config, nb);
+}
+
+void glewlwyd_module_callback_password_pool_release_helper(struct config_module * config, size_t nb) {
+  glewlwyd_password_pool_release_helper(config->glewlwyd_config, nb);
+}
+
+char * glewlwyd_password_pool_metrics(struct config_elements * config) {
+  struct _glwd_password_pool * pool = &config->password_pool;
+  char * content = NULL;
+
+  if (pool->initialized && !pthread_mutex_lock(&pool->lock)) {
+    content = msprintf("# HELP glewlwyd_password_pool_depth Number of password checks waiting in the queue\n# TYPE glewlwyd_password_pool_depth gauge\nglewlwyd_password_pool_depth %zu\n"
+                       "# HELP glewlwyd_password_pool_running Number of password checks running\n# TYPE glewlwyd_password_pool_running gauge\nglewlwyd_password_pool_running %u\n"
+                       "# HELP glewlwyd_password_pool_helpers Number of workers lent as helper threads to a running password check\n# TYPE glewlwyd_password_pool_helpers gauge\nglewlwyd_password_pool_helpers %u\n"
+                       "# HELP glewlwyd_password_pool_completed_total Total number of password checks completed\n# TYPE glewlwyd_password_pool_completed_total counter\nglewlwyd_password_pool_completed_total %zu\n"
+                       "# HELP glewlwyd_password_pool_rejected_total Total number of password checks rejected because the queue was full\n# TYPE glewlwyd_password_pool_rejected_total counter\nglewlwyd_password_pool_rejected_total %zu\n"
+                       "# HELP glewlwyd_password_pool_wait_seconds_total Total time spent by the password checks waiting in the queue\n# TYPE glewlwyd_password_pool_wait_seconds_total counter\nglewlwyd_password_pool_wait_seconds_total %.6f\n",
+                       pool->size, pool->nb_running, pool->nb_helper, pool->nb_done, pool->nb_rejected, (double)pool->wait_usec/1000000.0);
+    pthread_mutex_unlock(&pool->lock);
+  }
+  return content;
+}
@@ -0,0 +1,242 @@
+/**
+ *
+ * Glewlwyd SSO Server
+ *
+ * Authentiation server
+ * Users are authenticated via various backend available: database, ldap
+ * Using various authentication methods available: password, OTP, send code, etc.
+ *
+ * Multi-buffer PBKDF2-HMAC-SHA256 functions definitions
+ *
+ * Copyright 2016-2021 Nicolas Mora <mail@babelouest.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU GENERAL PUBLIC LICENSE
+ * License as published by the Free Software Foundation;
+ * version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU GENERAL PUBLIC LICENSE for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include <gnutls/gnutls.h>
+#include <nettle/pbkdf2.h>
+#include <nettle/sha2.h>
+
+#include "glewlwyd-common.h"
+
+/**
+ * The multi-buffer kernels run one derivation per 32 bits lane of a vector,
+ * 16 derivations at once with AVX-512, 8 with AVX2
+ * Both kernels are compiled, the one matching the CPU is selected at run time
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GLEWLWYD_PBKDF2_MULTI_BUFFER
+#endif
+
+#define GLEWLWYD_PBKDF2_KEY_SIZE   32
+#define GLEWLWYD_PBKDF2_BLOCK_SIZE 64
+
+#ifdef GLEWLWYD_PBKDF2_MULTI_BUFFER
+
+static const uint32_t glwd_sha256_k[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t glwd_sha256_iv[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+#define GLWD_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define GLWD_PBKDF2_LANES  16
+#define GLWD_PBKDF2_TARGET "avx512f"
+#define GLWD_PBKDF2_NAME(name) name##_avx512
+#include "pbkdf2_kernel.h"
+#undef GLWD_PBKDF2_LANES
+#undef GLWD_PBKDF2_TARGET
+#undef GLWD_PBKDF2_NAME
+
+#define GLWD_PBKDF2_LANES  8
+#define GLWD_PBKDF2_TARGET "avx2"
+#define GLWD_PBKDF2_NAME(name) name##_avx2
+#include "pbkdf2_kernel.h"
+#undef GLWD_PBKDF2_LANES
+#undef GLWD_PBKDF2_TARGET
+#undef GLWD_PBKDF2_NAME
+
+static uint32_t glwd_read_be32(const uint8_t * data) {
+  return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+}
+
+static void glwd_write_be32(uint8_t * data, uint32_t value) {
+  data[0] = (uint8_t)(value >> 24);
+  data[1] = (uint8_t)(value >> 16);
+  data[2] = (uint8_t)(value >> 8);
+  data[3] = (uint8_t)value;
+}
+
+/**
+ * Computes up to lanes derived keys
+ * The first iteration and the HMAC keys are computed by nettle,
+ * the other iterations by the multi-buffer kernel
+ */
+static void glwd_pbkdf2_sha256_multi(size_t lanes, size_t nb, const char ** data_list, const unsigned int * iterations_list, const uint8_t salt_list[][GLEWLWYD_DEFAULT_SALT_LENGTH], uint8_t out_key_list[][GLEWLWYD_PBKDF2_KEY_SIZE]) {
+  uint32_t ikey_block[16*GLEWLWYD_PBKDF2_MAX_LANES] = {0}, okey_block[16*GLEWLWYD_PBKDF2_MAX_LANES] = {0}, u1[8*GLEWLWYD_PBKDF2_MAX_LANES] = {0}, iterations[GLEWLWYD_PBKDF2_MAX_LANES] = {0}, t[8*GLEWLWYD_PBKDF2_MAX_LANES];
+  uint8_t key[GLEWLWYD_PBKDF2_BLOCK_SIZE], ipad[GLEWLWYD_PBKDF2_BLOCK_SIZE], opad[GLEWLWYD_PBKDF2_BLOCK_SIZE], u1_bytes[GLEWLWYD_PBKDF2_KEY_SIZE];
+  struct sha256_ctx ctx;
+  size_t lane, data_len, i;
+
+  for (lane=0; lane<nb; lane++) {
+    memset(key, 0, sizeof(key));
+    data_len = o_strlen(data_list[lane]);
+    if (data_len > GLEWLWYD_PBKDF2_BLOCK_SIZE) {
+      sha256_init(&ctx);
+      sha256_update(&ctx, data_len, (const uint8_t *)data_list[lane]);
+      sha256_digest(&ctx, SHA256_DIGEST_SIZE, key);
+    } else {
+      memcpy(key, data_list[lane], data_len);
+    }
+    for (i=0; i<GLEWLWYD_PBKDF2_BLOCK_SIZE; i++) {
+      ipad[i] = key[i] ^ 0x36;
+      opad[i] = key[i] ^ 0x5c;
+    }
+    for (i=0; i<16; i++) {
+      ikey_block[i*lanes+lane] = glwd_read_be32(ipad + 4*i);
+      okey_block[i*lanes+lane] = glwd_read_be32(opad + 4*i);
+    }
+    pbkdf2_hmac_sha256(data_len, (const uint8_t *)data_list[lane], 1, GLEWLWYD_DEFAULT_SALT_LENGTH, salt_list[lane], GLEWLWYD_PBKDF2_KEY_SIZE, u1_bytes);
+    for (i=0; i<8; i++) {
+      u1[i*lanes+lane] = glwd_read_be32(u1_bytes + 4*i);
+    }
+    iterations[lane] = iterations_list[lane];
+  }
+  if (lanes == 16) {
+    glwd_pbkdf2_sha256_iterate_avx512(ikey_block, okey_block, u1, iterations, t);
+  } else {
+    glwd_pbkdf2_sha256_iterate_avx2(ikey_block, okey_block, u1, iterations, t);
+  }
+  for (lane=0; lane<nb; lane++) {
+    for (i=0; i<8; i++) {
+      glwd_write_be32(out_key_list[lane] + 4*i, t[i*lanes+lane]);
+    }
+  }
+  gnutls_memset(key, 0, sizeof(key));
+  gnutls_memset(ipad, 0, sizeof(ipad));
+  gnutls_memset(opad, 0, sizeof(opad));
+  gnutls_memset(ikey_block, 0, sizeof(ikey_block));
+  gnutls_memset(okey_block, 0, sizeof(okey_block));
+}
+
+#endif
+
+/**
+ * Returns the number of PBKDF2 derivations computed at once by generate_digest_pbkdf2_multi:
+ * 16 with AVX-512, 8 with AVX2, 1 otherwise
+ */
+size_t generate_digest_pbkdf2_lanes(void) {
+  size_t lanes = 1;
+
+#ifdef GLEWLWYD_PBKDF2_MULTI_BUFFER
+  if (__builtin_cpu_supports("avx512f")) {
+    lanes = 16;
+  } else if (__builtin_cpu_supports("avx2")) {
+    lanes = 8;
+  }
+#endif
+  return lanes;
+}
+
+/**
+ * Returns the minimum number of digests computed with the multi-buffer kernel,
+ * smaller batches are computed one at a time with generate_digest_pbkdf2
+ */
+size_t generate_digest_pbkdf2_multi_min(void) {
+  return generate_digest_pbkdf2_lanes()/GLEWLWYD_PBKDF2_MULTI_MIN_RATIO;
+}
+
+/**
+ * Generates nb PBKDF2 digests, out_digest_list[i] is the same as the output of
+ * generate_digest_pbkdf2(data_list[i], iterations_list[i], salt_list[i], out_digest_list[i])
+ * if salt_list is NULL or salt_list[i] is NULL, a random salt is used
+ * The digests are computed generate_digest_pbkdf2_lanes() at a time,
+ * or one at a time with generate_digest_pbkdf2 if the CPU has no AVX2
+ * or if the batch has less than generate_digest_pbkdf2_multi_min() digests
+ */
+int generate_digest_pbkdf2_multi(size_t nb, const char ** data_list, const unsigned int * iterations_list, const char ** salt_list, char ** out_digest_list) {
+  int ret = 1;
+  size_t i;
+#ifdef GLEWLWYD_PBKDF2_MULTI_BUFFER
+  char my_salt[GLEWLWYD_DEFAULT_SALT_LENGTH + 1] = {0};
+  uint8_t cur_salt_list[GLEWLWYD_PBKDF2_MAX_LANES][GLEWLWYD_DEFAULT_SALT_LENGTH], key_list[GLEWLWYD_PBKDF2_MAX_LANES][GLEWLWYD_PBKDF2_KEY_SIZE], dst[GLEWLWYD_PBKDF2_KEY_SIZE + GLEWLWYD_DEFAULT_SALT_LENGTH];
+  size_t lanes = generate_digest_pbkdf2_lanes(), multi_min = generate_digest_pbkdf2_multi_min(), offset, lane, nb_lane, encoded_key_size_base64;
+#endif
+
+  if (data_list == NULL || iterations_list == NULL || out_digest_list == NULL) {
+    ret = 0;
+  } else {
+    for (i=0; i<nb; i++) {
+      if (data_list[i] == NULL || !iterations_list[i] || out_digest_list[i] == NULL) {
+        ret = 0;
+      }
+    }
+  }
+  if (ret) {
+#ifdef GLEWLWYD_PBKDF2_MULTI_BUFFER
+    if (nb > 1 && lanes > 1) {
+      for (offset=0; ret && offset<nb; offset+=lanes) {
+        nb_lane = nb-offset<lanes?nb-offset:lanes;
+        if (nb_lane < multi_min) {
+          // The last batch is too small for the multi-buffer kernel
+          for (lane=0; ret && lane<nb_lane; lane++) {
+            ret = generate_digest_pbkdf2(data_list[offset+lane], iterations_list[offset+lane], salt_list!=NULL?salt_list[offset+lane]:NULL, out_digest_list[offset+lane]);
+          }
+        } else {
+          for (lane=0; ret && lane<nb_lane; lane++) {
+            if (salt_list != NULL && salt_list[offset+lane] != NULL) {
+              memcpy(cur_salt_list[lane], salt_list[offset+lane], GLEWLWYD_DEFAULT_SALT_LENGTH);
+            } else if (rand_string_nonce(my_salt, GLEWLWYD_DEFAULT_SALT_LENGTH) != NULL) {
+              memcpy(cur_salt_list[lane], my_salt, GLEWLWYD_DEFAULT_SALT_LENGTH);
+            } else {
+              ret = 0;
+            }
+          }
+          if (ret) {
+            glwd_pbkdf2_sha256_multi(lanes, nb_lane, data_list+offset, iterations_list+offset, (const uint8_t (*)[GLEWLWYD_DEFAULT_SALT_LENGTH])cur_salt_list, key_list);
+            for (lane=0; ret && lane<nb_lane; lane++) {
+              memcpy(dst, key_list[lane], GLEWLWYD_PBKDF2_KEY_SIZE);
+              memcpy(dst+GLEWLWYD_PBKDF2_KEY_SIZE, cur_salt_list[lane], GLEWLWYD_DEFAULT_SALT_LENGTH);
+              if (!o_base64_encode(dst, GLEWLWYD_PBKDF2_KEY_SIZE + GLEWLWYD_DEFAULT_SALT_LENGTH, (unsigned char *)out_digest_list[offset+lane], &encoded_key_size_base64)) {
+                ret = 0;
+              }
+            }
+          }
+        }
+      }
+      gnutls_memset(key_list, 0, sizeof(key_list));
+    } else {
+#endif
+      for (i=0; ret && i<nb; i++) {
+        ret = generate_digest_pbkdf2(data_list[i], iterations_list[i], salt_list!=NULL?salt_list[i]:NULL, out_digest_list[i]);
+      }
+#ifdef GLEWLWYD_PBKDF2_MULTI_BUFFER
+    }
+#endif
+  }
+  return ret;
+}
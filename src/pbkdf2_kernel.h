@@ -0,0 +1,122 @@
+/**
+ *
+ * Glewlwyd SSO Server
+ *
+ * Authentiation server
+ * Users are authenticated via various backend available: database, ldap
+ * Using various authentication methods available: password, OTP, send code, etc.
+ *
+ * Multi-buffer PBKDF2-HMAC-SHA256 kernel
+ * This file is included by pbkdf2.c once per instruction set, with the macros
+ * GLWD_PBKDF2_LANES, GLWD_PBKDF2_TARGET and GLWD_PBKDF2_NAME defined
+ *
+ * Copyright 2016-2021 Nicolas Mora <mail@babelouest.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU GENERAL PUBLIC LICENSE
+ * License as published by the Free Software Foundation;
+ * version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU GENERAL PUBLIC LICENSE for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+typedef uint32_t GLWD_PBKDF2_NAME(glwd_pbkdf2_vec) __attribute__((vector_size(GLWD_PBKDF2_LANES * sizeof(uint32_t))));
+
+/**
+ * SHA-256 compression of one 64 bytes block per lane
+ */
+__attribute__((target(GLWD_PBKDF2_TARGET), always_inline))
+static inline void GLWD_PBKDF2_NAME(glwd_sha256_compress)(GLWD_PBKDF2_NAME(glwd_pbkdf2_vec) * state, const GLWD_PBKDF2_NAME(glwd_pbkdf2_vec) * block) {
+  GLWD_PBKDF2_NAME(glwd_pbkdf2_vec) w[16], a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7], t1, t2, s0, s1;
+  int i;
+
+  for (i=0; i<64; i++) {
+    if (i < 16) {
+      w[i] = block[i];
+    } else {
+      s0 = GLWD_ROTR(w[(i+1)&15], 7) ^ GLWD_ROTR(w[(i+1)&15], 18) ^ (w[(i+1)&15] >> 3);
+      s1 = GLWD_ROTR(w[(i+14)&15], 17) ^ GLWD_ROTR(w[(i+14)&15], 19) ^ (w[(i+14)&15] >> 10);
+      w[i&15] += s0 + w[(i+9)&15] + s1;
+    }
+    t1 = h + (GLWD_ROTR(e, 6) ^ GLWD_ROTR(e, 11) ^ GLWD_ROTR(e, 25)) + ((e & f) ^ (~e & g)) + glwd_sha256_k[i] + w[i&15];
+    t2 = (GLWD_ROTR(a, 2) ^ GLWD_ROTR(a, 13) ^ GLWD_ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
+
+/**
+ * Runs the iterations 2 to iterations[lane] of PBKDF2-HMAC-SHA256 for each lane
+ * ikey_block and okey_block are the HMAC keys xor ipad and opad, u1 is the first iteration,
+ * t_out is set with the derived keys, all arrays are big endian words, word i of lane l at i*GLWD_PBKDF2_LANES+l
+ */
+__attribute__((target(GLWD_PBKDF2_TARGET)))
+static void GLWD_PBKDF2_NAME(glwd_pbkdf2_sha256_iterate)(const uint32_t * ikey_block, const uint32_t * okey_block, const uint32_t * u1, const uint32_t * iterations, uint32_t * t_out) {
+  GLWD_PBKDF2_NAME(glwd_pbkdf2_vec) istate[8], ostate[8], state[8], u[16], inner[16], t[8], iter_vec, mask;
+  uint32_t max_iterations = 0, j;
+  int i;
+
+  for (i=0; i<16; i++) {
+    memcpy(&u[i], ikey_block + i*GLWD_PBKDF2_LANES, sizeof(u[i]));
+    memcpy(&inner[i], okey_block + i*GLWD_PBKDF2_LANES, sizeof(inner[i]));
+  }
+  for (i=0; i<8; i++) {
+    istate[i] = ostate[i] = (GLWD_PBKDF2_NAME(glwd_pbkdf2_vec)){0} + glwd_sha256_iv[i];
+  }
+  GLWD_PBKDF2_NAME(glwd_sha256_compress)(istate, u);
+  GLWD_PBKDF2_NAME(glwd_sha256_compress)(ostate, inner);
+
+  // The HMAC messages are 32 bytes long, the padding of their second block doesn't change
+  for (i=0; i<8; i++) {
+    memcpy(&u[i], u1 + i*GLWD_PBKDF2_LANES, sizeof(u[i]));
+    t[i] = u[i];
+    u[i+8] = inner[i+8] = (GLWD_PBKDF2_NAME(glwd_pbkdf2_vec)){0};
+  }
+  u[8] = inner[8] = (GLWD_PBKDF2_NAME(glwd_pbkdf2_vec)){0} + 0x80000000;
+  u[15] = inner[15] = (GLWD_PBKDF2_NAME(glwd_pbkdf2_vec)){0} + ((GLEWLWYD_PBKDF2_BLOCK_SIZE + GLEWLWYD_PBKDF2_KEY_SIZE) * 8);
+  memcpy(&iter_vec, iterations, sizeof(iter_vec));
+  for (i=0; i<GLWD_PBKDF2_LANES; i++) {
+    if (iterations[i] > max_iterations) {
+      max_iterations = iterations[i];
+    }
+  }
+
+  for (j=1; j<max_iterations; j++) {
+    memcpy(state, istate, sizeof(state));
+    GLWD_PBKDF2_NAME(glwd_sha256_compress)(state, u);
+    memcpy(inner, state, sizeof(state));
+    memcpy(state, ostate, sizeof(state));
+    GLWD_PBKDF2_NAME(glwd_sha256_compress)(state, inner);
+    // The lanes with less iterations keep their result
+    mask = (GLWD_PBKDF2_NAME(glwd_pbkdf2_vec))(((GLWD_PBKDF2_NAME(glwd_pbkdf2_vec)){0} + j) < iter_vec);
+    for (i=0; i<8; i++) {
+      u[i] = state[i];
+      t[i] ^= state[i] & mask;
+    }
+  }
+
+  for (i=0; i<8; i++) {
+    memcpy(t_out + i*GLWD_PBKDF2_LANES, &t[i], sizeof(t[i]));
+  }
+}
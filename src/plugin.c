@@ -36,7 +36,12 @@ int glewlwyd_callback_add_plugin_endpoint(struct config_plugin * config, const c
   if (config != NULL && config->glewlwyd_config != NULL && config->glewlwyd_config->instance != NULL && method != NULL && name != NULL && url != NULL && callback != NULL && 0 != o_strncasecmp(name, "auth", o_strlen("auth"))) {
     p_url = msprintf("%s/%s", name, url);
     if (p_url != NULL) {
-      if ((ret = ulfius_add_endpoint_by_val(config->glewlwyd_config->instance, method, config->glewlwyd_config->api_prefix, p_url, GLEWLWYD_CALLBACK_PRIORITY_PLUGIN + priority, callback, user_data)) != U_OK) {
+      if (priority == GLEWLWYD_CALLBACK_PRIORITY_APPLICATION) {
+        ret = glewlwyd_add_timed_endpoint(config->glewlwyd_config, name, method, config->glewlwyd_config->api_prefix, p_url, GLEWLWYD_CALLBACK_PRIORITY_PLUGIN + priority, callback, user_data);
+      } else {
+        ret = ulfius_add_endpoint_by_val(config->glewlwyd_config->instance, method, config->glewlwyd_config->api_prefix, p_url, GLEWLWYD_CALLBACK_PRIORITY_PLUGIN + priority, callback, user_data);
+      }
+      if (ret != U_OK) {
         y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_callback_add_plugin_endpoint - Error %d ulfius_add_endpoint_by_val %s - %s/%s",ret, method, config->glewlwyd_config->api_prefix, p_url);
         ret = G_ERROR;
       } else {
@@ -139,7 +144,9 @@ json_t * glewlwyd_callback_check_user_valid(struct config_plugin * config, const
       check_password = 1;
       if (password != NULL) {
         j_auth = auth_check_user_credentials(config->glewlwyd_config, username, password);
-        if (!check_result_value(j_auth, G_OK)) {
+        if (check_result_value(j_auth, G_ERROR_UNAVAILABLE)) {
+          check_password = -1;
+        } else if (!check_result_value(j_auth, G_OK)) {
           check_password = 0;
         }
         json_decref(j_auth);
@@ -179,7 +186,9 @@ json_t * glewlwyd_callback_check_user_valid(struct config_plugin * config, const
         }
         free_string_array(scope_array);
       }
-      if (check_password && check_scope) {
+      if (check_password < 0) {
+        j_return = json_pack("{si}", "result", G_ERROR_UNAVAILABLE);
+      } else if (check_password && check_scope) {
         j_return = json_pack("{sisO}", "result", G_OK, "user", json_object_get(j_user, "user"));
       } else {
         j_return = json_pack("{si}", "result", G_ERROR_UNAUTHORIZED);
@@ -212,13 +221,17 @@ json_t * glewlwyd_callback_check_client_valid(struct config_plugin * config, con
           }
         } else {
           j_client_credentials = auth_check_client_credentials(config->glewlwyd_config, client_id, password);
-          if (!check_result_value(j_client_credentials, G_OK)) {
+          if (check_result_value(j_client_credentials, G_ERROR_UNAVAILABLE)) {
+            password_checked = -1;
+          } else if (!check_result_value(j_client_credentials, G_OK)) {
             password_checked = 0;
           }
           json_decref(j_client_credentials);
         }
       }
-      if (password_checked) {
+      if (password_checked < 0) {
+        j_return = json_pack("{si}", "result", G_ERROR_UNAVAILABLE);
+      } else if (password_checked) {
         j_return = json_pack("{sisO}", "result", G_OK, "client", json_object_get(j_client, "client"));
       } else {
         j_return = json_pack("{si}", "result", G_ERROR_UNAUTHORIZED);
@@ -251,19 +264,21 @@ json_t * glewlwyd_callback_get_client_granted_scopes(struct config_plugin * conf
 }
 
 int glewlwyd_callback_trigger_session_used(struct config_plugin * config, const struct _u_request * request, const char * scope_list) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config->glewlwyd_config);
   json_t * j_session = glewlwyd_callback_check_session_valid(config, request, scope_list), * j_query, * j_scope, * j_scheme_processed, * j_group, * j_scheme;
-  char * session_uid = get_session_id(config->glewlwyd_config, request), * session_hash = NULL, * clause_session, * username_escaped, * clause_scheme, * escape_scheme_module, * escape_scheme_name;
+  char * session_uid = get_session_id(config->glewlwyd_config, request), * clause_session, * username_escaped, * clause_scheme, * escape_scheme_module, * escape_scheme_name;
   int ret, res, password_processed = 0;
   const char * key_scope, * key_group;
   size_t index;
+  char session_hash[GLEWLWYD_HASH_BUFFER_SIZE];
 
   if (check_result_value(j_session, G_OK) || session_uid == NULL) {
-    if ((session_hash = generate_hash(config->glewlwyd_config->hash_algorithm, session_uid)) != NULL) {
+    if (generate_hash_buffer(config->glewlwyd_config->hash_algorithm, session_uid, 0, session_hash, sizeof(session_hash)) == G_OK) {
       j_scheme_processed = json_object();
       if (j_scheme_processed != NULL) {
         ret = G_OK;
-        username_escaped = h_escape_string_with_quotes(config->glewlwyd_config->conn, json_string_value(json_object_get(json_object_get(json_object_get(j_session, "session"), "user"), "username")));
-        clause_session = msprintf("IN (SELECT gus_id FROM " GLEWLWYD_TABLE_USER_SESSION " WHERE gus_session_hash='%s' AND gus_username=%s AND gus_expiration %s AND gus_enabled=1 AND gus_current=1)", session_hash, username_escaped, SWITCH_DB_TYPE(config->glewlwyd_config->conn->type, "> NOW()", "> (strftime('%s','now'))", "> NOW()"));
+        username_escaped = h_escape_string_with_quotes(conn, json_string_value(json_object_get(json_object_get(json_object_get(j_session, "session"), "user"), "username")));
+        clause_session = msprintf("IN (SELECT gus_id FROM " GLEWLWYD_TABLE_USER_SESSION " WHERE gus_session_hash='%s' AND gus_username=%s AND gus_expiration %s AND gus_enabled=1 AND gus_current=1)", session_hash, username_escaped, SWITCH_DB_TYPE(conn->type, "> NOW()", "> (strftime('%s','now'))", "> NOW()"));
         json_object_foreach(json_object_get(json_object_get(j_session, "session"), "scope"), key_scope, j_scope) {
           if (!password_processed && json_object_get(j_scope, "password_authenticated") == json_true()) {
             password_processed = 1;
@@ -289,8 +304,8 @@ int glewlwyd_callback_trigger_session_used(struct config_plugin * config, const
                                     "operator",
                                     "raw",
                                     "value",
-                                    SWITCH_DB_TYPE(config->glewlwyd_config->conn->type, "> NOW()", "> (strftime('%s','now'))", "> NOW()"));
-            res = h_update(config->glewlwyd_config->conn, j_query, NULL);
+                                    SWITCH_DB_TYPE(conn->type, "> NOW()", "> (strftime('%s','now'))", "> NOW()"));
+            res = h_update(conn, j_query, NULL);
             json_decref(j_query);
             if (res != H_OK) {
               y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_callback_trigger_session_used - Error h_update for password scheme");
@@ -303,8 +318,8 @@ int glewlwyd_callback_trigger_session_used(struct config_plugin * config, const
               if (json_object_get(j_scheme, "scheme_authenticated") == json_true() && json_object_get(j_scheme_processed, json_string_value(json_object_get(j_scheme, "scheme_name"))) == NULL) {
                 json_object_set_new(j_scheme_processed, json_string_value(json_object_get(j_scheme, "scheme_name")), json_object());
                 // Increment guss_use_counter for the specified scheme on the specified session
-                escape_scheme_module = h_escape_string_with_quotes(config->glewlwyd_config->conn, json_string_value(json_object_get(j_scheme, "scheme_type")));
-                escape_scheme_name = h_escape_string_with_quotes(config->glewlwyd_config->conn, json_string_value(json_object_get(j_scheme, "scheme_name")));
+                escape_scheme_module = h_escape_string_with_quotes(conn, json_string_value(json_object_get(j_scheme, "scheme_type")));
+                escape_scheme_name = h_escape_string_with_quotes(conn, json_string_value(json_object_get(j_scheme, "scheme_name")));
                 clause_scheme = msprintf("IN (SELECT guasmi_id FROM " GLEWLWYD_TABLE_USER_AUTH_SCHEME_MODULE_INSTANCE " WHERE guasmi_module=%s AND guasmi_name=%s)", escape_scheme_module, escape_scheme_name);
                 j_query = json_pack("{sss{s{ss}}s{s{ssss}s{ssss}sis{ssss}}}",
                                     "table",
@@ -330,11 +345,11 @@ int glewlwyd_callback_trigger_session_used(struct config_plugin * config, const
                                         "operator",
                                         "raw",
                                         "value",
-                                        SWITCH_DB_TYPE(config->glewlwyd_config->conn->type, "> NOW()", "> (strftime('%s','now'))", "> NOW()"));
+                                        SWITCH_DB_TYPE(conn->type, "> NOW()", "> (strftime('%s','now'))", "> NOW()"));
                 o_free(clause_scheme);
                 o_free(escape_scheme_name);
                 o_free(escape_scheme_module);
-                res = h_update(config->glewlwyd_config->conn, j_query, NULL);
+                res = h_update(conn, j_query, NULL);
                 json_decref(j_query);
                 if (res != H_OK) {
                   y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_callback_trigger_session_used - Error h_update for scheme %s/%s", json_string_value(json_object_get(j_scheme, "scheme_type")), json_string_value(json_object_get(j_scheme, "scheme_name")));
@@ -353,29 +368,30 @@ int glewlwyd_callback_trigger_session_used(struct config_plugin * config, const
         ret = G_ERROR;
       }
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_callback_trigger_session_used - Error generate_hash");
+      y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_callback_trigger_session_used - Error generate_hash_buffer");
       ret = G_ERROR;
     }
-    o_free(session_hash);
   } else {
     y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_callback_trigger_session_used - Error glewlwyd_callback_check_session_valid or session_uid NULL");
     ret = G_ERROR;
   }
   json_decref(j_session);
   o_free(session_uid);
+  glewlwyd_db_pool_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 time_t glewlwyd_callback_get_session_age(struct config_plugin * config, const struct _u_request * request, const char * scope_list) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config->glewlwyd_config);
   time_t age = 0;
-  char * session_uid = get_session_id(config->glewlwyd_config, request), * session_uid_hash, * query, ** scope_array = NULL, * scope_escaped, * scope_list_clause = NULL;
+  char * session_uid = get_session_id(config->glewlwyd_config, request), session_uid_hash[GLEWLWYD_HASH_BUFFER_SIZE], * query, ** scope_array = NULL, * scope_escaped, * scope_list_clause = NULL;
   json_t * j_result;
   
   if (session_uid != NULL) {
-    if ((session_uid_hash = generate_hash(config->glewlwyd_config->hash_algorithm, session_uid)) != NULL) {
+    if (generate_hash_buffer(config->glewlwyd_config->hash_algorithm, session_uid, 0, session_uid_hash, sizeof(session_uid_hash)) == G_OK) {
       if (split_string(scope_list, " ", &scope_array)) {
         for (int i=0; scope_array[i] != NULL; i++) {
-          scope_escaped = h_escape_string_with_quotes(config->glewlwyd_config->conn, scope_array[i]);
+          scope_escaped = h_escape_string_with_quotes(conn, scope_array[i]);
           if (scope_list_clause == NULL) {
             scope_list_clause = msprintf("%s", scope_escaped);
           } else {
@@ -385,8 +401,8 @@ time_t glewlwyd_callback_get_session_age(struct config_plugin * config, const st
         }
         if (scope_list_clause != NULL) {
           // Quey to retreive the most recent, enabled and succeeded authentication date for the current session
-          query = msprintf("SELECT %s FROM " GLEWLWYD_TABLE_USER_SESSION_SCHEME " WHERE guss_enabled=1 AND gus_id IN (SELECT gus_id FROM " GLEWLWYD_TABLE_USER_SESSION " WHERE gus_session_hash='%s' AND gus_current=1) AND (guasmi_id IS NULL OR guasmi_id IN (SELECT guasmi_id FROM " GLEWLWYD_TABLE_SCOPE_GROUP_AUTH_SCHEME_MODULE_INSTANCE " WHERE gsg_id IN (SELECT gsg_id FROM " GLEWLWYD_TABLE_SCOPE_GROUP " WHERE gs_id IN (SELECT gs_id FROM " GLEWLWYD_TABLE_SCOPE " WHERE gs_name IN (%s))))) ORDER BY guss_last_login DESC LIMIT 1;", (SWITCH_DB_TYPE(config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(guss_last_login) AS guss_last_login", "guss_last_login", "EXTRACT(EPOCH FROM guss_last_login)::integer AS guss_last_login")), session_uid_hash, scope_list_clause);
-          if (h_execute_query_json(config->glewlwyd_config->conn, query, &j_result) == H_OK) {
+          query = msprintf("SELECT %s FROM " GLEWLWYD_TABLE_USER_SESSION_SCHEME " WHERE guss_enabled=1 AND gus_id IN (SELECT gus_id FROM " GLEWLWYD_TABLE_USER_SESSION " WHERE gus_session_hash='%s' AND gus_current=1) AND (guasmi_id IS NULL OR guasmi_id IN (SELECT guasmi_id FROM " GLEWLWYD_TABLE_SCOPE_GROUP_AUTH_SCHEME_MODULE_INSTANCE " WHERE gsg_id IN (SELECT gsg_id FROM " GLEWLWYD_TABLE_SCOPE_GROUP " WHERE gs_id IN (SELECT gs_id FROM " GLEWLWYD_TABLE_SCOPE " WHERE gs_name IN (%s))))) ORDER BY guss_last_login DESC LIMIT 1;", (SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(guss_last_login) AS guss_last_login", "guss_last_login", "EXTRACT(EPOCH FROM guss_last_login)::integer AS guss_last_login")), session_uid_hash, scope_list_clause);
+          if (h_execute_query_json(conn, query, &j_result) == H_OK) {
             if (json_array_size(j_result)) {
               age = (time_t)json_integer_value(json_object_get(json_array_get(j_result, 0), "guss_last_login"));
             }
@@ -402,11 +418,11 @@ time_t glewlwyd_callback_get_session_age(struct config_plugin * config, const st
         y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_callback_get_session_age - Error split_string");
       }
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_callback_get_session_age - Error generate_hash for session_uid");
+      y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_callback_get_session_age - Error generate_hash_buffer for session_uid");
     }
-    o_free(session_uid_hash);
   }
   o_free(session_uid);
+  glewlwyd_db_pool_checkin(config->glewlwyd_config, conn);
   return age;
 }
 
@@ -461,6 +477,10 @@ char * glewlwyd_callback_generate_hash(struct config_plugin * config, const char
   return generate_hash(config->glewlwyd_config->hash_algorithm, data);
 }
 
+int glewlwyd_callback_generate_hash_buffer(struct config_plugin * config, const char * data, char * out_hash, size_t out_hash_size) {
+  return generate_hash_buffer(config->glewlwyd_config->hash_algorithm, data, 0, out_hash, out_hash_size);
+}
+
 void glewlwyd_callback_update_issued_for(struct config_plugin * config, const struct _h_connection * conn, const char * sql_table, const char * issued_for_column, const char * issued_for_value, const char * id_column, json_int_t id_value) {
   const struct _h_connection * cur_conn = conn;
   
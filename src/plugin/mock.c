@@ -75,6 +75,7 @@
  *   char   * (* glewlwyd_callback_get_plugin_external_url)(struct config_plugin * config, const char * name);
  *   char   * (* glewlwyd_callback_get_login_url)(struct config_plugin * config, const char * client_id, const char * scope_list, const char * callback_url, struct _u_map * additional_parameters);
  *   char   * (* glewlwyd_callback_generate_hash)(struct config_plugin * config, const char * data);
+ *   int      (* glewlwyd_callback_generate_hash_buffer)(struct config_plugin * config, const char * data, char * out_hash, size_t out_hash_size);
  * };
  *
  * The functions glewlwyd_callback_add_plugin_endpoint and glewlwyd_callback_remove_plugin_endpoint exist to dynamically add or remove endpoints
@@ -91,7 +91,6 @@ struct _oauth2_config {
   json_int_t                         code_duration;
   unsigned short int                 refresh_token_rolling;
   unsigned short int                 auth_type_enabled[5];
-  pthread_mutex_t                    insert_lock;
   struct _glewlwyd_resource_config * glewlwyd_resource_config;
   struct _glewlwyd_resource_config * introspect_revoke_resource_config;
 };
@@ -334,100 +333,97 @@ static char * generate_query_parameters(struct _u_map * map_url, struct _u_map *
 }
 
 static int serialize_access_token(struct _oauth2_config * config, uint auth_type, json_int_t gpgr_id, const char * username, const char * client_id, const char * scope_list, time_t now, const char * issued_for, const char * user_agent, const char * access_token) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_last_id;
   int res, ret, i;
   char * issued_at_clause, ** scope_array = NULL, * access_token_hash = NULL;
   
-  if (pthread_mutex_lock(&config->insert_lock)) {
-    y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oauth2 - Error pthread_mutex_lock");
-    ret = G_ERROR;
-  } else {
-    if ((access_token_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, access_token)) != NULL) {
-      if (issued_for != NULL && now > 0) {
-        if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
-          issued_at_clause = msprintf("FROM_UNIXTIME(%u)", (now));
-        } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
-          issued_at_clause = msprintf("TO_TIMESTAMP(%u)", (now));
-        } else { // HOEL_DB_TYPE_SQLITE
-          issued_at_clause = msprintf("%u", (now));
-        }
-        j_query = json_pack("{sss{sssisososos{ss}ssssss}}",
-                            "table",
-                            GLEWLWYD_PLUGIN_OAUTH2_TABLE_ACCESS_TOKEN,
-                            "values",
-                              "gpga_plugin_name",
-                              config->name,
-                              "gpga_authorization_type",
-                              auth_type,
-                              "gpgr_id",
-                              gpgr_id?json_integer(gpgr_id):json_null(),
-                              "gpga_username",
-                              username!=NULL?json_string(username):json_null(),
-                              "gpga_client_id",
-                              client_id!=NULL?json_string(client_id):json_null(),
-                              "gpga_issued_at",
-                                "raw",
-                                issued_at_clause,
-                              "gpga_issued_for",
-                              issued_for,
-                              "gpga_user_agent",
-                              user_agent!=NULL?user_agent:"",
-                              "gpga_token_hash",
-                              access_token_hash);
-        o_free(issued_at_clause);
-        res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
-        json_decref(j_query);
-        if (res == H_OK) {
-          j_last_id = h_last_insert_id(config->glewlwyd_config->glewlwyd_config->conn);
-          if (j_last_id != NULL) {
-            if (split_string(scope_list, " ", &scope_array) > 0) {
-              j_query = json_pack("{sss[]}",
-                                  "table",
-                                  GLEWLWYD_PLUGIN_OAUTH2_TABLE_ACCESS_TOKEN_SCOPE,
-                                  "values");
-              if (j_query != NULL) {
-                for (i=0; scope_array[i] != NULL; i++) {
-                  json_array_append_new(json_object_get(j_query, "values"), json_pack("{sOss}", "gpga_id", j_last_id, "gpgas_scope", scope_array[i]));
-                }
-                res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
-                json_decref(j_query);
-                if (res == H_OK) {
-                  ret = G_OK;
-                } else {
-                  y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oauth2 - Error executing j_query (2)");
-                  config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
-                  ret = G_ERROR_DB;
-                }
+  if ((access_token_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, access_token)) != NULL) {
+    if (issued_for != NULL && now > 0) {
+      if (conn->type==HOEL_DB_TYPE_MARIADB) {
+        issued_at_clause = msprintf("FROM_UNIXTIME(%u)", (now));
+      } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
+        issued_at_clause = msprintf("TO_TIMESTAMP(%u)", (now));
+      } else { // HOEL_DB_TYPE_SQLITE
+        issued_at_clause = msprintf("%u", (now));
+      }
+      j_query = json_pack("{sss{sssisososos{ss}ssssss}}",
+                          "table",
+                          GLEWLWYD_PLUGIN_OAUTH2_TABLE_ACCESS_TOKEN,
+                          "values",
+                            "gpga_plugin_name",
+                            config->name,
+                            "gpga_authorization_type",
+                            auth_type,
+                            "gpgr_id",
+                            gpgr_id?json_integer(gpgr_id):json_null(),
+                            "gpga_username",
+                            username!=NULL?json_string(username):json_null(),
+                            "gpga_client_id",
+                            client_id!=NULL?json_string(client_id):json_null(),
+                            "gpga_issued_at",
+                              "raw",
+                              issued_at_clause,
+                            "gpga_issued_for",
+                            issued_for,
+                            "gpga_user_agent",
+                            user_agent!=NULL?user_agent:"",
+                            "gpga_token_hash",
+                            access_token_hash);
+      o_free(issued_at_clause);
+      config->glewlwyd_config->glewlwyd_callback_db_insert_begin(config->glewlwyd_config, conn);
+      res = config->glewlwyd_config->glewlwyd_callback_db_insert(config->glewlwyd_config, conn, j_query, "gpga_id", &j_last_id);
+      json_decref(j_query);
+      if (res == H_OK) {
+        if (j_last_id != NULL) {
+          if (split_string(scope_list, " ", &scope_array) > 0) {
+            j_query = json_pack("{sss[]}",
+                                "table",
+                                GLEWLWYD_PLUGIN_OAUTH2_TABLE_ACCESS_TOKEN_SCOPE,
+                                "values");
+            if (j_query != NULL) {
+              for (i=0; scope_array[i] != NULL; i++) {
+                json_array_append_new(json_object_get(j_query, "values"), json_pack("{sOss}", "gpga_id", j_last_id, "gpgas_scope", scope_array[i]));
+              }
+              res = h_insert(conn, j_query, NULL);
+              json_decref(j_query);
+              if (res == H_OK) {
+                ret = G_OK;
               } else {
-                y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oauth2 - Error json_pack");
-                ret = G_ERROR;
+                y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oauth2 - Error executing j_query (2)");
+                config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+                ret = G_ERROR_DB;
               }
             } else {
-              y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oauth2 - Error split_string");
+              y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oauth2 - Error json_pack");
               ret = G_ERROR;
             }
-            free_string_array(scope_array);
           } else {
-            y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oauth2 - Error h_last_insert_id");
-            config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
-            ret = G_ERROR_DB;
+            y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oauth2 - Error split_string");
+            ret = G_ERROR;
           }
-          json_decref(j_last_id);
+          free_string_array(scope_array);
         } else {
-          y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oauth2 - Error executing j_query (1)");
+          y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oauth2 - Error h_last_insert_id");
           config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
           ret = G_ERROR_DB;
         }
+        json_decref(j_last_id);
       } else {
-        ret = G_ERROR_PARAM;
+        y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oauth2 - Error executing j_query (1)");
+        config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+        ret = G_ERROR_DB;
       }
-      o_free(access_token_hash);
+      config->glewlwyd_config->glewlwyd_callback_db_insert_end(config->glewlwyd_config, conn);
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oauth2 - Error glewlwyd_callback_generate_hash");
-      ret = G_ERROR;
+      ret = G_ERROR_PARAM;
     }
-    pthread_mutex_unlock(&config->insert_lock);
+    o_free(access_token_hash);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oauth2 - Error glewlwyd_callback_generate_hash");
+    ret = G_ERROR;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
@@ -539,123 +535,120 @@ static char * generate_access_token(struct _oauth2_config * config, const char *
 }
 
 static json_t * serialize_refresh_token(struct _oauth2_config * config, uint auth_type, json_int_t gpgc_id, const char * username, const char * client_id, const char * scope_list, time_t now, json_int_t duration, uint rolling, const char * token, const char * issued_for, const char * user_agent) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   char * token_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, token);
   json_t * j_query, * j_return, * j_last_id;
   int res, i;
   char * issued_at_clause, * expires_at_clause, * last_seen_clause, ** scope_array = NULL;
   
-  if (pthread_mutex_lock(&config->insert_lock)) {
-    y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oauth2 - Error pthread_mutex_lock");
-    j_return = json_pack("{si}", "result", G_ERROR);
-  } else {
-    if (token_hash != NULL && username != NULL && issued_for != NULL && now > 0 && duration > 0) {
-      json_error_t error;
-      if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
-        issued_at_clause = msprintf("FROM_UNIXTIME(%u)", (now));
-      } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
-        issued_at_clause = msprintf("TO_TIMESTAMP(%u)", (now));
-      } else { // HOEL_DB_TYPE_SQLITE
-        issued_at_clause = msprintf("%u", (now));
-      }
-      if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
-        last_seen_clause = msprintf("FROM_UNIXTIME(%u)", (now));
-      } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
-        last_seen_clause = msprintf("TO_TIMESTAMP(%u)", (now));
-      } else { // HOEL_DB_TYPE_SQLITE
-        last_seen_clause = msprintf("%u", (now));
-      }
-      if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
-        expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)duration));
-      } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
-        expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)duration ));
-      } else { // HOEL_DB_TYPE_SQLITE
-        expires_at_clause = msprintf("%u", (now + (time_t)duration));
-      }
-      j_query = json_pack_ex(&error, 0, "{sss{ss si so ss so s{ss} s{ss} s{ss} sI si ss ss ss}}",
-                          "table",
-                          GLEWLWYD_PLUGIN_OAUTH2_TABLE_REFRESH_TOKEN,
-                          "values",
-                            "gpgr_plugin_name",
-                            config->name,
-                            "gpgr_authorization_type",
-                            auth_type,
-                            "gpgc_id",
-                            gpgc_id?json_integer(gpgc_id):json_null(),
-                            "gpgr_username",
-                            username,
-                            "gpgr_client_id",
-                            client_id!=NULL?json_string(client_id):json_null(),
-                            "gpgr_issued_at",
-                              "raw",
-                              issued_at_clause,
-                            "gpgr_last_seen",
-                              "raw",
-                              last_seen_clause,
-                            "gpgr_expires_at",
-                              "raw",
-                              expires_at_clause,
-                            "gpgr_duration",
-                            duration,
-                            "gpgr_rolling_expiration",
-                            rolling,
-                            "gpgr_token_hash",
-                            token_hash,
-                            "gpgr_issued_for",
-                            issued_for,
-                            "gpgr_user_agent",
-                            user_agent!=NULL?user_agent:"");
-      o_free(issued_at_clause);
-      o_free(expires_at_clause);
-      o_free(last_seen_clause);
-      res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
-      json_decref(j_query);
-      if (res == H_OK) {
-        j_last_id = h_last_insert_id(config->glewlwyd_config->glewlwyd_config->conn);
-        if (j_last_id != NULL) {
-          if (split_string(scope_list, " ", &scope_array) > 0) {
-            j_query = json_pack("{sss[]}",
-                                "table",
-                                GLEWLWYD_PLUGIN_OAUTH2_TABLE_REFRESH_TOKEN_SCOPE,
-                                "values");
-            if (j_query != NULL) {
-              for (i=0; scope_array[i] != NULL; i++) {
-                json_array_append_new(json_object_get(j_query, "values"), json_pack("{sOss}", "gpgr_id", j_last_id, "gpgrs_scope", scope_array[i]));
-              }
-              res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
-              json_decref(j_query);
-              if (res == H_OK) {
-                j_return = json_pack("{sisO}", "result", G_OK, "gpgr_id", j_last_id);
-              } else {
-                y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oauth2 - Error executing j_query (2)");
-                config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
-                j_return = json_pack("{si}", "result", G_ERROR_DB);
-              }
+  if (token_hash != NULL && username != NULL && issued_for != NULL && now > 0 && duration > 0) {
+    json_error_t error;
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
+      issued_at_clause = msprintf("FROM_UNIXTIME(%u)", (now));
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
+      issued_at_clause = msprintf("TO_TIMESTAMP(%u)", (now));
+    } else { // HOEL_DB_TYPE_SQLITE
+      issued_at_clause = msprintf("%u", (now));
+    }
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
+      last_seen_clause = msprintf("FROM_UNIXTIME(%u)", (now));
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
+      last_seen_clause = msprintf("TO_TIMESTAMP(%u)", (now));
+    } else { // HOEL_DB_TYPE_SQLITE
+      last_seen_clause = msprintf("%u", (now));
+    }
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
+      expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)duration));
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
+      expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)duration ));
+    } else { // HOEL_DB_TYPE_SQLITE
+      expires_at_clause = msprintf("%u", (now + (time_t)duration));
+    }
+    j_query = json_pack_ex(&error, 0, "{sss{ss si so ss so s{ss} s{ss} s{ss} sI si ss ss ss}}",
+                        "table",
+                        GLEWLWYD_PLUGIN_OAUTH2_TABLE_REFRESH_TOKEN,
+                        "values",
+                          "gpgr_plugin_name",
+                          config->name,
+                          "gpgr_authorization_type",
+                          auth_type,
+                          "gpgc_id",
+                          gpgc_id?json_integer(gpgc_id):json_null(),
+                          "gpgr_username",
+                          username,
+                          "gpgr_client_id",
+                          client_id!=NULL?json_string(client_id):json_null(),
+                          "gpgr_issued_at",
+                            "raw",
+                            issued_at_clause,
+                          "gpgr_last_seen",
+                            "raw",
+                            last_seen_clause,
+                          "gpgr_expires_at",
+                            "raw",
+                            expires_at_clause,
+                          "gpgr_duration",
+                          duration,
+                          "gpgr_rolling_expiration",
+                          rolling,
+                          "gpgr_token_hash",
+                          token_hash,
+                          "gpgr_issued_for",
+                          issued_for,
+                          "gpgr_user_agent",
+                          user_agent!=NULL?user_agent:"");
+    o_free(issued_at_clause);
+    o_free(expires_at_clause);
+    o_free(last_seen_clause);
+    config->glewlwyd_config->glewlwyd_callback_db_insert_begin(config->glewlwyd_config, conn);
+    res = config->glewlwyd_config->glewlwyd_callback_db_insert(config->glewlwyd_config, conn, j_query, "gpgr_id", &j_last_id);
+    json_decref(j_query);
+    if (res == H_OK) {
+      if (j_last_id != NULL) {
+        if (split_string(scope_list, " ", &scope_array) > 0) {
+          j_query = json_pack("{sss[]}",
+                              "table",
+                              GLEWLWYD_PLUGIN_OAUTH2_TABLE_REFRESH_TOKEN_SCOPE,
+                              "values");
+          if (j_query != NULL) {
+            for (i=0; scope_array[i] != NULL; i++) {
+              json_array_append_new(json_object_get(j_query, "values"), json_pack("{sOss}", "gpgr_id", j_last_id, "gpgrs_scope", scope_array[i]));
+            }
+            res = h_insert(conn, j_query, NULL);
+            json_decref(j_query);
+            if (res == H_OK) {
+              j_return = json_pack("{sisO}", "result", G_OK, "gpgr_id", j_last_id);
             } else {
-              y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oauth2 - Error json_pack");
-              j_return = json_pack("{si}", "result", G_ERROR);
+              y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oauth2 - Error executing j_query (2)");
+              config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+              j_return = json_pack("{si}", "result", G_ERROR_DB);
             }
           } else {
-            y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oauth2 - Error split_string");
+            y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oauth2 - Error json_pack");
             j_return = json_pack("{si}", "result", G_ERROR);
           }
-          free_string_array(scope_array);
         } else {
-          y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oauth2 - Error h_last_insert_id");
-          config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
-          j_return = json_pack("{si}", "result", G_ERROR_DB);
+          y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oauth2 - Error split_string");
+          j_return = json_pack("{si}", "result", G_ERROR);
         }
-        json_decref(j_last_id);
+        free_string_array(scope_array);
       } else {
-        y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oauth2 - Error executing j_query (1)");
+        y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oauth2 - Error h_last_insert_id");
         config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
         j_return = json_pack("{si}", "result", G_ERROR_DB);
       }
+      json_decref(j_last_id);
     } else {
-      j_return = json_pack("{si}", "result", G_ERROR_PARAM);
+      y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oauth2 - Error executing j_query (1)");
+      config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+      j_return = json_pack("{si}", "result", G_ERROR_DB);
     }
-    o_free(token_hash);
-    pthread_mutex_unlock(&config->insert_lock);
+    config->glewlwyd_config->glewlwyd_callback_db_insert_end(config->glewlwyd_config, conn);
+  } else {
+    j_return = json_pack("{si}", "result", G_ERROR_PARAM);
   }
+  o_free(token_hash);
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
@@ -755,6 +748,9 @@ static json_t * check_client_valid(struct _oauth2_config * config, const char *
         j_return = json_pack("{si}", "result", G_ERROR_PARAM);
       }
     }
+  } else if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+    // The password pool is full, the client may be valid
+    j_return = json_pack("{si}", "result", G_ERROR_UNAVAILABLE);
   } else {
     y_log_message(Y_LOG_LEVEL_DEBUG, "check_client_valid - oauth2 - Error, client '%s' is invalid, origin: %s", client_id, ip_source);
     j_return = json_pack("{si}", "result", G_ERROR_UNAUTHORIZED);
@@ -763,108 +759,117 @@ static json_t * check_client_valid(struct _oauth2_config * config, const char *
   return j_return;
 }
 
+/**
+ * The password verification pool is full, the client should retry later
+ */
+static void set_response_password_pool_unavailable(struct _u_response * response) {
+  json_t * j_body = json_pack("{ssss}", "error", "temporarily_unavailable", "error_description", "Too many pending password verifications");
+
+  ulfius_set_json_body_response(response, 503, j_body);
+  u_map_put(response->map_header, "Retry-After", GLEWLWYD_PASSWORD_POOL_RETRY_AFTER);
+  json_decref(j_body);
+}
+
 static char * generate_authorization_code(struct _oauth2_config * config, const char * username, const char * client_id, const char * scope_list, const char * redirect_uri, const char * issued_for, const char * user_agent, const char * code_challenge) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   char * code = NULL, * code_hash = NULL, * expiration_clause, ** scope_array = NULL;
   json_t * j_query, * j_code_id;
   int res, i;
   time_t now;
 
-  if (pthread_mutex_lock(&config->insert_lock)) {
-    y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oauth2 - Error pthread_mutex_lock");
-  } else {
-    code = o_malloc(33);
-    if (code != NULL) {
-      if (rand_string_nonce(code, 32) != NULL) {
-        code_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, code);
-        if (code_hash != NULL) {
-          time(&now);
-          if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
-            expiration_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)config->code_duration ));
-          } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
-            expiration_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)config->code_duration ));
-          } else { // HOEL_DB_TYPE_SQLITE
-            expiration_clause = msprintf("%u", (now + (time_t)config->code_duration ));
-          }
-          j_query = json_pack("{sss{sssssssssssssss{ss}ss}}",
-                              "table",
-                              GLEWLWYD_PLUGIN_OAUTH2_TABLE_CODE,
-                              "values",
-                                "gpgc_plugin_name",
-                                config->name,
-                                "gpgc_username",
-                                username,
-                                "gpgc_client_id",
-                                client_id,
-                                "gpgc_redirect_uri",
-                                redirect_uri,
-                                "gpgc_code_hash",
-                                code_hash,
-                                "gpgc_issued_for",
-                                issued_for,
-                                "gpgc_user_agent",
-                                user_agent!=NULL?user_agent:"",
-                                "gpgc_expires_at",
-                                  "raw",
-                                  expiration_clause,
-                                "gpgc_code_challenge",
-                                code_challenge);
-          o_free(expiration_clause);
-          res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
-          json_decref(j_query);
-          if (res != H_OK) {
-            y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oauth2 - Error executing j_query (1)");
-            o_free(code);
-            code = NULL;
-          } else {
-            if (scope_list != NULL) {
-              j_code_id = h_last_insert_id(config->glewlwyd_config->glewlwyd_config->conn);
-              if (j_code_id != NULL) {
-                j_query = json_pack("{sss[]}",
-                                    "table",
-                                    GLEWLWYD_PLUGIN_OAUTH2_TABLE_CODE_SCOPE,
-                                    "values");
-                if (split_string(scope_list, " ", &scope_array) > 0) {
-                  for (i=0; scope_array[i] != NULL; i++) {
-                    json_array_append_new(json_object_get(j_query, "values"), json_pack("{sOss}", "gpgc_id", j_code_id, "gpgcs_scope", scope_array[i]));
-                  }
-                  res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
-                  json_decref(j_query);
-                  if (res != H_OK) {
-                    y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oauth2 - Error executing j_query (2)");
-                    o_free(code);
-                    code = NULL;
-                  }
-                } else {
-                  y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oauth2 - Error split_string");
+  code = o_malloc(33);
+  if (code != NULL) {
+    if (rand_string_nonce(code, 32) != NULL) {
+      code_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, code);
+      if (code_hash != NULL) {
+        time(&now);
+        if (conn->type==HOEL_DB_TYPE_MARIADB) {
+          expiration_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)config->code_duration ));
+        } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
+          expiration_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)config->code_duration ));
+        } else { // HOEL_DB_TYPE_SQLITE
+          expiration_clause = msprintf("%u", (now + (time_t)config->code_duration ));
+        }
+        j_query = json_pack("{sss{sssssssssssssss{ss}ss}}",
+                            "table",
+                            GLEWLWYD_PLUGIN_OAUTH2_TABLE_CODE,
+                            "values",
+                              "gpgc_plugin_name",
+                              config->name,
+                              "gpgc_username",
+                              username,
+                              "gpgc_client_id",
+                              client_id,
+                              "gpgc_redirect_uri",
+                              redirect_uri,
+                              "gpgc_code_hash",
+                              code_hash,
+                              "gpgc_issued_for",
+                              issued_for,
+                              "gpgc_user_agent",
+                              user_agent!=NULL?user_agent:"",
+                              "gpgc_expires_at",
+                                "raw",
+                                expiration_clause,
+                              "gpgc_code_challenge",
+                              code_challenge);
+        o_free(expiration_clause);
+        config->glewlwyd_config->glewlwyd_callback_db_insert_begin(config->glewlwyd_config, conn);
+        res = config->glewlwyd_config->glewlwyd_callback_db_insert(config->glewlwyd_config, conn, j_query, "gpgc_id", &j_code_id);
+        json_decref(j_query);
+        if (res != H_OK) {
+          y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oauth2 - Error executing j_query (1)");
+          o_free(code);
+          code = NULL;
+        } else {
+          if (scope_list != NULL) {
+            if (j_code_id != NULL) {
+              j_query = json_pack("{sss[]}",
+                                  "table",
+                                  GLEWLWYD_PLUGIN_OAUTH2_TABLE_CODE_SCOPE,
+                                  "values");
+              if (split_string(scope_list, " ", &scope_array) > 0) {
+                for (i=0; scope_array[i] != NULL; i++) {
+                  json_array_append_new(json_object_get(j_query, "values"), json_pack("{sOss}", "gpgc_id", j_code_id, "gpgcs_scope", scope_array[i]));
+                }
+                res = h_insert(conn, j_query, NULL);
+                json_decref(j_query);
+                if (res != H_OK) {
+                  y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oauth2 - Error executing j_query (2)");
                   o_free(code);
                   code = NULL;
                 }
-                free_string_array(scope_array);
-                json_decref(j_code_id);
               } else {
-                y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oauth2 - Error h_last_insert_id");
+                y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oauth2 - Error split_string");
                 o_free(code);
                 code = NULL;
               }
+              free_string_array(scope_array);
+              json_decref(j_code_id);
+            } else {
+              y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oauth2 - Error h_last_insert_id");
+              o_free(code);
+              code = NULL;
             }
           }
-        } else {
-          y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oauth2 - Error glewlwyd_callback_generate_hash");
-          o_free(code);
-          code = NULL;
         }
-        o_free(code_hash);
+        config->glewlwyd_config->glewlwyd_callback_db_insert_end(config->glewlwyd_config, conn);
       } else {
-        y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oauth2 - Error rand_string");
+        y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oauth2 - Error glewlwyd_callback_generate_hash");
         o_free(code);
         code = NULL;
       }
+      o_free(code_hash);
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oauth2 - Error allocating resources for code");
+      y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oauth2 - Error rand_string");
+      o_free(code);
+      code = NULL;
     }
-    pthread_mutex_unlock(&config->insert_lock);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oauth2 - Error allocating resources for code");
   }
 
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return code;
 }
 
@@ -892,6 +897,7 @@ static json_t * get_scope_parameters(struct _oauth2_config * config, const char
 }
 
 static int disable_authorization_code(struct _oauth2_config * config, json_int_t gpgc_id) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res;
   
@@ -906,8 +912,9 @@ static int disable_authorization_code(struct _oauth2_config * config, json_int_t
                         config->name,
                         "gpgc_id",
                         gpgc_id);
-  res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   if (res == H_OK) {
     return G_OK;
   } else {
@@ -982,13 +989,14 @@ static int validate_code_challenge(json_t * j_result_code, const char * code_ver
 }
 
 static int revoke_tokens_from_code(struct _oauth2_config * config, json_int_t gpgc_id, const char * ip_source) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   int ret, res;
   char * query;
   json_t * j_result, * j_result_r, * j_element = NULL;
   size_t index = 0;
 
   query = msprintf("SELECT gpga_client_id AS client_id FROM " GLEWLWYD_PLUGIN_OAUTH2_TABLE_ACCESS_TOKEN " WHERE gpgr_id IN (SELECT gpgr_id FROM " GLEWLWYD_PLUGIN_OAUTH2_TABLE_REFRESH_TOKEN " WHERE gpgc_id=%" JSON_INTEGER_FORMAT ") AND gpga_enabled=1", gpgc_id);
-  res = h_execute_query_json(config->glewlwyd_config->glewlwyd_config->conn, query, &j_result);
+  res = h_execute_query_json(conn, query, &j_result);
   o_free(query);
   if (res == H_OK) {
     json_array_foreach(j_result, index, j_element) {
@@ -996,7 +1004,7 @@ static int revoke_tokens_from_code(struct _oauth2_config * config, json_int_t gp
     }
     json_decref(j_result);
     query = msprintf("SELECT gpgr_client_id AS client_id FROM " GLEWLWYD_PLUGIN_OAUTH2_TABLE_REFRESH_TOKEN " WHERE gpgc_id=%" JSON_INTEGER_FORMAT " AND gpgr_enabled=1", gpgc_id);
-    res = h_execute_query_json(config->glewlwyd_config->glewlwyd_config->conn, query, &j_result_r);
+    res = h_execute_query_json(conn, query, &j_result_r);
     o_free(query);
     if (res == H_OK) {
       if (json_array_size(j_result_r)) {
@@ -1004,11 +1012,11 @@ static int revoke_tokens_from_code(struct _oauth2_config * config, json_int_t gp
       }
       json_decref(j_result_r);
       query = msprintf("UPDATE " GLEWLWYD_PLUGIN_OAUTH2_TABLE_ACCESS_TOKEN " SET gpga_enabled='0' WHERE gpgr_id IN (SELECT gpgr_id FROM " GLEWLWYD_PLUGIN_OAUTH2_TABLE_REFRESH_TOKEN " WHERE gpgc_id=%" JSON_INTEGER_FORMAT ")", gpgc_id);
-      res = h_execute_query(config->glewlwyd_config->glewlwyd_config->conn, query, NULL, H_OPTION_EXEC);
+      res = h_execute_query(conn, query, NULL, H_OPTION_EXEC);
       o_free(query);
       if (res == H_OK) {
         query = msprintf("UPDATE " GLEWLWYD_PLUGIN_OAUTH2_TABLE_REFRESH_TOKEN " SET gpgr_enabled='0' WHERE gpgc_id=%" JSON_INTEGER_FORMAT, gpgc_id);
-        res = h_execute_query(config->glewlwyd_config->glewlwyd_config->conn, query, NULL, H_OPTION_EXEC);
+        res = h_execute_query(conn, query, NULL, H_OPTION_EXEC);
         o_free(query);
         if (res == H_OK) {
           ret = G_OK;
@@ -1032,21 +1040,23 @@ static int revoke_tokens_from_code(struct _oauth2_config * config, json_int_t gp
     config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static json_t * validate_authorization_code(struct _oauth2_config * config, const char * code, const char * client_id, const char * redirect_uri, const char * code_verifier, const char * ip_source) {
-  char * code_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, code), * expiration_clause = NULL, * scope_list = NULL, * tmp;
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
+  char code_hash[GLEWLWYD_HASH_BUFFER_SIZE], * expiration_clause = NULL, * scope_list = NULL, * tmp;
   json_t * j_query, * j_result = NULL, * j_result_scope = NULL, * j_return, * j_element = NULL, * j_scope_param;
   int res;
   size_t index = 0;
   json_int_t maximum_duration = config->refresh_token_duration, maximum_duration_override = -1;
   int rolling_refresh = config->refresh_token_rolling, rolling_refresh_override = -1;
   
-  if (code_hash != NULL) {
-    if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+  if (config->glewlwyd_config->glewlwyd_callback_generate_hash_buffer(config->glewlwyd_config, code, code_hash, sizeof(code_hash)) == G_OK) {
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
       expiration_clause = o_strdup("> NOW()");
-    } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
       expiration_clause = o_strdup("> NOW()");
     } else { // HOEL_DB_TYPE_SQLITE
       expiration_clause = o_strdup("> (strftime('%s','now'))");
@@ -1074,7 +1084,7 @@ static json_t * validate_authorization_code(struct _oauth2_config * config, cons
                             "value",
                             expiration_clause);
     o_free(expiration_clause);
-    res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+    res = h_select(conn, j_query, &j_result, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       if (json_array_size(j_result)) {
@@ -1088,7 +1098,7 @@ static json_t * validate_authorization_code(struct _oauth2_config * config, cons
                                 "where",
                                   "gpgc_id",
                                   json_object_get(json_array_get(j_result, 0), "gpgc_id"));
-            res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result_scope, NULL);
+            res = h_select(conn, j_query, &j_result_scope, NULL);
             json_decref(j_query);
             if (res == H_OK && json_array_size(j_result_scope) > 0) {
               if (!json_object_set_new(json_array_get(j_result, 0), "scope", json_array())) {
@@ -1159,10 +1169,10 @@ static json_t * validate_authorization_code(struct _oauth2_config * config, cons
     }
     json_decref(j_result);
   } else {
-    y_log_message(Y_LOG_LEVEL_ERROR, "validate_authorization_code - oauth2 - Error glewlwyd_callback_generate_hash");
+    y_log_message(Y_LOG_LEVEL_ERROR, "validate_authorization_code - oauth2 - Error glewlwyd_callback_generate_hash_buffer");
     j_return = json_pack("{si}", "result", G_ERROR);
   }
-  o_free(code_hash);
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
@@ -1267,19 +1277,19 @@ static json_t * validate_session_client_scope(struct _oauth2_config * config, co
 }
 
 static json_t * validate_refresh_token(struct _oauth2_config * config, const char * refresh_token) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_return, * j_query, * j_result, * j_result_scope, * j_element = NULL;
-  char * token_hash, * expires_at_clause;
+  char token_hash[GLEWLWYD_HASH_BUFFER_SIZE], * expires_at_clause;
   int res;
   size_t index = 0;
   time_t now;
 
   if (refresh_token != NULL) {
-    token_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, refresh_token);
-    if (token_hash != NULL) {
+    if (config->glewlwyd_config->glewlwyd_callback_generate_hash_buffer(config->glewlwyd_config, refresh_token, token_hash, sizeof(token_hash)) == G_OK) {
       time(&now);
-      if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+      if (conn->type==HOEL_DB_TYPE_MARIADB) {
         expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-      } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+      } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
         expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
       } else { // HOEL_DB_TYPE_SQLITE
         expires_at_clause = msprintf("> %u", (now));
@@ -1292,9 +1302,9 @@ static json_t * validate_refresh_token(struct _oauth2_config * config, const cha
                             "gpgc_id",
                             "gpgr_username AS username",
                             "gpgr_client_id AS client_id",
-                            SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpgr_issued_at) AS issued_at", "gpgr_issued_at AS issued_at", "EXTRACT(EPOCH FROM gpgr_issued_at)::integer AS issued_at"),
-                            SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpgr_expires_at) AS expired_at", "gpgr_expires_at AS expired_at", "EXTRACT(EPOCH FROM gpgr_expires_at)::integer AS expired_at"),
-                            SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpgr_last_seen) AS last_seen", "gpgr_last_seen AS last_seen", "EXTRACT(EPOCH FROM gpgr_last_seen)::integer AS last_seen"),
+                            SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpgr_issued_at) AS issued_at", "gpgr_issued_at AS issued_at", "EXTRACT(EPOCH FROM gpgr_issued_at)::integer AS issued_at"),
+                            SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpgr_expires_at) AS expired_at", "gpgr_expires_at AS expired_at", "EXTRACT(EPOCH FROM gpgr_expires_at)::integer AS expired_at"),
+                            SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpgr_last_seen) AS last_seen", "gpgr_last_seen AS last_seen", "EXTRACT(EPOCH FROM gpgr_last_seen)::integer AS last_seen"),
                             "gpgr_duration AS duration",
                             "gpgr_rolling_expiration",
                           "where",
@@ -1310,7 +1320,7 @@ static json_t * validate_refresh_token(struct _oauth2_config * config, const cha
                               "value",
                               expires_at_clause);
       o_free(expires_at_clause);
-      res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+      res = h_select(conn, j_query, &j_result, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         if (json_array_size(j_result) > 0) {
@@ -1324,7 +1334,7 @@ static json_t * validate_refresh_token(struct _oauth2_config * config, const cha
                               "where",
                                 "gpgr_id",
                                 json_object_get(json_array_get(j_result, 0), "gpgr_id"));
-          res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result_scope, NULL);
+          res = h_select(conn, j_query, &j_result_scope, NULL);
           json_decref(j_query);
           if (res == H_OK) {
             if (!json_object_set_new(json_array_get(j_result, 0), "scope", json_array())) {
@@ -1352,17 +1362,18 @@ static json_t * validate_refresh_token(struct _oauth2_config * config, const cha
         j_return = json_pack("{si}", "result", G_ERROR_DB);
       }
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "validate_refresh_token - oauth2 - Error glewlwyd_callback_generate_hash");
+      y_log_message(Y_LOG_LEVEL_ERROR, "validate_refresh_token - oauth2 - Error glewlwyd_callback_generate_hash_buffer");
       j_return = json_pack("{si}", "result", G_ERROR);
     }
-    o_free(token_hash);
   } else {
     j_return = json_pack("{si}", "result", G_ERROR_PARAM);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
 static json_t * refresh_token_list_get(struct _oauth2_config * config, const char * username, const char * pattern, size_t offset, size_t limit, const char * sort) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result, * j_return, * j_element = NULL;
   int res;
   size_t index = 0, token_hash_dec_len = 0;
@@ -1376,9 +1387,9 @@ static json_t * refresh_token_list_get(struct _oauth2_config * config, const cha
                         "gpgr_token_hash",
                         "gpgr_authorization_type",
                         "gpgr_client_id AS client_id",
-                        SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpgr_issued_at) AS issued_at", "gpgr_issued_at AS issued_at", "EXTRACT(EPOCH FROM gpgr_issued_at)::integer AS issued_at"),
-                        SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpgr_expires_at) AS expires_at", "gpgr_expires_at AS expires_at", "EXTRACT(EPOCH FROM gpgr_expires_at)::integer AS expires_at"),
-                        SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpgr_last_seen) AS last_seen", "gpgr_last_seen AS last_seen", "EXTRACT(EPOCH FROM gpgr_last_seen)::integer AS last_seen"),
+                        SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpgr_issued_at) AS issued_at", "gpgr_issued_at AS issued_at", "EXTRACT(EPOCH FROM gpgr_issued_at)::integer AS issued_at"),
+                        SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpgr_expires_at) AS expires_at", "gpgr_expires_at AS expires_at", "EXTRACT(EPOCH FROM gpgr_expires_at)::integer AS expires_at"),
+                        SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpgr_last_seen) AS last_seen", "gpgr_last_seen AS last_seen", "EXTRACT(EPOCH FROM gpgr_last_seen)::integer AS last_seen"),
                         "gpgr_rolling_expiration",
                         "gpgr_issued_for AS issued_for",
                         "gpgr_user_agent AS user_agent",
@@ -1398,15 +1409,15 @@ static json_t * refresh_token_list_get(struct _oauth2_config * config, const cha
     json_object_set_new(j_query, "order_by", json_string(sort));
   }
   if (pattern != NULL) {
-    pattern_escaped = h_escape_string_with_quotes(config->glewlwyd_config->glewlwyd_config->conn, pattern);
-    name_escaped = h_escape_string_with_quotes(config->glewlwyd_config->glewlwyd_config->conn, config->name);
+    pattern_escaped = h_escape_string_with_quotes(conn, pattern);
+    name_escaped = h_escape_string_with_quotes(conn, config->name);
     pattern_clause = msprintf("IN (SELECT gpgr_id FROM "GLEWLWYD_PLUGIN_OAUTH2_TABLE_REFRESH_TOKEN" WHERE (gpgr_user_agent LIKE '%%'||%s||'%%' OR gpgr_issued_for LIKE '%%'||%s||'%%') AND gpgr_plugin_name=%s)", pattern_escaped, pattern_escaped, name_escaped);
     json_object_set_new(json_object_get(j_query, "where"), "gpgr_id", json_pack("{ssss}", "operator", "raw", "value", pattern_clause));
     o_free(pattern_clause);
     o_free(pattern_escaped);
     o_free(name_escaped);
   }
-  res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     json_array_foreach(j_result, index, j_element) {
@@ -1441,10 +1452,12 @@ static json_t * refresh_token_list_get(struct _oauth2_config * config, const cha
     config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
 static int refresh_token_disable(struct _oauth2_config * config, const char * username, const char * token_hash, const char * ip_source) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result, * j_element = NULL;
   int res, ret = G_OK;
   unsigned char token_hash_dec[128];
@@ -1467,7 +1480,7 @@ static int refresh_token_disable(struct _oauth2_config * config, const char * us
       ret = G_ERROR_PARAM;
     }
   }
-  res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK && ret == G_OK) {
     if (json_array_size(j_result)) {
@@ -1481,7 +1494,7 @@ static int refresh_token_disable(struct _oauth2_config * config, const char * us
                               "where",
                                 "gpgr_plugin_name", config->name,
                                 "gpgr_id", json_object_get(j_element, "gpgr_id"));
-          res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+          res = h_update(conn, j_query, NULL);
           json_decref(j_query);
           if (res == H_OK) {
             if (token_hash != NULL) {
@@ -1507,17 +1520,19 @@ static int refresh_token_disable(struct _oauth2_config * config, const char * us
     config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static int update_refresh_token(struct _oauth2_config * config, json_int_t gpgr_id, json_int_t refresh_token_duration, int disable, time_t now) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res, ret;
   char * expires_at_clause, * last_seen_clause;
 
-  if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+  if (conn->type==HOEL_DB_TYPE_MARIADB) {
     last_seen_clause = msprintf("FROM_UNIXTIME(%u)", (now));
-  } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+  } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
     last_seen_clause = msprintf("TO_TIMESTAMP(%u)", now);
   } else { // HOEL_DB_TYPE_SQLITE
     last_seen_clause = msprintf("%u", (now));
@@ -1536,9 +1551,9 @@ static int update_refresh_token(struct _oauth2_config * config, json_int_t gpgr_
                         gpgr_id);
   o_free(last_seen_clause);
   if (refresh_token_duration) {
-    if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
       expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)refresh_token_duration));
-    } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
       expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)refresh_token_duration));
     } else { // HOEL_DB_TYPE_SQLITE
       expires_at_clause = msprintf("%u", (now + (time_t)refresh_token_duration));
@@ -1549,7 +1564,7 @@ static int update_refresh_token(struct _oauth2_config * config, json_int_t gpgr_
   if (disable) {
     json_object_set_new(json_object_get(j_query, "set"), "gpgr_enabled", json_integer(0));
   }
-  res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = G_OK;
@@ -1558,6 +1573,7 @@ static int update_refresh_token(struct _oauth2_config * config, json_int_t gpgr_
     config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
@@ -1633,76 +1649,88 @@ static int is_code_challenge_valid(struct _oauth2_config * config, const char *
 }
 
 static int revoke_refresh_token(struct _oauth2_config * config, const char * token) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res, ret;
-  char * token_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, token);
+  char token_hash[GLEWLWYD_HASH_BUFFER_SIZE];
   
-  j_query = json_pack("{sss{si}s{ssss}}",
-                      "table",
-                      GLEWLWYD_PLUGIN_OAUTH2_TABLE_REFRESH_TOKEN,
-                      "set",
-                        "gpgr_enabled",
-                        0,
-                      "where",
-                        "gpgr_plugin_name",
-                        config->name,
-                        "gpgr_token_hash",
-                        token_hash);
-  o_free(token_hash);
-  res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
-  json_decref(j_query);
-  if (res == H_OK) {
-    ret = G_OK;
+  if (config->glewlwyd_config->glewlwyd_callback_generate_hash_buffer(config->glewlwyd_config, token, token_hash, sizeof(token_hash)) == G_OK) {
+    j_query = json_pack("{sss{si}s{ssss}}",
+                        "table",
+                        GLEWLWYD_PLUGIN_OAUTH2_TABLE_REFRESH_TOKEN,
+                        "set",
+                          "gpgr_enabled",
+                          0,
+                        "where",
+                          "gpgr_plugin_name",
+                          config->name,
+                          "gpgr_token_hash",
+                          token_hash);
+    res = h_update(conn, j_query, NULL);
+    json_decref(j_query);
+    if (res == H_OK) {
+      ret = G_OK;
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "revoke_refresh_token - Error executing j_query");
+      config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+      ret = G_ERROR_DB;
+    }
   } else {
-    y_log_message(Y_LOG_LEVEL_ERROR, "revoke_refresh_token - Error executing j_query");
-    config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
-    ret = G_ERROR_DB;
+    y_log_message(Y_LOG_LEVEL_ERROR, "revoke_refresh_token - Error glewlwyd_callback_generate_hash_buffer");
+    ret = G_ERROR;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static int revoke_access_token(struct _oauth2_config * config, const char * token) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res, ret;
-  char * token_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, token);
+  char token_hash[GLEWLWYD_HASH_BUFFER_SIZE];
   
-  j_query = json_pack("{sss{si}s{ssss}}",
-                      "table",
-                      GLEWLWYD_PLUGIN_OAUTH2_TABLE_ACCESS_TOKEN,
-                      "set",
-                        "gpga_enabled",
-                        0,
-                      "where",
-                        "gpga_plugin_name",
-                        config->name,
-                        "gpga_token_hash",
-                        token_hash);
-  o_free(token_hash);
-  res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
-  json_decref(j_query);
-  if (res == H_OK) {
-    ret = G_OK;
+  if (config->glewlwyd_config->glewlwyd_callback_generate_hash_buffer(config->glewlwyd_config, token, token_hash, sizeof(token_hash)) == G_OK) {
+    j_query = json_pack("{sss{si}s{ssss}}",
+                        "table",
+                        GLEWLWYD_PLUGIN_OAUTH2_TABLE_ACCESS_TOKEN,
+                        "set",
+                          "gpga_enabled",
+                          0,
+                        "where",
+                          "gpga_plugin_name",
+                          config->name,
+                          "gpga_token_hash",
+                          token_hash);
+    res = h_update(conn, j_query, NULL);
+    json_decref(j_query);
+    if (res == H_OK) {
+      ret = G_OK;
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "revoke_access_token - Error executing j_query");
+      config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+      ret = G_ERROR_DB;
+    }
   } else {
-    y_log_message(Y_LOG_LEVEL_ERROR, "revoke_access_token - Error executing j_query");
-    config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
-    ret = G_ERROR_DB;
+    y_log_message(Y_LOG_LEVEL_ERROR, "revoke_access_token - Error glewlwyd_callback_generate_hash_buffer");
+    ret = G_ERROR;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static json_t * get_token_metadata(struct _oauth2_config * config, const char * token, const char * token_type_hint, const char * client_id) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result, * j_result_scope, * j_return = NULL, * j_element = NULL;
   int res, found_refresh = 0, found_access = 0;
   size_t index = 0;
-  char * token_hash = NULL, * scope_list = NULL, * expires_at_clause;
+  char token_hash[GLEWLWYD_HASH_BUFFER_SIZE], * scope_list = NULL, * expires_at_clause;
   time_t now;
   
-  if (!o_strnullempty(token)) {
-    token_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, token);
+  if (!o_strnullempty(token) && config->glewlwyd_config->glewlwyd_callback_generate_hash_buffer(config->glewlwyd_config, token, token_hash, sizeof(token_hash)) == G_OK) {
     time(&now);
-    if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
       expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-    } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
       expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
     } else { // HOEL_DB_TYPE_SQLITE
       expires_at_clause = msprintf("> %u", (now));
@@ -1715,9 +1743,9 @@ static json_t * get_token_metadata(struct _oauth2_config * config, const char *
                             "gpgr_id",
                             "gpgr_username AS username",
                             "gpgr_client_id AS client_id",
-                            SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpgr_issued_at) AS iat", "gpgr_issued_at AS iat", "EXTRACT(EPOCH FROM gpgr_issued_at)::integer AS iat"),
-                            SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpgr_issued_at) AS nbf", "gpgr_issued_at AS nbf", "EXTRACT(EPOCH FROM gpgr_issued_at)::integer AS nbf"),
-                            SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpgr_expires_at) AS exp", "gpgr_expires_at AS exp", "EXTRACT(EPOCH FROM gpgr_expires_at)::integer AS exp"),
+                            SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpgr_issued_at) AS iat", "gpgr_issued_at AS iat", "EXTRACT(EPOCH FROM gpgr_issued_at)::integer AS iat"),
+                            SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpgr_issued_at) AS nbf", "gpgr_issued_at AS nbf", "EXTRACT(EPOCH FROM gpgr_issued_at)::integer AS nbf"),
+                            SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpgr_expires_at) AS exp", "gpgr_expires_at AS exp", "EXTRACT(EPOCH FROM gpgr_expires_at)::integer AS exp"),
                             "gpgr_enabled",
                           "where",
                             "gpgr_plugin_name",
@@ -1732,7 +1760,7 @@ static json_t * get_token_metadata(struct _oauth2_config * config, const char *
       if (client_id != NULL) {
         json_object_set_new(json_object_get(j_query, "where"), "gpgr_client_id", json_string(client_id));
       }
-      res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+      res = h_select(conn, j_query, &j_result, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         if (json_array_size(j_result)) {
@@ -1755,7 +1783,7 @@ static json_t * get_token_metadata(struct _oauth2_config * config, const char *
                                 "where",
                                   "gpgr_id",
                                   json_object_get(json_array_get(j_result, 0), "gpgr_id"));
-            res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result_scope, NULL);
+            res = h_select(conn, j_query, &j_result_scope, NULL);
             json_decref(j_query);
             if (res == H_OK) {
               json_array_foreach(j_result_scope, index, j_element) {
@@ -1794,8 +1822,8 @@ static json_t * get_token_metadata(struct _oauth2_config * config, const char *
                             "gpga_id",
                             "gpga_username AS username",
                             "gpga_client_id AS client_id",
-                            SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpga_issued_at) AS iat", "gpga_issued_at AS iat", "EXTRACT(EPOCH FROM gpga_issued_at)::integer AS iat"),
-                            SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpga_issued_at) AS nbf", "gpga_issued_at AS nbf", "EXTRACT(EPOCH FROM gpga_issued_at)::integer AS nbf"),
+                            SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpga_issued_at) AS iat", "gpga_issued_at AS iat", "EXTRACT(EPOCH FROM gpga_issued_at)::integer AS iat"),
+                            SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpga_issued_at) AS nbf", "gpga_issued_at AS nbf", "EXTRACT(EPOCH FROM gpga_issued_at)::integer AS nbf"),
                             "gpga_enabled",
                           "where",
                             "gpga_plugin_name",
@@ -1805,7 +1833,7 @@ static json_t * get_token_metadata(struct _oauth2_config * config, const char *
       if (client_id != NULL) {
         json_object_set_new(json_object_get(j_query, "where"), "gpga_client_id", json_string(client_id));
       }
-      res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+      res = h_select(conn, j_query, &j_result, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         if (json_array_size(j_result)) {
@@ -1829,7 +1857,7 @@ static json_t * get_token_metadata(struct _oauth2_config * config, const char *
                                 "where",
                                   "gpga_id",
                                   json_object_get(json_array_get(j_result, 0), "gpga_id"));
-            res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result_scope, NULL);
+            res = h_select(conn, j_query, &j_result_scope, NULL);
             json_decref(j_query);
             if (res == H_OK) {
               json_array_foreach(j_result_scope, index, j_element) {
@@ -1863,11 +1891,11 @@ static json_t * get_token_metadata(struct _oauth2_config * config, const char *
     if (!found_refresh && !found_access && j_return == NULL) {
       j_return = json_pack("{sis{so}}", "result", G_OK, "token", "active", json_false());
     }
-    o_free(token_hash);
     o_free(expires_at_clause);
   } else {
     j_return = json_pack("{si}", "result", G_ERROR_PARAM);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
@@ -1882,6 +1910,7 @@ static const char * get_client_id_for_introspection(struct _oauth2_config * conf
 }
 
 static json_t * generate_device_authorization(struct _oauth2_config * config, const char * client_id, const char * scope_list, const char * ip_source) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   char device_code[GLEWLWYD_DEVICE_AUTH_DEVICE_CODE_LENGTH+1] = {0}, user_code[GLEWLWYD_DEVICE_AUTH_USER_CODE_LENGTH+2] = {0}, * device_code_hash = NULL, * user_code_hash = NULL;
   json_t * j_return, * j_query, * j_device_auth_id;
   int res;
@@ -1889,100 +1918,97 @@ static json_t * generate_device_authorization(struct _oauth2_config * config, co
   char * expires_at_clause = NULL, * last_check_clause = NULL, ** scope_array = NULL;
   size_t i;
   
-  if (pthread_mutex_lock(&config->insert_lock)) {
-    y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization oauth2 - Error pthread_mutex_lock");
-    j_return = json_pack("{si}", "result", G_ERROR);
-  } else {
-    if (rand_string(device_code, 32) != NULL && rand_string_from_charset(user_code, GLEWLWYD_DEVICE_AUTH_USER_CODE_LENGTH+1, "ABCDEFGHJKLMNOPQRSTUVWXYZ0123456789") != NULL) {
-      user_code[4] = '-';
-      device_code_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, device_code);
-      user_code_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, user_code);
-      time(&now);
-      if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
-        expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + expiration));
-        last_check_clause = msprintf("FROM_UNIXTIME(%u)", (now - (2*expiration)));
-      } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
-        expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + expiration));
-        last_check_clause = msprintf("TO_TIMESTAMP(%u)", (now - (2*expiration)));
-      } else { // HOEL_DB_TYPE_SQLITE
-        expires_at_clause = msprintf("%u", (now + expiration));
-        last_check_clause = msprintf("%u", (now - (2*expiration)));
-      }
-      j_query = json_pack("{sss{sssss{ss}sssssss{ss}}}",
-                          "table",
-                          GLEWLWYD_PLUGIN_OAUTH2_TABLE_DEVICE_AUTHORIZATION,
-                          "values",
-                            "gpgda_plugin_name",
-                            config->name,
-                            "gpgda_client_id",
-                            client_id,
-                            "gpgda_expires_at",
-                              "raw",
-                              expires_at_clause,
-                            "gpgda_issued_for",
-                            ip_source,
-                            "gpgda_device_code_hash",
-                            device_code_hash,
-                            "gpgda_user_code_hash",
-                            user_code_hash,
-                            "gpgda_last_check",
-                              "raw",
-                              last_check_clause);
-      o_free(expires_at_clause);
-      o_free(last_check_clause);
-      o_free(device_code_hash);
-      o_free(user_code_hash);
-      res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
-      json_decref(j_query);
-      if (res == H_OK) {
-        j_device_auth_id = h_last_insert_id(config->glewlwyd_config->glewlwyd_config->conn);
-        if (j_device_auth_id != NULL) {
-          if (split_string(scope_list, " ", &scope_array)) {
-            j_query = json_pack("{sss[]}", "table", GLEWLWYD_PLUGIN_OAUTH2_TABLE_DEVICE_AUTHORIZATION_SCOPE, "values");
-            for (i=0; scope_array[i]!=NULL; i++) {
-              json_array_append_new(json_object_get(j_query, "values"), json_pack("{sOss}", "gpgda_id", j_device_auth_id, "gpgdas_scope", scope_array[i]));
-            }
-            res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
-            json_decref(j_query);
-            if (res == H_OK) {
-              j_return = json_pack("{sis{ssss}}", "result", G_OK, "authorization", "device_code", device_code, "user_code", user_code);
-            } else {
-              y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization - Error executing j_query (2)");
-              config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
-              j_return = json_pack("{si}", "result", G_ERROR_DB);
-            }
+  if (rand_string(device_code, 32) != NULL && rand_string_from_charset(user_code, GLEWLWYD_DEVICE_AUTH_USER_CODE_LENGTH+1, "ABCDEFGHJKLMNOPQRSTUVWXYZ0123456789") != NULL) {
+    user_code[4] = '-';
+    device_code_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, device_code);
+    user_code_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, user_code);
+    time(&now);
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
+      expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + expiration));
+      last_check_clause = msprintf("FROM_UNIXTIME(%u)", (now - (2*expiration)));
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
+      expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + expiration));
+      last_check_clause = msprintf("TO_TIMESTAMP(%u)", (now - (2*expiration)));
+    } else { // HOEL_DB_TYPE_SQLITE
+      expires_at_clause = msprintf("%u", (now + expiration));
+      last_check_clause = msprintf("%u", (now - (2*expiration)));
+    }
+    j_query = json_pack("{sss{sssss{ss}sssssss{ss}}}",
+                        "table",
+                        GLEWLWYD_PLUGIN_OAUTH2_TABLE_DEVICE_AUTHORIZATION,
+                        "values",
+                          "gpgda_plugin_name",
+                          config->name,
+                          "gpgda_client_id",
+                          client_id,
+                          "gpgda_expires_at",
+                            "raw",
+                            expires_at_clause,
+                          "gpgda_issued_for",
+                          ip_source,
+                          "gpgda_device_code_hash",
+                          device_code_hash,
+                          "gpgda_user_code_hash",
+                          user_code_hash,
+                          "gpgda_last_check",
+                            "raw",
+                            last_check_clause);
+    o_free(expires_at_clause);
+    o_free(last_check_clause);
+    o_free(device_code_hash);
+    o_free(user_code_hash);
+    config->glewlwyd_config->glewlwyd_callback_db_insert_begin(config->glewlwyd_config, conn);
+    res = config->glewlwyd_config->glewlwyd_callback_db_insert(config->glewlwyd_config, conn, j_query, "gpgda_id", &j_device_auth_id);
+    json_decref(j_query);
+    if (res == H_OK) {
+      if (j_device_auth_id != NULL) {
+        if (split_string(scope_list, " ", &scope_array)) {
+          j_query = json_pack("{sss[]}", "table", GLEWLWYD_PLUGIN_OAUTH2_TABLE_DEVICE_AUTHORIZATION_SCOPE, "values");
+          for (i=0; scope_array[i]!=NULL; i++) {
+            json_array_append_new(json_object_get(j_query, "values"), json_pack("{sOss}", "gpgda_id", j_device_auth_id, "gpgdas_scope", scope_array[i]));
+          }
+          res = h_insert(conn, j_query, NULL);
+          json_decref(j_query);
+          if (res == H_OK) {
+            j_return = json_pack("{sis{ssss}}", "result", G_OK, "authorization", "device_code", device_code, "user_code", user_code);
           } else {
-            y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization - Error split_string scope");
-            j_return = json_pack("{si}", "result", G_ERROR);
+            y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization - Error executing j_query (2)");
+            config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+            j_return = json_pack("{si}", "result", G_ERROR_DB);
           }
-          free_string_array(scope_array);
         } else {
-          y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization - Error h_last_insert_id");
-          config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
-          j_return = json_pack("{si}", "result", G_ERROR_DB);
+          y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization - Error split_string scope");
+          j_return = json_pack("{si}", "result", G_ERROR);
         }
-        json_decref(j_device_auth_id);
+        free_string_array(scope_array);
       } else {
-        y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization - Error executing j_query (1)");
+        y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization - Error h_last_insert_id");
         config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
         j_return = json_pack("{si}", "result", G_ERROR_DB);
       }
+      json_decref(j_device_auth_id);
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization - Error generating random code");
-      j_return = json_pack("{si}", "result", G_ERROR);
+      y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization - Error executing j_query (1)");
+      config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+      j_return = json_pack("{si}", "result", G_ERROR_DB);
     }
-    pthread_mutex_unlock(&config->insert_lock);
+    config->glewlwyd_config->glewlwyd_callback_db_insert_end(config->glewlwyd_config, conn);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization - Error generating random code");
+    j_return = json_pack("{si}", "result", G_ERROR);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
 static int validate_device_authorization_scope(struct _oauth2_config * config, json_int_t gpgda_id, const char * username, const char * scope_list) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   char * query, * scope_clause = NULL, * scope_escaped, ** scope_array = NULL, * username_escaped;
   int res, i, ret;
   
   if (split_string(scope_list, " ", &scope_array)) {
     for (i=0; scope_array[i]!=NULL; i++) {
-      scope_escaped = h_escape_string_with_quotes(config->glewlwyd_config->glewlwyd_config->conn, scope_array[i]);
+      scope_escaped = h_escape_string_with_quotes(conn, scope_array[i]);
       if (scope_clause == NULL) {
         scope_clause = o_strdup(scope_escaped);
       } else {
@@ -1994,12 +2020,12 @@ static int validate_device_authorization_scope(struct _oauth2_config * config, j
   }
   if (!o_strnullempty(scope_clause)) {
     query = msprintf("UPDATE %s set gpgdas_allowed=1 WHERE gpgdas_scope IN (%s) AND gpgda_id=%"JSON_INTEGER_FORMAT, GLEWLWYD_PLUGIN_OAUTH2_TABLE_DEVICE_AUTHORIZATION_SCOPE, scope_clause, gpgda_id);
-    res = h_execute_query(config->glewlwyd_config->glewlwyd_config->conn, query, NULL, H_OPTION_EXEC);
+    res = h_execute_query(conn, query, NULL, H_OPTION_EXEC);
     o_free(query);
     if (res == H_OK) {
-      username_escaped = h_escape_string_with_quotes(config->glewlwyd_config->glewlwyd_config->conn, username);
+      username_escaped = h_escape_string_with_quotes(conn, username);
       query = msprintf("UPDATE %s set gpgda_status=1, gpgda_username=%s WHERE gpgda_id=%"JSON_INTEGER_FORMAT, GLEWLWYD_PLUGIN_OAUTH2_TABLE_DEVICE_AUTHORIZATION, username_escaped, gpgda_id);
-      res = h_execute_query(config->glewlwyd_config->glewlwyd_config->conn, query, NULL, H_OPTION_EXEC);
+      res = h_execute_query(conn, query, NULL, H_OPTION_EXEC);
       o_free(username_escaped);
       o_free(query);
       if (res == H_OK) {
@@ -2019,10 +2045,12 @@ static int validate_device_authorization_scope(struct _oauth2_config * config, j
     ret = G_ERROR_PARAM;
   }
   o_free(scope_clause);
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static json_t * validate_device_auth_user_code(struct _oauth2_config * config, const char * user_code) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query = NULL, * j_result = NULL, * j_result_scope = NULL, * j_return, * j_element = NULL;
   int res;
   char * scope = NULL, * expires_at_clause, * user_code_hash, user_code_ucase[GLEWLWYD_DEVICE_AUTH_USER_CODE_LENGTH+2] = {0};
@@ -2035,9 +2063,9 @@ static json_t * validate_device_auth_user_code(struct _oauth2_config * config, c
     }
     user_code_ucase[GLEWLWYD_DEVICE_AUTH_USER_CODE_LENGTH+1] = '\0';
     time(&now);
-    if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
       expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-    } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
       expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
     } else { // HOEL_DB_TYPE_SQLITE
       expires_at_clause = msprintf("> %u", (now));
@@ -2063,7 +2091,7 @@ static json_t * validate_device_auth_user_code(struct _oauth2_config * config, c
                           0);
     o_free(expires_at_clause);
     o_free(user_code_hash);
-    res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+    res = h_select(conn, j_query, &j_result, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       if (json_array_size(j_result)) {
@@ -2075,7 +2103,7 @@ static json_t * validate_device_auth_user_code(struct _oauth2_config * config, c
                             "where",
                               "gpgda_id",
                               json_object_get(json_array_get(j_result, 0), "gpgda_id"));
-        res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result_scope, NULL);
+        res = h_select(conn, j_query, &j_result_scope, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           json_array_foreach(j_result_scope, index, j_element) {
@@ -2105,11 +2133,13 @@ static json_t * validate_device_auth_user_code(struct _oauth2_config * config, c
   } else {
     j_return = json_pack("{si}", "result", G_ERROR_NOT_FOUND);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
 static int check_auth_type_device_code(const struct _u_request * request, struct _u_response * response, void * user_data) {
   struct _oauth2_config * config = (struct _oauth2_config *)user_data;
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_body, * j_client, * j_query, * j_result = NULL, * j_result_scope = NULL, * j_element = NULL, * j_user = NULL, * j_refresh_token = NULL, * j_user_only = NULL;
   const char * device_code = u_map_get(request->map_post_body, "device_code"), 
              * client_id = request->auth_basic_user,
@@ -2138,8 +2168,8 @@ static int check_auth_type_device_code(const struct _u_request * request, struct
                             "gpgda_id",
                             "gpgda_username AS username",
                             "gpgda_status",
-                            SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpgda_expires_at) AS expires_at", "gpgda_expires_at AS expires_at", "EXTRACT(EPOCH FROM gpgda_expires_at)::integer AS expires_at"),
-                            SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpgda_last_check) AS last_check", "gpgda_last_check AS last_check", "EXTRACT(EPOCH FROM gpgda_last_check)::integer AS last_check"),
+                            SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpgda_expires_at) AS expires_at", "gpgda_expires_at AS expires_at", "EXTRACT(EPOCH FROM gpgda_expires_at)::integer AS expires_at"),
+                            SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpgda_last_check) AS last_check", "gpgda_last_check AS last_check", "EXTRACT(EPOCH FROM gpgda_last_check)::integer AS last_check"),
                           "where",
                             "gpgda_device_code_hash",
                             device_code_hash,
@@ -2151,7 +2181,7 @@ static int check_auth_type_device_code(const struct _u_request * request, struct
                               "value",
                               "<= 1");
       o_free(device_code_hash);
-      res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+      res = h_select(conn, j_query, &j_result, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         if (json_array_size(j_result)) {
@@ -2168,7 +2198,7 @@ static int check_auth_type_device_code(const struct _u_request * request, struct
                                     json_object_get(json_array_get(j_result, 0), "gpgda_id"),
                                     "gpgdas_allowed",
                                     1);
-              res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result_scope, NULL);
+              res = h_select(conn, j_query, &j_result_scope, NULL);
               json_decref(j_query);
               if (res == H_OK) {
                 json_array_foreach(j_result_scope, index, j_element) {
@@ -2203,7 +2233,7 @@ static int check_auth_type_device_code(const struct _u_request * request, struct
                                                   "gpgda_status", 2,
                                                 "where",
                                                   "gpgda_id", json_object_get(json_array_get(j_result, 0), "gpgda_id"));
-                            res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+                            res = h_update(conn, j_query, NULL);
                             json_decref(j_query);
                             if (res == H_OK) {
                               j_body = json_pack("{sssssssisIss}",
@@ -2287,11 +2317,11 @@ static int check_auth_type_device_code(const struct _u_request * request, struct
                                   "set",
                                     "gpgda_last_check",
                                       "raw",
-                                      SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "CURRENT_TIMESTAMP", "strftime('%s','now')", "NOW()"),
+                                      SWITCH_DB_TYPE(conn->type, "CURRENT_TIMESTAMP", "strftime('%s','now')", "NOW()"),
                                   "where",
                                     "gpgda_id",
                                     json_object_get(json_array_get(j_result, 0), "gpgda_id"));
-              res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+              res = h_update(conn, j_query, NULL);
               json_decref(j_query);
               if (res == H_OK) {
                 if (((json_int_t)now - json_integer_value(json_object_get(json_array_get(j_result, 0), "last_check"))) >= json_integer_value(json_object_get(config->j_params, "device-authorization-interval"))) {
@@ -2331,6 +2361,8 @@ static int check_auth_type_device_code(const struct _u_request * request, struct
         ulfius_set_json_body_response(response, 500, j_body);
         json_decref(j_body);
       }
+    } else if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+      set_response_password_pool_unavailable(response);
     } else {
       j_body = json_pack("{ss}", "error", "unauthorized_client");
       ulfius_set_json_body_response(response, 403, j_body);
@@ -2345,6 +2377,7 @@ static int check_auth_type_device_code(const struct _u_request * request, struct
     json_decref(j_body);
   }
   o_free(issued_for);
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return U_CALLBACK_CONTINUE;
 }
 
@@ -2416,6 +2449,9 @@ static int callback_check_intropect_revoke(const struct _u_request * request, st
           ret = U_CALLBACK_CONTINUE;
         }
       }
+    } else if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+      set_response_password_pool_unavailable(response);
+      ret = U_CALLBACK_COMPLETE;
     }
     json_decref(j_client);
   }
@@ -2540,6 +2576,8 @@ static int check_auth_type_auth_code_grant (const struct _u_request * request, s
       o_free(redirect_url);
       response->status = 302;
     }
+  } else if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+    set_response_password_pool_unavailable(response);
   } else {
     // client is not authorized
     response->status = 302;
@@ -2671,6 +2709,8 @@ static int check_auth_type_access_token_request (const struct _u_request * reque
         json_decref(j_body);
       }
       json_decref(j_code);
+    } else if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+      set_response_password_pool_unavailable(response);
     } else {
       j_body = json_pack("{ss}", "error", "unauthorized_client");
       ulfius_set_json_body_response(response, 403, j_body);
@@ -2804,6 +2844,8 @@ static int check_auth_type_implicit_grant (const struct _u_request * request, st
       o_free(redirect_url);
       response->status = 302;
     }
+  } else if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+    set_response_password_pool_unavailable(response);
   } else {
     // client is not authorized
     response->status = 302;
@@ -2855,6 +2897,8 @@ static int check_auth_type_resource_owner_pwd_cred (const struct _u_request * re
       }
     } else if (check_result_value(j_client, G_ERROR_NOT_FOUND) || check_result_value(j_client, G_ERROR_UNAUTHORIZED)) {
       ret = G_ERROR_PARAM;
+    } else if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+      ret = G_ERROR_UNAVAILABLE;
     } else {
       y_log_message(Y_LOG_LEVEL_ERROR, "check_auth_type_resource_owner_pwd_cred - oauth2 - Error glewlwyd_callback_check_client_valid");
       ret = G_ERROR;
@@ -2969,6 +3013,8 @@ static int check_auth_type_resource_owner_pwd_cred (const struct _u_request * re
       y_log_message(Y_LOG_LEVEL_DEBUG, "check_auth_type_resource_owner_pwd_cred - oauth2 - Error user '%s'", username);
       y_log_message(Y_LOG_LEVEL_WARNING, "Security - Authorization invalid for username %s at IP Address %s", username, ip_source);
       response->status = 403;
+    } else if (check_result_value(j_user, G_ERROR_UNAVAILABLE)) {
+      set_response_password_pool_unavailable(response);
     } else {
       y_log_message(Y_LOG_LEVEL_ERROR, "check_auth_type_resource_owner_pwd_cred - oauth2 - glewlwyd_callback_check_user_valid");
       response->status = 403;
@@ -2976,6 +3022,8 @@ static int check_auth_type_resource_owner_pwd_cred (const struct _u_request * re
     json_decref(j_user);
   } else if (ret == G_ERROR_PARAM) {
     response->status = 400;
+  } else if (ret == G_ERROR_UNAVAILABLE) {
+    set_response_password_pool_unavailable(response);
   } else {
     response->status = 500;
   }
@@ -3059,6 +3107,8 @@ static int check_auth_type_client_credentials_grant (const struct _u_request * r
         response->status = 500;
       }
       free_string_array(scope_array);
+    } else if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+      set_response_password_pool_unavailable(response);
     } else {
       y_log_message(Y_LOG_LEVEL_DEBUG, "oidc check_auth_type_client_credentials_grant - Error client_id '%s' invalid", request->auth_basic_user);
       y_log_message(Y_LOG_LEVEL_WARNING, "Security - Authorization invalid for client_id %s at IP Address %s", request->auth_basic_user, ip_source);
@@ -3083,14 +3133,16 @@ static int get_access_token_from_refresh (const struct _u_request * request, str
   json_t * j_refresh, * json_body, * j_client, * j_user;
   time_t now;
   char * access_token, * scope_joined = NULL, * issued_for;
-  int has_error = 0, has_issues = 0;
+  int has_error = 0, has_issues = 0, is_unavailable = 0;
 
   if (refresh_token != NULL && !o_strnullempty(refresh_token)) {
     j_refresh = validate_refresh_token(config, refresh_token);
     if (check_result_value(j_refresh, G_OK)) {
       if (json_object_get(json_object_get(j_refresh, "token"), "client_id") != json_null()) {
         j_client = check_client_valid(config, json_string_value(json_object_get(json_object_get(j_refresh, "token"), "client_id")), request->auth_basic_user, request->auth_basic_password, NULL, GLEWLWYD_AUTHORIZATION_TYPE_REFRESH_TOKEN, 0, ip_source);
-        if (!check_result_value(j_client, G_OK)) {
+        if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+          is_unavailable = 1;
+        } else if (!check_result_value(j_client, G_OK)) {
           has_issues = 1;
         } else if (request->auth_basic_user == NULL && request->auth_basic_password == NULL && json_object_get(json_object_get(j_client, "client"), "confidential") == json_true()) {
           y_log_message(Y_LOG_LEVEL_DEBUG, "get_access_token_from_refresh - oauth2 - client '%s' is invalid or is not confidential, origin: %s", request->auth_basic_user, ip_source);
@@ -3113,7 +3165,7 @@ static int get_access_token_from_refresh (const struct _u_request * request, str
         y_log_message(Y_LOG_LEVEL_ERROR, "get_access_token_from_refresh - oauth2 - Error update_refresh_token");
         has_error = 1;
       }
-      if (!has_error && !has_issues) {
+      if (!has_error && !has_issues && !is_unavailable) {
         j_user = config->glewlwyd_config->glewlwyd_plugin_callback_get_user(config->glewlwyd_config, json_string_value(json_object_get(json_object_get(j_refresh, "token"), "username")));
         if (check_result_value(j_user, G_OK)) {
           if ((access_token = generate_access_token(config, 
@@ -3157,6 +3209,8 @@ static int get_access_token_from_refresh (const struct _u_request * request, str
           response->status = 500;
         }
         json_decref(j_user);
+      } else if (is_unavailable) {
+        set_response_password_pool_unavailable(response);
       } else if (has_issues) {
         response->status = 400;
       } else {
@@ -3189,14 +3243,16 @@ static int delete_refresh_token (const struct _u_request * request, struct _u_re
   json_t * j_refresh, * j_client;
   time_t now;
   char * issued_for;
-  int has_issues = 0;
+  int has_issues = 0, is_unavailable = 0;
   
   if (refresh_token != NULL && !o_strnullempty(refresh_token)) {
     j_refresh = validate_refresh_token(config, refresh_token);
     if (check_result_value(j_refresh, G_OK)) {
       if (json_object_get(json_object_get(j_refresh, "token"), "client_id") != json_null()) {
         j_client = check_client_valid(config, json_string_value(json_object_get(json_object_get(j_refresh, "token"), "client_id")), request->auth_basic_user, request->auth_basic_password, NULL, GLEWLWYD_AUTHORIZATION_TYPE_REFRESH_TOKEN, 0, ip_source);
-        if (!check_result_value(j_client, G_OK)) {
+        if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+          is_unavailable = 1;
+        } else if (!check_result_value(j_client, G_OK)) {
           y_log_message(Y_LOG_LEVEL_DEBUG, "delete_refresh_token - oauth2 - client '%s' is invalid, origin: %s", request->auth_basic_user, ip_source);
           has_issues = 1;
         } else if (request->auth_basic_user == NULL && request->auth_basic_password == NULL && json_object_get(json_object_get(j_client, "client"), "confidential") == json_true()) {
@@ -3205,7 +3261,9 @@ static int delete_refresh_token (const struct _u_request * request, struct _u_re
         }
         json_decref(j_client);
       }
-      if (!has_issues) {
+      if (is_unavailable) {
+        set_response_password_pool_unavailable(response);
+      } else if (!has_issues) {
         time(&now);
         issued_for = get_client_hostname(request);
         if (update_refresh_token(config, json_integer_value(json_object_get(json_object_get(j_refresh, "token"), "gpgr_id")), 0, 1, now) != G_OK) {
@@ -3535,6 +3593,8 @@ static int callback_oauth2_device_authorization(const struct _u_request * reques
         json_decref(j_body);
       }
       json_decref(j_result);
+    } else if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+      set_response_password_pool_unavailable(response);
     } else {
       j_body = json_pack("{ss}", "error", "unauthorized_client");
       ulfius_set_json_body_response(response, 403, j_body);
@@ -3685,6 +3745,7 @@ static int jwt_autocheck(struct _oauth2_config * config) {
 }
 
 static int disable_user_data(struct _oauth2_config * config, const char * username) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res, ret = G_OK;
   
@@ -3697,7 +3758,7 @@ static int disable_user_data(struct _oauth2_config * config, const char * userna
                           "gpgc_plugin_name", config->name,
                           "gpgc_username", username,
                           "gpgc_enabled", 1);
-    res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res != H_OK) {
       y_log_message(Y_LOG_LEVEL_ERROR, "disable_user_data - Error disable codes");
@@ -3713,7 +3774,7 @@ static int disable_user_data(struct _oauth2_config * config, const char * userna
                           "gpgr_plugin_name", config->name,
                           "gpgr_username", username,
                           "gpgr_enabled", 1);
-    res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res != H_OK) {
       y_log_message(Y_LOG_LEVEL_ERROR, "disable_user_data - Error disable refresh tokens");
@@ -3729,7 +3790,7 @@ static int disable_user_data(struct _oauth2_config * config, const char * userna
                           "gpga_plugin_name", config->name,
                           "gpga_username", username,
                           "gpga_enabled", 1);
-    res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res != H_OK) {
       y_log_message(Y_LOG_LEVEL_ERROR, "disable_user_data - Error disable access tokens");
@@ -3747,7 +3808,7 @@ static int disable_user_data(struct _oauth2_config * config, const char * userna
                           "gpgda_status",
                             "operator", "raw",
                             "value", "in (0, 1)");
-    res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res != H_OK) {
       y_log_message(Y_LOG_LEVEL_ERROR, "disable_user_data - Error disable device auth tokens");
@@ -3755,6 +3816,7 @@ static int disable_user_data(struct _oauth2_config * config, const char * userna
       break;
     }
   } while (0);
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
@@ -3775,7 +3837,6 @@ int plugin_module_unload(struct config_plugin * config) {
 json_t * plugin_module_init(struct config_plugin * config, const char * name, json_t * j_parameters, void ** cls) {
   const unsigned char * key;
   jwa_alg alg = R_JWA_ALG_UNKNOWN;
-  pthread_mutexattr_t mutexattr;
   json_t * j_return = NULL, * j_result = NULL, * j_element = NULL;
   size_t index = 0;
   struct _oauth2_config * p_config = NULL;
@@ -3788,15 +3849,6 @@ json_t * plugin_module_init(struct config_plugin * config, const char * name, js
     p_config->glewlwyd_resource_config = NULL;
     
     do {
-      pthread_mutexattr_init ( &mutexattr );
-      pthread_mutexattr_settype( &mutexattr, PTHREAD_MUTEX_RECURSIVE );
-      if (pthread_mutex_init(&p_config->insert_lock, &mutexattr) != 0) {
-        y_log_message(Y_LOG_LEVEL_ERROR, "plugin_module_init - oauth2 - Error initializing insert_lock");
-        j_return = json_pack("{si}", "result", G_ERROR);
-        break;
-      }
-      pthread_mutexattr_destroy(&mutexattr);
-      
       p_config->name = name;
       p_config->jwt_key = NULL;
       p_config->j_params = json_incref(j_parameters);
@@ -4068,7 +4120,16 @@ json_t * plugin_module_init(struct config_plugin * config, const char * name, js
       if (json_object_get(p_config->j_params, "introspection-revocation-allowed") == json_true()) {
         config->glewlwyd_plugin_callback_metrics_increment_counter(config, GLWD_METRICS_OAUTH2_INVALID_ACCESS_TOKEN, 0, "plugin", name, NULL);
       }
-      
+      // Expired rows purge, the codes used by a refresh token are kept
+      if (config->glewlwyd_callback_purge_add_task(config, name, GLEWLWYD_PLUGIN_OAUTH2_TABLE_CODE, "gpgc_id", "gpgc_plugin_name", "gpgc_expires_at", 0, "NOT EXISTS (SELECT gpgr_id FROM " GLEWLWYD_PLUGIN_OAUTH2_TABLE_REFRESH_TOKEN " WHERE " GLEWLWYD_PLUGIN_OAUTH2_TABLE_REFRESH_TOKEN ".gpgc_id=" GLEWLWYD_PLUGIN_OAUTH2_TABLE_CODE ".gpgc_id)") != G_OK ||
+          config->glewlwyd_callback_purge_add_task(config, name, GLEWLWYD_PLUGIN_OAUTH2_TABLE_REFRESH_TOKEN, "gpgr_id", "gpgr_plugin_name", "gpgr_expires_at", 0, NULL) != G_OK ||
+          config->glewlwyd_callback_purge_add_task(config, name, GLEWLWYD_PLUGIN_OAUTH2_TABLE_ACCESS_TOKEN, "gpga_id", "gpga_plugin_name", "gpga_issued_at", (unsigned int)p_config->access_token_duration, NULL) != G_OK ||
+          config->glewlwyd_callback_purge_add_task(config, name, GLEWLWYD_PLUGIN_OAUTH2_TABLE_DEVICE_AUTHORIZATION, "gpgda_id", "gpgda_plugin_name", "gpgda_expires_at", 0, NULL) != G_OK) {
+        y_log_message(Y_LOG_LEVEL_ERROR, "plugin_module_init - oauth2 - Error glewlwyd_callback_purge_add_task");
+        config->glewlwyd_callback_purge_remove_task(config, name);
+        j_return = json_pack("{si}", "result", G_ERROR);
+        break;
+      }
     } while (0);
     json_decref(j_result);
     r_jwk_free(key_priv);
@@ -4091,7 +4152,6 @@ json_t * plugin_module_init(struct config_plugin * config, const char * name, js
         }
         r_jwt_free(p_config->jwt_key);
         json_decref(p_config->j_params);
-        pthread_mutex_destroy(&p_config->insert_lock);
         o_free(p_config);
       }
     }
@@ -4108,6 +4168,7 @@ int plugin_module_close(struct config_plugin * config, const char * name, void *
   UNUSED(name);
   if (cls != NULL) {
     y_log_message(Y_LOG_LEVEL_INFO, "Close plugin Glewlwyd Oauth2 '%s'", name);
+    config->glewlwyd_callback_purge_remove_task(config, name);
     config->glewlwyd_callback_remove_plugin_endpoint(config, "GET", name, "auth/");
     config->glewlwyd_callback_remove_plugin_endpoint(config, "POST", name, "token/");
     config->glewlwyd_callback_remove_plugin_endpoint(config, "GET", name, "profile/");
@@ -4135,7 +4196,6 @@ int plugin_module_close(struct config_plugin * config, const char * name, void *
     }
     r_jwt_free(((struct _oauth2_config *)cls)->jwt_key);
     json_decref(((struct _oauth2_config *)cls)->j_params);
-    pthread_mutex_destroy(&((struct _oauth2_config *)cls)->insert_lock);
     o_free(cls);
   }
   return G_OK;
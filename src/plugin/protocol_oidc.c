@@ -39,6 +39,7 @@
 #include <orcania.h>
 #include <ulfius.h>
 #include <rhonabwy.h>
+#include <zlib.h>
 #include "glewlwyd-common.h"
 
 #define OIDC_CODE_LENGTH               32
@@ -148,6 +149,12 @@
 #define GLEWLWYD_TOKEN_TYPE_CIBA          6
 #define GLEWLWYD_TOKEN_TYPE_AUTH          7
 
+#define GLEWLWYD_JWK_KTY_OCT 0
+#define GLEWLWYD_JWK_KTY_RSA 1
+#define GLEWLWYD_JWK_KTY_EC  2
+#define GLEWLWYD_JWK_KTY_OKP 3
+#define GLEWLWYD_JWK_NB_KTY  4
+
 #define GLEWLWYD_AUTH_TOKEN_DEFAULT_MAX_AGE 3600
 #define GLEWLWYD_AUTH_TOKEN_ASSERTION_TYPE "urn:ietf:params:oauth:client-assertion-type:jwt-bearer"
 
@@ -169,6 +176,14 @@
 #define GLEWLWYD_CIBA_REQ_ID_LENGTH      32
 #define GLEWLWYD_CIBA_GRANT_TYPE         "urn:openid:params:grant-type:ciba"
 
+#define GLEWLWYD_CLIENT_JWKS_CACHE_MIN_TTL      60
+#define GLEWLWYD_CLIENT_JWKS_CACHE_MAX_TTL      3600
+#define GLEWLWYD_CLIENT_JWKS_CACHE_KID_INTERVAL 10
+#define GLEWLWYD_CLIENT_JWKS_CACHE_NB_BUCKET    256
+
+#define GLEWLWYD_STATIC_BODY_GZIP_WINDOW_BITS 15
+#define GLEWLWYD_STATIC_BODY_GZIP_ENCODING    16
+
 #define GLWD_METRICS_OIDC_CODE                        "glewlwyd_oidc_code"
 #define GLWD_METRICS_OIDC_DEVICE_CODE                 "glewlwyd_oidc_device_code"
 #define GLWD_METRICS_OIDC_ID_TOKEN                    "glewlwyd_oidc_id_token"
@@ -180,6 +195,9 @@
 #define GLWD_METRICS_OIDC_INVALID_DEVICE_CODE         "glewlwyd_oidc_invalid_device_code"
 #define GLWD_METRICS_OIDC_INVALID_REFRESH_TOKEN       "glewlwyd_oidc_invalid_refresh_token"
 #define GLWD_METRICS_OIDC_INVALID_ACCESS_TOKEN        "glewlwyd_oidc_invalid_acccess_token"
+#define GLWD_METRICS_OIDC_CLIENT_JWKS_CACHE           "glewlwyd_oidc_client_jwks_cache"
+#define GLWD_METRICS_OIDC_CLIENT_JWKS_REFRESH         "glewlwyd_oidc_client_jwks_refresh"
+#define GLWD_METRICS_OIDC_CLIENT_JWKS_REFRESH_DURATION "glewlwyd_oidc_client_jwks_refresh_duration_milliseconds"
 
 #define GLEWLWYD_TOKEN_TYPE_BEARER "bearer"
 #define GLEWLWYD_TOKEN_TYPE_DPOP "DPoP"
@@ -191,6 +209,32 @@
 /**
  * Structure used to store all the plugin parameters and data duringexecution
  */
+/**
+ * Index of the signing keys, built once with the keys
+ * The jwk are owned by the index, lookups return them without copy
+ */
+struct _jwks_sign_index {
+  size_t   nb_jwk;
+  jwk_t ** jwk_list;
+  json_t * j_kid;
+  json_t * j_alg;
+  jwk_t  * kty_default[GLEWLWYD_JWK_NB_KTY];
+};
+
+/**
+ * Precomputed validators and compressed variants of a static response body
+ * Each variant has its own ETag, as required for strong validators
+ */
+struct _oidc_static_body {
+  char   * etag;
+  char   * etag_gzip;
+  char   * etag_deflate;
+  char   * gzip;
+  size_t   gzip_len;
+  char   * deflate;
+  size_t   deflate_len;
+};
+
 struct _oidc_config {
   struct config_plugin         * glewlwyd_config;
   const char                   * name;
@@ -198,10 +242,13 @@ struct _oidc_config {
 
   jwks_t                       * jwks_sign;
   jwks_t                       * jwks_public;
+  struct _jwks_sign_index        jwks_sign_index;
   int                            x5u_flags;
 
   char                         * discovery_str;
   char                         * jwks_str;
+  struct _oidc_static_body       discovery_body;
+  struct _oidc_static_body       jwks_body;
   char                         * check_session_iframe;
 
   json_int_t                     access_token_duration;
@@ -219,6 +266,12 @@ struct _oidc_config {
   char                         * client_register_scope;
   time_t                         dpop_max_iat;
   time_t                         dpop_max_iat_gap;
+  unsigned short int             dpop_jti_persist;
+  struct _glwd_replay_cache      dpop_jti_cache;
+  unsigned short int             request_jti_persist;
+  struct _glwd_replay_cache      request_jti_cache;
+  struct _glwd_replay_cache      ciba_jti_cache;
+  struct _jwks_uri_cache       * jwks_uri_cache;
 };
 
 static size_t get_enc_key_size(jwa_enc enc) {
@@ -586,6 +639,10 @@ static json_t * check_parameters (json_t * j_params) {
         json_array_append_new(j_error, json_string("Property 'request-maximum-exp' is optional and must be a positive integer"));
         ret = G_ERROR_PARAM;
       }
+      if (json_object_get(j_params, "request-jti-persist") != NULL && !json_is_boolean(json_object_get(j_params, "request-jti-persist"))) {
+        json_array_append_new(j_error, json_string("Property 'request-jti-persist' is optional and must be a boolean"));
+        ret = G_ERROR_PARAM;
+      }
       if (json_object_get(j_params, "client-pubkey-parameter") != NULL && !json_is_string(json_object_get(j_params, "client-pubkey-parameter"))) {
         json_array_append_new(j_error, json_string("Property 'client-pubkey-parameter' is optional and must be a string"));
         ret = G_ERROR_PARAM;
@@ -594,6 +651,17 @@ static json_t * check_parameters (json_t * j_params) {
         json_array_append_new(j_error, json_string("Property 'client-jwks-parameter' is optional and must be a string"));
         ret = G_ERROR_PARAM;
       }
+      if (json_object_get(j_params, "client-jwks-cache-min-ttl") != NULL && (!json_is_integer(json_object_get(j_params, "client-jwks-cache-min-ttl")) || json_integer_value(json_object_get(j_params, "client-jwks-cache-min-ttl")) < 0)) {
+        json_array_append_new(j_error, json_string("Property 'client-jwks-cache-min-ttl' is optional and must be a positive integer or 0"));
+        ret = G_ERROR_PARAM;
+      }
+      if (json_object_get(j_params, "client-jwks-cache-max-ttl") != NULL && (!json_is_integer(json_object_get(j_params, "client-jwks-cache-max-ttl")) || json_integer_value(json_object_get(j_params, "client-jwks-cache-max-ttl")) < 0)) {
+        json_array_append_new(j_error, json_string("Property 'client-jwks-cache-max-ttl' is optional and must be a positive integer or 0"));
+        ret = G_ERROR_PARAM;
+      } else if (json_integer_value(json_object_get(j_params, "client-jwks-cache-max-ttl")) && json_integer_value(json_object_get(j_params, "client-jwks-cache-min-ttl")) > json_integer_value(json_object_get(j_params, "client-jwks-cache-max-ttl"))) {
+        json_array_append_new(j_error, json_string("Property 'client-jwks-cache-min-ttl' must be lower or equal to 'client-jwks-cache-max-ttl'"));
+        ret = G_ERROR_PARAM;
+      }
       if (json_object_get(j_params, "client-jwks_uri-parameter") != NULL && !json_is_string(json_object_get(j_params, "client-jwks_uri-parameter"))) {
         json_array_append_new(j_error, json_string("Property 'client-jwks_uri-parameter' is optional and must be a string"));
         ret = G_ERROR_PARAM;
@@ -1050,6 +1118,10 @@ static json_t * check_parameters (json_t * j_params) {
         json_array_append_new(j_error, json_string("Property 'oauth-dpop-dpop_bound_access_tokens-property' is optional and must be a string"));
         ret = G_ERROR_PARAM;
       }
+      if (json_object_get(j_params, "oauth-dpop-jti-persist") != NULL && !json_is_boolean(json_object_get(j_params, "oauth-dpop-jti-persist"))) {
+        json_array_append_new(j_error, json_string("Property 'oauth-dpop-jti-persist' is optional and must be a boolean"));
+        ret = G_ERROR_PARAM;
+      }
       if (json_object_get(j_params, "oauth-dpop-nonce-mandatory") != NULL && !json_is_boolean(json_object_get(j_params, "oauth-dpop-nonce-mandatory"))) {
         json_array_append_new(j_error, json_string("Property 'oauth-dpop-nonce-mandatory' is optional and must be a boolean"));
         ret = G_ERROR_PARAM;
@@ -1495,6 +1567,7 @@ static int verify_resource(struct _oidc_config * config, const char * resource,
  * if counter is 0 for client_id, generate one, then returns it
  */
 static char * refresh_client_dpop_nonce(struct _oidc_config * config, const char * client_id) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result;
   int res;
   char * nonce = NULL, new_nonce[OIDC_DPOP_NONCE_LENGTH+1];
@@ -1506,7 +1579,7 @@ static char * refresh_client_dpop_nonce(struct _oidc_config * config, const char
                           "gpodcn_counter AS counter",
                         "where",
                           "gpodcn_client_id", client_id);
-    res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+    res = h_select(conn, j_query, &j_result, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       if (json_array_size(j_result)) {
@@ -1529,7 +1602,7 @@ static char * refresh_client_dpop_nonce(struct _oidc_config * config, const char
           }
         }
         if (res == G_OK) {
-          res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+          res = h_update(conn, j_query, NULL);
           json_decref(j_query);
           if (res != H_OK) {
             y_log_message(Y_LOG_LEVEL_ERROR, "refresh_client_dpop_nonce - Error executing j_query (3)");
@@ -1543,7 +1616,7 @@ static char * refresh_client_dpop_nonce(struct _oidc_config * config, const char
                                 "gpodcn_client_id", client_id,
                                 "gpodcn_nonce", new_nonce,
                                 "gpodcn_counter", json_integer_value(json_object_get(config->j_params, "oauth-dpop-nonce-counter")));
-          res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+          res = h_insert(conn, j_query, NULL);
           json_decref(j_query);
           if (res == H_OK) {
             nonce = o_strdup(new_nonce);
@@ -1562,6 +1635,7 @@ static char * refresh_client_dpop_nonce(struct _oidc_config * config, const char
   } else {
     y_log_message(Y_LOG_LEVEL_ERROR, "refresh_client_dpop_nonce - Error pthread_mutex_lock");
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return nonce;
 }
 
@@ -1569,6 +1643,7 @@ static char * refresh_client_dpop_nonce(struct _oidc_config * config, const char
  * Return current dpop nonce for client_id
  */
 static char * get_client_dpop_nonce(struct _oidc_config * config, const char * client_id) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result;
   int res;
   char * nonce = NULL, new_nonce[OIDC_DPOP_NONCE_LENGTH+1];
@@ -1579,7 +1654,7 @@ static char * get_client_dpop_nonce(struct _oidc_config * config, const char * c
                         "gpodcn_nonce AS nonce",
                       "where",
                         "gpodcn_client_id", client_id);
-  res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result)) {
@@ -1593,7 +1668,7 @@ static char * get_client_dpop_nonce(struct _oidc_config * config, const char * c
                                 "gpodcn_client_id", client_id,
                                 "gpodcn_nonce", new_nonce,
                                 "gpodcn_counter", json_integer_value(json_object_get(config->j_params, "oauth-dpop-nonce-counter")));
-          res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+          res = h_insert(conn, j_query, NULL);
           json_decref(j_query);
           if (res == H_OK) {
             nonce = o_strdup(new_nonce);
@@ -1612,6 +1687,7 @@ static char * get_client_dpop_nonce(struct _oidc_config * config, const char * c
   } else {
     y_log_message(Y_LOG_LEVEL_ERROR, "get_client_dpop_nonce - Error executing j_query (1)");
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return nonce;
 }
 
@@ -1770,22 +1846,23 @@ static json_t * oidc_verify_dpop_proof(struct _oidc_config * config, const struc
 }
 
 /**
- * Verifies that this jti has not been used for another DPoP
+ * Verifies in the database that this jti has not been used for another DPoP
  * If so, stores its metadata
  */
-static int check_dpop_jti(struct _oidc_config * config,
-                          const char * jti,
-                          const char * htm,
-                          const char * htu,
-                          json_int_t iat,
-                          const char * client_id,
-                          const char * jkt,
-                          const char * ip_source) {
-  char * jti_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, jti), * iat_clause;
+static int check_dpop_jti_database(struct _oidc_config * config,
+                                   const char * jti,
+                                   const char * htm,
+                                   const char * htu,
+                                   json_int_t iat,
+                                   const char * client_id,
+                                   const char * jkt,
+                                   const char * ip_source) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
+  char jti_hash[GLEWLWYD_HASH_BUFFER_SIZE], * iat_clause;
   json_t * j_query, * j_result;
   int res, ret;
 
-  if (jti_hash != NULL) {
+  if (config->glewlwyd_config->glewlwyd_callback_generate_hash_buffer(config->glewlwyd_config, jti, jti_hash, sizeof(jti_hash)) == G_OK) {
     j_query = json_pack("{sss[s]s{ssssss}}",
                         "table", GLEWLWYD_PLUGIN_OIDC_TABLE_DPOP,
                         "columns",
@@ -1794,13 +1871,13 @@ static int check_dpop_jti(struct _oidc_config * config,
                           "gpod_plugin_name", config->name,
                           "gpod_jti_hash", jti_hash,
                           "gpod_client_id", client_id);
-    res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+    res = h_select(conn, j_query, &j_result, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       if (!json_array_size(j_result)) {
-        if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+        if (conn->type==HOEL_DB_TYPE_MARIADB) {
           iat_clause = msprintf("FROM_UNIXTIME(%"JSON_INTEGER_FORMAT")", iat);
-        } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+        } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
           iat_clause = msprintf("TO_TIMESTAMP(%"JSON_INTEGER_FORMAT")", iat);
         } else { // HOEL_DB_TYPE_SQLITE
           iat_clause = msprintf("%"JSON_INTEGER_FORMAT, iat);
@@ -1818,12 +1895,12 @@ static int check_dpop_jti(struct _oidc_config * config,
                                 "raw",
                                 iat_clause);
         o_free(iat_clause);
-        res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+        res = h_insert(conn, j_query, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           ret = G_OK;
         } else {
-          y_log_message(Y_LOG_LEVEL_ERROR, "check_dpop_jti - Error executing j_query (2)");
+          y_log_message(Y_LOG_LEVEL_ERROR, "check_dpop_jti_database - Error executing j_query (2)");
           config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
           ret = G_ERROR_DB;
         }
@@ -1834,32 +1911,68 @@ static int check_dpop_jti(struct _oidc_config * config,
       }
       json_decref(j_result);
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "check_dpop_jti - Error executing j_query (1)");
+      y_log_message(Y_LOG_LEVEL_ERROR, "check_dpop_jti_database - Error executing j_query (1)");
       config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
       ret = G_ERROR_DB;
     }
-    o_free(jti_hash);
   } else {
-    y_log_message(Y_LOG_LEVEL_ERROR, "check_dpop_jti - Error glewlwyd_callback_generate_hash");
+    y_log_message(Y_LOG_LEVEL_ERROR, "check_dpop_jti_database - Error glewlwyd_callback_generate_hash_buffer");
     ret = G_ERROR;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 /**
  * Verifies that this jti has not been used for another DPoP
- * If so, stores its metadata
+ * The jti is kept in memory until the DPoP iat expires,
+ * and stored in the database too if oauth-dpop-jti-persist is set
  */
-static int check_ciba_jti(struct _oidc_config * config,
+static int check_dpop_jti(struct _oidc_config * config,
                           const char * jti,
+                          const char * htm,
+                          const char * htu,
+                          json_int_t iat,
                           const char * client_id,
+                          const char * jkt,
                           const char * ip_source) {
-  char * jti_hash;
+  int ret;
+
+  if (config->dpop_jti_cache.initialized) {
+    ret = glewlwyd_replay_cache_check_and_set(&config->dpop_jti_cache, client_id, jti, (time_t)iat+config->dpop_max_iat+1);
+    if (ret == G_OK) {
+      if (config->dpop_jti_persist) {
+        ret = check_dpop_jti_database(config, jti, htm, htu, iat, client_id, jkt, ip_source);
+        if (ret != G_OK && ret != G_ERROR_UNAUTHORIZED) {
+          glewlwyd_replay_cache_remove(&config->dpop_jti_cache, client_id, jti);
+        }
+      }
+    } else if (ret == G_ERROR_UNAUTHORIZED) {
+      y_log_message(Y_LOG_LEVEL_WARNING, "jti already used for client %s at IP Address %s", client_id, ip_source);
+      config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_OIDC_UNAUTHORIZED_CLIENT, 1, "plugin", config->name, NULL);
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "check_dpop_jti - Error glewlwyd_replay_cache_check_and_set");
+    }
+  } else {
+    ret = check_dpop_jti_database(config, jti, htm, htu, iat, client_id, jkt, ip_source);
+  }
+  return ret;
+}
+
+/**
+ * Verifies in the database that this jti has not been used for another CIBA request
+ */
+static int check_ciba_jti_database(struct _oidc_config * config,
+                                   const char * jti,
+                                   const char * client_id,
+                                   const char * ip_source) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
+  char jti_hash[GLEWLWYD_HASH_BUFFER_SIZE];
   json_t * j_query, * j_result;
   int res, ret;
 
   if (!o_strnullempty(jti)) {
-    if ((jti_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, jti)) != NULL) {
+    if (config->glewlwyd_config->glewlwyd_callback_generate_hash_buffer(config->glewlwyd_config, jti, jti_hash, sizeof(jti_hash)) == G_OK) {
       j_query = json_pack("{sss[s]s{ssssss}}",
                           "table", GLEWLWYD_PLUGIN_OIDC_TABLE_CIBA,
                           "columns",
@@ -1868,9 +1981,8 @@ static int check_ciba_jti(struct _oidc_config * config,
                             "gpob_plugin_name", config->name,
                             "gpob_jti_hash", jti_hash,
                             "gpob_client_id", client_id);
-      res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+      res = h_select(conn, j_query, &j_result, NULL);
       json_decref(j_query);
-      o_free(jti_hash);
       if (res == H_OK) {
         if (!json_array_size(j_result)) {
           ret = RHN_OK;
@@ -1881,17 +1993,54 @@ static int check_ciba_jti(struct _oidc_config * config,
         }
         json_decref(j_result);
       } else {
-        y_log_message(Y_LOG_LEVEL_ERROR, "check_ciba_jti - Error executing j_query");
+        y_log_message(Y_LOG_LEVEL_ERROR, "check_ciba_jti_database - Error executing j_query");
         config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
         ret = G_ERROR_DB;
       }
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "check_ciba_jti - Error glewlwyd_callback_generate_hash");
+      y_log_message(Y_LOG_LEVEL_ERROR, "check_ciba_jti_database - Error glewlwyd_callback_generate_hash_buffer");
       ret = G_ERROR;
     }
   } else {
     ret = G_ERROR_PARAM;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
+  return ret;
+}
+
+/**
+ * Verifies that this jti has not been used for another CIBA request
+ * The jti is kept in memory until the request expires, the database is
+ * checked too if request-jti-persist is set or if exp is out of the cache range
+ */
+static int check_ciba_jti(struct _oidc_config * config,
+                          const char * jti,
+                          json_int_t exp,
+                          const char * client_id,
+                          const char * ip_source) {
+  json_int_t j_now = (json_int_t)time(NULL);
+  int ret;
+
+  if (o_strnullempty(jti)) {
+    ret = G_ERROR_PARAM;
+  } else if (config->ciba_jti_cache.initialized && exp > j_now && exp - j_now < (json_int_t)config->ciba_jti_cache.max_lifetime) {
+    ret = glewlwyd_replay_cache_check_and_set(&config->ciba_jti_cache, client_id, jti, (time_t)exp+1);
+    if (ret == G_OK) {
+      if (config->request_jti_persist) {
+        ret = check_ciba_jti_database(config, jti, client_id, ip_source);
+        if (ret != G_OK && ret != G_ERROR_UNAUTHORIZED) {
+          glewlwyd_replay_cache_remove(&config->ciba_jti_cache, client_id, jti);
+        }
+      }
+    } else if (ret == G_ERROR_UNAUTHORIZED) {
+      y_log_message(Y_LOG_LEVEL_WARNING, "jti already used for client %s at IP Address %s", client_id, ip_source);
+      config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_OIDC_UNAUTHORIZED_CLIENT, 1, "plugin", config->name, NULL);
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "check_ciba_jti - Error glewlwyd_replay_cache_check_and_set");
+    }
+  } else {
+    ret = check_ciba_jti_database(config, jti, client_id, ip_source);
+  }
   return ret;
 }
 
@@ -1900,6 +2049,7 @@ static int check_ciba_jti(struct _oidc_config * config,
  * Or create one and store it in the database if it doesn't exist
  */
 static char * get_sub_public(struct _oidc_config * config, const char * username) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result;
   int res;
   char * sub = NULL;
@@ -1918,7 +2068,7 @@ static char * get_sub_public(struct _oidc_config * config, const char * username
                         json_null(),
                         "gposi_sector_identifier_uri",
                         json_null());
-  res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result)) {
@@ -1942,7 +2092,7 @@ static char * get_sub_public(struct _oidc_config * config, const char * username
                                 json_null(),
                                 "gposi_sector_identifier_uri",
                                 json_null());
-          if (h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL) != H_OK) {
+          if (h_insert(conn, j_query, NULL) != H_OK) {
             y_log_message(Y_LOG_LEVEL_ERROR, "get_sub_public - Error executing h_insert");
             o_free(sub);
             sub = NULL;
@@ -1959,6 +2109,7 @@ static char * get_sub_public(struct _oidc_config * config, const char * username
   } else {
     y_log_message(Y_LOG_LEVEL_ERROR, "get_sub_public - Error executing h_select");
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return sub;
 }
 
@@ -1967,6 +2118,7 @@ static char * get_sub_public(struct _oidc_config * config, const char * username
  * Or create one and store it in the database if it doesn't exist
  */
 static char * get_sub_pairwise(struct _oidc_config * config, const char * username, json_t * j_client) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result;
   int res;
   char * sub = NULL;
@@ -1989,7 +2141,7 @@ static char * get_sub_pairwise(struct _oidc_config * config, const char * userna
     json_object_set(json_object_get(j_query, "where"), "gposi_sector_identifier_uri", json_null());
     json_object_set(json_object_get(j_query, "where"), "gposi_client_id", json_object_get(j_client, "client_id"));
   }
-  res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result)) {
@@ -2016,7 +2168,7 @@ static char * get_sub_pairwise(struct _oidc_config * config, const char * userna
             json_object_set(json_object_get(j_query, "values"), "gposi_sector_identifier_uri", json_null());
             json_object_set(json_object_get(j_query, "where"), "gposi_client_id", json_object_get(j_client, "client_id"));
           }
-          if (h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL) != H_OK) {
+          if (h_insert(conn, j_query, NULL) != H_OK) {
             y_log_message(Y_LOG_LEVEL_ERROR, "get_sub_pairwise - Error executing h_insert");
             o_free(sub);
             sub = NULL;
@@ -2033,6 +2185,7 @@ static char * get_sub_pairwise(struct _oidc_config * config, const char * userna
   } else {
     y_log_message(Y_LOG_LEVEL_ERROR, "get_sub_pairwise - Error executing h_select");
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return sub;
 }
 
@@ -2053,6 +2206,7 @@ static char * get_sub(struct _oidc_config * config, const char * username, json_
  * Return NULL if not exist
  */
 static char * get_username_from_sub(struct _oidc_config * config, const char * sub, json_t * j_client) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result;
   int res;
   char * username = NULL;
@@ -2078,7 +2232,7 @@ static char * get_username_from_sub(struct _oidc_config * config, const char * s
       }
     }
   }
-  res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result)) {
@@ -2088,6 +2242,7 @@ static char * get_username_from_sub(struct _oidc_config * config, const char * s
   } else {
     y_log_message(Y_LOG_LEVEL_ERROR, "get_username_from_sub - Error executing h_select");
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return username;
 }
 
@@ -2187,6 +2342,80 @@ static int is_encrypt_token_allowed(struct _oidc_config * config, json_t * j_cli
   return ret;
 }
 
+static int get_jwk_kty_index(jwk_t * jwk) {
+  const char * kty = r_jwk_get_property_str(jwk, "kty");
+  int index;
+
+  if (0 == o_strcmp("oct", kty)) {
+    index = GLEWLWYD_JWK_KTY_OCT;
+  } else if (0 == o_strcmp("RSA", kty)) {
+    index = GLEWLWYD_JWK_KTY_RSA;
+  } else if (0 == o_strcmp("EC", kty)) {
+    index = GLEWLWYD_JWK_KTY_EC;
+  } else if (0 == o_strcmp("OKP", kty)) {
+    index = GLEWLWYD_JWK_KTY_OKP;
+  } else {
+    index = -1;
+  }
+  return index;
+}
+
+static void free_jwks_sign_index(struct _jwks_sign_index * jwks_index) {
+  size_t i;
+
+  for (i=0; i<jwks_index->nb_jwk; i++) {
+    r_jwk_free(jwks_index->jwk_list[i]);
+  }
+  o_free(jwks_index->jwk_list);
+  json_decref(jwks_index->j_kid);
+  json_decref(jwks_index->j_alg);
+  memset(jwks_index, 0, sizeof(struct _jwks_sign_index));
+}
+
+/**
+ * Builds the index of config->jwks_sign by kid, alg and kty
+ * The first key of an alg or a kty is the default key for it
+ */
+static int build_jwks_sign_index(struct _oidc_config * config) {
+  struct _jwks_sign_index * jwks_index = &config->jwks_sign_index;
+  jwk_t * jwk;
+  size_t i;
+  int kty, ret = G_OK;
+
+  free_jwks_sign_index(jwks_index);
+  if ((jwks_index->jwk_list = o_malloc(r_jwks_size(config->jwks_sign)*sizeof(jwk_t *))) != NULL &&
+      (jwks_index->j_kid = json_object()) != NULL &&
+      (jwks_index->j_alg = json_object()) != NULL) {
+    for (i=0; i<r_jwks_size(config->jwks_sign); i++) {
+      jwk = r_jwks_get_at(config->jwks_sign, i);
+      jwks_index->jwk_list[jwks_index->nb_jwk++] = jwk;
+      if (json_object_get(jwks_index->j_kid, r_jwk_get_property_str(jwk, "kid")) == NULL) {
+        json_object_set_new(jwks_index->j_kid, r_jwk_get_property_str(jwk, "kid"), json_integer((json_int_t)i));
+      }
+      if (!o_strnullempty(r_jwk_get_property_str(jwk, "alg")) && json_object_get(jwks_index->j_alg, r_jwk_get_property_str(jwk, "alg")) == NULL) {
+        json_object_set_new(jwks_index->j_alg, r_jwk_get_property_str(jwk, "alg"), json_integer((json_int_t)i));
+      }
+      if ((kty = get_jwk_kty_index(jwk)) >= 0 && jwks_index->kty_default[kty] == NULL) {
+        jwks_index->kty_default[kty] = jwk;
+      }
+    }
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "build_jwks_sign_index - Error allocating resources for jwks_index");
+    free_jwks_sign_index(jwks_index);
+    ret = G_ERROR_MEMORY;
+  }
+  return ret;
+}
+
+/**
+ * Returns the signing key with this kid, the key must not be freed
+ */
+static jwk_t * get_jwk_sign_by_kid(struct _oidc_config * config, const char * kid) {
+  json_t * j_index = json_object_get(config->jwks_sign_index.j_kid, kid);
+
+  return j_index!=NULL?config->jwks_sign_index.jwk_list[json_integer_value(j_index)]:NULL;
+}
+
 static jwa_alg get_token_sign_alg(struct _oidc_config * config, json_t * j_client, int type) {
   const char * sign_kid = json_string_value(json_object_get(config->j_params, "client-sign_kid-parameter"));
   jwk_t * jwk = NULL;
@@ -2194,9 +2423,8 @@ static jwa_alg get_token_sign_alg(struct _oidc_config * config, json_t * j_clien
 
   if (j_client != NULL) {
     if (!json_string_null_or_empty(json_object_get(j_client, sign_kid))) {
-      jwk = r_jwks_get_by_kid(config->jwks_sign, json_string_value(json_object_get(j_client, sign_kid)));
+      jwk = get_jwk_sign_by_kid(config, json_string_value(json_object_get(j_client, sign_kid)));
       alg = r_str_to_jwa_alg(r_jwk_get_property_str(jwk, "alg"));
-      r_jwk_free(jwk);
     } else {
       switch (type) {
         case GLEWLWYD_TOKEN_TYPE_ACCESS_TOKEN:
@@ -2225,10 +2453,9 @@ static jwa_alg get_token_sign_alg(struct _oidc_config * config, json_t * j_clien
       }
     }
   }
-  if (alg == R_JWA_ALG_UNKNOWN) {
-    jwk = r_jwks_get_at(config->jwks_sign, 0);
+  if (alg == R_JWA_ALG_UNKNOWN && config->jwks_sign_index.nb_jwk > 0) {
+    jwk = config->jwks_sign_index.jwk_list[0];
     alg = r_str_to_jwa_alg(r_jwk_get_property_str(jwk, "alg"));
-    r_jwk_free(jwk);
   }
   return alg;
 }
@@ -2287,44 +2514,471 @@ static jwa_enc get_token_enc(struct _oidc_config * config, json_t * j_client, in
   return enc;
 }
 
+/**
+ * Returns the signing key to use for this client and alg, the key must not be freed
+ */
 static jwk_t * get_jwk_sign(struct _oidc_config * config, json_t * j_client, jwa_alg alg) {
-  jwks_t * jwks_subset = NULL;
+  struct _jwks_sign_index * jwks_index = &config->jwks_sign_index;
+  json_t * j_index;
   jwk_t * jwk = NULL;
   const char * sign_kid = json_string_value(json_object_get(config->j_params, "client-sign_kid-parameter"));
 
-  if (r_jwks_size(config->jwks_sign) == 1 || j_client == NULL) {
-    return r_jwks_get_at(config->jwks_sign, 0);
+  if (!jwks_index->nb_jwk) {
+    jwk = NULL;
+  } else if (jwks_index->nb_jwk == 1 || j_client == NULL) {
+    jwk = jwks_index->jwk_list[0];
   } else if (!json_string_null_or_empty(json_object_get(j_client, sign_kid))) {
-    return r_jwks_get_by_kid(config->jwks_sign, json_string_value(json_object_get(j_client, sign_kid)));
+    jwk = get_jwk_sign_by_kid(config, json_string_value(json_object_get(j_client, sign_kid)));
+  } else if ((j_index = json_object_get(jwks_index->j_alg, r_jwa_alg_to_str(alg))) != NULL) {
+    jwk = jwks_index->jwk_list[json_integer_value(j_index)];
   } else {
     if (alg == R_JWA_ALG_HS256 || alg == R_JWA_ALG_HS384 || alg == R_JWA_ALG_HS512) {
-      jwks_subset = r_jwks_search_json_str(config->jwks_sign, "{\"kty\":\"oct\"}");
-      jwk = r_jwks_get_at(jwks_subset, 0);
-      r_jwks_free(jwks_subset);
+      jwk = jwks_index->kty_default[GLEWLWYD_JWK_KTY_OCT];
     } else if (alg == R_JWA_ALG_RS256 || alg == R_JWA_ALG_RS384 || alg == R_JWA_ALG_RS512 ||
                alg == R_JWA_ALG_PS256 || alg == R_JWA_ALG_PS384 || alg == R_JWA_ALG_PS512) {
-      jwks_subset = r_jwks_search_json_str(config->jwks_sign, "{\"kty\":\"RSA\"}");
-      jwk = r_jwks_get_at(jwks_subset, 0);
-      r_jwks_free(jwks_subset);
+      jwk = jwks_index->kty_default[GLEWLWYD_JWK_KTY_RSA];
     } else if (alg == R_JWA_ALG_ES256 || alg == R_JWA_ALG_ES384 || alg == R_JWA_ALG_ES512) {
-      jwks_subset = r_jwks_search_json_str(config->jwks_sign, "{\"kty\":\"EC\"}");
-      jwk = r_jwks_get_at(jwks_subset, 0);
-      r_jwks_free(jwks_subset);
+      jwk = jwks_index->kty_default[GLEWLWYD_JWK_KTY_EC];
     } else if (alg == R_JWA_ALG_EDDSA || alg == R_JWA_ALG_ES256K) {
-      jwks_subset = r_jwks_search_json_str(config->jwks_sign, "{\"kty\":\"OKP\"}");
-      jwk = r_jwks_get_at(jwks_subset, 0);
-      r_jwks_free(jwks_subset);
+      jwk = jwks_index->kty_default[GLEWLWYD_JWK_KTY_OKP];
     }
   }
   return jwk;
 }
 
+/**
+ * Entry of the client jwks_uri cache
+ * An entry is fresh until fresh_until, then it's still served until
+ * fresh_until + max_ttl while it's refreshed in the background
+ * jwks is NULL until the first download succeeds, while refreshing is set,
+ * the other requests for this uri wait for the download instead of starting one
+ * refresh_id identifies the download that has set refreshing, so a cancelled
+ * refresh job doesn't clear the flag of a download started since
+ * After a failed download, the next one is delayed until retry_at
+ */
+struct _jwks_uri_cache_entry {
+  char                         * uri;
+  jwks_t                       * jwks;
+  time_t                         fetched_at;
+  time_t                         fresh_until;
+  time_t                         retry_at;
+  unsigned int                   nb_failure;
+  unsigned short int             refreshing;
+  unsigned int                   refresh_id;
+  struct _jwks_uri_cache_entry * next;
+};
+
+/**
+ * Client jwks_uri cache, shared with the background refresh jobs,
+ * it's freed when the plugin is closed and the last job is done
+ */
+struct _jwks_uri_cache {
+  pthread_mutex_t                lock;
+  pthread_cond_t                 cond;
+  unsigned int                   refcount;
+  struct config_plugin         * glewlwyd_config;
+  char                         * plugin_name;
+  int                            check_server_certificate;
+  time_t                         min_ttl;
+  time_t                         max_ttl;
+  unsigned int                   refresh_counter;
+  struct _jwks_uri_cache_entry * bucket_list[GLEWLWYD_CLIENT_JWKS_CACHE_NB_BUCKET];
+};
+
+struct _jwks_uri_refresh {
+  struct _jwks_uri_cache * cache;
+  char                   * uri;
+  unsigned int             refresh_id;
+};
+
+static struct _jwks_uri_cache_entry ** jwks_uri_cache_get_bucket(struct _jwks_uri_cache * cache, const char * uri) {
+  uint64_t hash = 14695981039346656037U;
+  const unsigned char * p;
+
+  for (p = (const unsigned char *)uri; *p; p++) {
+    hash = (hash ^ *p) * 1099511628211U;
+  }
+  return &cache->bucket_list[hash % GLEWLWYD_CLIENT_JWKS_CACHE_NB_BUCKET];
+}
+
+static void jwks_uri_cache_free_entry(struct _jwks_uri_cache_entry * entry) {
+  o_free(entry->uri);
+  r_jwks_free(entry->jwks);
+  o_free(entry);
+}
+
+/**
+ * Returns the entry for this uri, entries that are too old to be served are removed
+ * cache->lock must be locked
+ */
+static struct _jwks_uri_cache_entry * jwks_uri_cache_find_entry(struct _jwks_uri_cache * cache, const char * uri, time_t now) {
+  struct _jwks_uri_cache_entry ** p_entry = jwks_uri_cache_get_bucket(cache, uri), * entry, * found = NULL;
+
+  while ((entry = *p_entry) != NULL) {
+    if (entry->fresh_until + cache->max_ttl <= now && !entry->refreshing) {
+      *p_entry = entry->next;
+      jwks_uri_cache_free_entry(entry);
+    } else {
+      if (0 == o_strcmp(entry->uri, uri)) {
+        found = entry;
+      }
+      p_entry = &entry->next;
+    }
+  }
+  return found;
+}
+
+/**
+ * Returns the entry for this uri, an empty entry is added if there's none
+ * cache->lock must be locked
+ */
+static struct _jwks_uri_cache_entry * jwks_uri_cache_get_entry(struct _jwks_uri_cache * cache, const char * uri, time_t now) {
+  struct _jwks_uri_cache_entry ** p_bucket, * entry;
+
+  if ((entry = jwks_uri_cache_find_entry(cache, uri, now)) == NULL) {
+    if ((entry = o_malloc(sizeof(struct _jwks_uri_cache_entry))) != NULL) {
+      p_bucket = jwks_uri_cache_get_bucket(cache, uri);
+      entry->uri = o_strdup(uri);
+      entry->jwks = NULL;
+      entry->fetched_at = 0;
+      entry->fresh_until = now;
+      entry->retry_at = 0;
+      entry->nb_failure = 0;
+      entry->refreshing = 0;
+      entry->refresh_id = 0;
+      entry->next = *p_bucket;
+      *p_bucket = entry;
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "jwks_uri_cache_get_entry - Error allocating resources for entry");
+    }
+  }
+  return entry;
+}
+
+/**
+ * Stores the result of a download of the jwks for this uri, jwks is stolen
+ * If jwks is NULL, the download has failed, the current jwks is kept
+ * and the next download is delayed, twice as long after each failure,
+ * up to min_ttl or GLEWLWYD_CLIENT_JWKS_CACHE_KID_INTERVAL if it's longer
+ * The requests waiting for this download are woken up
+ */
+static void jwks_uri_cache_store(struct _jwks_uri_cache * cache, const char * uri, jwks_t * jwks, time_t ttl) {
+  struct _jwks_uri_cache_entry * entry;
+  time_t now = time(NULL), delay;
+
+  if (!pthread_mutex_lock(&cache->lock)) {
+    if ((entry = jwks_uri_cache_get_entry(cache, uri, now)) != NULL) {
+      if (jwks != NULL) {
+        r_jwks_free(entry->jwks);
+        entry->jwks = jwks;
+        jwks = NULL;
+        entry->fetched_at = now;
+        entry->fresh_until = now + ttl;
+        entry->retry_at = 0;
+        entry->nb_failure = 0;
+      } else {
+        if (entry->nb_failure < 16) {
+          entry->nb_failure++;
+        }
+        delay = (time_t)1<<entry->nb_failure;
+        if (delay > cache->min_ttl && delay > GLEWLWYD_CLIENT_JWKS_CACHE_KID_INTERVAL) {
+          delay = cache->min_ttl>GLEWLWYD_CLIENT_JWKS_CACHE_KID_INTERVAL?cache->min_ttl:GLEWLWYD_CLIENT_JWKS_CACHE_KID_INTERVAL;
+        }
+        entry->retry_at = now + delay;
+        if (entry->jwks == NULL) {
+          entry->fresh_until = now;
+        }
+      }
+      entry->refreshing = 0;
+    }
+    pthread_cond_broadcast(&cache->cond);
+    pthread_mutex_unlock(&cache->lock);
+  }
+  r_jwks_free(jwks);
+}
+
+static void jwks_uri_cache_unref(struct _jwks_uri_cache * cache) {
+  struct _jwks_uri_cache_entry * entry;
+  unsigned int refcount = 1;
+  size_t i;
+
+  if (cache != NULL) {
+    if (!pthread_mutex_lock(&cache->lock)) {
+      refcount = --cache->refcount;
+      pthread_mutex_unlock(&cache->lock);
+    }
+    if (!refcount) {
+      for (i=0; i<GLEWLWYD_CLIENT_JWKS_CACHE_NB_BUCKET; i++) {
+        while ((entry = cache->bucket_list[i]) != NULL) {
+          cache->bucket_list[i] = entry->next;
+          jwks_uri_cache_free_entry(entry);
+        }
+      }
+      pthread_mutex_destroy(&cache->lock);
+      pthread_cond_destroy(&cache->cond);
+      o_free(cache->plugin_name);
+      o_free(cache);
+    }
+  }
+}
+
+static struct _jwks_uri_cache * jwks_uri_cache_new(struct _oidc_config * config, time_t min_ttl, time_t max_ttl) {
+  struct _jwks_uri_cache * cache;
+
+  if ((cache = o_malloc(sizeof(struct _jwks_uri_cache))) != NULL) {
+    memset(cache->bucket_list, 0, sizeof(cache->bucket_list));
+    cache->refcount = 1;
+    cache->refresh_counter = 0;
+    cache->glewlwyd_config = config->glewlwyd_config;
+    cache->plugin_name = o_strdup(config->name);
+    cache->check_server_certificate = json_object_get(config->j_params, "request-uri-allow-https-non-secure")==json_true()?0:1;
+    cache->min_ttl = min_ttl;
+    cache->max_ttl = max_ttl;
+    if (pthread_mutex_init(&cache->lock, NULL)) {
+      y_log_message(Y_LOG_LEVEL_ERROR, "jwks_uri_cache_new - Error pthread_mutex_init");
+      o_free(cache->plugin_name);
+      o_free(cache);
+      cache = NULL;
+    } else if (pthread_cond_init(&cache->cond, NULL)) {
+      y_log_message(Y_LOG_LEVEL_ERROR, "jwks_uri_cache_new - Error pthread_cond_init");
+      pthread_mutex_destroy(&cache->lock);
+      o_free(cache->plugin_name);
+      o_free(cache);
+      cache = NULL;
+    }
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "jwks_uri_cache_new - Error allocating resources for cache");
+  }
+  return cache;
+}
+
+/**
+ * Returns the time to live of a jwks response from its Cache-Control header,
+ * bounded by min_ttl and max_ttl
+ */
+static time_t jwks_uri_cache_get_ttl(struct _jwks_uri_cache * cache, const char * cache_control) {
+  const char * max_age;
+  long int l_max_age;
+  char * endptr = NULL;
+  time_t ttl = cache->min_ttl;
+
+  if (cache_control != NULL && o_strstr(cache_control, "no-store") == NULL && o_strstr(cache_control, "no-cache") == NULL) {
+    if ((max_age = o_strstr(cache_control, "max-age=")) != NULL) {
+      l_max_age = strtol(max_age+o_strlen("max-age="), &endptr, 10);
+      if (endptr != max_age+o_strlen("max-age=") && l_max_age > 0) {
+        ttl = (time_t)l_max_age;
+      }
+    }
+  }
+  if (ttl < cache->min_ttl) {
+    ttl = cache->min_ttl;
+  } else if (ttl > cache->max_ttl) {
+    ttl = cache->max_ttl;
+  }
+  return ttl;
+}
+
+/**
+ * Downloads the jwks at uri and stores it in the cache
+ * Returns a copy of the jwks, or NULL if the download failed
+ */
+static jwks_t * jwks_uri_cache_fetch(struct _jwks_uri_cache * cache, const char * uri) {
+  struct _u_request req;
+  struct _u_response resp;
+  struct timespec start, end;
+  json_t * j_jwks = NULL;
+  jwks_t * jwks = NULL, * jwks_return = NULL;
+  time_t ttl = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (ulfius_init_request(&req) == U_OK) {
+    if (ulfius_init_response(&resp) == U_OK) {
+      ulfius_set_request_properties(&req, U_OPT_HTTP_VERB, "GET",
+                                          U_OPT_HTTP_URL, uri,
+                                          U_OPT_FOLLOW_REDIRECT, 1,
+                                          U_OPT_CHECK_SERVER_CERTIFICATE, cache->check_server_certificate,
+                                          U_OPT_NONE);
+      if (ulfius_send_http_request(&req, &resp) == U_OK) {
+        if (resp.status == 200) {
+          if ((j_jwks = ulfius_get_json_body_response(&resp, NULL)) != NULL && r_jwks_init(&jwks) == RHN_OK && r_jwks_import_from_json_t(jwks, j_jwks) == RHN_OK) {
+            ttl = jwks_uri_cache_get_ttl(cache, u_map_get_case(resp.map_header, "Cache-Control"));
+          } else {
+            y_log_message(Y_LOG_LEVEL_ERROR, "jwks_uri_cache_fetch - Invalid jwks at %s", uri);
+            r_jwks_free(jwks);
+            jwks = NULL;
+          }
+          json_decref(j_jwks);
+        } else {
+          y_log_message(Y_LOG_LEVEL_ERROR, "jwks_uri_cache_fetch - Invalid response status for %s: %d", uri, resp.status);
+        }
+      } else {
+        y_log_message(Y_LOG_LEVEL_ERROR, "jwks_uri_cache_fetch - Error ulfius_send_http_request");
+      }
+      ulfius_clean_response(&resp);
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "jwks_uri_cache_fetch - Error ulfius_init_response");
+    }
+    ulfius_clean_request(&req);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "jwks_uri_cache_fetch - Error ulfius_init_request");
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  cache->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(cache->glewlwyd_config, GLWD_METRICS_OIDC_CLIENT_JWKS_REFRESH, 1, "plugin", cache->plugin_name, "result", jwks!=NULL?"ok":"error", NULL);
+  cache->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(cache->glewlwyd_config, GLWD_METRICS_OIDC_CLIENT_JWKS_REFRESH_DURATION, (size_t)((end.tv_sec - start.tv_sec)*1000 + (end.tv_nsec - start.tv_nsec)/1000000), "plugin", cache->plugin_name, NULL);
+  if (jwks != NULL) {
+    jwks_return = r_jwks_copy(jwks);
+  }
+  jwks_uri_cache_store(cache, uri, jwks, ttl);
+  return jwks_return;
+}
+
+/**
+ * Sets the refreshing flag of the entry for a new download and returns its id
+ * cache->lock must be locked
+ */
+static unsigned int jwks_uri_cache_set_refreshing(struct _jwks_uri_cache * cache, struct _jwks_uri_cache_entry * entry) {
+  entry->refreshing = 1;
+  entry->refresh_id = ++cache->refresh_counter;
+  return entry->refresh_id;
+}
+
+/**
+ * Frees a refresh job after it's run or cancelled
+ * The refreshing flag is cleared only if it was set for this job
+ */
+static void free_jwks_uri_refresh(void * args) {
+  struct _jwks_uri_refresh * refresh = (struct _jwks_uri_refresh *)args;
+  struct _jwks_uri_cache_entry * entry;
+
+  if (!pthread_mutex_lock(&refresh->cache->lock)) {
+    if ((entry = jwks_uri_cache_find_entry(refresh->cache, refresh->uri, time(NULL))) != NULL && entry->refresh_id == refresh->refresh_id) {
+      entry->refreshing = 0;
+    }
+    pthread_cond_broadcast(&refresh->cache->cond);
+    pthread_mutex_unlock(&refresh->cache->lock);
+  }
+  jwks_uri_cache_unref(refresh->cache);
+  o_free(refresh->uri);
+  o_free(refresh);
+}
+
+static void run_jwks_uri_refresh_job(void * args) {
+  struct _jwks_uri_refresh * refresh = (struct _jwks_uri_refresh *)args;
+
+  r_jwks_free(jwks_uri_cache_fetch(refresh->cache, refresh->uri));
+  free_jwks_uri_refresh(refresh);
+}
+
+/**
+ * Queues a refresh of the jwks at uri
+ * cache->lock must be locked
+ */
+static void jwks_uri_cache_submit_refresh(struct _oidc_config * config, struct _jwks_uri_cache_entry * entry) {
+  struct _jwks_uri_refresh * refresh;
+  char * job_key;
+
+  if ((refresh = o_malloc(sizeof(struct _jwks_uri_refresh))) != NULL) {
+    refresh->cache = config->jwks_uri_cache;
+    refresh->uri = o_strdup(entry->uri);
+    config->jwks_uri_cache->refcount++;
+    refresh->refresh_id = jwks_uri_cache_set_refreshing(config->jwks_uri_cache, entry);
+    job_key = msprintf("jwks_uri:%s", entry->uri);
+    pthread_mutex_unlock(&config->jwks_uri_cache->lock);
+    if (config->glewlwyd_config->glewlwyd_callback_job_submit(config->glewlwyd_config, GLEWLWYD_JOB_TYPE_NOTIFICATION, job_key, config, &run_jwks_uri_refresh_job, &free_jwks_uri_refresh, refresh) != G_OK) {
+      y_log_message(Y_LOG_LEVEL_DEBUG, "jwks_uri_cache_submit_refresh - Error glewlwyd_callback_job_submit");
+    }
+    pthread_mutex_lock(&config->jwks_uri_cache->lock);
+    o_free(job_key);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "jwks_uri_cache_submit_refresh - Error allocating resources for refresh");
+  }
+}
+
+/**
+ * Returns true if kid is set and isn't in the jwks
+ */
+static int jwks_uri_cache_is_kid_missing(jwks_t * jwks, const char * kid) {
+  jwk_t * jwk = NULL;
+  int ret = 0;
+
+  if (jwks != NULL && !o_strnullempty(kid)) {
+    jwk = r_jwks_get_by_kid(jwks, kid);
+    ret = (jwk == NULL);
+    r_jwk_free(jwk);
+  }
+  return ret;
+}
+
+/**
+ * Returns the jwks published by a client at jwks_uri
+ * The jwks is served from the cache if possible, a stale entry is served while
+ * it's refreshed in the background, a kid missing from the cached jwks
+ * forces a refresh, at most once every GLEWLWYD_CLIENT_JWKS_CACHE_KID_INTERVAL seconds
+ * Only one request downloads a jwks at a time, the other ones wait for the result
+ * Returned value must be freed after use
+ */
+static jwks_t * get_client_jwks_from_uri(struct _oidc_config * config, const char * uri, const char * kid) {
+  struct _jwks_uri_cache * cache = config->jwks_uri_cache;
+  struct _jwks_uri_cache_entry * entry = NULL;
+  jwks_t * jwks = NULL;
+  time_t now;
+  const char * result = "miss";
+  int kid_missing = 0, fetch = 0, wait;
+
+  if (cache == NULL) {
+    if (r_jwks_init(&jwks) != RHN_OK || r_jwks_import_from_uri(jwks, uri, config->x5u_flags) != RHN_OK) {
+      y_log_message(Y_LOG_LEVEL_ERROR, "get_client_jwks_from_uri - Error r_jwks_import_from_uri");
+      r_jwks_free(jwks);
+      jwks = NULL;
+    }
+  } else {
+    if (!pthread_mutex_lock(&cache->lock)) {
+      do {
+        now = time(NULL);
+        if ((entry = jwks_uri_cache_find_entry(cache, uri, now)) != NULL) {
+          kid_missing = jwks_uri_cache_is_kid_missing(entry->jwks, kid);
+        }
+        // A download of this jwks is running, its result is awaited if there's no jwks or the kid isn't in it
+        if ((wait = (entry != NULL && entry->refreshing && (entry->jwks == NULL || kid_missing)))) {
+          pthread_cond_wait(&cache->cond, &cache->lock);
+        }
+      } while (wait);
+      if (entry != NULL && entry->jwks != NULL) {
+        result = entry->fresh_until>now?"hit":"stale";
+        if (kid_missing && !entry->refreshing && now - entry->fetched_at >= GLEWLWYD_CLIENT_JWKS_CACHE_KID_INTERVAL && now >= entry->retry_at) {
+          y_log_message(Y_LOG_LEVEL_DEBUG, "get_client_jwks_from_uri - kid '%s' not found in cached jwks, refresh %s", kid, uri);
+          jwks_uri_cache_set_refreshing(cache, entry);
+          fetch = 1;
+        } else {
+          jwks = r_jwks_copy(entry->jwks);
+          if (entry->fresh_until <= now && !entry->refreshing && now >= entry->retry_at) {
+            jwks_uri_cache_submit_refresh(config, entry);
+          }
+        }
+      } else if (entry == NULL || now >= entry->retry_at) {
+        if ((entry = jwks_uri_cache_get_entry(cache, uri, now)) != NULL) {
+          jwks_uri_cache_set_refreshing(cache, entry);
+          fetch = 1;
+        }
+      } else {
+        y_log_message(Y_LOG_LEVEL_DEBUG, "get_client_jwks_from_uri - Last download of %s failed, next one in %" JSON_INTEGER_FORMAT " seconds", uri, (json_int_t)(entry->retry_at - now));
+      }
+      pthread_mutex_unlock(&cache->lock);
+    }
+    config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_OIDC_CLIENT_JWKS_CACHE, 1, "plugin", config->name, "result", result, NULL);
+    if (fetch) {
+      jwks = jwks_uri_cache_fetch(cache, uri);
+    }
+  }
+  return jwks;
+}
+
 static jwk_t * get_jwk_enc(struct _oidc_config * config, json_t * j_client, jwa_alg alg, jwa_enc enc) {
-  jwks_t * jwks_pub, * jwks_subset;
+  jwks_t * jwks_pub, * jwks_subset, * jwks_uri;
   jwk_t * jwk = NULL, * jwk_import = NULL;
   const char * alg_kid_p = json_string_value(json_object_get(config->j_params, "client-alg_kid-parameter"));
   unsigned char key[64] = {0};
-  size_t key_len = 64;
+  size_t key_len = 64, i;
 
   if (r_jwks_init(&jwks_pub) == RHN_OK) {
     if (!json_string_null_or_empty(json_object_get(j_client, json_string_value(json_object_get(config->j_params, "client-pubkey-parameter"))))) {
@@ -2339,8 +2993,15 @@ static jwk_t * get_jwk_enc(struct _oidc_config * config, json_t * j_client, jwa_
       }
     }
     if (!json_string_null_or_empty(json_object_get(j_client, json_string_value(json_object_get(config->j_params, "client-jwks_uri-parameter"))))) {
-      if (r_jwks_import_from_uri(jwks_pub, json_string_value(json_object_get(j_client, json_string_value(json_object_get(config->j_params, "client-jwks_uri-parameter")))), config->x5u_flags) != RHN_OK) {
-        y_log_message(Y_LOG_LEVEL_ERROR, "get_jwk_enc - Error r_jwks_import_from_uri");
+      if ((jwks_uri = get_client_jwks_from_uri(config, json_string_value(json_object_get(j_client, json_string_value(json_object_get(config->j_params, "client-jwks_uri-parameter")))), json_string_value(json_object_get(j_client, alg_kid_p)))) != NULL) {
+        for (i=0; i<r_jwks_size(jwks_uri); i++) {
+          jwk_import = r_jwks_get_at(jwks_uri, i);
+          r_jwks_append_jwk(jwks_pub, jwk_import);
+          r_jwk_free(jwk_import);
+        }
+        r_jwks_free(jwks_uri);
+      } else {
+        y_log_message(Y_LOG_LEVEL_ERROR, "get_jwk_enc - Error get_client_jwks_from_uri");
       }
     }
     if (!json_string_null_or_empty(json_object_get(j_client, alg_kid_p))) {
@@ -2592,7 +3253,6 @@ static char * generate_client_access_token(struct _oidc_config * config,
   } else {
     y_log_message(Y_LOG_LEVEL_ERROR, "generate_client_access_token - oidc - Error no jwk available");
   }
-  r_jwk_free(jwk);
   return token;
 }
 
@@ -2926,6 +3586,7 @@ static json_t * get_userinfo(struct _oidc_config * config, const char * sub, jso
  * Return the id_token_hash of the last id_token provided to the client for the user
  */
 static json_t * get_last_id_token(struct _oidc_config * config, const char * username, const char * client_id) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result = NULL, * j_return;
   int res;
 
@@ -2934,7 +3595,7 @@ static json_t * get_last_id_token(struct _oidc_config * config, const char * use
                       GLEWLWYD_PLUGIN_OIDC_TABLE_ID_TOKEN,
                       "columns",
                         "gpoi_authorization_type AS authorization_type",
-                        SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpoi_issued_at) AS issued_at", "gpoi_issued_at AS issued_at", "EXTRACT(EPOCH FROM gpoi_issued_at)::integer AS issued_at"),
+                        SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpoi_issued_at) AS issued_at", "gpoi_issued_at AS issued_at", "EXTRACT(EPOCH FROM gpoi_issued_at)::integer AS issued_at"),
                         "gpoi_hash AS token_hash",
                       "where",
                         "gpoi_plugin_name",
@@ -2947,7 +3608,7 @@ static json_t * get_last_id_token(struct _oidc_config * config, const char * use
                       "gpoi_id DESC",
                       "limit",
                       1);
-  res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result)) {
@@ -2961,6 +3622,7 @@ static json_t * get_last_id_token(struct _oidc_config * config, const char * use
     config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
@@ -3009,6 +3671,7 @@ static int serialize_pushed_request_uri(struct _oidc_config * config,
                                         const char * code_challenge,
                                         json_t * j_authorization_details,
                                         struct _u_map * additional_parameters) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_last_id, * j_additional_parameters = NULL;
   int ret, res, i;
   char * request_uri_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, request_uri),
@@ -3023,92 +3686,88 @@ static int serialize_pushed_request_uri(struct _oidc_config * config,
   time(&now);
   if (request_uri_hash != NULL) {
     if (split_string(scope_list, " ", &scope_array)) {
-      if (pthread_mutex_lock(&config->insert_lock)) {
-        y_log_message(Y_LOG_LEVEL_ERROR, "serialize_pushed_request_uri oidc - Error pthread_mutex_lock");
-        ret = G_ERROR;
-      } else {
-        if (j_claims != NULL) {
-          str_claims_request = json_dumps(j_claims, JSON_COMPACT);
-        }
-        if (j_authorization_details != NULL) {
-          str_authorization_details = json_dumps(j_authorization_details, JSON_COMPACT);
-        }
-        if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
-          expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)config->request_uri_duration));
-        } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
-          expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)config->request_uri_duration ));
-        } else { // HOEL_DB_TYPE_SQLITE
-          expires_at_clause = msprintf("%u", (now + (time_t)config->request_uri_duration));
-        }
-        if (u_map_count(additional_parameters)) {
-          if ((j_additional_parameters = json_object()) != NULL) {
-            keys = u_map_enum_keys(additional_parameters);
-            for (i=0; keys[i]!=NULL; i++) {
-              json_object_set_new(j_additional_parameters, keys[i], json_string(u_map_get(additional_parameters, keys[i])));
-            }
-            str_additional_parameters = json_dumps(j_additional_parameters, JSON_COMPACT);
-          } else {
-            y_log_message(Y_LOG_LEVEL_ERROR, "serialize_pushed_request_uri oidc - Error allocating resources for j_additional_parameters");
+      if (j_claims != NULL) {
+        str_claims_request = json_dumps(j_claims, JSON_COMPACT);
+      }
+      if (j_authorization_details != NULL) {
+        str_authorization_details = json_dumps(j_authorization_details, JSON_COMPACT);
+      }
+      if (conn->type==HOEL_DB_TYPE_MARIADB) {
+        expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)config->request_uri_duration));
+      } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
+        expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)config->request_uri_duration ));
+      } else { // HOEL_DB_TYPE_SQLITE
+        expires_at_clause = msprintf("%u", (now + (time_t)config->request_uri_duration));
+      }
+      if (u_map_count(additional_parameters)) {
+        if ((j_additional_parameters = json_object()) != NULL) {
+          keys = u_map_enum_keys(additional_parameters);
+          for (i=0; keys[i]!=NULL; i++) {
+            json_object_set_new(j_additional_parameters, keys[i], json_string(u_map_get(additional_parameters, keys[i])));
           }
-          json_decref(j_additional_parameters);
+          str_additional_parameters = json_dumps(j_additional_parameters, JSON_COMPACT);
+        } else {
+          y_log_message(Y_LOG_LEVEL_ERROR, "serialize_pushed_request_uri oidc - Error allocating resources for j_additional_parameters");
         }
-        j_query = json_pack("{sss{ss ss ss* ss ss ss ss* ss* ss* ss* ss* ss* ss* s{ss} ss ss*}}",
-                            "table",
-                            GLEWLWYD_PLUGIN_OIDC_TABLE_PAR,
-                            "values",
-                              "gpop_plugin_name", config->name,
-                              "gpop_response_type", response_type,
-                              "gpop_state", state,
-                              "gpop_client_id", client_id,
-                              "gpop_redirect_uri", redirect_uri,
-                              "gpop_request_uri_hash", request_uri_hash,
-                              "gpop_nonce", nonce,
-                              "gpop_code_challenge", code_challenge,
-                              "gpop_resource", resource,
-                              "gpop_dpop_jkt", dpop_jkt,
-                              "gpop_claims_request", str_claims_request,
-                              "gpop_authorization_details", str_authorization_details,
-                              "gpop_additional_parameters", str_additional_parameters,
-                              "gpop_expires_at",
-                                "raw",
-                                expires_at_clause,
-                              "gpop_issued_for", issued_for,
-                              "gpop_user_agent", user_agent);
-        o_free(expires_at_clause);
-        o_free(str_claims_request);
-        o_free(str_authorization_details);
-        o_free(str_additional_parameters);
-        res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
-        json_decref(j_query);
-        if (res == H_OK) {
-          if ((j_last_id = h_last_insert_id(config->glewlwyd_config->glewlwyd_config->conn)) != NULL) {
-            config->glewlwyd_config->glewlwyd_callback_update_issued_for(config->glewlwyd_config, NULL, GLEWLWYD_PLUGIN_OIDC_TABLE_PAR, "gpop_issued_for", issued_for, "gpop_id", json_integer_value(j_last_id));
-            j_query = json_pack("{sss[]}", "table", GLEWLWYD_PLUGIN_OIDC_TABLE_PAR_SCOPE, "values");
-            for (i=0; scope_array[i]!= NULL; i++) {
-              json_array_append_new(json_object_get(j_query, "values"), json_pack("{sOss}", "gpop_id", j_last_id, "gpops_scope", scope_array[i]));
-            }
-            res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
-            json_decref(j_query);
-            if (res == H_OK) {
-              ret = G_OK;
-            } else {
-              y_log_message(Y_LOG_LEVEL_ERROR, "serialize_pushed_request_uri oidc - Error executing j_query (2)");
-              config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
-              ret = G_ERROR_DB;
-            }
+        json_decref(j_additional_parameters);
+      }
+      j_query = json_pack("{sss{ss ss ss* ss ss ss ss* ss* ss* ss* ss* ss* ss* s{ss} ss ss*}}",
+                          "table",
+                          GLEWLWYD_PLUGIN_OIDC_TABLE_PAR,
+                          "values",
+                            "gpop_plugin_name", config->name,
+                            "gpop_response_type", response_type,
+                            "gpop_state", state,
+                            "gpop_client_id", client_id,
+                            "gpop_redirect_uri", redirect_uri,
+                            "gpop_request_uri_hash", request_uri_hash,
+                            "gpop_nonce", nonce,
+                            "gpop_code_challenge", code_challenge,
+                            "gpop_resource", resource,
+                            "gpop_dpop_jkt", dpop_jkt,
+                            "gpop_claims_request", str_claims_request,
+                            "gpop_authorization_details", str_authorization_details,
+                            "gpop_additional_parameters", str_additional_parameters,
+                            "gpop_expires_at",
+                              "raw",
+                              expires_at_clause,
+                            "gpop_issued_for", issued_for,
+                            "gpop_user_agent", user_agent);
+      o_free(expires_at_clause);
+      o_free(str_claims_request);
+      o_free(str_authorization_details);
+      o_free(str_additional_parameters);
+      config->glewlwyd_config->glewlwyd_callback_db_insert_begin(config->glewlwyd_config, conn);
+      res = config->glewlwyd_config->glewlwyd_callback_db_insert(config->glewlwyd_config, conn, j_query, "gpop_id", &j_last_id);
+      json_decref(j_query);
+      if (res == H_OK) {
+        if (j_last_id != NULL) {
+          config->glewlwyd_config->glewlwyd_callback_update_issued_for(config->glewlwyd_config, NULL, GLEWLWYD_PLUGIN_OIDC_TABLE_PAR, "gpop_issued_for", issued_for, "gpop_id", json_integer_value(j_last_id));
+          j_query = json_pack("{sss[]}", "table", GLEWLWYD_PLUGIN_OIDC_TABLE_PAR_SCOPE, "values");
+          for (i=0; scope_array[i]!= NULL; i++) {
+            json_array_append_new(json_object_get(j_query, "values"), json_pack("{sOss}", "gpop_id", j_last_id, "gpops_scope", scope_array[i]));
+          }
+          res = h_insert(conn, j_query, NULL);
+          json_decref(j_query);
+          if (res == H_OK) {
+            ret = G_OK;
           } else {
-            y_log_message(Y_LOG_LEVEL_ERROR, "serialize_pushed_request_uri oidc - Error h_last_insert_id");
+            y_log_message(Y_LOG_LEVEL_ERROR, "serialize_pushed_request_uri oidc - Error executing j_query (2)");
             config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
             ret = G_ERROR_DB;
           }
-          json_decref(j_last_id);
         } else {
-          y_log_message(Y_LOG_LEVEL_ERROR, "serialize_pushed_request_uri oidc - Error executing j_query (1)");
+          y_log_message(Y_LOG_LEVEL_ERROR, "serialize_pushed_request_uri oidc - Error h_last_insert_id");
           config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
           ret = G_ERROR_DB;
         }
-        pthread_mutex_unlock(&config->insert_lock);
+        json_decref(j_last_id);
+      } else {
+        y_log_message(Y_LOG_LEVEL_ERROR, "serialize_pushed_request_uri oidc - Error executing j_query (1)");
+        config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+        ret = G_ERROR_DB;
       }
+      config->glewlwyd_config->glewlwyd_callback_db_insert_end(config->glewlwyd_config, conn);
       free_string_array(scope_array);
     } else {
       y_log_message(Y_LOG_LEVEL_ERROR, "serialize_pushed_request_uri oidc - Error split_string");
@@ -3119,6 +3778,7 @@ static int serialize_pushed_request_uri(struct _oidc_config * config,
     y_log_message(Y_LOG_LEVEL_ERROR, "serialize_pushed_request_uri oidc - Error glewlwyd_callback_generate_hash");
     ret = G_ERROR;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
@@ -3151,73 +3811,69 @@ static int serialize_id_token(struct _oidc_config * config,
                               time_t now,
                               const char * issued_for,
                               const char * user_agent) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_last_id;
   int res, ret;
   char * issued_at_clause, * id_token_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, id_token);
 
-  if (pthread_mutex_lock(&config->insert_lock)) {
-    y_log_message(Y_LOG_LEVEL_ERROR, "oidc serialize_id_token - Error pthread_mutex_lock");
-    ret = G_ERROR;
-  } else {
-    if (issued_for != NULL && now > 0 && id_token_hash != NULL) {
-      if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
-        issued_at_clause = msprintf("FROM_UNIXTIME(%u)", (now));
-      } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
-        issued_at_clause = msprintf("TO_TIMESTAMP(%u)", (now));
-      } else { // HOEL_DB_TYPE_SQLITE
-        issued_at_clause = msprintf("%u", (now));
-      }
-      j_query = json_pack("{sss{sssisosos{ss}ssssssss*soso}}",
-                          "table",
-                          GLEWLWYD_PLUGIN_OIDC_TABLE_ID_TOKEN,
-                          "values",
-                            "gpoi_plugin_name",
-                            config->name,
-                            "gpoi_authorization_type",
-                            auth_type,
-                            "gpoi_username",
-                            username!=NULL?json_string(username):json_null(),
-                            "gpoi_client_id",
-                            client_id!=NULL?json_string(client_id):json_null(),
-                            "gpoi_issued_at",
-                              "raw",
-                              issued_at_clause,
-                            "gpoi_issued_for",
-                            issued_for,
-                            "gpoi_user_agent",
-                            user_agent!=NULL?user_agent:"",
-                            "gpoi_hash",
-                            id_token_hash,
-                            "gpoi_sid",
-                            sid,
-                            "gpoc_id",
-                            gpoc_id?json_integer(gpoc_id):json_null(),
-                            "gpor_id",
-                            gpor_id?json_integer(gpor_id):json_null());
-      o_free(issued_at_clause);
-      res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
-      json_decref(j_query);
-      if (res == H_OK) {
-        if ((j_last_id = h_last_insert_id(config->glewlwyd_config->glewlwyd_config->conn)) != NULL) {
-          config->glewlwyd_config->glewlwyd_callback_update_issued_for(config->glewlwyd_config, NULL, GLEWLWYD_PLUGIN_OIDC_TABLE_ID_TOKEN, "gpoi_issued_for", issued_for, "gpoi_id", json_integer_value(j_last_id));
-          ret = G_OK;
-        } else {
-          y_log_message(Y_LOG_LEVEL_ERROR, "oidc serialize_id_token - Error h_last_insert_id");
-          config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
-          ret = G_ERROR_DB;
-        }
-        json_decref(j_last_id);
+  if (issued_for != NULL && now > 0 && id_token_hash != NULL) {
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
+      issued_at_clause = msprintf("FROM_UNIXTIME(%u)", (now));
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
+      issued_at_clause = msprintf("TO_TIMESTAMP(%u)", (now));
+    } else { // HOEL_DB_TYPE_SQLITE
+      issued_at_clause = msprintf("%u", (now));
+    }
+    j_query = json_pack("{sss{sssisosos{ss}ssssssss*soso}}",
+                        "table",
+                        GLEWLWYD_PLUGIN_OIDC_TABLE_ID_TOKEN,
+                        "values",
+                          "gpoi_plugin_name",
+                          config->name,
+                          "gpoi_authorization_type",
+                          auth_type,
+                          "gpoi_username",
+                          username!=NULL?json_string(username):json_null(),
+                          "gpoi_client_id",
+                          client_id!=NULL?json_string(client_id):json_null(),
+                          "gpoi_issued_at",
+                            "raw",
+                            issued_at_clause,
+                          "gpoi_issued_for",
+                          issued_for,
+                          "gpoi_user_agent",
+                          user_agent!=NULL?user_agent:"",
+                          "gpoi_hash",
+                          id_token_hash,
+                          "gpoi_sid",
+                          sid,
+                          "gpoc_id",
+                          gpoc_id?json_integer(gpoc_id):json_null(),
+                          "gpor_id",
+                          gpor_id?json_integer(gpor_id):json_null());
+    o_free(issued_at_clause);
+    res = config->glewlwyd_config->glewlwyd_callback_db_insert(config->glewlwyd_config, conn, j_query, "gpoi_id", &j_last_id);
+    json_decref(j_query);
+    if (res == H_OK) {
+      if (j_last_id != NULL) {
+        config->glewlwyd_config->glewlwyd_callback_update_issued_for(config->glewlwyd_config, NULL, GLEWLWYD_PLUGIN_OIDC_TABLE_ID_TOKEN, "gpoi_issued_for", issued_for, "gpoi_id", json_integer_value(j_last_id));
+        ret = G_OK;
       } else {
-        y_log_message(Y_LOG_LEVEL_ERROR, "oidc serialize_id_token - Error executing j_query");
+        y_log_message(Y_LOG_LEVEL_ERROR, "oidc serialize_id_token - Error h_last_insert_id");
         config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
         ret = G_ERROR_DB;
       }
+      json_decref(j_last_id);
     } else {
-      ret = G_ERROR_PARAM;
+      y_log_message(Y_LOG_LEVEL_ERROR, "oidc serialize_id_token - Error executing j_query");
+      config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+      ret = G_ERROR_DB;
     }
-    pthread_mutex_unlock(&config->insert_lock);
-    o_free(id_token_hash);
+  } else {
+    ret = G_ERROR_PARAM;
   }
+  o_free(id_token_hash);
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
@@ -3366,7 +4022,6 @@ static char * generate_id_token(struct _oidc_config * config,
   } else {
     y_log_message(Y_LOG_LEVEL_ERROR, "generate_id_token - oidc - Error no sign jwk available");
   }
-  r_jwk_free(jwk);
   o_free(sub);
   return token;
 }
@@ -3387,111 +4042,108 @@ static int serialize_access_token(struct _oidc_config * config,
                                   const char * access_token,
                                   const char * jti,
                                   json_t * j_authorization_details) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_last_id;
   int res, ret, i;
   char * issued_at_clause, ** scope_array = NULL, * access_token_hash = NULL, * str_authorization_details = NULL;
 
-  if (pthread_mutex_lock(&config->insert_lock)) {
-    y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oidc - Error pthread_mutex_lock");
-    ret = G_ERROR;
-  } else {
-    if ((access_token_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, access_token)) != NULL) {
-      if (issued_for != NULL && now > 0) {
-        if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
-          issued_at_clause = msprintf("FROM_UNIXTIME(%u)", (now));
-        } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
-          issued_at_clause = msprintf("TO_TIMESTAMP(%u)", (now));
-        } else { // HOEL_DB_TYPE_SQLITE
-          issued_at_clause = msprintf("%u", (now));
-        }
-        if (j_authorization_details != NULL) {
-          str_authorization_details = json_dumps(j_authorization_details, JSON_COMPACT);
-        }
-        j_query = json_pack("{sss{sssisososos{ss}ssssssss#ss?ss?}}",
-                            "table",
-                            GLEWLWYD_PLUGIN_OIDC_TABLE_ACCESS_TOKEN,
-                            "values",
-                              "gpoa_plugin_name",
-                              config->name,
-                              "gpoa_authorization_type",
-                              auth_type,
-                              "gpor_id",
-                              gpor_id?json_integer(gpor_id):json_null(),
-                              "gpoa_username",
-                              username!=NULL?json_string(username):json_null(),
-                              "gpoa_client_id",
-                              client_id!=NULL?json_string(client_id):json_null(),
-                              "gpoa_issued_at",
-                                "raw",
-                                issued_at_clause,
-                              "gpoa_issued_for",
-                              issued_for,
-                              "gpoa_user_agent",
-                              user_agent!=NULL?user_agent:"",
-                              "gpoa_token_hash",
-                              access_token_hash,
-                              "gpoa_jti",
-                              jti, OIDC_JTI_LENGTH,
-                              "gpoa_resource",
-                              resource,
-                              "gpoa_authorization_details",
-                              str_authorization_details);
-        o_free(issued_at_clause);
-        o_free(str_authorization_details);
-        res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
-        json_decref(j_query);
-        if (res == H_OK) {
-          j_last_id = h_last_insert_id(config->glewlwyd_config->glewlwyd_config->conn);
-          if (j_last_id != NULL) {
-            config->glewlwyd_config->glewlwyd_callback_update_issued_for(config->glewlwyd_config, NULL, GLEWLWYD_PLUGIN_OIDC_TABLE_ACCESS_TOKEN, "gpoa_issued_for", issued_for, "gpoa_id", json_integer_value(j_last_id));
-            if (split_string(scope_list, " ", &scope_array) > 0) {
-              j_query = json_pack("{sss[]}",
-                                  "table",
-                                  GLEWLWYD_PLUGIN_OIDC_TABLE_ACCESS_TOKEN_SCOPE,
-                                  "values");
-              if (j_query != NULL) {
-                for (i=0; scope_array[i] != NULL; i++) {
-                  json_array_append_new(json_object_get(j_query, "values"), json_pack("{sOss}", "gpoa_id", j_last_id, "gpoas_scope", scope_array[i]));
-                }
-                res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
-                json_decref(j_query);
-                if (res == H_OK) {
-                  ret = G_OK;
-                } else {
-                  y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oidc - Error executing j_query (2)");
-                  config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
-                  ret = G_ERROR_DB;
-                }
+  if ((access_token_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, access_token)) != NULL) {
+    if (issued_for != NULL && now > 0) {
+      if (conn->type==HOEL_DB_TYPE_MARIADB) {
+        issued_at_clause = msprintf("FROM_UNIXTIME(%u)", (now));
+      } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
+        issued_at_clause = msprintf("TO_TIMESTAMP(%u)", (now));
+      } else { // HOEL_DB_TYPE_SQLITE
+        issued_at_clause = msprintf("%u", (now));
+      }
+      if (j_authorization_details != NULL) {
+        str_authorization_details = json_dumps(j_authorization_details, JSON_COMPACT);
+      }
+      j_query = json_pack("{sss{sssisososos{ss}ssssssss#ss?ss?}}",
+                          "table",
+                          GLEWLWYD_PLUGIN_OIDC_TABLE_ACCESS_TOKEN,
+                          "values",
+                            "gpoa_plugin_name",
+                            config->name,
+                            "gpoa_authorization_type",
+                            auth_type,
+                            "gpor_id",
+                            gpor_id?json_integer(gpor_id):json_null(),
+                            "gpoa_username",
+                            username!=NULL?json_string(username):json_null(),
+                            "gpoa_client_id",
+                            client_id!=NULL?json_string(client_id):json_null(),
+                            "gpoa_issued_at",
+                              "raw",
+                              issued_at_clause,
+                            "gpoa_issued_for",
+                            issued_for,
+                            "gpoa_user_agent",
+                            user_agent!=NULL?user_agent:"",
+                            "gpoa_token_hash",
+                            access_token_hash,
+                            "gpoa_jti",
+                            jti, OIDC_JTI_LENGTH,
+                            "gpoa_resource",
+                            resource,
+                            "gpoa_authorization_details",
+                            str_authorization_details);
+      o_free(issued_at_clause);
+      o_free(str_authorization_details);
+      config->glewlwyd_config->glewlwyd_callback_db_insert_begin(config->glewlwyd_config, conn);
+      res = config->glewlwyd_config->glewlwyd_callback_db_insert(config->glewlwyd_config, conn, j_query, "gpoa_id", &j_last_id);
+      json_decref(j_query);
+      if (res == H_OK) {
+        if (j_last_id != NULL) {
+          config->glewlwyd_config->glewlwyd_callback_update_issued_for(config->glewlwyd_config, NULL, GLEWLWYD_PLUGIN_OIDC_TABLE_ACCESS_TOKEN, "gpoa_issued_for", issued_for, "gpoa_id", json_integer_value(j_last_id));
+          if (split_string(scope_list, " ", &scope_array) > 0) {
+            j_query = json_pack("{sss[]}",
+                                "table",
+                                GLEWLWYD_PLUGIN_OIDC_TABLE_ACCESS_TOKEN_SCOPE,
+                                "values");
+            if (j_query != NULL) {
+              for (i=0; scope_array[i] != NULL; i++) {
+                json_array_append_new(json_object_get(j_query, "values"), json_pack("{sOss}", "gpoa_id", j_last_id, "gpoas_scope", scope_array[i]));
+              }
+              res = h_insert(conn, j_query, NULL);
+              json_decref(j_query);
+              if (res == H_OK) {
+                ret = G_OK;
               } else {
-                y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oidc - Error json_pack");
-                ret = G_ERROR;
+                y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oidc - Error executing j_query (2)");
+                config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+                ret = G_ERROR_DB;
               }
             } else {
-              y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oidc - Error split_string");
+              y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oidc - Error json_pack");
               ret = G_ERROR;
             }
-            free_string_array(scope_array);
           } else {
-            y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oidc - Error h_last_insert_id");
-            config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
-            ret = G_ERROR_DB;
+            y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oidc - Error split_string");
+            ret = G_ERROR;
           }
-          json_decref(j_last_id);
+          free_string_array(scope_array);
         } else {
-          y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oidc - Error executing j_query (1)");
+          y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oidc - Error h_last_insert_id");
           config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
           ret = G_ERROR_DB;
         }
+        json_decref(j_last_id);
       } else {
-        ret = G_ERROR_PARAM;
+        y_log_message(Y_LOG_LEVEL_ERROR, "serialize_access_token - oidc - Error executing j_query (1)");
+        config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+        ret = G_ERROR_DB;
       }
-      o_free(access_token_hash);
+      config->glewlwyd_config->glewlwyd_callback_db_insert_end(config->glewlwyd_config, conn);
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "oidc serialize_access_token - Error glewlwyd_callback_generate_hash");
-      ret = G_ERROR;
+      ret = G_ERROR_PARAM;
     }
-    pthread_mutex_unlock(&config->insert_lock);
+    o_free(access_token_hash);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "oidc serialize_access_token - Error glewlwyd_callback_generate_hash");
+    ret = G_ERROR;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
@@ -3605,7 +4257,6 @@ static char * generate_access_token(struct _oidc_config * config,
     y_log_message(Y_LOG_LEVEL_ERROR, "generate_access_token - oidc - Error no jwk available");
   }
   o_free(sub);
-  r_jwk_free(jwk);
   return token;
 }
 
@@ -3629,141 +4280,138 @@ static json_t * serialize_refresh_token(struct _oidc_config * config,
                                         char * jti,
                                         const char * dpop_jkt,
                                         json_t * j_authorization_details) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   char * token_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, token);
   json_t * j_query, * j_return, * j_last_id;
   int res, i;
   char * issued_at_clause, * expires_at_clause, * last_seen_clause, ** scope_array = NULL, * str_claims_request = NULL, * str_authorization_details = NULL;
 
-  if (pthread_mutex_lock(&config->insert_lock)) {
-    y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oidc - Error pthread_mutex_lock");
-    j_return = json_pack("{si}", "result", G_ERROR);
-  } else {
-    if (token_hash != NULL && username != NULL && issued_for != NULL && now > 0 && duration > 0) {
-      json_error_t error;
-      if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
-        issued_at_clause = msprintf("FROM_UNIXTIME(%u)", (now));
-      } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
-        issued_at_clause = msprintf("TO_TIMESTAMP(%u)", (now));
-      } else { // HOEL_DB_TYPE_SQLITE
-        issued_at_clause = msprintf("%u", (now));
-      }
-      if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
-        last_seen_clause = msprintf("FROM_UNIXTIME(%u)", (now));
-      } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
-        last_seen_clause = msprintf("TO_TIMESTAMP(%u)", (now));
-      } else { // HOEL_DB_TYPE_SQLITE
-        last_seen_clause = msprintf("%u", (now));
-      }
-      if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
-        expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)duration));
-      } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
-        expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)duration ));
-      } else { // HOEL_DB_TYPE_SQLITE
-        expires_at_clause = msprintf("%u", (now + (time_t)duration));
-      }
-      if (j_claims_request != NULL) {
-        if ((str_claims_request = json_dumps(j_claims_request, JSON_COMPACT)) == NULL) {
-          y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oidc - Error dumping JSON claims request");
-        }
-      }
-      if (j_authorization_details != NULL) {
-        str_authorization_details = json_dumps(j_authorization_details, JSON_COMPACT);
-      }
-      j_query = json_pack_ex(&error, 0, "{sss{ss si so ss so s{ss} s{ss} s{ss} sI si ss ss ss ss ss? ss? ss?}}",
-                          "table", GLEWLWYD_PLUGIN_OIDC_TABLE_REFRESH_TOKEN,
-                          "values",
-                            "gpor_plugin_name", config->name,
-                            "gpor_authorization_type", auth_type,
-                            "gpoc_id", gpoc_id?json_integer(gpoc_id):json_null(),
-                            "gpor_username", username,
-                            "gpor_client_id", client_id!=NULL?json_string(client_id):json_null(),
-                            "gpor_issued_at",
-                              "raw",
-                              issued_at_clause,
-                            "gpor_last_seen",
-                              "raw",
-                              last_seen_clause,
-                            "gpor_expires_at",
-                              "raw",
-                              expires_at_clause,
-                            "gpor_duration", duration,
-                            "gpor_rolling_expiration", rolling,
-                            "gpor_claims_request", str_claims_request!=NULL?str_claims_request:"",
-                            "gpor_token_hash", token_hash,
-                            "gpor_issued_for", issued_for,
-                            "gpor_user_agent", user_agent!=NULL?user_agent:"",
-                            "gpor_resource", resource,
-                            "gpor_dpop_jkt", dpop_jkt,
-                            "gpor_authorization_details", str_authorization_details);
-      res = G_OK;
-      if (config->refresh_token_one_use) {
-        if (o_strnullempty(jti)) {
-          if (rand_string_nonce(jti, OIDC_JTI_LENGTH) == NULL) {
-            y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oidc - Error rand_string_nonce");
-            res = G_ERROR;
-          }
-        }
-        json_object_set_new(json_object_get(j_query, "values"), "gpor_jti", json_string(jti));
+  if (token_hash != NULL && username != NULL && issued_for != NULL && now > 0 && duration > 0) {
+    json_error_t error;
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
+      issued_at_clause = msprintf("FROM_UNIXTIME(%u)", (now));
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
+      issued_at_clause = msprintf("TO_TIMESTAMP(%u)", (now));
+    } else { // HOEL_DB_TYPE_SQLITE
+      issued_at_clause = msprintf("%u", (now));
+    }
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
+      last_seen_clause = msprintf("FROM_UNIXTIME(%u)", (now));
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
+      last_seen_clause = msprintf("TO_TIMESTAMP(%u)", (now));
+    } else { // HOEL_DB_TYPE_SQLITE
+      last_seen_clause = msprintf("%u", (now));
+    }
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
+      expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)duration));
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
+      expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)duration ));
+    } else { // HOEL_DB_TYPE_SQLITE
+      expires_at_clause = msprintf("%u", (now + (time_t)duration));
+    }
+    if (j_claims_request != NULL) {
+      if ((str_claims_request = json_dumps(j_claims_request, JSON_COMPACT)) == NULL) {
+        y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oidc - Error dumping JSON claims request");
       }
-      o_free(issued_at_clause);
-      o_free(expires_at_clause);
-      o_free(last_seen_clause);
-      o_free(str_claims_request);
-      o_free(str_authorization_details);
-      if (res == G_OK) {
-        res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
-        json_decref(j_query);
-        if (res == H_OK) {
-          j_last_id = h_last_insert_id(config->glewlwyd_config->glewlwyd_config->conn);
-          if (j_last_id != NULL) {
-            config->glewlwyd_config->glewlwyd_callback_update_issued_for(config->glewlwyd_config, NULL, GLEWLWYD_PLUGIN_OIDC_TABLE_REFRESH_TOKEN, "gpor_issued_for", issued_for, "gpor_id", json_integer_value(j_last_id));
-            if (split_string(scope_list, " ", &scope_array) > 0) {
-              j_query = json_pack("{sss[]}",
-                                  "table",
-                                  GLEWLWYD_PLUGIN_OIDC_TABLE_REFRESH_TOKEN_SCOPE,
-                                  "values");
-              if (j_query != NULL) {
-                for (i=0; scope_array[i] != NULL; i++) {
-                  json_array_append_new(json_object_get(j_query, "values"), json_pack("{sOss}", "gpor_id", j_last_id, "gpors_scope", scope_array[i]));
-                }
-                res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
-                json_decref(j_query);
-                if (res == H_OK) {
-                  j_return = json_pack("{sisO}", "result", G_OK, "gpor_id", j_last_id);
-                } else {
-                  y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oidc - Error executing j_query (2)");
-                  config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
-                  j_return = json_pack("{si}", "result", G_ERROR_DB);
-                }
+    }
+    if (j_authorization_details != NULL) {
+      str_authorization_details = json_dumps(j_authorization_details, JSON_COMPACT);
+    }
+    j_query = json_pack_ex(&error, 0, "{sss{ss si so ss so s{ss} s{ss} s{ss} sI si ss ss ss ss ss? ss? ss?}}",
+                        "table", GLEWLWYD_PLUGIN_OIDC_TABLE_REFRESH_TOKEN,
+                        "values",
+                          "gpor_plugin_name", config->name,
+                          "gpor_authorization_type", auth_type,
+                          "gpoc_id", gpoc_id?json_integer(gpoc_id):json_null(),
+                          "gpor_username", username,
+                          "gpor_client_id", client_id!=NULL?json_string(client_id):json_null(),
+                          "gpor_issued_at",
+                            "raw",
+                            issued_at_clause,
+                          "gpor_last_seen",
+                            "raw",
+                            last_seen_clause,
+                          "gpor_expires_at",
+                            "raw",
+                            expires_at_clause,
+                          "gpor_duration", duration,
+                          "gpor_rolling_expiration", rolling,
+                          "gpor_claims_request", str_claims_request!=NULL?str_claims_request:"",
+                          "gpor_token_hash", token_hash,
+                          "gpor_issued_for", issued_for,
+                          "gpor_user_agent", user_agent!=NULL?user_agent:"",
+                          "gpor_resource", resource,
+                          "gpor_dpop_jkt", dpop_jkt,
+                          "gpor_authorization_details", str_authorization_details);
+    res = G_OK;
+    if (config->refresh_token_one_use) {
+      if (o_strnullempty(jti)) {
+        if (rand_string_nonce(jti, OIDC_JTI_LENGTH) == NULL) {
+          y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oidc - Error rand_string_nonce");
+          res = G_ERROR;
+        }
+      }
+      json_object_set_new(json_object_get(j_query, "values"), "gpor_jti", json_string(jti));
+    }
+    o_free(issued_at_clause);
+    o_free(expires_at_clause);
+    o_free(last_seen_clause);
+    o_free(str_claims_request);
+    o_free(str_authorization_details);
+    if (res == G_OK) {
+      config->glewlwyd_config->glewlwyd_callback_db_insert_begin(config->glewlwyd_config, conn);
+      res = config->glewlwyd_config->glewlwyd_callback_db_insert(config->glewlwyd_config, conn, j_query, "gpor_id", &j_last_id);
+      json_decref(j_query);
+      if (res == H_OK) {
+        if (j_last_id != NULL) {
+          config->glewlwyd_config->glewlwyd_callback_update_issued_for(config->glewlwyd_config, NULL, GLEWLWYD_PLUGIN_OIDC_TABLE_REFRESH_TOKEN, "gpor_issued_for", issued_for, "gpor_id", json_integer_value(j_last_id));
+          if (split_string(scope_list, " ", &scope_array) > 0) {
+            j_query = json_pack("{sss[]}",
+                                "table",
+                                GLEWLWYD_PLUGIN_OIDC_TABLE_REFRESH_TOKEN_SCOPE,
+                                "values");
+            if (j_query != NULL) {
+              for (i=0; scope_array[i] != NULL; i++) {
+                json_array_append_new(json_object_get(j_query, "values"), json_pack("{sOss}", "gpor_id", j_last_id, "gpors_scope", scope_array[i]));
+              }
+              res = h_insert(conn, j_query, NULL);
+              json_decref(j_query);
+              if (res == H_OK) {
+                j_return = json_pack("{sisO}", "result", G_OK, "gpor_id", j_last_id);
               } else {
-                y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oidc - Error json_pack");
-                j_return = json_pack("{si}", "result", G_ERROR);
+                y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oidc - Error executing j_query (2)");
+                config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+                j_return = json_pack("{si}", "result", G_ERROR_DB);
               }
             } else {
-              y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oidc - Error split_string");
+              y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oidc - Error json_pack");
               j_return = json_pack("{si}", "result", G_ERROR);
             }
-            free_string_array(scope_array);
           } else {
-            y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oidc - Error h_last_insert_id");
-            config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
-            j_return = json_pack("{si}", "result", G_ERROR_DB);
+            y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oidc - Error split_string");
+            j_return = json_pack("{si}", "result", G_ERROR);
           }
-          json_decref(j_last_id);
+          free_string_array(scope_array);
         } else {
-          y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oidc - Error executing j_query (1)");
+          y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oidc - Error h_last_insert_id");
           config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
           j_return = json_pack("{si}", "result", G_ERROR_DB);
         }
+        json_decref(j_last_id);
       } else {
-        j_return = json_pack("{si}", "result", G_ERROR);
+        y_log_message(Y_LOG_LEVEL_ERROR, "serialize_refresh_token - oidc - Error executing j_query (1)");
+        config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+        j_return = json_pack("{si}", "result", G_ERROR_DB);
       }
+      config->glewlwyd_config->glewlwyd_callback_db_insert_end(config->glewlwyd_config, conn);
     } else {
-      j_return = json_pack("{si}", "result", G_ERROR_PARAM);
+      j_return = json_pack("{si}", "result", G_ERROR);
     }
-    o_free(token_hash);
-    pthread_mutex_unlock(&config->insert_lock);
+  } else {
+    j_return = json_pack("{si}", "result", G_ERROR_PARAM);
   }
+  o_free(token_hash);
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
@@ -4042,6 +4690,9 @@ static json_t * check_client_valid(struct _oidc_config * config,
         j_return = json_pack("{siss*}", "result", G_ERROR_PARAM, "error_description", error_description);
       }
     }
+  } else if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+    // The password pool is full, the client may be valid
+    j_return = json_pack("{si}", "result", G_ERROR_UNAVAILABLE);
   } else {
     y_log_message(Y_LOG_LEVEL_DEBUG, "check_client_valid - oidc - Error, client '%s' is invalid, origin: %s", client_id, ip_source);
     j_return = json_pack("{si}", "result", G_ERROR_UNAUTHORIZED);
@@ -4050,10 +4701,22 @@ static json_t * check_client_valid(struct _oidc_config * config,
   return j_return;
 }
 
+/**
+ * The password verification pool is full, the client should retry later
+ */
+static void set_response_password_pool_unavailable(struct _u_response * response) {
+  json_t * j_body = json_pack("{ssss}", "error", "temporarily_unavailable", "error_description", "Too many pending password verifications");
+
+  ulfius_set_json_body_response(response, 503, j_body);
+  u_map_put(response->map_header, "Retry-After", GLEWLWYD_PASSWORD_POOL_RETRY_AFTER);
+  json_decref(j_body);
+}
+
 /**
  * builds the amr list based on the code
  */
 static int set_amr_list_for_code(struct _oidc_config * config, json_int_t gpoc_id, json_t * j_amr) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_element = NULL;
   int ret;
   size_t index = 0;
@@ -4065,7 +4728,7 @@ static int set_amr_list_for_code(struct _oidc_config * config, json_int_t gpoc_i
         json_array_foreach(j_amr, index, j_element) {
           json_array_append_new(json_object_get(j_query, "values"), json_pack("{sIsO}", "gpoc_id", gpoc_id, "gpoch_scheme_module", j_element));
         }
-        if (h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL) == H_OK) {
+        if (h_insert(conn, j_query, NULL) == H_OK) {
           ret = G_OK;
         } else {
           y_log_message(Y_LOG_LEVEL_ERROR, "set_amr_list_for_code - Error executing j_query (1)");
@@ -4079,7 +4742,7 @@ static int set_amr_list_for_code(struct _oidc_config * config, json_int_t gpoc_i
       }
     } else {
       j_query = json_pack("{sss{sIss}}", "table", GLEWLWYD_PLUGIN_OIDC_TABLE_CODE_SHEME, "values", "gpoc_id", gpoc_id, "gpoch_scheme_module", "session");
-      if (h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL) == H_OK) {
+      if (h_insert(conn, j_query, NULL) == H_OK) {
         ret = G_OK;
       } else {
         y_log_message(Y_LOG_LEVEL_ERROR, "set_amr_list_for_code - Error executing j_query (2)");
@@ -4092,6 +4755,7 @@ static int set_amr_list_for_code(struct _oidc_config * config, json_int_t gpoc_i
     y_log_message(Y_LOG_LEVEL_ERROR, "set_amr_list_for_code - Error param %s", json_dumps(j_amr, JSON_ENCODE_ANY));
     ret = G_ERROR_PARAM;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
@@ -4116,116 +4780,113 @@ static json_t * generate_authorization_code(struct _oidc_config * config,
                                           const char * s_hash,
                                           const char * sid,
                                           const char * dpop_jkt) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   char code[OIDC_CODE_LENGTH+1] = {0}, * code_hash = NULL, * expiration_clause, ** scope_array = NULL, * str_claims = NULL, * str_authorization_details = NULL;
   json_t * j_query, * j_code_id, * j_return;
   int res, i;
   time_t now;
 
-  if (pthread_mutex_lock(&config->insert_lock)) {
-    y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oidc - Error pthread_mutex_lock");
-    j_return = json_pack("{si}", "result", G_ERROR);
-  } else {
-    if (rand_string_nonce(code, OIDC_CODE_LENGTH) != NULL) {
-      if ((code_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, code)) != NULL) {
-        if (j_claims != NULL) {
-          str_claims = json_dumps(j_claims, JSON_COMPACT);
-          if (str_claims == NULL) {
-            y_log_message(Y_LOG_LEVEL_DEBUG, "generate_authorization_code - oidc - Error dumping claims");
-          }
-        }
-        time(&now);
-        if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
-          expiration_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)config->code_duration ));
-        } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
-          expiration_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)config->code_duration ));
-        } else { // HOEL_DB_TYPE_SQLITE
-          expiration_clause = msprintf("%u", (now + (time_t)config->code_duration ));
-        }
-        if (j_authorization_details != NULL) {
-          str_authorization_details = json_dumps(j_authorization_details, JSON_COMPACT);
+  if (rand_string_nonce(code, OIDC_CODE_LENGTH) != NULL) {
+    if ((code_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, code)) != NULL) {
+      if (j_claims != NULL) {
+        str_claims = json_dumps(j_claims, JSON_COMPACT);
+        if (str_claims == NULL) {
+          y_log_message(Y_LOG_LEVEL_DEBUG, "generate_authorization_code - oidc - Error dumping claims");
         }
-        j_query = json_pack("{sss{ss ss ss ss ss ss ss ss ss? ss ss? si s{ss} ss? ss? ss? ss?}}",
-                            "table",
-                            GLEWLWYD_PLUGIN_OIDC_TABLE_CODE,
-                            "values",
-                              "gpoc_plugin_name", config->name,
-                              "gpoc_username", username,
-                              "gpoc_client_id", client_id,
-                              "gpoc_redirect_uri", redirect_uri,
-                              "gpoc_code_hash", code_hash,
-                              "gpoc_issued_for", issued_for,
-                              "gpoc_user_agent", user_agent!=NULL?user_agent:"",
-                              "gpoc_nonce", nonce!=NULL?nonce:"",
-                              "gpoc_resource", resource,
-                              "gpoc_claims_request", str_claims!=NULL?str_claims:"",
-                              "gpoc_authorization_details", str_authorization_details,
-                              "gpoc_authorization_type", auth_type,
-                              "gpoc_expires_at",
-                                "raw",
-                                expiration_clause,
-                              "gpoc_code_challenge", code_challenge,
-                              "gpoc_s_hash", s_hash,
-                              "gpoc_sid", sid,
-                              "gpoc_dpop_jkt", dpop_jkt);
-        o_free(expiration_clause);
-        o_free(str_claims);
-        o_free(str_authorization_details);
-        res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
-        json_decref(j_query);
-        if (res != H_OK) {
-          y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oidc - Error executing j_query (1)");
-          j_return = json_pack("{si}", "result", G_ERROR_DB);
-        } else {
-          if (scope_list != NULL) {
-            j_code_id = h_last_insert_id(config->glewlwyd_config->glewlwyd_config->conn);
-            if (j_code_id != NULL) {
-              config->glewlwyd_config->glewlwyd_callback_update_issued_for(config->glewlwyd_config, NULL, GLEWLWYD_PLUGIN_OIDC_TABLE_CODE, "gpoc_issued_for", issued_for, "gpoc_id", json_integer_value(j_code_id));
-              j_query = json_pack("{sss[]}",
-                                  "table",
-                                  GLEWLWYD_PLUGIN_OIDC_TABLE_CODE_SCOPE,
-                                  "values");
-              if (split_string(scope_list, " ", &scope_array) > 0) {
-                for (i=0; scope_array[i] != NULL; i++) {
-                  json_array_append_new(json_object_get(j_query, "values"), json_pack("{sOss}", "gpoc_id", j_code_id, "gpocs_scope", scope_array[i]));
-                }
-                res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
-                json_decref(j_query);
-                if (res == H_OK) {
-                  j_return = json_pack("{sisssO}", "result", G_OK, "code", code, "gpoc_id", j_code_id);
-                } else {
-                  y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oidc - Error executing j_query (2)");
-                  j_return = json_pack("{si}", "result", G_ERROR_DB);
-                }
-              } else {
-                y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oidc - Error split_string");
-                j_return = json_pack("{si}", "result", G_ERROR);
+      }
+      time(&now);
+      if (conn->type==HOEL_DB_TYPE_MARIADB) {
+        expiration_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)config->code_duration ));
+      } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
+        expiration_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)config->code_duration ));
+      } else { // HOEL_DB_TYPE_SQLITE
+        expiration_clause = msprintf("%u", (now + (time_t)config->code_duration ));
+      }
+      if (j_authorization_details != NULL) {
+        str_authorization_details = json_dumps(j_authorization_details, JSON_COMPACT);
+      }
+      j_query = json_pack("{sss{ss ss ss ss ss ss ss ss ss? ss ss? si s{ss} ss? ss? ss? ss?}}",
+                          "table",
+                          GLEWLWYD_PLUGIN_OIDC_TABLE_CODE,
+                          "values",
+                            "gpoc_plugin_name", config->name,
+                            "gpoc_username", username,
+                            "gpoc_client_id", client_id,
+                            "gpoc_redirect_uri", redirect_uri,
+                            "gpoc_code_hash", code_hash,
+                            "gpoc_issued_for", issued_for,
+                            "gpoc_user_agent", user_agent!=NULL?user_agent:"",
+                            "gpoc_nonce", nonce!=NULL?nonce:"",
+                            "gpoc_resource", resource,
+                            "gpoc_claims_request", str_claims!=NULL?str_claims:"",
+                            "gpoc_authorization_details", str_authorization_details,
+                            "gpoc_authorization_type", auth_type,
+                            "gpoc_expires_at",
+                              "raw",
+                              expiration_clause,
+                            "gpoc_code_challenge", code_challenge,
+                            "gpoc_s_hash", s_hash,
+                            "gpoc_sid", sid,
+                            "gpoc_dpop_jkt", dpop_jkt);
+      o_free(expiration_clause);
+      o_free(str_claims);
+      o_free(str_authorization_details);
+      config->glewlwyd_config->glewlwyd_callback_db_insert_begin(config->glewlwyd_config, conn);
+      res = config->glewlwyd_config->glewlwyd_callback_db_insert(config->glewlwyd_config, conn, j_query, "gpoc_id", &j_code_id);
+      json_decref(j_query);
+      if (res != H_OK) {
+        y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oidc - Error executing j_query (1)");
+        j_return = json_pack("{si}", "result", G_ERROR_DB);
+      } else {
+        if (scope_list != NULL) {
+          if (j_code_id != NULL) {
+            config->glewlwyd_config->glewlwyd_callback_update_issued_for(config->glewlwyd_config, NULL, GLEWLWYD_PLUGIN_OIDC_TABLE_CODE, "gpoc_issued_for", issued_for, "gpoc_id", json_integer_value(j_code_id));
+            j_query = json_pack("{sss[]}",
+                                "table",
+                                GLEWLWYD_PLUGIN_OIDC_TABLE_CODE_SCOPE,
+                                "values");
+            if (split_string(scope_list, " ", &scope_array) > 0) {
+              for (i=0; scope_array[i] != NULL; i++) {
+                json_array_append_new(json_object_get(j_query, "values"), json_pack("{sOss}", "gpoc_id", j_code_id, "gpocs_scope", scope_array[i]));
               }
-              free_string_array(scope_array);
-              if (set_amr_list_for_code(config, json_integer_value(j_code_id), j_amr) != G_OK) {
-                y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oidc - Error set_amr_list_for_code");
+              res = h_insert(conn, j_query, NULL);
+              json_decref(j_query);
+              if (res == H_OK) {
+                j_return = json_pack("{sisssO}", "result", G_OK, "code", code, "gpoc_id", j_code_id);
+              } else {
+                y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oidc - Error executing j_query (2)");
+                j_return = json_pack("{si}", "result", G_ERROR_DB);
               }
-              json_decref(j_code_id);
             } else {
-              y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oidc - Error h_last_insert_id");
+              y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oidc - Error split_string");
               j_return = json_pack("{si}", "result", G_ERROR);
             }
+            free_string_array(scope_array);
+            if (set_amr_list_for_code(config, json_integer_value(j_code_id), j_amr) != G_OK) {
+              y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oidc - Error set_amr_list_for_code");
+            }
+            json_decref(j_code_id);
           } else {
-            y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oidc - scope_list is empty");
+            y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oidc - Error h_last_insert_id");
             j_return = json_pack("{si}", "result", G_ERROR);
           }
+        } else {
+          y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oidc - scope_list is empty");
+          j_return = json_pack("{si}", "result", G_ERROR);
         }
-      } else {
-        y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oidc - Error glewlwyd_callback_generate_hash");
-        j_return = json_pack("{si}", "result", G_ERROR);
       }
-      o_free(code_hash);
+      config->glewlwyd_config->glewlwyd_callback_db_insert_end(config->glewlwyd_config, conn);
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oidc - Error rand_string");
+      y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oidc - Error glewlwyd_callback_generate_hash");
       j_return = json_pack("{si}", "result", G_ERROR);
     }
-    pthread_mutex_unlock(&config->insert_lock);
+    o_free(code_hash);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "generate_authorization_code - oidc - Error rand_string");
+    j_return = json_pack("{si}", "result", G_ERROR);
   }
 
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
@@ -4309,6 +4970,7 @@ static json_t * get_scope_parameters(struct _oidc_config * config, const char *
  * disable an authoriation code
  */
 static int disable_authorization_code(struct _oidc_config * config, json_int_t gpoc_id) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res;
 
@@ -4323,8 +4985,9 @@ static int disable_authorization_code(struct _oidc_config * config, json_int_t g
                         config->name,
                         "gpoc_id",
                         gpoc_id);
-  res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   if (res == H_OK) {
     return G_OK;
   } else {
@@ -4338,6 +5001,7 @@ static int disable_authorization_code(struct _oidc_config * config, json_int_t g
  * return the amr list based on the code
  */
 static json_t * get_amr_list_from_code(struct _oidc_config * config, json_int_t gpoc_id) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result, * j_return, * j_element = NULL;
   int ret;
   size_t index = 0;
@@ -4350,7 +5014,7 @@ static json_t * get_amr_list_from_code(struct _oidc_config * config, json_int_t
                       "where",
                         "gpoc_id",
                         gpoc_id);
-  ret = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+  ret = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (ret == H_OK) {
     if (json_array_size(j_result)) {
@@ -4372,6 +5036,7 @@ static json_t * get_amr_list_from_code(struct _oidc_config * config, json_int_t
     config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
@@ -4542,13 +5207,14 @@ static json_t * get_refresh_token_duration_rolling(struct _oidc_config * config,
 }
 
 static int revoke_tokens_from_code(struct _oidc_config * config, json_int_t gpoc_id, const char * ip_source) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   int ret, res;
   char * query;
   json_t * j_result, * j_result_r, * j_element = NULL;
   size_t index = 0;
 
   query = msprintf("SELECT gpoa_jti AS jti, gpoa_client_id AS client_id FROM " GLEWLWYD_PLUGIN_OIDC_TABLE_ACCESS_TOKEN " WHERE gpor_id IN (SELECT gpor_id FROM " GLEWLWYD_PLUGIN_OIDC_TABLE_REFRESH_TOKEN " WHERE gpoc_id=%" JSON_INTEGER_FORMAT ") AND gpoa_enabled=1", gpoc_id);
-  res = h_execute_query_json(config->glewlwyd_config->glewlwyd_config->conn, query, &j_result);
+  res = h_execute_query_json(conn, query, &j_result);
   o_free(query);
   if (res == H_OK) {
     json_array_foreach(j_result, index, j_element) {
@@ -4556,7 +5222,7 @@ static int revoke_tokens_from_code(struct _oidc_config * config, json_int_t gpoc
     }
     json_decref(j_result);
     query = msprintf("SELECT gpor_client_id AS client_id FROM " GLEWLWYD_PLUGIN_OIDC_TABLE_REFRESH_TOKEN " WHERE gpoc_id=%" JSON_INTEGER_FORMAT " AND gpor_enabled=1", gpoc_id);
-    res = h_execute_query_json(config->glewlwyd_config->glewlwyd_config->conn, query, &j_result_r);
+    res = h_execute_query_json(conn, query, &j_result_r);
     o_free(query);
     if (res == H_OK) {
       if (json_array_size(j_result_r)) {
@@ -4564,11 +5230,11 @@ static int revoke_tokens_from_code(struct _oidc_config * config, json_int_t gpoc
       }
       json_decref(j_result_r);
       query = msprintf("UPDATE " GLEWLWYD_PLUGIN_OIDC_TABLE_ACCESS_TOKEN " SET gpoa_enabled='0' WHERE gpor_id IN (SELECT gpor_id FROM " GLEWLWYD_PLUGIN_OIDC_TABLE_REFRESH_TOKEN " WHERE gpoc_id=%" JSON_INTEGER_FORMAT ")", gpoc_id);
-      res = h_execute_query(config->glewlwyd_config->glewlwyd_config->conn, query, NULL, H_OPTION_EXEC);
+      res = h_execute_query(conn, query, NULL, H_OPTION_EXEC);
       o_free(query);
       if (res == H_OK) {
         query = msprintf("UPDATE " GLEWLWYD_PLUGIN_OIDC_TABLE_REFRESH_TOKEN " SET gpor_enabled='0' WHERE gpoc_id=%" JSON_INTEGER_FORMAT, gpoc_id);
-        res = h_execute_query(config->glewlwyd_config->glewlwyd_config->conn, query, NULL, H_OPTION_EXEC);
+        res = h_execute_query(conn, query, NULL, H_OPTION_EXEC);
         o_free(query);
         if (res == H_OK) {
           ret = G_OK;
@@ -4592,6 +5258,7 @@ static int revoke_tokens_from_code(struct _oidc_config * config, json_int_t gpoc
     config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
@@ -4599,7 +5266,8 @@ static int revoke_tokens_from_code(struct _oidc_config * config, json_int_t gpoc
  * verify that the auth code is valid
  */
 static json_t * validate_authorization_code(struct _oidc_config * config, const char * code, const char * client_id, const char * redirect_uri, const char * code_verifier, const char * ip_source) {
-  char * code_hash = NULL,
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
+  char code_hash[GLEWLWYD_HASH_BUFFER_SIZE],
        * expiration_clause = NULL,
        * scope_list = NULL,
        * tmp;
@@ -4615,10 +5283,10 @@ static json_t * validate_authorization_code(struct _oidc_config * config, const
   int rolling_refresh = config->refresh_token_rolling, rolling_refresh_override = -1;
 
   if (o_strlen(code) == OIDC_CODE_LENGTH) {
-    if ((code_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, code)) != NULL) {
-      if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+    if (config->glewlwyd_config->glewlwyd_callback_generate_hash_buffer(config->glewlwyd_config, code, code_hash, sizeof(code_hash)) == G_OK) {
+      if (conn->type==HOEL_DB_TYPE_MARIADB) {
         expiration_clause = o_strdup("> NOW()");
-      } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+      } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
         expiration_clause = o_strdup("> NOW()");
       } else { // HOEL_DB_TYPE_SQLITE
         expiration_clause = o_strdup("> (strftime('%s','now'))");
@@ -4653,7 +5321,7 @@ static json_t * validate_authorization_code(struct _oidc_config * config, const
                               "value",
                               expiration_clause);
       o_free(expiration_clause);
-      res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+      res = h_select(conn, j_query, &j_result, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         if (json_array_size(j_result)) {
@@ -4671,7 +5339,7 @@ static json_t * validate_authorization_code(struct _oidc_config * config, const
                                   "where",
                                     "gpoc_id",
                                     json_object_get(json_array_get(j_result, 0), "gpoc_id"));
-              res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result_scope, NULL);
+              res = h_select(conn, j_query, &j_result_scope, NULL);
               json_decref(j_query);
               if (res == H_OK && json_array_size(j_result_scope) > 0) {
                 if (!json_object_set_new(json_array_get(j_result, 0), "scope", json_array())) {
@@ -4748,14 +5416,14 @@ static json_t * validate_authorization_code(struct _oidc_config * config, const
       }
       json_decref(j_result);
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "oidc validate_authorization_code - Error glewlwyd_callback_generate_hash");
+      y_log_message(Y_LOG_LEVEL_ERROR, "oidc validate_authorization_code - Error glewlwyd_callback_generate_hash_buffer");
       j_return = json_pack("{si}", "result", G_ERROR);
     }
-    o_free(code_hash);
   } else {
     y_log_message(Y_LOG_LEVEL_DEBUG, "oidc validate_authorization_code - validate_code_challenge invalid code");
     j_return = json_pack("{si}", "result", G_ERROR_UNAUTHORIZED);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
@@ -4878,18 +5546,19 @@ static json_t * validate_session_client_scope(struct _oidc_config * config, cons
  * Verify that the refresh token is still valid to get an access token
  */
 static json_t * validate_refresh_token(struct _oidc_config * config, const char * refresh_token) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_return, * j_query, * j_result, * j_result_scope, * j_element = NULL;
-  char * token_hash, * expires_at_clause;
+  char token_hash[GLEWLWYD_HASH_BUFFER_SIZE], * expires_at_clause;
   int res, enabled;
   size_t index = 0;
   time_t now;
 
   if (o_strlen(refresh_token) == OIDC_REFRESH_TOKEN_LENGTH) {
-    if ((token_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, refresh_token)) != NULL) {
+    if (config->glewlwyd_config->glewlwyd_callback_generate_hash_buffer(config->glewlwyd_config, refresh_token, token_hash, sizeof(token_hash)) == G_OK) {
       time(&now);
-      if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+      if (conn->type==HOEL_DB_TYPE_MARIADB) {
         expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-      } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+      } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
         expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
       } else { // HOEL_DB_TYPE_SQLITE
         expires_at_clause = msprintf("> %u", (now));
@@ -4903,9 +5572,9 @@ static json_t * validate_refresh_token(struct _oidc_config * config, const char
                             "gpoc_id",
                             "gpor_username AS username",
                             "gpor_client_id AS client_id",
-                            SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpor_issued_at) AS issued_at", "gpor_issued_at AS issued_at", "EXTRACT(EPOCH FROM gpor_issued_at)::integer AS issued_at"),
-                            SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpor_expires_at) AS expired_at", "gpor_expires_at AS expired_at", "EXTRACT(EPOCH FROM gpor_expires_at)::integer AS expired_at"),
-                            SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpor_last_seen) AS last_seen", "gpor_last_seen AS last_seen", "EXTRACT(EPOCH FROM gpor_last_seen)::integer AS last_seen"),
+                            SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpor_issued_at) AS issued_at", "gpor_issued_at AS issued_at", "EXTRACT(EPOCH FROM gpor_issued_at)::integer AS issued_at"),
+                            SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpor_expires_at) AS expired_at", "gpor_expires_at AS expired_at", "EXTRACT(EPOCH FROM gpor_expires_at)::integer AS expired_at"),
+                            SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpor_last_seen) AS last_seen", "gpor_last_seen AS last_seen", "EXTRACT(EPOCH FROM gpor_last_seen)::integer AS last_seen"),
                             "gpor_duration AS duration",
                             "gpor_rolling_expiration",
                             "gpor_claims_request AS claims_request",
@@ -4925,7 +5594,7 @@ static json_t * validate_refresh_token(struct _oidc_config * config, const char
                               "value",
                               expires_at_clause);
       o_free(expires_at_clause);
-      res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+      res = h_select(conn, j_query, &j_result, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         if (json_array_size(j_result) > 0) {
@@ -4945,7 +5614,7 @@ static json_t * validate_refresh_token(struct _oidc_config * config, const char
                               "where",
                                 "gpor_id",
                                 json_object_get(json_array_get(j_result, 0), "gpor_id"));
-          res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result_scope, NULL);
+          res = h_select(conn, j_query, &j_result_scope, NULL);
           if (res == H_OK) {
             if (!json_object_set_new(json_array_get(j_result, 0), "scope", json_array())) {
               json_array_foreach(j_result_scope, index, j_element) {
@@ -4973,13 +5642,13 @@ static json_t * validate_refresh_token(struct _oidc_config * config, const char
         j_return = json_pack("{si}", "result", G_ERROR_DB);
       }
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "oidc validate_refresh_token - Error glewlwyd_callback_generate_hash");
+      y_log_message(Y_LOG_LEVEL_ERROR, "oidc validate_refresh_token - Error glewlwyd_callback_generate_hash_buffer");
       j_return = json_pack("{si}", "result", G_ERROR);
     }
-    o_free(token_hash);
   } else {
     j_return = json_pack("{si}", "result", G_ERROR_UNAUTHORIZED);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
@@ -4987,6 +5656,7 @@ static json_t * validate_refresh_token(struct _oidc_config * config, const char
  * get a list of refresh token for a specified user
  */
 static json_t * refresh_token_list_get(struct _oidc_config * config, const char * username, const char * pattern, size_t offset, size_t limit, const char * sort) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result, * j_return, * j_element = NULL;
   int res;
   size_t index = 0, token_hash_dec_len = 0;
@@ -5000,9 +5670,9 @@ static json_t * refresh_token_list_get(struct _oidc_config * config, const char
                         "gpor_token_hash",
                         "gpor_authorization_type",
                         "gpor_client_id AS client_id",
-                        SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpor_issued_at) AS issued_at", "gpor_issued_at AS issued_at", "EXTRACT(EPOCH FROM gpor_issued_at)::integer AS issued_at"),
-                        SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpor_expires_at) AS expires_at", "gpor_expires_at AS expires_at", "EXTRACT(EPOCH FROM gpor_expires_at)::integer AS expires_at"),
-                        SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpor_last_seen) AS last_seen", "gpor_last_seen AS last_seen", "EXTRACT(EPOCH FROM gpor_last_seen)::integer AS last_seen"),
+                        SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpor_issued_at) AS issued_at", "gpor_issued_at AS issued_at", "EXTRACT(EPOCH FROM gpor_issued_at)::integer AS issued_at"),
+                        SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpor_expires_at) AS expires_at", "gpor_expires_at AS expires_at", "EXTRACT(EPOCH FROM gpor_expires_at)::integer AS expires_at"),
+                        SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpor_last_seen) AS last_seen", "gpor_last_seen AS last_seen", "EXTRACT(EPOCH FROM gpor_last_seen)::integer AS last_seen"),
                         "gpor_rolling_expiration",
                         "gpor_issued_for AS issued_for",
                         "gpor_user_agent AS user_agent",
@@ -5022,15 +5692,15 @@ static json_t * refresh_token_list_get(struct _oidc_config * config, const char
     json_object_set_new(j_query, "order_by", json_string(sort));
   }
   if (pattern != NULL) {
-    name_escaped = h_escape_string_with_quotes(config->glewlwyd_config->glewlwyd_config->conn, config->name);
-    pattern_escaped = h_escape_string_with_quotes(config->glewlwyd_config->glewlwyd_config->conn, pattern);
+    name_escaped = h_escape_string_with_quotes(conn, config->name);
+    pattern_escaped = h_escape_string_with_quotes(conn, pattern);
     pattern_clause = msprintf("IN (SELECT gpor_id FROM "GLEWLWYD_PLUGIN_OIDC_TABLE_REFRESH_TOKEN" WHERE (gpor_user_agent LIKE '%%'||%s||'%%' OR gpor_issued_for LIKE '%%'||%s||'%%') AND gpor_plugin_name=%s)", pattern_escaped, pattern_escaped, name_escaped);
     json_object_set_new(json_object_get(j_query, "where"), "gpor_id", json_pack("{ssss}", "operator", "raw", "value", pattern_clause));
     o_free(pattern_clause);
     o_free(pattern_escaped);
     o_free(name_escaped);
   }
-  res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     json_array_foreach(j_result, index, j_element) {
@@ -5062,6 +5732,7 @@ static json_t * refresh_token_list_get(struct _oidc_config * config, const char
     config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
@@ -5069,6 +5740,7 @@ static json_t * refresh_token_list_get(struct _oidc_config * config, const char
  * disable a refresh token based on its signature
  */
 static int refresh_token_disable(struct _oidc_config * config, const char * username, const char * token_hash, const char * ip_source) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result, * j_element = NULL;
   int res, ret = G_OK;
   unsigned char token_hash_dec[128];
@@ -5091,7 +5763,7 @@ static int refresh_token_disable(struct _oidc_config * config, const char * user
       ret = G_ERROR_PARAM;
     }
   }
-  res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result)) {
@@ -5105,7 +5777,7 @@ static int refresh_token_disable(struct _oidc_config * config, const char * user
                               "where",
                                 "gpor_plugin_name", config->name,
                                 "gpor_id", json_object_get(j_element, "gpor_id"));
-          res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+          res = h_update(conn, j_query, NULL);
           json_decref(j_query);
           if (res == H_OK) {
             if (token_hash != NULL) {
@@ -5140,7 +5812,7 @@ static int refresh_token_disable(struct _oidc_config * config, const char * user
                         "where",
                           "gpoa_plugin_name", config->name,
                           "gpoa_enabled", 1);
-    res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res != H_OK) {
       y_log_message(Y_LOG_LEVEL_ERROR, "refresh_token_disable - Error executing j_query (3)");
@@ -5157,7 +5829,7 @@ static int refresh_token_disable(struct _oidc_config * config, const char * user
                         "where",
                           "gpoi_plugin_name", config->name,
                           "gpoi_enabled", 1);
-    res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res != H_OK) {
       y_log_message(Y_LOG_LEVEL_ERROR, "refresh_token_disable - Error executing j_query (4)");
@@ -5165,6 +5837,7 @@ static int refresh_token_disable(struct _oidc_config * config, const char * user
       ret = G_ERROR_DB;
     }
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
@@ -5172,13 +5845,14 @@ static int refresh_token_disable(struct _oidc_config * config, const char * user
  * update settings for a refresh token
  */
 static int update_refresh_token(struct _oidc_config * config, json_int_t gpor_id, json_int_t refresh_token_duration, int disable, time_t now) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res, ret;
   char * expires_at_clause, * last_seen_clause;
 
-  if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+  if (conn->type==HOEL_DB_TYPE_MARIADB) {
     last_seen_clause = msprintf("FROM_UNIXTIME(%u)", (now));
-  } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+  } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
     last_seen_clause = msprintf("TO_TIMESTAMP(%u)", now);
   } else { // HOEL_DB_TYPE_SQLITE
     last_seen_clause = msprintf("%u", (now));
@@ -5197,9 +5871,9 @@ static int update_refresh_token(struct _oidc_config * config, json_int_t gpor_id
                         gpor_id);
   o_free(last_seen_clause);
   if (refresh_token_duration) {
-    if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
       expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)refresh_token_duration));
-    } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
       expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)refresh_token_duration));
     } else { // HOEL_DB_TYPE_SQLITE
       expires_at_clause = msprintf("%u", (now + (time_t)refresh_token_duration));
@@ -5210,7 +5884,7 @@ static int update_refresh_token(struct _oidc_config * config, json_int_t gpor_id
   if (disable) {
     json_object_set_new(json_object_get(j_query, "set"), "gpor_enabled", json_integer(0));
   }
-  res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = G_OK;
@@ -5219,6 +5893,7 @@ static int update_refresh_token(struct _oidc_config * config, json_int_t gpor_id
     config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
@@ -5455,7 +6130,7 @@ static json_t * verify_request_signature(struct _oidc_config * config, jwt_t * j
             }
           } else if (alg == R_JWA_ALG_ES256 || alg == R_JWA_ALG_ES384 || alg == R_JWA_ALG_ES512 || alg == R_JWA_ALG_RS256 || alg == R_JWA_ALG_RS384 || alg == R_JWA_ALG_RS512 || alg == R_JWA_ALG_PS256 || alg == R_JWA_ALG_PS384 || alg == R_JWA_ALG_PS512 || alg == R_JWA_ALG_EDDSA) {
             if (!json_string_null_or_empty(json_object_get(json_object_get(j_client, "client"), json_string_value(json_object_get(config->j_params, "client-jwks_uri-parameter")))) && o_strlen(kid)) {
-              if (r_jwks_init(&jwks) == RHN_OK && r_jwks_import_from_uri(jwks, json_string_value(json_object_get(json_object_get(j_client, "client"), json_string_value(json_object_get(config->j_params, "client-jwks_uri-parameter")))), config->x5u_flags) == RHN_OK && is_client_jwks_valid(config, jwks) == G_OK) {
+              if ((jwks = get_client_jwks_from_uri(config, json_string_value(json_object_get(json_object_get(j_client, "client"), json_string_value(json_object_get(config->j_params, "client-jwks_uri-parameter")))), kid)) != NULL && is_client_jwks_valid(config, jwks) == G_OK) {
                 if (json_object_get(config->j_params, "oauth-fapi-allow-multiple-kid") == json_true()) {
                   j_search = json_pack("{ss*}", "kid", kid);
                   jwks_kid = r_jwks_search_json_t(jwks, j_search);
@@ -5574,7 +6249,7 @@ static json_t * verify_request_signature(struct _oidc_config * config, jwt_t * j
 
 static int decrypt_request_token(struct _oidc_config * config, jwt_t * jwt) {
   int ret, res;
-  jwk_t * jwk = NULL;
+  jwk_t * jwk = NULL, * jwk_derived = NULL;
   unsigned char * key = NULL, key_hash[64] = {0};
   size_t key_len = 0, key_hash_len = 64;
   jwa_alg alg;
@@ -5588,12 +6263,12 @@ static int decrypt_request_token(struct _oidc_config * config, jwt_t * jwt) {
     if (json_object_get(config->j_params, "request-parameter-allow-encrypted") == json_true()) {
       alg = r_jwt_get_enc_alg(jwt);
       enc = r_jwt_get_enc(jwt);
-      if (r_jwks_size(config->jwks_sign) == 1) {
-        jwk = r_jwks_get_at(config->jwks_sign, 0);
+      if (config->jwks_sign_index.nb_jwk == 1) {
+        jwk = config->jwks_sign_index.jwk_list[0];
       } else if (r_jwt_get_header_str_value(jwt, "kid") != NULL) {
-        jwk = r_jwks_get_by_kid(config->jwks_sign, r_jwt_get_header_str_value(jwt, "kid"));
+        jwk = get_jwk_sign_by_kid(config, r_jwt_get_header_str_value(jwt, "kid"));
       } else if (!json_string_null_or_empty(json_object_get(config->j_params, "default-kid"))) {
-        jwk = r_jwks_get_by_kid(config->jwks_sign, json_string_value(json_object_get(config->j_params, "default-kid")));
+        jwk = get_jwk_sign_by_kid(config, json_string_value(json_object_get(config->j_params, "default-kid")));
       }
       if (jwk != NULL) {
         if (r_jwk_key_type(jwk, &bits, 0) & R_KEY_TYPE_SYMMETRIC) {
@@ -5609,12 +6284,11 @@ static int decrypt_request_token(struct _oidc_config * config, jwt_t * jwt) {
                   } else if (alg == R_JWA_ALG_A192GCMKW || alg == R_JWA_ALG_A192KW) {
                     key_hash_len = 24;
                   }
-                  r_jwk_free(jwk);
                   jwk = NULL;
-                  if (r_jwk_init(&jwk) != RHN_OK || r_jwk_import_from_symmetric_key(jwk, key_hash, key_hash_len) != RHN_OK) {
+                  if (r_jwk_init(&jwk_derived) == RHN_OK && r_jwk_import_from_symmetric_key(jwk_derived, key_hash, key_hash_len) == RHN_OK) {
+                    jwk = jwk_derived;
+                  } else {
                     y_log_message(Y_LOG_LEVEL_ERROR, "decrypt_request_token - Error setting jwk");
-                    r_jwk_free(jwk);
-                    jwk = NULL;
                   }
                 } else {
                   y_log_message(Y_LOG_LEVEL_ERROR, "decrypt_request_token - Error generate_digest_raw");
@@ -5628,13 +6302,11 @@ static int decrypt_request_token(struct _oidc_config * config, jwt_t * jwt) {
             }
           } else {
             // Key type differs
-            r_jwk_free(jwk);
             jwk = NULL;
           }
         } else {
           if (alg == R_JWA_ALG_A128GCMKW || alg == R_JWA_ALG_A128KW || alg == R_JWA_ALG_A192GCMKW || alg == R_JWA_ALG_A192KW || alg == R_JWA_ALG_A256GCMKW || alg == R_JWA_ALG_A256KW || alg == R_JWA_ALG_DIR) {
             // Key type differs
-            r_jwk_free(jwk);
             jwk = NULL;
           }
         }
@@ -5661,7 +6333,7 @@ static int decrypt_request_token(struct _oidc_config * config, jwt_t * jwt) {
     y_log_message(Y_LOG_LEVEL_DEBUG, "decrypt_request_token - invalid nested JWT type");
     ret = G_ERROR_PARAM;
   }
-  r_jwk_free(jwk);
+  r_jwk_free(jwk_derived);
   return ret;
 }
 
@@ -5747,7 +6419,7 @@ static json_t * validate_ciba_jwt_request(struct _oidc_config * config, const ch
                                            R_JWT_CLAIM_JTI, NULL,
                                            R_JWT_CLAIM_NOP) == RHN_OK &&
                 o_strnstr(r_jwt_get_claim_str_value(jwt, "aud"), json_string_value(json_object_get(config->j_params, "iss")), json_string_length(json_object_get(config->j_params, "iss"))) != NULL) {
-              if ((res = check_ciba_jti(config, r_jwt_get_claim_str_value(jwt, "jti"), client_id, ip_source)) == RHN_OK) {
+              if ((res = check_ciba_jti(config, r_jwt_get_claim_str_value(jwt, "jti"), r_jwt_get_claim_int_value(jwt, "exp"), client_id, ip_source)) == RHN_OK) {
                 j_claims = r_jwt_get_full_claims_json_t(jwt);
                 if (json_object_get(j_claims, "requested_expiry") != NULL) {
                   if (json_is_integer(json_object_get(j_claims, "requested_expiry"))) {
@@ -6004,6 +6676,7 @@ static json_t * generate_ciba_token_response(struct _oidc_config * config, json_
 }
 
 static int close_ciba_request(struct _oidc_config * config, json_int_t gpob_id) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res, ret;
 
@@ -6013,7 +6686,7 @@ static int close_ciba_request(struct _oidc_config * config, json_int_t gpob_id)
                         "gpob_status", 3,
                       "where",
                         "gpob_id", gpob_id);
-  res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = G_OK;
@@ -6021,91 +6694,72 @@ static int close_ciba_request(struct _oidc_config * config, json_int_t gpob_id)
     y_log_message(Y_LOG_LEVEL_ERROR, "close_ciba_request - Error executing j_query");
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
-static int send_ciba_client_notification(struct _oidc_config * config, json_t * j_client, json_t * j_user, json_t * j_ciba_request, const char * scope_list, int status, const char * sid) {
-  int ret;
+/**
+ * Sends the notification to the client backchannel_client_notification_endpoint
+ * The notification is sent by the current thread, so the caller gets the delivery result
+ * j_body is stolen
+ */
+static int send_ciba_notification(struct _oidc_config * config, json_t * j_client, json_t * j_ciba_request, json_t * j_body) {
   struct _u_request req;
   struct _u_response resp;
   char * bearer_token;
-  json_t * j_body, * j_ciba_token;
+  int ret;
 
-  if (0 == o_strcmp(json_string_value(json_object_get(j_client, "backchannel_token_delivery_mode")), "poll")) {
-    ret = G_OK; // Nothing to do, client will poll token endpoint
-  } else if (0 == o_strcmp(json_string_value(json_object_get(j_client, "backchannel_token_delivery_mode")), "ping")) {
-    // send ping request
-    if (ulfius_init_request(&req) == U_OK) {
-      if (ulfius_init_response(&resp) == U_OK) {
-        bearer_token = msprintf("Bearer %s", json_string_value(json_object_get(j_ciba_request, "client_notification_token")));
-        j_body = json_pack("{ss}", "auth_req_id", json_string_value(json_object_get(j_ciba_request, "auth_req_id")));
-        ulfius_set_request_properties(&req, U_OPT_HTTP_VERB, "POST",
-                                            U_OPT_HTTP_URL, json_string_value(json_object_get(j_client, "backchannel_client_notification_endpoint")),
-                                            U_OPT_JSON_BODY, j_body,
-                                            U_OPT_HEADER_PARAMETER, "Authorization", bearer_token,
-                                            U_OPT_CHECK_SERVER_CERTIFICATE, json_object_get(config->j_params, "oauth-ciba-allow-https-non-secure")==json_true()?0:1,
-                                            U_OPT_CHECK_PROXY_CERTIFICATE, json_object_get(config->j_params, "oauth-ciba-allow-https-non-secure")==json_true()?0:1,
-                                            U_OPT_NONE);
-        o_free(bearer_token);
-        json_decref(j_body);
-        if (ulfius_send_http_request(&req, &resp) == U_OK) {
-          if (resp.status == 200 || resp.status == 204) {
-            ret = G_OK;
-          } else {
-            y_log_message(Y_LOG_LEVEL_ERROR, "send_ciba_client_notification ping - Invalid response status: %d", resp.status);
-            ret = G_ERROR;
-          }
+  if (ulfius_init_request(&req) == U_OK) {
+    if (ulfius_init_response(&resp) == U_OK) {
+      bearer_token = msprintf("Bearer %s", json_string_value(json_object_get(j_ciba_request, "client_notification_token")));
+      ulfius_set_request_properties(&req, U_OPT_HTTP_VERB, "POST",
+                                          U_OPT_HTTP_URL, json_string_value(json_object_get(j_client, "backchannel_client_notification_endpoint")),
+                                          U_OPT_JSON_BODY, j_body,
+                                          U_OPT_HEADER_PARAMETER, "Authorization", bearer_token,
+                                          U_OPT_CHECK_SERVER_CERTIFICATE, json_object_get(config->j_params, "oauth-ciba-allow-https-non-secure")==json_true()?0:1,
+                                          U_OPT_CHECK_PROXY_CERTIFICATE, json_object_get(config->j_params, "oauth-ciba-allow-https-non-secure")==json_true()?0:1,
+                                          U_OPT_NONE);
+      o_free(bearer_token);
+      if (ulfius_send_http_request(&req, &resp) == U_OK) {
+        if (resp.status == 200 || resp.status == 204) {
+          ret = G_OK;
         } else {
-          y_log_message(Y_LOG_LEVEL_ERROR, "send_ciba_client_notification ping - Error ulfius_send_http_request");
+          y_log_message(Y_LOG_LEVEL_ERROR, "send_ciba_notification - Invalid response status: %d", resp.status);
           ret = G_ERROR;
         }
-        ulfius_clean_response(&resp);
       } else {
-        y_log_message(Y_LOG_LEVEL_ERROR, "send_ciba_client_notification ping - Error ulfius_init_request");
+        y_log_message(Y_LOG_LEVEL_ERROR, "send_ciba_notification - Error ulfius_send_http_request");
         ret = G_ERROR;
       }
-      ulfius_clean_request(&req);
+      ulfius_clean_response(&resp);
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "send_ciba_client_notification ping - Error ulfius_init_request");
+      y_log_message(Y_LOG_LEVEL_ERROR, "send_ciba_notification - Error ulfius_init_response");
       ret = G_ERROR;
     }
+    ulfius_clean_request(&req);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "send_ciba_notification - Error ulfius_init_request");
+    ret = G_ERROR;
+  }
+  json_decref(j_body);
+  return ret;
+}
+
+static int send_ciba_client_notification(struct _oidc_config * config, json_t * j_client, json_t * j_user, json_t * j_ciba_request, const char * scope_list, int status, const char * sid) {
+  int ret;
+  json_t * j_ciba_token;
+
+  if (0 == o_strcmp(json_string_value(json_object_get(j_client, "backchannel_token_delivery_mode")), "poll")) {
+    ret = G_OK; // Nothing to do, client will poll token endpoint
+  } else if (0 == o_strcmp(json_string_value(json_object_get(j_client, "backchannel_token_delivery_mode")), "ping")) {
+    // send ping request
+    ret = send_ciba_notification(config, j_client, j_ciba_request, json_pack("{ss}", "auth_req_id", json_string_value(json_object_get(j_ciba_request, "auth_req_id"))));
   } else if (0 == o_strcmp(json_string_value(json_object_get(j_client, "backchannel_token_delivery_mode")), "push")) {
     if (status == 1) {
       j_ciba_token = generate_ciba_token_response(config, j_client, j_user, j_ciba_request, scope_list, sid, json_string_value(json_object_get(j_ciba_request, "dpop_jkt")));
       if (check_result_value(j_ciba_token, G_OK)) {
         if (close_ciba_request(config, json_integer_value(json_object_get(j_ciba_request, "gpob_id"))) == G_OK) {
-          if (ulfius_init_request(&req) == U_OK) {
-            if (ulfius_init_response(&resp) == U_OK) {
-              bearer_token = msprintf("Bearer %s", json_string_value(json_object_get(j_ciba_request, "client_notification_token")));
-              ulfius_set_request_properties(&req, U_OPT_HTTP_VERB, "POST",
-                                                  U_OPT_HTTP_URL, json_string_value(json_object_get(j_client, "backchannel_client_notification_endpoint")),
-                                                  U_OPT_JSON_BODY, json_object_get(j_ciba_token, "token"),
-                                                  U_OPT_HEADER_PARAMETER, "Authorization", bearer_token,
-                                                  U_OPT_CHECK_SERVER_CERTIFICATE, json_object_get(config->j_params, "oauth-ciba-allow-https-non-secure")==json_true()?0:1,
-                                                  U_OPT_CHECK_PROXY_CERTIFICATE, json_object_get(config->j_params, "oauth-ciba-allow-https-non-secure")==json_true()?0:1,
-                                                  U_OPT_NONE);
-              o_free(bearer_token);
-              if (ulfius_send_http_request(&req, &resp) == U_OK) {
-                if (resp.status == 200 || resp.status == 204) {
-                  ret = G_OK;
-                } else {
-                  y_log_message(Y_LOG_LEVEL_ERROR, "send_ciba_client_notification push - Invalid response status: %d", resp.status);
-                  ret = G_ERROR;
-                }
-              } else {
-                y_log_message(Y_LOG_LEVEL_ERROR, "send_ciba_client_notification push - Error ulfius_send_http_request");
-                ret = G_ERROR;
-              }
-              ulfius_clean_response(&resp);
-            } else {
-              y_log_message(Y_LOG_LEVEL_ERROR, "send_ciba_client_notification push - Error ulfius_init_request");
-              ret = G_ERROR;
-            }
-            ulfius_clean_request(&req);
-          } else {
-            y_log_message(Y_LOG_LEVEL_ERROR, "send_ciba_client_notification push - Error ulfius_init_request");
-            ret = G_ERROR;
-          }
+          ret = send_ciba_notification(config, j_client, j_ciba_request, json_incref(json_object_get(j_ciba_token, "token")));
         } else {
           y_log_message(Y_LOG_LEVEL_ERROR, "send_ciba_client_notification push - Error close_ciba_request");
           ret = G_ERROR;
@@ -6118,40 +6772,7 @@ static int send_ciba_client_notification(struct _oidc_config * config, json_t *
       }
       json_decref(j_ciba_token);
     } else {
-    if (ulfius_init_request(&req) == U_OK) {
-        if (ulfius_init_response(&resp) == U_OK) {
-          bearer_token = msprintf("Bearer %s", json_string_value(json_object_get(j_ciba_request, "client_notification_token")));
-          j_body = json_pack("{ss}", "error", "access_denied");
-          ulfius_set_request_properties(&req, U_OPT_HTTP_VERB, "POST",
-                                              U_OPT_HTTP_URL, json_string_value(json_object_get(j_client, "backchannel_client_notification_endpoint")),
-                                              U_OPT_JSON_BODY, j_body,
-                                              U_OPT_HEADER_PARAMETER, "Authorization", bearer_token,
-                                              U_OPT_CHECK_SERVER_CERTIFICATE, json_object_get(config->j_params, "oauth-ciba-allow-https-non-secure")==json_true()?0:1,
-                                              U_OPT_CHECK_PROXY_CERTIFICATE, json_object_get(config->j_params, "oauth-ciba-allow-https-non-secure")==json_true()?0:1,
-                                              U_OPT_NONE);
-          o_free(bearer_token);
-          json_decref(j_body);
-          if (ulfius_send_http_request(&req, &resp) == U_OK) {
-            if (resp.status == 200 || resp.status == 204) {
-              ret = G_OK;
-            } else {
-              y_log_message(Y_LOG_LEVEL_ERROR, "send_ciba_client_notification ping - Invalid response status: %d", resp.status);
-              ret = G_ERROR;
-            }
-          } else {
-            y_log_message(Y_LOG_LEVEL_ERROR, "send_ciba_client_notification push - Error ulfius_send_http_request");
-            ret = G_ERROR;
-          }
-          ulfius_clean_response(&resp);
-        } else {
-          y_log_message(Y_LOG_LEVEL_ERROR, "send_ciba_client_notification ping - Error ulfius_init_request");
-          ret = G_ERROR;
-        }
-        ulfius_clean_request(&req);
-      } else {
-        y_log_message(Y_LOG_LEVEL_ERROR, "send_ciba_client_notification ping - Error ulfius_init_request");
-        ret = G_ERROR;
-      }
+      ret = send_ciba_notification(config, j_client, j_ciba_request, json_pack("{ss}", "error", "access_denied"));
     }
   } else {
     ret = G_ERROR_PARAM;
@@ -6159,82 +6780,171 @@ static int send_ciba_client_notification(struct _oidc_config * config, json_t *
   return ret;
 }
 
-static int check_request_jti_unused(struct _oidc_config * config, const char * jti, const char * iss, const char * ip_source) {
-  json_t * j_query, * j_result = NULL, * j_last_index;
-  int ret, res;
-  char * jti_hash = NULL;
+struct _request_jti_insert {
+  struct config_plugin * glewlwyd_config;
+  char                 * plugin_name;
+  char                 * client_id;
+  char                 * jti_hash;
+  char                 * ip_source;
+};
 
-  if (pthread_mutex_lock(&config->insert_lock)) {
-    y_log_message(Y_LOG_LEVEL_ERROR, "serialize_client_register - oidc - Error pthread_mutex_lock");
-    ret = G_ERROR;
+/**
+ * Stores the request jti hash in the database
+ */
+static int insert_request_jti(struct config_plugin * glewlwyd_config, const char * plugin_name, const char * client_id, const char * jti_hash, const char * ip_source) {
+  struct _h_connection * conn = glewlwyd_config->glewlwyd_callback_db_checkout(glewlwyd_config);
+  json_t * j_query, * j_last_index = NULL;
+  int res, ret;
+
+  j_query = json_pack("{sss{ssssssss}}",
+                      "table",
+                      GLEWLWYD_PLUGIN_OIDC_TABLE_CLIENT_TOKEN_REQUEST,
+                      "values",
+                        "gpoctr_plugin_name",
+                        plugin_name,
+                        "gpoctr_cient_id",
+                        client_id,
+                        "gpoctr_issued_for",
+                        ip_source,
+                        "gpoctr_jti_hash",
+                        jti_hash);
+  res = glewlwyd_config->glewlwyd_callback_db_insert(glewlwyd_config, conn, j_query, "gpoctr_id", &j_last_index);
+  json_decref(j_query);
+  glewlwyd_config->glewlwyd_callback_db_checkin(glewlwyd_config, conn);
+  if (res == H_OK) {
+    if (j_last_index != NULL) {
+      glewlwyd_config->glewlwyd_callback_update_issued_for(glewlwyd_config, NULL, GLEWLWYD_PLUGIN_OIDC_TABLE_CLIENT_TOKEN_REQUEST, "gpoctr_issued_for", ip_source, "gpoctr_id", json_integer_value(j_last_index));
+      ret = G_OK;
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "insert_request_jti - oidc - Error h_last_insert_id");
+      ret = G_ERROR_DB;
+    }
+    json_decref(j_last_index);
   } else {
-    if (!o_strnullempty(jti)) {
-      if ((jti_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, jti)) != NULL) {
-        j_query = json_pack("{sss[s]s{ssssss}}",
-                            "table",
-                            GLEWLWYD_PLUGIN_OIDC_TABLE_CLIENT_TOKEN_REQUEST,
-                            "columns",
-                              "gpoctr_id",
-                            "where",
-                              "gpoctr_plugin_name",
-                              config->name,
-                              "gpoctr_cient_id",
-                              iss,
-                              "gpoctr_jti_hash",
-                              jti_hash);
-        res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
-        json_decref(j_query);
-        if (res == H_OK) {
-          if (json_array_size(j_result)) {
-            y_log_message(Y_LOG_LEVEL_DEBUG, "check_request_jti_unused - jti already used for client '%s', origin %s", iss, ip_source);
-            ret = G_ERROR_UNAUTHORIZED;
-          } else {
-            j_query = json_pack("{sss{ssssssss}}",
-                                "table",
-                                GLEWLWYD_PLUGIN_OIDC_TABLE_CLIENT_TOKEN_REQUEST,
-                                "values",
-                                  "gpoctr_plugin_name",
-                                  config->name,
-                                  "gpoctr_cient_id",
-                                  iss,
-                                  "gpoctr_issued_for",
-                                  ip_source,
-                                  "gpoctr_jti_hash",
-                                  jti_hash);
-            res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
-            json_decref(j_query);
-            if (res == H_OK) {
-              j_last_index = h_last_insert_id(config->glewlwyd_config->glewlwyd_config->conn);
-              if (j_last_index != NULL) {
-                config->glewlwyd_config->glewlwyd_callback_update_issued_for(config->glewlwyd_config, NULL, GLEWLWYD_PLUGIN_OIDC_TABLE_CLIENT_TOKEN_REQUEST, "gpoctr_issued_for", ip_source, "gpoctr_id", json_integer_value(j_last_index));
-                ret = G_OK;
-              } else {
-                y_log_message(Y_LOG_LEVEL_ERROR, "check_request_jti_unused - oidc - Error h_last_insert_id");
-                ret = G_ERROR_DB;
-              }
-              json_decref(j_last_index);
-            } else {
-              y_log_message(Y_LOG_LEVEL_ERROR, "check_request_jti_unused - Error executing j_query (2)");
-              config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
-              ret = G_ERROR_DB;
-            }
-          }
-          json_decref(j_result);
+    y_log_message(Y_LOG_LEVEL_ERROR, "insert_request_jti - Error executing j_query");
+    glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+    ret = G_ERROR_DB;
+  }
+  return ret;
+}
+
+static void free_request_jti_insert(void * args) {
+  struct _request_jti_insert * jti_insert = (struct _request_jti_insert *)args;
+
+  o_free(jti_insert->plugin_name);
+  o_free(jti_insert->client_id);
+  o_free(jti_insert->jti_hash);
+  o_free(jti_insert->ip_source);
+  o_free(jti_insert);
+}
+
+static void run_request_jti_insert_job(void * args) {
+  struct _request_jti_insert * jti_insert = (struct _request_jti_insert *)args;
+
+  if (insert_request_jti(jti_insert->glewlwyd_config, jti_insert->plugin_name, jti_insert->client_id, jti_insert->jti_hash, jti_insert->ip_source) != G_OK) {
+    y_log_message(Y_LOG_LEVEL_ERROR, "run_request_jti_insert_job - Error insert_request_jti");
+  }
+  free_request_jti_insert(jti_insert);
+}
+
+/**
+ * Called when the job can't be queued or is cancelled by a plugin reset or the server stop,
+ * the jti is stored right away, otherwise it could be replayed once the in-memory cache is emptied
+ */
+static void cancel_request_jti_insert_job(void * args) {
+  struct _request_jti_insert * jti_insert = (struct _request_jti_insert *)args;
+
+  if (insert_request_jti(jti_insert->glewlwyd_config, jti_insert->plugin_name, jti_insert->client_id, jti_insert->jti_hash, jti_insert->ip_source) != G_OK) {
+    y_log_message(Y_LOG_LEVEL_ERROR, "cancel_request_jti_insert_job - Error insert_request_jti");
+  }
+  free_request_jti_insert(jti_insert);
+}
+
+/**
+ * Verifies in the database that this jti has not been used for another request
+ * If so, queues its storage in the database, or stores it right away if the job queue is full or the job is cancelled
+ */
+static int check_request_jti_database(struct _oidc_config * config, const char * jti, const char * iss, const char * ip_source) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
+  struct _request_jti_insert * jti_insert;
+  json_t * j_query, * j_result = NULL;
+  int ret, res;
+  char jti_hash[GLEWLWYD_HASH_BUFFER_SIZE];
+
+  if (config->glewlwyd_config->glewlwyd_callback_generate_hash_buffer(config->glewlwyd_config, jti, jti_hash, sizeof(jti_hash)) == G_OK) {
+    j_query = json_pack("{sss[s]s{ssssss}}",
+                        "table",
+                        GLEWLWYD_PLUGIN_OIDC_TABLE_CLIENT_TOKEN_REQUEST,
+                        "columns",
+                          "gpoctr_id",
+                        "where",
+                          "gpoctr_plugin_name",
+                          config->name,
+                          "gpoctr_cient_id",
+                          iss,
+                          "gpoctr_jti_hash",
+                          jti_hash);
+    res = h_select(conn, j_query, &j_result, NULL);
+    json_decref(j_query);
+    config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
+    if (res == H_OK) {
+      if (json_array_size(j_result)) {
+        y_log_message(Y_LOG_LEVEL_DEBUG, "check_request_jti_database - jti already used for client '%s', origin %s", iss, ip_source);
+        ret = G_ERROR_UNAUTHORIZED;
+      } else {
+        if ((jti_insert = o_malloc(sizeof(struct _request_jti_insert))) != NULL) {
+          jti_insert->glewlwyd_config = config->glewlwyd_config;
+          jti_insert->plugin_name = o_strdup(config->name);
+          jti_insert->client_id = o_strdup(iss);
+          jti_insert->jti_hash = o_strdup(jti_hash);
+          jti_insert->ip_source = o_strdup(ip_source);
+          // If the job can't be queued, it's stored right away by cancel_request_jti_insert_job
+          config->glewlwyd_config->glewlwyd_callback_job_submit(config->glewlwyd_config, GLEWLWYD_JOB_TYPE_DATABASE, NULL, config, &run_request_jti_insert_job, &cancel_request_jti_insert_job, jti_insert);
+          ret = G_OK;
         } else {
-          y_log_message(Y_LOG_LEVEL_ERROR, "check_request_jti_unused - Error executing j_query (1)");
-          config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
-          ret = G_ERROR_DB;
+          y_log_message(Y_LOG_LEVEL_ERROR, "check_request_jti_database - Error allocating resources for jti_insert");
+          ret = G_ERROR_MEMORY;
+        }
+      }
+      json_decref(j_result);
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "check_request_jti_database - Error executing j_query");
+      config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+      ret = G_ERROR_DB;
+    }
+  } else {
+    config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
+    y_log_message(Y_LOG_LEVEL_ERROR, "check_request_jti_database - oidc - Error glewlwyd_callback_generate_hash_buffer");
+    ret = G_ERROR;
+  }
+  return ret;
+}
+
+/**
+ * Verifies that this jti has not been used for another request
+ * The jti is kept in memory until the request expires,
+ * and stored in the database too if request-jti-persist is set
+ */
+static int check_request_jti_unused(struct _oidc_config * config, const char * jti, json_int_t exp, const char * iss, const char * ip_source) {
+  int ret;
+
+  if (!o_strnullempty(jti)) {
+    ret = glewlwyd_replay_cache_check_and_set(&config->request_jti_cache, iss, jti, (time_t)exp+1);
+    if (ret == G_OK) {
+      if (config->request_jti_persist) {
+        ret = check_request_jti_database(config, jti, iss, ip_source);
+        if (ret != G_OK && ret != G_ERROR_UNAUTHORIZED) {
+          glewlwyd_replay_cache_remove(&config->request_jti_cache, iss, jti);
         }
-        o_free(jti_hash);
-      } else {
-        y_log_message(Y_LOG_LEVEL_ERROR, "serialize_client_register - oidc - Error glewlwyd_callback_generate_hash");
-        ret = G_ERROR;
       }
+    } else if (ret == G_ERROR_UNAUTHORIZED) {
+      y_log_message(Y_LOG_LEVEL_DEBUG, "check_request_jti_unused - jti already used for client '%s', origin %s", iss, ip_source);
     } else {
-      y_log_message(Y_LOG_LEVEL_DEBUG, "check_request_jti_unused - no jti in jwt request for client '%s', origin %s", iss, ip_source);
-      ret = G_ERROR_PARAM;
+      y_log_message(Y_LOG_LEVEL_ERROR, "check_request_jti_unused - Error glewlwyd_replay_cache_check_and_set");
     }
-    pthread_mutex_unlock(&config->insert_lock);
+  } else {
+    y_log_message(Y_LOG_LEVEL_DEBUG, "check_request_jti_unused - no jti in jwt request for client '%s', origin %s", iss, ip_source);
+    ret = G_ERROR_PARAM;
   }
   return ret;
 }
@@ -6266,7 +6976,7 @@ static json_t * validate_jwt_assertion_request(struct _oidc_config * config, con
                                        R_JWT_CLAIM_NOP) == RHN_OK &&
             (json_object_get(config->j_params, "oauth-fapi-verify-nbf") != json_true() || r_jwt_validate_claims(jwt, R_JWT_CLAIM_NBF, R_JWT_CLAIM_NOW, R_JWT_CLAIM_NOP) == RHN_OK) &&
             ((r_jwt_get_claim_int_value(jwt, "exp") - j_now) <= config->auth_token_max_age) &&
-            check_request_jti_unused(config, r_jwt_get_claim_str_value(jwt, "jti"), r_jwt_get_claim_str_value(jwt, "iss"), ip_source) == G_OK) {
+            check_request_jti_unused(config, r_jwt_get_claim_str_value(jwt, "jti"), r_jwt_get_claim_int_value(jwt, "exp"), r_jwt_get_claim_str_value(jwt, "iss"), ip_source) == G_OK) {
           j_return = json_pack("{sisosOsO}", "result", G_OK, "request", r_jwt_get_full_claims_json_t(jwt), "client", json_object_get(j_result, "client"), "client_auth_method", json_object_get(j_result, "client_auth_method"));
         } else {
           y_log_message(Y_LOG_LEVEL_ERROR, "invalid jwt assertion content");
@@ -6300,11 +7010,12 @@ static json_t * validate_jwt_assertion_request(struct _oidc_config * config, con
 }
 
 static int revoke_refresh_token(struct _oidc_config * config, const char * token) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res, ret;
-  char * token_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, token);
+  char token_hash[GLEWLWYD_HASH_BUFFER_SIZE];
 
-  if (token_hash != NULL) {
+  if (config->glewlwyd_config->glewlwyd_callback_generate_hash_buffer(config->glewlwyd_config, token, token_hash, sizeof(token_hash)) == G_OK) {
     j_query = json_pack("{sss{si}s{ssss}}",
                         "table",
                         GLEWLWYD_PLUGIN_OIDC_TABLE_REFRESH_TOKEN,
@@ -6316,8 +7027,7 @@ static int revoke_refresh_token(struct _oidc_config * config, const char * token
                           config->name,
                           "gpor_token_hash",
                           token_hash);
-    o_free(token_hash);
-    res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       ret = G_OK;
@@ -6327,18 +7037,20 @@ static int revoke_refresh_token(struct _oidc_config * config, const char * token
       ret = G_ERROR_DB;
     }
   } else {
-    y_log_message(Y_LOG_LEVEL_ERROR, "revoke_refresh_token - Error glewlwyd_callback_generate_hash");
+    y_log_message(Y_LOG_LEVEL_ERROR, "revoke_refresh_token - Error glewlwyd_callback_generate_hash_buffer");
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static int revoke_access_token(struct _oidc_config * config, const char * token) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res, ret;
-  char * token_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, token);
+  char token_hash[GLEWLWYD_HASH_BUFFER_SIZE];
 
-  if (token_hash != NULL) {
+  if (config->glewlwyd_config->glewlwyd_callback_generate_hash_buffer(config->glewlwyd_config, token, token_hash, sizeof(token_hash)) == G_OK) {
     j_query = json_pack("{sss{si}s{ssss}}",
                         "table",
                         GLEWLWYD_PLUGIN_OIDC_TABLE_ACCESS_TOKEN,
@@ -6350,8 +7062,7 @@ static int revoke_access_token(struct _oidc_config * config, const char * token)
                           config->name,
                           "gpoa_token_hash",
                           token_hash);
-    o_free(token_hash);
-    res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       ret = G_OK;
@@ -6361,18 +7072,20 @@ static int revoke_access_token(struct _oidc_config * config, const char * token)
       ret = G_ERROR_DB;
     }
   } else {
-    y_log_message(Y_LOG_LEVEL_ERROR, "revoke_access_token - Error glewlwyd_callback_generate_hash");
+    y_log_message(Y_LOG_LEVEL_ERROR, "revoke_access_token - Error glewlwyd_callback_generate_hash_buffer");
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static int revoke_id_token(struct _oidc_config * config, const char * token) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res, ret;
-  char * token_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, token);
+  char token_hash[GLEWLWYD_HASH_BUFFER_SIZE];
 
-  if (token_hash != NULL) {
+  if (config->glewlwyd_config->glewlwyd_callback_generate_hash_buffer(config->glewlwyd_config, token, token_hash, sizeof(token_hash)) == G_OK) {
     j_query = json_pack("{sss{si}s{ssss}}",
                         "table",
                         GLEWLWYD_PLUGIN_OIDC_TABLE_ID_TOKEN,
@@ -6384,8 +7097,7 @@ static int revoke_id_token(struct _oidc_config * config, const char * token) {
                           config->name,
                           "gpoi_hash",
                           token_hash);
-    o_free(token_hash);
-    res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       ret = G_OK;
@@ -6395,26 +7107,28 @@ static int revoke_id_token(struct _oidc_config * config, const char * token) {
       ret = G_ERROR_DB;
     }
   } else {
-    y_log_message(Y_LOG_LEVEL_ERROR, "revoke_id_token - Error glewlwyd_callback_generate_hash");
+    y_log_message(Y_LOG_LEVEL_ERROR, "revoke_id_token - Error glewlwyd_callback_generate_hash_buffer");
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static json_t * get_token_metadata(struct _oidc_config * config, const char * token, const char * token_type_hint, const char * client_id) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result, * j_result_scope, * j_return = NULL, * j_element = NULL, * j_client = NULL, * j_cnf = NULL, * j_claims;
   int res, found_refresh = 0, found_access = 0, found_id_token = 0;
   size_t index = 0;
-  char * token_hash = NULL, * scope_list = NULL, * expires_at_clause = NULL, * sub = NULL;
+  char token_hash[GLEWLWYD_HASH_BUFFER_SIZE], * scope_list = NULL, * expires_at_clause = NULL, * sub = NULL;
   time_t now;
   jwt_t * jwt = NULL;
 
   if (!o_strnullempty(token)) {
-    if ((token_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, token)) != NULL) {
+    if (config->glewlwyd_config->glewlwyd_callback_generate_hash_buffer(config->glewlwyd_config, token, token_hash, sizeof(token_hash)) == G_OK) {
       time(&now);
-      if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+      if (conn->type==HOEL_DB_TYPE_MARIADB) {
         expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-      } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+      } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
         expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
       } else { // HOEL_DB_TYPE_SQLITE
         expires_at_clause = msprintf("> %u", (now));
@@ -6428,9 +7142,9 @@ static json_t * get_token_metadata(struct _oidc_config * config, const char * to
                               "gpor_username AS username",
                               "gpor_client_id AS client_id",
                               "gpor_client_id AS aud",
-                              SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpor_issued_at) AS iat", "gpor_issued_at AS iat", "EXTRACT(EPOCH FROM gpor_issued_at)::integer AS iat"),
-                              SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpor_issued_at) AS nbf", "gpor_issued_at AS nbf", "EXTRACT(EPOCH FROM gpor_issued_at)::integer AS nbf"),
-                              SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpor_expires_at) AS exp", "gpor_expires_at AS exp", "EXTRACT(EPOCH FROM gpor_expires_at)::integer AS exp"),
+                              SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpor_issued_at) AS iat", "gpor_issued_at AS iat", "EXTRACT(EPOCH FROM gpor_issued_at)::integer AS iat"),
+                              SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpor_issued_at) AS nbf", "gpor_issued_at AS nbf", "EXTRACT(EPOCH FROM gpor_issued_at)::integer AS nbf"),
+                              SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpor_expires_at) AS exp", "gpor_expires_at AS exp", "EXTRACT(EPOCH FROM gpor_expires_at)::integer AS exp"),
                               "gpor_enabled",
                             "where",
                               "gpor_plugin_name",
@@ -6445,7 +7159,7 @@ static json_t * get_token_metadata(struct _oidc_config * config, const char * to
         if (client_id != NULL) {
           json_object_set_new(json_object_get(j_query, "where"), "gpor_client_id", json_string(client_id));
         }
-        res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+        res = h_select(conn, j_query, &j_result, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           if (json_array_size(j_result)) {
@@ -6479,7 +7193,7 @@ static json_t * get_token_metadata(struct _oidc_config * config, const char * to
                                   "where",
                                     "gpor_id",
                                     json_object_get(json_array_get(j_result, 0), "gpor_id"));
-              res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result_scope, NULL);
+              res = h_select(conn, j_query, &j_result_scope, NULL);
               json_decref(j_query);
               if (res == H_OK) {
                 json_array_foreach(j_result_scope, index, j_element) {
@@ -6523,8 +7237,8 @@ static json_t * get_token_metadata(struct _oidc_config * config, const char * to
                               "gpoa_username AS username",
                               "gpoa_client_id AS client_id",
                               "gpoa_resource AS aud",
-                              SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpoa_issued_at) AS iat", "gpoa_issued_at AS iat", "EXTRACT(EPOCH FROM gpoa_issued_at)::integer AS iat"),
-                              SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpoa_issued_at) AS nbf", "gpoa_issued_at AS nbf", "EXTRACT(EPOCH FROM gpoa_issued_at)::integer AS nbf"),
+                              SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpoa_issued_at) AS iat", "gpoa_issued_at AS iat", "EXTRACT(EPOCH FROM gpoa_issued_at)::integer AS iat"),
+                              SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpoa_issued_at) AS nbf", "gpoa_issued_at AS nbf", "EXTRACT(EPOCH FROM gpoa_issued_at)::integer AS nbf"),
                               "gpoa_jti as jti",
                               "gpoa_authorization_details",
                               "gpoa_enabled",
@@ -6536,7 +7250,7 @@ static json_t * get_token_metadata(struct _oidc_config * config, const char * to
         if (client_id != NULL) {
           json_object_set_new(json_object_get(j_query, "where"), "gpoa_client_id", json_string(client_id));
         }
-        res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+        res = h_select(conn, j_query, &j_result, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           if (json_array_size(j_result)) {
@@ -6574,7 +7288,7 @@ static json_t * get_token_metadata(struct _oidc_config * config, const char * to
                                   "where",
                                     "gpoa_id",
                                     json_object_get(json_array_get(j_result, 0), "gpoa_id"));
-              res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result_scope, NULL);
+              res = h_select(conn, j_query, &j_result_scope, NULL);
               json_decref(j_query);
               if (res == H_OK) {
                 json_array_foreach(j_result_scope, index, j_element) {
@@ -6643,8 +7357,8 @@ static json_t * get_token_metadata(struct _oidc_config * config, const char * to
                               "gpoi_client_id AS client_id",
                               "gpoi_client_id AS aud",
                               "gpoi_sid AS sid",
-                              SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpoi_issued_at) AS iat", "gpoi_issued_at AS iat", "EXTRACT(EPOCH FROM gpoi_issued_at)::integer AS iat"),
-                              SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpoi_issued_at) AS nbf", "gpoi_issued_at AS nbf", "EXTRACT(EPOCH FROM gpoi_issued_at)::integer AS nbf"),
+                              SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpoi_issued_at) AS iat", "gpoi_issued_at AS iat", "EXTRACT(EPOCH FROM gpoi_issued_at)::integer AS iat"),
+                              SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpoi_issued_at) AS nbf", "gpoi_issued_at AS nbf", "EXTRACT(EPOCH FROM gpoi_issued_at)::integer AS nbf"),
                               "gpoi_enabled",
                             "where",
                               "gpoi_plugin_name",
@@ -6654,7 +7368,7 @@ static json_t * get_token_metadata(struct _oidc_config * config, const char * to
         if (client_id != NULL) {
           json_object_set_new(json_object_get(j_query, "where"), "gpoi_client_id", json_string(client_id));
         }
-        res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+        res = h_select(conn, j_query, &j_result, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           if (json_array_size(j_result)) {
@@ -6702,14 +7416,14 @@ static json_t * get_token_metadata(struct _oidc_config * config, const char * to
         j_return = json_pack("{sis{so}}", "result", G_OK, "token", "active", json_false());
       }
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "get_token_metadata - Error glewlwyd_callback_generate_hash");
+      y_log_message(Y_LOG_LEVEL_ERROR, "get_token_metadata - Error glewlwyd_callback_generate_hash_buffer");
       j_return = json_pack("{si}", "result", G_ERROR);
     }
-    o_free(token_hash);
     o_free(expires_at_clause);
   } else {
     j_return = json_pack("{si}", "result", G_ERROR_PARAM);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
@@ -6813,6 +7527,7 @@ static json_t * convert_client_registration_to_glewlwyd(json_t * j_registration)
 }
 
 static int client_registration_management_delete(struct _oidc_config * config, json_int_t gpocr_id, json_t * j_client) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   int ret, res;
   json_t * j_query;
 
@@ -6827,7 +7542,7 @@ static int client_registration_management_delete(struct _oidc_config * config, j
                         "where",
                           "gpocr_id",
                           gpocr_id);
-    res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res != H_OK) {
       y_log_message(Y_LOG_LEVEL_DEBUG, "client_registration_management_delete - Error executing j_query");
@@ -6840,10 +7555,12 @@ static int client_registration_management_delete(struct _oidc_config * config, j
     y_log_message(Y_LOG_LEVEL_ERROR, "client_registration_management_delete - Error glewlwyd_plugin_callback_set_client");
     ret = G_ERROR;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static json_t * check_client_registration_management_at(struct _oidc_config * config, const char * client_id, const char * management_at) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result = NULL, * j_client, * j_return;
   int res;
   char * management_at_hash;
@@ -6860,7 +7577,7 @@ static json_t * check_client_registration_management_at(struct _oidc_config * co
                             "gpocr_management_at_hash",
                             management_at_hash);
       o_free(management_at_hash);
-      res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+      res = h_select(conn, j_query, &j_result, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         if (json_array_size(j_result)) {
@@ -6884,7 +7601,7 @@ static json_t * check_client_registration_management_at(struct _oidc_config * co
                                 "where",
                                   "gpocr_id",
                                   json_object_get(json_array_get(j_result, 0), "gpocr_id"));
-            res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+            res = h_update(conn, j_query, NULL);
             json_decref(j_query);
             if (res != H_OK) {
               y_log_message(Y_LOG_LEVEL_DEBUG, "check_client_registration_management_at - Error executing j_query (2)");
@@ -6908,95 +7625,91 @@ static json_t * check_client_registration_management_at(struct _oidc_config * co
     y_log_message(Y_LOG_LEVEL_DEBUG, "check_client_registration_management_at - Missing or invalid access token");
     j_return = json_pack("{si}", "result", G_ERROR_PARAM);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
 static int serialize_client_register(struct _oidc_config * config, const struct _u_request * request, json_t * j_client, const char * client_management_at) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result, * j_last_index;
   int res, ret = G_OK;
   char * issued_for = get_client_hostname(request), * access_token_hash = NULL, * management_at_hash = NULL;
   json_int_t gpoa_id = 0;
 
-  if (pthread_mutex_lock(&config->insert_lock)) {
-    y_log_message(Y_LOG_LEVEL_ERROR, "serialize_client_register - oidc - Error pthread_mutex_lock");
-    ret = G_ERROR;
-  } else {
-    if (json_array_size(json_object_get(config->j_params, "register-client-auth-scope"))) {
-      if ((access_token_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, (u_map_get_case(request->map_header, GLEWLWYD_HEADER_AUTHORIZATION) + o_strlen(GLEWLWYD_HEADER_PREFIX_BEARER)))) != NULL) {
-        j_query = json_pack("{sss[s]s{ssss}}",
-                            "table",
-                            GLEWLWYD_PLUGIN_OIDC_TABLE_ACCESS_TOKEN,
-                            "columns",
-                              "gpoa_id",
-                            "where",
-                              "gpoa_plugin_name",
-                              config->name,
-                              "gpoa_token_hash",
-                              access_token_hash);
-        res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
-        json_decref(j_query);
-        if (res == H_OK) {
-          if (json_array_size(j_result)) {
-            gpoa_id = json_integer_value(json_object_get(json_array_get(j_result, 0), "gpoa_id"));
-          } else {
-            ret = G_ERROR_PARAM;
-          }
-          json_decref(j_result);
-        } else {
-          y_log_message(Y_LOG_LEVEL_ERROR, "serialize_client_register - Error executing j_query (1)");
-          config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
-          ret = G_ERROR_DB;
-        }
-      } else {
-        y_log_message(Y_LOG_LEVEL_ERROR, "serialize_client_register - Error glewlwyd_callback_generate_hash");
-        ret = G_ERROR;
-      }
-    }
-    if (ret == G_OK) {
-      if (!o_strnullempty(client_management_at)) {
-        management_at_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, client_management_at);
-      } else {
-        management_at_hash = o_strdup("disabled");
-      }
-      j_query = json_pack("{sss{sssOssss*ss?}}",
+  if (json_array_size(json_object_get(config->j_params, "register-client-auth-scope"))) {
+    if ((access_token_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, (u_map_get_case(request->map_header, GLEWLWYD_HEADER_AUTHORIZATION) + o_strlen(GLEWLWYD_HEADER_PREFIX_BEARER)))) != NULL) {
+      j_query = json_pack("{sss[s]s{ssss}}",
                           "table",
-                          GLEWLWYD_PLUGIN_OIDC_TABLE_CLIENT_REGISTRATION,
-                          "values",
-                            "gpocr_plugin_name",
+                          GLEWLWYD_PLUGIN_OIDC_TABLE_ACCESS_TOKEN,
+                          "columns",
+                            "gpoa_id",
+                          "where",
+                            "gpoa_plugin_name",
                             config->name,
-                            "gpocr_cient_id",
-                            json_object_get(j_client, "client_id"),
-                            "gpocr_issued_for",
-                            issued_for,
-                            "gpocr_user_agent",
-                            u_map_get_case(request->map_header, "user-agent"),
-                            "gpocr_management_at_hash",
-                            management_at_hash);
-      if (gpoa_id) {
-        json_object_set_new(json_object_get(j_query, "values"), "gpoa_id", json_integer(gpoa_id));
-      }
-      res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+                            "gpoa_token_hash",
+                            access_token_hash);
+      res = h_select(conn, j_query, &j_result, NULL);
       json_decref(j_query);
       if (res == H_OK) {
-        j_last_index = h_last_insert_id(config->glewlwyd_config->glewlwyd_config->conn);
-        if (j_last_index != NULL) {
-          config->glewlwyd_config->glewlwyd_callback_update_issued_for(config->glewlwyd_config, NULL, GLEWLWYD_PLUGIN_OIDC_TABLE_CLIENT_REGISTRATION, "gpocr_issued_for", issued_for, "gpocr_id", json_integer_value(j_last_index));
+        if (json_array_size(j_result)) {
+          gpoa_id = json_integer_value(json_object_get(json_array_get(j_result, 0), "gpoa_id"));
         } else {
-          y_log_message(Y_LOG_LEVEL_ERROR, "serialize_client_register - oidc - Error h_last_insert_id");
-          ret = G_ERROR_DB;
+          ret = G_ERROR_PARAM;
         }
-        json_decref(j_last_index);
+        json_decref(j_result);
       } else {
-        y_log_message(Y_LOG_LEVEL_ERROR, "serialize_client_register - Error executing j_query (2)");
+        y_log_message(Y_LOG_LEVEL_ERROR, "serialize_client_register - Error executing j_query (1)");
         config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
         ret = G_ERROR_DB;
       }
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "serialize_client_register - Error glewlwyd_callback_generate_hash");
+      ret = G_ERROR;
+    }
+  }
+  if (ret == G_OK) {
+    if (!o_strnullempty(client_management_at)) {
+      management_at_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, client_management_at);
+    } else {
+      management_at_hash = o_strdup("disabled");
+    }
+    j_query = json_pack("{sss{sssOssss*ss?}}",
+                        "table",
+                        GLEWLWYD_PLUGIN_OIDC_TABLE_CLIENT_REGISTRATION,
+                        "values",
+                          "gpocr_plugin_name",
+                          config->name,
+                          "gpocr_cient_id",
+                          json_object_get(j_client, "client_id"),
+                          "gpocr_issued_for",
+                          issued_for,
+                          "gpocr_user_agent",
+                          u_map_get_case(request->map_header, "user-agent"),
+                          "gpocr_management_at_hash",
+                          management_at_hash);
+    if (gpoa_id) {
+      json_object_set_new(json_object_get(j_query, "values"), "gpoa_id", json_integer(gpoa_id));
+    }
+    res = config->glewlwyd_config->glewlwyd_callback_db_insert(config->glewlwyd_config, conn, j_query, "gpocr_id", &j_last_index);
+    json_decref(j_query);
+    if (res == H_OK) {
+      if (j_last_index != NULL) {
+        config->glewlwyd_config->glewlwyd_callback_update_issued_for(config->glewlwyd_config, NULL, GLEWLWYD_PLUGIN_OIDC_TABLE_CLIENT_REGISTRATION, "gpocr_issued_for", issued_for, "gpocr_id", json_integer_value(j_last_index));
+      } else {
+        y_log_message(Y_LOG_LEVEL_ERROR, "serialize_client_register - oidc - Error h_last_insert_id");
+        ret = G_ERROR_DB;
+      }
+      json_decref(j_last_index);
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "serialize_client_register - Error executing j_query (2)");
+      config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+      ret = G_ERROR_DB;
     }
-    o_free(access_token_hash);
-    o_free(management_at_hash);
-    pthread_mutex_unlock(&config->insert_lock);
   }
+  o_free(access_token_hash);
+  o_free(management_at_hash);
   o_free(issued_for);
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
@@ -7820,7 +8533,6 @@ static char * build_jwt_auth_response(struct _oidc_config * config, json_t * j_c
   } else {
     y_log_message(Y_LOG_LEVEL_ERROR, "build_jwt_auth_response - oidc - Error no jwk available");
   }
-  r_jwk_free(jwk);
   if (token != NULL) {
     out_token = encrypt_token_if_required(config, token, j_client, GLEWLWYD_TOKEN_TYPE_AUTH, enc_res);
     o_free(token);
@@ -8006,6 +8718,7 @@ static char * generate_session_state(const char * client_id, const char * redire
 }
 
 static json_t * generate_device_authorization(struct _oidc_config * config, const char * client_id, const char * scope_list, const char * resource, json_t * j_authorization_details, const char * dpop_jkt, const char * ip_source) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   char device_code[GLEWLWYD_DEVICE_AUTH_DEVICE_CODE_LENGTH+1] = {0}, user_code[GLEWLWYD_DEVICE_AUTH_USER_CODE_LENGTH+2] = {0}, * device_code_hash = NULL, * user_code_hash = NULL;
   json_t * j_return, * j_query, * j_device_auth_id;
   int res;
@@ -8013,102 +8726,99 @@ static json_t * generate_device_authorization(struct _oidc_config * config, cons
   char * expires_at_clause = NULL, * last_check_clause = NULL, ** scope_array = NULL, * str_authorization_details = NULL;
   size_t i;
 
-  if (pthread_mutex_lock(&config->insert_lock)) {
-    y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization oidc - Error pthread_mutex_lock");
-    j_return = json_pack("{si}", "result", G_ERROR);
-  } else {
-    if (rand_string(device_code, 32) != NULL && rand_string_from_charset(user_code, GLEWLWYD_DEVICE_AUTH_USER_CODE_LENGTH+1, "ABCDEFGHJKLMNOPQRSTUVWXYZ0123456789") != NULL) {
-      user_code[4] = '-';
-      device_code_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, device_code);
-      user_code_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, user_code);
-      if (device_code_hash != NULL && user_code_hash != NULL) {
-        time(&now);
-        if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
-          expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + expiration));
-          last_check_clause = msprintf("FROM_UNIXTIME(%u)", (now - (2*expiration)));
-        } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
-          expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + expiration));
-          last_check_clause = msprintf("TO_TIMESTAMP(%u)", (now - (2*expiration)));
-        } else { // HOEL_DB_TYPE_SQLITE
-          expires_at_clause = msprintf("%u", (now + expiration));
-          last_check_clause = msprintf("%u", (now - (2*expiration)));
-        }
-        if (j_authorization_details != NULL) {
-          str_authorization_details = json_dumps(j_authorization_details, JSON_COMPACT);
-        }
-        j_query = json_pack("{sss{sssss{ss}sssssss{ss}ss?ss?ss?}}",
-                            "table",
-                            GLEWLWYD_PLUGIN_OIDC_TABLE_DEVICE_AUTHORIZATION,
-                            "values",
-                              "gpoda_plugin_name", config->name,
-                              "gpoda_client_id", client_id,
-                              "gpoda_expires_at",
-                                "raw",
-                                expires_at_clause,
-                              "gpoda_issued_for", ip_source,
-                              "gpoda_device_code_hash", device_code_hash,
-                              "gpoda_user_code_hash", user_code_hash,
-                              "gpoda_last_check",
-                                "raw",
-                                last_check_clause,
-                              "gpoda_resource", resource,
-                              "gpoda_authorization_details", str_authorization_details,
-                              "gpoda_dpop_jkt", dpop_jkt);
-        o_free(expires_at_clause);
-        o_free(last_check_clause);
-        o_free(str_authorization_details);
-        res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
-        json_decref(j_query);
-        if (res == H_OK) {
-          j_device_auth_id = h_last_insert_id(config->glewlwyd_config->glewlwyd_config->conn);
-          if (j_device_auth_id != NULL) {
-            config->glewlwyd_config->glewlwyd_callback_update_issued_for(config->glewlwyd_config, NULL, GLEWLWYD_PLUGIN_OIDC_TABLE_DEVICE_AUTHORIZATION, "gpoda_issued_for", ip_source, "gpoda_id", json_integer_value(j_device_auth_id));
-            if (split_string(scope_list, " ", &scope_array) > 0) {
-              j_query = json_pack("{sss[]}", "table", GLEWLWYD_PLUGIN_OIDC_TABLE_DEVICE_AUTHORIZATION_SCOPE, "values");
-              for (i=0; scope_array[i]!=NULL; i++) {
-                json_array_append_new(json_object_get(j_query, "values"), json_pack("{sOss}", "gpoda_id", j_device_auth_id, "gpodas_scope", scope_array[i]));
-              }
-              res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
-              json_decref(j_query);
-              if (res == H_OK) {
-                j_return = json_pack("{sis{ssss}}", "result", G_OK, "authorization", "device_code", device_code, "user_code", user_code);
-              } else {
-                y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization - Error executing j_query (2)");
-                config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
-                j_return = json_pack("{si}", "result", G_ERROR_DB);
-              }
+  if (rand_string(device_code, 32) != NULL && rand_string_from_charset(user_code, GLEWLWYD_DEVICE_AUTH_USER_CODE_LENGTH+1, "ABCDEFGHJKLMNOPQRSTUVWXYZ0123456789") != NULL) {
+    user_code[4] = '-';
+    device_code_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, device_code);
+    user_code_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, user_code);
+    if (device_code_hash != NULL && user_code_hash != NULL) {
+      time(&now);
+      if (conn->type==HOEL_DB_TYPE_MARIADB) {
+        expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + expiration));
+        last_check_clause = msprintf("FROM_UNIXTIME(%u)", (now - (2*expiration)));
+      } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
+        expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + expiration));
+        last_check_clause = msprintf("TO_TIMESTAMP(%u)", (now - (2*expiration)));
+      } else { // HOEL_DB_TYPE_SQLITE
+        expires_at_clause = msprintf("%u", (now + expiration));
+        last_check_clause = msprintf("%u", (now - (2*expiration)));
+      }
+      if (j_authorization_details != NULL) {
+        str_authorization_details = json_dumps(j_authorization_details, JSON_COMPACT);
+      }
+      j_query = json_pack("{sss{sssss{ss}sssssss{ss}ss?ss?ss?}}",
+                          "table",
+                          GLEWLWYD_PLUGIN_OIDC_TABLE_DEVICE_AUTHORIZATION,
+                          "values",
+                            "gpoda_plugin_name", config->name,
+                            "gpoda_client_id", client_id,
+                            "gpoda_expires_at",
+                              "raw",
+                              expires_at_clause,
+                            "gpoda_issued_for", ip_source,
+                            "gpoda_device_code_hash", device_code_hash,
+                            "gpoda_user_code_hash", user_code_hash,
+                            "gpoda_last_check",
+                              "raw",
+                              last_check_clause,
+                            "gpoda_resource", resource,
+                            "gpoda_authorization_details", str_authorization_details,
+                            "gpoda_dpop_jkt", dpop_jkt);
+      o_free(expires_at_clause);
+      o_free(last_check_clause);
+      o_free(str_authorization_details);
+      config->glewlwyd_config->glewlwyd_callback_db_insert_begin(config->glewlwyd_config, conn);
+      res = config->glewlwyd_config->glewlwyd_callback_db_insert(config->glewlwyd_config, conn, j_query, "gpoda_id", &j_device_auth_id);
+      json_decref(j_query);
+      if (res == H_OK) {
+        if (j_device_auth_id != NULL) {
+          config->glewlwyd_config->glewlwyd_callback_update_issued_for(config->glewlwyd_config, NULL, GLEWLWYD_PLUGIN_OIDC_TABLE_DEVICE_AUTHORIZATION, "gpoda_issued_for", ip_source, "gpoda_id", json_integer_value(j_device_auth_id));
+          if (split_string(scope_list, " ", &scope_array) > 0) {
+            j_query = json_pack("{sss[]}", "table", GLEWLWYD_PLUGIN_OIDC_TABLE_DEVICE_AUTHORIZATION_SCOPE, "values");
+            for (i=0; scope_array[i]!=NULL; i++) {
+              json_array_append_new(json_object_get(j_query, "values"), json_pack("{sOss}", "gpoda_id", j_device_auth_id, "gpodas_scope", scope_array[i]));
+            }
+            res = h_insert(conn, j_query, NULL);
+            json_decref(j_query);
+            if (res == H_OK) {
+              j_return = json_pack("{sis{ssss}}", "result", G_OK, "authorization", "device_code", device_code, "user_code", user_code);
             } else {
-              y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization - Error split_string scope");
-              j_return = json_pack("{si}", "result", G_ERROR);
+              y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization - Error executing j_query (2)");
+              config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+              j_return = json_pack("{si}", "result", G_ERROR_DB);
             }
-            free_string_array(scope_array);
           } else {
-            y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization - Error h_last_insert_id");
-            config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
-            j_return = json_pack("{si}", "result", G_ERROR_DB);
+            y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization - Error split_string scope");
+            j_return = json_pack("{si}", "result", G_ERROR);
           }
-          json_decref(j_device_auth_id);
+          free_string_array(scope_array);
         } else {
-          y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization - Error executing j_query (1)");
+          y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization - Error h_last_insert_id");
           config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
           j_return = json_pack("{si}", "result", G_ERROR_DB);
         }
+        json_decref(j_device_auth_id);
       } else {
-        y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization - Error glewlwyd_callback_generate_hash");
-        j_return = json_pack("{si}", "result", G_ERROR);
+        y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization - Error executing j_query (1)");
+        config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+        j_return = json_pack("{si}", "result", G_ERROR_DB);
       }
-      o_free(device_code_hash);
-      o_free(user_code_hash);
+      config->glewlwyd_config->glewlwyd_callback_db_insert_end(config->glewlwyd_config, conn);
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization - Error generating random code");
+      y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization - Error glewlwyd_callback_generate_hash");
       j_return = json_pack("{si}", "result", G_ERROR);
     }
-    pthread_mutex_unlock(&config->insert_lock);
+    o_free(device_code_hash);
+    o_free(user_code_hash);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "generate_device_authorization - Error generating random code");
+    j_return = json_pack("{si}", "result", G_ERROR);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
 static int validate_device_authorization_scope(struct _oidc_config * config, json_int_t gpoda_id, const char * username, const char * scope_list, json_t * j_amr, const char * sid) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   char * query, * scope_clause = NULL, * scope_escaped, ** scope_array = NULL, * username_escaped, * sid_sescaped;
   int res, i, ret;
   json_t * j_query, * j_element = NULL;
@@ -8116,7 +8826,7 @@ static int validate_device_authorization_scope(struct _oidc_config * config, jso
 
   if (split_string(scope_list, " ", &scope_array) > 0) {
     for (i=0; scope_array[i]!=NULL; i++) {
-      scope_escaped = h_escape_string_with_quotes(config->glewlwyd_config->glewlwyd_config->conn, scope_array[i]);
+      scope_escaped = h_escape_string_with_quotes(conn, scope_array[i]);
       if (scope_clause == NULL) {
         scope_clause = o_strdup(scope_escaped);
       } else {
@@ -8128,13 +8838,13 @@ static int validate_device_authorization_scope(struct _oidc_config * config, jso
   }
   if (!o_strnullempty(scope_clause)) {
     query = msprintf("UPDATE %s set gpodas_allowed=1 WHERE gpodas_scope IN (%s) AND gpoda_id=%"JSON_INTEGER_FORMAT, GLEWLWYD_PLUGIN_OIDC_TABLE_DEVICE_AUTHORIZATION_SCOPE, scope_clause, gpoda_id);
-    res = h_execute_query(config->glewlwyd_config->glewlwyd_config->conn, query, NULL, H_OPTION_EXEC);
+    res = h_execute_query(conn, query, NULL, H_OPTION_EXEC);
     o_free(query);
     if (res == H_OK) {
-      username_escaped = h_escape_string_with_quotes(config->glewlwyd_config->glewlwyd_config->conn, username);
-      sid_sescaped = h_escape_string_with_quotes(config->glewlwyd_config->glewlwyd_config->conn, sid);
+      username_escaped = h_escape_string_with_quotes(conn, username);
+      sid_sescaped = h_escape_string_with_quotes(conn, sid);
       query = msprintf("UPDATE %s set gpoda_status=1, gpoda_username=%s, gpoda_sid=%s WHERE gpoda_id=%"JSON_INTEGER_FORMAT, GLEWLWYD_PLUGIN_OIDC_TABLE_DEVICE_AUTHORIZATION, username_escaped, sid_sescaped, gpoda_id);
-      res = h_execute_query(config->glewlwyd_config->glewlwyd_config->conn, query, NULL, H_OPTION_EXEC);
+      res = h_execute_query(conn, query, NULL, H_OPTION_EXEC);
       o_free(username_escaped);
       o_free(sid_sescaped);
       o_free(query);
@@ -8144,7 +8854,7 @@ static int validate_device_authorization_scope(struct _oidc_config * config, jso
           json_array_foreach(j_amr, index, j_element) {
             json_array_append_new(json_object_get(j_query, "values"), json_pack("{sIsO}", "gpoda_id", gpoda_id, "gpodh_scheme_module", j_element));
           }
-          res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+          res = h_insert(conn, j_query, NULL);
           json_decref(j_query);
           if (res == H_OK) {
             ret = G_OK;
@@ -8171,10 +8881,12 @@ static int validate_device_authorization_scope(struct _oidc_config * config, jso
     ret = G_ERROR_PARAM;
   }
   o_free(scope_clause);
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static json_t * validate_device_auth_user_code(struct _oidc_config * config, const char * user_code) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query = NULL, * j_result = NULL, * j_result_scope = NULL, * j_return, * j_element = NULL;
   int res;
   char * scope = NULL, * expires_at_clause, * user_code_hash, user_code_ucase[GLEWLWYD_DEVICE_AUTH_USER_CODE_LENGTH+2] = {0};
@@ -8187,9 +8899,9 @@ static json_t * validate_device_auth_user_code(struct _oidc_config * config, con
     }
     user_code_ucase[GLEWLWYD_DEVICE_AUTH_USER_CODE_LENGTH+1] = '\0';
     time(&now);
-    if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
       expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-    } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
       expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
     } else { // HOEL_DB_TYPE_SQLITE
       expires_at_clause = msprintf("> %u", (now));
@@ -8215,7 +8927,7 @@ static json_t * validate_device_auth_user_code(struct _oidc_config * config, con
                             0);
       o_free(expires_at_clause);
       o_free(user_code_hash);
-      res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+      res = h_select(conn, j_query, &j_result, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         if (json_array_size(j_result)) {
@@ -8227,7 +8939,7 @@ static json_t * validate_device_auth_user_code(struct _oidc_config * config, con
                               "where",
                                 "gpoda_id",
                                 json_object_get(json_array_get(j_result, 0), "gpoda_id"));
-          res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result_scope, NULL);
+          res = h_select(conn, j_query, &j_result_scope, NULL);
           json_decref(j_query);
           if (res == H_OK) {
             json_array_foreach(j_result_scope, index, j_element) {
@@ -8261,6 +8973,7 @@ static json_t * validate_device_auth_user_code(struct _oidc_config * config, con
   } else {
     j_return = json_pack("{si}", "result", G_ERROR_NOT_FOUND);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
@@ -8271,6 +8984,7 @@ static int check_auth_type_device_code(const struct _u_request * request,
                                        const char * x5t_s256,
                                        int client_auth_method) {
   struct _oidc_config * config = (struct _oidc_config *)user_data;
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_body,
          * j_client,
          * j_query,
@@ -8336,8 +9050,8 @@ static int check_auth_type_device_code(const struct _u_request * request,
                               "gpoda_id",
                               "gpoda_username AS username",
                               "gpoda_status",
-                              SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpoda_expires_at) AS expires_at", "gpoda_expires_at AS expires_at", "EXTRACT(EPOCH FROM gpoda_expires_at)::integer AS expires_at"),
-                              SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpoda_last_check) AS last_check", "gpoda_last_check AS last_check", "EXTRACT(EPOCH FROM gpoda_last_check)::integer AS last_check"),
+                              SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpoda_expires_at) AS expires_at", "gpoda_expires_at AS expires_at", "EXTRACT(EPOCH FROM gpoda_expires_at)::integer AS expires_at"),
+                              SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpoda_last_check) AS last_check", "gpoda_last_check AS last_check", "EXTRACT(EPOCH FROM gpoda_last_check)::integer AS last_check"),
                               "gpoda_resource AS resource",
                               "gpoda_dpop_jkt AS dpop_jkt",
                               "gpoda_authorization_details",
@@ -8351,7 +9065,7 @@ static int check_auth_type_device_code(const struct _u_request * request,
                                 "value",
                                 "<= 1");
         o_free(device_code_hash);
-        res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+        res = h_select(conn, j_query, &j_result, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           if (json_array_size(j_result)) {
@@ -8372,7 +9086,7 @@ static int check_auth_type_device_code(const struct _u_request * request,
                                       json_object_get(json_array_get(j_result, 0), "gpoda_id"),
                                       "gpodas_allowed",
                                       1);
-                res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result_scope, NULL);
+                res = h_select(conn, j_query, &j_result_scope, NULL);
                 json_decref(j_query);
                 if (res == H_OK) {
                   json_array_foreach(j_result_scope, index, j_element) {
@@ -8393,7 +9107,7 @@ static int check_auth_type_device_code(const struct _u_request * request,
                                       "where",
                                         "gpoda_id",
                                         json_object_get(json_array_get(j_result, 0), "gpoda_id"));
-                  res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result_sheme, NULL);
+                  res = h_select(conn, j_query, &j_result_sheme, NULL);
                   json_decref(j_query);
                   if (res == H_OK) {
                     if ((j_amr = json_array()) != NULL) {
@@ -8573,7 +9287,7 @@ static int check_auth_type_device_code(const struct _u_request * request,
                                                                       "gpoda_status", 2,
                                                                     "where",
                                                                       "gpoda_id", json_object_get(json_array_get(j_result, 0), "gpoda_id"));
-                                                res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+                                                res = h_update(conn, j_query, NULL);
                                                 json_decref(j_query);
                                                 if (res == H_OK) {
                                                   j_body = json_pack("{ssssssss*sisIsssO*}",
@@ -8735,11 +9449,11 @@ static int check_auth_type_device_code(const struct _u_request * request,
                                     "set",
                                       "gpoda_last_check",
                                         "raw",
-                                        SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "CURRENT_TIMESTAMP", "strftime('%s','now')", "NOW()"),
+                                        SWITCH_DB_TYPE(conn->type, "CURRENT_TIMESTAMP", "strftime('%s','now')", "NOW()"),
                                     "where",
                                       "gpoda_id",
                                       json_object_get(json_array_get(j_result, 0), "gpoda_id"));
-                res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+                res = h_update(conn, j_query, NULL);
                 json_decref(j_query);
                 if (res == H_OK) {
                   if ((now - json_integer_value(json_object_get(json_array_get(j_result, 0), "last_check"))) >= json_integer_value(json_object_get(config->j_params, "device-authorization-interval"))) {
@@ -8785,6 +9499,8 @@ static int check_auth_type_device_code(const struct _u_request * request,
         ulfius_set_json_body_response(response, 500, j_body);
         json_decref(j_body);
       }
+    } else if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+      set_response_password_pool_unavailable(response);
     } else {
       y_log_message(Y_LOG_LEVEL_WARNING, "Security - Authorization invalid for client_id %s at IP Address %s", client_id, ip_source);
       j_body = json_pack("{ss}", "error", "unauthorized_client");
@@ -8801,6 +9517,7 @@ static int check_auth_type_device_code(const struct _u_request * request,
   }
   o_free(issued_for);
 
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return U_CALLBACK_CONTINUE;
 }
 
@@ -9027,6 +9744,169 @@ static json_t * check_client_certificate_valid(struct _oidc_config * config, con
   return j_return;
 }
 
+static void * static_body_zalloc(void * q, unsigned n, unsigned m) {
+  UNUSED(q);
+  return o_malloc((size_t)n * m);
+}
+
+static void static_body_zfree(void * q, void * p) {
+  UNUSED(q);
+  o_free(p);
+}
+
+/**
+ * Compresses data in one pass using gzip or deflate format
+ */
+static int compress_static_body(const char * data, size_t data_len, int gzip, char ** out, size_t * out_len) {
+  z_stream defstream;
+  int ret, res;
+  uLong bound;
+
+  memset(&defstream, 0, sizeof(z_stream));
+  defstream.zalloc = static_body_zalloc;
+  defstream.zfree = static_body_zfree;
+  defstream.opaque = Z_NULL;
+  if (gzip) {
+    res = deflateInit2(&defstream, Z_BEST_COMPRESSION, Z_DEFLATED, GLEWLWYD_STATIC_BODY_GZIP_WINDOW_BITS | GLEWLWYD_STATIC_BODY_GZIP_ENCODING, 8, Z_DEFAULT_STRATEGY);
+  } else {
+    res = deflateInit(&defstream, Z_BEST_COMPRESSION);
+  }
+  if (res == Z_OK) {
+    bound = deflateBound(&defstream, (uLong)data_len);
+    if ((*out = o_malloc((size_t)bound)) != NULL) {
+      defstream.next_in = (Bytef *)data;
+      defstream.avail_in = (uInt)data_len;
+      defstream.next_out = (Bytef *)*out;
+      defstream.avail_out = (uInt)bound;
+      if ((res = deflate(&defstream, Z_FINISH)) == Z_STREAM_END) {
+        *out_len = (size_t)defstream.total_out;
+        ret = G_OK;
+      } else {
+        y_log_message(Y_LOG_LEVEL_ERROR, "compress_static_body - Error deflate %d", res);
+        o_free(*out);
+        *out = NULL;
+        ret = G_ERROR;
+      }
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "compress_static_body - Error allocating resources for out");
+      ret = G_ERROR_MEMORY;
+    }
+    deflateEnd(&defstream);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "compress_static_body - Error deflateInit %d", res);
+    ret = G_ERROR;
+  }
+  return ret;
+}
+
+static void free_static_body(struct _oidc_static_body * static_body) {
+  o_free(static_body->etag);
+  o_free(static_body->etag_gzip);
+  o_free(static_body->etag_deflate);
+  o_free(static_body->gzip);
+  o_free(static_body->deflate);
+  memset(static_body, 0, sizeof(struct _oidc_static_body));
+}
+
+/**
+ * Builds the gzip and deflate variants of a response body and the strong ETag of each variant
+ */
+static int build_static_body(struct _oidc_static_body * static_body, const char * body) {
+  unsigned char digest[64] = {0}, digest_b64[128] = {0};
+  size_t digest_len = 64, digest_b64_len = 0, body_len = o_strlen(body);
+  int ret;
+
+  free_static_body(static_body);
+  if (generate_digest_raw(digest_SHA256, (const unsigned char *)body, body_len, digest, &digest_len) &&
+      o_base64url_encode(digest, digest_len, digest_b64, &digest_b64_len)) {
+    if ((static_body->etag = msprintf("\"%.*s\"", (int)digest_b64_len, digest_b64)) != NULL &&
+        (static_body->etag_gzip = msprintf("\"%.*s-gzip\"", (int)digest_b64_len, digest_b64)) != NULL &&
+        (static_body->etag_deflate = msprintf("\"%.*s-deflate\"", (int)digest_b64_len, digest_b64)) != NULL) {
+      if ((ret = compress_static_body(body, body_len, 1, &static_body->gzip, &static_body->gzip_len)) != G_OK) {
+        y_log_message(Y_LOG_LEVEL_ERROR, "build_static_body - Error compress_static_body gzip");
+      } else if ((ret = compress_static_body(body, body_len, 0, &static_body->deflate, &static_body->deflate_len)) != G_OK) {
+        y_log_message(Y_LOG_LEVEL_ERROR, "build_static_body - Error compress_static_body deflate");
+      }
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "build_static_body - Error allocating resources for etag list");
+      ret = G_ERROR_MEMORY;
+    }
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "build_static_body - Error generating digest");
+    ret = G_ERROR;
+  }
+  if (ret != G_OK) {
+    free_static_body(static_body);
+  }
+  return ret;
+}
+
+/**
+ * Returns true if the header If-None-Match matches the etag
+ * Weak comparison is used as specified in RFC 7232
+ */
+static int is_etag_matching(const char * if_none_match, const char * etag) {
+  char ** etag_list = NULL, * element;
+  size_t i;
+  int ret = 0;
+
+  if (split_string(if_none_match, ",", &etag_list)) {
+    for (i=0; etag_list[i]!=NULL && !ret; i++) {
+      element = trimwhitespace(etag_list[i]);
+      if (0 == o_strncmp(element, "W/", 2)) {
+        element += 2;
+      }
+      if (0 == o_strcmp(element, "*") || 0 == o_strcmp(element, etag)) {
+        ret = 1;
+      }
+    }
+  }
+  free_string_array(etag_list);
+  return ret;
+}
+
+/**
+ * Sets a static body response with its validator
+ * The variant is selected with Accept-Encoding, then 304 is returned
+ * if If-None-Match matches the ETag of this variant
+ */
+static void set_static_body_response(const struct _u_request * request, struct _u_response * response, const char * body, struct _oidc_static_body * static_body) {
+  char ** accept_list = NULL;
+  const char * etag = static_body->etag, * content_encoding = NULL, * variant = body;
+  size_t variant_len = o_strlen(body);
+
+  u_map_put(response->map_header, "Cache-Control", "no-cache");
+  u_map_put(response->map_header, "Referrer-Policy", "no-referrer");
+  if (etag != NULL) {
+    if (u_map_has_key_case(request->map_header, "Accept-Encoding") && split_string(u_map_get_case(request->map_header, "Accept-Encoding"), ",", &accept_list)) {
+      if (accept_list_has_coding(accept_list, "gzip")) {
+        etag = static_body->etag_gzip;
+        content_encoding = "gzip";
+        variant = static_body->gzip;
+        variant_len = static_body->gzip_len;
+      } else if (accept_list_has_coding(accept_list, "deflate")) {
+        etag = static_body->etag_deflate;
+        content_encoding = "deflate";
+        variant = static_body->deflate;
+        variant_len = static_body->deflate_len;
+      }
+    }
+    free_string_array(accept_list);
+    u_map_put(response->map_header, "ETag", etag);
+    u_map_put(response->map_header, "Vary", "Accept-Encoding");
+  }
+
+  if (etag != NULL && u_map_has_key_case(request->map_header, "If-None-Match") && is_etag_matching(u_map_get_case(request->map_header, "If-None-Match"), etag)) {
+    ulfius_set_empty_body_response(response, 304);
+  } else {
+    u_map_put(response->map_header, ULFIUS_HTTP_HEADER_CONTENT, ULFIUS_HTTP_ENCODING_JSON);
+    if (content_encoding != NULL) {
+      u_map_put(response->map_header, "Content-Encoding", content_encoding);
+    }
+    ulfius_set_binary_body_response(response, 200, variant, variant_len);
+  }
+}
+
 static int generate_discovery_content(struct _oidc_config * config) {
   json_t * j_discovery = json_object(), * j_element = NULL, * j_rhon_info = r_library_info_json_t(), * j_dpop_sign_pubkey = json_array(), * j_sign_pubkey = json_array(), * j_signing_alg = json_array(), * j_enc_list = NULL;
   jwks_t * jwks_res;
@@ -9330,7 +10210,10 @@ static int generate_discovery_content(struct _oidc_config * config) {
         json_object_set(j_discovery, "authorization_encryption_enc_values_supported", json_object_get(json_object_get(j_rhon_info, "jwe"), "enc"));
       }
     }
-    config->discovery_str = json_dumps(j_discovery, JSON_COMPACT);
+    if ((config->discovery_str = json_dumps(j_discovery, JSON_COMPACT)) == NULL || build_static_body(&config->discovery_body, config->discovery_str) != G_OK) {
+      y_log_message(Y_LOG_LEVEL_ERROR, "generate_discovery_content - Error build_static_body");
+      ret = G_ERROR;
+    }
   } else {
     y_log_message(Y_LOG_LEVEL_ERROR, "generate_discovery_content - Error allocating resources for j_discovery");
     ret = G_ERROR;
@@ -9393,6 +10276,7 @@ static json_t * authorization_details_element_access_enrich(json_t * j_rar_eleme
 }
 
 static int authorization_details_set_consent(struct _oidc_config * config, const char * type, const char * client_id, const char * username, int consent, const char * ip_source) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res, ret;
 
@@ -9406,7 +10290,7 @@ static int authorization_details_set_consent(struct _oidc_config * config, const
                         "gporar_client_id", client_id,
                         "gporar_type", type,
                         "gporar_username", username);
-  res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     y_log_message(Y_LOG_LEVEL_INFO, "Event oidc - Plugin '%s' - Rich Authorization Request consent type '%s' set to %s by user '%s' to client '%s', origin: %s", config->name, type, consent?"true":"false", username, client_id, ip_source);
@@ -9416,10 +10300,12 @@ static int authorization_details_set_consent(struct _oidc_config * config, const
     config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static int authorization_details_add_consent(struct _oidc_config * config, const char * type, const char * client_id, const char * username, int consent, const char * ip_source) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res, ret;
 
@@ -9432,7 +10318,7 @@ static int authorization_details_add_consent(struct _oidc_config * config, const
                         "gporar_client_id", client_id,
                         "gporar_type", type,
                         "gporar_username", username);
-  res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+  res = h_insert(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     y_log_message(Y_LOG_LEVEL_INFO, "Event oidc - Plugin '%s' - Rich Authorization Request consent type '%s' set to %s by user '%s' to client '%s', origin: %s", config->name, type, consent?"true":"false", username, client_id, ip_source);
@@ -9442,10 +10328,12 @@ static int authorization_details_add_consent(struct _oidc_config * config, const
     config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static int authorization_details_delete_consent(struct _oidc_config * config, const char * type, const char * client_id, const char * username, const char * ip_source) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res, ret;
 
@@ -9457,7 +10345,7 @@ static int authorization_details_delete_consent(struct _oidc_config * config, co
                         "gporar_client_id", client_id,
                         "gporar_type", type,
                         "gporar_username", username);
-  res = h_delete(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+  res = h_delete(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     y_log_message(Y_LOG_LEVEL_INFO, "Event oidc - Plugin '%s' - Rich Authorization Request consent type '%s' deleted by user '%s' to client '%s', origin: %s", config->name, type, username, client_id, ip_source);
@@ -9467,10 +10355,12 @@ static int authorization_details_delete_consent(struct _oidc_config * config, co
     config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static json_t * authorization_details_get_consent(struct _oidc_config * config, const char * type, const char * client_id, const char * username) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query = NULL, * j_result = NULL, * j_return;
   int res;
 
@@ -9484,7 +10374,7 @@ static json_t * authorization_details_get_consent(struct _oidc_config * config,
                         "gporar_type", type,
                         "gporar_username", username,
                         "gporar_enabled", 1);
-  res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result)) {
@@ -9498,6 +10388,7 @@ static json_t * authorization_details_get_consent(struct _oidc_config * config,
     config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
@@ -10081,7 +10972,6 @@ static int callback_introspection(const struct _u_request * request, struct _u_r
     response->status = 500;
   }
   json_decref(j_result);
-  r_jwk_free(jwk);
   return U_CALLBACK_CONTINUE;
 }
 
@@ -10210,6 +11100,9 @@ static int callback_check_intropect_revoke(const struct _u_request * request, st
         j_client = config->glewlwyd_config->glewlwyd_callback_check_client_valid(config->glewlwyd_config, client_id, client_secret);
         if (check_result_value(j_client, G_OK) && is_client_auth_method_allowed(json_object_get(j_client, "client"), client_auth_method)) {
           ret = U_CALLBACK_CONTINUE;
+        } else if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+          set_response_password_pool_unavailable(response);
+          ret = U_CALLBACK_COMPLETE;
         }
         ulfius_set_response_shared_data(response, json_pack("{sO}", "client", json_object_get(j_client, "client")), (void (*)(void *))&json_decref);
         json_decref(j_client);
@@ -10621,6 +11514,8 @@ static int check_auth_type_access_token_request (const struct _u_request * reque
       }
       json_decref(j_code);
       json_decref(j_claims_request);
+    } else if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+      set_response_password_pool_unavailable(response);
     } else {
       j_body = json_pack("{ss}", "error", "unauthorized_client");
       ulfius_set_json_body_response(response, 403, j_body);
@@ -10710,6 +11605,8 @@ static int check_auth_type_resource_owner_pwd_cred (const struct _u_request * re
       }
     } else if (check_result_value(j_client, G_ERROR_NOT_FOUND) || check_result_value(j_client, G_ERROR_UNAUTHORIZED)) {
       ret = G_ERROR_PARAM;
+    } else if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+      ret = G_ERROR_UNAVAILABLE;
     } else {
       y_log_message(Y_LOG_LEVEL_ERROR, "oidc check_auth_type_resource_owner_pwd_cred - Error glewlwyd_callback_check_client_valid");
       ret = G_ERROR;
@@ -11006,6 +11903,8 @@ static int check_auth_type_resource_owner_pwd_cred (const struct _u_request * re
       y_log_message(Y_LOG_LEVEL_WARNING, "Security - Authorization invalid for username %s at IP Address %s", username, ip_source);
       response->status = 403;
       config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_OIDC_UNAUTHORIZED_CLIENT, 1, "plugin", config->name, NULL);
+    } else if (check_result_value(j_user, G_ERROR_UNAVAILABLE)) {
+      set_response_password_pool_unavailable(response);
     } else {
       y_log_message(Y_LOG_LEVEL_ERROR, "oidc check_auth_type_resource_owner_pwd_cred - glewlwyd_callback_check_user_valid");
       response->status = 403;
@@ -11016,6 +11915,8 @@ static int check_auth_type_resource_owner_pwd_cred (const struct _u_request * re
     response->status = 400;
   } else if (ret == G_ERROR_UNAUTHORIZED) {
     response->status = 403;
+  } else if (ret == G_ERROR_UNAVAILABLE) {
+    set_response_password_pool_unavailable(response);
   } else {
     response->status = 500;
   }
@@ -11230,6 +12131,8 @@ static int check_auth_type_client_credentials_grant (const struct _u_request * r
         response->status = 500;
       }
       free_string_array(scope_array);
+    } else if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+      set_response_password_pool_unavailable(response);
     } else {
       y_log_message(Y_LOG_LEVEL_DEBUG, "oidc check_auth_type_client_credentials_grant - Error client_id '%s' invalid", client_id);
       y_log_message(Y_LOG_LEVEL_WARNING, "Security - Authorization invalid for client_id %s at IP Address %s", client_id, ip_source);
@@ -11444,6 +12347,10 @@ static int check_pushed_authorization_request (const struct _u_request * request
       j_client = check_client_valid(config, client_id, client_secret, redirect_uri, (short unsigned int)auth_type, 0, ip_source);
     }
 
+    if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+      set_response_password_pool_unavailable(response);
+      break;
+    }
     if (!check_result_value(j_client, G_OK)) {
       y_log_message(Y_LOG_LEVEL_DEBUG, "check_pushed_authorization_request oidc - client '%s' is invalid, origin: %s", client_id, ip_source);
       response->status = 403;
@@ -11705,6 +12612,7 @@ static int serialize_ciba_request(struct _oidc_config * config,
                                   const char * x5t_s256,
                                   const char * jti_hash,
                                   const char * dpop_jkt) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   int ret, res;
   json_t * j_query, * j_last_id;
   char ** scope_array = NULL, * expires_at_clause;
@@ -11725,13 +12633,13 @@ static int serialize_ciba_request(struct _oidc_config * config,
                           "gpob_client_id", client_id,
                           "gpob_username", json_object_get(j_user, "username"),
                           "gpob_enabled", 1);
-    res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       time(&now);
-      if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+      if (conn->type==HOEL_DB_TYPE_MARIADB) {
         expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)requested_expiry));
-      } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+      } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
         expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)requested_expiry ));
       } else { // HOEL_DB_TYPE_SQLITE
         expires_at_clause = msprintf("%u", (now + (time_t)requested_expiry));
@@ -11753,18 +12661,19 @@ static int serialize_ciba_request(struct _oidc_config * config,
                             "gpob_issued_for", ip_source,
                             "gpob_user_agent", user_agent,
                             "gpob_dpop_jkt", dpop_jkt);
-      res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+      config->glewlwyd_config->glewlwyd_callback_db_insert_begin(config->glewlwyd_config, conn);
+      res = config->glewlwyd_config->glewlwyd_callback_db_insert(config->glewlwyd_config, conn, j_query, "gpob_id", &j_last_id);
       json_decref(j_query);
       o_free(expires_at_clause);
       if (res == H_OK) {
-        if ((j_last_id = h_last_insert_id(config->glewlwyd_config->glewlwyd_config->conn)) != NULL) {
+        if (j_last_id != NULL) {
           config->glewlwyd_config->glewlwyd_callback_update_issued_for(config->glewlwyd_config, NULL, GLEWLWYD_PLUGIN_OIDC_TABLE_CIBA, "gpob_issued_for", ip_source, "gpob_id", json_integer_value(j_last_id));
           j_query = json_pack("{sss[]}", "table", GLEWLWYD_PLUGIN_OIDC_TABLE_CIBA_SCOPE, "values");
           if (split_string(scope, " ", &scope_array)) {
             for (i=0; scope_array[i] != NULL; i++) {
               json_array_append_new(json_object_get(j_query, "values"), json_pack("{sOss}", "gpob_id", j_last_id, "gpops_scope", scope_array[i]));
             }
-            res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+            res = h_insert(conn, j_query, NULL);
             if (res == H_OK) {
               ret = G_OK;
             } else {
@@ -11786,6 +12695,7 @@ static int serialize_ciba_request(struct _oidc_config * config,
         y_log_message(Y_LOG_LEVEL_ERROR, "serialize_ciba_request - Error executing j_query (2)");
         ret = G_ERROR_DB;
       }
+      config->glewlwyd_config->glewlwyd_callback_db_insert_end(config->glewlwyd_config, conn);
     } else {
       y_log_message(Y_LOG_LEVEL_ERROR, "serialize_ciba_request - Error executing j_query (1)");
       ret = G_ERROR_DB;
@@ -11794,6 +12704,7 @@ static int serialize_ciba_request(struct _oidc_config * config,
     pthread_mutex_unlock(&config->insert_lock);
   }
 
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
@@ -11989,6 +12900,10 @@ static int process_ciba_request (const struct _u_request * request,
       j_client = check_client_valid(config, client_id, client_secret, NULL, GLEWLWYD_AUTHORIZATION_TYPE_CIBA_FLAG, 0, ip_source);
     }
 
+    if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+      set_response_password_pool_unavailable(response);
+      break;
+    }
     if (!check_result_value(j_client, G_OK) || json_object_get(json_object_get(j_client, "client"), "enabled") != json_true()) {
       j_return = json_pack("{ss}", "error", "invalid_client");
       ulfius_set_json_body_response(response, 403, j_return);
@@ -12295,6 +13210,7 @@ static int process_ciba_request (const struct _u_request * request,
 }
 
 static json_t * get_ciba_requests_for_user(struct _oidc_config * config, const char * username) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result, * j_result_scope, * j_return, * j_element = NULL, * j_scope = NULL, * j_client;
   int res;
   char * expires_at_clause;
@@ -12304,9 +13220,9 @@ static json_t * get_ciba_requests_for_user(struct _oidc_config * config, const c
 
 
   time(&now);
-  if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+  if (conn->type==HOEL_DB_TYPE_MARIADB) {
     expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-  } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+  } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
     expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
   } else { // HOEL_DB_TYPE_SQLITE
     expires_at_clause = msprintf("> %u", (now));
@@ -12329,7 +13245,7 @@ static json_t * get_ciba_requests_for_user(struct _oidc_config * config, const c
                       "order_by",
                       "gpob_id DESC");
   o_free(expires_at_clause);
-  res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     json_array_foreach(j_result, index, j_element) {
@@ -12340,7 +13256,7 @@ static json_t * get_ciba_requests_for_user(struct _oidc_config * config, const c
                             "gpops_scope AS scope",
                           "where",
                             "gpob_id", json_object_get(j_element, "gpob_id"));
-      res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result_scope, NULL);
+      res = h_select(conn, j_query, &j_result_scope, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         json_array_foreach(j_result_scope, index_scope, j_scope) {
@@ -12368,10 +13284,12 @@ static json_t * get_ciba_requests_for_user(struct _oidc_config * config, const c
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
   o_free(external_url);
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
 static int update_ciba_request(struct _oidc_config * config, json_int_t gpob_id, const char * scopes_granted, json_t * j_amr, int status, const char * sid) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_element = NULL;
   int res, ret;
   char ** scope_array = NULL, * scope_escaped, * scope_clause = NULL;
@@ -12384,7 +13302,7 @@ static int update_ciba_request(struct _oidc_config * config, json_int_t gpob_id,
                         "gpob_sid", sid,
                       "where",
                         "gpob_id", gpob_id);
-  res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (scopes_granted != NULL) {
@@ -12395,11 +13313,11 @@ static int update_ciba_request(struct _oidc_config * config, json_int_t gpob_id,
                               "gpobs_granted", 0,
                             "where",
                               "gpob_id", gpob_id);
-        res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+        res = h_update(conn, j_query, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           for (i=0; scope_array[i]!=NULL; i++) {
-            scope_escaped = h_escape_string_with_quotes(config->glewlwyd_config->glewlwyd_config->conn, scope_array[i]);
+            scope_escaped = h_escape_string_with_quotes(conn, scope_array[i]);
             if (scope_clause == NULL) {
               scope_clause = msprintf("IN (%s", scope_escaped);
             } else {
@@ -12417,14 +13335,14 @@ static int update_ciba_request(struct _oidc_config * config, json_int_t gpob_id,
                                   "operator", "raw",
                                   "value", scope_clause, ")");
           o_free(scope_clause);
-          res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+          res = h_update(conn, j_query, NULL);
           json_decref(j_query);
           if (res == H_OK) {
             j_query = json_pack("{sss{sI}}",
                                 "table", GLEWLWYD_PLUGIN_OIDC_TABLE_CIBA_SCHEME,
                                 "where",
                                   "gpob_id", gpob_id);
-            res = h_delete(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+            res = h_delete(conn, j_query, NULL);
             json_decref(j_query);
             if (res == H_OK) {
               j_query = json_pack("{sss[]}",
@@ -12434,7 +13352,7 @@ static int update_ciba_request(struct _oidc_config * config, json_int_t gpob_id,
                 json_array_append_new(json_object_get(j_query, "values"), json_pack("{sIsO}", "gpob_id", gpob_id, "gpobh_scheme_module", j_element));
               }
               if (json_array_size(json_object_get(j_query, "values"))) {
-                res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+                res = h_insert(conn, j_query, NULL);
                 if (res == H_OK) {
                   ret = G_OK;
                 } else {
@@ -12469,10 +13387,12 @@ static int update_ciba_request(struct _oidc_config * config, json_int_t gpob_id,
     y_log_message(Y_LOG_LEVEL_ERROR, "update_ciba_request - Error executing j_query (1)");
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static json_t * get_ciba_request_from_user_req_id(struct _oidc_config * config, const char * user_req_id) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result, * j_result_scope, * j_result_scheme, * j_return, * j_element = NULL, * j_client;
   int res;
   char * expires_at_clause, * scope_list = NULL;
@@ -12481,9 +13401,9 @@ static json_t * get_ciba_request_from_user_req_id(struct _oidc_config * config,
 
   if (!o_strnullempty(user_req_id)) {
     time(&now);
-    if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
       expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-    } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
       expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
     } else { // HOEL_DB_TYPE_SQLITE
       expires_at_clause = msprintf("> %u", (now));
@@ -12511,7 +13431,7 @@ static json_t * get_ciba_request_from_user_req_id(struct _oidc_config * config,
                             "value", expires_at_clause,
                           "gpob_enabled", 1);
     o_free(expires_at_clause);
-    res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+    res = h_select(conn, j_query, &j_result, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       if (json_array_size(j_result)) {
@@ -12522,7 +13442,7 @@ static json_t * get_ciba_request_from_user_req_id(struct _oidc_config * config,
                               "gpobs_granted",
                             "where",
                               "gpob_id", json_object_get(json_array_get(j_result, 0), "gpob_id"));
-        res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result_scope, NULL);
+        res = h_select(conn, j_query, &j_result_scope, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           json_array_foreach(j_result_scope, index, j_element) {
@@ -12559,7 +13479,7 @@ static json_t * get_ciba_request_from_user_req_id(struct _oidc_config * config,
                               "gpobh_scheme_module AS scheme_module",
                             "where",
                               "gpob_id", json_object_get(json_array_get(j_result, 0), "gpob_id"));
-        res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result_scheme, NULL);
+        res = h_select(conn, j_query, &j_result_scheme, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           json_array_foreach(j_result_scheme, index, j_element) {
@@ -12581,10 +13501,12 @@ static json_t * get_ciba_request_from_user_req_id(struct _oidc_config * config,
   } else {
     j_return = json_pack("{si}", "result", G_ERROR_NOT_FOUND);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
 static json_t * get_ciba_request_from_auth_req_id(struct _oidc_config * config, const char * auth_req_id) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result, * j_result_scope, * j_result_scheme, * j_return, * j_element = NULL, * j_client;
   int res;
   char * scope_list = NULL;
@@ -12603,14 +13525,14 @@ static json_t * get_ciba_request_from_auth_req_id(struct _oidc_config * config,
                         "gpob_client_notification_token AS client_notification_token",
                         "gpob_issued_for AS issued_for",
                         "gpob_user_agent AS user_agent",
-                        SWITCH_DB_TYPE(config->glewlwyd_config->glewlwyd_config->conn->type, "UNIX_TIMESTAMP(gpob_expires_at) AS expires_at", "gpob_expires_at AS expires_at", "EXTRACT(EPOCH FROM gpob_expires_at)::integer AS expires_at"),
+                        SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gpob_expires_at) AS expires_at", "gpob_expires_at AS expires_at", "EXTRACT(EPOCH FROM gpob_expires_at)::integer AS expires_at"),
                         "gpob_sid AS sid",
                         "gpob_dpop_jkt AS dpop_jkt",
                       "where",
                         "gpob_plugin_name", config->name,
                         "gpob_auth_req_id", auth_req_id,
                         "gpob_enabled", 1);
-  res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result)) {
@@ -12621,7 +13543,7 @@ static json_t * get_ciba_request_from_auth_req_id(struct _oidc_config * config,
                           "where",
                             "gpob_id", json_object_get(json_array_get(j_result, 0), "gpob_id"),
                             "gpobs_granted", 1);
-      res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result_scope, NULL);
+      res = h_select(conn, j_query, &j_result_scope, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         json_array_foreach(j_result_scope, index, j_element) {
@@ -12652,7 +13574,7 @@ static json_t * get_ciba_request_from_auth_req_id(struct _oidc_config * config,
                             "gpobh_scheme_module AS scheme_module",
                           "where",
                             "gpob_id", json_object_get(json_array_get(j_result, 0), "gpob_id"));
-      res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result_scheme, NULL);
+      res = h_select(conn, j_query, &j_result_scheme, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         json_array_foreach(j_result_scheme, index, j_element) {
@@ -12671,6 +13593,7 @@ static json_t * get_ciba_request_from_auth_req_id(struct _oidc_config * config,
     y_log_message(Y_LOG_LEVEL_ERROR, "get_ciba_request_from_auth_req_id - Error executing j_query (1)");
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
@@ -12716,7 +13639,10 @@ static int check_ciba_auth_req_id(struct _oidc_config * config,
           j_client = check_client_valid(config, client_id, client_secret, NULL, GLEWLWYD_AUTHORIZATION_TYPE_CIBA_FLAG, 0, ip_source);
         }
       }
-      if (!check_result_value(j_client, G_OK) || !is_client_auth_method_allowed(json_object_get(j_client, "client"), client_auth_method)) {
+      if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+        set_response_password_pool_unavailable(response);
+        break;
+      } else if (!check_result_value(j_client, G_OK) || !is_client_auth_method_allowed(json_object_get(j_client, "client"), client_auth_method)) {
         j_response = json_pack("{ss}", "error", "unauthorized_client");
         ulfius_set_json_body_response(response, 403, j_response);
         json_decref(j_response);
@@ -12885,6 +13811,7 @@ static int check_ciba_auth_req_id(struct _oidc_config * config,
 }
 
 static json_t * verify_pushed_authorization_request(struct _oidc_config * config, const char * request_uri, const char * client_id, const char * ip_source) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result = NULL, * j_result_scope = NULL, * j_return, * j_element = NULL, * j_client = NULL;
   int res;
   char * request_uri_hash = NULL, * expires_at_clause = NULL, * scope_list = NULL, * tmp;
@@ -12893,9 +13820,9 @@ static json_t * verify_pushed_authorization_request(struct _oidc_config * config
 
   if (!o_strnullempty(client_id)) {
     time(&now);
-    if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
       expires_at_clause = msprintf("((gpop_status=0 AND gpop_expires_at> FROM_UNIXTIME(%u)) OR gpop_status=1)", (now));
-    } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
       expires_at_clause = msprintf("((gpop_status=0 AND gpop_expires_at> TO_TIMESTAMP(%u)) OR gpop_status=1)", now);
     } else { // HOEL_DB_TYPE_SQLITE
       expires_at_clause = msprintf("((gpop_status=0 AND gpop_expires_at> %u) OR gpop_status=1)", (now));
@@ -12932,7 +13859,7 @@ static json_t * verify_pushed_authorization_request(struct _oidc_config * config
                               expires_at_clause);
       o_free(request_uri_hash);
       o_free(expires_at_clause);
-      res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+      res = h_select(conn, j_query, &j_result, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         if (json_array_size(j_result)) {
@@ -12946,7 +13873,7 @@ static json_t * verify_pushed_authorization_request(struct _oidc_config * config
                                 "where",
                                   "gpop_id",
                                   json_object_get(json_array_get(j_result, 0), "gpop_id"));
-            res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+            res = h_update(conn, j_query, NULL);
             json_decref(j_query);
             if (res != H_OK) {
               y_log_message(Y_LOG_LEVEL_ERROR, "verify_pushed_authorization_request oidc - Error executing j_query (2)");
@@ -12963,7 +13890,7 @@ static json_t * verify_pushed_authorization_request(struct _oidc_config * config
                                 "where",
                                   "gpop_id",
                                   json_object_get(json_array_get(j_result, 0), "gpop_id"));
-            res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result_scope, NULL);
+            res = h_select(conn, j_query, &j_result_scope, NULL);
             json_decref(j_query);
             if (res == H_OK) {
               json_array_foreach(j_result_scope, index, j_element) {
@@ -13032,10 +13959,12 @@ static json_t * verify_pushed_authorization_request(struct _oidc_config * config
     j_return = json_pack("{si}", "result", G_ERROR_UNAUTHORIZED);
     config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_OIDC_UNAUTHORIZED_CLIENT, 1, "plugin", config->name, NULL);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
 static int complete_pushed_authorization_request(struct _oidc_config * config, json_int_t gpop_id, const char * username) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res, ret;
 
@@ -13047,7 +13976,7 @@ static int complete_pushed_authorization_request(struct _oidc_config * config, j
                         "gpop_username", username,
                       "where",
                         "gpop_id", gpop_id);
-  res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = G_OK;
@@ -13056,10 +13985,12 @@ static int complete_pushed_authorization_request(struct _oidc_config * config, j
     config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static int disable_refresh_token_by_jti(struct _oidc_config * config, const char * jti) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res, ret;
 
@@ -13074,7 +14005,7 @@ static int disable_refresh_token_by_jti(struct _oidc_config * config, const char
                         jti,
                         "gpor_enabled",
                         1);
-  res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = G_OK;
@@ -13083,6 +14014,7 @@ static int disable_refresh_token_by_jti(struct _oidc_config * config, const char
     config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
@@ -13100,6 +14032,10 @@ static int is_refresh_token_one_use(struct _oidc_config * config, json_t * j_cli
   }
 }
 
+/**
+ * Backchannel logout job, the job uses config and its signing keys without copy,
+ * they stay valid because plugin_module_close cancels or waits for the jobs of the instance
+ */
 struct _backchannel_elements {
   struct _oidc_config * config;
   char * username;
@@ -13107,7 +14043,16 @@ struct _backchannel_elements {
   json_t * j_client_id_list;
 };
 
-static void * run_backchannel_logout_thread(void * args) {
+static void free_backchannel_elements(void * args) {
+  struct _backchannel_elements * elt = (struct _backchannel_elements *)args;
+
+  json_decref(elt->j_client_id_list);
+  o_free(elt->username);
+  o_free(elt->sid);
+  o_free(elt);
+}
+
+static void run_backchannel_logout_job(void * args) {
   struct _backchannel_elements * elt = (struct _backchannel_elements *)args;
   json_t * j_element = NULL, * j_client, * j_events = json_pack("{s{}}", "http://schemas.openid.net/event/backchannel-logout");;
   size_t index = 0;
@@ -13157,42 +14102,35 @@ static void * run_backchannel_logout_thread(void * args) {
             if (resp.status == 200) {
               y_log_message(Y_LOG_LEVEL_DEBUG, "Send backchannel_logout successfully for client %s", json_string_value(json_object_get(json_object_get(j_client, "client"), "client_id")));
             } else {
-              y_log_message(Y_LOG_LEVEL_ERROR, "run_backchannel_logout_thread - Error backchannel_logout response for client %s, response status %d", json_string_value(json_object_get(json_object_get(j_client, "client"), "client_id")), resp.status);
+              y_log_message(Y_LOG_LEVEL_ERROR, "run_backchannel_logout_job - Error backchannel_logout response for client %s, response status %d", json_string_value(json_object_get(json_object_get(j_client, "client"), "client_id")), resp.status);
               y_log_message(Y_LOG_LEVEL_DEBUG, "  -  response body %.*s", resp.binary_body_length, resp.binary_body);
             }
           } else {
-            y_log_message(Y_LOG_LEVEL_ERROR, "run_backchannel_logout_thread - Error ulfius_send_http_request for client %s", json_string_value(json_object_get(json_object_get(j_client, "client"), "client_id")));
+            y_log_message(Y_LOG_LEVEL_ERROR, "run_backchannel_logout_job - Error ulfius_send_http_request for client %s", json_string_value(json_object_get(json_object_get(j_client, "client"), "client_id")));
           }
           ulfius_clean_request(&req);
           ulfius_clean_response(&resp);
         } else {
-          y_log_message(Y_LOG_LEVEL_ERROR, "run_backchannel_logout_thread - Error serializing JWT for client %s", json_string_value(json_object_get(json_object_get(j_client, "client"), "client_id")));
+          y_log_message(Y_LOG_LEVEL_ERROR, "run_backchannel_logout_job - Error serializing JWT for client %s", json_string_value(json_object_get(json_object_get(j_client, "client"), "client_id")));
         }
         o_free(token);
         o_free(out_token);
       } else {
-        y_log_message(Y_LOG_LEVEL_ERROR, "run_backchannel_logout_thread - Invalid alg or sign key for client %s", json_string_value(json_object_get(json_object_get(j_client, "client"), "client_id")));
+        y_log_message(Y_LOG_LEVEL_ERROR, "run_backchannel_logout_job - Invalid alg or sign key for client %s", json_string_value(json_object_get(json_object_get(j_client, "client"), "client_id")));
       }
-      r_jwk_free(jwk);
     }
     json_decref(j_client);
   }
   json_decref(j_events);
-  json_decref(elt->j_client_id_list);
-  o_free(elt->username);
-  o_free(elt->sid);
-  o_free(elt);
-  pthread_exit(NULL);
+  free_backchannel_elements(elt);
 }
 
 static int run_backchannel_logout(struct _oidc_config * config, const char * username, const char * sid) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result = NULL;
   int ret, res;
-  pthread_t thread_logout;
-  int thread_ret, thread_detach;
-  pthread_attr_t attr;
-  struct sched_param param;
   struct _backchannel_elements * elt;
+  char * job_key;
 
   if (json_object_get(config->j_params, "back-channel-logout-allowed") == json_true()) {
     j_query = json_pack("{sss[s]s{sssssssi}}",
@@ -13204,7 +14142,7 @@ static int run_backchannel_logout(struct _oidc_config * config, const char * use
                           "gpoi_username", username,
                           "gpoi_sid", sid,
                           "gpoi_enabled", 1);
-    res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+    res = h_select(conn, j_query, &j_result, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       if ((elt = o_malloc(sizeof(struct _backchannel_elements))) != NULL) {
@@ -13212,22 +14150,14 @@ static int run_backchannel_logout(struct _oidc_config * config, const char * use
         elt->username = o_strdup(username);
         elt->sid = o_strdup(sid);
         elt->j_client_id_list = j_result;
-        pthread_attr_init (&attr);
-        pthread_attr_getschedparam (&attr, &param);
-        param.sched_priority = 0;
-        pthread_attr_setschedparam (&attr, &param);
-        thread_ret = pthread_create(&thread_logout, &attr, run_backchannel_logout_thread, (void *)elt);
-        thread_detach = pthread_detach(thread_logout);
-        if (thread_ret || thread_detach) {
-          y_log_message(Y_LOG_LEVEL_ERROR, "run_backchannel_logout - Error thread");
-          o_free(elt->username);
-          o_free(elt->sid);
-          o_free(elt);
-          json_decref(j_result);
+        job_key = msprintf("%s:logout:%s", config->name, sid);
+        if (config->glewlwyd_config->glewlwyd_callback_job_submit(config->glewlwyd_config, GLEWLWYD_JOB_TYPE_NOTIFICATION, job_key, config, &run_backchannel_logout_job, &free_backchannel_elements, elt) != G_OK) {
+          y_log_message(Y_LOG_LEVEL_ERROR, "run_backchannel_logout - Error glewlwyd_callback_job_submit");
           ret = G_ERROR;
         } else {
           ret = G_OK;
         }
+        o_free(job_key);
       } else {
         y_log_message(Y_LOG_LEVEL_ERROR, "run_backchannel_logout - Error allocating resources for elt");
         json_decref(j_result);
@@ -13240,35 +14170,37 @@ static int run_backchannel_logout(struct _oidc_config * config, const char * use
   } else {
     ret = G_OK;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static int disable_tokens_from_session(struct _oidc_config * config, const char * username, const char * sid) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res, ret = G_OK;
   char * query, * expires_at_clause, * sid_escaped, * name_escaped, * username_escaped;
   time_t now;
 
   time(&now);
-  if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+  if (conn->type==HOEL_DB_TYPE_MARIADB) {
     expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-  } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+  } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
     expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
   } else { // HOEL_DB_TYPE_SQLITE
     expires_at_clause = msprintf("> %u", (now));
   }
-  sid_escaped = h_escape_string_with_quotes(config->glewlwyd_config->glewlwyd_config->conn, sid);
-  name_escaped = h_escape_string_with_quotes(config->glewlwyd_config->glewlwyd_config->conn, config->name);
-  username_escaped = h_escape_string_with_quotes(config->glewlwyd_config->glewlwyd_config->conn, username);
+  sid_escaped = h_escape_string_with_quotes(conn, sid);
+  name_escaped = h_escape_string_with_quotes(conn, config->name);
+  username_escaped = h_escape_string_with_quotes(conn, username);
 
   // Disable access tokens
   query = msprintf("UPDATE "GLEWLWYD_PLUGIN_OIDC_TABLE_ACCESS_TOKEN" SET gpoa_enabled=0 WHERE gpoa_enabled=1 AND gpor_id IN (SELECT gpor_id FROM "GLEWLWYD_PLUGIN_OIDC_TABLE_REFRESH_TOKEN" WHERE gpor_enabled=1 AND gpor_expires_at %s AND gpoc_id IN (SELECT gpoc_id FROM "GLEWLWYD_PLUGIN_OIDC_TABLE_CODE" WHERE gpoc_plugin_name=%s AND gpoc_username=%s AND gpoc_sid=%s))", expires_at_clause, name_escaped, username_escaped, sid_escaped);
-  res = h_execute_query(config->glewlwyd_config->glewlwyd_config->conn, query, NULL, H_OPTION_EXEC);
+  res = h_execute_query(conn, query, NULL, H_OPTION_EXEC);
   o_free(query);
   if (res == H_OK) {
     // Disable refresh tokens
     query = msprintf("UPDATE "GLEWLWYD_PLUGIN_OIDC_TABLE_REFRESH_TOKEN" SET gpor_enabled=0 WHERE gpor_enabled=1 AND gpor_expires_at %s AND gpoc_id IN (SELECT gpoc_id FROM "GLEWLWYD_PLUGIN_OIDC_TABLE_CODE" WHERE gpoc_plugin_name=%s AND gpoc_username=%s AND gpoc_sid=%s)", expires_at_clause, name_escaped, username_escaped, sid_escaped);
-    res = h_execute_query(config->glewlwyd_config->glewlwyd_config->conn, query, NULL, H_OPTION_EXEC);
+    res = h_execute_query(conn, query, NULL, H_OPTION_EXEC);
     o_free(query);
     if (res == H_OK) {
       j_query = json_pack("{sss{si}s{sssssssi}}",
@@ -13280,7 +14212,7 @@ static int disable_tokens_from_session(struct _oidc_config * config, const char
                             "gpoi_username", username,
                             "gpoi_sid", sid,
                             "gpoi_enabled", 1);
-      res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+      res = h_update(conn, j_query, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         ret = G_OK;
@@ -13300,10 +14232,12 @@ static int disable_tokens_from_session(struct _oidc_config * config, const char
   o_free(sid_escaped);
   o_free(name_escaped);
   o_free(username_escaped);
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static json_t * get_session_front_client_list(struct _oidc_config * config, const char * username, const char * sid, const char * client_id, const char * post_redirect_to) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result = NULL, * j_client, * j_client_alpha, * j_return, * j_element = NULL;
   int res;
   size_t index = 0;
@@ -13332,7 +14266,7 @@ static json_t * get_session_front_client_list(struct _oidc_config * config, cons
                               "gpoi_username", username,
                               "gpoi_sid", sid,
                               "gpoi_enabled", 1);
-        res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+        res = h_select(conn, j_query, &j_result, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           if (json_array_size(j_result)) {
@@ -13371,6 +14305,7 @@ static json_t * get_session_front_client_list(struct _oidc_config * config, cons
     y_log_message(Y_LOG_LEVEL_ERROR, "get_session_front_client_list - Invalid input parameters");
     j_return = json_pack("{si}", "result", G_ERROR_PARAM);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
@@ -13411,7 +14346,7 @@ static int get_access_token_from_refresh (const struct _u_request * request,
          jti[OIDC_JTI_LENGTH+1] = {0},
        * dpop_nonce,
       ** resource_list;
-  int has_error = 0, has_issues = 0, res, enc_res = G_OK, resource_valid;
+  int has_error = 0, has_issues = 0, is_unavailable = 0, res, enc_res = G_OK, resource_valid;
   json_int_t gpor_id = 0;
   size_t i;
 
@@ -13451,7 +14386,9 @@ static int get_access_token_from_refresh (const struct _u_request * request,
             j_client = check_client_valid(config, client_id, client_secret, NULL, GLEWLWYD_AUTHORIZATION_TYPE_REFRESH_TOKEN_FLAG, 0, ip_source);
           }
         }
-        if (!check_result_value(j_client, G_OK) || !is_client_auth_method_allowed(json_object_get(j_client, "client"), client_auth_method)) {
+        if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+          is_unavailable = 1;
+        } else if (!check_result_value(j_client, G_OK) || !is_client_auth_method_allowed(json_object_get(j_client, "client"), client_auth_method)) {
           has_issues = 1;
         } else if (client_id == NULL && client_secret == NULL && json_object_get(json_object_get(j_client, "client"), "confidential") == json_true()) {
           y_log_message(Y_LOG_LEVEL_DEBUG, "get_access_token_from_refresh oidc - client '%s' is invalid or is not confidential, origin: %s", client_id, ip_source);
@@ -13459,8 +14396,10 @@ static int get_access_token_from_refresh (const struct _u_request * request,
         }
         j_client_for_sub = json_incref(json_object_get(j_client, "client"));
       }
-      j_jkt = oidc_verify_dpop_proof(config, request, "POST", "/token", json_object_get(j_client, "client"), NULL, json_string_value(json_object_get(json_object_get(j_refresh, "token"), "dpop_jkt")));
-      if (check_result_value(j_jkt, G_OK)) {
+      j_jkt = is_unavailable?NULL:oidc_verify_dpop_proof(config, request, "POST", "/token", json_object_get(j_client, "client"), NULL, json_string_value(json_object_get(json_object_get(j_refresh, "token"), "dpop_jkt")));
+      if (is_unavailable) {
+        set_response_password_pool_unavailable(response);
+      } else if (check_result_value(j_jkt, G_OK)) {
         if (json_object_get(j_jkt, "jkt") == NULL ||
             ((res = check_dpop_jti(config,
                                   json_string_value(json_object_get(json_object_get(j_jkt, "claims"), "jti")),
@@ -13787,7 +14726,7 @@ static int delete_refresh_token (const struct _u_request * request, struct _u_re
   json_t * j_refresh, * j_client = NULL;
   time_t now;
   char * issued_for;
-  int has_issues = 0;
+  int has_issues = 0, is_unavailable = 0;
 
   if (client_id == NULL && u_map_get(request->map_post_body, "client_id") != NULL) {
     client_id = u_map_get(request->map_post_body, "client_id");
@@ -13812,7 +14751,9 @@ static int delete_refresh_token (const struct _u_request * request, struct _u_re
             j_client = json_pack("{si}", "result", G_ERROR_UNAUTHORIZED);
           }
         }
-        if (!check_result_value(j_client, G_OK) || !is_client_auth_method_allowed(json_object_get(j_client, "client"), client_auth_method)) {
+        if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+          is_unavailable = 1;
+        } else if (!check_result_value(j_client, G_OK) || !is_client_auth_method_allowed(json_object_get(j_client, "client"), client_auth_method)) {
           y_log_message(Y_LOG_LEVEL_DEBUG, "oidc delete_refresh_token - client '%s' is invalid, origin: %s", request->auth_basic_user, ip_source);
           has_issues = 1;
           config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_OIDC_UNAUTHORIZED_CLIENT, 1, "plugin", config->name, NULL);
@@ -13823,7 +14764,9 @@ static int delete_refresh_token (const struct _u_request * request, struct _u_re
         }
         json_decref(j_client);
       }
-      if (!has_issues) {
+      if (is_unavailable) {
+        set_response_password_pool_unavailable(response);
+      } else if (!has_issues) {
         time(&now);
         issued_for = get_client_hostname(request);
         if (update_refresh_token(config, json_integer_value(json_object_get(json_object_get(j_refresh, "token"), "gpor_id")), 0, 1, now) != G_OK) {
@@ -14991,7 +15934,6 @@ static int callback_oidc_authorization(const struct _u_request * request, struct
   json_decref(j_rar_filtered_result);
   json_decref(j_authorization_code);
   r_jwt_free(jwt);
-  r_jwk_free(jwk_id_token);
 
   return U_CALLBACK_CONTINUE;
 }
@@ -15175,7 +16117,6 @@ static int callback_oidc_get_userinfo(const struct _u_request * request, struct
   }
   o_free(username);
   json_decref(j_client);
-  r_jwk_free(jwk);
   return U_CALLBACK_CONTINUE;
 }
 
@@ -15256,14 +16197,9 @@ static int callback_oidc_disable_refresh_token(const struct _u_request * request
  * /.well-known/openid-configuration callback
  */
 static int callback_oidc_discovery(const struct _u_request * request, struct _u_response * response, void * user_data) {
-  UNUSED(request);
-
-  u_map_put(response->map_header, "Cache-Control", "no-store");
-  u_map_put(response->map_header, "Pragma", "no-cache");
-  u_map_put(response->map_header, "Referrer-Policy", "no-referrer");
+  struct _oidc_config * config = (struct _oidc_config *)user_data;
 
-  u_map_put(response->map_header, ULFIUS_HTTP_HEADER_CONTENT, ULFIUS_HTTP_ENCODING_JSON);
-  ulfius_set_string_body_response(response, 200, ((struct _oidc_config *)user_data)->discovery_str);
+  set_static_body_response(request, response, config->discovery_str, &config->discovery_body);
   return U_CALLBACK_CONTINUE;
 }
 
@@ -15271,17 +16207,14 @@ static int callback_oidc_discovery(const struct _u_request * request, struct _u_
  * /jwks allback
  */
 static int callback_oidc_get_jwks(const struct _u_request * request, struct _u_response * response, void * user_data) {
-  UNUSED(request);
   struct _oidc_config * config = (struct _oidc_config *)user_data;
 
-  u_map_put(response->map_header, "Cache-Control", "no-store");
-  u_map_put(response->map_header, "Pragma", "no-cache");
-  u_map_put(response->map_header, "Referrer-Policy", "no-referrer");
-
   if (config->jwks_str != NULL) {
-    u_map_put(response->map_header, ULFIUS_HTTP_HEADER_CONTENT, ULFIUS_HTTP_ENCODING_JSON);
-    ulfius_set_string_body_response(response, 200, config->jwks_str);
+    set_static_body_response(request, response, config->jwks_str, &config->jwks_body);
   } else {
+    u_map_put(response->map_header, "Cache-Control", "no-store");
+    u_map_put(response->map_header, "Pragma", "no-cache");
+    u_map_put(response->map_header, "Referrer-Policy", "no-referrer");
     ulfius_set_string_body_response(response, 403, "JWKS unavailable");
   }
   return U_CALLBACK_CONTINUE;
@@ -15577,6 +16510,8 @@ static int callback_oidc_device_authorization(const struct _u_request * request,
           }
           json_decref(j_authorization_details);
         }
+      } else if (check_result_value(j_client, G_ERROR_UNAVAILABLE)) {
+        set_response_password_pool_unavailable(response);
       } else {
         j_body = json_pack("{ss}", "error", "unauthorized_client");
         ulfius_set_json_body_response(response, 403, j_body);
@@ -16514,8 +17449,16 @@ static int build_sign_keys_from_params(struct _oidc_config * config) {
       break;
     }
 
+    if ((ret = build_jwks_sign_index(config)) != G_OK) {
+      y_log_message(Y_LOG_LEVEL_ERROR, "build_sign_keys_from_params - oidc - Error build_jwks_sign_index");
+      break;
+    }
+
     if (r_jwks_size(jwks_pub_export)) {
-      config->jwks_str = r_jwks_export_to_json_str(jwks_pub_export, 0);
+      if ((config->jwks_str = r_jwks_export_to_json_str(jwks_pub_export, 0)) == NULL || build_static_body(&config->jwks_body, config->jwks_str) != G_OK) {
+        y_log_message(Y_LOG_LEVEL_ERROR, "build_sign_keys_from_params - oidc - Error build_static_body");
+        ret = G_ERROR;
+      }
     }
   } while (0);
   r_jwks_free(jwks_pub_export);
@@ -16523,6 +17466,7 @@ static int build_sign_keys_from_params(struct _oidc_config * config) {
 }
 
 static int remove_subject_identifier(struct _oidc_config * config, const char * username) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res, ret = G_OK;
 
@@ -16531,7 +17475,7 @@ static int remove_subject_identifier(struct _oidc_config * config, const char *
                         "where",
                           "gposi_plugin_name", config->name,
                           "gposi_username", username);
-  res = h_delete(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+  res = h_delete(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = G_OK;
@@ -16539,10 +17483,12 @@ static int remove_subject_identifier(struct _oidc_config * config, const char *
     y_log_message(Y_LOG_LEVEL_ERROR, "remove_subject_identifier - Error executing j_query");
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static int disable_user_data(struct _oidc_config * config, const char * username) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res, ret = G_OK;
 
@@ -16555,7 +17501,7 @@ static int disable_user_data(struct _oidc_config * config, const char * username
                           "gpoc_plugin_name", config->name,
                           "gpoc_username", username,
                           "gpoc_enabled", 1);
-    res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res != H_OK) {
       y_log_message(Y_LOG_LEVEL_ERROR, "disable_user_data - Error disable codes");
@@ -16571,7 +17517,7 @@ static int disable_user_data(struct _oidc_config * config, const char * username
                           "gpor_plugin_name", config->name,
                           "gpor_username", username,
                           "gpor_enabled", 1);
-    res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res != H_OK) {
       y_log_message(Y_LOG_LEVEL_ERROR, "disable_user_data - Error disable refresh tokens");
@@ -16587,7 +17533,7 @@ static int disable_user_data(struct _oidc_config * config, const char * username
                           "gpoa_plugin_name", config->name,
                           "gpoa_username", username,
                           "gpoa_enabled", 1);
-    res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res != H_OK) {
       y_log_message(Y_LOG_LEVEL_ERROR, "disable_user_data - Error disable access tokens");
@@ -16603,7 +17549,7 @@ static int disable_user_data(struct _oidc_config * config, const char * username
                           "gpoi_plugin_name", config->name,
                           "gpoi_username", username,
                           "gpoi_enabled", 1);
-    res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res != H_OK) {
       y_log_message(Y_LOG_LEVEL_ERROR, "disable_user_data - Error disable id tokens");
@@ -16621,7 +17567,7 @@ static int disable_user_data(struct _oidc_config * config, const char * username
                           "gpoda_status",
                             "operator", "raw",
                             "value", "in (0, 1)");
-    res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res != H_OK) {
       y_log_message(Y_LOG_LEVEL_ERROR, "disable_user_data - Error disable device auth tokens");
@@ -16637,7 +17583,7 @@ static int disable_user_data(struct _oidc_config * config, const char * username
                           "gporar_plugin_name", config->name,
                           "gporar_username", username,
                           "gporar_enabled", 1);
-    res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res != H_OK) {
       y_log_message(Y_LOG_LEVEL_ERROR, "disable_user_data - Error disable rar");
@@ -16655,7 +17601,7 @@ static int disable_user_data(struct _oidc_config * config, const char * username
                           "gpop_status",
                             "operator", "raw",
                             "value", "in (0, 1)");
-    res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res != H_OK) {
       y_log_message(Y_LOG_LEVEL_ERROR, "disable_user_data - Error disable par");
@@ -16671,7 +17617,7 @@ static int disable_user_data(struct _oidc_config * config, const char * username
                           "gpob_plugin_name", config->name,
                           "gpob_username", username,
                           "gpob_enabled", 1);
-    res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res != H_OK) {
       y_log_message(Y_LOG_LEVEL_ERROR, "disable_user_data - Error disable ciba");
@@ -16679,6 +17625,7 @@ static int disable_user_data(struct _oidc_config * config, const char * username
       break;
     }
   } while (0);
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
@@ -16729,13 +17676,20 @@ json_t * plugin_module_init(struct config_plugin * config, const char * name, js
       json_object_set_new(p_config->j_params, "name", json_string(name));
       p_config->discovery_str = NULL;
       p_config->jwks_str = NULL;
+      memset(&p_config->discovery_body, 0, sizeof(struct _oidc_static_body));
+      memset(&p_config->jwks_body, 0, sizeof(struct _oidc_static_body));
       p_config->check_session_iframe = NULL;
       p_config->request_uri_duration = 0;
       p_config->jwks_sign = NULL;
       p_config->jwks_public = NULL;
+      memset(&p_config->jwks_sign_index, 0, sizeof(struct _jwks_sign_index));
       p_config->x5u_flags = 0;
       p_config->introspect_revoke_scope = NULL;
       p_config->client_register_scope = NULL;
+      p_config->dpop_jti_cache.initialized = 0;
+      p_config->request_jti_cache.initialized = 0;
+      p_config->ciba_jti_cache.initialized = 0;
+      p_config->jwks_uri_cache = NULL;
 
       j_result = check_parameters(((struct _oidc_config *)*cls)->j_params);
 
@@ -16756,6 +17710,12 @@ json_t * plugin_module_init(struct config_plugin * config, const char * name, js
 
       p_config->dpop_max_iat = (time_t)json_integer_value(json_object_get(p_config->j_params, "oauth-dpop-iat-duration"));
       p_config->dpop_max_iat_gap = (time_t)json_integer_value(json_object_get(p_config->j_params, "oauth-dpop-iat-gap-duration"));
+      p_config->dpop_jti_persist = json_object_get(p_config->j_params, "oauth-dpop-jti-persist")==json_true()?1:0;
+      if (json_object_get(p_config->j_params, "oauth-dpop-allowed") == json_true() && glewlwyd_replay_cache_init(&p_config->dpop_jti_cache, 0, p_config->dpop_max_iat+p_config->dpop_max_iat_gap+1) != G_OK) {
+        y_log_message(Y_LOG_LEVEL_ERROR, "protocol_init - oidc - Error glewlwyd_replay_cache_init for DPoP jti");
+        j_return = json_pack("{si}", "result", G_ERROR);
+        break;
+      }
 
       p_config->access_token_duration = json_integer_value(json_object_get(p_config->j_params, "access-token-duration"));
       if (!p_config->access_token_duration) {
@@ -16798,6 +17758,26 @@ json_t * plugin_module_init(struct config_plugin * config, const char * name, js
       if (!p_config->auth_token_max_age) {
         p_config->auth_token_max_age = GLEWLWYD_AUTH_TOKEN_DEFAULT_MAX_AGE;
       }
+      p_config->request_jti_persist = json_object_get(p_config->j_params, "request-jti-persist")==json_true()?1:0;
+      if (glewlwyd_replay_cache_init(&p_config->request_jti_cache, 0, (time_t)p_config->auth_token_max_age+1) != G_OK) {
+        y_log_message(Y_LOG_LEVEL_ERROR, "protocol_init - oidc - Error glewlwyd_replay_cache_init for request jti");
+        j_return = json_pack("{si}", "result", G_ERROR);
+        break;
+      }
+      if (json_object_get(p_config->j_params, "oauth-ciba-allowed") == json_true() && glewlwyd_replay_cache_init(&p_config->ciba_jti_cache, 0, (time_t)p_config->auth_token_max_age+1) != G_OK) {
+        y_log_message(Y_LOG_LEVEL_ERROR, "protocol_init - oidc - Error glewlwyd_replay_cache_init for CIBA jti");
+        j_return = json_pack("{si}", "result", G_ERROR);
+        break;
+      }
+      if (json_object_get(p_config->j_params, "client-jwks-cache-max-ttl") == NULL || json_integer_value(json_object_get(p_config->j_params, "client-jwks-cache-max-ttl"))) {
+        if ((p_config->jwks_uri_cache = jwks_uri_cache_new(p_config,
+                                                           json_object_get(p_config->j_params, "client-jwks-cache-min-ttl")!=NULL?(time_t)json_integer_value(json_object_get(p_config->j_params, "client-jwks-cache-min-ttl")):GLEWLWYD_CLIENT_JWKS_CACHE_MIN_TTL,
+                                                           json_object_get(p_config->j_params, "client-jwks-cache-max-ttl")!=NULL?(time_t)json_integer_value(json_object_get(p_config->j_params, "client-jwks-cache-max-ttl")):GLEWLWYD_CLIENT_JWKS_CACHE_MAX_TTL)) == NULL) {
+          y_log_message(Y_LOG_LEVEL_ERROR, "protocol_init - oidc - Error jwks_uri_cache_new");
+          j_return = json_pack("{si}", "result", G_ERROR);
+          break;
+        }
+      }
 
       if (jwt_autocheck(p_config) != G_OK) {
         y_log_message(Y_LOG_LEVEL_ERROR, "protocol_init - oidc - Error jwt_autocheck");
@@ -17014,6 +17994,9 @@ json_t * plugin_module_init(struct config_plugin * config, const char * name, js
       config->glewlwyd_plugin_callback_metrics_add_metric(config, GLWD_METRICS_OIDC_INVALID_DEVICE_CODE, "Total number of invalid device code");
       config->glewlwyd_plugin_callback_metrics_add_metric(config, GLWD_METRICS_OIDC_INVALID_REFRESH_TOKEN, "Total number of invalid refresh token");
       config->glewlwyd_plugin_callback_metrics_add_metric(config, GLWD_METRICS_OIDC_INVALID_ACCESS_TOKEN, "Total number of invalid access token");
+      config->glewlwyd_plugin_callback_metrics_add_metric(config, GLWD_METRICS_OIDC_CLIENT_JWKS_CACHE, "Total number of client jwks_uri cache lookups");
+      config->glewlwyd_plugin_callback_metrics_add_metric(config, GLWD_METRICS_OIDC_CLIENT_JWKS_REFRESH, "Total number of client jwks_uri downloads");
+      config->glewlwyd_plugin_callback_metrics_add_metric(config, GLWD_METRICS_OIDC_CLIENT_JWKS_REFRESH_DURATION, "Total duration of client jwks_uri downloads in milliseconds");
       config->glewlwyd_plugin_callback_metrics_increment_counter(config, GLWD_METRICS_OIDC_CODE, 0, "plugin", name, NULL);
       config->glewlwyd_plugin_callback_metrics_increment_counter(config, GLWD_METRICS_OIDC_ID_TOKEN, 0, "plugin", name, NULL);
       config->glewlwyd_plugin_callback_metrics_increment_counter(config, GLWD_METRICS_OIDC_REFRESH_TOKEN, 0, "plugin", name, NULL);
@@ -17055,6 +18038,19 @@ json_t * plugin_module_init(struct config_plugin * config, const char * name, js
         config->glewlwyd_plugin_callback_metrics_increment_counter(config, GLWD_METRICS_OIDC_REFRESH_TOKEN, 0, "plugin", name, "response_type", "ciba", NULL);
         config->glewlwyd_plugin_callback_metrics_increment_counter(config, GLWD_METRICS_OIDC_USER_ACCESS_TOKEN, 0, "plugin", name, "response_type", "ciba", NULL);
       }
+      // Expired rows purge, the codes used by a refresh token and the access tokens used by a client registration are kept
+      if (config->glewlwyd_callback_purge_add_task(config, name, GLEWLWYD_PLUGIN_OIDC_TABLE_CODE, "gpoc_id", "gpoc_plugin_name", "gpoc_expires_at", 0, "NOT EXISTS (SELECT gpor_id FROM " GLEWLWYD_PLUGIN_OIDC_TABLE_REFRESH_TOKEN " WHERE " GLEWLWYD_PLUGIN_OIDC_TABLE_REFRESH_TOKEN ".gpoc_id=" GLEWLWYD_PLUGIN_OIDC_TABLE_CODE ".gpoc_id)") != G_OK ||
+          config->glewlwyd_callback_purge_add_task(config, name, GLEWLWYD_PLUGIN_OIDC_TABLE_REFRESH_TOKEN, "gpor_id", "gpor_plugin_name", "gpor_expires_at", 0, NULL) != G_OK ||
+          config->glewlwyd_callback_purge_add_task(config, name, GLEWLWYD_PLUGIN_OIDC_TABLE_ACCESS_TOKEN, "gpoa_id", "gpoa_plugin_name", "gpoa_issued_at", (unsigned int)p_config->access_token_duration, "NOT EXISTS (SELECT gpocr_id FROM " GLEWLWYD_PLUGIN_OIDC_TABLE_CLIENT_REGISTRATION " WHERE " GLEWLWYD_PLUGIN_OIDC_TABLE_CLIENT_REGISTRATION ".gpoa_id=" GLEWLWYD_PLUGIN_OIDC_TABLE_ACCESS_TOKEN ".gpoa_id)") != G_OK ||
+          config->glewlwyd_callback_purge_add_task(config, name, GLEWLWYD_PLUGIN_OIDC_TABLE_DEVICE_AUTHORIZATION, "gpoda_id", "gpoda_plugin_name", "gpoda_expires_at", 0, NULL) != G_OK ||
+          config->glewlwyd_callback_purge_add_task(config, name, GLEWLWYD_PLUGIN_OIDC_TABLE_DPOP, "gpod_id", "gpod_plugin_name", "gpod_iat", 0, NULL) != G_OK ||
+          config->glewlwyd_callback_purge_add_task(config, name, GLEWLWYD_PLUGIN_OIDC_TABLE_PAR, "gpop_id", "gpop_plugin_name", "gpop_expires_at", 0, NULL) != G_OK ||
+          config->glewlwyd_callback_purge_add_task(config, name, GLEWLWYD_PLUGIN_OIDC_TABLE_CIBA, "gpob_id", "gpob_plugin_name", "gpob_expires_at", 0, NULL) != G_OK) {
+        y_log_message(Y_LOG_LEVEL_ERROR, "protocol_init - oidc - Error glewlwyd_callback_purge_add_task");
+        config->glewlwyd_callback_purge_remove_task(config, name);
+        j_return = json_pack("{si}", "result", G_ERROR);
+        break;
+      }
     } while (0);
     json_decref(j_result);
     r_jwk_free(jwk_pub);
@@ -17071,10 +18067,17 @@ json_t * plugin_module_init(struct config_plugin * config, const char * name, js
         o_free(p_config->client_register_scope);
         r_jwks_free(p_config->jwks_sign);
         r_jwks_free(p_config->jwks_public);
+        free_jwks_sign_index(&p_config->jwks_sign_index);
+        glewlwyd_replay_cache_close(&p_config->dpop_jti_cache);
+        glewlwyd_replay_cache_close(&p_config->request_jti_cache);
+        glewlwyd_replay_cache_close(&p_config->ciba_jti_cache);
+        jwks_uri_cache_unref(p_config->jwks_uri_cache);
         json_decref(p_config->j_params);
         pthread_mutex_destroy(&p_config->insert_lock);
         o_free(p_config->discovery_str);
         o_free(p_config->jwks_str);
+        free_static_body(&p_config->discovery_body);
+        free_static_body(&p_config->jwks_body);
         o_free(p_config->check_session_iframe);
         o_free(p_config);
       }
@@ -17091,6 +18094,7 @@ json_t * plugin_module_init(struct config_plugin * config, const char * name, js
 int plugin_module_close(struct config_plugin * config, const char * name, void * cls) {
   if (cls != NULL) {
     y_log_message(Y_LOG_LEVEL_INFO, "Close plugin Glewlwyd OpenID Connect '%s'", name);
+    config->glewlwyd_callback_purge_remove_task(config, name);
     config->glewlwyd_callback_remove_plugin_endpoint(config, "GET", name, "auth/");
     config->glewlwyd_callback_remove_plugin_endpoint(config, "POST", name, "auth/");
     config->glewlwyd_callback_remove_plugin_endpoint(config, "POST", name, "token/");
@@ -17152,12 +18156,21 @@ int plugin_module_close(struct config_plugin * config, const char * name, void *
       config->glewlwyd_callback_remove_plugin_endpoint(config, "GET", name, "ciba_user_list/");
       config->glewlwyd_callback_remove_plugin_endpoint(config, "GET", name, "ciba_user_check/");
     }
+    // Background jobs of this instance use its keys and caches, they must end before those are freed
+    config->glewlwyd_callback_job_cancel(config, cls);
     r_jwks_free(((struct _oidc_config *)cls)->jwks_sign);
     r_jwks_free(((struct _oidc_config *)cls)->jwks_public);
+    free_jwks_sign_index(&((struct _oidc_config *)cls)->jwks_sign_index);
+    glewlwyd_replay_cache_close(&((struct _oidc_config *)cls)->dpop_jti_cache);
+    glewlwyd_replay_cache_close(&((struct _oidc_config *)cls)->request_jti_cache);
+    glewlwyd_replay_cache_close(&((struct _oidc_config *)cls)->ciba_jti_cache);
+    jwks_uri_cache_unref(((struct _oidc_config *)cls)->jwks_uri_cache);
     json_decref(((struct _oidc_config *)cls)->j_params);
     pthread_mutex_destroy(&((struct _oidc_config *)cls)->insert_lock);
     o_free(((struct _oidc_config *)cls)->discovery_str);
     o_free(((struct _oidc_config *)cls)->jwks_str);
+    free_static_body(&((struct _oidc_config *)cls)->discovery_body);
+    free_static_body(&((struct _oidc_config *)cls)->jwks_body);
     o_free(((struct _oidc_config *)cls)->check_session_iframe);
     o_free(cls);
   }
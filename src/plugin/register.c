@@ -210,6 +210,7 @@ static int can_register_scheme(struct _register_config * config, const struct _u
 }
 
 static json_t * register_generate_email_verification_code(struct _register_config * config, const char * username, const char * email, const char * lang, const char * callback_url, const char * issued_for, const char * user_agent, const char * ip_source) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   char * code, * code_hash, * expires_at_clause, * tmp_body, * body, token[GLEWLWYD_TOKEN_LENGTH+1], * token_hash;
   json_t * j_return, * j_query, * j_last_id;
   int res;
@@ -222,9 +223,9 @@ static json_t * register_generate_email_verification_code(struct _register_confi
   } else {
     // Disable existing sessions for the specified e-mail address
     time(&now);
-    if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
       expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-    } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
       expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
     } else { // HOEL_DB_TYPE_SQLITE
       expires_at_clause = msprintf("> %u", (now));
@@ -248,7 +249,7 @@ static json_t * register_generate_email_verification_code(struct _register_confi
                           "gprs_enabled",
                           1);
     o_free(expires_at_clause);
-    res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       code_len = (size_t)json_integer_value(json_object_get(config->j_parameters, "verification-code-length"));
@@ -273,9 +274,9 @@ static json_t * register_generate_email_verification_code(struct _register_confi
                                                    get_template_property(config->j_parameters, lang, "subject"),
                                                    body) == U_OK) {
                       y_log_message(Y_LOG_LEVEL_WARNING, "Security - Register new user - code sent to email %s at IP Address %s", email, ip_source);
-                      if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+                      if (conn->type==HOEL_DB_TYPE_MARIADB) {
                         expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)json_integer_value(json_object_get(config->j_parameters, "verification-code-duration"))));
-                      } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+                      } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
                         expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)json_integer_value(json_object_get(config->j_parameters, "verification-code-duration"))));
                       } else { // HOEL_DB_TYPE_SQLITE
                         expires_at_clause = msprintf("%u", (now + (time_t)json_integer_value(json_object_get(config->j_parameters, "verification-code-duration"))));
@@ -304,10 +305,10 @@ static json_t * register_generate_email_verification_code(struct _register_confi
                                             "gprs_user_agent",
                                             user_agent!=NULL?user_agent:"");
                       o_free(expires_at_clause);
-                      res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+                      res = config->glewlwyd_config->glewlwyd_callback_db_insert(config->glewlwyd_config, conn, j_query, "gprs_id", &j_last_id);
                       json_decref(j_query);
                       if (res == H_OK) {
-                        if ((j_last_id = h_last_insert_id(config->glewlwyd_config->glewlwyd_config->conn)) != NULL) {
+                        if (j_last_id != NULL) {
                           config->glewlwyd_config->glewlwyd_callback_update_issued_for(config->glewlwyd_config, NULL, GLEWLWYD_PLUGIN_REGISTER_TABLE_SESSION, "gprs_issued_for", issued_for, "gprs_id", json_integer_value(j_last_id));
                           j_return = json_pack("{siss}", "result", G_OK, "code", code);
                         } else {
@@ -365,10 +366,12 @@ static json_t * register_generate_email_verification_code(struct _register_confi
     }
     pthread_mutex_unlock(&config->insert_lock);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
 static json_t * register_verify_email_token(struct _register_config * config, const char * token, const char * ip_source) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result = NULL, * j_return, * j_new_user;
   int res;
   char * token_hash = NULL, * expires_at_clause = NULL, session[GLEWLWYD_SESSION_ID_LENGTH+1] = {}, * session_hash = NULL;
@@ -376,9 +379,9 @@ static json_t * register_verify_email_token(struct _register_config * config, co
   
   if ((token_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, token)) != NULL) {
     time(&now);
-    if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
       expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-    } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
       expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
     } else { // HOEL_DB_TYPE_SQLITE
       expires_at_clause = msprintf("> %u", (now));
@@ -403,7 +406,7 @@ static json_t * register_verify_email_token(struct _register_config * config, co
                           "gprs_enabled",
                           1);
     o_free(expires_at_clause);
-    res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+    res = h_select(conn, j_query, &j_result, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       if (json_array_size(j_result)) {
@@ -412,9 +415,9 @@ static json_t * register_verify_email_token(struct _register_config * config, co
           if (rand_string_nonce(session, GLEWLWYD_SESSION_ID_LENGTH) != NULL) {
             if ((session_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, session)) != NULL) {
               time(&now);
-              if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+              if (conn->type==HOEL_DB_TYPE_MARIADB) {
                 expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)json_integer_value(json_object_get(config->j_parameters, "session-duration"))));
-              } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+              } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
                 expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)json_integer_value(json_object_get(config->j_parameters, "session-duration"))));
               } else { // HOEL_DB_TYPE_SQLITE
                 expires_at_clause = msprintf("%u", (now + (time_t)json_integer_value(json_object_get(config->j_parameters, "session-duration"))));
@@ -436,7 +439,7 @@ static json_t * register_verify_email_token(struct _register_config * config, co
                                     "gprs_id",
                                     json_object_get(json_array_get(j_result, 0), "gprs_id"));
               o_free(expires_at_clause);
-              res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+              res = h_update(conn, j_query, NULL);
               json_decref(j_query);
               if (res == H_OK) {
                 j_return = json_pack("{siss}", "result", G_OK, "session", session);
@@ -475,10 +478,12 @@ static json_t * register_verify_email_token(struct _register_config * config, co
     j_return = json_pack("{si}", "result", G_ERROR);
   }
   o_free(token_hash);
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
 static json_t * register_verify_email_code(struct _register_config * config, const char * username, const char * email, const char * code, const char * ip_source) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result = NULL, * j_return, * j_new_user;
   int res;
   char * code_hash = NULL, * expires_at_clause = NULL, session[GLEWLWYD_SESSION_ID_LENGTH+1] = {}, * session_hash = NULL;
@@ -486,9 +491,9 @@ static json_t * register_verify_email_code(struct _register_config * config, con
   
   if ((code_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, code)) != NULL) {
     time(&now);
-    if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
       expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-    } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
       expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
     } else { // HOEL_DB_TYPE_SQLITE
       expires_at_clause = msprintf("> %u", (now));
@@ -515,7 +520,7 @@ static json_t * register_verify_email_code(struct _register_config * config, con
                           "gprs_enabled",
                           1);
     o_free(expires_at_clause);
-    res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+    res = h_select(conn, j_query, &j_result, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       if (json_array_size(j_result)) {
@@ -524,9 +529,9 @@ static json_t * register_verify_email_code(struct _register_config * config, con
           if (rand_string_nonce(session, GLEWLWYD_SESSION_ID_LENGTH) != NULL) {
             if ((session_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, session)) != NULL) {
               time(&now);
-              if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+              if (conn->type==HOEL_DB_TYPE_MARIADB) {
                 expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)json_integer_value(json_object_get(config->j_parameters, "session-duration"))));
-              } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+              } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
                 expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)json_integer_value(json_object_get(config->j_parameters, "session-duration"))));
               } else { // HOEL_DB_TYPE_SQLITE
                 expires_at_clause = msprintf("%u", (now + (time_t)json_integer_value(json_object_get(config->j_parameters, "session-duration"))));
@@ -548,7 +553,7 @@ static json_t * register_verify_email_code(struct _register_config * config, con
                                     "gprs_id",
                                     json_object_get(json_array_get(j_result, 0), "gprs_id"));
               o_free(expires_at_clause);
-              res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+              res = h_update(conn, j_query, NULL);
               json_decref(j_query);
               if (res == H_OK) {
                 j_return = json_pack("{siss}", "result", G_OK, "session", session);
@@ -587,10 +592,12 @@ static json_t * register_verify_email_code(struct _register_config * config, con
     j_return = json_pack("{si}", "result", G_ERROR);
   }
   o_free(code_hash);
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
 static json_t * register_check_session(struct _register_config * config, const char * session) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result = NULL, * j_return;
   int res;
   char * session_hash = NULL, * expires_at_clause = NULL;
@@ -600,9 +607,9 @@ static json_t * register_check_session(struct _register_config * config, const c
     session_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, session);
     if (session_hash != NULL) {
       time(&now);
-      if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+      if (conn->type==HOEL_DB_TYPE_MARIADB) {
         expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-      } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+      } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
         expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
       } else { // HOEL_DB_TYPE_SQLITE
         expires_at_clause = msprintf("> %u", (now));
@@ -629,7 +636,7 @@ static json_t * register_check_session(struct _register_config * config, const c
                             "gprs_enabled",
                             1);
       o_free(expires_at_clause);
-      res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+      res = h_select(conn, j_query, &j_result, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         if (json_array_size(j_result)) {
@@ -657,10 +664,12 @@ static json_t * register_check_session(struct _register_config * config, const c
   } else {
     j_return = json_pack("{si}", "result", G_ERROR_NOT_FOUND);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
 static json_t * register_check_username(struct _register_config * config, const char * username) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result = NULL, * j_return;
   int res;
   char * expires_at_clause = NULL;
@@ -668,9 +677,9 @@ static json_t * register_check_username(struct _register_config * config, const
   
   if (!o_strnullempty(username)) {
     time(&now);
-    if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
       expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-    } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
       expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
     } else { // HOEL_DB_TYPE_SQLITE
       expires_at_clause = msprintf("> %u", (now));
@@ -693,7 +702,7 @@ static json_t * register_check_username(struct _register_config * config, const
                           "gprs_enabled",
                           1);
     o_free(expires_at_clause);
-    res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+    res = h_select(conn, j_query, &j_result, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       if (json_array_size(j_result)) {
@@ -710,10 +719,12 @@ static json_t * register_check_username(struct _register_config * config, const
   } else {
     j_return = json_pack("{si}", "result", G_ERROR_PARAM);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
 static json_t * register_new_user(struct _register_config * config, const char * username, const char * issued_for, const char * user_agent) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_return, * j_user, * j_new_user, * j_last_id, * j_result;
   int res;
   char * expires_at_clause, session[GLEWLWYD_SESSION_ID_LENGTH+1] = {}, * session_hash = NULL;
@@ -732,9 +743,9 @@ static json_t * register_new_user(struct _register_config * config, const char *
           if (rand_string_nonce(session, GLEWLWYD_SESSION_ID_LENGTH) != NULL) {
             if ((session_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, session)) != NULL) {
               time(&now);
-              if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+              if (conn->type==HOEL_DB_TYPE_MARIADB) {
                 expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)json_integer_value(json_object_get(config->j_parameters, "session-duration"))));
-              } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+              } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
                 expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)json_integer_value(json_object_get(config->j_parameters, "session-duration"))));
               } else { // HOEL_DB_TYPE_SQLITE
                 expires_at_clause = msprintf("%u", (now + (time_t)json_integer_value(json_object_get(config->j_parameters, "session-duration"))));
@@ -757,10 +768,10 @@ static json_t * register_new_user(struct _register_config * config, const char *
                                     "gprs_user_agent",
                                     user_agent!=NULL?user_agent:"");
               o_free(expires_at_clause);
-              res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+              res = config->glewlwyd_config->glewlwyd_callback_db_insert(config->glewlwyd_config, conn, j_query, "gprs_id", &j_last_id);
               json_decref(j_query);
               if (res == H_OK) {
-                if ((j_last_id = h_last_insert_id(config->glewlwyd_config->glewlwyd_config->conn)) != NULL) {
+                if (j_last_id != NULL) {
                   config->glewlwyd_config->glewlwyd_callback_update_issued_for(config->glewlwyd_config, NULL, GLEWLWYD_PLUGIN_REGISTER_TABLE_SESSION, "gprs_issued_for", issued_for, "gprs_id", json_integer_value(j_last_id));
                   j_return = json_pack("{siss}", "result", G_OK, "session", session);
                 } else {
@@ -804,19 +815,21 @@ static json_t * register_new_user(struct _register_config * config, const char *
     json_decref(j_user);
     pthread_mutex_unlock(&config->insert_lock);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
 static int register_user_set(struct _register_config * config, const char * username, json_t * j_user) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res, ret;
   char * expires_at_clause = NULL;
   time_t now;
   
   time(&now);
-  if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+  if (conn->type==HOEL_DB_TYPE_MARIADB) {
     expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-  } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+  } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
     expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
   } else { // HOEL_DB_TYPE_SQLITE
     expires_at_clause = msprintf("> %u", (now));
@@ -840,7 +853,7 @@ static int register_user_set(struct _register_config * config, const char * user
                         "gprs_enabled",
                         1);
   o_free(expires_at_clause);
-  res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = G_OK;
@@ -849,19 +862,21 @@ static int register_user_set(struct _register_config * config, const char * user
     config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static int register_user_password_set(struct _register_config * config, const char * username) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res, ret;
   char * expires_at_clause = NULL;
   time_t now;
   
   time(&now);
-  if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+  if (conn->type==HOEL_DB_TYPE_MARIADB) {
     expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-  } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+  } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
     expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
   } else { // HOEL_DB_TYPE_SQLITE
     expires_at_clause = msprintf("> %u", (now));
@@ -885,7 +900,7 @@ static int register_user_password_set(struct _register_config * config, const ch
                         "gprs_enabled",
                         1);
   o_free(expires_at_clause);
-  res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = G_OK;
@@ -894,19 +909,21 @@ static int register_user_password_set(struct _register_config * config, const ch
     config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static int register_user_complete(struct _register_config * config, const char * username) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res, ret;
   char * expires_at_clause = NULL;
   time_t now;
   
   time(&now);
-  if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+  if (conn->type==HOEL_DB_TYPE_MARIADB) {
     expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-  } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+  } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
     expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
   } else { // HOEL_DB_TYPE_SQLITE
     expires_at_clause = msprintf("> %u", (now));
@@ -930,7 +947,7 @@ static int register_user_complete(struct _register_config * config, const char *
                         "gprs_enabled",
                         1);
   o_free(expires_at_clause);
-  res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = G_OK;
@@ -939,6 +956,7 @@ static int register_user_complete(struct _register_config * config, const char *
     config->glewlwyd_config->glewlwyd_plugin_callback_metrics_increment_counter(config->glewlwyd_config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
@@ -969,6 +987,7 @@ static int register_delete_new_user(struct _register_config * config, const char
 }
 
 static int register_update_email_trigger(struct _register_config * config, const char * username, const char * email, const char * lang, const char * issued_for, const char * user_agent, const char * ip_source) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_last_id;
   int ret, res;
   char token[GLEWLWYD_TOKEN_LENGTH+1] = {0}, * token_hash = NULL, * body = NULL, * expires_at_clause;
@@ -980,9 +999,9 @@ static int register_update_email_trigger(struct _register_config * config, const
   } else {
     // Disable existing sessions for the specified e-mail address
     time(&now);
-    if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
       expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-    } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
       expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
     } else { // HOEL_DB_TYPE_SQLITE
       expires_at_clause = msprintf("> %u", (now));
@@ -1006,7 +1025,7 @@ static int register_update_email_trigger(struct _register_config * config, const
                             "value",
                             expires_at_clause);
     o_free(expires_at_clause);
-    res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       if (rand_string(token, GLEWLWYD_TOKEN_LENGTH) != NULL) {
@@ -1026,9 +1045,9 @@ static int register_update_email_trigger(struct _register_config * config, const
                                            get_template_email_update_property(config->j_parameters, lang, "subject"),
                                            body) == U_OK) {
               y_log_message(Y_LOG_LEVEL_WARNING, "Security - Update e-mail - token sent to email %s at IP Address %s", email, ip_source);
-              if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+              if (conn->type==HOEL_DB_TYPE_MARIADB) {
                 expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)json_integer_value(json_object_get(config->j_parameters, "update-email-token-duration"))));
-              } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+              } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
                 expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)json_integer_value(json_object_get(config->j_parameters, "update-email-token-duration"))));
               } else { // HOEL_DB_TYPE_SQLITE
                 expires_at_clause = msprintf("%u", (now + (time_t)json_integer_value(json_object_get(config->j_parameters, "update-email-token-duration"))));
@@ -1053,10 +1072,10 @@ static int register_update_email_trigger(struct _register_config * config, const
                                     "gprue_user_agent",
                                     user_agent!=NULL?user_agent:"");
               o_free(expires_at_clause);
-              res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+              res = config->glewlwyd_config->glewlwyd_callback_db_insert(config->glewlwyd_config, conn, j_query, "gprue_id", &j_last_id);
               json_decref(j_query);
               if (res == H_OK) {
-                if ((j_last_id = h_last_insert_id(config->glewlwyd_config->glewlwyd_config->conn)) != NULL) {
+                if (j_last_id != NULL) {
                   config->glewlwyd_config->glewlwyd_callback_update_issued_for(config->glewlwyd_config, NULL, GLEWLWYD_PLUGIN_REGISTER_TABLE_UPDATE_EMAIL, "gprue_issued_for", issued_for, "gprue_id", json_integer_value(j_last_id));
                   ret = G_OK;
                 } else {
@@ -1095,10 +1114,12 @@ static int register_update_email_trigger(struct _register_config * config, const
     }
     pthread_mutex_unlock(&config->insert_lock);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static int register_update_email_verify(struct _register_config * config, const char * token, const char * ip_source) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result = NULL, * j_updated_user = NULL;
   int res, ret;
   char * token_hash = NULL, * expires_at_clause = NULL;
@@ -1107,9 +1128,9 @@ static int register_update_email_verify(struct _register_config * config, const
   if (o_strlen(token) == GLEWLWYD_TOKEN_LENGTH) {
     if ((token_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, token)) != NULL) {
       time(&now);
-      if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+      if (conn->type==HOEL_DB_TYPE_MARIADB) {
         expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-      } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+      } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
         expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
       } else { // HOEL_DB_TYPE_SQLITE
         expires_at_clause = msprintf("> %u", (now));
@@ -1134,7 +1155,7 @@ static int register_update_email_verify(struct _register_config * config, const
                             "gprue_enabled",
                             1);
       o_free(expires_at_clause);
-      res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+      res = h_select(conn, j_query, &j_result, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         if (json_array_size(j_result)) {
@@ -1151,7 +1172,7 @@ static int register_update_email_verify(struct _register_config * config, const
                                   "where",
                                     "gprue_id",
                                     json_object_get(json_array_get(j_result, 0), "gprue_id"));
-              res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+              res = h_update(conn, j_query, NULL);
               json_decref(j_query);
               if (res == H_OK) {
                 ret = G_OK;
@@ -1189,10 +1210,12 @@ static int register_update_email_verify(struct _register_config * config, const
     y_log_message(Y_LOG_LEVEL_WARNING, "Security - Update e-mail - token invalid at IP Address %s", ip_source);
     ret = G_ERROR_PARAM;
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static json_t * reset_credentials_check_session(struct _register_config * config, const char * session) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_result = NULL, * j_return, * j_user;
   int res;
   char * session_hash = NULL, * expires_at_clause = NULL;
@@ -1202,9 +1225,9 @@ static json_t * reset_credentials_check_session(struct _register_config * config
     session_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, session);
     if (session_hash != NULL) {
       time(&now);
-      if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+      if (conn->type==HOEL_DB_TYPE_MARIADB) {
         expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-      } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+      } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
         expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
       } else { // HOEL_DB_TYPE_SQLITE
         expires_at_clause = msprintf("> %u", (now));
@@ -1228,7 +1251,7 @@ static json_t * reset_credentials_check_session(struct _register_config * config
                             "gprrcs_enabled",
                             1);
       o_free(expires_at_clause);
-      res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+      res = h_select(conn, j_query, &j_result, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         if (json_array_size(j_result)) {
@@ -1257,10 +1280,12 @@ static json_t * reset_credentials_check_session(struct _register_config * config
   } else {
     j_return = json_pack("{si}", "result", G_ERROR_NOT_FOUND);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
 static int reset_credentials_remove_session(struct _register_config * config, const char * session) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query;
   int res, ret;
   char * session_hash = NULL;
@@ -1275,7 +1300,7 @@ static int reset_credentials_remove_session(struct _register_config * config, co
                         "where",
                           "gprrcs_plugin_name", config->name,
                           "gprrcs_session_hash", session_hash);
-    res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       ret = G_OK;
@@ -1289,10 +1314,12 @@ static int reset_credentials_remove_session(struct _register_config * config, co
     ret = G_ERROR;
   }
   o_free(session_hash);
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static int register_reset_credentials_trigger(struct _register_config * config, const char * username, const char * lang, const char * callback_url, const char * issued_for, const char * user_agent, const char * ip_source) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_query, * j_user = config->glewlwyd_config->glewlwyd_plugin_callback_get_user(config->glewlwyd_config, username), * j_last_id = NULL;
   int ret, res;
   char token[GLEWLWYD_TOKEN_LENGTH+1] = {0}, * token_hash = NULL, * body = NULL, * expires_at_clause;
@@ -1307,9 +1334,9 @@ static int register_reset_credentials_trigger(struct _register_config * config,
       email = json_string_value(json_object_get(json_object_get(j_user, "user"), "email"));
       // Disable existing sessions for the specified e-mail address
       time(&now);
-      if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+      if (conn->type==HOEL_DB_TYPE_MARIADB) {
         expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-      } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+      } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
         expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
       } else { // HOEL_DB_TYPE_SQLITE
         expires_at_clause = msprintf("> %u", (now));
@@ -1333,7 +1360,7 @@ static int register_reset_credentials_trigger(struct _register_config * config,
                               "value",
                               expires_at_clause);
       o_free(expires_at_clause);
-      res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+      res = h_update(conn, j_query, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         if (rand_string(token, GLEWLWYD_TOKEN_LENGTH) != NULL) {
@@ -1353,9 +1380,9 @@ static int register_reset_credentials_trigger(struct _register_config * config,
                                              get_template_reset_credentials_property(config->j_parameters, lang, "subject"),
                                              body) == U_OK) {
                 y_log_message(Y_LOG_LEVEL_WARNING, "Security - Reset credentials - token sent to email %s at IP Address %s", email, ip_source);
-                if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+                if (conn->type==HOEL_DB_TYPE_MARIADB) {
                   expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)json_integer_value(json_object_get(config->j_parameters, "reset-credentials-token-duration"))));
-                } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+                } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
                   expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)json_integer_value(json_object_get(config->j_parameters, "reset-credentials-token-duration"))));
                 } else { // HOEL_DB_TYPE_SQLITE
                   expires_at_clause = msprintf("%u", (now + (time_t)json_integer_value(json_object_get(config->j_parameters, "reset-credentials-token-duration"))));
@@ -1374,10 +1401,10 @@ static int register_reset_credentials_trigger(struct _register_config * config,
                                       "gprrct_issued_for", issued_for,
                                       "gprrct_user_agent", user_agent!=NULL?user_agent:"");
                 o_free(expires_at_clause);
-                res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+                res = config->glewlwyd_config->glewlwyd_callback_db_insert(config->glewlwyd_config, conn, j_query, "gprrct_id", &j_last_id);
                 json_decref(j_query);
                 if (res == H_OK) {
-                  if ((j_last_id = h_last_insert_id(config->glewlwyd_config->glewlwyd_config->conn)) != NULL) {
+                  if (j_last_id != NULL) {
                     config->glewlwyd_config->glewlwyd_callback_update_issued_for(config->glewlwyd_config, NULL, GLEWLWYD_PLUGIN_REGISTER_TABLE_RESET_CREDENTIALS_EMAIL, "gprrct_issued_for", issued_for, "gprrct_id", json_integer_value(j_last_id));
                     ret = G_OK;
                   } else {
@@ -1423,10 +1450,12 @@ static int register_reset_credentials_trigger(struct _register_config * config,
     pthread_mutex_unlock(&config->insert_lock);
   }
   json_decref(j_user);
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return ret;
 }
 
 static json_t * register_reset_credentials_check_token(struct _register_config * config, const char * token) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_return, * j_query, * j_result = NULL;
   int res;
   char * token_hash = NULL, * expires_at_clause = NULL;
@@ -1434,9 +1463,9 @@ static json_t * register_reset_credentials_check_token(struct _register_config *
   
   if ((token_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, token)) != NULL) {
     time(&now);
-    if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
       expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-    } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
       expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
     } else { // HOEL_DB_TYPE_SQLITE
       expires_at_clause = msprintf("> %u", (now));
@@ -1458,7 +1487,7 @@ static json_t * register_reset_credentials_check_token(struct _register_config *
                             expires_at_clause,
                           "gprrct_enabled", 1);
     o_free(expires_at_clause);
-    res = h_select(config->glewlwyd_config->glewlwyd_config->conn, j_query, &j_result, NULL);
+    res = h_select(conn, j_query, &j_result, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       if (json_array_size(j_result)) {
@@ -1471,7 +1500,7 @@ static json_t * register_reset_credentials_check_token(struct _register_config *
                             "where",
                               "gprrct_id",
                               json_object_get(json_array_get(j_result, 0), "gprrct_id"));
-        res = h_update(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+        res = h_update(conn, j_query, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           j_return = json_pack("{sisO}", "result", G_OK, "username", json_object_get(json_array_get(j_result, 0), "username"));
@@ -1494,27 +1523,23 @@ static json_t * register_reset_credentials_check_token(struct _register_config *
     j_return = json_pack("{si}", "result", G_ERROR);
   }
   o_free(token_hash);
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
 static json_t * reset_credentials_create_session(struct _register_config * config, const char * username, const char * callback_url, const char * issued_for, const char * user_agent) {
+  struct _h_connection * conn = config->glewlwyd_config->glewlwyd_callback_db_checkout(config->glewlwyd_config);
   json_t * j_return, * j_query, * j_last_id;
   int res;
   char token[GLEWLWYD_TOKEN_LENGTH+1] = {}, * token_hash = NULL, * expires_at_clause;
   time_t now;
   
-  if (pthread_mutex_lock(&config->insert_lock)) {
-    y_log_message(Y_LOG_LEVEL_ERROR, "reset_credentials_create_session - Error pthread_mutex_lock");
-    j_return = json_pack("{si}", "result", G_ERROR);
-  } else {
-    pthread_mutex_unlock(&config->insert_lock);
-  }
   if (rand_string_nonce(token, GLEWLWYD_TOKEN_LENGTH)) {
     if ((token_hash = config->glewlwyd_config->glewlwyd_callback_generate_hash(config->glewlwyd_config, token)) != NULL) {
       time(&now);
-      if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_MARIADB) {
+      if (conn->type==HOEL_DB_TYPE_MARIADB) {
         expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)json_integer_value(json_object_get(config->j_parameters, "reset-credentials-session-duration"))));
-      } else if (config->glewlwyd_config->glewlwyd_config->conn->type==HOEL_DB_TYPE_PGSQL) {
+      } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
         expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)json_integer_value(json_object_get(config->j_parameters, "reset-credentials-session-duration"))));
       } else { // HOEL_DB_TYPE_SQLITE
         expires_at_clause = msprintf("%u", (now + (time_t)json_integer_value(json_object_get(config->j_parameters, "reset-credentials-session-duration"))));
@@ -1533,10 +1558,10 @@ static json_t * reset_credentials_create_session(struct _register_config * confi
                             "gprrcs_issued_for", issued_for,
                             "gprrcs_user_agent", user_agent!=NULL?user_agent:"");
       o_free(expires_at_clause);
-      res = h_insert(config->glewlwyd_config->glewlwyd_config->conn, j_query, NULL);
+      res = config->glewlwyd_config->glewlwyd_callback_db_insert(config->glewlwyd_config, conn, j_query, "gprrcs_id", &j_last_id);
       json_decref(j_query);
       if (res == H_OK) {
-        if ((j_last_id = h_last_insert_id(config->glewlwyd_config->glewlwyd_config->conn)) != NULL) {
+        if (j_last_id != NULL) {
           config->glewlwyd_config->glewlwyd_callback_update_issued_for(config->glewlwyd_config, NULL, GLEWLWYD_PLUGIN_REGISTER_TABLE_RESET_CREDENTIALS_SESSION, "gprrcs_issued_for", issued_for, "gprrcs_id", json_integer_value(j_last_id));
           j_return = json_pack("{siss}", "result", G_OK, "session", token);
         } else {
@@ -1559,6 +1584,7 @@ static json_t * reset_credentials_create_session(struct _register_config * confi
     y_log_message(Y_LOG_LEVEL_ERROR, "reset_credentials_create_session - Error rand_string_nonce");
     j_return = json_pack("{si}", "result", G_ERROR);
   }
+  config->glewlwyd_config->glewlwyd_callback_db_checkin(config->glewlwyd_config, conn);
   return j_return;
 }
 
@@ -2879,6 +2905,14 @@ json_t * plugin_module_init(struct config_plugin * config, const char * name, js
               }
             }
           }
+          if (config->glewlwyd_callback_purge_add_task(config, name, GLEWLWYD_PLUGIN_REGISTER_TABLE_SESSION, "gprs_id", "gprs_plugin_name", "gprs_expires_at", 0, NULL) != G_OK ||
+              config->glewlwyd_callback_purge_add_task(config, name, GLEWLWYD_PLUGIN_REGISTER_TABLE_UPDATE_EMAIL, "gprue_id", "gprue_plugin_name", "gprue_expires_at", 0, NULL) != G_OK ||
+              config->glewlwyd_callback_purge_add_task(config, name, GLEWLWYD_PLUGIN_REGISTER_TABLE_RESET_CREDENTIALS_SESSION, "gprrcs_id", "gprrcs_plugin_name", "gprrcs_expires_at", 0, NULL) != G_OK ||
+              config->glewlwyd_callback_purge_add_task(config, name, GLEWLWYD_PLUGIN_REGISTER_TABLE_RESET_CREDENTIALS_EMAIL, "gprrct_id", "gprrct_plugin_name", "gprrct_expires_at", 0, NULL) != G_OK) {
+            y_log_message(Y_LOG_LEVEL_ERROR, "plugin_module_init register - Error glewlwyd_callback_purge_add_task");
+            config->glewlwyd_callback_purge_remove_task(config, name);
+            registration_ok = 0;
+          }
           if (registration_ok && update_email_ok && reset_credentials_ok) {
             j_return = json_pack("{si}", "result", G_OK);
           } else {
@@ -2907,6 +2941,7 @@ json_t * plugin_module_init(struct config_plugin * config, const char * name, js
 int plugin_module_close(struct config_plugin * config, const char * name, void * cls) {
   y_log_message(Y_LOG_LEVEL_INFO, "Close plugin Glewlwyd register '%s'", name);
   if (cls != NULL) {
+    config->glewlwyd_callback_purge_remove_task(config, name);
     config->glewlwyd_callback_remove_plugin_endpoint(config, "GET", name, "config");
     if (json_object_get(((struct _register_config *)cls)->j_parameters, "registration") == json_true() || json_object_get(((struct _register_config *)cls)->j_parameters, "registration") == NULL) {
       config->glewlwyd_callback_remove_plugin_endpoint(config, "POST", name, "username");
@@ -0,0 +1,407 @@
+/**
+ *
+ * Glewlwyd SSO Server
+ *
+ * Authentiation server
+ * Users are authenticated via various backend available: database, ldap
+ * Using various authentication methods available: password, OTP, send code, etc.
+ *
+ * Expired rows purge functions definitions
+ *
+ * Copyright 2016-2021 Nicolas Mora <mail@babelouest.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU GENERAL PUBLIC LICENSE
+ * License as published by the Free Software Foundation;
+ * version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU GENERAL PUBLIC LICENSE for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "glewlwyd.h"
+
+/**
+ * Expired rows of a table, i.e. rows whose date_column is older than
+ * the purge retention plus extra_retention
+ * If plugin_column is set, only the rows of the plugin instance name are purged
+ * condition is an optional sql condition added to the id column clause
+ * last_id is the position of the purge in the table, the rows are purged by id order
+ */
+struct _glwd_purge_task {
+  char               * name;
+  char               * table;
+  char               * id_column;
+  char               * plugin_column;
+  char               * date_column;
+  unsigned int         extra_retention;
+  char               * condition;
+  json_int_t           last_id;
+  unsigned short       pending;
+  unsigned short       running;
+  size_t               nb_deleted;
+  size_t               nb_batch;
+  unsigned long long   usec;
+};
+
+static void glewlwyd_purge_task_free(struct _glwd_purge_task * task) {
+  if (task != NULL) {
+    o_free(task->name);
+    o_free(task->table);
+    o_free(task->id_column);
+    o_free(task->plugin_column);
+    o_free(task->date_column);
+    o_free(task->condition);
+    o_free(task);
+  }
+}
+
+/**
+ * Deletes the next batch of expired rows of the task, nb_deleted is set to the number of rows deleted
+ * The purge lock must not be held
+ */
+static int glewlwyd_purge_task_batch(struct config_elements * config, struct _glwd_purge_task * task, size_t * nb_deleted) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
+  json_t * j_query, * j_result = NULL, * j_element = NULL;
+  char * date_clause, * id_clause;
+  time_t cutoff = time(NULL) - (time_t)config->purge.retention - (time_t)task->extra_retention;
+  size_t index = 0;
+  int res, ret;
+
+  *nb_deleted = 0;
+  if (conn->type==HOEL_DB_TYPE_MARIADB) {
+    date_clause = msprintf("< FROM_UNIXTIME(%" JSON_INTEGER_FORMAT ")", (json_int_t)cutoff);
+  } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
+    date_clause = msprintf("< TO_TIMESTAMP(%" JSON_INTEGER_FORMAT ")", (json_int_t)cutoff);
+  } else { // HOEL_DB_TYPE_SQLITE
+    date_clause = msprintf("< %" JSON_INTEGER_FORMAT, (json_int_t)cutoff);
+  }
+  if (task->condition != NULL) {
+    id_clause = msprintf("> %" JSON_INTEGER_FORMAT " AND %s", task->last_id, task->condition);
+  } else {
+    id_clause = msprintf("> %" JSON_INTEGER_FORMAT, task->last_id);
+  }
+  j_query = json_pack("{sss[s]s{s{ssss}s{ssss}}sssI}",
+                      "table",
+                      task->table,
+                      "columns",
+                        task->id_column,
+                      "where",
+                        task->id_column,
+                          "operator",
+                          "raw",
+                          "value",
+                          id_clause,
+                        task->date_column,
+                          "operator",
+                          "raw",
+                          "value",
+                          date_clause,
+                      "order_by",
+                      task->id_column,
+                      "limit",
+                      (json_int_t)config->purge.batch_size);
+  if (task->plugin_column != NULL) {
+    json_object_set_new(json_object_get(j_query, "where"), task->plugin_column, json_string(task->name));
+  }
+  o_free(date_clause);
+  o_free(id_clause);
+  res = h_select(conn, j_query, &j_result, NULL);
+  json_decref(j_query);
+  if (res == H_OK) {
+    if (json_array_size(j_result)) {
+      j_query = json_pack("{sss{s{ssso}}}",
+                          "table",
+                          task->table,
+                          "where",
+                            task->id_column,
+                              "operator",
+                              "IN",
+                              "value",
+                              json_array());
+      json_array_foreach(j_result, index, j_element) {
+        json_array_append(json_object_get(json_object_get(json_object_get(j_query, "where"), task->id_column), "value"), json_object_get(j_element, task->id_column));
+      }
+      res = h_delete(conn, j_query, NULL);
+      json_decref(j_query);
+      if (res == H_OK) {
+        task->last_id = json_integer_value(json_object_get(json_array_get(j_result, json_array_size(j_result)-1), task->id_column));
+        *nb_deleted = json_array_size(j_result);
+        ret = G_OK;
+      } else {
+        y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_purge_task_batch - Error executing j_query (2) on table %s", task->table);
+        ret = G_ERROR_DB;
+      }
+    } else {
+      ret = G_OK;
+    }
+    json_decref(j_result);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_purge_task_batch - Error executing j_query (1) on table %s", task->table);
+    ret = G_ERROR_DB;
+  }
+  glewlwyd_db_pool_checkin(config, conn);
+  return ret;
+}
+
+/**
+ * Waits msec milliseconds or until the purge is stopped
+ * The purge lock must be held
+ */
+static void glewlwyd_purge_wait(struct _glwd_purge * purge, unsigned long msec) {
+  struct timespec deadline;
+
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += (time_t)(msec/1000);
+  deadline.tv_nsec += (long)(msec%1000)*1000000L;
+  if (deadline.tv_nsec >= 1000000000L) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+  while (!purge->stop && pthread_cond_timedwait(&purge->cond, &purge->lock, &deadline) != ETIMEDOUT);
+}
+
+/**
+ * Every purge interval, the tasks are run one batch at a time in turn,
+ * with a pause of batch_delay milliseconds between batches,
+ * until each task has no more expired rows
+ * The lock isn't held while a batch is running
+ */
+static void * glewlwyd_purge_run(void * args) {
+  struct config_elements * config = (struct config_elements *)args;
+  struct _glwd_purge * purge = &config->purge;
+  struct _glwd_purge_task * task;
+  struct timespec start, end;
+  size_t i, nb_deleted;
+  int has_pending, res;
+
+  pthread_mutex_lock(&purge->lock);
+  while (!purge->stop) {
+    glewlwyd_purge_wait(purge, (unsigned long)purge->interval*1000);
+    for (i=0; i<purge->nb_task; i++) {
+      purge->task_list[i]->pending = 1;
+      purge->task_list[i]->last_id = 0;
+    }
+    do {
+      has_pending = 0;
+      for (i=0; !purge->stop && i<purge->nb_task; i++) {
+        task = purge->task_list[i];
+        if (task->pending) {
+          task->running = 1;
+          pthread_mutex_unlock(&purge->lock);
+          clock_gettime(CLOCK_MONOTONIC, &start);
+          res = glewlwyd_purge_task_batch(config, task, &nb_deleted);
+          clock_gettime(CLOCK_MONOTONIC, &end);
+          pthread_mutex_lock(&purge->lock);
+          task->running = 0;
+          task->nb_batch++;
+          task->nb_deleted += nb_deleted;
+          task->usec += (unsigned long long)((end.tv_sec-start.tv_sec)*1000000L + (end.tv_nsec-start.tv_nsec)/1000L);
+          if (res != G_OK || nb_deleted < purge->batch_size) {
+            task->pending = 0;
+            if (nb_deleted) {
+              y_log_message(Y_LOG_LEVEL_DEBUG, "Purge %s %s complete", task->name, task->table);
+            }
+          } else {
+            has_pending = 1;
+          }
+          // glewlwyd_purge_remove_task may be waiting for this task
+          pthread_cond_broadcast(&purge->cond);
+          if (purge->batch_delay) {
+            glewlwyd_purge_wait(purge, purge->batch_delay);
+          }
+        }
+      }
+    } while (has_pending && !purge->stop);
+  }
+  pthread_mutex_unlock(&purge->lock);
+  return NULL;
+}
+
+int glewlwyd_purge_init(struct config_elements * config) {
+  struct _glwd_purge * purge = &config->purge;
+  int ret = G_OK;
+
+  purge->task_list = NULL;
+  purge->nb_task = 0;
+  purge->stop = 0;
+  if (!purge->interval) {
+    y_log_message(Y_LOG_LEVEL_INFO, "Purge of expired rows disabled");
+  } else if (!purge->batch_size) {
+    y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_purge_init - Error invalid parameters");
+    ret = G_ERROR_PARAM;
+  } else if (pthread_mutex_init(&purge->lock, NULL) || pthread_cond_init(&purge->cond, NULL)) {
+    y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_purge_init - Error initializing lock or cond");
+    ret = G_ERROR;
+  } else if (pthread_create(&purge->thread, NULL, glewlwyd_purge_run, config)) {
+    y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_purge_init - Error pthread_create");
+    pthread_mutex_destroy(&purge->lock);
+    pthread_cond_destroy(&purge->cond);
+    ret = G_ERROR;
+  } else {
+    purge->initialized = 1;
+  }
+  return ret;
+}
+
+/**
+ * Stops the purge after the current batch and removes all the tasks
+ */
+void glewlwyd_purge_close(struct config_elements * config) {
+  struct _glwd_purge * purge = &config->purge;
+  size_t i;
+
+  if (purge->initialized) {
+    pthread_mutex_lock(&purge->lock);
+    purge->stop = 1;
+    pthread_cond_broadcast(&purge->cond);
+    pthread_mutex_unlock(&purge->lock);
+    pthread_join(purge->thread, NULL);
+    for (i=0; i<purge->nb_task; i++) {
+      glewlwyd_purge_task_free(purge->task_list[i]);
+    }
+    o_free(purge->task_list);
+    purge->task_list = NULL;
+    purge->nb_task = 0;
+    pthread_mutex_destroy(&purge->lock);
+    pthread_cond_destroy(&purge->cond);
+    purge->initialized = 0;
+  }
+}
+
+/**
+ * Adds a table to purge, the rows are expired when date_column is older than the
+ * purge retention plus extra_retention seconds
+ * If plugin_column is not NULL, only the rows where plugin_column is name are purged
+ * condition is an optional sql condition that the id column of the rows must match too,
+ * e.g. to keep the rows referenced by other rows
+ */
+int glewlwyd_purge_add_task(struct config_elements * config, const char * name, const char * table, const char * id_column, const char * plugin_column, const char * date_column, unsigned int extra_retention, const char * condition) {
+  struct _glwd_purge * purge = &config->purge;
+  struct _glwd_purge_task * task, ** task_list;
+  int ret;
+
+  if (!o_strnullempty(name) && !o_strnullempty(table) && !o_strnullempty(id_column) && !o_strnullempty(date_column)) {
+    if (purge->initialized) {
+      if ((task = o_malloc(sizeof(struct _glwd_purge_task))) != NULL) {
+        memset(task, 0, sizeof(struct _glwd_purge_task));
+        task->name = o_strdup(name);
+        task->table = o_strdup(table);
+        task->id_column = o_strdup(id_column);
+        task->plugin_column = o_strdup(plugin_column);
+        task->date_column = o_strdup(date_column);
+        task->extra_retention = extra_retention;
+        task->condition = o_strdup(condition);
+        if (!pthread_mutex_lock(&purge->lock)) {
+          if ((task_list = o_realloc(purge->task_list, (purge->nb_task+1)*sizeof(struct _glwd_purge_task *))) != NULL) {
+            purge->task_list = task_list;
+            purge->task_list[purge->nb_task] = task;
+            purge->nb_task++;
+            ret = G_OK;
+          } else {
+            y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_purge_add_task - Error allocating resources for task_list");
+            glewlwyd_purge_task_free(task);
+            ret = G_ERROR_MEMORY;
+          }
+          pthread_mutex_unlock(&purge->lock);
+        } else {
+          y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_purge_add_task - Error lock");
+          glewlwyd_purge_task_free(task);
+          ret = G_ERROR;
+        }
+      } else {
+        y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_purge_add_task - Error allocating resources for task");
+        ret = G_ERROR_MEMORY;
+      }
+    } else {
+      // Purge disabled
+      ret = G_OK;
+    }
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "glewlwyd_purge_add_task - Error input parameters");
+    ret = G_ERROR_PARAM;
+  }
+  return ret;
+}
+
+/**
+ * Removes all the tasks of name, waits for the batch running on one of them if any
+ */
+void glewlwyd_purge_remove_task(struct config_elements * config, const char * name) {
+  struct _glwd_purge * purge = &config->purge;
+  size_t i;
+
+  if (purge->initialized && !pthread_mutex_lock(&purge->lock)) {
+    i = 0;
+    while (i<purge->nb_task) {
+      if (0 == o_strcmp(purge->task_list[i]->name, name)) {
+        if (purge->task_list[i]->running) {
+          pthread_cond_wait(&purge->cond, &purge->lock);
+          // The task list may have changed in the meantime
+          i = 0;
+        } else {
+          glewlwyd_purge_task_free(purge->task_list[i]);
+          memmove(purge->task_list+i, purge->task_list+i+1, (purge->nb_task-i-1)*sizeof(struct _glwd_purge_task *));
+          purge->nb_task--;
+        }
+      } else {
+        i++;
+      }
+    }
+    pthread_mutex_unlock(&purge->lock);
+  }
+}
+
+char * glewlwyd_purge_metrics(struct config_elements * config) {
+  struct _glwd_purge * purge = &config->purge;
+  const char * metric_list[][2] = {
+    {"glewlwyd_purge_deleted_total", "Total number of expired rows deleted"},
+    {"glewlwyd_purge_batches_total", "Total number of purge batches run"},
+    {"glewlwyd_purge_seconds_total", "Total time spent purging expired rows"}
+  };
+  char * content = NULL;
+  size_t i, j;
+
+  if (purge->initialized && !pthread_mutex_lock(&purge->lock)) {
+    for (j=0; j<3; j++) {
+      if (content == NULL) {
+        content = msprintf("# HELP %s %s\n# TYPE %s counter\n", metric_list[j][0], metric_list[j][1], metric_list[j][0]);
+      } else {
+        content = mstrcatf(content, "# HELP %s %s\n# TYPE %s counter\n", metric_list[j][0], metric_list[j][1], metric_list[j][0]);
+      }
+      for (i=0; i<purge->nb_task; i++) {
+        switch (j) {
+          case 0:
+            content = mstrcatf(content, "%s{plugin=\"%s\", table=\"%s\"} %zu\n", metric_list[j][0], purge->task_list[i]->name, purge->task_list[i]->table, purge->task_list[i]->nb_deleted);
+            break;
+          case 1:
+            content = mstrcatf(content, "%s{plugin=\"%s\", table=\"%s\"} %zu\n", metric_list[j][0], purge->task_list[i]->name, purge->task_list[i]->table, purge->task_list[i]->nb_batch);
+            break;
+          default:
+            content = mstrcatf(content, "%s{plugin=\"%s\", table=\"%s\"} %.6f\n", metric_list[j][0], purge->task_list[i]->name, purge->task_list[i]->table, (double)purge->task_list[i]->usec/1000000.0);
+            break;
+        }
+      }
+    }
+    pthread_mutex_unlock(&purge->lock);
+  }
+  return content;
+}
+
+int glewlwyd_callback_purge_add_task(struct config_plugin * config, const char * name, const char * table, const char * id_column, const char * plugin_column, const char * date_column, unsigned int extra_retention, const char * condition) {
+  return glewlwyd_purge_add_task(config->glewlwyd_config, name, table, id_column, plugin_column, date_column, extra_retention, condition);
+}
+
+void glewlwyd_callback_purge_remove_task(struct config_plugin * config, const char * name) {
+  glewlwyd_purge_remove_task(config->glewlwyd_config, name);
+}
@@ -223,6 +223,7 @@ static json_t * parse_certificate(const char * x509_data, int der_format) {
 }
 
 static int update_user_certificate_enabled_scheme_storage(struct config_module * config, json_t * j_parameters, const char * username, const char * cert_id, int enabled) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query;
   int res, ret;
   
@@ -239,7 +240,7 @@ static int update_user_certificate_enabled_scheme_storage(struct config_module *
                         username,
                         "gsuc_x509_certificate_id",
                         cert_id);
-  res = h_update(config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = G_OK;
@@ -248,17 +249,19 @@ static int update_user_certificate_enabled_scheme_storage(struct config_module *
     config->glewlwyd_module_callback_metrics_increment_counter(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return ret;
 }
 
 static int update_user_certificate_last_used_scheme_storage(struct config_module * config, json_t * j_parameters, const char * username, const char * cert_id, const char * user_agent) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query;
   int res, ret;
   char * last_used_clause;
   
-  if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+  if (conn->type==HOEL_DB_TYPE_MARIADB) {
     last_used_clause = msprintf("FROM_UNIXTIME(%u)", time(NULL));
-  } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+  } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
     last_used_clause = msprintf("TO_TIMESTAMP(%u)", time(NULL));
   } else { // HOEL_DB_TYPE_SQLITE
     last_used_clause = msprintf("%u", time(NULL));
@@ -280,7 +283,7 @@ static int update_user_certificate_last_used_scheme_storage(struct config_module
                         "gsuc_x509_certificate_id",
                         cert_id);
   o_free(last_used_clause);
-  res = h_update(config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = G_OK;
@@ -289,10 +292,12 @@ static int update_user_certificate_last_used_scheme_storage(struct config_module
     config->glewlwyd_module_callback_metrics_increment_counter(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return ret;
 }
 
 static int delete_user_certificate_scheme_storage(struct config_module * config, json_t * j_parameters, const char * username, const char * cert_id) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query;
   int res, ret;
   
@@ -306,7 +311,7 @@ static int delete_user_certificate_scheme_storage(struct config_module * config,
                         username,
                         "gsuc_x509_certificate_id",
                         cert_id);
-  res = h_delete(config->conn, j_query, NULL);
+  res = h_delete(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = G_OK;
@@ -315,6 +320,7 @@ static int delete_user_certificate_scheme_storage(struct config_module * config,
     config->glewlwyd_module_callback_metrics_increment_counter(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return ret;
 }
 
@@ -425,6 +431,7 @@ static json_t * get_user_certificate_list_user_property(struct config_module * c
 }
 
 static json_t * get_user_certificate_from_id_scheme_storage(struct config_module * config, json_t * j_parameters, const char * username, const char * cert_id) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query, * j_result, * j_return;
   int res;
 
@@ -435,10 +442,10 @@ static json_t * get_user_certificate_from_id_scheme_storage(struct config_module
                         "gsuc_x509_certificate_dn AS certificate_dn",
                         "gsuc_x509_certificate_issuer_dn AS certificate_issuer_dn",
                         "gsuc_x509_certificate_id AS certificate_id",
-                        SWITCH_DB_TYPE(config->conn->type, "UNIX_TIMESTAMP(gsuc_activation) AS activation", "strftime('%s', gsuc_activation) AS activation", "EXTRACT(EPOCH FROM gsuc_activation)::integer AS activation"),
-                        SWITCH_DB_TYPE(config->conn->type, "UNIX_TIMESTAMP(gsuc_expiration) AS expiration", "strftime('%s', gsuc_expiration) AS expiration", "EXTRACT(EPOCH FROM gsuc_expiration)::integer AS expiration"),
+                        SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gsuc_activation) AS activation", "strftime('%s', gsuc_activation) AS activation", "EXTRACT(EPOCH FROM gsuc_activation)::integer AS activation"),
+                        SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gsuc_expiration) AS expiration", "strftime('%s', gsuc_expiration) AS expiration", "EXTRACT(EPOCH FROM gsuc_expiration)::integer AS expiration"),
                         "gsuc_enabled",
-                        SWITCH_DB_TYPE(config->conn->type, "UNIX_TIMESTAMP(gsuc_last_used) AS last_used", "strftime('%s', gsuc_last_used) AS last_used", "EXTRACT(EPOCH FROM gsuc_last_used)::integer AS last_used"),
+                        SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gsuc_last_used) AS last_used", "strftime('%s', gsuc_last_used) AS last_used", "EXTRACT(EPOCH FROM gsuc_last_used)::integer AS last_used"),
                         "gsuc_last_user_agent AS last_user_agent",
                       "where",
                         "gsuc_mod_name",
@@ -447,7 +454,7 @@ static json_t * get_user_certificate_from_id_scheme_storage(struct config_module
                         username,
                         "gsuc_x509_certificate_id",
                         cert_id);
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result)) {
@@ -467,10 +474,12 @@ static json_t * get_user_certificate_from_id_scheme_storage(struct config_module
     config->glewlwyd_module_callback_metrics_increment_counter(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return j_return;
 }
 
 static json_t * get_user_certificate_list_scheme_storage(struct config_module * config, json_t * j_parameters, const char * username, int enabled) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query, * j_result, * j_return, * j_element = NULL;
   int res;
   size_t index = 0;
@@ -482,10 +491,10 @@ static json_t * get_user_certificate_list_scheme_storage(struct config_module *
                         "gsuc_x509_certificate_dn AS certificate_dn",
                         "gsuc_x509_certificate_issuer_dn AS certificate_issuer_dn",
                         "gsuc_x509_certificate_id AS certificate_id",
-                        SWITCH_DB_TYPE(config->conn->type, "UNIX_TIMESTAMP(gsuc_activation) AS activation", "strftime('%s', gsuc_activation) AS activation", "EXTRACT(EPOCH FROM gsuc_activation)::integer AS activation"),
-                        SWITCH_DB_TYPE(config->conn->type, "UNIX_TIMESTAMP(gsuc_expiration) AS expiration", "strftime('%s', gsuc_expiration) AS expiration", "EXTRACT(EPOCH FROM gsuc_expiration)::integer AS expiration"),
+                        SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gsuc_activation) AS activation", "strftime('%s', gsuc_activation) AS activation", "EXTRACT(EPOCH FROM gsuc_activation)::integer AS activation"),
+                        SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gsuc_expiration) AS expiration", "strftime('%s', gsuc_expiration) AS expiration", "EXTRACT(EPOCH FROM gsuc_expiration)::integer AS expiration"),
                         "gsuc_enabled",
-                        SWITCH_DB_TYPE(config->conn->type, "UNIX_TIMESTAMP(gsuc_last_used) AS last_used", "strftime('%s', gsuc_last_used) AS last_used", "EXTRACT(EPOCH FROM gsuc_last_used)::integer AS last_used"),
+                        SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gsuc_last_used) AS last_used", "strftime('%s', gsuc_last_used) AS last_used", "EXTRACT(EPOCH FROM gsuc_last_used)::integer AS last_used"),
                         "gsuc_last_user_agent AS last_user_agent",
                       "where",
                         "gsuc_mod_name",
@@ -497,7 +506,7 @@ static json_t * get_user_certificate_list_scheme_storage(struct config_module *
   if (enabled) {
     json_object_set_new(json_object_get(j_query, "where"), "gsuc_enabled", json_integer(1));
   }
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     json_array_foreach(j_result, index, j_element) {
@@ -515,6 +524,7 @@ static json_t * get_user_certificate_list_scheme_storage(struct config_module *
     config->glewlwyd_module_callback_metrics_increment_counter(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return j_return;
 }
 
@@ -533,6 +543,7 @@ static struct _cert_chain_element * get_cert_chain_element_from_dn(struct _cert_
 }
 
 static int add_user_certificate_scheme_storage(struct config_module * config, json_t * j_parameters, const char * x509_data, const char * username, const char * user_agent) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query, * j_parsed_certificate, * j_result;
   char * expiration_clause, * activation_clause;
   int res, ret;
@@ -542,10 +553,10 @@ static int add_user_certificate_scheme_storage(struct config_module * config, js
     if (check_result_value(j_parsed_certificate, G_OK)) {
       j_result = get_user_certificate_from_id_scheme_storage(config, j_parameters, username, json_string_value(json_object_get(json_object_get(j_parsed_certificate, "certificate"), "certificate_id")));
       if (check_result_value(j_result, G_ERROR_NOT_FOUND)) {
-        if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+        if (conn->type==HOEL_DB_TYPE_MARIADB) {
           expiration_clause = msprintf("FROM_UNIXTIME(%"JSON_INTEGER_FORMAT")", json_integer_value(json_object_get(json_object_get(j_parsed_certificate, "certificate"), "expiration")));
           activation_clause = msprintf("FROM_UNIXTIME(%"JSON_INTEGER_FORMAT")", json_integer_value(json_object_get(json_object_get(j_parsed_certificate, "certificate"), "activation")));
-        } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+        } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
           expiration_clause = msprintf("TO_TIMESTAMP(%"JSON_INTEGER_FORMAT")", json_integer_value(json_object_get(json_object_get(j_parsed_certificate, "certificate"), "expiration")));
           activation_clause = msprintf("TO_TIMESTAMP(%"JSON_INTEGER_FORMAT")", json_integer_value(json_object_get(json_object_get(j_parsed_certificate, "certificate"), "activation")));
         } else { // HOEL_DB_TYPE_SQLITE
@@ -581,7 +592,7 @@ static int add_user_certificate_scheme_storage(struct config_module * config, js
         if (!o_strnullempty(user_agent)) {
           json_object_set_new(json_object_get(j_query, "values"), "gsuc_last_user_agent", json_string(user_agent));
         }
-        res = h_insert(config->conn, j_query, NULL);
+        res = h_insert(conn, j_query, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           ret = G_OK;
@@ -611,6 +622,7 @@ static int add_user_certificate_scheme_storage(struct config_module * config, js
     ret = G_ERROR_PARAM;
   }
 
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return ret;
 }
 
@@ -767,6 +779,7 @@ static int is_user_certificate_valid_user_property(struct config_module * config
 }
 
 static int is_user_certificate_valid_scheme_storage(struct config_module * config, json_t * j_parameters, const char * username, gnutls_x509_crt_t cert) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   int ret, res;
   json_t * j_query, * j_result;
   unsigned char key_id_enc[256] = {0};
@@ -788,7 +801,7 @@ static int is_user_certificate_valid_scheme_storage(struct config_module * confi
                           key_id_enc,
                           "gsuc_enabled",
                           1);
-    res = h_select(config->conn, j_query, &j_result, NULL);
+    res = h_select(conn, j_query, &j_result, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       if (json_array_size(j_result)) {
@@ -806,6 +819,7 @@ static int is_user_certificate_valid_scheme_storage(struct config_module * confi
     ret = G_ERROR;
   }
   
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return ret;
 }
 
@@ -827,6 +841,7 @@ static int is_user_certificate_valid(struct config_module * config, json_t * j_p
 }
 
 static json_t * identify_certificate(struct config_module * config, json_t * j_parameters, gnutls_x509_crt_t cert) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   time_t now, exp;
   int res;
   json_t * j_query, * j_result, * j_return;
@@ -851,7 +866,7 @@ static json_t * identify_certificate(struct config_module * config, json_t * j_p
                               key_id_enc,
                               "gsuc_enabled",
                               1);
-        res = h_select(config->conn, j_query, &j_result, NULL);
+        res = h_select(conn, j_query, &j_result, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           if (json_array_size(j_result) == 1) {
@@ -875,6 +890,7 @@ static json_t * identify_certificate(struct config_module * config, json_t * j_p
     y_log_message(Y_LOG_LEVEL_DEBUG, "identify_certificate - Certificate expired");
     j_return = json_pack("{si}", "result", G_ERROR_UNAUTHORIZED);
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return j_return;
 }
 
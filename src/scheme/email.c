@@ -38,6 +38,7 @@
 #define GLEWLWYD_SCHEME_CODE_DURATION 900
 
 static int generate_new_code(struct config_module * config, json_t * j_param, const char * username, char * code, size_t len) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query;
   int res, ret;
   char * code_hash = NULL;
@@ -53,7 +54,7 @@ static int generate_new_code(struct config_module * config, json_t * j_param, co
                         username,
                         "gsc_mod_name",
                         json_object_get(j_param, "mod_name"));
-  res = h_delete(config->conn, j_query, NULL);
+  res = h_delete(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (rand_code(code, len)) {
@@ -68,7 +69,7 @@ static int generate_new_code(struct config_module * config, json_t * j_param, co
                               username,
                               "gsc_code_hash",
                               code_hash);
-        res = h_insert(config->conn, j_query, NULL);
+        res = h_insert(conn, j_query, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           ret = G_OK;
@@ -91,10 +92,12 @@ static int generate_new_code(struct config_module * config, json_t * j_param, co
     config->glewlwyd_module_callback_metrics_increment_counter(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return ret;
 }
 
 static int check_code(struct config_module * config, json_t * j_param, const char * username, const char * code) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query, * j_result;
   int res, ret;
   char * code_hash = NULL, * issued_at_clause = NULL;
@@ -102,9 +105,9 @@ static int check_code(struct config_module * config, json_t * j_param, const cha
 
   if ((code_hash = generate_hash(config->hash_algorithm, code)) != NULL) {
     time(&now);
-    if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
       issued_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now - (time_t)json_integer_value(json_object_get(j_param, "code-duration"))));
-    } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
       issued_at_clause = msprintf("> TO_TIMESTAMP(%u)", (now - (time_t)json_integer_value(json_object_get(j_param, "code-duration"))));
     } else { // HOEL_DB_TYPE_SQLITE
       issued_at_clause = msprintf("> %u", (now - (time_t)json_integer_value(json_object_get(j_param, "code-duration"))));
@@ -126,7 +129,7 @@ static int check_code(struct config_module * config, json_t * j_param, const cha
                             "raw",
                             "value",
                             issued_at_clause);
-    res = h_select(config->conn, j_query, &j_result, NULL);
+    res = h_select(conn, j_query, &j_result, NULL);
     o_free(issued_at_clause);
     json_decref(j_query);
     if (res == H_OK) {
@@ -144,7 +147,7 @@ static int check_code(struct config_module * config, json_t * j_param, const cha
                                username,
                                "gsc_code_hash",
                                code_hash);
-        res = h_update(config->conn, j_query, NULL);
+        res = h_update(conn, j_query, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           ret = G_OK;
@@ -167,6 +170,7 @@ static int check_code(struct config_module * config, json_t * j_param, const cha
     y_log_message(Y_LOG_LEVEL_ERROR, "check_code - Error generate_hash");
     ret = G_ERROR;
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return ret;
 }
 
@@ -206,6 +206,7 @@ static json_t * is_scheme_parameters_valid(json_t * j_params) {
 }
 
 static json_t * complete_session_identify(struct config_module * config, struct _oauth2_config * oauth2_config, json_t * j_provider, const char * redirect_uri, const char * redirect_to, const char * state) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query, * j_result = NULL, * j_result_sub = NULL, * j_return;
   int res, ret;
   time_t now;
@@ -213,9 +214,9 @@ static json_t * complete_session_identify(struct config_module * config, struct
   struct _i_session i_session;
 
   time(&now);
-  if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+  if (conn->type==HOEL_DB_TYPE_MARIADB) {
     expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-  } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+  } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
     expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
   } else { // HOEL_DB_TYPE_SQLITE
     expires_at_clause = msprintf("> %u", (now));
@@ -239,7 +240,7 @@ static json_t * complete_session_identify(struct config_module * config, struct
                         "gsor_id",
                         json_null());
   o_free(expires_at_clause);
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result)) {
@@ -338,7 +339,7 @@ static json_t * complete_session_identify(struct config_module * config, struct
                                     json_object_get(j_provider, "name"),
                                     "gsor_userinfo_sub",
                                     sub);
-              res = h_select(config->conn, j_query, &j_result_sub, NULL);
+              res = h_select(conn, j_query, &j_result_sub, NULL);
               json_decref(j_query);
               if (res == H_OK) {
                 if (json_array_size(j_result_sub) == 1) {
@@ -353,7 +354,7 @@ static json_t * complete_session_identify(struct config_module * config, struct
                                       "where",
                                         "gsos_id",
                                         json_object_get(json_array_get(j_result, 0), "gsos_id"));
-                  res = h_update(config->conn, j_query, NULL);
+                  res = h_update(conn, j_query, NULL);
                   json_decref(j_query);
                   if (res != H_OK) {
                     y_log_message(Y_LOG_LEVEL_ERROR, "complete_session_identify - Error executing j_query (1)");
@@ -373,7 +374,7 @@ static json_t * complete_session_identify(struct config_module * config, struct
                                       "where",
                                         "gsos_id",
                                         json_object_get(json_array_get(j_result, 0), "gsos_id"));
-                  res = h_update(config->conn, j_query, NULL);
+                  res = h_update(conn, j_query, NULL);
                   json_decref(j_query);
                   if (res != H_OK) {
                     y_log_message(Y_LOG_LEVEL_ERROR, "complete_session_identify - Error executing j_query (2)");
@@ -399,7 +400,7 @@ static json_t * complete_session_identify(struct config_module * config, struct
                                   "where",
                                     "gsos_id",
                                     json_object_get(json_array_get(j_result, 0), "gsos_id"));
-              res = h_update(config->conn, j_query, NULL);
+              res = h_update(conn, j_query, NULL);
               json_decref(j_query);
               if (res != H_OK) {
                 y_log_message(Y_LOG_LEVEL_ERROR, "complete_session_identify - Error executing j_query (4)");
@@ -436,10 +437,12 @@ static json_t * complete_session_identify(struct config_module * config, struct
     config->glewlwyd_module_callback_metrics_increment_counter(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return j_return;
 }
 
 static json_t * add_session_identify(struct config_module * config, struct _oauth2_config * oauth2_config, json_t * j_provider, const char * callback_url) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query, * j_state = NULL, * j_return;
   int res;
   time_t now;
@@ -458,9 +461,9 @@ static json_t * add_session_identify(struct config_module * config, struct _oaut
             i_set_str_parameter(&i_session, I_OPT_STATE, state_export_b64);
             if (i_build_auth_url_get(&i_session) == I_OK) {
               time(&now);
-              if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+              if (conn->type==HOEL_DB_TYPE_MARIADB) {
                 expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)json_integer_value(json_object_get(oauth2_config->j_parameters, "session_expiration"))));
-              } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+              } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
                 expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)json_integer_value(json_object_get(oauth2_config->j_parameters, "session_expiration"))));
               } else { // HOEL_DB_TYPE_SQLITE
                 expires_at_clause = msprintf("%u", (now + (time_t)json_integer_value(json_object_get(oauth2_config->j_parameters, "session_expiration"))));
@@ -482,7 +485,7 @@ static json_t * add_session_identify(struct config_module * config, struct _oaut
                                     "gsos_status",
                                     GLEWLWYD_SCHEME_OAUTH2_SESSION_AUTHENTICATION);
               o_free(expires_at_clause);
-              res = h_insert(config->conn, j_query, NULL);
+              res = h_insert(conn, j_query, NULL);
               json_decref(j_query);
               o_free(i_export);
               if (res == H_OK) {
@@ -521,10 +524,12 @@ static json_t * add_session_identify(struct config_module * config, struct _oaut
     j_return = json_pack("{si}", "result", G_ERROR);
   }
 
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return j_return;
 }
 
 static json_t * add_session_for_user(struct config_module * config, struct _oauth2_config * oauth2_config, const char * username, json_t * j_registration, json_t * j_provider, const char * callback_url) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query, * j_state = NULL, * j_return;
   int res;
   time_t now;
@@ -533,9 +538,9 @@ static json_t * add_session_for_user(struct config_module * config, struct _oaut
   struct _o_datum dat = {0, NULL};
 
   time(&now);
-  if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+  if (conn->type==HOEL_DB_TYPE_MARIADB) {
     expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-  } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+  } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
     expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
   } else { // HOEL_DB_TYPE_SQLITE
     expires_at_clause = msprintf("> %u", (now));
@@ -557,7 +562,7 @@ static json_t * add_session_for_user(struct config_module * config, struct _oaut
                           "value",
                           expires_at_clause);
   o_free(expires_at_clause);
-  res = h_update(config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (i_init_session(&i_session) == I_OK) {
@@ -571,9 +576,9 @@ static json_t * add_session_for_user(struct config_module * config, struct _oaut
               i_set_str_parameter(&i_session, I_OPT_STATE, state_export_b64);
               if (i_build_auth_url_get(&i_session) == I_OK) {
                 time(&now);
-                if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+                if (conn->type==HOEL_DB_TYPE_MARIADB) {
                   expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)json_integer_value(json_object_get(oauth2_config->j_parameters, "session_expiration"))));
-                } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+                } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
                   expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)json_integer_value(json_object_get(oauth2_config->j_parameters, "session_expiration"))));
                 } else { // HOEL_DB_TYPE_SQLITE
                   expires_at_clause = msprintf("%u", (now + (time_t)json_integer_value(json_object_get(oauth2_config->j_parameters, "session_expiration"))));
@@ -595,7 +600,7 @@ static json_t * add_session_for_user(struct config_module * config, struct _oaut
                                       "gsos_status",
                                       GLEWLWYD_SCHEME_OAUTH2_SESSION_AUTHENTICATION);
                 o_free(expires_at_clause);
-                res = h_insert(config->conn, j_query, NULL);
+                res = h_insert(conn, j_query, NULL);
                 json_decref(j_query);
                 o_free(i_export);
                 if (res == H_OK) {
@@ -638,10 +643,12 @@ static json_t * add_session_for_user(struct config_module * config, struct _oaut
     config->glewlwyd_module_callback_metrics_increment_counter(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return j_return;
 }
 
 static json_t * get_last_session_for_registration(struct config_module * config, json_int_t gsor_id) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query, * j_result = NULL, * j_return;
   int res;
 
@@ -649,7 +656,7 @@ static json_t * get_last_session_for_registration(struct config_module * config,
                       "table",
                       GLEWLWYD_SCHEME_OAUTH2_SESSION_TABLE,
                       "columns",
-                        SWITCH_DB_TYPE(config->conn->type, "UNIX_TIMESTAMP(gsos_created_at) AS last_session", "strftime('%s', gsos_created_at) AS last_session", "EXTRACT(EPOCH FROM gsos_created_at)::integer AS last_session"),
+                        SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gsos_created_at) AS last_session", "strftime('%s', gsos_created_at) AS last_session", "EXTRACT(EPOCH FROM gsos_created_at)::integer AS last_session"),
                       "where",
                         "gsor_id",
                         gsor_id,
@@ -659,7 +666,7 @@ static json_t * get_last_session_for_registration(struct config_module * config,
                         "gsos_created_at DESC",
                       "limit",
                         1);
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result)) {
@@ -673,10 +680,12 @@ static json_t * get_last_session_for_registration(struct config_module * config,
     config->glewlwyd_module_callback_metrics_increment_counter(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return j_return;
 }
 
 static json_t * get_registration_for_user(struct config_module * config, struct _oauth2_config * oauth2_config, const char * username, const char * provider) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query, * j_result = NULL, * j_return, * j_element = NULL, * j_session;
   int res;
   size_t index = 0;
@@ -687,7 +696,7 @@ static json_t * get_registration_for_user(struct config_module * config, struct
                       "columns",
                         "gsor_id",
                         "gsor_provider AS provider",
-                        SWITCH_DB_TYPE(config->conn->type, "UNIX_TIMESTAMP(gsor_created_at) AS created_at", "strftime('%s', gsor_created_at) AS created_at", "EXTRACT(EPOCH FROM gsor_created_at)::integer AS created_at"),
+                        SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gsor_created_at) AS created_at", "strftime('%s', gsor_created_at) AS created_at", "EXTRACT(EPOCH FROM gsor_created_at)::integer AS created_at"),
                         "gsor_userinfo_sub AS sub",
                       "where",
                         "gsor_mod_name",
@@ -697,7 +706,7 @@ static json_t * get_registration_for_user(struct config_module * config, struct
   if (provider != NULL) {
     json_object_set_new(json_object_get(j_query, "where"), "gsor_provider", json_string(provider));
   }
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result)) {
@@ -727,10 +736,12 @@ static json_t * get_registration_for_user(struct config_module * config, struct
     config->glewlwyd_module_callback_metrics_increment_counter(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return j_return;
 }
 
 static json_t * add_registration_for_user(struct config_module * config, struct _oauth2_config * oauth2_config, const char * username, json_t * j_provider, const char * register_url, const char * complete_url) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query, * j_return, * j_state = NULL, * j_last_id = NULL;
   int res;
   time_t now;
@@ -761,18 +772,18 @@ static json_t * add_registration_for_user(struct config_module * config, struct
                                       username,
                                       "gsor_userinfo_sub",
                                       "");
-                res = h_insert(config->conn, j_query, NULL);
+                res = h_insert(conn, j_query, NULL);
                 json_decref(j_query);
                 if (res == H_OK) {
                   time(&now);
-                  if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+                  if (conn->type==HOEL_DB_TYPE_MARIADB) {
                     expires_at_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)json_integer_value(json_object_get(oauth2_config->j_parameters, "session_expiration"))));
-                  } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+                  } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
                     expires_at_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)json_integer_value(json_object_get(oauth2_config->j_parameters, "session_expiration"))));
                   } else { // HOEL_DB_TYPE_SQLITE
                     expires_at_clause = msprintf("%u", (now + (time_t)json_integer_value(json_object_get(oauth2_config->j_parameters, "session_expiration"))));
                   }
-                  j_last_id = h_last_insert_id(config->conn);
+                  j_last_id = h_last_insert_id(conn);
                   i_export = i_export_session_str(&i_session);
                   j_query = json_pack("{sss{sOs{ss}sssssi}}",
                                       "table",
@@ -790,7 +801,7 @@ static json_t * add_registration_for_user(struct config_module * config, struct
                                         "gsos_status",
                                         GLEWLWYD_SCHEME_OAUTH2_SESSION_REGISTRATION);
                   o_free(expires_at_clause);
-                  res = h_insert(config->conn, j_query, NULL);
+                  res = h_insert(conn, j_query, NULL);
                   json_decref(j_query);
                   json_decref(j_last_id);
                   o_free(i_export);
@@ -839,10 +850,12 @@ static json_t * add_registration_for_user(struct config_module * config, struct
     y_log_message(Y_LOG_LEVEL_ERROR, "add_registration_for_user - Error pthread_mutex_lock");
     j_return = json_pack("{si}", "result", G_ERROR);
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return j_return;
 }
 
 static int delete_registration_for_user(struct config_module * config, struct _oauth2_config * oauth2_config, const char * username, const char * provider) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query;
   int res, ret;
 
@@ -857,7 +870,7 @@ static int delete_registration_for_user(struct config_module * config, struct _o
   if (provider != NULL) {
     json_object_set_new(json_object_get(j_query, "where"), "gsor_provider", json_string(provider));
   }
-  res = h_delete(config->conn, j_query, NULL);
+  res = h_delete(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = G_OK;
@@ -866,10 +879,12 @@ static int delete_registration_for_user(struct config_module * config, struct _o
     config->glewlwyd_module_callback_metrics_increment_counter(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return ret;
 }
 
 static int complete_session_for_user(struct config_module * config, const char * redirect_uri, json_t * j_registration, json_t * j_provider, const char * redirect_to, const char * state, int status) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query, * j_result = NULL;
   int res, ret;
   time_t now;
@@ -877,9 +892,9 @@ static int complete_session_for_user(struct config_module * config, const char *
   struct _i_session i_session;
 
   time(&now);
-  if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+  if (conn->type==HOEL_DB_TYPE_MARIADB) {
     expires_at_clause = msprintf("> FROM_UNIXTIME(%u)", (now));
-  } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+  } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
     expires_at_clause = msprintf("> TO_TIMESTAMP(%u)", now);
   } else { // HOEL_DB_TYPE_SQLITE
     expires_at_clause = msprintf("> %u", (now));
@@ -903,7 +918,7 @@ static int complete_session_for_user(struct config_module * config, const char *
                         "gsor_id",
                         json_object_get(j_registration, "gsor_id"));
   o_free(expires_at_clause);
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result)) {
@@ -999,7 +1014,7 @@ static int complete_session_for_user(struct config_module * config, const char *
                                     "where",
                                       "gsor_id",
                                       json_object_get(j_registration, "gsor_id"));
-                res = h_update(config->conn, j_query, NULL);
+                res = h_update(conn, j_query, NULL);
                 json_decref(j_query);
                 if (res != H_OK) {
                   y_log_message(Y_LOG_LEVEL_ERROR, "complete_session_for_user - Error executing j_query (2)");
@@ -1020,7 +1035,7 @@ static int complete_session_for_user(struct config_module * config, const char *
                                   "where",
                                     "gsos_id",
                                     json_object_get(json_array_get(j_result, 0), "gsos_id"));
-              res = h_update(config->conn, j_query, NULL);
+              res = h_update(conn, j_query, NULL);
               json_decref(j_query);
               if (res != H_OK) {
                 y_log_message(Y_LOG_LEVEL_ERROR, "complete_session_for_user - Error executing j_query (3)");
@@ -1037,7 +1052,7 @@ static int complete_session_for_user(struct config_module * config, const char *
                                   "where",
                                     "gsos_id",
                                     json_object_get(json_array_get(j_result, 0), "gsos_id"));
-              res = h_update(config->conn, j_query, NULL);
+              res = h_update(conn, j_query, NULL);
               json_decref(j_query);
               if (res != H_OK) {
                 y_log_message(Y_LOG_LEVEL_ERROR, "complete_session_for_user - Error executing j_query (3)");
@@ -1071,6 +1086,7 @@ static int complete_session_for_user(struct config_module * config, const char *
     config->glewlwyd_module_callback_metrics_increment_counter(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return ret;
 }
 
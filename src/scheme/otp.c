@@ -40,17 +40,18 @@
 #define G_TOTP_DEFAULT_START_OFFSET 0
 
 static int is_current_otp_available(struct config_module * config, json_t * j_params, const char * username) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   time_t now;
   json_t * j_query, * j_result;
   int res, ret;
   char * username_escaped, * username_clause, * last_used_clause;
 
   time(&now);
-  username_escaped = h_escape_string_with_quotes(config->conn, username);
+  username_escaped = h_escape_string_with_quotes(conn, username);
   username_clause = msprintf(" = UPPER(%s)", username_escaped);
-  if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+  if (conn->type==HOEL_DB_TYPE_MARIADB) {
     last_used_clause = msprintf("< (FROM_UNIXTIME(%u-gso_totp_time_step_size))", now);
-  } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+  } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
     last_used_clause = msprintf("< (TO_TIMESTAMP(%u-gso_totp_time_step_size))", now);
   } else { // HOEL_DB_TYPE_SQLITE
     last_used_clause = msprintf("< (%u-gso_totp_time_step_size)", now);
@@ -76,7 +77,7 @@ static int is_current_otp_available(struct config_module * config, json_t * j_pa
   o_free(last_used_clause);
   o_free(username_clause);
   o_free(username_escaped);
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result)) {
@@ -89,6 +90,7 @@ static int is_current_otp_available(struct config_module * config, json_t * j_pa
     y_log_message(Y_LOG_LEVEL_DEBUG, "is_current_otp_possible - Error executing j_query");
     ret = G_ERROR_PARAM;
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return ret;
 }
 
@@ -139,17 +141,18 @@ static json_t * is_scheme_parameters_valid(json_t * j_params) {
 }
 
 static json_t * get_otp(struct config_module * config, json_t * j_params, const char * username) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query, * j_result, * j_return;
   int res;
   char * username_escaped, * username_clause;
 
-  username_escaped = h_escape_string_with_quotes(config->conn, username);
+  username_escaped = h_escape_string_with_quotes(conn, username);
   username_clause = msprintf(" = UPPER(%s)", username_escaped);
   j_query = json_pack("{sss[sssss]s{s{ssss}sO}}",
                       "table",
                       GLEWLWYD_TABLE_OTP,
                       "columns",
-                        SWITCH_DB_TYPE(config->conn->type, "UNIX_TIMESTAMP(gso_issued_at) AS issued_at", "gso_issued_at AS issued_at", "EXTRACT(EPOCH FROM gso_issued_at)::integer AS issued_at"),
+                        SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gso_issued_at) AS issued_at", "gso_issued_at AS issued_at", "EXTRACT(EPOCH FROM gso_issued_at)::integer AS issued_at"),
                         "gso_otp_type",
                         "gso_secret AS secret",
                         "gso_hotp_moving_factor AS moving_factor",
@@ -164,7 +167,7 @@ static json_t * get_otp(struct config_module * config, json_t * j_params, const
                         json_object_get(j_params, "mod_name"));
   o_free(username_clause);
   o_free(username_escaped);
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result)) {
@@ -187,19 +190,21 @@ static json_t * get_otp(struct config_module * config, json_t * j_params, const
     config->glewlwyd_module_callback_metrics_increment_counter(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return j_return;
 }
 
 static int update_otp(struct config_module * config, json_t * j_params, const char * username, int increment_moving_factor) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   char * username_escaped, * username_clause, * last_login_clause;
   json_t * j_query;
   int ret;
 
-  username_escaped = h_escape_string_with_quotes(config->conn, username);
+  username_escaped = h_escape_string_with_quotes(conn, username);
   username_clause = msprintf(" = UPPER(%s)", username_escaped);
-  if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+  if (conn->type==HOEL_DB_TYPE_MARIADB) {
     last_login_clause = msprintf("FROM_UNIXTIME(%u)", (time(NULL)));
-  } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+  } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
     last_login_clause = msprintf("TO_TIMESTAMP(%u)", (time(NULL)));
   } else { // HOEL_DB_TYPE_SQLITE
     last_login_clause = msprintf("%u", (time(NULL)));
@@ -225,7 +230,7 @@ static int update_otp(struct config_module * config, json_t * j_params, const ch
   if (increment_moving_factor) {
     json_object_set_new(json_object_get(j_query, "set"), "gso_hotp_moving_factor", json_pack("{ss}", "raw", "gso_hotp_moving_factor+1"));
   }
-  if (h_update(config->conn, j_query, NULL) == H_OK) {
+  if (h_update(conn, j_query, NULL) == H_OK) {
     ret = G_OK;
   } else {
     y_log_message(Y_LOG_LEVEL_ERROR, "update_otp - Error executing j_query");
@@ -233,10 +238,12 @@ static int update_otp(struct config_module * config, json_t * j_params, const ch
     ret = G_ERROR_DB;
   }
   json_decref(j_query);
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return ret;
 }
 
 static int set_otp(struct config_module * config, json_t * j_params, const char * username, json_t * j_scheme_data) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query, * j_otp;
   int ret, res, type = (0==o_strcmp(json_string_value(json_object_get(j_scheme_data, "type")), "HOTP")?0:1);
   char * username_escaped, * username_clause;
@@ -244,7 +251,7 @@ static int set_otp(struct config_module * config, json_t * j_params, const char
   if (0 != o_strcmp(json_string_value(json_object_get(j_scheme_data, "type")), "NONE")) {
     j_otp = get_otp(config, j_params, username);
     if (check_result_value(j_otp, G_OK)) {
-      username_escaped = h_escape_string_with_quotes(config->conn, username);
+      username_escaped = h_escape_string_with_quotes(conn, username);
       username_clause = msprintf(" = UPPER(%s)", username_escaped);
       j_query = json_pack("{sss{sisOsOso}s{s{ssss}sO}}",
                           "table",
@@ -268,7 +275,7 @@ static int set_otp(struct config_module * config, json_t * j_params, const char
                             json_object_get(j_params, "mod_name"));
       o_free(username_clause);
       o_free(username_escaped);
-      res = h_update(config->conn, j_query, NULL);
+      res = h_update(conn, j_query, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         ret = G_OK;
@@ -295,8 +302,8 @@ static int set_otp(struct config_module * config, json_t * j_params, const char
                             json_object_get(j_params, "mod_name"),
                             "gso_last_used",
                               "raw",
-                              SWITCH_DB_TYPE(config->conn->type, "FROM_UNIXTIME(1)", "1", "TO_TIMESTAMP(1)")); // Let's hope no one will use Glewlwyd before January 1st, 1970!
-      res = h_insert(config->conn, j_query, NULL);
+                              SWITCH_DB_TYPE(conn->type, "FROM_UNIXTIME(1)", "1", "TO_TIMESTAMP(1)")); // Let's hope no one will use Glewlwyd before January 1st, 1970!
+      res = h_insert(conn, j_query, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         ret = G_OK;
@@ -310,7 +317,7 @@ static int set_otp(struct config_module * config, json_t * j_params, const char
     }
     json_decref(j_otp);
   } else {
-    username_escaped = h_escape_string_with_quotes(config->conn, username);
+    username_escaped = h_escape_string_with_quotes(conn, username);
     username_clause = msprintf(" = UPPER(%s)", username_escaped);
     j_query = json_pack("{sss{s{ssss}sO}}",
                         "table",
@@ -325,7 +332,7 @@ static int set_otp(struct config_module * config, json_t * j_params, const char
                           json_object_get(j_params, "mod_name"));
     o_free(username_clause);
     o_free(username_escaped);
-    res = h_delete(config->conn, j_query, NULL);
+    res = h_delete(conn, j_query, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       ret = G_OK;
@@ -334,6 +341,7 @@ static int set_otp(struct config_module * config, json_t * j_params, const char
       ret = G_ERROR_NOT_FOUND;
     }
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return ret;
 }
 
@@ -256,13 +256,14 @@ static json_t * is_scheme_parameters_valid(json_t * j_params) {
  * If user_id doesn't exist, create one, stores it, and return the new user_id
  */
 static json_t * get_user_id_from_username(struct config_module * config, json_t * j_param, const char * username, int create) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query, * j_result, * j_return;
   int res;
   char * username_escaped, * username_clause;
   unsigned char new_user_id[USER_ID_LENGTH] = {0}, new_user_id_b64[USER_ID_LENGTH*2] = {0};
   size_t new_user_id_b64_len;
 
-  username_escaped = h_escape_string_with_quotes(config->conn, username);
+  username_escaped = h_escape_string_with_quotes(conn, username);
   username_clause = msprintf(" = UPPER(%s)", username_escaped);
   j_query = json_pack("{sss[s]s{s{ssss}sO}}",
                       "table",
@@ -279,7 +280,7 @@ static json_t * get_user_id_from_username(struct config_module * config, json_t
                         json_object_get(j_param, "mod_name"));
   o_free(username_clause);
   o_free(username_escaped);
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result)) {
@@ -298,7 +299,7 @@ static json_t * get_user_id_from_username(struct config_module * config, json_t
                               username,
                               "gswu_user_id",
                               new_user_id_b64);
-        res = h_insert(config->conn, j_query, NULL);
+        res = h_insert(conn, j_query, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           j_return = json_pack("{siss}", "result", G_OK, "user_id", new_user_id_b64);
@@ -320,17 +321,19 @@ static json_t * get_user_id_from_username(struct config_module * config, json_t
     config->glewlwyd_module_callback_metrics_increment_counter(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return j_return;
 }
 
 static json_t * get_credential_list(struct config_module * config, json_t * j_params, const char * username, int restrict_to_registered) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query, * j_result, * j_return, * j_element = NULL;
   int res;
   char * username_escaped, * mod_name_escaped, * username_clause;
   size_t index = 0;
 
-  username_escaped = h_escape_string_with_quotes(config->conn, username);
-  mod_name_escaped = h_escape_string_with_quotes(config->conn, json_string_value(json_object_get(j_params, "mod_name")));
+  username_escaped = h_escape_string_with_quotes(conn, username);
+  mod_name_escaped = h_escape_string_with_quotes(conn, json_string_value(json_object_get(j_params, "mod_name")));
   username_clause = msprintf(" = (SELECT gswu_id FROM "G_TABLE_WEBAUTHN_USER" WHERE UPPER(gswu_username) = UPPER(%s) AND gswu_mod_name = %s)", username_escaped, mod_name_escaped);
   j_query = json_pack("{sss[ssss]s{s{ssss}}}",
                       "table",
@@ -338,7 +341,7 @@ static json_t * get_credential_list(struct config_module * config, json_t * j_pa
                       "columns",
                         "gswc_credential_id AS credential_id",
                         "gswc_name AS name",
-                        SWITCH_DB_TYPE(config->conn->type, "UNIX_TIMESTAMP(gswc_created_at) AS created_at", "strftime('%s', gswc_created_at) AS created_at", "EXTRACT(EPOCH FROM gswc_created_at)::integer AS created_at"),
+                        SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gswc_created_at) AS created_at", "strftime('%s', gswc_created_at) AS created_at", "EXTRACT(EPOCH FROM gswc_created_at)::integer AS created_at"),
                         "gswc_status",
                       "where",
                         "gswu_id",
@@ -354,7 +357,7 @@ static json_t * get_credential_list(struct config_module * config, json_t * j_pa
   } else {
     json_object_set_new(json_object_get(j_query, "where"), "gswc_status", json_pack("{ssss}", "operator", "raw", "value", " IN (1,3)"));
   }
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result)) {
@@ -387,10 +390,12 @@ static json_t * get_credential_list(struct config_module * config, json_t * j_pa
     config->glewlwyd_module_callback_metrics_increment_counter(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return j_return;
 }
 
 static json_t * generate_new_credential(struct config_module * config, json_t * j_params, const char * username) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query, * j_return;
   char * username_escaped, * mod_name_escaped, * username_clause, * challenge_hash;
   int res;
@@ -404,8 +409,8 @@ static json_t * generate_new_credential(struct config_module * config, json_t *
     if ((challenge_hash = generate_hash(config->hash_algorithm, (const char *)challenge_b64)) != NULL) {
       if (rand_string(session, SESSION_LENGTH) != NULL) {
         if ((session_hash = generate_hash(config->hash_algorithm, session)) != NULL) {
-          username_escaped = h_escape_string_with_quotes(config->conn, username);
-          mod_name_escaped = h_escape_string_with_quotes(config->conn, json_string_value(json_object_get(j_params, "mod_name")));
+          username_escaped = h_escape_string_with_quotes(conn, username);
+          mod_name_escaped = h_escape_string_with_quotes(conn, json_string_value(json_object_get(j_params, "mod_name")));
           username_clause = msprintf(" (SELECT gswu_id FROM "G_TABLE_WEBAUTHN_USER" WHERE UPPER(gswu_username) = UPPER(%s) AND gswu_mod_name = %s)", username_escaped, mod_name_escaped);
           // Disable all credential with status 0 (new) of the same user
           j_query = json_pack("{sss{si}s{s{ssss+}si}}",
@@ -423,7 +428,7 @@ static json_t * generate_new_credential(struct config_module * config, json_t *
                                   username_clause,
                                 "gswc_status",
                                 0);
-          res = h_update(config->conn, j_query, NULL);
+          res = h_update(conn, j_query, NULL);
           json_decref(j_query);
           if (res == H_OK) {
             // Insert new credential
@@ -440,7 +445,7 @@ static json_t * generate_new_credential(struct config_module * config, json_t *
                                   challenge_hash,
                                   "gswc_status",
                                   0);
-            res = h_insert(config->conn, j_query, NULL);
+            res = h_insert(conn, j_query, NULL);
             json_decref(j_query);
             if (res == H_OK) {
               j_return = json_pack("{sis{ssss}}", "result", G_OK, "credential", "session", session, "challenge", challenge_b64);
@@ -475,10 +480,12 @@ static json_t * generate_new_credential(struct config_module * config, json_t *
     y_log_message(Y_LOG_LEVEL_ERROR, "generate_new_credential - Error o_base64_encode challenge");
     j_return = json_pack("{si}", "result", G_ERROR);
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return j_return;
 }
 
 static json_t * generate_new_assertion(struct config_module * config, json_t * j_params, const char * username, int mock) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query, * j_return;
   char * username_escaped, * username_clause, * mod_name_escaped, * challenge_hash;
   int res;
@@ -493,8 +500,8 @@ static json_t * generate_new_assertion(struct config_module * config, json_t * j
       if (rand_string(session, SESSION_LENGTH) != NULL) {
         if ((session_hash = generate_hash(config->hash_algorithm, session)) != NULL) {
           if (mock < 2) {
-            username_escaped = h_escape_string_with_quotes(config->conn, username);
-            mod_name_escaped = h_escape_string_with_quotes(config->conn, json_string_value(json_object_get(j_params, "mod_name")));
+            username_escaped = h_escape_string_with_quotes(conn, username);
+            mod_name_escaped = h_escape_string_with_quotes(conn, json_string_value(json_object_get(j_params, "mod_name")));
             username_clause = msprintf(" (SELECT gswu_id FROM "G_TABLE_WEBAUTHN_USER" WHERE UPPER(gswu_username) = UPPER(%s) AND gswu_mod_name = %s)", username_escaped, mod_name_escaped);
             // Disable all assertions with status 0 (new) of the same user
             j_query = json_pack("{sss{si}s{s{ssss+}si}}",
@@ -512,7 +519,7 @@ static json_t * generate_new_assertion(struct config_module * config, json_t * j
                                     username_clause,
                                   "gswa_status",
                                   0);
-            res = h_update(config->conn, j_query, NULL);
+            res = h_update(conn, j_query, NULL);
             json_decref(j_query);
             if (res == H_OK) {
               // Insert new assertion
@@ -531,7 +538,7 @@ static json_t * generate_new_assertion(struct config_module * config, json_t * j
                                     0,
                                     "gswa_mock",
                                     mock);
-              res = h_insert(config->conn, j_query, NULL);
+              res = h_insert(conn, j_query, NULL);
               json_decref(j_query);
               if (res == H_OK) {
                 j_return = json_pack("{sis{ssss}}", "result", G_OK, "assertion", "session", session, "challenge", challenge_b64);
@@ -569,10 +576,12 @@ static json_t * generate_new_assertion(struct config_module * config, json_t * j
     y_log_message(Y_LOG_LEVEL_ERROR, "generate_new_assertion - Error o_base64_encode challenge");
     j_return = json_pack("{si}", "result", G_ERROR);
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return j_return;
 }
 
 static json_t * get_credential_from_session(struct config_module * config, json_t * j_params, const char * username, const char * session) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query, * j_result, * j_return;
   char * username_escaped, * mod_name_escaped, * username_clause, * expiration_clause;
   char * session_hash;
@@ -582,12 +591,12 @@ static json_t * get_credential_from_session(struct config_module * config, json_
   if (!o_strnullempty(session)) {
     if ((session_hash = generate_hash(config->hash_algorithm, session)) != NULL) {
       time(&now);
-      username_escaped = h_escape_string_with_quotes(config->conn, username);
-      mod_name_escaped = h_escape_string_with_quotes(config->conn, json_string_value(json_object_get(j_params, "mod_name")));
+      username_escaped = h_escape_string_with_quotes(conn, username);
+      mod_name_escaped = h_escape_string_with_quotes(conn, json_string_value(json_object_get(j_params, "mod_name")));
       username_clause = msprintf(" = (SELECT gswu_id FROM "G_TABLE_WEBAUTHN_USER" WHERE UPPER(gswu_username) = UPPER(%s) AND gswu_mod_name = %s)", username_escaped, mod_name_escaped);
-      if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+      if (conn->type==HOEL_DB_TYPE_MARIADB) {
         expiration_clause = msprintf("> FROM_UNIXTIME(%u)", (now - (time_t)json_integer_value(json_object_get(j_params, "credential-expiration"))));
-      } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+      } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
         expiration_clause = msprintf("> TO_TIMESTAMP(%u)", (now - (time_t)json_integer_value(json_object_get(j_params, "credential-expiration"))));
       } else { // HOEL_DB_TYPE_SQLITE
         expiration_clause = msprintf("> %u", (now - (time_t)json_integer_value(json_object_get(j_params, "credential-expiration"))));
@@ -621,7 +630,7 @@ static json_t * get_credential_from_session(struct config_module * config, json_
       o_free(username_escaped);
       o_free(mod_name_escaped);
       o_free(expiration_clause);
-      res = h_select(config->conn, j_query, &j_result, NULL);
+      res = h_select(conn, j_query, &j_result, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         if (json_array_size(j_result)) {
@@ -643,16 +652,18 @@ static json_t * get_credential_from_session(struct config_module * config, json_
   } else {
     j_return = json_pack("{si}", "result", G_ERROR_PARAM);
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return j_return;
 }
 
 static json_t * get_credential(struct config_module * config, json_t * j_params, const char * username, const char * credential_id) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query, * j_result, * j_return;
   char * username_escaped, * mod_name_escaped, * username_clause;
   int res;
 
-  username_escaped = h_escape_string_with_quotes(config->conn, username);
-  mod_name_escaped = h_escape_string_with_quotes(config->conn, json_string_value(json_object_get(j_params, "mod_name")));
+  username_escaped = h_escape_string_with_quotes(conn, username);
+  mod_name_escaped = h_escape_string_with_quotes(conn, json_string_value(json_object_get(j_params, "mod_name")));
   username_clause = msprintf(" = (SELECT gswu_id FROM "G_TABLE_WEBAUTHN_USER" WHERE UPPER(gswu_username) = UPPER(%s) AND gswu_mod_name = %s)", username_escaped, mod_name_escaped);
   j_query = json_pack("{sss[sss]s{sss{ssss}s{ssss}}}",
                       "table",
@@ -677,7 +688,7 @@ static json_t * get_credential(struct config_module * config, json_t * j_params,
   o_free(username_clause);
   o_free(username_escaped);
   o_free(mod_name_escaped);
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result)) {
@@ -691,16 +702,18 @@ static json_t * get_credential(struct config_module * config, json_t * j_params,
     config->glewlwyd_module_callback_metrics_increment_counter(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return j_return;
 }
 
 static int update_credential(struct config_module * config, json_t * j_params, const char * username, const char * credential_id, int status) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query;
   char * username_escaped, * mod_name_escaped, * username_clause;
   int res, ret;
 
-  username_escaped = h_escape_string_with_quotes(config->conn, username);
-  mod_name_escaped = h_escape_string_with_quotes(config->conn, json_string_value(json_object_get(j_params, "mod_name")));
+  username_escaped = h_escape_string_with_quotes(conn, username);
+  mod_name_escaped = h_escape_string_with_quotes(conn, json_string_value(json_object_get(j_params, "mod_name")));
   username_clause = msprintf(" = (SELECT gswu_id FROM "G_TABLE_WEBAUTHN_USER" WHERE UPPER(gswu_username) = UPPER(%s) AND gswu_mod_name = %s)", username_escaped, mod_name_escaped);
   j_query = json_pack("{sss{si}s{sss{ssss}}}",
                       "table",
@@ -719,7 +732,7 @@ static int update_credential(struct config_module * config, json_t * j_params, c
   o_free(username_clause);
   o_free(username_escaped);
   o_free(mod_name_escaped);
-  res = h_update(config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = G_OK;
@@ -728,16 +741,18 @@ static int update_credential(struct config_module * config, json_t * j_params, c
     config->glewlwyd_module_callback_metrics_increment_counter(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return ret;
 }
 
 static int update_credential_name(struct config_module * config, json_t * j_params, const char * username, const char * credential_id, const char * name) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query;
   char * username_escaped, * mod_name_escaped, * username_clause;
   int res, ret;
 
-  username_escaped = h_escape_string_with_quotes(config->conn, username);
-  mod_name_escaped = h_escape_string_with_quotes(config->conn, json_string_value(json_object_get(j_params, "mod_name")));
+  username_escaped = h_escape_string_with_quotes(conn, username);
+  mod_name_escaped = h_escape_string_with_quotes(conn, json_string_value(json_object_get(j_params, "mod_name")));
   username_clause = msprintf(" = (SELECT gswu_id FROM "G_TABLE_WEBAUTHN_USER" WHERE UPPER(gswu_username) = UPPER(%s) AND gswu_mod_name = %s)", username_escaped, mod_name_escaped);
   j_query = json_pack("{sss{ss}s{sss{ssss}}}",
                       "table",
@@ -756,7 +771,7 @@ static int update_credential_name(struct config_module * config, json_t * j_para
   o_free(username_clause);
   o_free(username_escaped);
   o_free(mod_name_escaped);
-  res = h_update(config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = G_OK;
@@ -765,10 +780,12 @@ static int update_credential_name(struct config_module * config, json_t * j_para
     config->glewlwyd_module_callback_metrics_increment_counter(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return ret;
 }
 
 static json_t * get_assertion_from_session(struct config_module * config, json_t * j_params, const char * username, const char * session, int mock) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query, * j_result, * j_return;
   char * username_escaped, * mod_name_escaped, * username_clause, * expiration_clause;
   char * session_hash;
@@ -778,12 +795,12 @@ static json_t * get_assertion_from_session(struct config_module * config, json_t
   if (!o_strnullempty(session)) {
     if ((session_hash = generate_hash(config->hash_algorithm, session)) != NULL) {
       time(&now);
-      username_escaped = h_escape_string_with_quotes(config->conn, username);
-      mod_name_escaped = h_escape_string_with_quotes(config->conn, json_string_value(json_object_get(j_params, "mod_name")));
+      username_escaped = h_escape_string_with_quotes(conn, username);
+      mod_name_escaped = h_escape_string_with_quotes(conn, json_string_value(json_object_get(j_params, "mod_name")));
       username_clause = msprintf(" = (SELECT gswu_id FROM "G_TABLE_WEBAUTHN_USER" WHERE UPPER(gswu_username) = UPPER(%s) AND gswu_mod_name = %s)", username_escaped, mod_name_escaped);
-      if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+      if (conn->type==HOEL_DB_TYPE_MARIADB) {
         expiration_clause = msprintf("> FROM_UNIXTIME(%u)", (now - (time_t)json_integer_value(json_object_get(j_params, "credential-assertion"))));
-      } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+      } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
         expiration_clause = msprintf("> TO_TIMESTAMP(%u)", (now - (time_t)json_integer_value(json_object_get(j_params, "credential-assertion"))));
       } else { // HOEL_DB_TYPE_SQLITE
         expiration_clause = msprintf("> %u", (now - (time_t)json_integer_value(json_object_get(j_params, "credential-assertion"))));
@@ -817,7 +834,7 @@ static json_t * get_assertion_from_session(struct config_module * config, json_t
       o_free(username_escaped);
       o_free(mod_name_escaped);
       o_free(expiration_clause);
-      res = h_select(config->conn, j_query, &j_result, NULL);
+      res = h_select(conn, j_query, &j_result, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         if (json_array_size(j_result)) {
@@ -839,16 +856,18 @@ static json_t * get_assertion_from_session(struct config_module * config, json_t
   } else {
     j_return = json_pack("{si}", "result", G_ERROR_PARAM);
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return j_return;
 }
 
 static int check_certificate(struct config_module * config, json_t * j_params, const char * credential_id, json_int_t gswu_id) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_query, * j_result;
   int res, ret;
   char * credential_id_escaped, * mod_name_escaped, * where_clause;
 
-  credential_id_escaped = h_escape_string_with_quotes(config->conn, credential_id);
-  mod_name_escaped = h_escape_string_with_quotes(config->conn, json_string_value(json_object_get(j_params, "mod_name")));
+  credential_id_escaped = h_escape_string_with_quotes(conn, credential_id);
+  mod_name_escaped = h_escape_string_with_quotes(conn, json_string_value(json_object_get(j_params, "mod_name")));
   where_clause = msprintf(" IN (SELECT gswu_id FROM " G_TABLE_WEBAUTHN_CREDENTIAL " WHERE gswc_credential_id=%s AND gswc_status=1 AND gswu_id IN (SELECT gswu_id FROM " G_TABLE_WEBAUTHN_USER " WHERE gswu_mod_name=%s))", credential_id_escaped, mod_name_escaped);
   j_query = json_pack("{sss[s]s{s{ssss}si}}",
                       "table",
@@ -866,7 +885,7 @@ static int check_certificate(struct config_module * config, json_t * j_params, c
   o_free(where_clause);
   o_free(mod_name_escaped);
   o_free(credential_id_escaped);
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result)) {
@@ -884,6 +903,7 @@ static int check_certificate(struct config_module * config, json_t * j_params, c
     config->glewlwyd_module_callback_metrics_increment_counter(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return ret;
 }
 
@@ -1982,6 +2002,7 @@ static json_t * check_attestation_fido_u2f(json_t * j_params, unsigned char * cr
  *
  */
 static json_t * register_new_attestation(struct config_module * config, json_t * j_params, json_t * j_scheme_data, json_t * j_credential) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   json_t * j_return, * j_client_data = NULL, * j_error, * j_result, * j_pubkey = NULL, * j_cert = NULL, * j_query, * j_element = NULL;
   unsigned char * client_data = NULL, * challenge_b64 = NULL, * att_obj = NULL, * cbor_bs_handle = NULL, rpid_hash[32], * fmt = NULL, * credential_id_b64 = NULL, * cbor_auth_data, * cred_pub_key, cert_x[256], cert_y[256], pubkey_export[1024];
   char * challenge_hash = NULL, * message = NULL;
@@ -2437,7 +2458,7 @@ static json_t * register_new_attestation(struct config_module * config, json_t *
                             "where",
                               "gswc_id",
                               json_object_get(j_credential, "gswc_id"));
-        res = h_update(config->conn, j_query, NULL);
+        res = h_update(conn, j_query, NULL);
         json_decref(j_query);
         if (res != H_OK) {
           y_log_message(Y_LOG_LEVEL_ERROR, "register_new_attestation - Error h_update");
@@ -2466,6 +2487,7 @@ static json_t * register_new_attestation(struct config_module * config, json_t *
   } else {
     j_return = json_pack("{sis[s]}", "result", G_ERROR_PARAM, "error", "scheme_data mandatory");
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return j_return;
 }
 
@@ -2473,6 +2495,7 @@ static json_t * register_new_attestation(struct config_module * config, json_t *
  *
  */
 static int check_assertion(struct config_module * config, json_t * j_params, const char * username, json_t * j_scheme_data, json_t * j_assertion) {
+  struct _h_connection * conn = config->glewlwyd_module_callback_db_checkout(config);
   int ret, res;
   unsigned char * client_data = NULL, * challenge_b64 = NULL, * auth_data = NULL, rpid_hash[32] = {0}, * flags, cdata_hash[32] = {0},
                   data_signed[128] = {0}, * counter;
@@ -2698,7 +2721,7 @@ static int check_assertion(struct config_module * config, json_t * j_params, con
                           "where",
                             "gswa_id",
                             json_object_get(j_assertion, "gswa_id"));
-      res = h_update(config->conn, j_query, NULL);
+      res = h_update(conn, j_query, NULL);
       json_decref(j_query);
       if (res != H_OK) {
         y_log_message(Y_LOG_LEVEL_ERROR, "check_assertion - Error executing j_query (1)");
@@ -2716,7 +2739,7 @@ static int check_assertion(struct config_module * config, json_t * j_params, con
                               "where",
                                 "gswc_id",
                                 json_object_get(json_object_get(j_credential, "credential"), "gswc_id"));
-          res = h_update(config->conn, j_query, NULL);
+          res = h_update(conn, j_query, NULL);
           json_decref(j_query);
           if (res != H_OK) {
             y_log_message(Y_LOG_LEVEL_ERROR, "check_assertion - Error executing j_query (2)");
@@ -2737,7 +2760,7 @@ static int check_assertion(struct config_module * config, json_t * j_params, con
                           "where",
                             "gswa_id",
                             json_object_get(j_assertion, "gswa_id"));
-      res = h_update(config->conn, j_query, NULL);
+      res = h_update(conn, j_query, NULL);
       json_decref(j_query);
       if (res != H_OK) {
         y_log_message(Y_LOG_LEVEL_ERROR, "check_assertion - Error executing j_query (3)");
@@ -2756,7 +2779,7 @@ static int check_assertion(struct config_module * config, json_t * j_params, con
                           "where",
                             "gswa_id",
                             json_object_get(j_assertion, "gswa_id"));
-      res = h_update(config->conn, j_query, NULL);
+      res = h_update(conn, j_query, NULL);
       json_decref(j_query);
       if (res != H_OK) {
         y_log_message(Y_LOG_LEVEL_ERROR, "check_assertion - Error executing j_query (4)");
@@ -2774,6 +2797,7 @@ static int check_assertion(struct config_module * config, json_t * j_params, con
   } else {
     ret = G_ERROR_PARAM;
   }
+  config->glewlwyd_module_callback_db_checkin(config, conn);
   return ret;
 }
 
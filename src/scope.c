@@ -27,13 +27,14 @@
 #include "glewlwyd.h"
 
 static json_t * get_current_session(struct config_elements * config, const char * session_hash) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query, * j_result = NULL, * j_return;
   int res;
   char * expire_clause;
 
-  if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+  if (conn->type==HOEL_DB_TYPE_MARIADB) {
     expire_clause = o_strdup("> NOW()");
-  } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+  } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
     expire_clause = o_strdup("> NOW()");
   } else { // HOEL_DB_TYPE_SQLITE
     expire_clause = o_strdup("> (strftime('%s','now'))");
@@ -61,7 +62,7 @@ static json_t * get_current_session(struct config_elements * config, const char
                       "limit",
                       1);
   o_free(expire_clause);
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result) > 0) {
@@ -75,15 +76,16 @@ static json_t * get_current_session(struct config_elements * config, const char
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
   json_decref(j_result);
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
 static json_t * get_current_user_from_session(struct config_elements * config, const char * session_uid) {
-  char * session_hash;
+  char session_hash[GLEWLWYD_HASH_BUFFER_SIZE];
   json_t * j_session, * j_return, * j_user;
 
   if (!o_strnullempty(session_uid)) {
-    if ((session_hash = generate_hash(config->hash_algorithm, session_uid)) != NULL) {
+    if (generate_hash_buffer(config->hash_algorithm, session_uid, 0, session_hash, sizeof(session_hash)) == G_OK) {
       j_session = get_current_session(config, session_hash);
       if (check_result_value(j_session, G_OK)) {
         j_user = get_user(config, json_string_value(json_object_get(json_object_get(j_session, "session"), "username")), NULL);
@@ -104,17 +106,134 @@ static json_t * get_current_user_from_session(struct config_elements * config, c
       }
       json_decref(j_session);
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "get_current_user_from_session - Error generate_hash");
+      y_log_message(Y_LOG_LEVEL_ERROR, "get_current_user_from_session - Error generate_hash_buffer");
       j_return = json_pack("{si}", "result", G_ERROR);
     }
-    o_free(session_hash);
   } else {
     j_return = json_pack("{si}", "result", G_ERROR_NOT_FOUND);
   }
   return j_return;
 }
 
+/**
+ * Returns a new reference to the current scope graph, or NULL if it's not loaded
+ */
+static json_t * get_scope_graph(struct config_elements * config) {
+  json_t * j_graph = NULL;
+
+  if (!pthread_mutex_lock(&config->scope_graph_lock)) {
+    j_graph = json_incref(config->j_scope_graph);
+    pthread_mutex_unlock(&config->scope_graph_lock);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "get_scope_graph - Error pthread_mutex_lock");
+  }
+  return j_graph;
+}
+
+/**
+ * Rebuilds the in-memory scope graph: every scope with its properties,
+ * its scheme groups and the number of schemes required per group
+ * The graph is immutable, it's replaced by a new one on every update
+ */
+int update_scope_graph(struct config_elements * config) {
+  struct _h_connection * conn;
+  const char * str_query =
+    "SELECT \
+    " GLEWLWYD_TABLE_SCOPE ".gs_name AS scope_name, \
+    gsg_name AS group_name, \
+    gsg_scheme_required AS scheme_required, \
+    guasmi_module AS scheme_type, \
+    guasmi_name AS scheme_name, \
+    guasmi_display_name AS scheme_display_name \
+    FROM \
+    " GLEWLWYD_TABLE_SCOPE ", \
+    " GLEWLWYD_TABLE_SCOPE_GROUP ", \
+    " GLEWLWYD_TABLE_USER_AUTH_SCHEME_MODULE_INSTANCE ", \
+    " GLEWLWYD_TABLE_SCOPE_GROUP_AUTH_SCHEME_MODULE_INSTANCE " \
+    WHERE \
+    " GLEWLWYD_TABLE_SCOPE_GROUP_AUTH_SCHEME_MODULE_INSTANCE ".guasmi_id = " GLEWLWYD_TABLE_USER_AUTH_SCHEME_MODULE_INSTANCE ".guasmi_id AND \
+    " GLEWLWYD_TABLE_SCOPE_GROUP ".gsg_id = " GLEWLWYD_TABLE_SCOPE_GROUP_AUTH_SCHEME_MODULE_INSTANCE ".gsg_id AND \
+    " GLEWLWYD_TABLE_SCOPE_GROUP ".gs_id = " GLEWLWYD_TABLE_SCOPE ".gs_id \
+    ORDER BY \
+    " GLEWLWYD_TABLE_SCOPE_GROUP ".gsg_id, \
+    " GLEWLWYD_TABLE_USER_AUTH_SCHEME_MODULE_INSTANCE ".guasmi_name;";
+  json_t * j_query, * j_result = NULL, * j_graph = NULL, * j_element, * j_scope, * j_old;
+  const char * group_name;
+  int res, ret;
+  size_t index;
+
+  if (!pthread_mutex_lock(&config->scope_graph_update_lock)) {
+    conn = glewlwyd_db_pool_checkout(config);
+    j_query = json_pack("{sss[sssss]}",
+                        "table",
+                        GLEWLWYD_TABLE_SCOPE,
+                        "columns",
+                          "gs_name AS name",
+                          "gs_display_name AS display_name",
+                          "gs_description AS description",
+                          "gs_password_required",
+                          "gs_password_max_age AS password_max_age");
+    res = h_select(conn, j_query, &j_result, NULL);
+    json_decref(j_query);
+    if (res == H_OK) {
+      j_graph = json_object();
+      json_array_foreach(j_result, index, j_element) {
+        json_object_set(j_element, "password_required", json_integer_value(json_object_get(j_element, "gs_password_required"))?json_true():json_false());
+        json_object_del(j_element, "gs_password_required");
+        json_object_set_new(j_element, "scheme", json_object());
+        json_object_set(j_graph, json_string_value(json_object_get(j_element, "name")), j_element);
+      }
+      json_decref(j_result);
+      j_result = NULL;
+      res = h_execute_query_json(conn, str_query, &j_result);
+      if (res == H_OK) {
+        json_array_foreach(j_result, index, j_element) {
+          if ((j_scope = json_object_get(j_graph, json_string_value(json_object_get(j_element, "scope_name")))) != NULL) {
+            group_name = json_string_value(json_object_get(j_element, "group_name"));
+            if (json_object_get(json_object_get(j_scope, "scheme"), group_name) == NULL) {
+              json_object_set_new(json_object_get(j_scope, "scheme"), group_name, json_array());
+              if (json_object_get(j_scope, "scheme_required") == NULL) {
+                json_object_set_new(j_scope, "scheme_required", json_object());
+              }
+              json_object_set(json_object_get(j_scope, "scheme_required"), group_name, json_object_get(j_element, "scheme_required"));
+            }
+            json_array_append_new(json_object_get(json_object_get(j_scope, "scheme"), group_name), json_pack("{ssssss?}", "scheme_type", json_string_value(json_object_get(j_element, "scheme_type")), "scheme_name", json_string_value(json_object_get(j_element, "scheme_name")), "scheme_display_name", json_string_value(json_object_get(j_element, "scheme_display_name"))));
+          }
+        }
+        if (!pthread_mutex_lock(&config->scope_graph_lock)) {
+          j_old = config->j_scope_graph;
+          config->j_scope_graph = j_graph;
+          j_graph = NULL;
+          pthread_mutex_unlock(&config->scope_graph_lock);
+          json_decref(j_old);
+          ret = G_OK;
+        } else {
+          y_log_message(Y_LOG_LEVEL_ERROR, "update_scope_graph - Error pthread_mutex_lock (2)");
+          ret = G_ERROR;
+        }
+      } else {
+        y_log_message(Y_LOG_LEVEL_ERROR, "update_scope_graph - Error executing str_query");
+        glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+        ret = G_ERROR_DB;
+      }
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "update_scope_graph - Error executing j_query");
+      glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+      ret = G_ERROR_DB;
+    }
+    json_decref(j_result);
+    json_decref(j_graph);
+    glewlwyd_db_pool_checkin(config, conn);
+    pthread_mutex_unlock(&config->scope_graph_update_lock);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "update_scope_graph - Error pthread_mutex_lock (1)");
+    ret = G_ERROR;
+  }
+  return ret;
+}
+
 json_t * get_scope_list(struct config_elements * config, const char * pattern, size_t offset, size_t limit) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query, * j_result, * j_return, * j_element, * j_scheme;
   int res;
   size_t index;
@@ -137,13 +256,13 @@ json_t * get_scope_list(struct config_elements * config, const char * pattern, s
     json_object_set_new(j_query, "limit", json_integer((json_int_t)limit));
   }
   if (!o_strnullempty(pattern)) {
-    pattern_escaped = h_escape_string_with_quotes(config->conn, pattern);
+    pattern_escaped = h_escape_string_with_quotes(conn, pattern);
     pattern_clause = msprintf("IN (SELECT gs_id FROM " GLEWLWYD_TABLE_SCOPE " WHERE gs_name LIKE '%%'||%s||'%%' OR gs_display_name LIKE '%%'||%s||'%%' OR gs_description LIKE '%%'||%s||'%%')", pattern_escaped, pattern_escaped, pattern_escaped);
     json_object_set_new(j_query, "where", json_pack("{s{ssss}}", "gs_id", "operator", "raw", "value", pattern_clause));
     o_free(pattern_escaped);
     o_free(pattern_clause);
   }
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     json_array_foreach(j_result, index, j_element) {
@@ -166,10 +285,12 @@ json_t * get_scope_list(struct config_elements * config, const char * pattern, s
     glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
-json_t * get_scope(struct config_elements * config, const char * scope) {
+static json_t * get_scope_db(struct config_elements * config, const char * scope) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query, * j_result = NULL, * j_return, * j_scheme;
   int res;
 
@@ -185,7 +306,7 @@ json_t * get_scope(struct config_elements * config, const char * scope) {
                       "where",
                         "gs_name",
                         scope);
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result)) {
@@ -200,7 +321,7 @@ json_t * get_scope(struct config_elements * config, const char * scope) {
         json_object_set_new(json_array_get(j_result, 0), "scheme", json_object());
         j_return = json_pack("{sisO}", "result", G_OK, "scope", json_array_get(j_result, 0));
       } else {
-        y_log_message(Y_LOG_LEVEL_ERROR, "get_scope - Error get_auth_scheme_list_from_scope");
+        y_log_message(Y_LOG_LEVEL_ERROR, "get_scope_db - Error get_auth_scheme_list_from_scope");
         j_return = json_pack("{si}", "result", G_ERROR);
       }
       json_decref(j_scheme);
@@ -208,15 +329,17 @@ json_t * get_scope(struct config_elements * config, const char * scope) {
       j_return = json_pack("{si}", "result", G_ERROR_NOT_FOUND);
     }
   } else {
-    y_log_message(Y_LOG_LEVEL_ERROR, "get_scope - Error executing j_query");
+    y_log_message(Y_LOG_LEVEL_ERROR, "get_scope_db - Error executing j_query");
     glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
   json_decref(j_result);
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
-json_t * get_auth_scheme_list_from_scope(struct config_elements * config, const char * scope) {
+static json_t * get_auth_scheme_list_from_scope_db(struct config_elements * config, const char * scope) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   const char * str_query_pattern = 
     "SELECT \
     gsg_name AS group_name, \
@@ -237,7 +360,7 @@ json_t * get_auth_scheme_list_from_scope(struct config_elements * config, const
     ORDER BY \
     " GLEWLWYD_TABLE_SCOPE_GROUP ".gsg_id, \
     " GLEWLWYD_TABLE_USER_AUTH_SCHEME_MODULE_INSTANCE ".guasmi_name;";
-  char * scope_escape = h_escape_string_with_quotes(config->conn, scope), * str_query = NULL;
+  char * scope_escape = h_escape_string_with_quotes(conn, scope), * str_query = NULL;
   json_t * j_return, * j_result = NULL, * j_element;
   int res;
   size_t index;
@@ -245,7 +368,7 @@ json_t * get_auth_scheme_list_from_scope(struct config_elements * config, const
   if (scope_escape != NULL) {
     str_query = msprintf(str_query_pattern, scope_escape);
     if (str_query != NULL) {
-      res = h_execute_query_json(config->conn, str_query, &j_result);
+      res = h_execute_query_json(conn, str_query, &j_result);
       if (res == H_OK) {
         if (json_array_size(j_result)) {
           j_return = json_pack("{sis{}s{}}", "result", G_OK, "scheme", "scheme_required");
@@ -260,28 +383,63 @@ json_t * get_auth_scheme_list_from_scope(struct config_elements * config, const
               }
             }
           } else {
-            y_log_message(Y_LOG_LEVEL_ERROR, "get_auth_scheme_list_from_scope - Error allocating resources for j_return");
+            y_log_message(Y_LOG_LEVEL_ERROR, "get_auth_scheme_list_from_scope_db - Error allocating resources for j_return");
             j_return = json_pack("{si}", "result", G_ERROR_MEMORY);
           }
         } else {
           j_return = json_pack("{si}", "result", G_ERROR_NOT_FOUND);
         }
       } else {
-        y_log_message(Y_LOG_LEVEL_ERROR, "get_auth_scheme_list_from_scope - Error executing str_query");
+        y_log_message(Y_LOG_LEVEL_ERROR, "get_auth_scheme_list_from_scope_db - Error executing str_query");
         glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
         j_return = json_pack("{si}", "result", G_ERROR_DB);
       }
       json_decref(j_result);
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "get_auth_scheme_list_from_scope - Error allocating resources for str_query");
+      y_log_message(Y_LOG_LEVEL_ERROR, "get_auth_scheme_list_from_scope_db - Error allocating resources for str_query");
       j_return = json_pack("{si}", "result", G_ERROR);
     }
     o_free(str_query);
   } else {
-    y_log_message(Y_LOG_LEVEL_ERROR, "get_auth_scheme_list_from_scope - Error h_escape_string");
+    y_log_message(Y_LOG_LEVEL_ERROR, "get_auth_scheme_list_from_scope_db - Error h_escape_string");
     j_return = json_pack("{si}", "result", G_ERROR);
   }
   o_free(scope_escape);
+  glewlwyd_db_pool_checkin(config, conn);
+  return j_return;
+}
+
+json_t * get_scope(struct config_elements * config, const char * scope) {
+  json_t * j_graph = get_scope_graph(config), * j_scope, * j_return;
+
+  if (j_graph != NULL && !o_strnullempty(scope) && (j_scope = json_object_get(j_graph, scope)) != NULL) {
+    j_return = json_pack("{siso}", "result", G_OK, "scope", json_deep_copy(j_scope));
+  } else if (j_graph != NULL && (o_strnullempty(scope) || config->conn->type != HOEL_DB_TYPE_MARIADB)) {
+    j_return = json_pack("{si}", "result", G_ERROR_NOT_FOUND);
+  } else {
+    // MariaDB compares scope names case-insensitively, a cache miss may still match in the database
+    j_return = get_scope_db(config, scope);
+  }
+  json_decref(j_graph);
+  return j_return;
+}
+
+json_t * get_auth_scheme_list_from_scope(struct config_elements * config, const char * scope) {
+  json_t * j_graph = get_scope_graph(config), * j_scope, * j_return;
+
+  if (j_graph != NULL && !o_strnullempty(scope) && (j_scope = json_object_get(j_graph, scope)) != NULL) {
+    if (json_object_size(json_object_get(j_scope, "scheme"))) {
+      j_return = json_pack("{sisoso}", "result", G_OK, "scheme", json_deep_copy(json_object_get(j_scope, "scheme")), "scheme_required", json_deep_copy(json_object_get(j_scope, "scheme_required")));
+    } else {
+      j_return = json_pack("{si}", "result", G_ERROR_NOT_FOUND);
+    }
+  } else if (j_graph != NULL && (o_strnullempty(scope) || config->conn->type != HOEL_DB_TYPE_MARIADB)) {
+    j_return = json_pack("{si}", "result", G_ERROR_NOT_FOUND);
+  } else {
+    // MariaDB compares scope names case-insensitively, a cache miss may still match in the database
+    j_return = get_auth_scheme_list_from_scope_db(config, scope);
+  }
+  json_decref(j_graph);
   return j_return;
 }
 
@@ -297,13 +455,12 @@ json_t * get_auth_scheme_list_from_scope_list(struct config_elements * config, c
         if (json_object_get(json_object_get(j_result, "scheme"), scope_array[i]) == NULL) {
           j_scope = get_scope(config, scope_array[i]);
           if (check_result_value(j_scope, G_OK)) {
-            j_scheme_list = get_auth_scheme_list_from_scope(config, scope_array[i]);
-            if (check_result_value(j_scheme_list, G_OK)) {
-              json_object_set_new(json_object_get(j_result, "scheme"), scope_array[i], json_pack("{sOsOsOsO}", "password_required", json_object_get(json_object_get(j_scope, "scope"), "password_required"), "password_max_age", json_object_get(json_object_get(j_scope, "scope"), "password_max_age"), "schemes", json_object_get(j_scheme_list, "scheme"), "scheme_required", json_object_get(j_scheme_list, "scheme_required")));
-            } else if (check_result_value(j_scheme_list, G_ERROR_NOT_FOUND)) {
-              json_object_set_new(json_object_get(j_result, "scheme"), scope_array[i], json_pack("{sOsOs{}s{}}", "password_required", json_object_get(json_object_get(j_scope, "scope"), "password_required"), "password_max_age", json_object_get(json_object_get(j_scope, "scope"), "password_max_age"), "schemes", "scheme_required"));
+            j_scheme_list = json_object_get(j_scope, "scope");
+            if (json_object_size(json_object_get(j_scheme_list, "scheme")) && json_object_get(j_scheme_list, "scheme_required") != NULL) {
+              json_object_set_new(json_object_get(j_result, "scheme"), scope_array[i], json_pack("{sOsOsOsO}", "password_required", json_object_get(j_scheme_list, "password_required"), "password_max_age", json_object_get(j_scheme_list, "password_max_age"), "schemes", json_object_get(j_scheme_list, "scheme"), "scheme_required", json_object_get(j_scheme_list, "scheme_required")));
+            } else {
+              json_object_set_new(json_object_get(j_result, "scheme"), scope_array[i], json_pack("{sOsOs{}s{}}", "password_required", json_object_get(j_scheme_list, "password_required"), "password_max_age", json_object_get(j_scheme_list, "password_max_age"), "schemes", "scheme_required"));
             }
-            json_decref(j_scheme_list);
           }
           json_decref(j_scope);
         }
@@ -325,6 +482,7 @@ json_t * get_auth_scheme_list_from_scope_list(struct config_elements * config, c
 }
 
 static json_t * is_scheme_valid_for_session(struct config_elements * config, json_int_t guasmi_id, json_int_t max_use, json_int_t password_max_age, const char * session_hash) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query, * j_result = NULL, * j_session = get_current_session(config, session_hash), * j_return;
   int res;
   time_t now;
@@ -335,8 +493,8 @@ static json_t * is_scheme_valid_for_session(struct config_elements * config, jso
                         GLEWLWYD_TABLE_USER_SESSION_SCHEME,
                         "columns",
                           "guss_id",
-                          SWITCH_DB_TYPE(config->conn->type, "UNIX_TIMESTAMP(guss_last_login) AS guss_last_login", "guss_last_login AS guss_last_login", "EXTRACT(EPOCH FROM guss_last_login)::integer AS guss_last_login"),
-                          SWITCH_DB_TYPE(config->conn->type, "UNIX_TIMESTAMP(guss_expiration) AS guss_expiration", "guss_expiration AS guss_expiration", "EXTRACT(EPOCH FROM guss_expiration)::integer AS guss_expiration"),
+                          SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(guss_last_login) AS guss_last_login", "guss_last_login AS guss_last_login", "EXTRACT(EPOCH FROM guss_last_login)::integer AS guss_last_login"),
+                          SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(guss_expiration) AS guss_expiration", "guss_expiration AS guss_expiration", "EXTRACT(EPOCH FROM guss_expiration)::integer AS guss_expiration"),
                         "where",
                           "gus_id",
                           json_object_get(json_object_get(j_session, "session"), "gus_id"),
@@ -349,7 +507,7 @@ static json_t * is_scheme_valid_for_session(struct config_elements * config, jso
     if (max_use > 0) {
       json_object_set_new(json_object_get(j_query, "where"), "guss_use_counter", json_pack("{sssI}", "operator", "<", "value", max_use));
     }
-    res = h_select(config->conn, j_query, &j_result, NULL);
+    res = h_select(conn, j_query, &j_result, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       time(&now);
@@ -377,6 +535,7 @@ static json_t * is_scheme_valid_for_session(struct config_elements * config, jso
     j_return = json_pack("{si}", "result", G_ERROR);
   }
   json_decref(j_session);
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
@@ -417,7 +576,7 @@ int is_scope_list_valid_for_session(struct config_elements * config, const char
 }
 
 json_t * get_validated_auth_scheme_list_from_scope_list(struct config_elements * config, const char * scope_list, const char * session_uid) {
-  char * session_hash = NULL;
+  char session_hash[GLEWLWYD_HASH_BUFFER_SIZE];
   json_t * j_scheme_list = NULL, * j_cur_scope, * j_scope, * j_scheme, * j_group, * j_user = NULL, * j_scheme_remove, * j_scheme_password_valid, * j_scheme_valid;
   const char * key_scope, * key_group;
   size_t index_scheme;
@@ -431,8 +590,7 @@ json_t * get_validated_auth_scheme_list_from_scope_list(struct config_elements *
       if (check_result_value(j_scope, G_OK)) {
         j_user = get_current_user_from_session(config, session_uid);
         if (check_result_value(j_user, G_OK)) {
-          session_hash = generate_hash(config->hash_algorithm, session_uid);
-          if (session_hash != NULL) {
+          if (generate_hash_buffer(config->hash_algorithm, session_uid, 0, session_hash, sizeof(session_hash)) == G_OK) {
             j_scheme_password_valid = is_scheme_valid_for_session(config, 0, 0, json_object_get(j_cur_scope, "password_required")==json_true()?json_integer_value(json_object_get(j_cur_scope, "password_max_age")):0, session_hash);
             if (check_result_value(j_scheme_password_valid, G_OK)) {
               json_object_set(j_cur_scope, "display_name", json_object_get(json_object_get(j_scope, "scope"), "display_name"));
@@ -500,10 +658,9 @@ json_t * get_validated_auth_scheme_list_from_scope_list(struct config_elements *
             }
             json_decref(j_scheme_password_valid);
           } else {
-            y_log_message(Y_LOG_LEVEL_ERROR, "get_validated_auth_scheme_list_from_scope_list - Error generate_hash");
+            y_log_message(Y_LOG_LEVEL_ERROR, "get_validated_auth_scheme_list_from_scope_list - Error generate_hash_buffer");
             j_scheme_list = json_pack("{si}", "result", G_ERROR);
           }
-          o_free(session_hash);
         } else {
           json_object_del(j_cur_scope, "schemes");
           json_object_del(j_cur_scope, "scheme_required");
@@ -521,6 +678,7 @@ json_t * get_validated_auth_scheme_list_from_scope_list(struct config_elements *
 }
 
 json_t * get_client_user_scope_grant(struct config_elements * config, const char * client_id, const char * username, const char * scope_list) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   char ** scope_array = NULL;
   json_t * j_query, * j_result = NULL, * j_return, * j_element;
   int res, i;
@@ -529,7 +687,7 @@ json_t * get_client_user_scope_grant(struct config_elements * config, const char
   
   if (split_string(scope_list, " ", &scope_array) > 0) {
     for (i=0; scope_array[i] != NULL; i++) {
-      scope_escaped = h_escape_string_with_quotes(config->conn, scope_array[i]);
+      scope_escaped = h_escape_string_with_quotes(conn, scope_array[i]);
       if (scope_name_list == NULL) {
         scope_name_list = o_strdup(scope_escaped);
       } else {
@@ -538,8 +696,8 @@ json_t * get_client_user_scope_grant(struct config_elements * config, const char
       o_free(scope_escaped);
     }
     if (scope_name_list != NULL) {
-      username_escaped = h_escape_string_with_quotes(config->conn, username);
-      client_id_escaped = h_escape_string_with_quotes(config->conn, client_id);
+      username_escaped = h_escape_string_with_quotes(conn, username);
+      client_id_escaped = h_escape_string_with_quotes(conn, client_id);
       scope_clause = msprintf("IN (SELECT gs_id FROM " GLEWLWYD_TABLE_CLIENT_USER_SCOPE " WHERE gs_id IN (SELECT gs_id FROM " GLEWLWYD_TABLE_SCOPE " WHERE gs_name IN (%s)) AND gcus_username=%s AND gcus_client_id=%s AND gcus_enabled=1)", scope_name_list, username_escaped, client_id_escaped);
       j_query = json_pack("{sss[ssss]s{s{ssss}}}",
                           "table",
@@ -559,7 +717,7 @@ json_t * get_client_user_scope_grant(struct config_elements * config, const char
       o_free(username_escaped);
       o_free(client_id_escaped);
       o_free(scope_clause);
-      res = h_select(config->conn, j_query, &j_result, NULL);
+      res = h_select(conn, j_query, &j_result, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         json_array_foreach(j_result, index, j_element) {
@@ -582,6 +740,7 @@ json_t * get_client_user_scope_grant(struct config_elements * config, const char
     j_return = json_pack("{si}", "result", G_ERROR);
   }
   free_string_array(scope_array);
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
@@ -653,6 +812,7 @@ json_t * get_granted_scopes_for_client(struct config_elements * config, json_t *
 }
 
 json_t * get_client_grant_list(struct config_elements * config, const char * username, size_t offset, size_t limit) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query, * j_result = NULL, * j_result_scope = NULL, * j_return, * j_client, * j_element = NULL;
   int res;
   size_t index = 0;
@@ -670,15 +830,15 @@ json_t * get_client_grant_list(struct config_elements * config, const char * use
   if (limit) {
     json_object_set_new(j_query, "limit", json_integer((json_int_t)limit));
   }
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     j_return = json_pack("{sis[]}", "result", G_OK, "client_grant");
     json_array_foreach(j_result, index, j_element) {
       j_client = get_client(config, json_string_value(json_object_get(j_element, "client_id")), NULL);
       if (check_result_value(j_client, G_OK) && json_object_get(json_object_get(j_client, "client"), "enabled") == json_true()) {
-        username_escaped = h_escape_string_with_quotes(config->conn, username);
-        client_id_escaped = h_escape_string_with_quotes(config->conn, json_string_value(json_object_get(j_element, "client_id")));
+        username_escaped = h_escape_string_with_quotes(conn, username);
+        client_id_escaped = h_escape_string_with_quotes(conn, json_string_value(json_object_get(j_element, "client_id")));
         scope_clause = msprintf("IN (SELECT gs_id FROM " GLEWLWYD_TABLE_CLIENT_USER_SCOPE " WHERE gcus_username=%s AND gcus_client_id=%s AND gcus_enabled=1)", username_escaped, client_id_escaped);
         j_query = json_pack("{sss[sss]s{s{ssss}}}",
                             "table", GLEWLWYD_TABLE_SCOPE,
@@ -695,7 +855,7 @@ json_t * get_client_grant_list(struct config_elements * config, const char * use
         o_free(scope_clause);
         o_free(client_id_escaped);
         o_free(username_escaped);
-        res = h_select(config->conn, j_query, &j_result_scope, NULL);
+        res = h_select(conn, j_query, &j_result_scope, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           json_array_append_new(json_object_get(j_return, "client_grant"), json_pack("{sOsOsOsO}", "client_id", json_object_get(json_object_get(j_client, "client"), "client_id"), "name", json_object_get(json_object_get(j_client, "client"), "name"), "description", json_object_get(json_object_get(j_client, "client"), "description"), "scope", j_result_scope));
@@ -714,10 +874,12 @@ json_t * get_client_grant_list(struct config_elements * config, const char * use
     glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
 int set_granted_scopes_for_client(struct config_elements * config, json_t * j_user, const char * client_id, const char * scope_list) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query, * j_element;
   char * scope_clause = NULL, * scope_escaped, ** scope_array = NULL;
   int res, ret = G_OK, i, has_granted;
@@ -734,7 +896,7 @@ int set_granted_scopes_for_client(struct config_elements * config, json_t * j_us
                        json_string_value(json_object_get(j_user, "username")),
                        "gcus_client_id",
                        client_id);
-  res = h_update(config->conn, j_query, NULL);
+  res = h_update(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (scope_list != NULL && !o_strnullempty(scope_list)) {
@@ -744,7 +906,7 @@ int set_granted_scopes_for_client(struct config_elements * config, json_t * j_us
           json_array_foreach(json_object_get(j_user, "scope"), index, j_element) {
             if (0 == o_strcmp(scope_array[i], json_string_value(j_element)) && ret != G_ERROR_DB) {
               has_granted = 1;
-              scope_escaped = h_escape_string_with_quotes(config->conn, scope_array[i]);
+              scope_escaped = h_escape_string_with_quotes(conn, scope_array[i]);
               scope_clause = msprintf("(SELECT gs_id FROM " GLEWLWYD_TABLE_SCOPE " WHERE gs_name=%s)", scope_escaped);
               j_query = json_pack("{sss{s{ss}ssss}}",
                                   "table",
@@ -758,7 +920,7 @@ int set_granted_scopes_for_client(struct config_elements * config, json_t * j_us
                                     "gcus_client_id",
                                     client_id);
               o_free(scope_clause);
-              res = h_insert(config->conn, j_query, NULL);
+              res = h_insert(conn, j_query, NULL);
               if (res != H_OK) {
                 y_log_message(Y_LOG_LEVEL_ERROR, "set_granted_scopes_for_client - Error executing j_query (2)");
                 glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
@@ -784,6 +946,7 @@ int set_granted_scopes_for_client(struct config_elements * config, json_t * j_us
     glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return ret;
 }
 
@@ -924,13 +1087,14 @@ json_t * is_scope_valid(struct config_elements * config, json_t * j_scope, int a
 }
 
 static int add_scope_scheme_groups(struct config_elements * config, const char * scope, json_t * j_scheme, json_t * j_scheme_required) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query, * j_scope_group, * j_scope_group_id, * j_scheme_module;
   int res, ret = G_OK;
   char * scope_escaped, * scope_clause, * scheme_escaped, * scheme_module_clause;
   const char * group_name;
   size_t index;
 
-  scope_escaped = h_escape_string_with_quotes(config->conn, scope);
+  scope_escaped = h_escape_string_with_quotes(conn, scope);
   scope_clause = msprintf("(SELECT gs_id FROM " GLEWLWYD_TABLE_SCOPE " WHERE gs_name=%s)", scope_escaped);
 
   json_object_foreach(j_scheme, group_name, j_scope_group) {
@@ -946,13 +1110,13 @@ static int add_scope_scheme_groups(struct config_elements * config, const char *
     if (json_object_get(j_scheme_required, group_name) != NULL) {
       json_object_set(json_object_get(j_query, "values"), "gsg_scheme_required", json_object_get(j_scheme_required, group_name));
     }
-    res = h_insert(config->conn, j_query, NULL);
+    glewlwyd_db_insert_begin(config, conn);
+    res = glewlwyd_db_insert(config, conn, j_query, "gsg_id", &j_scope_group_id);
     json_decref(j_query);
     if (res == H_OK) {
-      j_scope_group_id = h_last_insert_id(config->conn);
       if (j_scope_group_id != NULL && json_integer_value(j_scope_group_id) > 0) {
         json_array_foreach(j_scope_group, index, j_scheme_module) {
-          scheme_escaped = h_escape_string_with_quotes(config->conn, json_string_value(json_object_get(j_scheme_module, "scheme_name")));
+          scheme_escaped = h_escape_string_with_quotes(conn, json_string_value(json_object_get(j_scheme_module, "scheme_name")));
           scheme_module_clause = msprintf("(SELECT guasmi_id FROM " GLEWLWYD_TABLE_USER_AUTH_SCHEME_MODULE_INSTANCE " WHERE guasmi_name=%s)", scheme_escaped);
           j_query = json_pack("{sss{sOs{ss}}}",
                               "table",
@@ -965,7 +1129,7 @@ static int add_scope_scheme_groups(struct config_elements * config, const char *
                                   scheme_module_clause);
           o_free(scheme_module_clause);
           o_free(scheme_escaped);
-          res = h_insert(config->conn, j_query, NULL);
+          res = h_insert(conn, j_query, NULL);
           json_decref(j_query);
           if (res != H_OK) {
             y_log_message(Y_LOG_LEVEL_ERROR, "add_scope_scheme_groups - Error executing j_query (2)");
@@ -984,13 +1148,16 @@ static int add_scope_scheme_groups(struct config_elements * config, const char *
       glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
       ret = G_ERROR_DB;
     }
+    glewlwyd_db_insert_end(config, conn);
   }
   o_free(scope_escaped);
   o_free(scope_clause);
+  glewlwyd_db_pool_checkin(config, conn);
   return ret;
 }
 
 int add_scope(struct config_elements * config, json_t * j_scope) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query;
   int res, ret;
 
@@ -1008,7 +1175,7 @@ int add_scope(struct config_elements * config, json_t * j_scope) {
                         json_object_get(j_scope, "password_required")==json_false()?0:1,
                         "gs_password_max_age",
                         json_object_get(j_scope, "password_max_age")!=NULL?json_integer_value(json_object_get(j_scope, "password_max_age")):0);
-  res = h_insert(config->conn, j_query, NULL);
+  res = h_insert(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_object_get(j_scope, "scheme") != NULL && json_object_size(json_object_get(j_scope, "scheme"))) {
@@ -1026,15 +1193,18 @@ int add_scope(struct config_elements * config, json_t * j_scope) {
     glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  glewlwyd_db_pool_checkin(config, conn);
+  update_scope_graph(config);
   return ret;
 }
 
 int set_scope(struct config_elements * config, const char * scope, json_t * j_scope) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query;
   char * scope_escaped, * scope_clause;
   int res, ret;
 
-  scope_escaped = h_escape_string_with_quotes(config->conn, scope);
+  scope_escaped = h_escape_string_with_quotes(conn, scope);
   scope_clause = msprintf("IN (SELECT gs_id FROM " GLEWLWYD_TABLE_SCOPE " WHERE gs_name=%s)", scope_escaped);
   j_query = json_pack("{sss{s{ssss}}}",
                       "table",
@@ -1047,7 +1217,7 @@ int set_scope(struct config_elements * config, const char * scope, json_t * j_sc
                           scope_clause);
   o_free(scope_clause);
   o_free(scope_escaped);
-  res = h_delete(config->conn, j_query, NULL);
+  res = h_delete(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     j_query = json_pack("{sss{sOsOsisI}s{ss}}",
@@ -1065,7 +1235,7 @@ int set_scope(struct config_elements * config, const char * scope, json_t * j_sc
                         "where",
                           "gs_name",
                           scope);
-    res = h_update(config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       if (add_scope_scheme_groups(config, scope, json_object_get(j_scope, "scheme"), json_object_get(j_scope, "scheme_required")) == G_OK) {
@@ -1084,10 +1254,13 @@ int set_scope(struct config_elements * config, const char * scope, json_t * j_sc
     glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  glewlwyd_db_pool_checkin(config, conn);
+  update_scope_graph(config);
   return ret;
 }
 
 int delete_scope(struct config_elements * config, const char * scope) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query;
   int res, ret;
 
@@ -1097,7 +1270,7 @@ int delete_scope(struct config_elements * config, const char * scope) {
                       "where",
                         "gs_name",
                         scope);
-  res = h_delete(config->conn, j_query, NULL);
+  res = h_delete(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = G_OK;
@@ -1106,5 +1279,7 @@ int delete_scope(struct config_elements * config, const char * scope) {
     glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  glewlwyd_db_pool_checkin(config, conn);
+  update_scope_graph(config);
   return ret;
 }
@@ -28,10 +28,6 @@
 
 static void send_mail_on_new_connexion(struct config_elements * config, const char * username, const char * ip_address) {
   struct send_mail_content_struct * send_mail;
-  pthread_t thread_mail_connexion;
-  int thread_ret, thread_detach;
-  pthread_attr_t attr;
-  struct sched_param param;
   json_t * j_misc_config = get_misc_config(config, GLEWLWYD_MAIL_ON_CONNEXION_TYPE, NULL), * j_user;
   char * body, * ip_data = NULL, * ip_address_parsed = o_strdup(ip_address);
   const char * lang, * body_pattern;
@@ -66,23 +62,8 @@ static void send_mail_on_new_connexion(struct config_elements * config, const ch
         send_mail->subject = o_strdup(get_template_property(json_object_get(json_object_get(j_misc_config, "misc_config"), "value"), "templates", lang, "subject"));
         send_mail->body = o_strdup(body);
         y_log_message(Y_LOG_LEVEL_WARNING, "Security - New connexion - Notification sent to username %s, e-mail %s at IP Address %s", username, send_mail->email, ip_address);
-        pthread_attr_init (&attr);
-        pthread_attr_getschedparam (&attr, &param);
-        param.sched_priority = 0;
-        pthread_attr_setschedparam (&attr, &param);
-        thread_ret = pthread_create(&thread_mail_connexion, &attr, thread_send_mail, (void *)send_mail);
-        thread_detach = pthread_detach(thread_mail_connexion);
-        if (thread_ret || thread_detach) {
-          y_log_message(Y_LOG_LEVEL_ERROR, "send_mail_on_new_connexion - Error thread");
-          o_free(send_mail->host);
-          o_free(send_mail->user);
-          o_free(send_mail->password);
-          o_free(send_mail->from);
-          o_free(send_mail->content_type);
-          o_free(send_mail->email);
-          o_free(send_mail->subject);
-          o_free(send_mail->body);
-          o_free(send_mail);
+        if (glewlwyd_job_queue_submit(config, GLEWLWYD_JOB_TYPE_MAIL, NULL, NULL, &run_send_mail, &free_send_mail, send_mail) != G_OK) {
+          y_log_message(Y_LOG_LEVEL_ERROR, "send_mail_on_new_connexion - Error glewlwyd_job_queue_submit");
         }
       } else {
         y_log_message(Y_LOG_LEVEL_ERROR, "send_mail_on_new_connexion - Error allocating resources for send_mail");
@@ -96,13 +77,14 @@ static void send_mail_on_new_connexion(struct config_elements * config, const ch
 }
 
 json_t * get_session_scheme(struct config_elements * config, json_int_t gus_id) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query, * j_result, * j_return;
   int res;
   char * expire_clause;
   
-  if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+  if (conn->type==HOEL_DB_TYPE_MARIADB) {
     expire_clause = o_strdup("> NOW()");
-  } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+  } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
     expire_clause = o_strdup("> NOW()");
   } else { // HOEL_DB_TYPE_SQLITE
     expire_clause = o_strdup("> (strftime('%s','now'))");
@@ -112,7 +94,7 @@ json_t * get_session_scheme(struct config_elements * config, json_int_t gus_id)
                       GLEWLWYD_TABLE_USER_SESSION_SCHEME,
                       "columns",
                         "guasmi_id",
-                        SWITCH_DB_TYPE(config->conn->type, "UNIX_TIMESTAMP(guss_expiration) AS expiration", "guss_expiration AS expiration", "EXTRACT(EPOCH FROM guss_expiration)::integer AS expiration"),
+                        SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(guss_expiration) AS expiration", "guss_expiration AS expiration", "EXTRACT(EPOCH FROM guss_expiration)::integer AS expiration"),
                       "where",
                         "gus_id",
                         gus_id,
@@ -124,7 +106,7 @@ json_t * get_session_scheme(struct config_elements * config, json_int_t gus_id)
                           "value",
                           expire_clause);
   o_free(expire_clause);
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     j_return = json_pack("{siso}", "result", G_OK, "scheme", j_result);
@@ -133,29 +115,31 @@ json_t * get_session_scheme(struct config_elements * config, json_int_t gus_id)
     glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
 json_t * get_session_for_username(struct config_elements * config, const char * session_uid, const char * username) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query, * j_result, * j_return, * j_session_scheme;
   int res;
   char * expire_clause;
-  char * session_uid_hash = generate_hash(config->hash_algorithm, session_uid);
+  char session_uid_hash[GLEWLWYD_HASH_BUFFER_SIZE];
 
-  if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+  if (conn->type==HOEL_DB_TYPE_MARIADB) {
     expire_clause = o_strdup("> NOW()");
-  } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+  } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
     expire_clause = o_strdup("> NOW()");
   } else { // HOEL_DB_TYPE_SQLITE
     expire_clause = o_strdup("> (strftime('%s','now'))");
   }
-  if (session_uid_hash != NULL) {
+  if (generate_hash_buffer(config->hash_algorithm, session_uid, 0, session_uid_hash, sizeof(session_uid_hash)) == G_OK) {
     j_query = json_pack("{sss[ss]s{sssssis{ssss}}}",
                         "table",
                         GLEWLWYD_TABLE_USER_SESSION,
                         "columns",
                           "gus_id",
-                          SWITCH_DB_TYPE(config->conn->type, "UNIX_TIMESTAMP(gus_expiration) AS expiration", "gus_expiration AS expiration", "EXTRACT(EPOCH FROM gus_expiration)::integer AS expiration"),
+                          SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gus_expiration) AS expiration", "gus_expiration AS expiration", "EXTRACT(EPOCH FROM gus_expiration)::integer AS expiration"),
                         "where",
                           "gus_session_hash",
                           session_uid_hash,
@@ -169,7 +153,7 @@ json_t * get_session_for_username(struct config_elements * config, const char *
                             "value",
                             expire_clause);
     o_free(expire_clause);
-    res = h_select(config->conn, j_query, &j_result, NULL);
+    res = h_select(conn, j_query, &j_result, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       if (json_array_size(j_result) > 0) {
@@ -201,35 +185,36 @@ json_t * get_session_for_username(struct config_elements * config, const char *
       glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
       j_return = json_pack("{si}", "result", G_ERROR_DB);
     }
-    o_free(session_uid_hash);
   } else {
-    y_log_message(Y_LOG_LEVEL_ERROR, "get_session_for_username - Error generate_hash");
+    y_log_message(Y_LOG_LEVEL_ERROR, "get_session_for_username - Error generate_hash_buffer");
     j_return = json_pack("{si}", "result", G_ERROR);
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
 json_t * get_users_for_session(struct config_elements * config, const char * session_uid) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query, * j_result, * j_return, * j_element, * j_user, * j_session_array;
   int res;
   size_t index;
-  char * expire_clause, * session_uid_hash;
+  char * expire_clause, session_uid_hash[GLEWLWYD_HASH_BUFFER_SIZE];
 
   if (session_uid != NULL && !o_strnullempty(session_uid)) {
-    if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
       expire_clause = o_strdup("> NOW()");
-    } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
       expire_clause = o_strdup("> NOW()");
     } else { // HOEL_DB_TYPE_SQLITE
       expire_clause = o_strdup("> (strftime('%s','now'))");
     }
-    if ((session_uid_hash = generate_hash(config->hash_algorithm, session_uid)) != NULL) {
+    if (generate_hash_buffer(config->hash_algorithm, session_uid, 0, session_uid_hash, sizeof(session_uid_hash)) == G_OK) {
       j_query = json_pack("{sss[ss]s{sssis{ssss}}ss}",
                           "table",
                           GLEWLWYD_TABLE_USER_SESSION,
                           "columns",
                             "gus_username",
-                            SWITCH_DB_TYPE(config->conn->type, "UNIX_TIMESTAMP(gus_last_login) AS last_login", "gus_last_login AS last_login", "EXTRACT(EPOCH FROM gus_last_login)::integer AS last_login"),
+                            SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gus_last_login) AS last_login", "gus_last_login AS last_login", "EXTRACT(EPOCH FROM gus_last_login)::integer AS last_login"),
                           "where",
                             "gus_session_hash",
                             session_uid_hash,
@@ -243,8 +228,7 @@ json_t * get_users_for_session(struct config_elements * config, const char * ses
                           "order_by",
                           "gus_current DESC");
       o_free(expire_clause);
-      o_free(session_uid_hash);
-      res = h_select(config->conn, j_query, &j_result, NULL);
+      res = h_select(conn, j_query, &j_result, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         if (json_array_size(j_result) > 0) {
@@ -280,36 +264,37 @@ json_t * get_users_for_session(struct config_elements * config, const char * ses
         j_return = json_pack("{si}", "result", G_ERROR_DB);
       }
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "get_users_for_session - Error generate_hash");
+      y_log_message(Y_LOG_LEVEL_ERROR, "get_users_for_session - Error generate_hash_buffer");
       j_return = json_pack("{si}", "result", G_ERROR);
     }
   } else {
     j_return = json_pack("{si}", "result", G_ERROR_NOT_FOUND);
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
 json_t * get_current_user_for_session(struct config_elements * config, const char * session_uid) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query, * j_result, * j_return;
   int res;
-  char * expire_clause, * session_uid_hash;
+  char * expire_clause, session_uid_hash[GLEWLWYD_HASH_BUFFER_SIZE];
 
   if (!o_strnullempty(session_uid)) {
-    if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+    if (conn->type==HOEL_DB_TYPE_MARIADB) {
       expire_clause = o_strdup("> NOW()");
-    } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+    } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
       expire_clause = o_strdup("> NOW()");
     } else { // HOEL_DB_TYPE_SQLITE
       expire_clause = o_strdup("> (strftime('%s','now'))");
     }
-    session_uid_hash = generate_hash(config->hash_algorithm, session_uid);
-    if (session_uid_hash != NULL) {
+    if (generate_hash_buffer(config->hash_algorithm, session_uid, 0, session_uid_hash, sizeof(session_uid_hash)) == G_OK) {
       j_query = json_pack("{sss[ss]s{sssis{ssss}si}sssi}",
                           "table",
                           GLEWLWYD_TABLE_USER_SESSION,
                           "columns",
                             "gus_username",
-                            SWITCH_DB_TYPE(config->conn->type, "UNIX_TIMESTAMP(gus_expiration) AS expiration", "gus_expiration AS expiration", "EXTRACT(EPOCH FROM gus_expiration)::integer AS expiration"),
+                            SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gus_expiration) AS expiration", "gus_expiration AS expiration", "EXTRACT(EPOCH FROM gus_expiration)::integer AS expiration"),
                           "where",
                             "gus_session_hash",
                             session_uid_hash,
@@ -326,7 +311,7 @@ json_t * get_current_user_for_session(struct config_elements * config, const cha
                           "gus_current DESC",
                           "limit",
                           1);
-      res = h_select(config->conn, j_query, &j_result, NULL);
+      res = h_select(conn, j_query, &j_result, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         if (json_array_size(j_result) > 0) {
@@ -341,27 +326,28 @@ json_t * get_current_user_for_session(struct config_elements * config, const cha
         j_return = json_pack("{si}", "result", G_ERROR_DB);
       }
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "get_current_user_for_session - Error generate_hash");
+      y_log_message(Y_LOG_LEVEL_ERROR, "get_current_user_for_session - Error generate_hash_buffer");
       j_return = json_pack("{si}", "result", G_ERROR);
     }
-    o_free(session_uid_hash);
     o_free(expire_clause);
   } else {
     j_return = json_pack("{si}", "result", G_ERROR_NOT_FOUND);
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
 int user_session_update(struct config_elements * config, const char * session_uid, const char * ip_source, const char * user_agent, const char * issued_for, const char * username, const char * scheme_name, int update_login) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query, * j_session = get_session_for_username(config, session_uid, username), * j_last_index;
   struct _user_auth_scheme_module_instance * scheme_instance = NULL;
   int res, ret;
   time_t now;
   char * expiration_clause, * last_login_clause;
-  char * session_uid_hash = generate_hash(config->hash_algorithm, session_uid);
+  char session_uid_hash[GLEWLWYD_HASH_BUFFER_SIZE];
   
   time(&now);
-  if (session_uid_hash != NULL) {
+  if (generate_hash_buffer(config->hash_algorithm, session_uid, 0, session_uid_hash, sizeof(session_uid_hash)) == G_OK) {
     if (check_result_value(j_session, G_ERROR_NOT_FOUND)) {
       j_query = json_pack("{sss{si}s{ss}}",
                           "table",
@@ -372,63 +358,57 @@ int user_session_update(struct config_elements * config, const char * session_ui
                           "where",
                             "gus_session_hash",
                             session_uid_hash);
-      res = h_update(config->conn, j_query, NULL);
+      res = h_update(conn, j_query, NULL);
       json_decref(j_query);
       if (res == H_OK) {
-        if (pthread_mutex_lock(&config->insert_lock)) {
-          y_log_message(Y_LOG_LEVEL_ERROR, "user_session_update - Error pthread_mutex_lock");
-          ret = G_ERROR;
-        } else {
-          // Create session for user if not exist
-          j_query = json_pack("{sss{sssssssssi}}",
-                              "table",
-                              GLEWLWYD_TABLE_USER_SESSION,
-                              "values",
-                                "gus_session_hash", session_uid_hash,
-                                "gus_username", username,
-                                "gus_user_agent", user_agent!=NULL?user_agent:"",
-                                "gus_issued_for", issued_for!=NULL?issued_for:"",
-                                "gus_current", 1);
-          if (update_login) {
-            if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
-              expiration_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)config->session_expiration));
-            } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
-              expiration_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)config->session_expiration));
-            } else { // HOEL_DB_TYPE_SQLITE
-              expiration_clause = msprintf("%u", (now + (time_t)config->session_expiration));
-            }
-            if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
-              last_login_clause = msprintf("FROM_UNIXTIME(%u)", (now));
-            } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
-              last_login_clause = msprintf("TO_TIMESTAMP(%u)", (now));
-            } else { // HOEL_DB_TYPE_SQLITE
-              last_login_clause = msprintf("%u", (now));
-            }
-            json_object_set_new(json_object_get(j_query, "values"), "gus_last_login", json_pack("{ss}", "raw", last_login_clause));
-            json_object_set_new(json_object_get(j_query, "values"), "gus_expiration", json_pack("{ss}", "raw", expiration_clause));
-            o_free(last_login_clause);
-            o_free(expiration_clause);
+        // Create session for user if not exist
+        j_query = json_pack("{sss{sssssssssi}}",
+                            "table",
+                            GLEWLWYD_TABLE_USER_SESSION,
+                            "values",
+                              "gus_session_hash", session_uid_hash,
+                              "gus_username", username,
+                              "gus_user_agent", user_agent!=NULL?user_agent:"",
+                              "gus_issued_for", issued_for!=NULL?issued_for:"",
+                              "gus_current", 1);
+        if (update_login) {
+          if (conn->type==HOEL_DB_TYPE_MARIADB) {
+            expiration_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)config->session_expiration));
+          } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
+            expiration_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)config->session_expiration));
+          } else { // HOEL_DB_TYPE_SQLITE
+            expiration_clause = msprintf("%u", (now + (time_t)config->session_expiration));
           }
-          res = h_insert(config->conn, j_query, NULL);
-          json_decref(j_query);
-          json_decref(j_session);
-          if (res == H_OK) {
-            if ((j_last_index = h_last_insert_id(config->conn)) != NULL) {
-              update_issued_for(config, NULL, GLEWLWYD_TABLE_USER_SESSION, "gus_issued_for", issued_for, "gus_id", json_integer_value(j_last_index));
-              send_mail_on_new_connexion(config, username, ip_source);
-              j_session = get_session_for_username(config, session_uid, username);
-            } else {
-              y_log_message(Y_LOG_LEVEL_ERROR, "user_session_update - Error j_last_index session");
-              glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
-              j_session = json_pack("{si}", "result", G_ERROR_DB);
-            }
-            json_decref(j_last_index);
+          if (conn->type==HOEL_DB_TYPE_MARIADB) {
+            last_login_clause = msprintf("FROM_UNIXTIME(%u)", (now));
+          } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
+            last_login_clause = msprintf("TO_TIMESTAMP(%u)", (now));
+          } else { // HOEL_DB_TYPE_SQLITE
+            last_login_clause = msprintf("%u", (now));
+          }
+          json_object_set_new(json_object_get(j_query, "values"), "gus_last_login", json_pack("{ss}", "raw", last_login_clause));
+          json_object_set_new(json_object_get(j_query, "values"), "gus_expiration", json_pack("{ss}", "raw", expiration_clause));
+          o_free(last_login_clause);
+          o_free(expiration_clause);
+        }
+        res = glewlwyd_db_insert(config, conn, j_query, "gus_id", &j_last_index);
+        json_decref(j_query);
+        json_decref(j_session);
+        if (res == H_OK) {
+          if (j_last_index != NULL) {
+            update_issued_for(config, NULL, GLEWLWYD_TABLE_USER_SESSION, "gus_issued_for", issued_for, "gus_id", json_integer_value(j_last_index));
+            send_mail_on_new_connexion(config, username, ip_source);
+            j_session = get_session_for_username(config, session_uid, username);
           } else {
-            y_log_message(Y_LOG_LEVEL_ERROR, "user_session_update - Error h_insert session");
+            y_log_message(Y_LOG_LEVEL_ERROR, "user_session_update - Error j_last_index session");
             glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
             j_session = json_pack("{si}", "result", G_ERROR_DB);
           }
-          pthread_mutex_unlock(&config->insert_lock);
+          json_decref(j_last_index);
+        } else {
+          y_log_message(Y_LOG_LEVEL_ERROR, "user_session_update - Error h_insert session");
+          glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+          j_session = json_pack("{si}", "result", G_ERROR_DB);
         }
       } else {
         y_log_message(Y_LOG_LEVEL_ERROR, "user_session_update - Error h_update session (0)");
@@ -445,7 +425,7 @@ int user_session_update(struct config_elements * config, const char * session_ui
                           "where",
                             "gus_session_hash",
                             session_uid_hash);
-      res = h_update(config->conn, j_query, NULL);
+      res = h_update(conn, j_query, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         j_query = json_pack("{sss{sssi}s{ssss}}",
@@ -463,16 +443,16 @@ int user_session_update(struct config_elements * config, const char * session_ui
                               username);
         if (update_login) {
           // Refresh session for user
-          if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+          if (conn->type==HOEL_DB_TYPE_MARIADB) {
             expiration_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)config->session_expiration));
-          } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+          } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
             expiration_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)config->session_expiration));
           } else { // HOEL_DB_TYPE_SQLITE
             expiration_clause = msprintf("%u", (now + (time_t)config->session_expiration));
           }
-          if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+          if (conn->type==HOEL_DB_TYPE_MARIADB) {
             last_login_clause = msprintf("FROM_UNIXTIME(%u)", (now));
-          } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+          } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
             last_login_clause = msprintf("TO_TIMESTAMP(%u)", (now));
           } else { // HOEL_DB_TYPE_SQLITE
             last_login_clause = msprintf("%u", (now));
@@ -482,7 +462,7 @@ int user_session_update(struct config_elements * config, const char * session_ui
           o_free(last_login_clause);
           o_free(expiration_clause);
         }
-        res = h_update(config->conn, j_query, NULL);
+        res = h_update(conn, j_query, NULL);
         json_decref(j_query);
         json_decref(j_session);
         if (res == H_OK) {
@@ -515,13 +495,13 @@ int user_session_update(struct config_elements * config, const char * session_ui
                                   json_object_get(json_object_get(j_session, "session"), "gus_id"),
                                   "guasmi_id",
                                   scheme_instance->guasmi_id);
-            res = h_update(config->conn, j_query, NULL);
+            res = h_update(conn, j_query, NULL);
             json_decref(j_query);
             if (res == H_OK) {
               // Set session scheme for this scheme with the timeout
-              if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+              if (conn->type==HOEL_DB_TYPE_MARIADB) {
                 expiration_clause = msprintf("FROM_UNIXTIME(%u)", (now + (time_t)scheme_instance->guasmi_expiration));
-              } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+              } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
                 expiration_clause = msprintf("TO_TIMESTAMP(%u)", (now + (time_t)scheme_instance->guasmi_expiration));
               } else { // HOEL_DB_TYPE_SQLITE
                 expiration_clause = msprintf("%u", (now + (time_t)scheme_instance->guasmi_expiration));
@@ -538,9 +518,9 @@ int user_session_update(struct config_elements * config, const char * session_ui
                                       "raw",
                                       expiration_clause);
               if (update_login) {
-                if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+                if (conn->type==HOEL_DB_TYPE_MARIADB) {
                   last_login_clause = msprintf("FROM_UNIXTIME(%u)", (now));
-                } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+                } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
                   last_login_clause = msprintf("TO_TIMESTAMP(%u)", (now));
                 } else { // HOEL_DB_TYPE_SQLITE
                   last_login_clause = msprintf("%u", (now));
@@ -549,7 +529,7 @@ int user_session_update(struct config_elements * config, const char * session_ui
                 o_free(last_login_clause);
               }
               o_free(expiration_clause);
-              res = h_insert(config->conn, j_query, NULL);
+              res = h_insert(conn, j_query, NULL);
               json_decref(j_query);
               if (res == H_OK) {
                 ret = G_OK;
@@ -578,13 +558,13 @@ int user_session_update(struct config_elements * config, const char * session_ui
                                 "gus_id",
                                 json_object_get(json_object_get(j_session, "session"), "gus_id"),
                                 "guasmi_id");
-          res = h_update(config->conn, j_query, NULL);
+          res = h_update(conn, j_query, NULL);
           json_decref(j_query);
           if (res == H_OK) {
             // Set session scheme password with the timeout
-            if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+            if (conn->type==HOEL_DB_TYPE_MARIADB) {
               expiration_clause = msprintf("FROM_UNIXTIME(%u)", (now + GLEWLWYD_RESET_PASSWORD_DEFAULT_SESSION_EXPIRATION));
-            } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+            } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
               expiration_clause = msprintf("TO_TIMESTAMP(%u)", (now + GLEWLWYD_RESET_PASSWORD_DEFAULT_SESSION_EXPIRATION));
             } else { // HOEL_DB_TYPE_SQLITE
               expiration_clause = msprintf("%u", (now + GLEWLWYD_RESET_PASSWORD_DEFAULT_SESSION_EXPIRATION));
@@ -600,9 +580,9 @@ int user_session_update(struct config_elements * config, const char * session_ui
                                     "raw",
                                     expiration_clause);
             if (update_login) {
-              if (config->conn->type==HOEL_DB_TYPE_MARIADB) {
+              if (conn->type==HOEL_DB_TYPE_MARIADB) {
                 last_login_clause = msprintf("FROM_UNIXTIME(%u)", (now));
-              } else if (config->conn->type==HOEL_DB_TYPE_PGSQL) {
+              } else if (conn->type==HOEL_DB_TYPE_PGSQL) {
                 last_login_clause = msprintf("TO_TIMESTAMP(%u)", (now));
               } else { // HOEL_DB_TYPE_SQLITE
                 last_login_clause = msprintf("%u", (now));
@@ -611,7 +591,7 @@ int user_session_update(struct config_elements * config, const char * session_ui
               o_free(last_login_clause);
             }
             o_free(expiration_clause);
-            res = h_insert(config->conn, j_query, NULL);
+            res = h_insert(conn, j_query, NULL);
             json_decref(j_query);
             if (res == H_OK) {
               ret = G_OK;
@@ -633,21 +613,22 @@ int user_session_update(struct config_elements * config, const char * session_ui
       y_log_message(Y_LOG_LEVEL_ERROR, "user_session_update - Error get_session_for_username");
       ret = G_ERROR;
     }
-    o_free(session_uid_hash);
   } else {
-    y_log_message(Y_LOG_LEVEL_ERROR, "user_session_update - Error generate_hash");
+    y_log_message(Y_LOG_LEVEL_ERROR, "user_session_update - Error generate_hash_buffer");
     ret = G_ERROR;
   }
   json_decref(j_session);
+  glewlwyd_db_pool_checkin(config, conn);
   return ret;
 }
 
 int user_session_delete(struct config_elements * config, const char * session_uid, const char * username) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query;
   int res, ret;
-  char * session_uid_hash = generate_hash(config->hash_algorithm, session_uid);
+  char session_uid_hash[GLEWLWYD_HASH_BUFFER_SIZE];
 
-  if (session_uid_hash != NULL) {
+  if (generate_hash_buffer(config->hash_algorithm, session_uid, 0, session_uid_hash, sizeof(session_uid_hash)) == G_OK) {
     j_query = json_pack("{sss{sisi}s{ss}}",
                         "table",
                         GLEWLWYD_TABLE_USER_SESSION,
@@ -662,7 +643,7 @@ int user_session_delete(struct config_elements * config, const char * session_ui
     if (username != NULL) {
       json_object_set_new(json_object_get(j_query, "where"), "gus_username", json_string(username));
     }
-    res = h_update(config->conn, j_query, NULL);
+    res = h_update(conn, j_query, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       if (username != NULL) {
@@ -678,7 +659,7 @@ int user_session_delete(struct config_elements * config, const char * session_ui
                               "gus_session_hash",
                               session_uid_hash,
                             "limit", 1);
-        res = h_update(config->conn, j_query, NULL);
+        res = h_update(conn, j_query, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           ret = G_OK;
@@ -695,11 +676,11 @@ int user_session_delete(struct config_elements * config, const char * session_ui
       glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
       ret = G_ERROR_DB;
     }
-    o_free(session_uid_hash);
   } else {
-    y_log_message(Y_LOG_LEVEL_ERROR, "user_session_delete - Error generate_hash");
+    y_log_message(Y_LOG_LEVEL_ERROR, "user_session_delete - Error generate_hash_buffer");
     ret = G_ERROR;
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return ret;
 }
 
@@ -737,6 +718,7 @@ char * generate_session_id() {
 }
 
 json_t * get_user_session_list(struct config_elements * config, const char * username, const char * pattern, size_t offset, size_t limit, const char * sort) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query, * j_result, * j_return, * j_element;
   int res;
   size_t index, session_hash_url_len = 0;
@@ -750,8 +732,8 @@ json_t * get_user_session_list(struct config_elements * config, const char * use
                         "gus_session_hash",
                         "gus_user_agent AS user_agent",
                         "gus_issued_for AS issued_for",
-                        SWITCH_DB_TYPE(config->conn->type, "UNIX_TIMESTAMP(gus_expiration) AS expiration", "gus_expiration AS expiration", "EXTRACT(EPOCH FROM gus_expiration)::integer AS expiration"),
-                        SWITCH_DB_TYPE(config->conn->type, "UNIX_TIMESTAMP(gus_last_login) AS last_login", "gus_last_login AS last_login", "EXTRACT(EPOCH FROM gus_last_login)::integer AS last_login"),
+                        SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gus_expiration) AS expiration", "gus_expiration AS expiration", "EXTRACT(EPOCH FROM gus_expiration)::integer AS expiration"),
+                        SWITCH_DB_TYPE(conn->type, "UNIX_TIMESTAMP(gus_last_login) AS last_login", "gus_last_login AS last_login", "EXTRACT(EPOCH FROM gus_last_login)::integer AS last_login"),
                         "gus_enabled",
                       "where",
                         "gus_username",
@@ -766,13 +748,13 @@ json_t * get_user_session_list(struct config_elements * config, const char * use
     json_object_set_new(j_query, "order_by", json_string(sort));
   }
   if (pattern != NULL) {
-    pattern_escaped = h_escape_string_with_quotes(config->conn, pattern);
+    pattern_escaped = h_escape_string_with_quotes(conn, pattern);
     pattern_clause = msprintf("IN (SELECT gus_id FROM "GLEWLWYD_TABLE_USER_SESSION" WHERE gus_user_agent LIKE '%%'||%s||'%%' OR gus_issued_for LIKE '%%'||%s||'%%')", pattern_escaped, pattern_escaped);
     json_object_set_new(json_object_get(j_query, "where"), "gus_id", json_pack("{ssss}", "operator", "raw", "value", pattern_clause));
     o_free(pattern_clause);
     o_free(pattern_escaped);
   }
-  res = h_select(config->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     json_array_foreach(j_result, index, j_element) {
@@ -793,10 +775,12 @@ json_t * get_user_session_list(struct config_elements * config, const char * use
     glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return j_return;
 }
 
 int delete_user_session_from_hash(struct config_elements * config, const char * username, const char * session_hash) {
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
   json_t * j_query, * j_result, * j_element = NULL;
   int res, ret = G_OK;
   unsigned char session_hash_dec[128];
@@ -818,7 +802,7 @@ int delete_user_session_from_hash(struct config_elements * config, const char *
     }
   }
   if (ret == G_OK) {
-    res = h_select(config->conn, j_query, &j_result, NULL);
+    res = h_select(conn, j_query, &j_result, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       if (json_array_size(j_result)) {
@@ -831,7 +815,7 @@ int delete_user_session_from_hash(struct config_elements * config, const char *
                                 0,
                               "where",
                                 "gus_id", json_object_get(j_element, "gus_id"));
-          res = h_update(config->conn, j_query, NULL);
+          res = h_update(conn, j_query, NULL);
           json_decref(j_query);
           if (res != H_OK) {
             y_log_message(Y_LOG_LEVEL_ERROR, "delete_user_session_from_hash - Error executing j_query (2)");
@@ -849,6 +833,7 @@ int delete_user_session_from_hash(struct config_elements * config, const char *
       ret = G_ERROR_DB;
     }
   }
+  glewlwyd_db_pool_checkin(config, conn);
   return ret;
 }
 
@@ -4,7 +4,7 @@
  *
  * Copyright 2020-2022 Nicolas Mora <mail@babelouest.org>
  *
- * Version 20221024
+ * Version 20261018
  *
  * The MIT License (MIT)
  *
@@ -35,10 +35,13 @@
  * `redirect_on_404`: redirct uri on error 404, if NULL, send 404
  * `allow_gzip`: Set to true if you want to allow gzip compression (default true)
  * `allow_deflate`: Set to true if you want to allow deflate compression (default true)
- * `allow_cache_compressed`: set to true if you want to allow memory cache for compressed files (default true)
+ * `allow_brotli`: Set to true if you want to allow the precompressed brotli files (default true)
+ * `allow_cache_compressed`: set to true if you want to allow memory cache for files (default true)
+ *   the files of `files_path` are loaded and compressed once in an index, by `u_load_compressed_inmemory_website_files`
+ *   or at the first request, the files added after are read and compressed at each request
+ *   if a file has the siblings `<file>.gz` or `<file>.br`, they are sent as is and the file isn't compressed
  * `lock`: mutex lock (do not touch this variable)
- * `gzip_files`: a `struct _u_map` containing cached gzip files
- * `deflate_files`: a `struct _u_map` containing cached deflate files
+ * `file_index`: index of the cached files, immutable once loaded (do not touch this variable)
  *
  * example of mime-types used in Hutch:
  * {
@@ -92,19 +95,30 @@
 #include <limits.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
 #include <ulfius.h>
 
+#include "glewlwyd-common.h"
 #include "static_compressed_inmemory_website_callback.h"
 
-#define U_COMPRESS_NONE 0
-#define U_COMPRESS_GZIP 1
-#define U_COMPRESS_DEFL 2
+#define U_COMPRESS_NONE   0
+#define U_COMPRESS_GZIP   1
+#define U_COMPRESS_DEFL   2
+#define U_COMPRESS_BROTLI 3
 
 #define U_ACCEPT_HEADER  "Accept-Encoding"
 #define U_CONTENT_HEADER "Content-Encoding"
 
 #define U_ACCEPT_GZIP    "gzip"
 #define U_ACCEPT_DEFLATE "deflate"
+#define U_ACCEPT_BROTLI  "br"
+
+#define U_SUFFIX_GZIP    ".gz"
+#define U_SUFFIX_BROTLI  ".br"
 
 #define U_GZIP_WINDOW_BITS 15
 #define U_GZIP_ENCODING    16
@@ -133,6 +147,487 @@ static const char * get_filename_ext(const char *path) {
     return dot;
 }
 
+/**
+ * FNV-1a hash of the file name
+ */
+static uint64_t u_static_file_hash(const char * name) {
+  uint64_t hash = 14695981039346656037ULL;
+
+  for (; *name; name++) {
+    hash ^= (uint64_t)(unsigned char)*name;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/**
+ * Compress data in one pass using gzip or deflate format
+ */
+static int u_compress_data(const char * data, size_t length, int compress_mode, int level, char ** data_zip, size_t * data_zip_len) {
+  z_stream defstream;
+  int ret = U_OK, res;
+  uLong bound;
+
+  memset(&defstream, 0, sizeof(z_stream));
+  defstream.zalloc = u_zalloc;
+  defstream.zfree = u_zfree;
+  defstream.opaque = Z_NULL;
+  if (compress_mode == U_COMPRESS_GZIP) {
+    res = deflateInit2(&defstream, level, Z_DEFLATED, U_GZIP_WINDOW_BITS | U_GZIP_ENCODING, 8, Z_DEFAULT_STRATEGY);
+  } else {
+    res = deflateInit(&defstream, level);
+  }
+  if (res == Z_OK) {
+    bound = deflateBound(&defstream, (uLong)length);
+    if ((*data_zip = o_malloc((size_t)bound)) != NULL) {
+      defstream.avail_in = (uInt)length;
+      defstream.next_in = (Bytef *)data;
+      defstream.avail_out = (uInt)bound;
+      defstream.next_out = (Bytef *)*data_zip;
+      if ((res = deflate(&defstream, Z_FINISH)) == Z_STREAM_END) {
+        *data_zip_len = (size_t)defstream.total_out;
+      } else {
+        y_log_message(Y_LOG_LEVEL_ERROR, "u_compress_data - Error deflate %d", res);
+        o_free(*data_zip);
+        *data_zip = NULL;
+        ret = U_ERROR;
+      }
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "u_compress_data - Error allocating resources for data_zip");
+      ret = U_ERROR_MEMORY;
+    }
+    deflateEnd(&defstream);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "u_compress_data - Error deflateInit (%s)", compress_mode==U_COMPRESS_GZIP?"gzip":"deflate");
+    ret = U_ERROR;
+  }
+  return ret;
+}
+
+static const char * u_get_content_type(struct _u_compressed_inmemory_website_config * config, const char * file_requested) {
+  const char * content_type = u_map_get_case(&config->mime_types, get_filename_ext(file_requested));
+
+  if (content_type == NULL) {
+    content_type = u_map_get(&config->mime_types, "*");
+    y_log_message(Y_LOG_LEVEL_WARNING, "Static File Server - Unknown mime type for extension %s", get_filename_ext(file_requested));
+  }
+  return content_type;
+}
+
+static void u_free_static_file(struct _u_static_file * file) {
+  if (file != NULL) {
+    o_free(file->data);
+    o_free(file->name);
+    o_free(file->content_type);
+    o_free(file->etag);
+    o_free(file->etag_gzip);
+    o_free(file->etag_deflate);
+    o_free(file->etag_brotli);
+    o_free(file->last_modified);
+    o_free(file->gzip);
+    o_free(file->deflate);
+    o_free(file->brotli);
+    o_free(file);
+  }
+}
+
+static void u_free_static_file_index(struct _u_static_file_index * file_index) {
+  struct _u_static_file * file, * next;
+  size_t i;
+
+  if (file_index != NULL) {
+    for (i=0; i<file_index->nb_bucket; i++) {
+      for (file = file_index->bucket_list[i]; file != NULL; file = next) {
+        next = file->next;
+        u_free_static_file(file);
+      }
+    }
+    o_free(file_index->bucket_list);
+    o_free(file_index);
+  }
+}
+
+/**
+ * Reads the file in memory, the file must have the length given by stat
+ */
+static int u_read_static_file(const char * path, size_t length, char ** data) {
+  char * buffer;
+  size_t offset = 0;
+  ssize_t read_length = 1;
+  int fd, ret = U_OK;
+
+  if ((fd = open(path, O_RDONLY)) != -1) {
+    if ((buffer = o_malloc(length)) != NULL) {
+      while (offset < length && (read_length = read(fd, buffer+offset, length-offset)) > 0) {
+        offset += (size_t)read_length;
+      }
+      if (offset == length && read_length > 0) {
+        *data = buffer;
+      } else {
+        y_log_message(Y_LOG_LEVEL_ERROR, "u_read_static_file - Error read %s", path);
+        o_free(buffer);
+        ret = U_ERROR;
+      }
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "u_read_static_file - Error allocating resources for %s", path);
+      ret = U_ERROR_MEMORY;
+    }
+    close(fd);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "u_read_static_file - Error open %s", path);
+    ret = U_ERROR;
+  }
+  return ret;
+}
+
+/**
+ * Reads the precompressed sibling of the file, i.e. path with the suffix .gz or .br
+ * The sibling is ignored if it's older than the file
+ */
+static int u_read_static_file_sibling(const char * path, const char * suffix, const struct stat * st, char ** data, size_t * length) {
+  char * sibling_path = msprintf("%s%s", path, suffix);
+  struct stat st_sibling;
+  int ret = U_ERROR_NOT_FOUND;
+
+  if (sibling_path != NULL && !lstat(sibling_path, &st_sibling) && S_ISREG(st_sibling.st_mode) && st_sibling.st_size > 0) {
+    if (st_sibling.st_mtime >= st->st_mtime) {
+      *length = (size_t)st_sibling.st_size;
+      ret = u_read_static_file(sibling_path, *length, data);
+    } else {
+      y_log_message(Y_LOG_LEVEL_WARNING, "Static File Server - %s is older than %s, ignored", sibling_path, path);
+    }
+  }
+  o_free(sibling_path);
+  return ret;
+}
+
+/**
+ * Returns true if the file is the precompressed sibling of another file
+ */
+static int u_is_static_file_sibling(const char * path) {
+  size_t path_len = o_strlen(path);
+  char * base_path;
+  struct stat st;
+  int ret = 0;
+
+  if (path_len > o_strlen(U_SUFFIX_GZIP) && (0 == o_strcmp(path+path_len-o_strlen(U_SUFFIX_GZIP), U_SUFFIX_GZIP) || 0 == o_strcmp(path+path_len-o_strlen(U_SUFFIX_BROTLI), U_SUFFIX_BROTLI))) {
+    if ((base_path = o_strndup(path, path_len-o_strlen(U_SUFFIX_GZIP))) != NULL) {
+      ret = !lstat(base_path, &st) && S_ISREG(st.st_mode);
+      o_free(base_path);
+    }
+  }
+  return ret;
+}
+
+/**
+ * Reads the file in memory, builds its validators
+ * and its compressed variants if its mime-type is compressible
+ * The variants are the precompressed siblings .gz and .br if present,
+ * otherwise gzip and deflate variants are compressed once
+ */
+static struct _u_static_file * u_load_static_file(struct _u_compressed_inmemory_website_config * config, const char * path, const char * name, const struct stat * st) {
+  struct _u_static_file * file = NULL;
+  char last_modified[64] = {0};
+  struct tm tm_modified;
+  int res = U_OK, res_gzip, res_brotli;
+
+  if ((file = o_malloc(sizeof(struct _u_static_file))) != NULL) {
+    memset(file, 0, sizeof(struct _u_static_file));
+    file->name = o_strdup(name);
+    file->hash = u_static_file_hash(name);
+    file->content_type = o_strdup(u_get_content_type(config, name));
+    file->compress = string_array_has_value((const char **)config->mime_types_compressed, file->content_type);
+    file->length = (size_t)st->st_size;
+    file->mtime = st->st_mtime;
+    file->etag = msprintf("\"%llx-%zx\"", (unsigned long long)st->st_mtime, file->length);
+    file->etag_gzip = msprintf("\"%llx-%zx-gzip\"", (unsigned long long)st->st_mtime, file->length);
+    file->etag_deflate = msprintf("\"%llx-%zx-deflate\"", (unsigned long long)st->st_mtime, file->length);
+    file->etag_brotli = msprintf("\"%llx-%zx-br\"", (unsigned long long)st->st_mtime, file->length);
+    if (gmtime_r(&st->st_mtime, &tm_modified) != NULL && strftime(last_modified, sizeof(last_modified), "%a, %d %b %Y %H:%M:%S GMT", &tm_modified)) {
+      file->last_modified = o_strdup(last_modified);
+    }
+    if (file->length) {
+      res = u_read_static_file(path, file->length, &file->data);
+    }
+    if (res == U_OK && file->compress && file->length) {
+      res_gzip = config->allow_gzip?u_read_static_file_sibling(path, U_SUFFIX_GZIP, st, &file->gzip, &file->gzip_length):U_ERROR_NOT_FOUND;
+      res_brotli = config->allow_brotli?u_read_static_file_sibling(path, U_SUFFIX_BROTLI, st, &file->brotli, &file->brotli_length):U_ERROR_NOT_FOUND;
+      if (res_gzip != U_ERROR_NOT_FOUND || res_brotli != U_ERROR_NOT_FOUND) {
+        // Precompressed files are available, nothing is compressed at runtime
+        if (res_gzip != U_OK && res_gzip != U_ERROR_NOT_FOUND) {
+          res = res_gzip;
+        } else if (res_brotli != U_OK && res_brotli != U_ERROR_NOT_FOUND) {
+          res = res_brotli;
+        }
+      } else if (config->allow_gzip && u_compress_data(file->data, file->length, U_COMPRESS_GZIP, Z_BEST_COMPRESSION, &file->gzip, &file->gzip_length) != U_OK) {
+        y_log_message(Y_LOG_LEVEL_ERROR, "u_load_static_file - Error u_compress_data gzip %s", path);
+        res = U_ERROR;
+      } else if (config->allow_deflate && u_compress_data(file->data, file->length, U_COMPRESS_DEFL, Z_BEST_COMPRESSION, &file->deflate, &file->deflate_length) != U_OK) {
+        y_log_message(Y_LOG_LEVEL_ERROR, "u_load_static_file - Error u_compress_data deflate %s", path);
+        res = U_ERROR;
+      }
+    }
+    if (res != U_OK || file->name == NULL || file->content_type == NULL || file->etag == NULL || file->etag_gzip == NULL || file->etag_deflate == NULL || file->etag_brotli == NULL || file->last_modified == NULL) {
+      u_free_static_file(file);
+      file = NULL;
+    }
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "u_load_static_file - Error allocating resources for file");
+  }
+  return file;
+}
+
+/**
+ * Loads the regular files of the directory and its subdirectories in the list
+ * The symbolic links aren't followed, these files are served from the disk
+ */
+static int u_load_static_dir(struct _u_compressed_inmemory_website_config * config, const char * dir_path, const char * prefix, struct _u_static_file ** file_list, size_t * nb_file) {
+  DIR * dir;
+  struct dirent * entry;
+  struct stat st;
+  struct _u_static_file * file;
+  char * path, * name;
+  int ret = U_OK;
+
+  if ((dir = opendir(dir_path)) != NULL) {
+    while (ret == U_OK && (entry = readdir(dir)) != NULL) {
+      if (0 != o_strcmp(entry->d_name, ".") && 0 != o_strcmp(entry->d_name, "..")) {
+        path = msprintf("%s/%s", dir_path, entry->d_name);
+        name = o_strnullempty(prefix)?o_strdup(entry->d_name):msprintf("%s/%s", prefix, entry->d_name);
+        if (path != NULL && name != NULL) {
+          if (!lstat(path, &st)) {
+            if (S_ISDIR(st.st_mode)) {
+              ret = u_load_static_dir(config, path, name, file_list, nb_file);
+            } else if (S_ISREG(st.st_mode) && !u_is_static_file_sibling(path)) {
+              // If the file can't be loaded, it's served from the disk
+              if ((file = u_load_static_file(config, path, name, &st)) != NULL) {
+                file->next = *file_list;
+                *file_list = file;
+                (*nb_file)++;
+              }
+            }
+          }
+        } else {
+          y_log_message(Y_LOG_LEVEL_ERROR, "u_load_static_dir - Error allocating resources for path");
+          ret = U_ERROR_MEMORY;
+        }
+        o_free(path);
+        o_free(name);
+      }
+    }
+    closedir(dir);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "u_load_static_dir - Error opendir %s", dir_path);
+    ret = U_ERROR;
+  }
+  return ret;
+}
+
+/**
+ * Builds the index of all the files in config->files_path
+ * If the files can't be loaded, the index is empty
+ * and all the files are served from the disk
+ */
+static struct _u_static_file_index * u_build_static_file_index(struct _u_compressed_inmemory_website_config * config) {
+  struct _u_static_file_index * file_index;
+  struct _u_static_file * file_list = NULL, * file, * next;
+  size_t nb_file = 0, index;
+
+  if ((file_index = o_malloc(sizeof(struct _u_static_file_index))) != NULL) {
+    file_index->nb_bucket = 1;
+    file_index->bucket_list = NULL;
+    if (u_load_static_dir(config, config->files_path, "", &file_list, &nb_file) == U_OK) {
+      while (file_index->nb_bucket < 2*nb_file) {
+        file_index->nb_bucket <<= 1;
+      }
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "u_build_static_file_index - Error loading files, the files will be served from %s", config->files_path);
+      for (file = file_list; file != NULL; file = next) {
+        next = file->next;
+        u_free_static_file(file);
+      }
+      file_list = NULL;
+      nb_file = 0;
+    }
+    if ((file_index->bucket_list = o_malloc(file_index->nb_bucket*sizeof(struct _u_static_file *))) != NULL) {
+      memset(file_index->bucket_list, 0, file_index->nb_bucket*sizeof(struct _u_static_file *));
+      for (file = file_list; file != NULL; file = next) {
+        next = file->next;
+        index = (size_t)(file->hash & (file_index->nb_bucket-1));
+        file->next = file_index->bucket_list[index];
+        file_index->bucket_list[index] = file;
+      }
+      y_log_message(Y_LOG_LEVEL_DEBUG, "Static File Server - %zu files loaded from %s", nb_file, config->files_path);
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "u_build_static_file_index - Error allocating resources for bucket_list");
+      for (file = file_list; file != NULL; file = next) {
+        next = file->next;
+        u_free_static_file(file);
+      }
+      o_free(file_index);
+      file_index = NULL;
+    }
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "u_build_static_file_index - Error allocating resources for file_index");
+  }
+  return file_index;
+}
+
+/**
+ * Returns the file index, loads it if it's not loaded yet
+ * Only one thread loads the index, the others wait for it
+ */
+static struct _u_static_file_index * u_get_static_file_index(struct _u_compressed_inmemory_website_config * config) {
+  struct _u_static_file_index * file_index = __atomic_load_n(&config->file_index, __ATOMIC_ACQUIRE);
+
+  if (file_index == NULL && config->allow_cache_compressed && config->files_path != NULL) {
+    if (!pthread_mutex_lock(&config->lock)) {
+      if ((file_index = __atomic_load_n(&config->file_index, __ATOMIC_ACQUIRE)) == NULL) {
+        file_index = u_build_static_file_index(config);
+        __atomic_store_n(&config->file_index, file_index, __ATOMIC_RELEASE);
+      }
+      pthread_mutex_unlock(&config->lock);
+    } else {
+      y_log_message(Y_LOG_LEVEL_ERROR, "u_get_static_file_index - Error pthread_lock_mutex");
+    }
+  }
+  return file_index;
+}
+
+static struct _u_static_file * u_find_static_file(struct _u_static_file_index * file_index, const char * name) {
+  struct _u_static_file * file = NULL;
+  uint64_t hash;
+
+  if (file_index != NULL) {
+    hash = u_static_file_hash(name);
+    for (file = file_index->bucket_list[hash & (file_index->nb_bucket-1)]; file != NULL; file = file->next) {
+      if (file->hash == hash && 0 == o_strcmp(file->name, name)) {
+        break;
+      }
+    }
+  }
+  return file;
+}
+
+/**
+ * Returns true if the file on the disk is still the file of the index
+ * The files updated or removed since they were loaded are served from the disk
+ */
+static int u_is_static_file_current(struct _u_compressed_inmemory_website_config * config, struct _u_static_file * file) {
+  char * path = msprintf("%s/%s", config->files_path, file->name);
+  struct stat st;
+  int ret = 0;
+
+  if (path != NULL && !lstat(path, &st) && S_ISREG(st.st_mode) && (size_t)st.st_size == file->length && st.st_mtime == file->mtime) {
+    ret = 1;
+  }
+  o_free(path);
+  return ret;
+}
+
+/**
+ * Returns true if one of the etags of If-None-Match matches the etag of the representation sent
+ * Each compressed variant has its own etag, so a 304 is sent only for the variant the client has
+ */
+static int u_is_etag_matching(const char * if_none_match, const char * etag) {
+  char ** etag_list = NULL, * element;
+  size_t i;
+  int ret = 0;
+
+  if (split_string(if_none_match, ",", &etag_list)) {
+    for (i=0; etag_list[i]!=NULL && !ret; i++) {
+      element = trimwhitespace(etag_list[i]);
+      if (0 == o_strncmp(element, "W/", 2)) {
+        element += 2;
+      }
+      if (0 == o_strcmp(element, "*") || 0 == o_strcmp(element, etag)) {
+        ret = 1;
+      }
+    }
+  }
+  free_string_array(etag_list);
+  return ret;
+}
+
+/**
+ * Streaming callback function to send a file loaded in memory
+ */
+static ssize_t callback_static_file_inmemory_stream(void * cls, uint64_t pos, char * buf, size_t max) {
+  struct _u_static_file * file = (struct _u_static_file *)cls;
+
+  if (pos < file->length) {
+    if (max > file->length - pos) {
+      max = (size_t)(file->length - pos);
+    }
+    memcpy(buf, file->data + pos, max);
+    return (ssize_t)max;
+  } else {
+    return (ssize_t)U_STREAM_END;
+  }
+}
+
+/**
+ * Sends a file of the index, or 304 if the client has the current version
+ */
+static int callback_static_file_indexed(const struct _u_request * request, struct _u_response * response, struct _u_compressed_inmemory_website_config * config, struct _u_static_file * file, int accept_brotli, int accept_gzip, int accept_deflate) {
+  int ret = U_CALLBACK_CONTINUE, compress_mode = U_COMPRESS_NONE;
+  const char * etag;
+
+  // A compressed variant is sent only if it's smaller than the file
+  if (accept_brotli && file->brotli != NULL && file->brotli_length < file->length) {
+    compress_mode = U_COMPRESS_BROTLI;
+  } else if (accept_gzip && file->gzip != NULL && file->gzip_length < file->length) {
+    compress_mode = U_COMPRESS_GZIP;
+  } else if (accept_deflate && file->deflate != NULL && file->deflate_length < file->length) {
+    compress_mode = U_COMPRESS_DEFL;
+  }
+
+  u_map_put(response->map_header, "Content-Type", file->content_type);
+  u_map_copy_into(response->map_header, &config->map_header);
+  u_map_put(response->map_header, "Last-Modified", file->last_modified);
+  // The clients must check the file with its validators before using their copy
+  if (!u_map_has_key_case(response->map_header, "Cache-Control")) {
+    u_map_put(response->map_header, "Cache-Control", "no-cache");
+  }
+  if (file->compress) {
+    u_map_put(response->map_header, "Vary", U_ACCEPT_HEADER);
+  }
+  if (compress_mode == U_COMPRESS_BROTLI) {
+    etag = file->etag_brotli;
+  } else if (compress_mode == U_COMPRESS_GZIP) {
+    etag = file->etag_gzip;
+  } else if (compress_mode == U_COMPRESS_DEFL) {
+    etag = file->etag_deflate;
+  } else {
+    etag = file->etag;
+  }
+  u_map_put(response->map_header, "ETag", etag);
+
+  // If-Modified-Since is ignored if If-None-Match is present
+  if (u_map_has_key_case(request->map_header, "If-None-Match")?
+      u_is_etag_matching(u_map_get_case(request->map_header, "If-None-Match"), etag):
+      0 == o_strcmp(u_map_get_case(request->map_header, "If-Modified-Since"), file->last_modified)) {
+    ulfius_set_empty_body_response(response, 304);
+  } else if (compress_mode == U_COMPRESS_BROTLI) {
+    ulfius_set_binary_body_response(response, 200, file->brotli, file->brotli_length);
+    u_map_put(response->map_header, U_CONTENT_HEADER, U_ACCEPT_BROTLI);
+  } else if (compress_mode == U_COMPRESS_GZIP) {
+    ulfius_set_binary_body_response(response, 200, file->gzip, file->gzip_length);
+    u_map_put(response->map_header, U_CONTENT_HEADER, U_ACCEPT_GZIP);
+  } else if (compress_mode == U_COMPRESS_DEFL) {
+    ulfius_set_binary_body_response(response, 200, file->deflate, file->deflate_length);
+    u_map_put(response->map_header, U_CONTENT_HEADER, U_ACCEPT_DEFLATE);
+  } else if (file->length) {
+    if (ulfius_set_stream_response(response, 200, callback_static_file_inmemory_stream, NULL, file->length, CHUNK, file) != U_OK) {
+      y_log_message(Y_LOG_LEVEL_ERROR, "Static File Server - Error ulfius_set_stream_response");
+      ret = U_CALLBACK_ERROR;
+    }
+  } else {
+    ulfius_set_empty_body_response(response, 200);
+  }
+  return ret;
+}
+
 /**
  * Streaming callback function to ease sending large files
  */
@@ -195,11 +690,7 @@ static int callback_static_file_uncompressed (const struct _u_request * request,
         length = (size_t)ftell (f);
         fseek (f, 0, SEEK_SET);
 
-        content_type = u_map_get_case(&((struct _u_compressed_inmemory_website_config *)user_data)->mime_types, get_filename_ext(file_requested));
-        if (content_type == NULL) {
-          content_type = u_map_get(&((struct _u_compressed_inmemory_website_config *)user_data)->mime_types, "*");
-          y_log_message(Y_LOG_LEVEL_WARNING, "Static File Server - Unknown mime type for extension %s", get_filename_ext(file_requested));
-        }
+        content_type = u_get_content_type((struct _u_compressed_inmemory_website_config *)user_data, file_requested);
         u_map_put(response->map_header, "Content-Type", content_type);
         u_map_copy_into(response->map_header, &((struct _u_compressed_inmemory_website_config *)user_data)->map_header);
 
@@ -243,17 +734,15 @@ int u_init_compressed_inmemory_website_config(struct _u_compressed_inmemory_webs
     config->redirect_on_404            = NULL;
     config->allow_gzip                 = 1;
     config->allow_deflate              = 1;
+    config->allow_brotli               = 1;
     config->mime_types_compressed      = NULL;
     config->mime_types_compressed_size = 0;
     config->allow_cache_compressed     = 1;
+    config->file_index                 = NULL;
     if ((ret = u_map_init(&(config->mime_types))) != U_OK) {
       y_log_message(Y_LOG_LEVEL_ERROR, "u_init_compressed_inmemory_website_config - Error u_map_init mime_types");
     } else if ((ret = u_map_init(&(config->map_header))) != U_OK) {
       y_log_message(Y_LOG_LEVEL_ERROR, "u_init_compressed_inmemory_website_config - Error u_map_init map_header");
-    } else if ((ret = u_map_init(&(config->gzip_files))) != U_OK) {
-      y_log_message(Y_LOG_LEVEL_ERROR, "u_init_compressed_inmemory_website_config - Error u_map_init gzip_files");
-    } else if ((ret = u_map_init(&(config->deflate_files))) != U_OK) {
-      y_log_message(Y_LOG_LEVEL_ERROR, "u_init_compressed_inmemory_website_config - Error u_map_init deflate_files");
     } else {
       pthread_mutexattr_init (&mutexattr);
       pthread_mutexattr_settype(&mutexattr, PTHREAD_MUTEX_RECURSIVE);
@@ -270,8 +759,8 @@ void u_clean_compressed_inmemory_website_config(struct _u_compressed_inmemory_we
   if (config != NULL) {
     u_map_clean(&(config->mime_types));
     u_map_clean(&(config->map_header));
-    u_map_clean(&(config->gzip_files));
-    u_map_clean(&(config->deflate_files));
+    u_free_static_file_index(config->file_index);
+    config->file_index = NULL;
     free_string_array(config->mime_types_compressed);
     pthread_mutex_destroy(&(config->lock));
   }
@@ -295,11 +784,22 @@ int u_add_mime_types_compressed(struct _u_compressed_inmemory_website_config * c
   return ret;
 }
 
+int u_load_compressed_inmemory_website_files(struct _u_compressed_inmemory_website_config * config) {
+  int ret;
+
+  if (config != NULL && config->files_path != NULL && config->allow_cache_compressed) {
+    ret = u_get_static_file_index(config)!=NULL?U_OK:U_ERROR;
+  } else {
+    ret = U_ERROR_PARAMS;
+  }
+  return ret;
+}
+
 int callback_static_compressed_inmemory_website (const struct _u_request * request, struct _u_response * response, void * user_data) {
   struct _u_compressed_inmemory_website_config * config = (struct _u_compressed_inmemory_website_config *)user_data;
+  struct _u_static_file * file;
   char ** accept_list = NULL;
-  int ret = U_CALLBACK_CONTINUE, compress_mode = U_COMPRESS_NONE, res;
-  z_stream defstream;
+  int ret = U_CALLBACK_CONTINUE, compress_mode = U_COMPRESS_NONE, accept_brotli = 0, accept_gzip = 0, accept_deflate = 0;
   unsigned char * file_content, * file_content_orig = NULL;
   size_t length, read_length, offset, data_zip_len = 0;
   FILE * f;
@@ -335,162 +835,77 @@ int callback_static_compressed_inmemory_website (const struct _u_request * reque
 
     if (!u_map_has_key_case(response->map_header, U_CONTENT_HEADER)) {
       if (split_string(u_map_get_case(request->map_header, U_ACCEPT_HEADER), ",", &accept_list)) {
-        if (config->allow_gzip && string_array_has_trimmed_value((const char **)accept_list, U_ACCEPT_GZIP)) {
+        accept_brotli = config->allow_brotli && accept_list_has_coding(accept_list, U_ACCEPT_BROTLI);
+        accept_gzip = config->allow_gzip && accept_list_has_coding(accept_list, U_ACCEPT_GZIP);
+        accept_deflate = config->allow_deflate && accept_list_has_coding(accept_list, U_ACCEPT_DEFLATE);
+        if (accept_gzip) {
           compress_mode = U_COMPRESS_GZIP;
-        } else if (config->allow_deflate && string_array_has_trimmed_value((const char **)accept_list, U_ACCEPT_DEFLATE)) {
+        } else if (accept_deflate) {
           compress_mode = U_COMPRESS_DEFL;
         }
-
-        if (compress_mode != U_COMPRESS_NONE) {
-          if (compress_mode == U_COMPRESS_GZIP && config->allow_cache_compressed && u_map_has_key(&config->gzip_files, file_requested)) {
-            ulfius_set_binary_body_response(response, 200, u_map_get(&config->gzip_files, file_requested), (size_t)u_map_get_length(&config->gzip_files, file_requested));
-            u_map_put(response->map_header, U_CONTENT_HEADER, U_ACCEPT_GZIP);
-
-            content_type = u_map_get_case(&config->mime_types, get_filename_ext(file_requested));
-            if (content_type == NULL) {
-              content_type = u_map_get(&config->mime_types, "*");
-            }
-            u_map_put(response->map_header, "Content-Type", content_type);
-            u_map_copy_into(response->map_header, &config->map_header);
-          } else if (compress_mode == U_COMPRESS_DEFL && config->allow_cache_compressed && u_map_has_key(&config->deflate_files, file_requested)) {
-            ulfius_set_binary_body_response(response, 200, u_map_get(&config->deflate_files, file_requested), (size_t)u_map_get_length(&config->deflate_files, file_requested));
-            u_map_put(response->map_header, U_CONTENT_HEADER, U_ACCEPT_DEFLATE);
-
-            content_type = u_map_get_case(&config->mime_types, get_filename_ext(file_requested));
-            if (content_type == NULL) {
-              content_type = u_map_get(&config->mime_types, "*");
-            }
-            u_map_put(response->map_header, "Content-Type", content_type);
-            u_map_copy_into(response->map_header, &config->map_header);
-          } else {
-            file_path = msprintf("%s/%s", ((struct _u_compressed_inmemory_website_config *)user_data)->files_path, file_requested);
-            real_path = realpath(file_path, NULL);
-            if (0 == o_strncmp(((struct _u_compressed_inmemory_website_config *)user_data)->files_path, real_path, o_strlen(((struct _u_compressed_inmemory_website_config *)user_data)->files_path))) {
-              if (!pthread_mutex_lock(&config->lock)) {
-                f = fopen (file_path, "rb");
-                if (f) {
-                  content_type = u_map_get_case(&config->mime_types, get_filename_ext(file_requested));
-                  if (content_type == NULL) {
-                    content_type = u_map_get(&config->mime_types, "*");
-                    y_log_message(Y_LOG_LEVEL_WARNING, "Static File Server - Unknown mime type for extension %s", get_filename_ext(file_requested));
+      }
+      free_string_array(accept_list);
+
+      if ((file = u_find_static_file(u_get_static_file_index(config), file_requested)) != NULL && u_is_static_file_current(config, file)) {
+        ret = callback_static_file_indexed(request, response, config, file, accept_brotli, accept_gzip, accept_deflate);
+      } else if (compress_mode != U_COMPRESS_NONE) {
+        // The file isn't in the index, it's read and compressed from the disk
+        file_path = msprintf("%s/%s", config->files_path, file_requested);
+        real_path = realpath(file_path, NULL);
+        if (0 == o_strncmp(config->files_path, real_path, o_strlen(config->files_path))) {
+          f = fopen (file_path, "rb");
+          if (f) {
+            content_type = u_get_content_type(config, file_requested);
+            if (!string_array_has_value((const char **)config->mime_types_compressed, content_type)) {
+              ret = callback_static_file_uncompressed(request, response, user_data);
+            } else {
+              u_map_put(response->map_header, "Content-Type", content_type);
+              u_map_copy_into(response->map_header, &config->map_header);
+
+              fseek (f, 0, SEEK_END);
+              offset = length = (size_t)ftell (f);
+              fseek (f, 0, SEEK_SET);
+
+              if (length) {
+                if ((file_content_orig = file_content = o_malloc(length)) != NULL) {
+                  while ((read_length = fread(file_content, sizeof(char), offset, f))) {
+                    file_content += read_length;
+                    offset -= read_length;
                   }
-                  if (!string_array_has_value((const char **)config->mime_types_compressed, content_type)) {
-                    ret = callback_static_file_uncompressed(request, response, user_data);
+                  if (u_compress_data((const char *)file_content_orig, length, compress_mode, Z_BEST_COMPRESSION, &data_zip, &data_zip_len) == U_OK) {
+                    ulfius_set_binary_body_response(response, 200, data_zip, data_zip_len);
+                    u_map_put(response->map_header, U_CONTENT_HEADER, compress_mode==U_COMPRESS_GZIP?U_ACCEPT_GZIP:U_ACCEPT_DEFLATE);
+                    o_free(data_zip);
                   } else {
-                    u_map_put(response->map_header, "Content-Type", content_type);
-                    u_map_copy_into(response->map_header, &config->map_header);
-
-                    fseek (f, 0, SEEK_END);
-                    offset = length = (size_t)ftell (f);
-                    fseek (f, 0, SEEK_SET);
-
-                    if (length) {
-                      if ((file_content_orig = file_content = o_malloc(length)) != NULL && (data_zip = o_malloc((2*length)+20)) != NULL) {
-                        defstream.zalloc = u_zalloc;
-                        defstream.zfree = u_zfree;
-                        defstream.opaque = Z_NULL;
-                        defstream.avail_in = (uInt)length;
-                        defstream.next_in = (Bytef *)file_content;
-                        while ((read_length = fread(file_content, sizeof(char), offset, f))) {
-                          file_content += read_length;
-                          offset -= read_length;
-                        }
-
-                        if (compress_mode == U_COMPRESS_GZIP) {
-                          if (deflateInit2(&defstream,
-                                           Z_DEFAULT_COMPRESSION,
-                                           Z_DEFLATED,
-                                           U_GZIP_WINDOW_BITS | U_GZIP_ENCODING,
-                                           8,
-                                           Z_DEFAULT_STRATEGY) != Z_OK) {
-                            y_log_message(Y_LOG_LEVEL_ERROR, "callback_static_compressed_inmemory_website - Error deflateInit (gzip)");
-                            ret = U_CALLBACK_ERROR;
-                          }
-                        } else {
-                          if (deflateInit(&defstream, Z_BEST_COMPRESSION) != Z_OK) {
-                            y_log_message(Y_LOG_LEVEL_ERROR, "callback_static_compressed_inmemory_website - Error deflateInit (deflate)");
-                            ret = U_CALLBACK_ERROR;
-                          }
-                        }
-                        if (ret == U_CALLBACK_CONTINUE) {
-                          do {
-                            if ((data_zip = o_realloc(data_zip, data_zip_len+_U_W_BLOCK_SIZE)) != NULL) {
-                              defstream.avail_out = _U_W_BLOCK_SIZE;
-                              defstream.next_out = ((Bytef *)data_zip)+data_zip_len;
-                              switch ((res = deflate(&defstream, Z_FINISH))) {
-                                case Z_OK:
-                                case Z_STREAM_END:
-                                case Z_BUF_ERROR:
-                                  break;
-                                default:
-                                  y_log_message(Y_LOG_LEVEL_ERROR, "callback_static_compressed_inmemory_website - Error deflate %d", res);
-                                  ret = U_CALLBACK_ERROR;
-                                  break;
-                              }
-                              data_zip_len += _U_W_BLOCK_SIZE - defstream.avail_out;
-                            } else {
-                              y_log_message(Y_LOG_LEVEL_ERROR, "callback_static_compressed_inmemory_website - Error allocating resources for data_zip");
-                              ret = U_CALLBACK_ERROR;
-                            }
-                          } while (U_CALLBACK_CONTINUE == ret && defstream.avail_out == 0);
-
-                          if (ret == U_CALLBACK_CONTINUE) {
-                            if (compress_mode == U_COMPRESS_GZIP) {
-                              if (config->allow_cache_compressed) {
-                                u_map_put_binary(&config->gzip_files, file_requested, data_zip, 0, defstream.total_out);
-                                ulfius_set_binary_body_response(response, 200, u_map_get(&config->gzip_files, file_requested), (size_t)u_map_get_length(&config->gzip_files, file_requested));
-                              } else {
-                                ulfius_set_binary_body_response(response, 200, data_zip, defstream.total_out);
-                              }
-                            } else {
-                              if (config->allow_cache_compressed) {
-                                u_map_put_binary(&config->deflate_files, file_requested, data_zip, 0, defstream.total_out);
-                                ulfius_set_binary_body_response(response, 200, u_map_get(&config->deflate_files, file_requested), (size_t)u_map_get_length(&config->deflate_files, file_requested));
-                              } else {
-                                ulfius_set_binary_body_response(response, 200, data_zip, defstream.total_out);
-                              }
-                            }
-                            u_map_put(response->map_header, U_CONTENT_HEADER, compress_mode==U_COMPRESS_GZIP?U_ACCEPT_GZIP:U_ACCEPT_DEFLATE);
-                          }
-                        }
-                        deflateEnd(&defstream);
-                        o_free(data_zip);
-                      } else {
-                        y_log_message(Y_LOG_LEVEL_ERROR, "callback_static_compressed_inmemory_website - Error allocating resource for file_content or data_zip");
-                        ret = U_CALLBACK_ERROR;
-                      }
-                      o_free(file_content_orig);
-                    }
-                    fclose(f);
+                    y_log_message(Y_LOG_LEVEL_ERROR, "callback_static_compressed_inmemory_website - Error u_compress_data");
+                    ret = U_CALLBACK_ERROR;
                   }
                 } else {
-                  if (((struct _u_compressed_inmemory_website_config *)user_data)->redirect_on_404 == NULL) {
-                    ret = U_CALLBACK_IGNORE;
-                  } else {
-                    ulfius_add_header_to_response(response, "Location", ((struct _u_compressed_inmemory_website_config *)user_data)->redirect_on_404);
-                    response->status = 302;
-                  }
+                  y_log_message(Y_LOG_LEVEL_ERROR, "callback_static_compressed_inmemory_website - Error allocating resource for file_content");
+                  ret = U_CALLBACK_ERROR;
                 }
-                pthread_mutex_unlock(&config->lock);
-              } else {
-                y_log_message(Y_LOG_LEVEL_ERROR, "callback_static_compressed_inmemory_website - Error pthread_lock_mutex");
-                ret = U_CALLBACK_ERROR;
+                o_free(file_content_orig);
               }
+            }
+            fclose(f);
+          } else {
+            if (config->redirect_on_404 == NULL) {
+              ret = U_CALLBACK_IGNORE;
             } else {
-              if (((struct _u_compressed_inmemory_website_config *)user_data)->redirect_on_404 == NULL) {
-                ret = U_CALLBACK_IGNORE;
-              } else {
-                ulfius_add_header_to_response(response, "Location", ((struct _u_compressed_inmemory_website_config *)user_data)->redirect_on_404);
-                response->status = 302;
-              }
+              ulfius_add_header_to_response(response, "Location", config->redirect_on_404);
+              response->status = 302;
             }
-            o_free(file_path);
-            free(real_path); // realpath uses malloc
           }
         } else {
-          ret = callback_static_file_uncompressed(request, response, user_data);
+          if (config->redirect_on_404 == NULL) {
+            ret = U_CALLBACK_IGNORE;
+          } else {
+            ulfius_add_header_to_response(response, "Location", config->redirect_on_404);
+            response->status = 302;
+          }
         }
-        free_string_array(accept_list);
+        o_free(file_path);
+        free(real_path); // realpath uses malloc
       } else {
         ret = callback_static_file_uncompressed(request, response, user_data);
       }
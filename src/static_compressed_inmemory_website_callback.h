@@ -4,7 +4,7 @@
  *
  * Copyright 2020-2022 Nicolas Mora <mail@babelouest.org>
  *
- * Version 20221024
+ * Version 20261018
  * 
  * The MIT License (MIT)
  * 
@@ -35,10 +35,13 @@
  * `redirect_on_404`: redirct uri on error 404, if NULL, send 404
  * `allow_gzip`: Set to true if you want to allow gzip compression (default true)
  * `allow_deflate`: Set to true if you want to allow deflate compression (default true)
- * `allow_cache_compressed`: set to true if you want to allow memory cache for compressed files (default true)
+ * `allow_brotli`: Set to true if you want to allow the precompressed brotli files (default true)
+ * `allow_cache_compressed`: set to true if you want to allow memory cache for files (default true)
+ *   the files of `files_path` are loaded and compressed once in an index, by `u_load_compressed_inmemory_website_files`
+ *   or at the first request, the files added after are read and compressed at each request
+ *   if a file has the siblings `<file>.gz` or `<file>.br`, they are sent as is and the file isn't compressed
  * `lock`: mutex lock (do not touch this variable)
- * `gzip_files`: a `struct _u_map` containing cached gzip files
- * `deflate_files`: a `struct _u_map` containing cached deflate files
+ * `file_index`: index of the cached files, immutable once loaded (do not touch this variable)
  * 
  * example of mime-types used in Hutch:
  * {
@@ -91,7 +94,39 @@
 #ifndef _U_STATIC_COMPRESSED_INMEMORY_WEBSITE
 #define _U_STATIC_COMPRESSED_INMEMORY_WEBSITE
 
-#define _U_W_BLOCK_SIZE 256
+/**
+ * File cached in the index, with its validators and its compressed variants
+ * data and the variants are copied in memory, mtime and length detect the file updates on the disk
+ */
+struct _u_static_file {
+  char                  * name;
+  uint64_t                hash;
+  char                  * content_type;
+  int                     compress;
+  char                  * etag;
+  char                  * etag_gzip;
+  char                  * etag_deflate;
+  char                  * etag_brotli;
+  char                  * last_modified;
+  char                  * data;
+  size_t                  length;
+  time_t                  mtime;
+  char                  * gzip;
+  size_t                  gzip_length;
+  char                  * deflate;
+  size_t                  deflate_length;
+  char                  * brotli;
+  size_t                  brotli_length;
+  struct _u_static_file * next;
+};
+
+/**
+ * Hashed index of the cached files, never modified once published
+ */
+struct _u_static_file_index {
+  size_t                   nb_bucket;
+  struct _u_static_file ** bucket_list;
+};
 
 struct _u_compressed_inmemory_website_config {
   char          * files_path;
@@ -103,10 +138,10 @@ struct _u_compressed_inmemory_website_config {
   char          * redirect_on_404;
   int             allow_gzip;
   int             allow_deflate;
+  int             allow_brotli;
   int             allow_cache_compressed;
   pthread_mutex_t lock;
-  struct _u_map   gzip_files;
-  struct _u_map   deflate_files;
+  struct _u_static_file_index * file_index;
 };
 
 int u_init_compressed_inmemory_website_config(struct _u_compressed_inmemory_website_config * config);
@@ -115,6 +150,13 @@ void u_clean_compressed_inmemory_website_config(struct _u_compressed_inmemory_we
 
 int u_add_mime_types_compressed(struct _u_compressed_inmemory_website_config * config, const char * mime_type);
 
+/**
+ * Loads and compresses all the files of config->files_path in the file index
+ * Must be called after files_path, mime_types and mime_types_compressed are set
+ * If not called, the index is loaded at the first request
+ */
+int u_load_compressed_inmemory_website_files(struct _u_compressed_inmemory_website_config * config);
+
 int callback_static_compressed_inmemory_website (const struct _u_request * request, struct _u_response * response, void * user_data);
 
 #endif
@@ -28,10 +28,6 @@
 
 static void send_mail_on_registration(struct config_elements * config, const char * username, const char * scheme, const char * ip_address) {
   struct send_mail_content_struct * send_mail;
-  pthread_t thread_mail_connexion;
-  int thread_ret, thread_detach;
-  pthread_attr_t attr;
-  struct sched_param param;
   json_t * j_misc_config = get_misc_config(config, GLEWLWYD_MAIL_ON_CONNEXION_TYPE, NULL), * j_user;
   char * body, * ip_data = NULL, * ip_address_parsed = o_strdup(ip_address);
   const char * lang, * body_pattern;
@@ -66,23 +62,8 @@ static void send_mail_on_registration(struct config_elements * config, const cha
         send_mail->subject = o_strdup(get_template_property(json_object_get(json_object_get(j_misc_config, "misc_config"), "value"), "templatesRegisterScheme", lang, "subject"));
         send_mail->body = o_strdup(body);
         y_log_message(Y_LOG_LEVEL_WARNING, "Security - New connexion - Notification sent to username %s, e-mail %s at IP Address %s", username, send_mail->email, ip_address);
-        pthread_attr_init (&attr);
-        pthread_attr_getschedparam (&attr, &param);
-        param.sched_priority = 0;
-        pthread_attr_setschedparam (&attr, &param);
-        thread_ret = pthread_create(&thread_mail_connexion, &attr, thread_send_mail, (void *)send_mail);
-        thread_detach = pthread_detach(thread_mail_connexion);
-        if (thread_ret || thread_detach) {
-          y_log_message(Y_LOG_LEVEL_ERROR, "send_mail_on_new_connexion - Error thread");
-          o_free(send_mail->host);
-          o_free(send_mail->user);
-          o_free(send_mail->password);
-          o_free(send_mail->from);
-          o_free(send_mail->content_type);
-          o_free(send_mail->email);
-          o_free(send_mail->subject);
-          o_free(send_mail->body);
-          o_free(send_mail);
+        if (glewlwyd_job_queue_submit(config, GLEWLWYD_JOB_TYPE_MAIL, NULL, NULL, &run_send_mail, &free_send_mail, send_mail) != G_OK) {
+          y_log_message(Y_LOG_LEVEL_ERROR, "send_mail_on_new_connexion - Error glewlwyd_job_queue_submit");
         }
       } else {
         y_log_message(Y_LOG_LEVEL_ERROR, "send_mail_on_new_connexion - Error allocating resources for send_mail");
@@ -97,10 +78,6 @@ static void send_mail_on_registration(struct config_elements * config, const cha
 
 static void send_mail_on_update_password(struct config_elements * config, const char * username, const char * ip_address) {
   struct send_mail_content_struct * send_mail;
-  pthread_t thread_mail_connexion;
-  int thread_ret, thread_detach;
-  pthread_attr_t attr;
-  struct sched_param param;
   json_t * j_misc_config = get_misc_config(config, GLEWLWYD_MAIL_ON_CONNEXION_TYPE, NULL), * j_user;
   char * body, * ip_data = NULL, * ip_address_parsed = o_strdup(ip_address);
   const char * lang, * body_pattern;
@@ -135,23 +112,8 @@ static void send_mail_on_update_password(struct config_elements * config, const
         send_mail->subject = o_strdup(get_template_property(json_object_get(json_object_get(j_misc_config, "misc_config"), "value"), "templatesUpdatePassword", lang, "subject"));
         send_mail->body = o_strdup(body);
         y_log_message(Y_LOG_LEVEL_WARNING, "Security - New connexion - Notification sent to username %s, e-mail %s at IP Address %s", username, send_mail->email, ip_address);
-        pthread_attr_init (&attr);
-        pthread_attr_getschedparam (&attr, &param);
-        param.sched_priority = 0;
-        pthread_attr_setschedparam (&attr, &param);
-        thread_ret = pthread_create(&thread_mail_connexion, &attr, thread_send_mail, (void *)send_mail);
-        thread_detach = pthread_detach(thread_mail_connexion);
-        if (thread_ret || thread_detach) {
-          y_log_message(Y_LOG_LEVEL_ERROR, "send_mail_on_new_connexion - Error thread");
-          o_free(send_mail->host);
-          o_free(send_mail->user);
-          o_free(send_mail->password);
-          o_free(send_mail->from);
-          o_free(send_mail->content_type);
-          o_free(send_mail->email);
-          o_free(send_mail->subject);
-          o_free(send_mail->body);
-          o_free(send_mail);
+        if (glewlwyd_job_queue_submit(config, GLEWLWYD_JOB_TYPE_MAIL, NULL, NULL, &run_send_mail, &free_send_mail, send_mail) != G_OK) {
+          y_log_message(Y_LOG_LEVEL_ERROR, "send_mail_on_new_connexion - Error glewlwyd_job_queue_submit");
         }
       } else {
         y_log_message(Y_LOG_LEVEL_ERROR, "send_mail_on_new_connexion - Error allocating resources for send_mail");
@@ -164,10 +126,67 @@ static void send_mail_on_update_password(struct config_elements * config, const
   json_decref(j_misc_config);
 }
 
+/**
+ * The user cache stores the result of get_user and get_user_profile
+ * when the user is looked up among all the user backends
+ * generation is set before the lookup, so a user read from the backends during
+ * an update isn't stored in the cache after the update has invalidated it
+ */
+static json_t * get_user_cache(struct config_elements * config, const char * prefix, const char * username, size_t * generation) {
+  json_t * j_return = NULL;
+  char * key;
+
+  *generation = 0;
+  if (!o_strnullempty(username) && (key = msprintf("%s:%s", prefix, username)) != NULL) {
+    *generation = glewlwyd_cache_get_generation(&config->user_cache, key);
+    j_return = glewlwyd_cache_get(&config->user_cache, key);
+    o_free(key);
+  }
+  return j_return;
+}
+
+static void set_user_cache(struct config_elements * config, const char * prefix, const char * username, json_t * j_value, size_t generation) {
+  char * key;
+
+  if (!o_strnullempty(username) && (key = msprintf("%s:%s", prefix, username)) != NULL) {
+    glewlwyd_cache_set_if_generation(&config->user_cache, key, j_value, 0, generation);
+    o_free(key);
+  }
+}
+
+static void invalidate_user_cache(struct config_elements * config, const char * username) {
+  char * key;
+
+  if (!o_strnullempty(username)) {
+    if ((key = msprintf("user:%s", username)) != NULL) {
+      glewlwyd_cache_remove(&config->user_cache, key);
+      o_free(key);
+    }
+    if ((key = msprintf("profile:%s", username)) != NULL) {
+      glewlwyd_cache_remove(&config->user_cache, key);
+      o_free(key);
+    }
+  }
+}
+
+struct _user_password_check {
+  struct config_elements      * config;
+  struct _user_module_instance * user_module;
+  const char                  * username;
+  const char                  * password;
+};
+
+static int user_module_check_password_task(void * data) {
+  struct _user_password_check * check = (struct _user_password_check *)data;
+
+  return check->user_module->module->user_module_check_password(check->config->config_m, check->username, check->password, check->user_module->cls);
+}
+
 json_t * auth_check_user_credentials(struct config_elements * config, const char * username, const char * password) {
   int res;
   json_t * j_return = NULL, * j_module_list = get_user_module_list(config), * j_module, * j_user;
   struct _user_module_instance * user_module;
+  struct _user_password_check check = {config, NULL, username, password};
   size_t index;
   
   if (check_result_value(j_module_list, G_OK)) {
@@ -178,11 +197,14 @@ json_t * auth_check_user_credentials(struct config_elements * config, const char
           if (user_module->enabled) {
             j_user = user_module->module->user_module_get(config->config_m, username, user_module->cls);
             if (check_result_value(j_user, G_OK) && json_object_get(json_object_get(j_user, "user"), "enabled") == json_true()) {
-              res = user_module->module->user_module_check_password(config->config_m, username, password, user_module->cls);
+              check.user_module = user_module;
+              res = glewlwyd_password_pool_check(config, &user_module_check_password_task, &check);
               if (res == G_OK) {
                 j_return = json_pack("{si}", "result", G_OK);
               } else if (res == G_ERROR_UNAUTHORIZED) {
                 j_return = json_pack("{si}", "result", G_ERROR_UNAUTHORIZED);
+              } else if (res == G_ERROR_UNAVAILABLE) {
+                j_return = json_pack("{si}", "result", G_ERROR_UNAVAILABLE);
               } else if (res != G_ERROR_NOT_FOUND) {
                 y_log_message(Y_LOG_LEVEL_ERROR, "auth_check_user_credentials - Error, user_module_check_password for module '%s', skip", user_module->name);
               }
@@ -443,7 +465,7 @@ json_t * get_user(struct config_elements * config, const char * username, const
   json_t * j_return = NULL, * j_user, * j_module_list, * j_module;
   struct _user_module_instance * user_module;
   struct _user_middleware_module_instance * user_middleware_module;
-  size_t index, i;
+  size_t index, i, generation;
   
   if (o_strnullempty(username)) {
     j_return = json_pack("{si}", "result", G_ERROR_PARAM);
@@ -480,7 +502,7 @@ json_t * get_user(struct config_elements * config, const char * username, const
     } else {
       j_return = json_pack("{si}", "result", G_ERROR_NOT_FOUND);
     }
-  } else {
+  } else if ((j_return = get_user_cache(config, "user", username, &generation)) == NULL) {
     j_module_list = get_user_module_list(config);
     if (check_result_value(j_module_list, G_OK)) {
       json_array_foreach(json_object_get(j_module_list, "module"), index, j_module) {
@@ -524,6 +546,9 @@ json_t * get_user(struct config_elements * config, const char * username, const
       j_return = json_pack("{si}", "result", G_ERROR_NOT_FOUND);
     }
     json_decref(j_module_list);
+    if (check_result_value(j_return, G_OK)) {
+      set_user_cache(config, "user", username, j_return, generation);
+    }
   }
   if (j_return == NULL) {
     j_return = json_pack("{si}", "result", G_ERROR_NOT_FOUND);
@@ -536,7 +561,7 @@ json_t * get_user_profile(struct config_elements * config, const char * username
   json_t * j_return = NULL, * j_module_list, * j_module, * j_profile;
   struct _user_module_instance * user_module;
   struct _user_middleware_module_instance * user_middleware_module;
-  size_t index, i;
+  size_t index, i, generation;
   
   if (source != NULL) {
     user_module = get_user_module_instance(config, source);
@@ -570,7 +595,7 @@ json_t * get_user_profile(struct config_elements * config, const char * username
     } else {
       j_return = json_pack("{si}", "result", G_ERROR_NOT_FOUND);
     }
-  } else {
+  } else if ((j_return = get_user_cache(config, "profile", username, &generation)) == NULL) {
     j_module_list = get_user_module_list(config);
     if (check_result_value(j_module_list, G_OK)) {
       json_array_foreach(json_object_get(j_module_list, "module"), index, j_module) {
@@ -611,6 +636,9 @@ json_t * get_user_profile(struct config_elements * config, const char * username
       j_return = json_pack("{si}", "result", G_ERROR);
     }
     json_decref(j_module_list);
+    if (check_result_value(j_return, G_OK)) {
+      set_user_cache(config, "profile", username, j_return, generation);
+    }
   }
   if (j_return == NULL) {
     j_return = json_pack("{si}", "result", G_ERROR_NOT_FOUND);
@@ -868,6 +896,7 @@ int add_user(struct config_elements * config, json_t * j_user, const char * sour
       ret = G_ERROR_NOT_FOUND;
     }
   }
+  invalidate_user_cache(config, json_string_value(json_object_get(j_user, "username")));
   return ret;
 }
 
@@ -918,6 +947,7 @@ int set_user(struct config_elements * config, const char * username, json_t * j_
   } else {
     ret = G_ERROR_PARAM;
   }
+  invalidate_user_cache(config, username);
   return ret;
 }
 
@@ -995,6 +1025,7 @@ int delete_user(struct config_elements * config, const char * username, const ch
   } else {
     ret = G_ERROR_PARAM;
   }
+  invalidate_user_cache(config, username);
   return ret;
 }
 
@@ -1048,6 +1079,7 @@ json_t * user_set_profile(struct config_elements * config, const char * username
     j_return = json_pack("{si}", "result", G_ERROR);
   }
   json_decref(j_user);
+  invalidate_user_cache(config, username);
   return j_return;
 }
 
@@ -1113,6 +1145,7 @@ int user_delete_profile(struct config_elements * config, const char * username)
     ret = G_ERROR;
   }
   json_decref(j_user);
+  invalidate_user_cache(config, username);
   return ret;
 }
 
@@ -1146,6 +1179,7 @@ int user_update_password(struct config_elements * config, const char * username,
     ret = G_ERROR;
   }
   json_decref(j_user);
+  invalidate_user_cache(config, username);
   return ret;
 }
 
@@ -1171,6 +1205,7 @@ int user_set_password(struct config_elements * config, const char * username, co
     ret = G_ERROR;
   }
   json_decref(j_user);
+  invalidate_user_cache(config, username);
   return ret;
 }
 
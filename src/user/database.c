@@ -26,6 +26,7 @@
  */
 
 #include <string.h>
+#include <unistd.h>
 #include <jansson.h>
 #include <yder.h>
 #include <orcania.h>
@@ -39,6 +40,7 @@
 #define G_TABLE_USER_PASSWORD "g_user_password"
 
 #define G_PBKDF2_ITERATOR_SEP ','
+#define G_PBKDF2_CHECK_MAX_THREADS 8
 
 struct mod_parameters {
   int                    use_glewlwyd_connection;
@@ -50,6 +52,24 @@ struct mod_parameters {
   struct config_module * config_glewlwyd;
 };
 
+/**
+ * Checkout a connection from the glewlwyd database pool,
+ * or return the module connection if the module uses its own database
+ */
+static struct _h_connection * database_conn_checkout(struct mod_parameters * param) {
+  if (!param->use_glewlwyd_connection) {
+    return param->config_glewlwyd->glewlwyd_module_callback_db_checkout(param->config_glewlwyd);
+  } else {
+    return param->conn;
+  }
+}
+
+static void database_conn_checkin(struct mod_parameters * param, struct _h_connection * conn) {
+  if (!param->use_glewlwyd_connection) {
+    param->config_glewlwyd->glewlwyd_module_callback_db_checkin(param->config_glewlwyd, conn);
+  }
+}
+
 static json_t * is_user_database_parameters_valid(json_t * j_params) {
   json_t * j_return, * j_error = json_array(), * j_element = NULL;
   const char * field = NULL;
@@ -135,16 +155,19 @@ static json_t * is_user_database_parameters_valid(json_t * j_params) {
 }
 
 static char * get_pattern_clause(struct mod_parameters * param, const char * pattern) {
-  char * escape_pattern = h_escape_string_with_quotes(param->conn, pattern), * clause = NULL;
+  struct _h_connection * conn = database_conn_checkout(param);
+  char * escape_pattern = h_escape_string_with_quotes(conn, pattern), * clause = NULL;
   
   if (escape_pattern != NULL) {
     clause = msprintf("IN (SELECT gu_id from " G_TABLE_USER " WHERE gu_username LIKE '%%'||%s||'%%' OR gu_name LIKE '%%'||%s||'%%' OR gu_email LIKE '%%'||%s||'%%')", escape_pattern, escape_pattern, escape_pattern);
   }
   o_free(escape_pattern);
+  database_conn_checkin(param, conn);
   return clause;
 }
 
 static json_int_t get_user_nb_passwords(struct mod_parameters * param, json_int_t gu_id) {
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query, * j_result = NULL;
   int res;
   json_int_t result = 0;
@@ -157,7 +180,7 @@ static json_int_t get_user_nb_passwords(struct mod_parameters * param, json_int_
                       "where",
                         "gu_id",
                         gu_id);
-  res = h_select(param->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result)) {
@@ -167,15 +190,17 @@ static json_int_t get_user_nb_passwords(struct mod_parameters * param, json_int_
   } else {
     y_log_message(Y_LOG_LEVEL_ERROR, "get_user_nb_passwords database - Error executing j_query");
   }
+  database_conn_checkin(param, conn);
   return result;
 }
 
 static int append_user_properties(struct mod_parameters * param, json_t * j_user, int profile) {
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query, * j_result, * j_element = NULL, * j_param_config;
   int res, ret;
   size_t index = 0;
   
-  if (param->conn->type == HOEL_DB_TYPE_MARIADB) {
+  if (conn->type == HOEL_DB_TYPE_MARIADB) {
     j_query = json_pack("{sss[ssss]s{sO}}",
                         "table",
                         G_TABLE_USER_PROPERTY,
@@ -187,7 +212,7 @@ static int append_user_properties(struct mod_parameters * param, json_t * j_user
                         "where",
                           "gu_id",
                           json_object_get(j_user, "gu_id"));
-    res = h_select(param->conn, j_query, &j_result, NULL);
+    res = h_select(conn, j_query, &j_result, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       json_array_foreach(j_result, index, j_element) {
@@ -249,7 +274,7 @@ static int append_user_properties(struct mod_parameters * param, json_t * j_user
                         "where",
                           "gu_id",
                           json_object_get(j_user, "gu_id"));
-    res = h_select(param->conn, j_query, &j_result, NULL);
+    res = h_select(conn, j_query, &j_result, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       json_array_foreach(j_result, index, j_element) {
@@ -284,10 +309,12 @@ static int append_user_properties(struct mod_parameters * param, json_t * j_user
       ret = G_ERROR_DB;
     }
   }
+  database_conn_checkin(param, conn);
   return ret;
 }
 
 static json_t * database_user_scope_get(struct mod_parameters * param, json_int_t gu_id) {
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query, * j_result, * j_return, * j_array, * j_scope = NULL;
   int res;
   size_t index = 0;
@@ -307,7 +334,7 @@ static json_t * database_user_scope_get(struct mod_parameters * param, json_int_
                       "order_by",
                       "gus_id");
   o_free(scope_clause);
-  res = h_select(param->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     j_array = json_array();
@@ -327,16 +354,18 @@ static json_t * database_user_scope_get(struct mod_parameters * param, json_int_
     param->config_glewlwyd->glewlwyd_module_callback_metrics_increment_counter(param->config_glewlwyd, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  database_conn_checkin(param, conn);
   return j_return;
 }
 
 static json_t * database_user_get(const char * username, void * cls, int profile) {
   struct mod_parameters * param = (struct mod_parameters *)cls;
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query, * j_result, * j_scope, * j_return;
   int res;
   char * username_escaped, * username_clause;
   
-  username_escaped = h_escape_string_with_quotes(param->conn, username);
+  username_escaped = h_escape_string_with_quotes(conn, username);
   username_clause = msprintf(" = UPPER(%s)", username_escaped);
   j_query = json_pack("{sss[sssss]s{s{ssss}}}",
                       "table",
@@ -355,7 +384,7 @@ static json_t * database_user_get(const char * username, void * cls, int profile
                           username_clause);
   o_free(username_clause);
   o_free(username_escaped);
-  res = h_select(param->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result) == 1) {
@@ -386,30 +415,32 @@ static json_t * database_user_get(const char * username, void * cls, int profile
     param->config_glewlwyd->glewlwyd_module_callback_metrics_increment_counter(param->config_glewlwyd, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  database_conn_checkin(param, conn);
   return j_return;
 }
 
 static char * get_password_clause_write(struct mod_parameters * param, const char * password) {
+  struct _h_connection * conn = database_conn_checkout(param);
   char * clause = NULL, * password_encoded, digest[1024] = {0};
   
   if (o_strnullempty(password)) {
     clause = o_strdup("''");
-  } else if (param->conn->type == HOEL_DB_TYPE_SQLITE) {
+  } else if (conn->type == HOEL_DB_TYPE_SQLITE) {
     if (generate_digest_pbkdf2(password, param->PBKDF2_iterations, NULL, digest)) {
       clause = msprintf("'%s%c%u'", digest, G_PBKDF2_ITERATOR_SEP, param->PBKDF2_iterations);
     } else {
       y_log_message(Y_LOG_LEVEL_ERROR, "get_password_clause_write database - Error generate_digest_pbkdf2");
     }
-  } else if (param->conn->type == HOEL_DB_TYPE_MARIADB) {
-    password_encoded = h_escape_string_with_quotes(param->conn, password);
+  } else if (conn->type == HOEL_DB_TYPE_MARIADB) {
+    password_encoded = h_escape_string_with_quotes(conn, password);
     if (password_encoded != NULL) {
       clause = msprintf("PASSWORD(%s)", password_encoded);
       o_free(password_encoded);
     } else {
       y_log_message(Y_LOG_LEVEL_ERROR, "get_password_clause_write database - Error h_escape_string_with_quotes (mariadb)");
     }
-  } else if (param->conn->type == HOEL_DB_TYPE_PGSQL) {
-    password_encoded = h_escape_string_with_quotes(param->conn, password);
+  } else if (conn->type == HOEL_DB_TYPE_PGSQL) {
+    password_encoded = h_escape_string_with_quotes(conn, password);
     if (password_encoded != NULL) {
       clause = msprintf("crypt(%s, gen_salt('bf'))", password_encoded);
       o_free(password_encoded);
@@ -417,10 +448,12 @@ static char * get_password_clause_write(struct mod_parameters * param, const cha
       y_log_message(Y_LOG_LEVEL_ERROR, "get_password_clause_write database - Error h_escape_string_with_quotes (postgre)");
     }
   }
+  database_conn_checkin(param, conn);
   return clause;
 }
 
 static int update_password_list(struct mod_parameters * param, json_int_t gu_id, const char ** new_passwords, size_t new_passwords_len, int add) {
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query, * j_result;
   int res, ret;
   size_t i;
@@ -437,7 +470,7 @@ static int update_password_list(struct mod_parameters * param, json_int_t gu_id,
       o_free(clause_password);
     }
     if (json_array_size(json_object_get(j_query, "values"))) {
-      res = h_insert(param->conn, j_query, NULL);
+      res = h_insert(conn, j_query, NULL);
     } else {
       res = H_OK;
     }
@@ -456,7 +489,7 @@ static int update_password_list(struct mod_parameters * param, json_int_t gu_id,
                           "guw_password",
                         "where",
                           "gu_id", gu_id);
-    res = h_select(param->conn, j_query, &j_result, NULL);
+    res = h_select(conn, j_query, &j_result, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       j_query = json_pack("{sss{sI}}",
@@ -464,7 +497,7 @@ static int update_password_list(struct mod_parameters * param, json_int_t gu_id,
                           G_TABLE_USER_PASSWORD,
                           "where",
                             "gu_id", gu_id);
-      res = h_delete(param->conn, j_query, NULL);
+      res = h_delete(conn, j_query, NULL);
       json_decref(j_query);
       if (res == H_OK) {
         j_query = json_pack("{sss[]}",
@@ -481,7 +514,7 @@ static int update_password_list(struct mod_parameters * param, json_int_t gu_id,
           }
         }
         if (json_array_size(json_object_get(j_query, "values"))) {
-          res = h_insert(param->conn, j_query, NULL);
+          res = h_insert(conn, j_query, NULL);
         } else {
           res = H_OK;
         }
@@ -505,122 +538,209 @@ static int update_password_list(struct mod_parameters * param, json_int_t gu_id,
       ret = G_ERROR_DB;
     }
   }
+  database_conn_checkin(param, conn);
   return ret;
 }
 
-static char ** get_salt_from_password_hash(struct mod_parameters * param, const char * username, json_t * j_iterations) {
-  json_t * j_query, * j_result, * j_element = 0;
-  int res;
-  unsigned char password_b64_decoded[1024] = {0};
-  char * salt = NULL, * username_escaped, * username_clause, ** salt_list = NULL, * str_iterator;
-  size_t password_b64_decoded_len = 0, index = 0, gc_password_len;
-  
-  if (j_iterations != NULL) {
-    username_escaped = h_escape_string_with_quotes(param->conn, username);
-    username_clause = msprintf("IN (SELECT gu_id FROM "G_TABLE_USER" WHERE UPPER(gu_username) = UPPER(%s))", username_escaped);  
-    j_query = json_pack("{sss[s]s{s{ssss}}}",
-                        "table",
-                        G_TABLE_USER_PASSWORD,
-                        "columns",
-                          "guw_password",
-                        "where",
-                          "gu_id",
-                            "operator",
-                            "raw",
-                            "value",
-                            username_clause);
-    o_free(username_clause);
-    o_free(username_escaped);
-    res = h_select(param->conn, j_query, &j_result, NULL);
-    json_decref(j_query);
-    if (res == H_OK) {
-      if (json_array_size(j_result)) {
-        if ((salt_list = o_malloc((json_array_size(j_result)+1)*sizeof(char *))) != NULL) {
-          json_array_foreach(j_result, index, j_element) {
-            if ((str_iterator = o_strchr(json_string_value(json_object_get(j_element, "guw_password")), G_PBKDF2_ITERATOR_SEP)) != NULL) {
-              gc_password_len = (size_t)(o_strchr(json_string_value(json_object_get(j_element, "guw_password")), G_PBKDF2_ITERATOR_SEP) - json_string_value(json_object_get(j_element, "guw_password")));
-              json_array_append_new(j_iterations, json_integer(strtol(str_iterator+1, NULL, 10)));
-            } else {
-              gc_password_len = json_string_length(json_object_get(j_element, "guw_password"));
-              json_array_append_new(j_iterations, json_integer(0));
-            }
-            if (!json_string_null_or_empty(json_object_get(j_element, "guw_password")) && o_base64_decode((const unsigned char *)json_string_value(json_object_get(j_element, "guw_password")), gc_password_len, password_b64_decoded, &password_b64_decoded_len)) {
-              password_b64_decoded[password_b64_decoded_len] = '\0';
-              if ((salt = o_strdup((const char *)password_b64_decoded + password_b64_decoded_len - GLEWLWYD_DEFAULT_SALT_LENGTH)) != NULL) {
-                salt_list[index] = salt;
-              } else {
-                y_log_message(Y_LOG_LEVEL_ERROR, "get_salt_from_password_hash - Error extracting salt");
-              }
-            } else {
-              y_log_message(Y_LOG_LEVEL_ERROR, "get_salt_from_password_hash - Error o_base64_decode");
-            }
-          }
-          salt_list[json_array_size(j_result)] = NULL;
-        } else {
-          y_log_message(Y_LOG_LEVEL_ERROR, "get_salt_from_password_hash - Error allocatig resources for salt_list (1)");
+/**
+ * Extracts the salt and the iterations of a PBKDF2 hash, the hash format is
+ * base64(digest + salt)[,iterations], 1000 iterations if not specified
+ */
+static int get_password_hash_pbkdf2_params(const char * hash, char * salt, unsigned int * iterations, size_t * hash_len) {
+  unsigned char hash_b64_decoded[1024] = {0};
+  const char * str_iterator = o_strchr(hash, G_PBKDF2_ITERATOR_SEP);
+  size_t hash_b64_decoded_len = 0;
+  int ret = 0;
+
+  *hash_len = str_iterator!=NULL?(size_t)(str_iterator - hash):o_strlen(hash);
+  *iterations = str_iterator!=NULL?(unsigned int)strtoul(str_iterator+1, NULL, 10):0;
+  if (!*iterations) {
+    *iterations = 1000;
+  }
+  if (*hash_len && *hash_len < sizeof(hash_b64_decoded) && o_base64_decode((const unsigned char *)hash, *hash_len, hash_b64_decoded, &hash_b64_decoded_len) && hash_b64_decoded_len > GLEWLWYD_DEFAULT_SALT_LENGTH) {
+    memcpy(salt, hash_b64_decoded + hash_b64_decoded_len - GLEWLWYD_DEFAULT_SALT_LENGTH, GLEWLWYD_DEFAULT_SALT_LENGTH);
+    ret = 1;
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "get_password_hash_pbkdf2_params database - Error o_base64_decode");
+  }
+  return ret;
+}
+
+/**
+ * Compares the digest with the first hash_len characters of hash in constant time
+ */
+static int is_password_digest_equal(const char * digest, const char * hash, size_t hash_len) {
+  unsigned char diff = 0;
+  size_t i;
+  int ret = 0;
+
+  if (o_strlen(digest) == hash_len) {
+    for (i=0; i<hash_len; i++) {
+      diff |= (unsigned char)(digest[i] ^ hash[i]);
+    }
+    ret = !diff;
+  }
+  return ret;
+}
+
+/**
+ * Password hashes of a user shared by the threads checking them
+ * nb_found is the number of hashes matching the password, the check stops at 2
+ */
+struct _password_check {
+  const char      * password;
+  json_t          * j_hash_list;
+  size_t            lanes;
+  size_t            next;
+  size_t            nb_found;
+  pthread_mutex_t   lock;
+};
+
+/**
+ * Checks the next lanes hashes of the list with one generate_digest_pbkdf2_multi call,
+ * until the list is done or more than one match is found
+ */
+static void * check_password_pbkdf2_thread(void * args) {
+  struct _password_check * check = (struct _password_check *)args;
+  const char * data_list[GLEWLWYD_PBKDF2_MAX_LANES], * salt_ptr_list[GLEWLWYD_PBKDF2_MAX_LANES], * hash_list[GLEWLWYD_PBKDF2_MAX_LANES];
+  char salt_list[GLEWLWYD_PBKDF2_MAX_LANES][GLEWLWYD_DEFAULT_SALT_LENGTH + 1], digest_list[GLEWLWYD_PBKDF2_MAX_LANES][128], * digest_ptr_list[GLEWLWYD_PBKDF2_MAX_LANES];
+  unsigned int iterations_list[GLEWLWYD_PBKDF2_MAX_LANES];
+  size_t index, end, hash_len_list[GLEWLWYD_PBKDF2_MAX_LANES], nb, i, nb_found;
+
+  pthread_mutex_lock(&check->lock);
+  while (check->nb_found < 2 && check->next < json_array_size(check->j_hash_list)) {
+    index = check->next;
+    end = index + check->lanes;
+    if (end > json_array_size(check->j_hash_list)) {
+      end = json_array_size(check->j_hash_list);
+    }
+    check->next = end;
+    pthread_mutex_unlock(&check->lock);
+    nb = 0;
+    for (; index<end; index++) {
+      hash_list[nb] = json_string_value(json_object_get(json_array_get(check->j_hash_list, index), "guw_password"));
+      memset(salt_list[nb], 0, GLEWLWYD_DEFAULT_SALT_LENGTH + 1);
+      if (get_password_hash_pbkdf2_params(hash_list[nb], salt_list[nb], &iterations_list[nb], &hash_len_list[nb])) {
+        data_list[nb] = check->password;
+        salt_ptr_list[nb] = salt_list[nb];
+        digest_list[nb][0] = '\0';
+        digest_ptr_list[nb] = digest_list[nb];
+        nb++;
+      }
+    }
+    nb_found = 0;
+    if (nb) {
+      if (generate_digest_pbkdf2_multi(nb, data_list, iterations_list, salt_ptr_list, digest_ptr_list)) {
+        for (i=0; i<nb; i++) {
+          nb_found += (size_t)is_password_digest_equal(digest_list[i], hash_list[i], hash_len_list[i]);
         }
       } else {
-        if ((salt_list = o_malloc(sizeof(char *))) != NULL) {
-          salt_list[0] = NULL;
-        } else {
-          y_log_message(Y_LOG_LEVEL_ERROR, "get_salt_from_password_hash - Error allocatig resources for salt_list (2)");
-        }
+        y_log_message(Y_LOG_LEVEL_ERROR, "check_password_pbkdf2_thread database - Error generate_digest_pbkdf2_multi");
       }
-      json_decref(j_result);
-    } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "get_salt_from_password_hash - Error executing j_query");
     }
-  } else {
-    y_log_message(Y_LOG_LEVEL_ERROR, "get_salt_from_password_hash - Error j_iterations is NULL");
+    pthread_mutex_lock(&check->lock);
+    check->nb_found += nb_found;
   }
-  return salt_list;
+  pthread_mutex_unlock(&check->lock);
+  return NULL;
 }
 
-static char * get_password_clause_check(struct mod_parameters * param, const char * username, const char * password) {
-  char * clause = NULL, * password_encoded, digest[1024] = {0}, ** salt_list, * username_escaped = h_escape_string_with_quotes(param->conn, username);
-  size_t i;
-  json_t * j_iterations = json_array();
-  unsigned int iterations;
-  
-  if (param->conn->type == HOEL_DB_TYPE_SQLITE) {
-    if ((salt_list = get_salt_from_password_hash(param, username, j_iterations)) != NULL) {
-      clause = o_strdup("IN (");
-      for (i=0; salt_list[i]!=NULL; i++) {
-        iterations = (unsigned int)json_integer_value(json_array_get(j_iterations, i));
-        if (generate_digest_pbkdf2(password, iterations?iterations:1000, salt_list[i], digest)) {
-          if (!i) {
-            if (iterations) {
-              clause = mstrcatf(clause, "'%s%c%u'", digest, G_PBKDF2_ITERATOR_SEP, iterations);
-            } else {
-              clause = mstrcatf(clause, "'%s'", digest);
-            }
-          } else {
-            if (iterations) {
-              clause = mstrcatf(clause, ",'%s%c%u'", digest, G_PBKDF2_ITERATOR_SEP, iterations);
-            } else {
-              clause = mstrcatf(clause, ",'%s'", digest);
-            }
+/**
+ * Checks the password against the PBKDF2 hashes of the user in memory,
+ * the hashes are checked in parallel when the user has multiple passwords:
+ * by the multi-buffer PBKDF2 lanes if there are at least generate_digest_pbkdf2_multi_min() hashes,
+ * then by threads if there are more hashes than lanes and if the password pool has idle workers to lend
+ * As with the database checks, the password is valid only if exactly one hash matches it
+ */
+static int check_password_pbkdf2(struct mod_parameters * param, struct _h_connection * conn, const char * username, const char * password) {
+  json_t * j_query, * j_result;
+  int res, ret;
+  char * username_escaped, * username_clause;
+  struct _password_check check;
+  pthread_t thread_list[G_PBKDF2_CHECK_MAX_THREADS];
+  size_t nb_thread = 0, nb_helper = 0, nb_started = 0, i;
+  long nb_cpu;
+
+  username_escaped = h_escape_string_with_quotes(conn, username);
+  username_clause = msprintf("IN (SELECT gu_id FROM "G_TABLE_USER" WHERE UPPER(gu_username) = UPPER(%s))", username_escaped);
+  j_query = json_pack("{sss[s]s{s{ssss}}}",
+                      "table",
+                      G_TABLE_USER_PASSWORD,
+                      "columns",
+                        "guw_password",
+                      "where",
+                        "gu_id",
+                          "operator",
+                          "raw",
+                          "value",
+                          username_clause);
+  o_free(username_clause);
+  o_free(username_escaped);
+  res = h_select(conn, j_query, &j_result, NULL);
+  json_decref(j_query);
+  if (res == H_OK) {
+    check.password = password;
+    check.j_hash_list = j_result;
+    check.lanes = generate_digest_pbkdf2_lanes();
+    if (json_array_size(j_result) < generate_digest_pbkdf2_multi_min()) {
+      // Too few hashes for the multi-buffer lanes, the threads check one hash at a time
+      check.lanes = 1;
+    }
+    check.next = 0;
+    check.nb_found = 0;
+    if (!pthread_mutex_init(&check.lock, NULL)) {
+      if (json_array_size(j_result) > check.lanes && (nb_cpu = sysconf(_SC_NPROCESSORS_ONLN)) > 1) {
+        nb_thread = (json_array_size(j_result) + check.lanes - 1) / check.lanes;
+        if (nb_thread > (size_t)nb_cpu) {
+          nb_thread = (size_t)nb_cpu;
+        }
+        if (nb_thread > G_PBKDF2_CHECK_MAX_THREADS) {
+          nb_thread = G_PBKDF2_CHECK_MAX_THREADS;
+        }
+        // The current thread checks hashes too, the helper threads are counted in the password pool
+        nb_helper = param->config_glewlwyd->glewlwyd_module_callback_password_pool_reserve_helper(param->config_glewlwyd, nb_thread-1);
+        for (i=0; i<nb_helper; i++) {
+          if (pthread_create(&thread_list[nb_started], NULL, check_password_pbkdf2_thread, &check)) {
+            y_log_message(Y_LOG_LEVEL_WARNING, "check_password_pbkdf2 database - Error pthread_create, continue with %zu threads", nb_started+1);
+            break;
           }
-          digest[0] = '\0';
-        } else {
-          y_log_message(Y_LOG_LEVEL_ERROR, "get_password_clause_check database - Error generate_digest_pbkdf2");
+          nb_started++;
         }
       }
-      clause = mstrcatf(clause, ")");
+      check_password_pbkdf2_thread(&check);
+      for (i=0; i<nb_started; i++) {
+        pthread_join(thread_list[i], NULL);
+      }
+      param->config_glewlwyd->glewlwyd_module_callback_password_pool_release_helper(param->config_glewlwyd, nb_helper);
+      pthread_mutex_destroy(&check.lock);
+      ret = check.nb_found==1?G_OK:G_ERROR_UNAUTHORIZED;
     } else {
-      y_log_message(Y_LOG_LEVEL_ERROR, "get_password_clause_check database - Error get_salt_from_password_hash");
+      y_log_message(Y_LOG_LEVEL_ERROR, "check_password_pbkdf2 database - Error pthread_mutex_init");
+      ret = G_ERROR;
     }
-    free_string_array(salt_list);
-  } else if (param->conn->type == HOEL_DB_TYPE_MARIADB) {
-    password_encoded = h_escape_string_with_quotes(param->conn, password);
+    json_decref(j_result);
+  } else {
+    y_log_message(Y_LOG_LEVEL_ERROR, "check_password_pbkdf2 database - Error executing j_query");
+    param->config_glewlwyd->glewlwyd_module_callback_metrics_increment_counter(param->config_glewlwyd, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+    ret = G_ERROR_DB;
+  }
+  return ret;
+}
+
+static char * get_password_clause_check(struct mod_parameters * param, const char * password) {
+  struct _h_connection * conn = database_conn_checkout(param);
+  char * clause = NULL, * password_encoded;
+  
+  if (conn->type == HOEL_DB_TYPE_MARIADB) {
+    password_encoded = h_escape_string_with_quotes(conn, password);
     if (password_encoded != NULL) {
       clause = msprintf("= PASSWORD(%s)", password_encoded);
       o_free(password_encoded);
     } else {
       y_log_message(Y_LOG_LEVEL_ERROR, "get_password_clause_check database - Error h_escape_string_with_quotes (mariadb)");
     }
-  } else if (param->conn->type == HOEL_DB_TYPE_PGSQL) {
-    password_encoded = h_escape_string_with_quotes(param->conn, password);
+  } else if (conn->type == HOEL_DB_TYPE_PGSQL) {
+    password_encoded = h_escape_string_with_quotes(conn, password);
     if (password_encoded != NULL) {
       clause = msprintf("= crypt(%s, guw_password)", password_encoded);
       o_free(password_encoded);
@@ -628,8 +748,7 @@ static char * get_password_clause_check(struct mod_parameters * param, const cha
       y_log_message(Y_LOG_LEVEL_ERROR, "get_password_clause_check database - Error h_escape_string_with_quotes (postgre)");
     }
   }
-  o_free(username_escaped);
-  json_decref(j_iterations);
+  database_conn_checkin(param, conn);
   return clause;
 }
 
@@ -651,6 +770,7 @@ static json_t * get_property_value_db(struct mod_parameters * param, const char
 }
 
 static int save_user_properties(struct mod_parameters * param, json_t * j_user, json_int_t gu_id, int profile) {
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_property = NULL, * j_query, * j_array = json_array(), * j_format, * j_property_value = NULL;
   const char * name = NULL;
   int ret, res;
@@ -675,13 +795,13 @@ static int save_user_properties(struct mod_parameters * param, json_t * j_user,
     }
     // Delete old values
     j_query = json_pack("{sss{sI}}", "table", G_TABLE_USER_PROPERTY, "where", "gu_id", gu_id);
-    res = h_delete(param->conn, j_query, NULL);
+    res = h_delete(conn, j_query, NULL);
     json_decref(j_query);
     if (res == H_OK) {
       // Add new values
       if (json_array_size(j_array)) {
         j_query = json_pack("{sssO}", "table", G_TABLE_USER_PROPERTY, "values", j_array);
-        res = h_insert(param->conn, j_query, NULL);
+        res = h_insert(conn, j_query, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           ret = G_OK;
@@ -703,17 +823,19 @@ static int save_user_properties(struct mod_parameters * param, json_t * j_user,
     y_log_message(Y_LOG_LEVEL_ERROR, "insert_user_properties database - Error allocating resources for j_array");
     ret = G_ERROR_MEMORY;
   }
+  database_conn_checkin(param, conn);
   return ret;
 }
 
 static int save_user_scope(struct mod_parameters * param, json_t * j_scope, json_int_t gu_id) {
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query, * j_result, * j_element = NULL, * j_new_scope_id;
   int res, ret;
   char * scope_clause;
   size_t index = 0;
   
   j_query = json_pack("{sss{sI}}", "table", G_TABLE_USER_SCOPE_USER, "where", "gu_id", gu_id);
-  res = h_delete(param->conn, j_query, NULL);
+  res = h_delete(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = G_OK;
@@ -727,7 +849,7 @@ static int save_user_scope(struct mod_parameters * param, json_t * j_scope, json
                             "where",
                               "gus_name",
                               j_element);
-        res = h_select(param->conn, j_query, &j_result, NULL);
+        res = h_select(conn, j_query, &j_result, NULL);
         json_decref(j_query);
         if (res == H_OK) {
           if (json_array_size(j_result)) {
@@ -739,7 +861,7 @@ static int save_user_scope(struct mod_parameters * param, json_t * j_scope, json
                                   gu_id,
                                   "gus_id",
                                   json_object_get(json_array_get(j_result, 0), "gus_id"));
-            res = h_insert(param->conn, j_query, NULL);
+            res = h_insert(conn, j_query, NULL);
             json_decref(j_query);
             if (res != H_OK) {
               y_log_message(Y_LOG_LEVEL_ERROR, "save_user_scope database - Error executing j_query insert scope_user (1)");
@@ -751,10 +873,10 @@ static int save_user_scope(struct mod_parameters * param, json_t * j_scope, json
                                 "values",
                                   "gus_name",
                                   j_element);
-            res = h_insert(param->conn, j_query, NULL);
+            res = h_insert(conn, j_query, NULL);
             json_decref(j_query);
             if (res == H_OK) {
-              j_new_scope_id = h_last_insert_id(param->conn);
+              j_new_scope_id = h_last_insert_id(conn);
               if (j_new_scope_id != NULL) {
                 j_query = json_pack("{sss{sIsO}}",
                                     "table",
@@ -764,7 +886,7 @@ static int save_user_scope(struct mod_parameters * param, json_t * j_scope, json
                                       gu_id,
                                       "gus_id",
                                       j_new_scope_id);
-                res = h_insert(param->conn, j_query, NULL);
+                res = h_insert(conn, j_query, NULL);
                 json_decref(j_query);
                 if (res != H_OK) {
                   y_log_message(Y_LOG_LEVEL_ERROR, "save_user_scope database - Error executing j_query insert scope_user (2)");
@@ -795,7 +917,7 @@ static int save_user_scope(struct mod_parameters * param, json_t * j_scope, json
                             "value",
                             scope_clause);
     o_free(scope_clause);
-    res = h_delete(param->conn, j_query, NULL);
+    res = h_delete(conn, j_query, NULL);
     json_decref(j_query);
     if (res != H_OK) {
       y_log_message(Y_LOG_LEVEL_ERROR, "save_user_scope database - Error executing j_query delete empty scopes");
@@ -806,6 +928,7 @@ static int save_user_scope(struct mod_parameters * param, json_t * j_scope, json
     ret = G_ERROR_DB;
   }
   
+  database_conn_checkin(param, conn);
   return ret;
 }
 
@@ -906,6 +1029,7 @@ int user_module_close(struct config_module * config, void * cls) {
 size_t user_module_count_total(struct config_module * config, const char * pattern, void * cls) {
   UNUSED(config);
   struct mod_parameters * param = (struct mod_parameters *)cls;
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query, * j_result = NULL;
   int res;
   size_t ret = 0;
@@ -921,7 +1045,7 @@ size_t user_module_count_total(struct config_module * config, const char * patte
     json_object_set_new(j_query, "where", json_pack("{s{ssss}}", "gu_id", "operator", "raw", "value", pattern_clause));
     o_free(pattern_clause);
   }
-  res = h_select(param->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = (size_t)json_integer_value(json_object_get(json_array_get(j_result, 0), "total"));
@@ -929,12 +1053,14 @@ size_t user_module_count_total(struct config_module * config, const char * patte
   } else {
     y_log_message(Y_LOG_LEVEL_ERROR, "user_module_count_total database - Error executing j_query");
   }
+  database_conn_checkin(param, conn);
   return ret;
 }
 
 json_t * user_module_get_list(struct config_module * config, const char * pattern, size_t offset, size_t limit, void * cls) {
   UNUSED(config);
   struct mod_parameters * param = (struct mod_parameters *)cls;
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query, * j_result, * j_element = NULL, * j_scope, * j_return;
   int res;
   char * pattern_clause;
@@ -960,7 +1086,7 @@ json_t * user_module_get_list(struct config_module * config, const char * patter
     json_object_set_new(j_query, "where", json_pack("{s{ssss}}", "gu_id", "operator", "raw", "value", pattern_clause));
     o_free(pattern_clause);
   }
-  res = h_select(param->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     json_array_foreach(j_result, index, j_element) {
@@ -989,6 +1115,7 @@ json_t * user_module_get_list(struct config_module * config, const char * patter
     param->config_glewlwyd->glewlwyd_module_callback_metrics_increment_counter(param->config_glewlwyd, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     j_return = json_pack("{si}", "result", G_ERROR_DB);
   }
+  database_conn_checkin(param, conn);
   return j_return;
 }
 
@@ -1004,6 +1131,7 @@ json_t * user_module_get_profile(struct config_module * config, const char * use
 
 json_t * user_module_is_valid(struct config_module * config, const char * username, json_t * j_user, int mode, void * cls) {
   struct mod_parameters * param = (struct mod_parameters *)cls;
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_result = json_array(), * j_element, * j_format, * j_value, * j_return = NULL, * j_cur_user;
   char * message, * escaped;
   size_t index = 0;
@@ -1011,7 +1139,7 @@ json_t * user_module_is_valid(struct config_module * config, const char * userna
   
   if (j_result != NULL) {
     if (mode == GLEWLWYD_IS_VALID_MODE_ADD) {
-      escaped = h_escape_string(param->conn, json_string_value(json_object_get(j_user, "username")));
+      escaped = h_escape_string(conn, json_string_value(json_object_get(j_user, "username")));
       if (!json_is_string(json_object_get(j_user, "username")) || o_strlen(escaped) > 128) {
         json_array_append_new(j_result, json_string("username is mandatory and must be a string (maximum 128 characters)"));
       } else {
@@ -1049,12 +1177,12 @@ json_t * user_module_is_valid(struct config_module * config, const char * userna
         json_array_append_new(j_result, json_string("password must be a string"));
       }
     }
-    escaped = h_escape_string(param->conn, json_string_value(json_object_get(j_user, "name")));
+    escaped = h_escape_string(conn, json_string_value(json_object_get(j_user, "name")));
     if (json_object_get(j_user, "name") != NULL && (!json_is_string(json_object_get(j_user, "name")) || o_strlen(escaped) > 256)) {
       json_array_append_new(j_result, json_string("name must be a string (maximum 256 characters)"));
     }
     o_free(escaped);
-    escaped = h_escape_string(param->conn, json_string_value(json_object_get(j_user, "email")));
+    escaped = h_escape_string(conn, json_string_value(json_object_get(j_user, "email")));
     if (json_object_get(j_user, "email") != NULL && (!json_is_string(json_object_get(j_user, "email")) || o_strlen(escaped) > 512)) {
       json_array_append_new(j_result, json_string("email must be a string (maximum 512 characters)"));
     }
@@ -1072,7 +1200,7 @@ json_t * user_module_is_valid(struct config_module * config, const char * userna
             o_free(message);
           } else {
             json_array_foreach(j_element, index, j_value) {
-              escaped = h_escape_string(param->conn, json_string_value(j_value));
+              escaped = h_escape_string(conn, json_string_value(j_value));
               if (!json_is_string(j_value) || o_strlen(escaped) > 16*1024*1024) {
                 message = msprintf("property '%s' must contain a string value (maximum 16M characters)", property);
                 json_array_append_new(j_result, json_string(message));
@@ -1082,7 +1210,7 @@ json_t * user_module_is_valid(struct config_module * config, const char * userna
             }
           }
         } else {
-          escaped = h_escape_string(param->conn, json_string_value(j_element));
+          escaped = h_escape_string(conn, json_string_value(j_element));
           if (!json_is_string(j_element) || o_strlen(escaped) > 16*1024*1024) {
             message = msprintf("property '%s' must be a string value (maximum 16M characters)", property);
             json_array_append_new(j_result, json_string(message));
@@ -1102,12 +1230,14 @@ json_t * user_module_is_valid(struct config_module * config, const char * userna
     y_log_message(Y_LOG_LEVEL_ERROR, "user_module_is_valid database - Error allocating resources for j_result");
     j_return = json_pack("{si}", "result", G_ERROR_MEMORY);
   }
+  database_conn_checkin(param, conn);
   return j_return;
 }
 
 int user_module_add(struct config_module * config, json_t * j_user, void * cls) {
   UNUSED(config);
   struct mod_parameters * param = (struct mod_parameters *)cls;
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query, * j_gu_id;
   int res, ret;
   const char ** passwords = NULL;
@@ -1129,10 +1259,10 @@ int user_module_add(struct config_module * config, json_t * j_user, void * cls)
   if (json_object_get(j_user, "enabled") != NULL) {
     json_object_set_new(json_object_get(j_query, "values"), "gu_enabled", json_object_get(j_user, "enabled")==json_false()?json_integer(0):json_integer(1));
   }
-  res = h_insert(param->conn, j_query, NULL);
+  res = h_insert(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
-    j_gu_id = h_last_insert_id(param->conn);
+    j_gu_id = h_last_insert_id(conn);
     if (save_user_properties(param, j_user, json_integer_value(j_gu_id), 0) != G_OK) {
       y_log_message(Y_LOG_LEVEL_ERROR, "user_module_add database - Error save_user_properties");
       param->config_glewlwyd->glewlwyd_module_callback_metrics_increment_counter(param->config_glewlwyd, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
@@ -1175,22 +1305,24 @@ int user_module_add(struct config_module * config, json_t * j_user, void * cls)
     param->config_glewlwyd->glewlwyd_module_callback_metrics_increment_counter(param->config_glewlwyd, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  database_conn_checkin(param, conn);
   return ret;
 }
 
 int user_module_update(struct config_module * config, const char * username, json_t * j_user, void * cls) {
   UNUSED(config);
   struct mod_parameters * param = (struct mod_parameters *)cls;
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query, * j_result = NULL;
   int res, ret;
   char * username_escaped, * username_clause;
   const char ** passwords = NULL;
   size_t i;
   
-  username_escaped = h_escape_string_with_quotes(param->conn, username);
+  username_escaped = h_escape_string_with_quotes(conn, username);
   username_clause = msprintf(" = UPPER(%s)", username_escaped);  
   j_query = json_pack("{sss[s]s{s{ssss}}}", "table", G_TABLE_USER, "columns", "gu_id", "where", "UPPER(gu_username)", "operator", "raw", "value", username_clause);
-  res = h_select(param->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   o_free(username_clause);
   o_free(username_escaped);
@@ -1213,7 +1345,7 @@ int user_module_update(struct config_module * config, const char * username, jso
       json_object_set_new(json_object_get(j_query, "set"), "gu_enabled", json_object_get(j_user, "enabled")==json_false()?json_integer(0):json_integer(1));
     }
     if (json_object_size(json_object_get(j_query, "set"))) {
-      res = h_update(param->conn, j_query, NULL);
+      res = h_update(conn, j_query, NULL);
     } else {
       res = H_OK;
     }
@@ -1264,20 +1396,22 @@ int user_module_update(struct config_module * config, const char * username, jso
     ret = G_ERROR_NOT_FOUND;
   }
   json_decref(j_result);
+  database_conn_checkin(param, conn);
   return ret;
 }
 
 int user_module_update_profile(struct config_module * config, const char * username, json_t * j_user, void * cls) {
   UNUSED(config);
   struct mod_parameters * param = (struct mod_parameters *)cls;
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query, * j_result = NULL;
   int res, ret;
   char * username_escaped, * username_clause;
   
-  username_escaped = h_escape_string_with_quotes(param->conn, username);
+  username_escaped = h_escape_string_with_quotes(conn, username);
   username_clause = msprintf(" = UPPER(%s)", username_escaped);  
   j_query = json_pack("{sss[s]s{s{ssss}}}", "table", G_TABLE_USER, "columns", "gu_id", "where", "UPPER(gu_username)", "operator", "raw", "value", username_clause);
-  res = h_select(param->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   o_free(username_clause);
   o_free(username_escaped);
@@ -1294,7 +1428,7 @@ int user_module_update_profile(struct config_module * config, const char * usern
         json_object_set(json_object_get(j_query, "set"), "gu_name", json_object_get(j_user, "name"));
       }
       if (json_object_size(json_object_get(j_query, "set"))) {
-        if (h_update(param->conn, j_query, NULL) == H_OK) {
+        if (h_update(conn, j_query, NULL) == H_OK) {
           ret = G_OK;
         } else {
           y_log_message(Y_LOG_LEVEL_ERROR, "user_module_update_profile database - Error executing j_query update");
@@ -1324,17 +1458,19 @@ int user_module_update_profile(struct config_module * config, const char * usern
     ret = G_ERROR_DB;
   }
   json_decref(j_result);
+  database_conn_checkin(param, conn);
   return ret;
 }
 
 int user_module_delete(struct config_module * config, const char * username, void * cls) {
   UNUSED(config);
   struct mod_parameters * param = (struct mod_parameters *)cls;
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query;
   int res, ret;
   char * username_escaped, * username_clause;
   
-  username_escaped = h_escape_string_with_quotes(param->conn, username);
+  username_escaped = h_escape_string_with_quotes(conn, username);
   username_clause = msprintf(" = UPPER(%s)", username_escaped);  
   j_query = json_pack("{sss{s{ssss}}}",
                       "table",
@@ -1347,7 +1483,7 @@ int user_module_delete(struct config_module * config, const char * username, voi
                           username_clause);
   o_free(username_clause);
   o_free(username_escaped);
-  res = h_delete(param->conn, j_query, NULL);
+  res = h_delete(conn, j_query, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     ret = G_OK;
@@ -1356,63 +1492,71 @@ int user_module_delete(struct config_module * config, const char * username, voi
     param->config_glewlwyd->glewlwyd_module_callback_metrics_increment_counter(param->config_glewlwyd, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
     ret = G_ERROR_DB;
   }
+  database_conn_checkin(param, conn);
   return ret;
 }
 
 int user_module_check_password(struct config_module * config, const char * username, const char * password, void * cls) {
   UNUSED(config);
   struct mod_parameters * param = (struct mod_parameters *)cls;
+  struct _h_connection * conn = database_conn_checkout(param);
   int ret, res;
   json_t * j_query, * j_result;
-  char * clause = get_password_clause_check(param, username, password);
-  char * username_escaped, * username_clause;
+  char * clause, * username_escaped, * username_clause;
   
-  username_escaped = h_escape_string_with_quotes(param->conn, username);
-  username_clause = msprintf("IN (SELECT gu_id FROM "G_TABLE_USER" WHERE UPPER(gu_username) = UPPER(%s))", username_escaped);  
-  j_query = json_pack("{sss[s]s{s{ssss}s{ssss}}}",
-                      "table",
-                      G_TABLE_USER_PASSWORD,
-                      "columns",
-                        "gu_id",
-                      "where",
-                        "gu_id",
-                          "operator",
-                          "raw",
-                          "value",
-                          username_clause,
-                        "guw_password",
-                          "operator",
-                          "raw",
-                          "value",
-                          clause);
-  o_free(clause);
-  o_free(username_clause);
-  o_free(username_escaped);
-  res = h_select(param->conn, j_query, &j_result, NULL);
-  json_decref(j_query);
-  if (res == H_OK) {
-    if (json_array_size(j_result) == 1) {
-      ret = G_OK;
+  if (conn->type == HOEL_DB_TYPE_SQLITE) {
+    ret = check_password_pbkdf2(param, conn, username, password);
+  } else {
+    clause = get_password_clause_check(param, password);
+    username_escaped = h_escape_string_with_quotes(conn, username);
+    username_clause = msprintf("IN (SELECT gu_id FROM "G_TABLE_USER" WHERE UPPER(gu_username) = UPPER(%s))", username_escaped);  
+    j_query = json_pack("{sss[s]s{s{ssss}s{ssss}}}",
+                        "table",
+                        G_TABLE_USER_PASSWORD,
+                        "columns",
+                          "gu_id",
+                        "where",
+                          "gu_id",
+                            "operator",
+                            "raw",
+                            "value",
+                            username_clause,
+                          "guw_password",
+                            "operator",
+                            "raw",
+                            "value",
+                            clause);
+    o_free(clause);
+    o_free(username_clause);
+    o_free(username_escaped);
+    res = h_select(conn, j_query, &j_result, NULL);
+    json_decref(j_query);
+    if (res == H_OK) {
+      if (json_array_size(j_result) == 1) {
+        ret = G_OK;
+      } else {
+        ret = G_ERROR_UNAUTHORIZED;
+      }
+      json_decref(j_result);
     } else {
-      ret = G_ERROR_UNAUTHORIZED;
+      y_log_message(Y_LOG_LEVEL_ERROR, "user_module_check_password database - Error executing j_query");
+      param->config_glewlwyd->glewlwyd_module_callback_metrics_increment_counter(param->config_glewlwyd, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
+      ret = G_ERROR_DB;
     }
-    json_decref(j_result);
-  } else {
-    y_log_message(Y_LOG_LEVEL_ERROR, "user_module_check_password database - Error executing j_query");
-    param->config_glewlwyd->glewlwyd_module_callback_metrics_increment_counter(param->config_glewlwyd, GLWD_METRICS_DATABSE_ERROR, 1, NULL);
-    ret = G_ERROR_DB;
   }
+  database_conn_checkin(param, conn);
   return ret;
 }
 
 int user_module_update_password(struct config_module * config, const char * username, const char ** new_passwords, size_t new_passwords_len, void * cls) {
   UNUSED(config);
   struct mod_parameters * param = (struct mod_parameters *)cls;
+  struct _h_connection * conn = database_conn_checkout(param);
   json_t * j_query, * j_result;
   int res, ret;
   char * username_escaped, * username_clause;
   
-  username_escaped = h_escape_string_with_quotes(param->conn, username);
+  username_escaped = h_escape_string_with_quotes(conn, username);
   username_clause = msprintf(" = UPPER(%s)", username_escaped);  
   j_query = json_pack("{sss[s]s{s{ssss}}}",
                       "table",
@@ -1427,7 +1571,7 @@ int user_module_update_password(struct config_module * config, const char * user
                           username_clause);
   o_free(username_clause);
   o_free(username_escaped);
-  res = h_select(param->conn, j_query, &j_result, NULL);
+  res = h_select(conn, j_query, &j_result, NULL);
   json_decref(j_query);
   if (res == H_OK) {
     if (json_array_size(j_result) == 1) {
@@ -1442,5 +1586,6 @@ int user_module_update_password(struct config_module * config, const char * user
     ret = G_ERROR_DB;
   }
   
+  database_conn_checkin(param, conn);
   return ret;
 }
@@ -284,6 +284,9 @@ int callback_glewlwyd_user_auth (const struct _u_request * request, struct _u_re
             o_free(session_uid);
             glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_AUTH_USER_VALID, 1, NULL);
             glewlwyd_metrics_increment_counter_va(config, GLWD_METRICS_AUTH_USER_VALID_SCHEME, 1, "scheme_type", "password", NULL);
+          } else if (check_result_value(j_result, G_ERROR_UNAVAILABLE)) {
+            response->status = 503;
+            u_map_put(response->map_header, "Retry-After", GLEWLWYD_PASSWORD_POOL_RETRY_AFTER);
           } else {
             if (check_result_value(j_result, G_ERROR_UNAUTHORIZED)) {
               y_log_message(Y_LOG_LEVEL_WARNING, "Security - Authorization invalid for username %s at IP Address %s", json_string_value(json_object_get(j_param, "username")), ip_source);
@@ -2814,23 +2817,33 @@ int callback_glewlwyd_delete_misc_config (const struct _u_request * request, str
 int callback_metrics (const struct _u_request * request, struct _u_response * response, void * user_data) {
   UNUSED(request);
   struct config_elements * config = (struct config_elements *)user_data;
-  size_t i, j;
-  char * content = o_strdup("# We have seen handsome noble-looking men but I have never seen a man like the one who now stands at the entrance of the gate.\n");
-  struct _glwd_metric * metric;
+  char * content = o_strdup("# We have seen handsome noble-looking men but I have never seen a man like the one who now stands at the entrance of the gate.\n"), * metrics_content, * pool_content, * cache_content, * job_content, * password_content, * purge_content;
   
   if (!pthread_mutex_lock(&config->metrics_lock)) {
     u_map_put(response->map_header, ULFIUS_HTTP_HEADER_CONTENT, "text/plain; charset=utf-8");
-    for (i=0; i<pointer_list_size(&config->metrics_list); i++) {
-      metric = (struct _glwd_metric *)pointer_list_get_at(&config->metrics_list, i);
-      content = mstrcatf(content, "# HELP %s_total %s\n", metric->name, metric->help);
-      content = mstrcatf(content, "# TYPE %s_total counter\n", metric->name);
-      for (j=0; j<metric->data_size; j++) {
-        if (metric->data[j].label != NULL) {
-          content = mstrcatf(content, "%s_total{%s} %zu\n", metric->name, metric->data[j].label, metric->data[j].counter);
-        } else {
-          content = mstrcatf(content, "%s_total %zu\n", metric->name, metric->data[j].counter);
-        }
-      }
+    if ((metrics_content = glewlwyd_metrics_get_content(config)) != NULL) {
+      content = mstrcatf(content, "%s", metrics_content);
+      o_free(metrics_content);
+    }
+    if ((pool_content = glewlwyd_db_pool_metrics(config)) != NULL) {
+      content = mstrcatf(content, "%s", pool_content);
+      o_free(pool_content);
+    }
+    if ((cache_content = glewlwyd_cache_metrics(config)) != NULL) {
+      content = mstrcatf(content, "%s", cache_content);
+      o_free(cache_content);
+    }
+    if ((job_content = glewlwyd_job_queue_metrics(config)) != NULL) {
+      content = mstrcatf(content, "%s", job_content);
+      o_free(job_content);
+    }
+    if ((password_content = glewlwyd_password_pool_metrics(config)) != NULL) {
+      content = mstrcatf(content, "%s", password_content);
+      o_free(password_content);
+    }
+    if ((purge_content = glewlwyd_purge_metrics(config)) != NULL) {
+      content = mstrcatf(content, "%s", purge_content);
+      o_free(purge_content);
     }
     ulfius_set_string_body_response(response, 200, content);
     o_free(content);
@@ -0,0 +1,93 @@
+/* Public domain, no copyright. Use at your own risk. */
+
+/**
+ * Random string generation benchmark
+ * Generates session ids, tokens and codes with the functions of misc.c
+ * and prints the CPU time per string
+ * for the previous generation (one gnutls_rnd call per character)
+ * and for the batched generation
+ *
+ * Usage: ./glewlwyd_bench_rand [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <orcania.h>
+#include <yder.h>
+
+#include "../src/glewlwyd-common.h"
+
+#define BENCH_DEFAULT_ITERATIONS 100000
+#define BENCH_CHARSET            "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"
+#define BENCH_MAX_LENGTH         128
+
+static double get_cpu_time(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+/**
+ * Previous implementation of rand_string, one random_at_most call per character
+ */
+static char * previous_rand_string(char * str, size_t str_size) {
+  size_t n;
+  int is_error = 0;
+
+  for (n = 0; n < str_size; n++) {
+    str[n] = BENCH_CHARSET[random_at_most((unsigned char)(o_strlen(BENCH_CHARSET) - 2), 0, &is_error)];
+    if (is_error) {
+      return NULL;
+    }
+  }
+  str[str_size] = '\0';
+  return str;
+}
+
+static void run_bench(const char * name, char * (* generate)(char * str, size_t str_size), size_t length, unsigned int iterations) {
+  char str[BENCH_MAX_LENGTH+1];
+  unsigned int i, nb_error = 0;
+  double start, duration;
+
+  start = get_cpu_time();
+  for (i=0; i<iterations; i++) {
+    if (generate(str, length) == NULL) {
+      nb_error++;
+    }
+  }
+  duration = get_cpu_time() - start;
+  printf("%-10s | %6zu | %10.3f | %u\n", name, length, duration * 1000000.0 / iterations, nb_error);
+}
+
+static char * code_string(char * str, size_t str_size) {
+  return rand_code(str, str_size)?str:NULL;
+}
+
+int main(int argc, char *argv[]) {
+  unsigned int iterations = BENCH_DEFAULT_ITERATIONS;
+  int ret = 0;
+
+  if (argc > 1) {
+    iterations = (unsigned int)strtoul(argv[1], NULL, 10);
+  }
+  if (iterations) {
+    y_init_logs("Glewlwyd bench", Y_LOG_MODE_CONSOLE, Y_LOG_LEVEL_ERROR, NULL, "Starting Glewlwyd random benchmark");
+    printf("generator  | length | cpu us/str | errors\n");
+    run_bench("previous", previous_rand_string, 32, iterations);
+    run_bench("string", rand_string, 32, iterations);
+    run_bench("nonce", rand_string_nonce, 32, iterations);
+    run_bench("previous", previous_rand_string, BENCH_MAX_LENGTH, iterations);
+    run_bench("string", rand_string, BENCH_MAX_LENGTH, iterations);
+    run_bench("nonce", rand_string_nonce, BENCH_MAX_LENGTH, iterations);
+    run_bench("code", code_string, 8, iterations);
+    y_close_logs();
+  } else {
+    fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+    ret = 1;
+  }
+  return ret;
+}
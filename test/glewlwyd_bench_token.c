@@ -0,0 +1,118 @@
+/* Public domain, no copyright. Use at your own risk. */
+
+/**
+ * Token endpoint throughput benchmark
+ * Runs client_credentials token requests with 1, 2, 4... up to max_threads
+ * concurrent clients and prints the number of tokens issued per second
+ *
+ * Usage: ./glewlwyd_bench_token [max_threads [duration_seconds]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <ulfius.h>
+#include <orcania.h>
+#include <yder.h>
+
+#define SERVER_URI "http://localhost:4593/api/oidc"
+#define CLIENT_ID "client3_id"
+#define CLIENT_PASSWORD "password"
+#define SCOPE_LIST "scope2 scope3"
+
+#define BENCH_DEFAULT_MAX_THREADS 16
+#define BENCH_DEFAULT_DURATION 10
+
+struct _bench_thread {
+  pthread_t thread;
+  time_t    end;
+  size_t    nb_ok;
+  size_t    nb_error;
+};
+
+static void * run_bench_thread(void * args) {
+  struct _bench_thread * bench = (struct _bench_thread *)args;
+  struct _u_request req;
+  struct _u_response resp;
+
+  while (time(NULL) < bench->end) {
+    ulfius_init_request(&req);
+    ulfius_init_response(&resp);
+    ulfius_set_request_properties(&req,
+                                  U_OPT_HTTP_VERB, "POST",
+                                  U_OPT_HTTP_URL, SERVER_URI "/token/",
+                                  U_OPT_AUTH_BASIC_USER, CLIENT_ID,
+                                  U_OPT_AUTH_BASIC_PASSWORD, CLIENT_PASSWORD,
+                                  U_OPT_POST_BODY_PARAMETER, "grant_type", "client_credentials",
+                                  U_OPT_POST_BODY_PARAMETER, "scope", SCOPE_LIST,
+                                  U_OPT_NONE);
+    if (ulfius_send_http_request(&req, &resp) == U_OK && resp.status == 200) {
+      bench->nb_ok++;
+    } else {
+      bench->nb_error++;
+    }
+    ulfius_clean_request(&req);
+    ulfius_clean_response(&resp);
+  }
+  return NULL;
+}
+
+static int run_bench(unsigned int nb_threads, unsigned int duration) {
+  struct _bench_thread * bench_list = o_malloc(nb_threads*sizeof(struct _bench_thread));
+  size_t nb_ok = 0, nb_error = 0;
+  unsigned int i;
+  time_t end = time(NULL) + (time_t)duration;
+  int ret = 0;
+
+  if (bench_list != NULL) {
+    for (i=0; i<nb_threads; i++) {
+      bench_list[i].end = end;
+      bench_list[i].nb_ok = 0;
+      bench_list[i].nb_error = 0;
+      if (pthread_create(&bench_list[i].thread, NULL, run_bench_thread, &bench_list[i])) {
+        fprintf(stderr, "Error pthread_create\n");
+        ret = 1;
+        break;
+      }
+    }
+    nb_threads = i;
+    for (i=0; i<nb_threads; i++) {
+      pthread_join(bench_list[i].thread, NULL);
+      nb_ok += bench_list[i].nb_ok;
+      nb_error += bench_list[i].nb_error;
+    }
+    printf("%7u | %10zu | %8zu | %10.1f\n", nb_threads, nb_ok, nb_error, (double)nb_ok/duration);
+    o_free(bench_list);
+  } else {
+    fprintf(stderr, "Error allocating resources for bench_list\n");
+    ret = 1;
+  }
+  return ret;
+}
+
+int main(int argc, char *argv[]) {
+  unsigned int max_threads = BENCH_DEFAULT_MAX_THREADS, duration = BENCH_DEFAULT_DURATION, nb_threads;
+  int ret = 0;
+
+  if (argc > 1) {
+    max_threads = (unsigned int)strtoul(argv[1], NULL, 10);
+  }
+  if (argc > 2) {
+    duration = (unsigned int)strtoul(argv[2], NULL, 10);
+  }
+  if (max_threads && duration) {
+    y_init_logs("Glewlwyd bench", Y_LOG_MODE_CONSOLE, Y_LOG_LEVEL_ERROR, NULL, "Starting Glewlwyd token endpoint benchmark");
+    printf("threads | tokens     | errors   | tokens/s\n");
+    for (nb_threads=1; !ret && nb_threads<=max_threads; nb_threads*=2) {
+      ret = run_bench(nb_threads, duration);
+    }
+    y_close_logs();
+  } else {
+    fprintf(stderr, "Usage: %s [max_threads [duration_seconds]]\n", argv[0]);
+    ret = 1;
+  }
+  return ret;
+}
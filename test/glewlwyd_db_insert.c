@@ -0,0 +1,166 @@
+/* Public domain, no copyright. Use at your own risk. */
+
+/**
+ * Database insert tests
+ * Runs concurrent inserts of a parent row and its child rows with db_pool.c
+ * on a shared sqlite3 in-memory connection, and checks every child row
+ * references the parent row inserted by the same thread
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <check.h>
+#include <orcania.h>
+#include <yder.h>
+
+#include "../src/glewlwyd.h"
+
+#define INSERT_TABLE_PARENT "g_insert_test"
+#define INSERT_TABLE_CHILD  "g_insert_test_child"
+#define INSERT_NB_THREAD    8
+#define INSERT_NB_ROUND     50
+#define INSERT_NB_CHILD     3
+
+static struct config_elements * config;
+
+struct _insert_thread {
+  pthread_t thread;
+  size_t    index;
+  int       result;
+};
+
+static void setup(void) {
+  pthread_mutexattr_t mutexattr;
+
+  ck_assert_ptr_ne(NULL, config = o_malloc(sizeof(struct config_elements)));
+  memset(config, 0, sizeof(struct config_elements));
+  pthread_mutexattr_init(&mutexattr);
+  pthread_mutexattr_settype(&mutexattr, PTHREAD_MUTEX_RECURSIVE);
+  ck_assert_int_eq(pthread_mutex_init(&config->insert_lock, &mutexattr), 0);
+  pthread_mutexattr_destroy(&mutexattr);
+  ck_assert_ptr_ne(NULL, config->conn = h_connect_sqlite(":memory:"));
+  ck_assert_int_eq(h_execute_query_sqlite(config->conn, "CREATE TABLE " INSERT_TABLE_PARENT " (git_id INTEGER PRIMARY KEY AUTOINCREMENT, git_name TEXT);"), H_OK);
+  ck_assert_int_eq(h_execute_query_sqlite(config->conn, "CREATE TABLE " INSERT_TABLE_CHILD " (gitc_id INTEGER PRIMARY KEY AUTOINCREMENT, git_id INTEGER, gitc_name TEXT);"), H_OK);
+}
+
+static void teardown(void) {
+  glewlwyd_db_pool_close(config);
+  h_close_db(config->conn);
+  h_clean_connection(config->conn);
+  pthread_mutex_destroy(&config->insert_lock);
+  o_free(config);
+}
+
+/**
+ * Inserts INSERT_NB_ROUND parent rows, each one followed by INSERT_NB_CHILD child rows
+ * using the parent id, all named after the thread and the round
+ */
+static void * run_insert_thread(void * args) {
+  struct _insert_thread * insert = (struct _insert_thread *)args;
+  struct _h_connection * conn = glewlwyd_db_pool_checkout(config);
+  json_t * j_query, * j_last_id;
+  char * name;
+  size_t i, j;
+
+  insert->result = G_OK;
+  for (i=0; insert->result == G_OK && i<INSERT_NB_ROUND; i++) {
+    name = msprintf("thread-%zu-%zu", insert->index, i);
+    j_query = json_pack("{sss{ss}}", "table", INSERT_TABLE_PARENT, "values", "git_name", name);
+    glewlwyd_db_insert_begin(config, conn);
+    if (glewlwyd_db_insert(config, conn, j_query, "git_id", &j_last_id) == H_OK && j_last_id != NULL) {
+      for (j=0; insert->result == G_OK && j<INSERT_NB_CHILD; j++) {
+        json_decref(j_query);
+        j_query = json_pack("{sss{sOss}}", "table", INSERT_TABLE_CHILD, "values", "git_id", j_last_id, "gitc_name", name);
+        if (h_insert(conn, j_query, NULL) != H_OK) {
+          insert->result = G_ERROR_DB;
+        }
+      }
+    } else {
+      insert->result = G_ERROR_DB;
+    }
+    glewlwyd_db_insert_end(config, conn);
+    json_decref(j_last_id);
+    json_decref(j_query);
+    o_free(name);
+  }
+  glewlwyd_db_pool_checkin(config, conn);
+  return NULL;
+}
+
+static void run_inserts(void) {
+  struct _insert_thread insert_list[INSERT_NB_THREAD];
+  json_t * j_result = NULL;
+  size_t i;
+
+  for (i=0; i<INSERT_NB_THREAD; i++) {
+    insert_list[i].index = i;
+    ck_assert_int_eq(pthread_create(&insert_list[i].thread, NULL, run_insert_thread, &insert_list[i]), 0);
+  }
+  for (i=0; i<INSERT_NB_THREAD; i++) {
+    pthread_join(insert_list[i].thread, NULL);
+    ck_assert_int_eq(insert_list[i].result, G_OK);
+  }
+  ck_assert_int_eq(h_execute_query_json(config->conn, "SELECT COUNT(*) AS nb FROM " INSERT_TABLE_CHILD, &j_result), H_OK);
+  ck_assert_int_eq(json_integer_value(json_object_get(json_array_get(j_result, 0), "nb")), INSERT_NB_THREAD*INSERT_NB_ROUND*INSERT_NB_CHILD);
+  json_decref(j_result);
+
+  // Every child row must reference the parent row with the same name
+  ck_assert_int_eq(h_execute_query_json(config->conn, "SELECT COUNT(*) AS nb FROM " INSERT_TABLE_CHILD " LEFT JOIN " INSERT_TABLE_PARENT " ON " INSERT_TABLE_CHILD ".git_id = " INSERT_TABLE_PARENT ".git_id WHERE " INSERT_TABLE_PARENT ".git_name IS NULL OR " INSERT_TABLE_PARENT ".git_name <> " INSERT_TABLE_CHILD ".gitc_name", &j_result), H_OK);
+  ck_assert_int_eq(json_integer_value(json_object_get(json_array_get(j_result, 0), "nb")), 0);
+  json_decref(j_result);
+}
+
+START_TEST(test_glwd_db_insert_pool_shared)
+{
+  ck_assert_int_eq(glewlwyd_db_pool_set_parameters(&config->db_pool, HOEL_DB_TYPE_SQLITE, ":memory:", NULL, NULL, NULL, NULL, 0), G_OK);
+  ck_assert_int_eq(glewlwyd_db_pool_init(config), G_OK);
+  // sqlite3 pools have a single connection, shared by all the threads
+  ck_assert_int_eq(config->db_pool.nb_conn, 1);
+  run_inserts();
+}
+END_TEST
+
+START_TEST(test_glwd_db_insert_no_pool)
+{
+  // Without a pool, config->insert_lock is used
+  run_inserts();
+}
+END_TEST
+
+static Suite *glewlwyd_suite(void)
+{
+  Suite *s;
+  TCase *tc_core;
+
+  s = suite_create("Glewlwyd database insert");
+  tc_core = tcase_create("test_glwd_db_insert");
+  tcase_add_checked_fixture(tc_core, setup, teardown);
+  tcase_add_test(tc_core, test_glwd_db_insert_pool_shared);
+  tcase_add_test(tc_core, test_glwd_db_insert_no_pool);
+  tcase_set_timeout(tc_core, 30);
+  suite_add_tcase(s, tc_core);
+
+  return s;
+}
+
+int main(void)
+{
+  int number_failed;
+  Suite *s;
+  SRunner *sr;
+
+  y_init_logs("Glewlwyd test", Y_LOG_MODE_CONSOLE, Y_LOG_LEVEL_DEBUG, NULL, "Starting Glewlwyd database insert tests");
+  s = glewlwyd_suite();
+  sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_VERBOSE);
+  number_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  y_close_logs();
+
+  return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
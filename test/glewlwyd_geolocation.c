@@ -48,6 +48,10 @@
 #define PORT_GEOLOCATION_STR "5622"
 #define GEOLOCATION_CITY "Cair Paravel"
 #define GEOLOCATION_COUNTRY "Narnia"
+#define GEOLOCATION_FILE "/tmp/glewlwyd_geolocation_ranges.csv"
+#define GEOLOCATION_FILE_CITY "Tashbaan"
+#define GEOLOCATION_FILE_CITY_RELOADED "Anvard"
+#define GEOLOCATION_FILE_COUNTRY "Calormen"
 
 char user_agent[33];
 
@@ -647,6 +651,85 @@ START_TEST(test_glwd_geolocation_incomplete)
 }
 END_TEST
 
+static void write_geolocation_file(const char * city) {
+  FILE * f = fopen(GEOLOCATION_FILE, "w");
+  ck_assert_ptr_ne(NULL, f);
+  fprintf(f, "network,city,country_name\n");
+  fprintf(f, "10.0.0.0/8,Private,Nowhere\n");
+  fprintf(f, "127.0.0.0/8,\"%s\",%s\n", city, GEOLOCATION_FILE_COUNTRY);
+  fprintf(f, "::1/128,\"%s\",%s\n", city, GEOLOCATION_FILE_COUNTRY);
+  fclose(f);
+}
+
+static void check_session_location(char first_char, const char * location) {
+  struct _u_request req, admin_req_copy;
+  struct _u_response resp;
+  json_t * j_body = json_pack("{ssss}", "username", USER1, "password", USER_PASSWORD), * j_response;
+  int counter = 10;
+
+  ulfius_init_request(&req);
+  user_agent[0] = first_char;
+  u_map_put(req.map_header, "User-Agent", user_agent);
+  ck_assert_int_eq(run_simple_test(&req, "POST", SERVER_URI "/auth/", NULL, NULL, j_body, NULL, 200, NULL, NULL, NULL), 1);
+  ulfius_clean_request(&req);
+  json_decref(j_body);
+
+  ulfius_init_request(&admin_req_copy);
+  ck_assert_int_eq(ulfius_copy_request(&admin_req_copy, &admin_req), U_OK);
+  ck_assert_int_eq(ulfius_set_request_properties(&admin_req_copy, U_OPT_HTTP_VERB, "GET",
+                                                                  U_OPT_HTTP_URL, SERVER_URI "/delegate/" USER1 "/profile/session",
+                                                                  U_OPT_URL_PARAMETER, "pattern", user_agent,
+                                                                  U_OPT_NONE), U_OK);
+  do {
+    ulfius_init_response(&resp);
+    ck_assert_int_eq(ulfius_send_http_request(&admin_req_copy, &resp), U_OK);
+    ck_assert_int_eq(resp.status, 200);
+    ck_assert_ptr_ne(NULL, j_response = ulfius_get_json_body_response(&resp, NULL));
+    ck_assert_int_gt(json_array_size(j_response), 0);
+    if (o_strstr(json_string_value(json_object_get(json_array_get(j_response, 0), "issued_for")), location) != NULL) {
+      json_decref(j_response);
+      ulfius_clean_response(&resp);
+      break;
+    }
+    json_decref(j_response);
+    ulfius_clean_response(&resp);
+    usleep(50000);
+  } while (counter--);
+  ck_assert_int_ne(0, counter);
+  ulfius_clean_request(&admin_req_copy);
+}
+
+START_TEST(test_glwd_geolocation_file)
+{
+  json_t * j_body;
+
+  write_geolocation_file(GEOLOCATION_FILE_CITY);
+  j_body = json_pack("{sss{so ss ss}}",
+                     "type", CONFIG_TYPE_GEOLOC,
+                     "value",
+                       "enabled", json_true(),
+                       "file", GEOLOCATION_FILE,
+                       "output-properties", "city, country_name");
+  ck_assert_int_eq(run_simple_test(&admin_req, "PUT", SERVER_URI "/misc/" CONFIG_NAME_GEOLOC, NULL, NULL, j_body, NULL, 200, NULL, NULL, NULL), 1);
+  json_decref(j_body);
+
+  ck_assert_ptr_ne(NULL, (j_body = json_pack("{sssssss[s]so}", "username", USER1, "password", USER_PASSWORD, "email", MAIL1, "scope", SCOPE, "enabled", json_true())));
+  ck_assert_int_eq(run_simple_test(&admin_req, "POST", SERVER_URI "/user", NULL, NULL, j_body, NULL, 200, NULL, NULL, NULL), 1);
+  json_decref(j_body);
+
+  check_session_location('F', GEOLOCATION_FILE_CITY " - " GEOLOCATION_FILE_COUNTRY);
+
+  // The file is checked at most once per second
+  sleep(2);
+  write_geolocation_file(GEOLOCATION_FILE_CITY_RELOADED);
+  check_session_location('G', GEOLOCATION_FILE_CITY_RELOADED " - " GEOLOCATION_FILE_COUNTRY);
+
+  ck_assert_int_eq(run_simple_test(&admin_req, "DELETE", SERVER_URI "/user/" USER1, NULL, NULL, NULL, NULL, 200, NULL, NULL, NULL), 1);
+  ck_assert_int_eq(run_simple_test(&admin_req, "DELETE", SERVER_URI "/misc/" CONFIG_NAME_GEOLOC, NULL, NULL, NULL, NULL, 200, NULL, NULL, NULL), 1);
+  unlink(GEOLOCATION_FILE);
+}
+END_TEST
+
 static Suite *glewlwyd_suite(void)
 {
   Suite *s;
@@ -661,6 +744,7 @@ static Suite *glewlwyd_suite(void)
   tcase_add_test(tc_core, test_glwd_geolocation_incomplete);
   tcase_add_test(tc_core, test_glwd_geolocation_remove_user);
   tcase_add_test(tc_core, test_glwd_geolocation_invalid_url);
+  tcase_add_test(tc_core, test_glwd_geolocation_file);
   tcase_set_timeout(tc_core, 30);
   suite_add_tcase(s, tc_core);
 
@@ -0,0 +1,122 @@
+/* Public domain, no copyright. Use at your own risk. */
+
+/**
+ * Hash tests
+ * Checks that generate_hash_buffer of misc.c gives the same hashes as generate_hash
+ * for every unsalted algorithm, with and without url_safe
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <check.h>
+#include <orcania.h>
+#include <yder.h>
+
+#include "../src/glewlwyd-common.h"
+
+#define HASH_NB_ALG  6
+#define HASH_NB_DATA 5
+
+static const digest_algorithm alg_list[HASH_NB_ALG] = {digest_SHA1, digest_SHA224, digest_SHA256, digest_SHA384, digest_SHA512, digest_MD5};
+
+static const char * data_list[HASH_NB_DATA] = {
+  "",
+  "a",
+  "session_uid",
+  "data-longer-than-the-sha512-block-size-0123456789abcdefghijklmnopqrstuvwxyz-0123456789abcdefghijklmnopqrstuvwxyz-0123456789",
+  "d\xc3\xa4t\xc3\xa4"
+};
+
+START_TEST(test_glwd_hash_buffer)
+{
+  char out_hash[GLEWLWYD_HASH_BUFFER_SIZE], * hash;
+  size_t i, j;
+
+  for (i=0; i<HASH_NB_ALG; i++) {
+    for (j=0; j<HASH_NB_DATA; j++) {
+      ck_assert_ptr_ne(NULL, hash = generate_hash(alg_list[i], data_list[j]));
+      ck_assert_int_eq(generate_hash_buffer(alg_list[i], data_list[j], 0, out_hash, sizeof(out_hash)), G_OK);
+      ck_assert_str_eq(out_hash, hash);
+      // The context of the thread is reused for the next hash
+      ck_assert_int_eq(generate_hash_buffer(alg_list[i], data_list[j], 0, out_hash, sizeof(out_hash)), G_OK);
+      ck_assert_str_eq(out_hash, hash);
+      o_free(hash);
+    }
+  }
+}
+END_TEST
+
+START_TEST(test_glwd_hash_buffer_url_safe)
+{
+  char out_hash[GLEWLWYD_HASH_BUFFER_SIZE], * hash;
+  size_t i, j, k, nb_replaced = 0;
+
+  for (i=0; i<HASH_NB_ALG; i++) {
+    for (j=0; j<HASH_NB_DATA; j++) {
+      ck_assert_ptr_ne(NULL, hash = generate_hash(alg_list[i], data_list[j]));
+      for (k=0; hash[k]; k++) {
+        if (hash[k] == '+') {
+          hash[k] = '-';
+          nb_replaced++;
+        } else if (hash[k] == '/') {
+          hash[k] = '_';
+          nb_replaced++;
+        }
+      }
+      ck_assert_int_eq(generate_hash_buffer(alg_list[i], data_list[j], 1, out_hash, sizeof(out_hash)), G_OK);
+      ck_assert_str_eq(out_hash, hash);
+      o_free(hash);
+    }
+  }
+  // At least one hash has characters that differ in url safe base64
+  ck_assert_int_gt(nb_replaced, 0);
+}
+END_TEST
+
+START_TEST(test_glwd_hash_buffer_invalid)
+{
+  char out_hash[GLEWLWYD_HASH_BUFFER_SIZE];
+
+  ck_assert_int_eq(generate_hash_buffer(digest_SHA256, NULL, 0, out_hash, sizeof(out_hash)), G_ERROR_PARAM);
+  ck_assert_int_eq(generate_hash_buffer(digest_SHA256, "data", 0, NULL, sizeof(out_hash)), G_ERROR_PARAM);
+  ck_assert_int_eq(generate_hash_buffer(digest_SHA256, "data", 0, out_hash, 0), G_ERROR_PARAM);
+  ck_assert_int_eq(generate_hash_buffer(digest_SHA256, "data", 0, out_hash, 8), G_ERROR_PARAM);
+}
+END_TEST
+
+static Suite *glewlwyd_suite(void)
+{
+  Suite *s;
+  TCase *tc_core;
+
+  s = suite_create("Glewlwyd hash");
+  tc_core = tcase_create("test_glwd_hash");
+  tcase_add_test(tc_core, test_glwd_hash_buffer);
+  tcase_add_test(tc_core, test_glwd_hash_buffer_url_safe);
+  tcase_add_test(tc_core, test_glwd_hash_buffer_invalid);
+  tcase_set_timeout(tc_core, 30);
+  suite_add_tcase(s, tc_core);
+
+  return s;
+}
+
+int main(void)
+{
+  int number_failed;
+  Suite *s;
+  SRunner *sr;
+
+  y_init_logs("Glewlwyd test", Y_LOG_MODE_CONSOLE, Y_LOG_LEVEL_DEBUG, NULL, "Starting Glewlwyd hash tests");
+  s = glewlwyd_suite();
+  sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_VERBOSE);
+  number_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  y_close_logs();
+
+  return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -35,6 +35,8 @@
 #define PASSWORD1 "password1"
 #define PASSWORD2 "password2"
 #define PASSWORD3 "password3"
+#define PASSWORD_MANY_PREFIX "password_many_"
+#define PASSWORD_MANY_NB 40
 
 struct _u_request admin_req;
 json_t * j_params;
@@ -306,6 +308,78 @@ START_TEST(test_glwd_mod_user_irl_admin_update_password)
 }
 END_TEST
 
+START_TEST(test_glwd_mod_user_irl_user_auth_many_passwords)
+{
+  json_t * j_profile, * j_body, * j_password = json_array();
+  char * password;
+  int i;
+  
+  // More passwords than PBKDF2 lanes, so the database backend checks them with helper threads
+  for (i=0; i<PASSWORD_MANY_NB; i++) {
+    password = msprintf("%s%d", PASSWORD_MANY_PREFIX, i);
+    json_array_append_new(j_password, json_string(password));
+    o_free(password);
+  }
+  j_profile = json_pack("{sss[s]sosO}", "name", NAME, "scope", SCOPE, "enabled", json_true(), "password", j_password);
+  ck_assert_int_eq(run_simple_test(&admin_req, "PUT", SERVER_URI "/user/" USERNAME, NULL, NULL, j_profile, NULL, 200, NULL, NULL, NULL), 1);
+  json_decref(j_profile);
+  
+  j_profile = json_pack("{si}", "password", PASSWORD_MANY_NB);
+  ck_assert_int_eq(run_simple_test(&admin_req, "GET", SERVER_URI "/user/" USERNAME, NULL, NULL, NULL, NULL, 200, j_profile, NULL, NULL), 1);
+  json_decref(j_profile);
+  
+  j_body = json_pack("{ssss}", "username", USERNAME, "password", PASSWORD_MANY_PREFIX "0");
+  ck_assert_int_eq(run_simple_test(NULL, "POST", SERVER_URI "/auth/", NULL, NULL, j_body, NULL, 200, NULL, NULL, NULL), 1);
+  json_decref(j_body);
+  
+  j_body = json_pack("{ssss}", "username", USERNAME, "password", PASSWORD_MANY_PREFIX "17");
+  ck_assert_int_eq(run_simple_test(NULL, "POST", SERVER_URI "/auth/", NULL, NULL, j_body, NULL, 200, NULL, NULL, NULL), 1);
+  json_decref(j_body);
+  
+  j_body = json_pack("{ssss}", "username", USERNAME, "password", PASSWORD_MANY_PREFIX "39");
+  ck_assert_int_eq(run_simple_test(NULL, "POST", SERVER_URI "/auth/", NULL, NULL, j_body, NULL, 200, NULL, NULL, NULL), 1);
+  json_decref(j_body);
+  
+  j_body = json_pack("{ssss}", "username", USERNAME, "password", PASSWORD_MANY_PREFIX "40");
+  ck_assert_int_eq(run_simple_test(NULL, "POST", SERVER_URI "/auth/", NULL, NULL, j_body, NULL, 401, NULL, NULL, NULL), 1);
+  json_decref(j_body);
+  
+  j_body = json_pack("{ssss}", "username", USERNAME, "password", PASSWORD1);
+  ck_assert_int_eq(run_simple_test(NULL, "POST", SERVER_URI "/auth/", NULL, NULL, j_body, NULL, 401, NULL, NULL, NULL), 1);
+  json_decref(j_body);
+  
+  j_profile = json_pack("{sss[s]sos[ss]}", "name", NAME, "scope", SCOPE, "enabled", json_true(), "password", PASSWORD1, PASSWORD2);
+  ck_assert_int_eq(run_simple_test(&admin_req, "PUT", SERVER_URI "/user/" USERNAME, NULL, NULL, j_profile, NULL, 200, NULL, NULL, NULL), 1);
+  json_decref(j_profile);
+  json_decref(j_password);
+}
+END_TEST
+
+START_TEST(test_glwd_mod_user_irl_user_auth_duplicate_password)
+{
+  json_t * j_profile, * j_body;
+  
+  // The database backend accepts a password only if exactly one of the user's hashes matches it
+  if (0 == o_strcmp("database", json_string_value(json_object_get(j_params, "module")))) {
+    j_profile = json_pack("{sss[s]sos[sss]}", "name", NAME, "scope", SCOPE, "enabled", json_true(), "password", PASSWORD1, PASSWORD3, PASSWORD3);
+    ck_assert_int_eq(run_simple_test(&admin_req, "PUT", SERVER_URI "/user/" USERNAME, NULL, NULL, j_profile, NULL, 200, NULL, NULL, NULL), 1);
+    json_decref(j_profile);
+    
+    j_body = json_pack("{ssss}", "username", USERNAME, "password", PASSWORD1);
+    ck_assert_int_eq(run_simple_test(NULL, "POST", SERVER_URI "/auth/", NULL, NULL, j_body, NULL, 200, NULL, NULL, NULL), 1);
+    json_decref(j_body);
+    
+    j_body = json_pack("{ssss}", "username", USERNAME, "password", PASSWORD3);
+    ck_assert_int_eq(run_simple_test(NULL, "POST", SERVER_URI "/auth/", NULL, NULL, j_body, NULL, 401, NULL, NULL, NULL), 1);
+    json_decref(j_body);
+    
+    j_profile = json_pack("{sss[s]sos[ss]}", "name", NAME, "scope", SCOPE, "enabled", json_true(), "password", PASSWORD1, PASSWORD2);
+    ck_assert_int_eq(run_simple_test(&admin_req, "PUT", SERVER_URI "/user/" USERNAME, NULL, NULL, j_profile, NULL, 200, NULL, NULL, NULL), 1);
+    json_decref(j_profile);
+  }
+}
+END_TEST
+
 START_TEST(test_glwd_mod_user_irl_user_delete)
 {
   ck_assert_int_eq(run_simple_test(&admin_req, "DELETE", SERVER_URI "/user/" USERNAME "?source=" MOD_NAME, NULL, NULL, NULL, NULL, 200, NULL, NULL, NULL), 1);
@@ -331,6 +405,8 @@ static Suite *glewlwyd_suite(void)
   tcase_add_test(tc_core, test_glwd_mod_user_irl_user_auth);
   tcase_add_test(tc_core, test_glwd_mod_user_irl_profile_update_password);
   tcase_add_test(tc_core, test_glwd_mod_user_irl_admin_update_password);
+  tcase_add_test(tc_core, test_glwd_mod_user_irl_user_auth_many_passwords);
+  tcase_add_test(tc_core, test_glwd_mod_user_irl_user_auth_duplicate_password);
   tcase_add_test(tc_core, test_glwd_mod_user_irl_user_delete);
   tcase_add_test(tc_core, test_glwd_mod_user_irl_module_delete);
   tcase_set_timeout(tc_core, 90);
@@ -57,6 +57,73 @@ START_TEST(test_oidc_discovery_default_test)
 }
 END_TEST
 
+START_TEST(test_oidc_discovery_etag_test)
+{
+  struct _u_request req;
+  struct _u_response resp;
+  char * etag, * etag_gzip, * etag_deflate;
+
+  ulfius_init_request(&req);
+  ulfius_init_response(&resp);
+  req.http_url = o_strdup(SERVER_URI "/oidc/.well-known/openid-configuration");
+  ck_assert_int_eq(ulfius_send_http_request(&req, &resp), U_OK);
+  ck_assert_int_eq(resp.status, 200);
+  ck_assert_ptr_ne((etag = o_strdup(u_map_get_case(resp.map_header, "ETag"))), NULL);
+  ck_assert_str_eq(u_map_get_case(resp.map_header, "Cache-Control"), "no-cache");
+  ck_assert_str_eq(u_map_get_case(resp.map_header, "Vary"), "Accept-Encoding");
+  ck_assert_ptr_eq(u_map_get_case(resp.map_header, "Content-Encoding"), NULL);
+  ulfius_clean_response(&resp);
+
+  ulfius_init_response(&resp);
+  u_map_put(req.map_header, "If-None-Match", etag);
+  ck_assert_int_eq(ulfius_send_http_request(&req, &resp), U_OK);
+  ck_assert_int_eq(resp.status, 304);
+  ck_assert_int_eq(resp.binary_body_length, 0);
+  ulfius_clean_response(&resp);
+
+  // Each variant has its own ETag, the ETag of the identity variant doesn't validate the gzip variant
+  ulfius_init_response(&resp);
+  u_map_put(req.map_header, "Accept-Encoding", "gzip");
+  ck_assert_int_eq(ulfius_send_http_request(&req, &resp), U_OK);
+  ck_assert_int_eq(resp.status, 200);
+  ck_assert_str_eq(u_map_get_case(resp.map_header, "Content-Encoding"), "gzip");
+  ck_assert_ptr_ne((etag_gzip = o_strdup(u_map_get_case(resp.map_header, "ETag"))), NULL);
+  ck_assert_str_ne(etag_gzip, etag);
+  ulfius_clean_response(&resp);
+
+  ulfius_init_response(&resp);
+  u_map_put(req.map_header, "If-None-Match", etag_gzip);
+  ck_assert_int_eq(ulfius_send_http_request(&req, &resp), U_OK);
+  ck_assert_int_eq(resp.status, 304);
+  ck_assert_str_eq(u_map_get_case(resp.map_header, "ETag"), etag_gzip);
+  ulfius_clean_response(&resp);
+
+  // gzip is refused with q=0
+  ulfius_init_response(&resp);
+  u_map_put(req.map_header, "Accept-Encoding", "gzip;q=0, deflate");
+  ck_assert_int_eq(ulfius_send_http_request(&req, &resp), U_OK);
+  ck_assert_int_eq(resp.status, 200);
+  ck_assert_str_eq(u_map_get_case(resp.map_header, "Content-Encoding"), "deflate");
+  ck_assert_ptr_ne((etag_deflate = o_strdup(u_map_get_case(resp.map_header, "ETag"))), NULL);
+  ck_assert_str_ne(etag_deflate, etag);
+  ck_assert_str_ne(etag_deflate, etag_gzip);
+  ulfius_clean_response(&resp);
+
+  ulfius_init_response(&resp);
+  u_map_put(req.map_header, "Accept-Encoding", "gzip;q=0");
+  ck_assert_int_eq(ulfius_send_http_request(&req, &resp), U_OK);
+  ck_assert_int_eq(resp.status, 200);
+  ck_assert_ptr_eq(u_map_get_case(resp.map_header, "Content-Encoding"), NULL);
+  ck_assert_str_eq(u_map_get_case(resp.map_header, "ETag"), etag);
+  ulfius_clean_response(&resp);
+
+  ulfius_clean_request(&req);
+  o_free(etag);
+  o_free(etag_gzip);
+  o_free(etag_deflate);
+}
+END_TEST
+
 START_TEST(test_oidc_discovery_add_plugin)
 {
   json_t * j_param = json_pack("{sssssss{sssssssssssisisisosososososososososssssosos[{ssssso}{ssssso}]sssss{ssss}s[ssss]s[s]sosososos[s]sososssisssososisosssosos{s{s[ss]s[ss]s[ss]s[ss]s[ss]}s{s[s]s[ss]s[ss]s[ss]s[s]}s{s[s]s[s]s[s]s[sss]s[s]}s{}}sososssisosisisososososososo}}",
@@ -299,6 +366,7 @@ static Suite *glewlwyd_suite(void)
   s = suite_create("Glewlwyd oidc discovery");
   tc_core = tcase_create("test_oidc_discovery");
   tcase_add_test(tc_core, test_oidc_discovery_default_test);
+  tcase_add_test(tc_core, test_oidc_discovery_etag_test);
   tcase_add_test(tc_core, test_oidc_discovery_add_plugin);
   tcase_add_test(tc_core, test_oidc_discovery_new_plugin_test);
   tcase_add_test(tc_core, test_oidc_discovery_delete_plugin);
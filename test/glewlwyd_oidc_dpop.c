@@ -179,6 +179,35 @@ START_TEST(test_oidc_dpop_add_plugin_nonce)
 }
 END_TEST
 
+START_TEST(test_oidc_dpop_add_plugin_jti_persist)
+{
+  json_t * j_param = json_pack("{sssssss{sssssssssisisisosososososisisssoso}}",
+                                "module", "oidc",
+                                "name", PLUGIN_NAME,
+                                "display_name", PLUGIN_NAME,
+                                "parameters",
+                                  "iss", "https://glewlwyd.tld",
+                                  "jwt-type", "sha",
+                                  "jwt-key-size", "256",
+                                  "key", "secret_" PLUGIN_NAME,
+                                  "access-token-duration", 3600,
+                                  "refresh-token-duration", 1209600,
+                                  "code-duration", 600,
+                                  "refresh-token-rolling", json_true(),
+                                  "allow-non-oidc", json_true(),
+                                  "auth-type-code-enabled", json_true(),
+                                  "auth-type-refresh-enabled", json_true(),
+                                  "oauth-dpop-allowed", json_true(),
+                                  "oauth-dpop-iat-duration", 60,
+                                  "oauth-dpop-iat-gap-duration", DPOP_IAT_GAP,
+                                  "oauth-dpop-dpop_bound_access_tokens-property", "dpop_client_bound",
+                                  "oauth-dpop-jti-persist", json_true(),
+                                  "introspection-revocation-allowed", json_true());
+  ck_assert_int_eq(run_simple_test(&admin_req, "POST", SERVER_URI "/mod/plugin/", NULL, NULL, j_param, NULL, 200, NULL, NULL, NULL), 1);
+  json_decref(j_param);
+}
+END_TEST
+
 START_TEST(test_oidc_dpop_add_client_confidential_ok)
 {
   json_t * j_parameters = json_pack("{sssssssos[sssss]s[s]s[ss]sssos[s]}",
@@ -1723,6 +1752,107 @@ START_TEST(test_oidc_dpop_userinfo_with_jkt_jti_replay)
 }
 END_TEST
 
+START_TEST(test_oidc_dpop_userinfo_with_jkt_jti_replay_persist)
+{
+  struct _u_response resp;
+  struct _u_request req;
+  char * code, jti[17], * dpop_token, * bearer;
+  json_t * j_result, * j_dpop_pub;
+  jwt_t * jwt_dpop;
+  jwk_t * jwk_dpop_pub;
+  unsigned char ath[32] = {0}, ath_enc[64] = {0};
+  size_t ath_len = 32, ath_enc_len = 64;
+  gnutls_datum_t hash_data;
+
+  ulfius_init_response(&resp);
+  o_free(user_req.http_url);
+  user_req.http_url = msprintf("%s/%s/auth?response_type=%s&g_continue&client_id=%s&redirect_uri=..%%2f..%%2ftest-oidc.html%%3fparam%%3dclient1_cb1&nonce=nonce1234&scope=%s", SERVER_URI, PLUGIN_NAME, RESPONSE_TYPE, CLIENT, SCOPE_LIST);
+  o_free(user_req.http_verb);
+  user_req.http_verb = o_strdup("GET");
+  ck_assert_int_eq(ulfius_send_http_request(&user_req, &resp), U_OK);
+  ck_assert_int_eq(resp.status, 302);
+  ck_assert_ptr_ne(o_strstr(u_map_get(resp.map_header, "Location"), "code="), NULL);
+  code = o_strdup(o_strstr(u_map_get(resp.map_header, "Location"), "code=") + o_strlen("code="));
+  if (o_strchr(code, '&')) {
+    *(o_strchr(code, '&')) = '\0';
+  }
+  ulfius_clean_response(&resp);
+  
+  ck_assert_int_eq(r_jwk_init(&jwk_dpop_pub), RHN_OK);
+  ck_assert_int_eq(r_jwk_import_from_json_str(jwk_dpop_pub, jwk_pubkey_sign_str), RHN_OK);
+  ck_assert_ptr_ne(NULL, j_dpop_pub = r_jwk_export_to_json_t(jwk_dpop_pub));
+  ck_assert_int_eq(r_jwt_init(&jwt_dpop), RHN_OK);
+  ck_assert_int_eq(r_jwt_add_sign_keys_json_str(jwt_dpop, jwk_privkey_sign_str, NULL), RHN_OK);
+  rand_jti(jti);
+  ck_assert_int_eq(r_jwt_set_sign_alg(jwt_dpop, R_JWA_ALG_RS256), RHN_OK);
+  ck_assert_int_eq(r_jwt_set_claim_str_value(jwt_dpop, "jti", jti), RHN_OK);
+  ck_assert_int_eq(r_jwt_set_claim_str_value(jwt_dpop, "htm", "POST"), RHN_OK);
+  ck_assert_int_eq(r_jwt_set_claim_str_value(jwt_dpop, "htu", SERVER_URI "/" PLUGIN_NAME "/token"), RHN_OK);
+  ck_assert_int_eq(r_jwt_set_claim_int_value(jwt_dpop, "iat", time(NULL)), RHN_OK);
+  ck_assert_int_eq(r_jwt_set_header_str_value(jwt_dpop, "typ", "dpop+jwt"), RHN_OK);
+  ck_assert_int_eq(r_jwt_set_header_json_t_value(jwt_dpop, "jwk", j_dpop_pub), RHN_OK);
+  ck_assert_ptr_ne(NULL, dpop_token = r_jwt_serialize_signed(jwt_dpop, NULL, 0));
+  
+  ulfius_init_request(&req);
+  ulfius_init_response(&resp);
+  ck_assert_int_eq(ulfius_set_request_properties(&req, 
+                                                 U_OPT_HTTP_VERB, "POST",
+                                                 U_OPT_HTTP_URL, SERVER_URI "/" PLUGIN_NAME "/token",
+                                                 U_OPT_POST_BODY_PARAMETER, "code", code,
+                                                 U_OPT_POST_BODY_PARAMETER, "grant_type", "authorization_code",
+                                                 U_OPT_POST_BODY_PARAMETER, "client_id", CLIENT,
+                                                 U_OPT_POST_BODY_PARAMETER, "redirect_uri", "../../test-oidc.html?param=client1_cb1",
+                                                 U_OPT_HEADER_PARAMETER, "DPoP", dpop_token,
+                                                 U_OPT_NONE), U_OK);
+  ck_assert_int_eq(ulfius_send_http_request(&req, &resp), U_OK);
+  ck_assert_int_eq(resp.status, 200);
+  ck_assert_ptr_ne(NULL, j_result = ulfius_get_json_body_response(&resp, NULL));
+  ulfius_clean_response(&resp);
+  ulfius_clean_request(&req);
+  o_free(dpop_token);
+  
+  hash_data.data = (unsigned char*)json_string_value(json_object_get(j_result, "access_token"));
+  hash_data.size = json_string_length(json_object_get(j_result, "access_token"));
+  ck_assert_int_eq(gnutls_fingerprint(GNUTLS_DIG_SHA256, &hash_data, ath, &ath_len), GNUTLS_E_SUCCESS);
+  ck_assert_int_eq(o_base64url_encode(ath, ath_len, ath_enc, &ath_enc_len), 1);
+  ath_enc[ath_enc_len] = '\0';
+
+  ulfius_init_request(&req);
+  ulfius_init_response(&resp);
+  rand_jti(jti);
+  ck_assert_int_eq(r_jwt_set_claim_str_value(jwt_dpop, "jti", jti), RHN_OK);
+  ck_assert_int_eq(r_jwt_set_claim_str_value(jwt_dpop, "htm", "GET"), RHN_OK);
+  ck_assert_int_eq(r_jwt_set_claim_str_value(jwt_dpop, "htu", SERVER_URI "/" PLUGIN_NAME "/userinfo"), RHN_OK);
+  ck_assert_int_eq(r_jwt_set_claim_str_value(jwt_dpop, "ath", (const char *)ath_enc), RHN_OK);
+  ck_assert_ptr_ne(NULL, dpop_token = r_jwt_serialize_signed(jwt_dpop, NULL, 0));
+  ck_assert_ptr_ne(NULL, bearer = msprintf("DPoP %s", json_string_value(json_object_get(j_result, "access_token"))));
+  ck_assert_int_eq(ulfius_set_request_properties(&req, 
+                                                 U_OPT_HTTP_VERB, "GET",
+                                                 U_OPT_HTTP_URL, SERVER_URI "/" PLUGIN_NAME "/userinfo",
+                                                 U_OPT_HEADER_PARAMETER, "DPoP", dpop_token,
+                                                 U_OPT_HEADER_PARAMETER, "Authorization", bearer,
+                                                 U_OPT_NONE), U_OK);
+  ck_assert_int_eq(ulfius_send_http_request(&req, &resp), U_OK);
+  ck_assert_int_eq(resp.status, 200);
+  ulfius_clean_response(&resp);
+  // The in-memory replay cache is emptied on reset, the jti must be rejected from the database
+  ck_assert_int_eq(run_simple_test(&admin_req, "PUT", SERVER_URI "/mod/plugin/" PLUGIN_NAME "/reset", NULL, NULL, NULL, NULL, 200, NULL, NULL, NULL), 1);
+  ulfius_init_response(&resp);
+  ck_assert_int_eq(ulfius_send_http_request(&req, &resp), U_OK);
+  ck_assert_int_eq(resp.status, 401);
+  
+  json_decref(j_result);
+  json_decref(j_dpop_pub);
+  ulfius_clean_response(&resp);
+  ulfius_clean_request(&req);
+  o_free(code);
+  o_free(bearer);
+  o_free(dpop_token);
+  r_jwt_free(jwt_dpop);
+  r_jwk_free(jwk_dpop_pub);
+}
+END_TEST
+
 START_TEST(test_oidc_dpop_introspection)
 {
   struct _u_response resp;
@@ -3737,6 +3867,12 @@ static Suite *glewlwyd_suite(void)
   tcase_add_test(tc_core, test_oidc_dpop_client_credentials_at_with_jkt_and_nonce_and_nonce_updated);
   tcase_add_test(tc_core, test_oidc_dpop_delete_client);
   tcase_add_test(tc_core, test_oidc_dpop_delete_plugin);
+  tcase_add_test(tc_core, test_oidc_dpop_add_plugin_jti_persist);
+  tcase_add_test(tc_core, test_oidc_dpop_add_client_confidential_ok);
+  tcase_add_test(tc_core, test_oidc_dpop_userinfo_with_jkt_jti_replay);
+  tcase_add_test(tc_core, test_oidc_dpop_userinfo_with_jkt_jti_replay_persist);
+  tcase_add_test(tc_core, test_oidc_dpop_delete_client);
+  tcase_add_test(tc_core, test_oidc_dpop_delete_plugin);
   tcase_set_timeout(tc_core, 30);
   suite_add_tcase(s, tc_core);
 
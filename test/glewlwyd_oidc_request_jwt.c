@@ -5,6 +5,7 @@
 #include <string.h>
 #include <errno.h>
 #include <time.h>
+#include <unistd.h>
 #include <gnutls/gnutls.h>
 #include <gnutls/crypto.h>
 #include <gnutls/abstract.h>
@@ -55,6 +56,7 @@
 #define CLIENT_PUBKEY_REDIRECT "https://glewlwyd.local/"
 #define CLIENT_SCOPE "scope1"
 #define KID_PUB "pubkey"
+#define JTI_RESET_NB_REQUEST 8
 
 struct _u_request admin_req;
 struct _u_request user_req;
@@ -837,6 +839,41 @@ START_TEST(test_oidc_request_jwt_add_module_request_signed)
 }
 END_TEST
 
+START_TEST(test_oidc_request_jwt_add_module_request_signed_jti_persist)
+{
+  json_t * j_parameters = json_pack("{sssssssos{sssssssssisisisosososososososososissssssso}}",
+                                "module", PLUGIN_MODULE,
+                                "name", PLUGIN_NAME,
+                                "display_name", PLUGIN_DISPLAY_NAME,
+                                "enabled", json_true(),
+                                "parameters",
+                                  "iss", PLUGIN_ISS,
+                                  "jwt-type", PLUGIN_JWT_TYPE,
+                                  "jwt-key-size", PLUGIN_JWT_KEY_SIZE,
+                                  "key", PLUGIN_KEY,
+                                  "code-duration", PLUGIN_CODE_DURATION,
+                                  "refresh-token-duration", PLUGIN_REFRESH_TOKEN_DURATION,
+                                  "access-token-duration", PLUGIN_ACCESS_TOKEN_DURATION,
+                                  "allow-non-oidc", json_true(),
+                                  "auth-type-client-enabled", json_true(),
+                                  "auth-type-code-enabled", json_true(),
+                                  "auth-type-token-enabled", json_true(),
+                                  "auth-type-implicit-enabled", json_true(),
+                                  "auth-type-password-enabled", json_true(),
+                                  "auth-type-refresh-enabled", json_true(),
+                                  "request-parameter-allow", json_true(),
+                                  "request-uri-allow-https-non-secure", json_true(),
+                                  "request-maximum-exp", CLIENT_AUTH_TOKEN_MAX_AGE,
+                                  "client-pubkey-parameter", CLIENT_PUBKEY_PARAM,
+                                  "client-jwks-parameter", CLIENT_JWKS_PARAM,
+                                  "client-jwks_uri-parameter", CLIENT_JWKS_URI_PARAM,
+                                  "request-jti-persist", json_true());
+
+  ck_assert_int_eq(run_simple_test(&admin_req, "POST", SERVER_URI "/mod/plugin/", NULL, NULL, j_parameters, NULL, 200, NULL, NULL, NULL), 1);
+  json_decref(j_parameters);
+}
+END_TEST
+
 START_TEST(test_oidc_request_jwt_add_client_pubkey)
 {
   json_t * j_client = json_pack("{ss ss ss so s[s] s[ssss] s[s] ss so s[ss]}", "client_id", CLIENT_PUBKEY_ID, "client_secret", CLIENT_SECRET, "name", CLIENT_PUBKEY_NAME, "confidential", json_true(), "redirect_uri", CLIENT_PUBKEY_REDIRECT, "authorization_type", "code", "token", "id_token", "client_credentials", "scope", CLIENT_SCOPE, "pubkey", pubkey_1_pem, "enabled", json_true(), "token_endpoint_auth_method", "private_key_jwt", "client_secret_jwt");
@@ -1546,6 +1583,163 @@ START_TEST(test_oidc_request_token_jwt_jti_duplicate)
 }
 END_TEST
 
+START_TEST(test_oidc_request_token_jwt_jwks_uri_cached)
+{
+  jwt_t * jwt_request = NULL;
+  char * request;
+  r_jwt_init(&jwt_request);
+  struct _u_instance instance;
+  int rnd;
+  gnutls_rnd(GNUTLS_RND_NONCE, &rnd, sizeof(int));
+  char jti[12] = {0};
+  struct _u_map body;
+  snprintf(jti, 11, "jti_%06d", rnd);
+  
+  ck_assert_int_eq(ulfius_init_instance(&instance, 7462, NULL, NULL), U_OK);
+  ck_assert_int_eq(ulfius_add_endpoint_by_val(&instance, "GET", "/jwks", NULL, 0, &callback_jwks_ok, NULL), U_OK);
+  
+  ck_assert_int_eq(ulfius_start_framework(&instance), U_OK);
+  
+  ck_assert_ptr_ne(jwt_request, NULL);
+  ck_assert_int_eq(r_jwt_set_sign_alg(jwt_request, R_JWA_ALG_RS256), RHN_OK);
+  ck_assert_int_eq(r_jwt_add_sign_keys_json_str(jwt_request, privkey_1_jwk, NULL), RHN_OK);
+  r_jwt_set_claim_str_value(jwt_request, "iss", CLIENT_PUBKEY_ID);
+  r_jwt_set_claim_str_value(jwt_request, "sub", CLIENT_PUBKEY_ID);
+  r_jwt_set_claim_str_value(jwt_request, "aud", SERVER_URI "/" PLUGIN_NAME "/token");
+  r_jwt_set_claim_str_value(jwt_request, "jti", jti);
+  r_jwt_set_claim_int_value(jwt_request, "exp", time(NULL)+(CLIENT_AUTH_TOKEN_MAX_AGE/2));
+  r_jwt_set_claim_int_value(jwt_request, "iat", time(NULL));
+  r_jwt_set_header_str_value(jwt_request, "kid", KID_PUB);
+  request = r_jwt_serialize_signed(jwt_request, NULL, 0);
+  ck_assert_ptr_ne(request, NULL);
+  
+  u_map_init(&body);
+  u_map_put(&body, "grant_type", "client_credentials");
+  u_map_put(&body, "scope", CLIENT_SCOPE);
+  u_map_put(&body, "client_assertion", request);
+  u_map_put(&body, "client_assertion_type", "urn:ietf:params:oauth:client-assertion-type:jwt-bearer");
+  ck_assert_int_eq(run_simple_test(&user_req, "POST", SERVER_URI "/" PLUGIN_NAME "/token", NULL, NULL, NULL, &body, 200, NULL, "access_token", NULL), 1);
+  
+  ulfius_stop_framework(&instance);
+  ulfius_clean_instance(&instance);
+  
+  // The client jwks is served from the cache
+  snprintf(jti, 11, "jtc_%06d", rnd);
+  r_jwt_set_claim_str_value(jwt_request, "jti", jti);
+  o_free(request);
+  request = r_jwt_serialize_signed(jwt_request, NULL, 0);
+  ck_assert_ptr_ne(request, NULL);
+  u_map_put(&body, "client_assertion", request);
+  ck_assert_int_eq(run_simple_test(&user_req, "POST", SERVER_URI "/" PLUGIN_NAME "/token", NULL, NULL, NULL, &body, 200, NULL, "access_token", NULL), 1);
+
+  u_map_clean(&body);
+  o_free(request);
+  r_jwt_free(jwt_request);
+}
+END_TEST
+
+START_TEST(test_oidc_request_token_jwt_jti_duplicate_persist)
+{
+  jwt_t * jwt_request = NULL;
+  char * request;
+  r_jwt_init(&jwt_request);
+  struct _u_instance instance;
+  int rnd;
+  gnutls_rnd(GNUTLS_RND_NONCE, &rnd, sizeof(int));
+  char jti[12] = {0};
+  struct _u_map body;
+  snprintf(jti, 11, "jti_%06d", rnd);
+  
+  ck_assert_int_eq(ulfius_init_instance(&instance, 7462, NULL, NULL), U_OK);
+  ck_assert_int_eq(ulfius_add_endpoint_by_val(&instance, "GET", "/jwks", NULL, 0, &callback_jwks_ok, NULL), U_OK);
+  
+  ck_assert_int_eq(ulfius_start_framework(&instance), U_OK);
+  
+  ck_assert_ptr_ne(jwt_request, NULL);
+  ck_assert_int_eq(r_jwt_set_sign_alg(jwt_request, R_JWA_ALG_RS256), RHN_OK);
+  ck_assert_int_eq(r_jwt_add_sign_keys_json_str(jwt_request, privkey_1_jwk, NULL), RHN_OK);
+  r_jwt_set_claim_str_value(jwt_request, "iss", CLIENT_PUBKEY_ID);
+  r_jwt_set_claim_str_value(jwt_request, "sub", CLIENT_PUBKEY_ID);
+  r_jwt_set_claim_str_value(jwt_request, "aud", SERVER_URI "/" PLUGIN_NAME "/token");
+  r_jwt_set_claim_str_value(jwt_request, "jti", jti);
+  r_jwt_set_claim_int_value(jwt_request, "exp", time(NULL)+(CLIENT_AUTH_TOKEN_MAX_AGE/2));
+  r_jwt_set_claim_int_value(jwt_request, "iat", time(NULL));
+  r_jwt_set_header_str_value(jwt_request, "kid", KID_PUB);
+  request = r_jwt_serialize_signed(jwt_request, NULL, 0);
+  ck_assert_ptr_ne(request, NULL);
+  
+  u_map_init(&body);
+  u_map_put(&body, "grant_type", "client_credentials");
+  u_map_put(&body, "scope", CLIENT_SCOPE);
+  u_map_put(&body, "client_assertion", request);
+  u_map_put(&body, "client_assertion_type", "urn:ietf:params:oauth:client-assertion-type:jwt-bearer");
+  ck_assert_int_eq(run_simple_test(&user_req, "POST", SERVER_URI "/" PLUGIN_NAME "/token", NULL, NULL, NULL, &body, 200, NULL, "access_token", NULL), 1);
+  // Empty the in-memory cache, the jti must be in the database even if its write is still queued
+  ck_assert_int_eq(run_simple_test(&admin_req, "PUT", SERVER_URI "/mod/plugin/" PLUGIN_NAME "/reset", NULL, NULL, NULL, NULL, 200, NULL, NULL, NULL), 1);
+  ck_assert_int_eq(run_simple_test(&user_req, "POST", SERVER_URI "/" PLUGIN_NAME "/token", NULL, NULL, NULL, &body, 403, NULL, NULL, NULL), 1);
+  
+  ulfius_stop_framework(&instance);
+  ulfius_clean_instance(&instance);
+
+  u_map_clean(&body);
+  o_free(request);
+  r_jwt_free(jwt_request);
+}
+END_TEST
+
+START_TEST(test_oidc_request_token_jwt_jti_duplicate_persist_reset)
+{
+  jwt_t * jwt_request = NULL;
+  char * request_list[JTI_RESET_NB_REQUEST];
+  struct _u_instance instance;
+  struct _u_map body;
+  int rnd, i;
+  char jti[20] = {0};
+
+  ck_assert_int_eq(ulfius_init_instance(&instance, 7462, NULL, NULL), U_OK);
+  ck_assert_int_eq(ulfius_add_endpoint_by_val(&instance, "GET", "/jwks", NULL, 0, &callback_jwks_ok, NULL), U_OK);
+  ck_assert_int_eq(ulfius_start_framework(&instance), U_OK);
+
+  gnutls_rnd(GNUTLS_RND_NONCE, &rnd, sizeof(int));
+  u_map_init(&body);
+  u_map_put(&body, "grant_type", "client_credentials");
+  u_map_put(&body, "scope", CLIENT_SCOPE);
+  u_map_put(&body, "client_assertion_type", "urn:ietf:params:oauth:client-assertion-type:jwt-bearer");
+  // Several requests in a row, so some jti writes are still queued when the plugin is reset
+  for (i=0; i<JTI_RESET_NB_REQUEST; i++) {
+    r_jwt_init(&jwt_request);
+    ck_assert_ptr_ne(jwt_request, NULL);
+    snprintf(jti, 19, "jti_%06d_%d", rnd, i);
+    ck_assert_int_eq(r_jwt_set_sign_alg(jwt_request, R_JWA_ALG_RS256), RHN_OK);
+    ck_assert_int_eq(r_jwt_add_sign_keys_json_str(jwt_request, privkey_1_jwk, NULL), RHN_OK);
+    r_jwt_set_claim_str_value(jwt_request, "iss", CLIENT_PUBKEY_ID);
+    r_jwt_set_claim_str_value(jwt_request, "sub", CLIENT_PUBKEY_ID);
+    r_jwt_set_claim_str_value(jwt_request, "aud", SERVER_URI "/" PLUGIN_NAME "/token");
+    r_jwt_set_claim_str_value(jwt_request, "jti", jti);
+    r_jwt_set_claim_int_value(jwt_request, "exp", time(NULL)+(CLIENT_AUTH_TOKEN_MAX_AGE/2));
+    r_jwt_set_claim_int_value(jwt_request, "iat", time(NULL));
+    r_jwt_set_header_str_value(jwt_request, "kid", KID_PUB);
+    request_list[i] = r_jwt_serialize_signed(jwt_request, NULL, 0);
+    ck_assert_ptr_ne(request_list[i], NULL);
+    r_jwt_free(jwt_request);
+    u_map_put(&body, "client_assertion", request_list[i]);
+    ck_assert_int_eq(run_simple_test(&user_req, "POST", SERVER_URI "/" PLUGIN_NAME "/token", NULL, NULL, NULL, &body, 200, NULL, "access_token", NULL), 1);
+  }
+  ck_assert_int_eq(run_simple_test(&admin_req, "PUT", SERVER_URI "/mod/plugin/" PLUGIN_NAME "/reset", NULL, NULL, NULL, NULL, 200, NULL, NULL, NULL), 1);
+
+  // Every jti is found in the database after the reset
+  for (i=0; i<JTI_RESET_NB_REQUEST; i++) {
+    u_map_put(&body, "client_assertion", request_list[i]);
+    ck_assert_int_eq(run_simple_test(&user_req, "POST", SERVER_URI "/" PLUGIN_NAME "/token", NULL, NULL, NULL, &body, 403, NULL, NULL, NULL), 1);
+    o_free(request_list[i]);
+  }
+
+  ulfius_stop_framework(&instance);
+  ulfius_clean_instance(&instance);
+  u_map_clean(&body);
+}
+END_TEST
+
 START_TEST(test_oidc_request_jwt_response_client_pubkey_invalid_signature)
 {
   jwt_t * jwt_request = NULL;
@@ -3146,6 +3340,7 @@ static Suite *glewlwyd_suite(void)
   tcase_add_test(tc_core, test_oidc_request_token_jwt_invalid_kid);
   tcase_add_test(tc_core, test_oidc_request_token_jwt_no_jti);
   tcase_add_test(tc_core, test_oidc_request_token_jwt_jti_duplicate);
+  tcase_add_test(tc_core, test_oidc_request_token_jwt_jwks_uri_cached);
   tcase_add_test(tc_core, test_oidc_request_jwt_response_client_pubkey_ok);
   tcase_add_test(tc_core, test_oidc_request_jwt_response_client_pubkey_invalid_signature);
   tcase_add_test(tc_core, test_oidc_request_jwt_response_client_pubkey_invalid_kid);
@@ -3197,6 +3392,12 @@ static Suite *glewlwyd_suite(void)
   tcase_add_test(tc_core, test_oidc_request_uri_ietf_jwt_response_invalid_typ);
   tcase_add_test(tc_core, test_oidc_request_jwt_delete_client_pubkey);
   tcase_add_test(tc_core, test_oidc_request_jwt_delete_module_request_signed);
+  tcase_add_test(tc_core, test_oidc_request_jwt_add_module_request_signed_jti_persist);
+  tcase_add_test(tc_core, test_oidc_request_jwt_add_client_pubkey);
+  tcase_add_test(tc_core, test_oidc_request_token_jwt_jti_duplicate_persist);
+  tcase_add_test(tc_core, test_oidc_request_token_jwt_jti_duplicate_persist_reset);
+  tcase_add_test(tc_core, test_oidc_request_jwt_delete_client_pubkey);
+  tcase_add_test(tc_core, test_oidc_request_jwt_delete_module_request_signed);
   tcase_set_timeout(tc_core, 30);
   suite_add_tcase(s, tc_core);
 
@@ -0,0 +1,273 @@
+/* Public domain, no copyright. Use at your own risk. */
+
+/**
+ * Password verification pool tests
+ * Runs blocking checks on the pool of password_pool.c to fill its queue,
+ * checks the workers lent as helper threads and the pool disabled with 0 workers
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <check.h>
+#include <orcania.h>
+#include <yder.h>
+
+#include "../src/glewlwyd.h"
+
+#define POOL_MAX_WAIT 10
+
+static struct config_elements * config;
+static pthread_mutex_t check_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t check_cond = PTHREAD_COND_INITIALIZER;
+static int check_released;
+static unsigned int nb_check;
+static pthread_t check_thread;
+
+struct _pool_check_thread {
+  pthread_t thread;
+  int       result;
+};
+
+static void setup(void) {
+  ck_assert_ptr_ne(NULL, config = o_malloc(sizeof(struct config_elements)));
+  memset(config, 0, sizeof(struct config_elements));
+  check_released = 0;
+  nb_check = 0;
+}
+
+static void teardown(void) {
+  glewlwyd_password_pool_close(config);
+  o_free(config);
+}
+
+/**
+ * Password check waiting until the test releases it
+ */
+static int check_blocking(void * data) {
+  (void)data;
+  pthread_mutex_lock(&check_lock);
+  nb_check++;
+  while (!check_released) {
+    pthread_cond_wait(&check_cond, &check_lock);
+  }
+  pthread_mutex_unlock(&check_lock);
+  return G_OK;
+}
+
+/**
+ * Password check returning an invalid password from the thread running it
+ */
+static int check_invalid(void * data) {
+  (void)data;
+  pthread_mutex_lock(&check_lock);
+  nb_check++;
+  check_thread = pthread_self();
+  pthread_mutex_unlock(&check_lock);
+  return G_ERROR_UNAUTHORIZED;
+}
+
+static void release_checks(void) {
+  pthread_mutex_lock(&check_lock);
+  check_released = 1;
+  pthread_cond_broadcast(&check_cond);
+  pthread_mutex_unlock(&check_lock);
+}
+
+static void * run_check_thread(void * args) {
+  struct _pool_check_thread * check = (struct _pool_check_thread *)args;
+
+  check->result = glewlwyd_password_pool_check(config, check_blocking, NULL);
+  return NULL;
+}
+
+/**
+ * Waits until the pool has nb_running checks running and size checks in the queue
+ */
+static void wait_pool(unsigned int nb_running, size_t size) {
+  int found = 0, i;
+
+  for (i=0; !found && i<POOL_MAX_WAIT*10; i++) {
+    pthread_mutex_lock(&config->password_pool.lock);
+    found = (config->password_pool.nb_running == nb_running && config->password_pool.size == size);
+    pthread_mutex_unlock(&config->password_pool.lock);
+    if (!found) {
+      usleep(100000);
+    }
+  }
+  ck_assert_int_eq(found, 1);
+}
+
+static void * run_close_thread(void * args) {
+  (void)args;
+  glewlwyd_password_pool_close(config);
+  return NULL;
+}
+
+START_TEST(test_glwd_password_pool_full)
+{
+  struct _pool_check_thread running, queued;
+
+  config->password_pool.nb_worker = 1;
+  config->password_pool.max_size = 1;
+  ck_assert_int_eq(glewlwyd_password_pool_init(config), G_OK);
+  ck_assert_int_eq(pthread_create(&running.thread, NULL, run_check_thread, &running), 0);
+  wait_pool(1, 0);
+  ck_assert_int_eq(pthread_create(&queued.thread, NULL, run_check_thread, &queued), 0);
+  wait_pool(1, 1);
+
+  // The queue is full, the check is rejected without being run
+  ck_assert_int_eq(glewlwyd_password_pool_check(config, check_invalid, NULL), G_ERROR_UNAVAILABLE);
+  ck_assert_int_eq(config->password_pool.nb_rejected, 1);
+
+  release_checks();
+  pthread_join(running.thread, NULL);
+  pthread_join(queued.thread, NULL);
+  ck_assert_int_eq(running.result, G_OK);
+  ck_assert_int_eq(queued.result, G_OK);
+  ck_assert_int_eq(nb_check, 2);
+  ck_assert_int_eq(config->password_pool.nb_done, 2);
+
+  // The queue has room again
+  ck_assert_int_eq(glewlwyd_password_pool_check(config, check_invalid, NULL), G_ERROR_UNAUTHORIZED);
+  ck_assert_int_eq(pthread_equal(check_thread, pthread_self()), 0);
+}
+END_TEST
+
+START_TEST(test_glwd_password_pool_close)
+{
+  struct _pool_check_thread running, queued;
+  pthread_t close_thread;
+  unsigned short stop = 0;
+  int i;
+
+  config->password_pool.nb_worker = 1;
+  config->password_pool.max_size = 2;
+  ck_assert_int_eq(glewlwyd_password_pool_init(config), G_OK);
+  ck_assert_int_eq(pthread_create(&running.thread, NULL, run_check_thread, &running), 0);
+  wait_pool(1, 0);
+  ck_assert_int_eq(pthread_create(&queued.thread, NULL, run_check_thread, &queued), 0);
+  wait_pool(1, 1);
+  ck_assert_int_eq(pthread_create(&close_thread, NULL, run_close_thread, NULL), 0);
+  for (i=0; !stop && i<POOL_MAX_WAIT*10; i++) {
+    pthread_mutex_lock(&config->password_pool.lock);
+    stop = config->password_pool.stop;
+    pthread_mutex_unlock(&config->password_pool.lock);
+    if (!stop) {
+      usleep(100000);
+    }
+  }
+  ck_assert_int_eq(stop, 1);
+
+  // The running check completes, the queued check isn't run
+  release_checks();
+  pthread_join(close_thread, NULL);
+  pthread_join(running.thread, NULL);
+  pthread_join(queued.thread, NULL);
+  ck_assert_int_eq(running.result, G_OK);
+  ck_assert_int_eq(queued.result, G_ERROR_UNAVAILABLE);
+  ck_assert_int_eq(nb_check, 1);
+}
+END_TEST
+
+START_TEST(test_glwd_password_pool_helper)
+{
+  struct _pool_check_thread running, queued;
+
+  config->password_pool.nb_worker = 3;
+  config->password_pool.max_size = 2;
+  ck_assert_int_eq(glewlwyd_password_pool_init(config), G_OK);
+  ck_assert_int_eq(pthread_create(&running.thread, NULL, run_check_thread, &running), 0);
+  wait_pool(1, 0);
+
+  // Only the 2 idle workers can be lent as helpers
+  ck_assert_int_eq(glewlwyd_password_pool_reserve_helper(config, 4), 2);
+  ck_assert_int_eq(glewlwyd_password_pool_reserve_helper(config, 1), 0);
+
+  // The next check waits until the helpers are released
+  ck_assert_int_eq(pthread_create(&queued.thread, NULL, run_check_thread, &queued), 0);
+  wait_pool(1, 1);
+  usleep(200000);
+  wait_pool(1, 1);
+  glewlwyd_password_pool_release_helper(config, 2);
+  wait_pool(2, 0);
+
+  release_checks();
+  pthread_join(running.thread, NULL);
+  pthread_join(queued.thread, NULL);
+  ck_assert_int_eq(running.result, G_OK);
+  ck_assert_int_eq(queued.result, G_OK);
+  ck_assert_int_eq(glewlwyd_password_pool_reserve_helper(config, 4), 3);
+  glewlwyd_password_pool_release_helper(config, 3);
+}
+END_TEST
+
+START_TEST(test_glwd_password_pool_disabled)
+{
+  unsigned int i;
+
+  config->password_pool.nb_worker = 0;
+  config->password_pool.max_size = 0;
+  ck_assert_int_eq(glewlwyd_password_pool_init(config), G_OK);
+
+  // The checks are run by the calling thread and never rejected
+  for (i=0; i<8; i++) {
+    ck_assert_int_eq(glewlwyd_password_pool_check(config, check_invalid, NULL), G_ERROR_UNAUTHORIZED);
+    ck_assert_int_eq(pthread_equal(check_thread, pthread_self()), 1);
+  }
+  ck_assert_int_eq(nb_check, 8);
+  ck_assert_int_eq(config->password_pool.nb_rejected, 0);
+  ck_assert_int_eq(glewlwyd_password_pool_check(config, NULL, NULL), G_ERROR_PARAM);
+  // The helpers aren't bounded without a pool
+  ck_assert_int_eq(glewlwyd_password_pool_reserve_helper(config, 4), 4);
+}
+END_TEST
+
+START_TEST(test_glwd_password_pool_invalid)
+{
+  config->password_pool.nb_worker = 2;
+  config->password_pool.max_size = 0;
+  ck_assert_int_eq(glewlwyd_password_pool_init(config), G_ERROR_PARAM);
+}
+END_TEST
+
+static Suite *glewlwyd_suite(void)
+{
+  Suite *s;
+  TCase *tc_core;
+
+  s = suite_create("Glewlwyd password pool");
+  tc_core = tcase_create("test_glwd_password_pool");
+  tcase_add_checked_fixture(tc_core, setup, teardown);
+  tcase_add_test(tc_core, test_glwd_password_pool_full);
+  tcase_add_test(tc_core, test_glwd_password_pool_close);
+  tcase_add_test(tc_core, test_glwd_password_pool_helper);
+  tcase_add_test(tc_core, test_glwd_password_pool_disabled);
+  tcase_add_test(tc_core, test_glwd_password_pool_invalid);
+  tcase_set_timeout(tc_core, 30);
+  suite_add_tcase(s, tc_core);
+
+  return s;
+}
+
+int main(void)
+{
+  int number_failed;
+  Suite *s;
+  SRunner *sr;
+
+  y_init_logs("Glewlwyd test", Y_LOG_MODE_CONSOLE, Y_LOG_LEVEL_DEBUG, NULL, "Starting Glewlwyd password pool tests");
+  s = glewlwyd_suite();
+  sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_VERBOSE);
+  number_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  y_close_logs();
+
+  return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,227 @@
+/* Public domain, no copyright. Use at your own risk. */
+
+/**
+ * Password verification pool full tests
+ * Must be run on an instance started with glewlwyd-password-pool.conf,
+ * 1 worker and 1 queued verification, so a burst of logins fills the queue
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <check.h>
+#include <ulfius.h>
+#include <orcania.h>
+#include <yder.h>
+
+#include "unit-tests.h"
+
+#define SERVER_URI "http://localhost:4593/api"
+#define USERNAME "user1"
+#define PASSWORD "password"
+#define SCOPE_LIST "g_profile scope3"
+#define CLIENT "client3_id"
+#define CLIENT_PASSWORD "password"
+#define CLIENT_SCOPE_LIST "scope2 scope3"
+#define RETRY_AFTER "1"
+#define ERROR_UNAVAILABLE "temporarily_unavailable"
+
+#define BURST_NB_THREAD 32
+#define BURST_MAX_ROUND 10
+
+#define BURST_LOGIN              0
+#define BURST_CLIENT_CREDENTIALS 1
+#define BURST_REFRESH_TOKEN      2
+
+struct _burst_thread {
+  pthread_t    thread;
+  int          type;
+  const char * url;
+  const char * refresh_token;
+  long         status;
+  int          retry_after_valid;
+  int          error_valid;
+};
+
+char * refresh_token_oauth2 = NULL, * refresh_token_oidc = NULL;
+
+static void * run_burst_thread(void * args) {
+  struct _burst_thread * burst = (struct _burst_thread *)args;
+  struct _u_request req;
+  struct _u_response resp;
+  json_t * j_body;
+
+  ulfius_init_request(&req);
+  ulfius_init_response(&resp);
+  ulfius_set_request_properties(&req, U_OPT_HTTP_VERB, "POST", U_OPT_HTTP_URL, burst->url, U_OPT_NONE);
+  if (burst->type == BURST_LOGIN) {
+    j_body = json_pack("{ssss}", "username", USERNAME, "password", PASSWORD);
+    ulfius_set_json_body_request(&req, j_body);
+    json_decref(j_body);
+  } else {
+    ulfius_set_request_properties(&req, U_OPT_AUTH_BASIC_USER, CLIENT, U_OPT_AUTH_BASIC_PASSWORD, CLIENT_PASSWORD, U_OPT_NONE);
+    if (burst->type == BURST_CLIENT_CREDENTIALS) {
+      ulfius_set_request_properties(&req, U_OPT_POST_BODY_PARAMETER, "grant_type", "client_credentials", U_OPT_POST_BODY_PARAMETER, "scope", CLIENT_SCOPE_LIST, U_OPT_NONE);
+    } else {
+      ulfius_set_request_properties(&req, U_OPT_POST_BODY_PARAMETER, "grant_type", "refresh_token", U_OPT_POST_BODY_PARAMETER, "refresh_token", burst->refresh_token, U_OPT_NONE);
+    }
+  }
+  burst->status = 0;
+  if (ulfius_send_http_request(&req, &resp) == U_OK) {
+    burst->status = resp.status;
+    burst->retry_after_valid = (0 == o_strcmp(RETRY_AFTER, u_map_get_case(resp.map_header, "Retry-After")));
+    j_body = ulfius_get_json_body_response(&resp, NULL);
+    burst->error_valid = (0 == o_strcmp(ERROR_UNAVAILABLE, json_string_value(json_object_get(j_body, "error"))));
+    json_decref(j_body);
+  }
+  ulfius_clean_request(&req);
+  ulfius_clean_response(&resp);
+  return NULL;
+}
+
+/**
+ * Sends bursts of BURST_NB_THREAD concurrent requests until one is rejected
+ * Every response must be a success or a 503 with the Retry-After header
+ */
+static void run_burst(int type, const char * url, const char * refresh_token) {
+  struct _burst_thread burst_list[BURST_NB_THREAD];
+  size_t nb_ok = 0, nb_unavailable = 0, i, round;
+
+  for (round=0; !nb_unavailable && round<BURST_MAX_ROUND; round++) {
+    for (i=0; i<BURST_NB_THREAD; i++) {
+      burst_list[i].type = type;
+      burst_list[i].url = url;
+      burst_list[i].refresh_token = refresh_token;
+      burst_list[i].retry_after_valid = 0;
+      burst_list[i].error_valid = 0;
+      ck_assert_int_eq(pthread_create(&burst_list[i].thread, NULL, run_burst_thread, &burst_list[i]), 0);
+    }
+    for (i=0; i<BURST_NB_THREAD; i++) {
+      pthread_join(burst_list[i].thread, NULL);
+    }
+    for (i=0; i<BURST_NB_THREAD; i++) {
+      if (burst_list[i].status == 200) {
+        nb_ok++;
+      } else {
+        ck_assert_int_eq(burst_list[i].status, 503);
+        ck_assert_int_eq(burst_list[i].retry_after_valid, 1);
+        if (type != BURST_LOGIN) {
+          ck_assert_int_eq(burst_list[i].error_valid, 1);
+        }
+        nb_unavailable++;
+      }
+    }
+  }
+  ck_assert_int_gt(nb_ok, 0);
+  ck_assert_int_gt(nb_unavailable, 0);
+}
+
+/**
+ * Gets a refresh token with the password grant, retried while the queue is full
+ */
+static char * get_refresh_token(const char * url) {
+  struct _u_request req;
+  struct _u_response resp;
+  json_t * j_body;
+  char * refresh_token = NULL;
+  int i;
+
+  for (i=0; refresh_token == NULL && i<BURST_MAX_ROUND; i++) {
+    ulfius_init_request(&req);
+    ulfius_init_response(&resp);
+    ulfius_set_request_properties(&req,
+                                  U_OPT_HTTP_VERB, "POST",
+                                  U_OPT_HTTP_URL, url,
+                                  U_OPT_AUTH_BASIC_USER, CLIENT,
+                                  U_OPT_AUTH_BASIC_PASSWORD, CLIENT_PASSWORD,
+                                  U_OPT_POST_BODY_PARAMETER, "grant_type", "password",
+                                  U_OPT_POST_BODY_PARAMETER, "username", USERNAME,
+                                  U_OPT_POST_BODY_PARAMETER, "password", PASSWORD,
+                                  U_OPT_POST_BODY_PARAMETER, "scope", SCOPE_LIST,
+                                  U_OPT_NONE);
+    if (ulfius_send_http_request(&req, &resp) == U_OK && resp.status == 200) {
+      j_body = ulfius_get_json_body_response(&resp, NULL);
+      refresh_token = o_strdup(json_string_value(json_object_get(j_body, "refresh_token")));
+      json_decref(j_body);
+    }
+    ulfius_clean_request(&req);
+    ulfius_clean_response(&resp);
+  }
+  return refresh_token;
+}
+
+START_TEST(test_glwd_password_pool_full_login)
+{
+  run_burst(BURST_LOGIN, SERVER_URI "/auth/", NULL);
+}
+END_TEST
+
+START_TEST(test_glwd_password_pool_full_oauth2_client_credentials)
+{
+  run_burst(BURST_CLIENT_CREDENTIALS, SERVER_URI "/glwd/token/", NULL);
+}
+END_TEST
+
+START_TEST(test_glwd_password_pool_full_oauth2_refresh_token)
+{
+  ck_assert_ptr_ne(NULL, refresh_token_oauth2);
+  run_burst(BURST_REFRESH_TOKEN, SERVER_URI "/glwd/token/", refresh_token_oauth2);
+}
+END_TEST
+
+START_TEST(test_glwd_password_pool_full_oidc_client_credentials)
+{
+  run_burst(BURST_CLIENT_CREDENTIALS, SERVER_URI "/oidc/token/", NULL);
+}
+END_TEST
+
+START_TEST(test_glwd_password_pool_full_oidc_refresh_token)
+{
+  ck_assert_ptr_ne(NULL, refresh_token_oidc);
+  run_burst(BURST_REFRESH_TOKEN, SERVER_URI "/oidc/token/", refresh_token_oidc);
+}
+END_TEST
+
+static Suite *glewlwyd_suite(void)
+{
+  Suite *s;
+  TCase *tc_core;
+
+  s = suite_create("Glewlwyd password pool full");
+  tc_core = tcase_create("test_glwd_password_pool_full");
+  tcase_add_test(tc_core, test_glwd_password_pool_full_login);
+  tcase_add_test(tc_core, test_glwd_password_pool_full_oauth2_client_credentials);
+  tcase_add_test(tc_core, test_glwd_password_pool_full_oauth2_refresh_token);
+  tcase_add_test(tc_core, test_glwd_password_pool_full_oidc_client_credentials);
+  tcase_add_test(tc_core, test_glwd_password_pool_full_oidc_refresh_token);
+  tcase_set_timeout(tc_core, 60);
+  suite_add_tcase(s, tc_core);
+
+  return s;
+}
+
+int main(int argc, char *argv[])
+{
+  int number_failed;
+  Suite *s;
+  SRunner *sr;
+
+  y_init_logs("Glewlwyd test", Y_LOG_MODE_CONSOLE, Y_LOG_LEVEL_DEBUG, NULL, "Starting Glewlwyd password pool full tests");
+  refresh_token_oauth2 = get_refresh_token(SERVER_URI "/glwd/token/");
+  refresh_token_oidc = get_refresh_token(SERVER_URI "/oidc/token/");
+
+  s = glewlwyd_suite();
+  sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_VERBOSE);
+  number_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  o_free(refresh_token_oauth2);
+  o_free(refresh_token_oidc);
+  y_close_logs();
+
+  return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
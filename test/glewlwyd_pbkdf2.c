@@ -0,0 +1,200 @@
+/* Public domain, no copyright. Use at your own risk. */
+
+/**
+ * PBKDF2 known-answer tests
+ * Checks that the multi-buffer PBKDF2 digests of pbkdf2.c
+ * are the same as the digests of generate_digest_pbkdf2
+ * The expected digests were computed with generate_digest_pbkdf2
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <check.h>
+#include <orcania.h>
+#include <yder.h>
+
+#include "../src/glewlwyd-common.h"
+
+#define PBKDF2_DIGEST_SIZE 128
+#define PBKDF2_NB_KAT      5
+#define PBKDF2_NB_BATCH    37
+
+struct _pbkdf2_kat {
+  const char * password;
+  unsigned int iterations;
+  const char * salt;
+  const char * digest;
+};
+
+static const struct _pbkdf2_kat kat_list[PBKDF2_NB_KAT] = {
+  {"password", 1000, "abcdefghijklmnop", "zmpYmraJ8a17OK9Yol0wrW9/A1PnsRg6/JUmt47UJG9hYmNkZWZnaGlqa2xtbm9w"},
+  {"", 1, "0123456789abcdef", "moqAVuINiBoWSAWnx8lm5dC4MOzq9bszXOTTyglip60wMTIzNDU2Nzg5YWJjZGVm"},
+  {"MyPassword171", 2, "ponmlkjihgfedcba", "QEy1GCvJfy+3NsqY1n6yg74FogJ6MqJC8rQIHeb0GKlwb25tbGtqaWhnZmVkY2Jh"},
+  {"password-longer-than-the-sha256-block-size-0123456789abcdefghijklmnopqrstuvwxyz", 4096, "ABCDEFGHIJKLMNOP", "lJqtcTsrpRZU9+Ck2fHysl4PxVZLnwBVwz4cY5vFFMpBQkNERUZHSElKS0xNTk9Q"},
+  {"passw\xc3\xb8rd", 10000, "qrstuvwxyzABCDEF", "4iJcJFIAQVXQoeKFoInaVTIs/fvWDWenivOqL0KRmmpxcnN0dXZ3eHl6QUJDREVG"}
+};
+
+START_TEST(test_glwd_pbkdf2_kat_single)
+{
+  char digest[PBKDF2_DIGEST_SIZE], * digest_list[1] = {digest};
+  const char * data_list[1], * salt_list[1];
+  unsigned int iterations_list[1];
+  size_t i;
+
+  for (i=0; i<PBKDF2_NB_KAT; i++) {
+    memset(digest, 0, PBKDF2_DIGEST_SIZE);
+    ck_assert_int_eq(generate_digest_pbkdf2(kat_list[i].password, kat_list[i].iterations, kat_list[i].salt, digest), 1);
+    ck_assert_str_eq(digest, kat_list[i].digest);
+
+    memset(digest, 0, PBKDF2_DIGEST_SIZE);
+    data_list[0] = kat_list[i].password;
+    iterations_list[0] = kat_list[i].iterations;
+    salt_list[0] = kat_list[i].salt;
+    ck_assert_int_eq(generate_digest_pbkdf2_multi(1, data_list, iterations_list, salt_list, digest_list), 1);
+    ck_assert_str_eq(digest, kat_list[i].digest);
+  }
+}
+END_TEST
+
+START_TEST(test_glwd_pbkdf2_kat_multi)
+{
+  char digest[PBKDF2_NB_BATCH][PBKDF2_DIGEST_SIZE], * digest_list[PBKDF2_NB_BATCH];
+  const char * data_list[PBKDF2_NB_BATCH], * salt_list[PBKDF2_NB_BATCH];
+  unsigned int iterations_list[PBKDF2_NB_BATCH];
+  size_t i;
+
+  // Mixed iterations in the same batch, and more digests than lanes
+  memset(digest, 0, sizeof(digest));
+  for (i=0; i<PBKDF2_NB_BATCH; i++) {
+    data_list[i] = kat_list[i%PBKDF2_NB_KAT].password;
+    iterations_list[i] = kat_list[i%PBKDF2_NB_KAT].iterations;
+    salt_list[i] = kat_list[i%PBKDF2_NB_KAT].salt;
+    digest_list[i] = digest[i];
+  }
+  ck_assert_int_eq(generate_digest_pbkdf2_multi(PBKDF2_NB_KAT, data_list, iterations_list, salt_list, digest_list), 1);
+  for (i=0; i<PBKDF2_NB_KAT; i++) {
+    ck_assert_str_eq(digest[i], kat_list[i].digest);
+  }
+
+  memset(digest, 0, sizeof(digest));
+  ck_assert_int_eq(generate_digest_pbkdf2_multi(generate_digest_pbkdf2_lanes(), data_list, iterations_list, salt_list, digest_list), 1);
+  for (i=0; i<generate_digest_pbkdf2_lanes(); i++) {
+    ck_assert_str_eq(digest[i], kat_list[i%PBKDF2_NB_KAT].digest);
+  }
+
+  memset(digest, 0, sizeof(digest));
+  ck_assert_int_eq(generate_digest_pbkdf2_multi(PBKDF2_NB_BATCH, data_list, iterations_list, salt_list, digest_list), 1);
+  for (i=0; i<PBKDF2_NB_BATCH; i++) {
+    ck_assert_str_eq(digest[i], kat_list[i%PBKDF2_NB_KAT].digest);
+  }
+}
+END_TEST
+
+START_TEST(test_glwd_pbkdf2_multi_min)
+{
+  char digest[PBKDF2_NB_BATCH][PBKDF2_DIGEST_SIZE], * digest_list[PBKDF2_NB_BATCH];
+  const char * data_list[PBKDF2_NB_BATCH], * salt_list[PBKDF2_NB_BATCH];
+  unsigned int iterations_list[PBKDF2_NB_BATCH];
+  size_t nb_list[3], i, j;
+
+  ck_assert_int_eq(generate_digest_pbkdf2_multi_min(), generate_digest_pbkdf2_lanes()/GLEWLWYD_PBKDF2_MULTI_MIN_RATIO);
+  for (i=0; i<PBKDF2_NB_BATCH; i++) {
+    data_list[i] = kat_list[i%PBKDF2_NB_KAT].password;
+    iterations_list[i] = kat_list[i%PBKDF2_NB_KAT].iterations;
+    salt_list[i] = kat_list[i%PBKDF2_NB_KAT].salt;
+    digest_list[i] = digest[i];
+  }
+  // A batch one digest too small for the multi-buffer kernel, the smallest batch using it,
+  // and a full batch followed by a batch too small
+  nb_list[0] = generate_digest_pbkdf2_multi_min()>1?generate_digest_pbkdf2_multi_min()-1:1;
+  nb_list[1] = generate_digest_pbkdf2_multi_min()>1?generate_digest_pbkdf2_multi_min():2;
+  nb_list[2] = generate_digest_pbkdf2_lanes()+nb_list[0];
+  for (i=0; i<3; i++) {
+    memset(digest, 0, sizeof(digest));
+    ck_assert_int_eq(generate_digest_pbkdf2_multi(nb_list[i], data_list, iterations_list, salt_list, digest_list), 1);
+    for (j=0; j<nb_list[i]; j++) {
+      ck_assert_str_eq(digest[j], kat_list[j%PBKDF2_NB_KAT].digest);
+    }
+  }
+}
+END_TEST
+
+START_TEST(test_glwd_pbkdf2_random_salt)
+{
+  char digest[PBKDF2_NB_KAT][PBKDF2_DIGEST_SIZE], * digest_list[PBKDF2_NB_KAT], salt[GLEWLWYD_DEFAULT_SALT_LENGTH+1], expected[PBKDF2_DIGEST_SIZE];
+  unsigned char decoded[PBKDF2_DIGEST_SIZE];
+  const char * data_list[PBKDF2_NB_KAT];
+  unsigned int iterations_list[PBKDF2_NB_KAT];
+  size_t i, decoded_len;
+
+  memset(digest, 0, sizeof(digest));
+  for (i=0; i<PBKDF2_NB_KAT; i++) {
+    data_list[i] = kat_list[i].password;
+    iterations_list[i] = kat_list[i].iterations;
+    digest_list[i] = digest[i];
+  }
+  ck_assert_int_eq(generate_digest_pbkdf2_multi(PBKDF2_NB_KAT, data_list, iterations_list, NULL, digest_list), 1);
+  for (i=0; i<PBKDF2_NB_KAT; i++) {
+    ck_assert_int_eq(o_base64_decode((const unsigned char *)digest[i], o_strlen(digest[i]), decoded, &decoded_len), 1);
+    ck_assert_int_eq(decoded_len, 32 + GLEWLWYD_DEFAULT_SALT_LENGTH);
+    memcpy(salt, decoded+32, GLEWLWYD_DEFAULT_SALT_LENGTH);
+    salt[GLEWLWYD_DEFAULT_SALT_LENGTH] = '\0';
+    memset(expected, 0, PBKDF2_DIGEST_SIZE);
+    ck_assert_int_eq(generate_digest_pbkdf2(kat_list[i].password, kat_list[i].iterations, salt, expected), 1);
+    ck_assert_str_eq(digest[i], expected);
+  }
+}
+END_TEST
+
+START_TEST(test_glwd_pbkdf2_invalid)
+{
+  char digest[2][PBKDF2_DIGEST_SIZE], * digest_list[2] = {digest[0], digest[1]};
+  const char * data_list[2] = {"password", "password"}, * invalid_data_list[2] = {"password", NULL};
+  unsigned int iterations_list[2] = {1000, 1000}, invalid_iterations_list[2] = {1000, 0};
+
+  ck_assert_int_eq(generate_digest_pbkdf2_multi(2, NULL, iterations_list, NULL, digest_list), 0);
+  ck_assert_int_eq(generate_digest_pbkdf2_multi(2, data_list, NULL, NULL, digest_list), 0);
+  ck_assert_int_eq(generate_digest_pbkdf2_multi(2, data_list, iterations_list, NULL, NULL), 0);
+  ck_assert_int_eq(generate_digest_pbkdf2_multi(2, invalid_data_list, iterations_list, NULL, digest_list), 0);
+  ck_assert_int_eq(generate_digest_pbkdf2_multi(2, data_list, invalid_iterations_list, NULL, digest_list), 0);
+}
+END_TEST
+
+static Suite *glewlwyd_suite(void)
+{
+  Suite *s;
+  TCase *tc_core;
+
+  s = suite_create("Glewlwyd pbkdf2");
+  tc_core = tcase_create("test_glwd_pbkdf2");
+  tcase_add_test(tc_core, test_glwd_pbkdf2_kat_single);
+  tcase_add_test(tc_core, test_glwd_pbkdf2_kat_multi);
+  tcase_add_test(tc_core, test_glwd_pbkdf2_multi_min);
+  tcase_add_test(tc_core, test_glwd_pbkdf2_random_salt);
+  tcase_add_test(tc_core, test_glwd_pbkdf2_invalid);
+  tcase_set_timeout(tc_core, 30);
+  suite_add_tcase(s, tc_core);
+
+  return s;
+}
+
+int main(void)
+{
+  int number_failed;
+  Suite *s;
+  SRunner *sr;
+
+  y_init_logs("Glewlwyd test", Y_LOG_MODE_CONSOLE, Y_LOG_LEVEL_DEBUG, NULL, "Starting Glewlwyd pbkdf2 tests");
+  s = glewlwyd_suite();
+  sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_VERBOSE);
+  number_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  y_close_logs();
+
+  return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
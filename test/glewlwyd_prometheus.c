@@ -322,6 +322,117 @@ START_TEST(test_glwd_prometheus_metrics_glwd_flow_ok)
 }
 END_TEST
 
+START_TEST(test_glwd_prometheus_metrics_database_pool)
+{
+  int nb_checkout_1, nb_checkout_2, pool_size, nb_in_use;
+
+  ck_assert_int_gt(pool_size = get_metrics("glewlwyd_database_pool_size", NULL), 0);
+  ck_assert_int_ne(-1, nb_in_use = get_metrics("glewlwyd_database_pool_in_use", NULL));
+  ck_assert_int_le(nb_in_use, pool_size);
+  ck_assert_int_ne(-1, nb_checkout_1 = get_metrics("glewlwyd_database_pool_checkout_total", NULL));
+  ck_assert_int_eq(run_simple_test(&user_req, "GET", SERVER_URI "/profile_list/", NULL, NULL, NULL, NULL, 200, NULL, NULL, NULL), 1);
+  ck_assert_int_ne(-1, nb_checkout_2 = get_metrics("glewlwyd_database_pool_checkout_total", NULL));
+  ck_assert_int_gt(nb_checkout_2, nb_checkout_1);
+  ck_assert_int_ne(-1, get_metrics("glewlwyd_database_pool_wait_total", NULL));
+}
+END_TEST
+
+START_TEST(test_glwd_prometheus_metrics_user_cache)
+{
+  json_t * j_labels = json_pack("{ss}", "cache", "user");
+  int nb_hit_1, nb_hit_2;
+
+  ck_assert_int_eq(run_simple_test(&user_req, "GET", SERVER_URI "/profile_list/", NULL, NULL, NULL, NULL, 200, NULL, NULL, NULL), 1);
+  ck_assert_int_gt(get_metrics("glewlwyd_cache_entries", j_labels), 0);
+  ck_assert_int_ne(-1, nb_hit_1 = get_metrics("glewlwyd_cache_hit_total", j_labels));
+  ck_assert_int_ne(-1, get_metrics("glewlwyd_cache_miss_total", j_labels));
+  ck_assert_int_eq(run_simple_test(&user_req, "GET", SERVER_URI "/profile_list/", NULL, NULL, NULL, NULL, 200, NULL, NULL, NULL), 1);
+  ck_assert_int_ne(-1, nb_hit_2 = get_metrics("glewlwyd_cache_hit_total", j_labels));
+  ck_assert_int_gt(nb_hit_2, nb_hit_1);
+  ck_assert_int_ne(-1, get_metrics("glewlwyd_cache_eviction_total", j_labels));
+  json_decref(j_labels);
+}
+END_TEST
+
+START_TEST(test_glwd_prometheus_metrics_client_cache)
+{
+  json_t * j_labels = json_pack("{ss}", "cache", "client");
+  struct _u_map body;
+  int nb_miss_1, nb_miss_2;
+
+  u_map_init(&body);
+  u_map_put(&body, "grant_type", "client_credentials");
+  u_map_put(&body, "scope", "scope2");
+  ck_assert_int_ne(-1, nb_miss_1 = get_metrics("glewlwyd_cache_miss_total", j_labels));
+  ck_assert_int_eq(run_simple_test(NULL, "POST", SERVER_URI "/glwd/token/", "client_unknown", CLIENT_SECRET, NULL, &body, 403, NULL, NULL, NULL), 1);
+  ck_assert_int_eq(run_simple_test(NULL, "POST", SERVER_URI "/glwd/token/", "client_unknown", CLIENT_SECRET, NULL, &body, 403, NULL, NULL, NULL), 1);
+  ck_assert_int_ne(-1, nb_miss_2 = get_metrics("glewlwyd_cache_miss_total", j_labels));
+  ck_assert_int_le(nb_miss_2, nb_miss_1+1);
+  ck_assert_int_gt(get_metrics("glewlwyd_cache_entries", j_labels), 0);
+  u_map_clean(&body);
+  json_decref(j_labels);
+}
+END_TEST
+
+START_TEST(test_glwd_prometheus_metrics_request_duration)
+{
+  json_t * j_labels = json_pack("{ss}", "endpoint", "GET /user/");
+  int nb_request_1, nb_request_2;
+
+  nb_request_1 = get_metrics("glewlwyd_http_request_duration_seconds_count", j_labels);
+  ck_assert_int_eq(run_simple_test(&admin_req, "GET", SERVER_URI "/user/", NULL, NULL, NULL, NULL, 200, NULL, NULL, NULL), 1);
+  ck_assert_int_eq(run_simple_test(&admin_req, "GET", SERVER_URI "/user/", NULL, NULL, NULL, NULL, 200, NULL, NULL, NULL), 1);
+  ck_assert_int_ne(-1, nb_request_2 = get_metrics("glewlwyd_http_request_duration_seconds_count", j_labels));
+  ck_assert_int_eq(nb_request_2, (nb_request_1>0?nb_request_1:0)+2);
+  ck_assert_int_eq(get_metrics("glewlwyd_http_requests_in_flight", j_labels), 0);
+  json_decref(j_labels);
+  j_labels = json_pack("{ssss}", "endpoint", "GET /user/", "le", "+Inf");
+  ck_assert_int_eq(get_metrics("glewlwyd_http_request_duration_seconds_bucket", j_labels), nb_request_2);
+  json_decref(j_labels);
+}
+END_TEST
+
+START_TEST(test_glwd_prometheus_metrics_job_queue)
+{
+  const char * type_list[] = {"mail", "geolocation", "notification", NULL};
+  json_t * j_labels;
+  size_t i;
+
+  for (i=0; type_list[i] != NULL; i++) {
+    j_labels = json_pack("{ss}", "type", type_list[i]);
+    ck_assert_int_ne(-1, get_metrics("glewlwyd_job_queue_depth", j_labels));
+    ck_assert_int_ne(-1, get_metrics("glewlwyd_job_queue_running", j_labels));
+    ck_assert_int_ne(-1, get_metrics("glewlwyd_job_queue_completed_total", j_labels));
+    ck_assert_int_eq(0, get_metrics("glewlwyd_job_queue_dropped_total", j_labels));
+    json_decref(j_labels);
+  }
+}
+END_TEST
+
+START_TEST(test_glwd_prometheus_metrics_geolocation_cache)
+{
+  json_t * j_labels = json_pack("{ss}", "cache", "geolocation");
+
+  ck_assert_int_ne(-1, get_metrics("glewlwyd_cache_entries", j_labels));
+  ck_assert_int_ne(-1, get_metrics("glewlwyd_cache_miss_total", j_labels));
+  ck_assert_int_ne(-1, get_metrics("glewlwyd_cache_hit_ratio", j_labels));
+  json_decref(j_labels);
+}
+END_TEST
+
+START_TEST(test_glwd_prometheus_metrics_purge)
+{
+  json_t * j_labels = json_pack("{ssss}", "plugin", "glewlwyd", "table", "g_user_session");
+
+  ck_assert_int_ne(-1, get_metrics("glewlwyd_purge_deleted_total", j_labels));
+  ck_assert_int_ne(-1, get_metrics("glewlwyd_purge_batches_total", j_labels));
+  json_decref(j_labels);
+  j_labels = json_pack("{ssss}", "plugin", "oidc", "table", "gpo_refresh_token");
+  ck_assert_int_ne(-1, get_metrics("glewlwyd_purge_deleted_total", j_labels));
+  json_decref(j_labels);
+}
+END_TEST
+
 static Suite *glewlwyd_suite(void)
 {
   Suite *s;
@@ -334,6 +445,13 @@ static Suite *glewlwyd_suite(void)
   tcase_add_test(tc_core, test_glwd_prometheus_metrics_auth_invalid_pwd_increase);
   tcase_add_test(tc_core, test_glwd_prometheus_metrics_oidc_flow_ok);
   tcase_add_test(tc_core, test_glwd_prometheus_metrics_glwd_flow_ok);
+  tcase_add_test(tc_core, test_glwd_prometheus_metrics_database_pool);
+  tcase_add_test(tc_core, test_glwd_prometheus_metrics_user_cache);
+  tcase_add_test(tc_core, test_glwd_prometheus_metrics_client_cache);
+  tcase_add_test(tc_core, test_glwd_prometheus_metrics_request_duration);
+  tcase_add_test(tc_core, test_glwd_prometheus_metrics_job_queue);
+  tcase_add_test(tc_core, test_glwd_prometheus_metrics_geolocation_cache);
+  tcase_add_test(tc_core, test_glwd_prometheus_metrics_purge);
   tcase_set_timeout(tc_core, 30);
   suite_add_tcase(s, tc_core);
 
@@ -0,0 +1,210 @@
+/* Public domain, no copyright. Use at your own risk. */
+
+/**
+ * Expired rows purge tests
+ * Runs the purge of purge.c on a sqlite3 in-memory database
+ * with a 1 second interval and a batch size smaller than the number of expired rows
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <check.h>
+#include <orcania.h>
+#include <yder.h>
+
+#include "../src/glewlwyd.h"
+
+#define PURGE_TABLE          "g_purge_test"
+#define PURGE_TABLE_REF      "g_purge_test_ref"
+#define PURGE_PLUGIN         "test"
+#define PURGE_PLUGIN_OTHER   "other"
+#define PURGE_RETENTION      60
+#define PURGE_BATCH_SIZE     2
+#define PURGE_MAX_WAIT       10
+
+static struct config_elements * config;
+
+static void setup(void) {
+  ck_assert_ptr_ne(NULL, config = o_malloc(sizeof(struct config_elements)));
+  memset(config, 0, sizeof(struct config_elements));
+  ck_assert_ptr_ne(NULL, config->conn = h_connect_sqlite(":memory:"));
+  ck_assert_int_eq(h_execute_query_sqlite(config->conn, "CREATE TABLE " PURGE_TABLE " (gpt_id INTEGER PRIMARY KEY AUTOINCREMENT, gpt_plugin_name TEXT, gpt_expires_at INTEGER);"), H_OK);
+  ck_assert_int_eq(h_execute_query_sqlite(config->conn, "CREATE TABLE " PURGE_TABLE_REF " (gptr_id INTEGER PRIMARY KEY AUTOINCREMENT, gpt_id INTEGER);"), H_OK);
+  config->purge.interval = 1;
+  config->purge.retention = PURGE_RETENTION;
+  config->purge.batch_size = PURGE_BATCH_SIZE;
+  config->purge.batch_delay = 0;
+}
+
+static void teardown(void) {
+  glewlwyd_purge_close(config);
+  h_close_db(config->conn);
+  h_clean_connection(config->conn);
+  o_free(config);
+}
+
+static void insert_rows(const char * plugin_name, time_t expires_at, size_t nb_rows) {
+  json_t * j_query;
+  size_t i;
+
+  for (i=0; i<nb_rows; i++) {
+    j_query = json_pack("{sss{sssI}}", "table", PURGE_TABLE, "values", "gpt_plugin_name", plugin_name, "gpt_expires_at", (json_int_t)expires_at);
+    ck_assert_int_eq(h_insert(config->conn, j_query, NULL), H_OK);
+    json_decref(j_query);
+  }
+}
+
+/**
+ * Returns the number of rows of plugin_name whose expiration is before the date
+ */
+static size_t count_rows(const char * plugin_name, time_t before) {
+  json_t * j_query, * j_result = NULL;
+  char * clause = msprintf("< %" JSON_INTEGER_FORMAT, (json_int_t)before);
+  size_t nb_rows;
+
+  j_query = json_pack("{sss[s]s{sss{ssss}}}", "table", PURGE_TABLE, "columns", "gpt_id", "where", "gpt_plugin_name", plugin_name, "gpt_expires_at", "operator", "raw", "value", clause);
+  ck_assert_int_eq(h_select(config->conn, j_query, &j_result, NULL), H_OK);
+  nb_rows = json_array_size(j_result);
+  json_decref(j_query);
+  json_decref(j_result);
+  o_free(clause);
+  return nb_rows;
+}
+
+/**
+ * Waits until the purge metrics contain the line expected
+ */
+static void wait_metrics(const char * expected) {
+  char * metrics;
+  int found = 0, i;
+
+  for (i=0; !found && i<PURGE_MAX_WAIT*10; i++) {
+    metrics = glewlwyd_purge_metrics(config);
+    found = (o_strstr(metrics, expected) != NULL);
+    o_free(metrics);
+    if (!found) {
+      usleep(100000);
+    }
+  }
+  ck_assert_int_eq(found, 1);
+}
+
+START_TEST(test_glwd_purge_expired_rows)
+{
+  time_t now = time(NULL);
+
+  insert_rows(PURGE_PLUGIN, now-3600, 5);
+  insert_rows(PURGE_PLUGIN, now+3600, 3);
+  insert_rows(PURGE_PLUGIN, now-(PURGE_RETENTION/2), 2);
+  insert_rows(PURGE_PLUGIN_OTHER, now-3600, 2);
+  ck_assert_int_eq(glewlwyd_purge_init(config), G_OK);
+  ck_assert_int_eq(glewlwyd_purge_add_task(config, PURGE_PLUGIN, PURGE_TABLE, "gpt_id", "gpt_plugin_name", "gpt_expires_at", 0, NULL), G_OK);
+
+  // 5 expired rows with a batch size of 2 are deleted in 3 batches
+  wait_metrics("glewlwyd_purge_deleted_total{plugin=\"" PURGE_PLUGIN "\", table=\"" PURGE_TABLE "\"} 5\n");
+  wait_metrics("glewlwyd_purge_batches_total{plugin=\"" PURGE_PLUGIN "\", table=\"" PURGE_TABLE "\"} 3\n");
+  glewlwyd_purge_close(config);
+  ck_assert_int_eq(count_rows(PURGE_PLUGIN, now-PURGE_RETENTION), 0);
+  ck_assert_int_eq(count_rows(PURGE_PLUGIN, now+7200), 5);
+  ck_assert_int_eq(count_rows(PURGE_PLUGIN_OTHER, now+7200), 2);
+}
+END_TEST
+
+START_TEST(test_glwd_purge_next_interval)
+{
+  time_t now = time(NULL);
+  json_t * j_query;
+
+  insert_rows(PURGE_PLUGIN, now+3600, 3);
+  insert_rows(PURGE_PLUGIN, now-3600, 1);
+  ck_assert_int_eq(glewlwyd_purge_init(config), G_OK);
+  ck_assert_int_eq(glewlwyd_purge_add_task(config, PURGE_PLUGIN, PURGE_TABLE, "gpt_id", "gpt_plugin_name", "gpt_expires_at", 0, NULL), G_OK);
+  wait_metrics("glewlwyd_purge_deleted_total{plugin=\"" PURGE_PLUGIN "\", table=\"" PURGE_TABLE "\"} 1\n");
+
+  // A row expired since the last run, with an id lower than the last row purged, is deleted by the next run
+  j_query = json_pack("{sss{sI}s{sI}}", "table", PURGE_TABLE, "set", "gpt_expires_at", (json_int_t)(now-3600), "where", "gpt_id", (json_int_t)1);
+  ck_assert_int_eq(h_update(config->conn, j_query, NULL), H_OK);
+  json_decref(j_query);
+  wait_metrics("glewlwyd_purge_deleted_total{plugin=\"" PURGE_PLUGIN "\", table=\"" PURGE_TABLE "\"} 2\n");
+  glewlwyd_purge_close(config);
+  ck_assert_int_eq(count_rows(PURGE_PLUGIN, now), 0);
+  ck_assert_int_eq(count_rows(PURGE_PLUGIN, now+7200), 2);
+}
+END_TEST
+
+START_TEST(test_glwd_purge_extra_retention_condition)
+{
+  time_t now = time(NULL);
+  json_t * j_query;
+
+  insert_rows(PURGE_PLUGIN, now-7200, 4);
+  insert_rows(PURGE_PLUGIN, now-1800, 2);
+  // The first expired row is referenced and must be kept
+  j_query = json_pack("{sss{sI}}", "table", PURGE_TABLE_REF, "values", "gpt_id", (json_int_t)1);
+  ck_assert_int_eq(h_insert(config->conn, j_query, NULL), H_OK);
+  json_decref(j_query);
+  ck_assert_int_eq(glewlwyd_purge_init(config), G_OK);
+  ck_assert_int_eq(glewlwyd_purge_add_task(config, PURGE_PLUGIN, PURGE_TABLE, "gpt_id", "gpt_plugin_name", "gpt_expires_at", 3600, "NOT EXISTS (SELECT gptr_id FROM " PURGE_TABLE_REF " WHERE " PURGE_TABLE_REF ".gpt_id=" PURGE_TABLE ".gpt_id)"), G_OK);
+
+  // Rows older than retention+extra_retention and not referenced are deleted
+  wait_metrics("glewlwyd_purge_deleted_total{plugin=\"" PURGE_PLUGIN "\", table=\"" PURGE_TABLE "\"} 3\n");
+  glewlwyd_purge_close(config);
+  ck_assert_int_eq(count_rows(PURGE_PLUGIN, now-3600), 1);
+  ck_assert_int_eq(count_rows(PURGE_PLUGIN, now+7200), 3);
+}
+END_TEST
+
+START_TEST(test_glwd_purge_disabled)
+{
+  time_t now = time(NULL);
+
+  insert_rows(PURGE_PLUGIN, now-3600, 2);
+  config->purge.interval = 0;
+  ck_assert_int_eq(glewlwyd_purge_init(config), G_OK);
+  ck_assert_int_eq(glewlwyd_purge_add_task(config, PURGE_PLUGIN, PURGE_TABLE, "gpt_id", "gpt_plugin_name", "gpt_expires_at", 0, NULL), G_OK);
+  ck_assert_ptr_eq(NULL, glewlwyd_purge_metrics(config));
+  sleep(2);
+  ck_assert_int_eq(count_rows(PURGE_PLUGIN, now), 2);
+}
+END_TEST
+
+static Suite *glewlwyd_suite(void)
+{
+  Suite *s;
+  TCase *tc_core;
+
+  s = suite_create("Glewlwyd purge");
+  tc_core = tcase_create("test_glwd_purge");
+  tcase_add_checked_fixture(tc_core, setup, teardown);
+  tcase_add_test(tc_core, test_glwd_purge_expired_rows);
+  tcase_add_test(tc_core, test_glwd_purge_next_interval);
+  tcase_add_test(tc_core, test_glwd_purge_extra_retention_condition);
+  tcase_add_test(tc_core, test_glwd_purge_disabled);
+  tcase_set_timeout(tc_core, 60);
+  suite_add_tcase(s, tc_core);
+
+  return s;
+}
+
+int main(void)
+{
+  int number_failed;
+  Suite *s;
+  SRunner *sr;
+
+  y_init_logs("Glewlwyd test", Y_LOG_MODE_CONSOLE, Y_LOG_LEVEL_DEBUG, NULL, "Starting Glewlwyd purge tests");
+  s = glewlwyd_suite();
+  sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_VERBOSE);
+  number_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  y_close_logs();
+
+  return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
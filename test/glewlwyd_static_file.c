@@ -0,0 +1,199 @@
+/* Public domain, no copyright. Use at your own risk. */
+
+/**
+ * Static files tests
+ * Runs the callback of static_compressed_inmemory_website_callback.c
+ * on a temporary directory, without a running instance
+ * and checks the status, the ETag of each variant and the files updated after loading
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <check.h>
+#include <ulfius.h>
+#include <orcania.h>
+#include <yder.h>
+
+#include "../src/glewlwyd-common.h"
+
+#define STATIC_FILE_NAME     "index.html"
+#define STATIC_FILE_LINE     "<p>Glewlwyd static file</p>\n"
+#define STATIC_FILE_NB_LINE  256
+#define STATIC_FILE_UPDATED  "<p>Updated</p>\n"
+
+static struct _u_compressed_inmemory_website_config config;
+static char dir_path[] = "/tmp/glewlwyd_static_XXXXXX";
+static char * file_path;
+
+static void write_file(const char * content, size_t nb_line) {
+  FILE * f;
+  size_t i;
+
+  ck_assert_ptr_ne(NULL, f = fopen(file_path, "w"));
+  for (i=0; i<nb_line; i++) {
+    ck_assert_int_eq(fputs(content, f) >= 0, 1);
+  }
+  fclose(f);
+}
+
+static void setup(void) {
+  ck_assert_ptr_ne(NULL, mkdtemp(dir_path));
+  ck_assert_ptr_ne(NULL, file_path = msprintf("%s/%s", dir_path, STATIC_FILE_NAME));
+  write_file(STATIC_FILE_LINE, STATIC_FILE_NB_LINE);
+  ck_assert_int_eq(u_init_compressed_inmemory_website_config(&config), U_OK);
+  config.files_path = o_strdup(dir_path);
+  config.url_prefix = o_strdup("");
+  u_map_put(&config.mime_types, ".html", "text/html");
+  u_map_put(&config.mime_types, "*", "application/octet-stream");
+  ck_assert_int_eq(u_add_mime_types_compressed(&config, "text/html"), U_OK);
+  ck_assert_int_eq(u_load_compressed_inmemory_website_files(&config), U_OK);
+}
+
+static void teardown(void) {
+  o_free(config.files_path);
+  o_free(config.url_prefix);
+  u_clean_compressed_inmemory_website_config(&config);
+  unlink(file_path);
+  rmdir(dir_path);
+  o_free(file_path);
+}
+
+/**
+ * Runs the callback on /index.html with the headers Accept-Encoding and If-None-Match if set
+ */
+static void run_static_file(const char * accept_encoding, const char * if_none_match, struct _u_response * response) {
+  struct _u_request request;
+
+  ulfius_init_request(&request);
+  ulfius_init_response(response);
+  request.http_url = o_strdup("/" STATIC_FILE_NAME);
+  if (accept_encoding != NULL) {
+    u_map_put(request.map_header, "Accept-Encoding", accept_encoding);
+  }
+  if (if_none_match != NULL) {
+    u_map_put(request.map_header, "If-None-Match", if_none_match);
+  }
+  ck_assert_int_eq(callback_static_compressed_inmemory_website(&request, response, &config), U_CALLBACK_CONTINUE);
+  ulfius_clean_request(&request);
+}
+
+START_TEST(test_glwd_static_file_etag)
+{
+  struct _u_response response;
+  char * etag, * etag_gzip;
+
+  run_static_file(NULL, NULL, &response);
+  ck_assert_int_eq(response.status, 200);
+  ck_assert_int_eq(response.stream_size, o_strlen(STATIC_FILE_LINE)*STATIC_FILE_NB_LINE);
+  ck_assert_ptr_eq(NULL, u_map_get_case(response.map_header, "Content-Encoding"));
+  ck_assert_str_eq(u_map_get_case(response.map_header, "Vary"), "Accept-Encoding");
+  ck_assert_ptr_ne(NULL, etag = o_strdup(u_map_get_case(response.map_header, "ETag")));
+  ulfius_clean_response(&response);
+
+  run_static_file(NULL, etag, &response);
+  ck_assert_int_eq(response.status, 304);
+  ulfius_clean_response(&response);
+
+  run_static_file("gzip, deflate", NULL, &response);
+  ck_assert_int_eq(response.status, 200);
+  ck_assert_str_eq(u_map_get_case(response.map_header, "Content-Encoding"), "gzip");
+  ck_assert_ptr_ne(NULL, etag_gzip = o_strdup(u_map_get_case(response.map_header, "ETag")));
+  ck_assert_str_ne(etag, etag_gzip);
+  ck_assert_int_lt(response.binary_body_length, o_strlen(STATIC_FILE_LINE)*STATIC_FILE_NB_LINE);
+  ulfius_clean_response(&response);
+
+  // The ETag of the identity variant doesn't validate the gzip variant
+  run_static_file("gzip, deflate", etag, &response);
+  ck_assert_int_eq(response.status, 200);
+  ck_assert_str_eq(u_map_get_case(response.map_header, "Content-Encoding"), "gzip");
+  ulfius_clean_response(&response);
+
+  run_static_file("gzip, deflate", etag_gzip, &response);
+  ck_assert_int_eq(response.status, 304);
+  ulfius_clean_response(&response);
+
+  // The ETag of the gzip variant doesn't validate the identity variant
+  run_static_file(NULL, etag_gzip, &response);
+  ck_assert_int_eq(response.status, 200);
+  ulfius_clean_response(&response);
+
+  run_static_file("gzip;q=0, deflate", NULL, &response);
+  ck_assert_int_eq(response.status, 200);
+  ck_assert_str_eq(u_map_get_case(response.map_header, "Content-Encoding"), "deflate");
+  ck_assert_str_ne(u_map_get_case(response.map_header, "ETag"), etag);
+  ck_assert_str_ne(u_map_get_case(response.map_header, "ETag"), etag_gzip);
+  ulfius_clean_response(&response);
+
+  o_free(etag);
+  o_free(etag_gzip);
+}
+END_TEST
+
+START_TEST(test_glwd_static_file_updated)
+{
+  struct _u_response response;
+  char * etag;
+
+  run_static_file(NULL, NULL, &response);
+  ck_assert_int_eq(response.status, 200);
+  ck_assert_ptr_ne(NULL, etag = o_strdup(u_map_get_case(response.map_header, "ETag")));
+  ulfius_clean_response(&response);
+
+  // The file updated after loading is served from the disk, without the ETag of the former version
+  write_file(STATIC_FILE_UPDATED, 1);
+  run_static_file(NULL, etag, &response);
+  ck_assert_int_eq(response.status, 200);
+  ck_assert_int_eq(response.stream_size, o_strlen(STATIC_FILE_UPDATED));
+  ck_assert_ptr_eq(NULL, u_map_get_case(response.map_header, "ETag"));
+  if (response.stream_callback_free != NULL) {
+    response.stream_callback_free(response.stream_user_data);
+  }
+  ulfius_clean_response(&response);
+
+  run_static_file("gzip", etag, &response);
+  ck_assert_int_eq(response.status, 200);
+  ck_assert_str_eq(u_map_get_case(response.map_header, "Content-Encoding"), "gzip");
+  ck_assert_ptr_eq(NULL, u_map_get_case(response.map_header, "ETag"));
+  ulfius_clean_response(&response);
+
+  o_free(etag);
+}
+END_TEST
+
+static Suite *glewlwyd_suite(void)
+{
+  Suite *s;
+  TCase *tc_core;
+
+  s = suite_create("Glewlwyd static file");
+  tc_core = tcase_create("test_glwd_static_file");
+  tcase_add_checked_fixture(tc_core, setup, teardown);
+  tcase_add_test(tc_core, test_glwd_static_file_etag);
+  tcase_add_test(tc_core, test_glwd_static_file_updated);
+  tcase_set_timeout(tc_core, 30);
+  suite_add_tcase(s, tc_core);
+
+  return s;
+}
+
+int main(void)
+{
+  int number_failed;
+  Suite *s;
+  SRunner *sr;
+
+  y_init_logs("Glewlwyd test", Y_LOG_MODE_CONSOLE, Y_LOG_LEVEL_DEBUG, NULL, "Starting Glewlwyd static file tests");
+  s = glewlwyd_suite();
+  sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_VERBOSE);
+  number_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  y_close_logs();
+
+  return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -76,7 +76,10 @@ let defaultParam = {
   "client-pubkey-parameter":"",
   "client-jwks-parameter":"jwks",
   "client-jwks_uri-parameter":"jwks_uri",
+  "client-jwks-cache-min-ttl":60,
+  "client-jwks-cache-max-ttl":3600,
   "request-maximum-exp":3600,
+  "request-jti-persist": false,
   "encrypt-out-token-allow":false,
   "client-enc-parameter":"enc",
   "client-alg-parameter":"alg",
@@ -96,6 +99,7 @@ let defaultParam = {
   "oauth-dpop-iat-duration":10,
   "oauth-dpop-iat-gap-duration":0,
   "oauth-dpop-dpop_bound_access_tokens-property":"dpop_bound_access_tokens",
+  "oauth-dpop-jti-persist": false,
   "oauth-dpop-nonce-mandatory": false,
   "oauth-dpop-nonce-counter": 10,
   "resource-allowed":false,
@@ -2648,6 +2652,14 @@ class GlwdOIDCParams extends Component {
                     <input type="number" min="1" step="1" className="form-control" id="mod-glwd-jwt-request-maximum-exp" onChange={(e) => this.changeNumberParam(e, "request-maximum-exp", 1)} value={this.state.mod.parameters["request-maximum-exp"]} placeholder={i18next.t("admin.mod-glwd-jwt-request-maximum-exp-ph")} />
                   </div>
                 </div>
+                <div className="form-group form-check">
+                  <input type="checkbox"
+                         className="form-check-input"
+                         id="mod-glwd-jwt-request-jti-persist"
+                         onChange={(e) => this.toggleParam(e, "request-jti-persist")}
+                         checked={this.state.mod.parameters["request-jti-persist"]} />
+                  <label className="form-check-label" htmlFor="mod-glwd-jwt-request-jti-persist">{i18next.t("admin.mod-glwd-jwt-request-jti-persist")}</label>
+                </div>
                 <div className="form-group">
                   <div className="input-group mb-3">
                     <div className="input-group-prepend">
@@ -2672,6 +2684,22 @@ class GlwdOIDCParams extends Component {
                     <input type="text" className="form-control" id="mod-glwd-jwt-request-pubkey-client-jwks_uri-parameter" onChange={(e) => this.changeParam(e, "client-jwks_uri-parameter")} value={this.state.mod.parameters["client-jwks_uri-parameter"]} placeholder={i18next.t("admin.mod-glwd-jwt-request-pubkey-client-jwks_uri-parameter-ph")} />
                   </div>
                 </div>
+                <div className="form-group">
+                  <div className="input-group mb-3">
+                    <div className="input-group-prepend">
+                      <label className="input-group-text" htmlFor="mod-glwd-jwt-request-client-jwks-cache-min-ttl">{i18next.t("admin.mod-glwd-jwt-request-client-jwks-cache-min-ttl")}</label>
+                    </div>
+                    <input type="number" min="0" step="1" className="form-control" id="mod-glwd-jwt-request-client-jwks-cache-min-ttl" onChange={(e) => this.changeNumberParam(e, "client-jwks-cache-min-ttl")} value={this.state.mod.parameters["client-jwks-cache-min-ttl"]} placeholder={i18next.t("admin.mod-glwd-jwt-request-client-jwks-cache-min-ttl-ph")} />
+                  </div>
+                </div>
+                <div className="form-group">
+                  <div className="input-group mb-3">
+                    <div className="input-group-prepend">
+                      <label className="input-group-text" htmlFor="mod-glwd-jwt-request-client-jwks-cache-max-ttl">{i18next.t("admin.mod-glwd-jwt-request-client-jwks-cache-max-ttl")}</label>
+                    </div>
+                    <input type="number" min="0" step="1" className="form-control" id="mod-glwd-jwt-request-client-jwks-cache-max-ttl" onChange={(e) => this.changeNumberParam(e, "client-jwks-cache-max-ttl")} value={this.state.mod.parameters["client-jwks-cache-max-ttl"]} placeholder={i18next.t("admin.mod-glwd-jwt-request-client-jwks-cache-max-ttl-ph")} />
+                  </div>
+                </div>
               </div>
             </div>
           </div>
@@ -3134,6 +3162,15 @@ class GlwdOIDCParams extends Component {
                     <input type="text" className="form-control" id="mod-glwd-oauth-dpop-dpop_bound_access_tokens-property" onChange={(e) => this.changeNumberParam(e, "oauth-dpop-dpop_bound_access_tokens-property")} value={this.state.mod.parameters["oauth-dpop-dpop_bound_access_tokens-property"]} placeholder={i18next.t("admin.mod-glwd-oauth-dpop-dpop_bound_access_tokens-property-ph")} disabled={!this.state.mod.parameters["oauth-dpop-allowed"]} />
                   </div>
                 </div>
+                <div className="form-group form-check">
+                  <input type="checkbox"
+                         className="form-check-input"
+                         id="mod-glwd-oauth-dpop-jti-persist"
+                         onChange={(e) => this.toggleParam(e, "oauth-dpop-jti-persist")}
+                         checked={this.state.mod.parameters["oauth-dpop-jti-persist"]}
+                         disabled={!this.state.mod.parameters["oauth-dpop-allowed"]} />
+                  <label className="form-check-label" htmlFor="mod-glwd-oauth-dpop-jti-persist">{i18next.t("admin.mod-glwd-oauth-dpop-jti-persist")}</label>
+                </div>
                 <div className="form-group form-check">
                   <input type="checkbox"
                          className="form-check-input"
@@ -493,7 +493,7 @@ class MiscConfig extends Component {
   closeGeolocationModal(e, result) {
     if (result) {
       var errorList = {}, hasError = false;
-      if (!this.state.geolocation["url"]) {
+      if (!this.state.geolocation["url"] && !this.state.geolocation["file"]) {
         hasError = true;
         errorList["url"] = i18next.t("admin.misc-geolocation-url-error")
       }
@@ -1122,6 +1122,14 @@ class MiscConfig extends Component {
                     </div>
                     {this.state.errorList["url"]?<span className="error-input">{this.state.errorList["url"]}</span>:""}
                   </div>
+                  <div className="form-group">
+                    <div className="input-group mb-3">
+                      <div className="input-group-prepend">
+                        <label className="input-group-text" htmlFor="misc-geolocation-file">{i18next.t("admin.misc-geolocation-file")}</label>
+                      </div>
+                      <input type="text" className="form-control" id="misc-geolocation-file" onChange={(e) => this.changeGeolocationValue(e, "file")} value={this.state.geolocation["file"]||""} placeholder={i18next.t("admin.misc-geolocation-file-ph")} />
+                    </div>
+                  </div>
                   <div className="form-group">
                     <div className="input-group mb-3">
                       <div className="input-group-prepend">